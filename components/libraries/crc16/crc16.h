@@ -29,6 +29,11 @@
 extern "C" {
 #endif
 
+/**@brief Implementations selectable with CRC16_CONFIG_IMPLEMENTATION. All give the same CRC-16. */
+#define CRC16_IMPLEMENTATION_BITWISE        0   /**< Bit by bit. Smallest and slowest. */
+#define CRC16_IMPLEMENTATION_TABLE          1   /**< Byte by byte, with a 256 entry table in flash. */
+#define CRC16_IMPLEMENTATION_SLICING_BY_4   2   /**< Four bytes at a time, with four 256 entry tables in flash. */
+
 /**@brief Function for calculating CRC-16 in blocks.
  *
  * Feed each consecutive data block into this function, along with the current value of p_crc as
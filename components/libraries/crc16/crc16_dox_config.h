@@ -12,5 +12,18 @@
  */
 #define CRC16_ENABLED
 
+/** @brief Implementation of the CRC16 calculation
+ *
+ *  Following options are available:
+ * - 0 - Bitwise. No table.
+ * - 1 - 256 entry table. 512 bytes of flash.
+ * - 2 - Slicing-by-4, four 256 entry tables. 2048 bytes of flash.
+ *
+ *  All give the same result, so the option only trades flash for speed.
+ *
+ * @note This is an NRF_CONFIG macro.
+ */
+#define CRC16_CONFIG_IMPLEMENTATION
+
 
 /** @} */
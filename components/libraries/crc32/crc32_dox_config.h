@@ -12,5 +12,18 @@
  */
 #define CRC32_ENABLED
 
+/** @brief Implementation of the CRC32 calculation
+ *
+ *  Following options are available:
+ * - 0 - Bitwise. No table.
+ * - 1 - 256 entry table. 1024 bytes of flash.
+ * - 2 - Slicing-by-4, four 256 entry tables. 4096 bytes of flash.
+ *
+ *  All give the same result, so the option only trades flash for speed.
+ *
+ * @note This is an NRF_CONFIG macro.
+ */
+#define CRC32_CONFIG_IMPLEMENTATION
+
 
 /** @} */
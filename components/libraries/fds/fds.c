@@ -65,6 +65,11 @@ static fds_swap_page_t      m_swap_page;
 // Garbage collection data.
 static fds_gc_data_t        m_gc;
 
+#if (FDS_INDEX_SIZE > 0)
+// RAM index of the records, used to find records by file ID without scanning flash.
+static fds_index_t          m_index;
+#endif
+
 
 static void flag_set(fds_flags_t flag)
 {
@@ -406,6 +411,271 @@ static bool record_find_next(uint16_t page, uint32_t const ** p_record)
 }
 
 
+#if (FDS_INDEX_SIZE > 0)
+
+// Compares two index entries by file ID, record key, page and offset, in this order.
+static int32_t index_compare(fds_index_entry_t const * const p_a, fds_index_entry_t const * const p_b)
+{
+    if (p_a->file_id != p_b->file_id)
+    {
+        return (int32_t)p_a->file_id - p_b->file_id;
+    }
+    if (p_a->record_key != p_b->record_key)
+    {
+        return (int32_t)p_a->record_key - p_b->record_key;
+    }
+    if (p_a->page != p_b->page)
+    {
+        return (int32_t)p_a->page - p_b->page;
+    }
+    return (int32_t)p_a->offset - p_b->offset;
+}
+
+
+// Returns the position of the first entry which is not smaller than p_entry.
+// NOTE: Must be called from within a critical section.
+static uint16_t index_lower_bound(fds_index_entry_t const * const p_entry)
+{
+    uint16_t low  = 0;
+    uint16_t high = m_index.count;
+
+    while (low < high)
+    {
+        uint16_t const mid = (low + high) / 2;
+
+        if (index_compare(&m_index.entry[mid], p_entry) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+
+static void index_entry_set(fds_index_entry_t * const p_entry,
+                            uint16_t                  page,
+                            uint32_t    const * const p_record)
+{
+    fds_header_t const * const p_header = (fds_header_t*)p_record;
+
+    p_entry->file_id    = p_header->ic.file_id;
+    p_entry->record_key = p_header->tl.record_key;
+    p_entry->page       = page;
+    p_entry->offset     = (uint16_t)(p_record - m_pages[page].p_addr);
+}
+
+
+// Adds a record to the index, unless it is there already.
+// If the index is full, it is invalidated and flash is scanned from then on.
+static void index_record_add(uint16_t page, uint32_t const * const p_record)
+{
+    fds_index_entry_t entry;
+
+    index_entry_set(&entry, page, p_record);
+
+    CRITICAL_SECTION_ENTER();
+    if (m_index.valid)
+    {
+        uint16_t const pos = index_lower_bound(&entry);
+
+        if ((pos == m_index.count) || (index_compare(&m_index.entry[pos], &entry) != 0))
+        {
+            if (m_index.count < FDS_INDEX_SIZE)
+            {
+                memmove(&m_index.entry[pos + 1], &m_index.entry[pos],
+                        (m_index.count - pos) * sizeof(fds_index_entry_t));
+                m_index.entry[pos] = entry;
+                m_index.count++;
+            }
+            else
+            {
+                m_index.valid = false;
+            }
+        }
+    }
+    CRITICAL_SECTION_EXIT();
+}
+
+
+// Removes a record from the index. The record header must still be intact in flash.
+static void index_record_remove(uint16_t page, uint32_t const * const p_record)
+{
+    fds_index_entry_t entry;
+
+    index_entry_set(&entry, page, p_record);
+
+    CRITICAL_SECTION_ENTER();
+    if (m_index.valid)
+    {
+        uint16_t const pos = index_lower_bound(&entry);
+
+        if ((pos < m_index.count) && (index_compare(&m_index.entry[pos], &entry) == 0))
+        {
+            m_index.count--;
+            memmove(&m_index.entry[pos], &m_index.entry[pos + 1],
+                    (m_index.count - pos) * sizeof(fds_index_entry_t));
+        }
+    }
+    CRITICAL_SECTION_EXIT();
+}
+
+
+// Replaces the entries of a page with the records currently stored on it.
+static void index_page_rebuild(uint16_t page)
+{
+    uint32_t const * p_record = NULL;
+    uint16_t         count    = 0;
+
+    CRITICAL_SECTION_ENTER();
+    for (uint16_t i = 0; i < m_index.count; i++)
+    {
+        if (m_index.entry[i].page != page)
+        {
+            m_index.entry[count++] = m_index.entry[i];
+        }
+    }
+    m_index.count = count;
+    CRITICAL_SECTION_EXIT();
+
+    while (record_find_next(page, &p_record))
+    {
+        index_record_add(page, p_record);
+    }
+}
+
+
+// Builds the index from scratch, by scanning all data pages.
+static void index_rebuild(void)
+{
+    CRITICAL_SECTION_ENTER();
+    m_index.count = 0;
+    m_index.valid = true;
+    CRITICAL_SECTION_EXIT();
+
+    for (uint16_t page = 0; page < FDS_MAX_PAGES; page++)
+    {
+        if (m_pages[page].page_type == FDS_PAGE_DATA)
+        {
+            index_page_rebuild(page);
+        }
+    }
+}
+
+
+// Invalidates the index, e.g., when a flash operation timed out and it is not known whether
+// the record was written or deleted. The index is rebuilt after the next garbage collection.
+static void index_invalidate(void)
+{
+    m_index.valid = false;
+}
+
+
+// The same as record_find(), for a given file ID, using the index.
+// Records of a file are returned in the order in which they are stored in flash, like
+// record_find() does, so that the token can be used with both.
+static ret_code_t index_find(uint16_t                  file_id,
+                             uint16_t          const * p_record_key,
+                             fds_record_desc_t       * p_desc,
+                             fds_find_token_t        * p_token,
+                             bool                    * p_index_used)
+{
+    fds_index_entry_t         first  = {0};
+    fds_index_entry_t         last   = {0};
+    fds_index_entry_t const * p_next = NULL;
+
+    if (p_token->page >= FDS_MAX_PAGES)
+    {
+        *p_index_used = true;
+        return FDS_ERR_NOT_FOUND;
+    }
+
+    // The location of the last record found. Only records stored after it are returned.
+    last.page   = p_token->page;
+    last.offset = (p_token->p_addr == NULL) ? 0 : (uint16_t)(p_token->p_addr - m_pages[last.page].p_addr);
+
+    first.file_id    = file_id;
+    first.record_key = (p_record_key != NULL) ? *p_record_key : 0;
+
+    CRITICAL_SECTION_ENTER();
+    *p_index_used = m_index.valid;
+    if (m_index.valid)
+    {
+        for (uint16_t i = index_lower_bound(&first);
+             (i < m_index.count) && (m_index.entry[i].file_id == file_id);
+             i++)
+        {
+            fds_index_entry_t const * const p_entry = &m_index.entry[i];
+
+            if ((p_record_key != NULL) && (p_entry->record_key != *p_record_key))
+            {
+                break;
+            }
+
+            // Skip records stored before the last record found.
+            if ((p_entry->page < last.page) ||
+                ((p_entry->page == last.page) && (p_entry->offset <= last.offset)))
+            {
+                continue;
+            }
+
+            if ((p_next == NULL) ||
+                (p_entry->page < p_next->page) ||
+                ((p_entry->page == p_next->page) && (p_entry->offset < p_next->offset)))
+            {
+                p_next = p_entry;
+            }
+
+            // The records with the same key are sorted by location, so the first one is next.
+            if (p_record_key != NULL)
+            {
+                break;
+            }
+        }
+
+        if (p_next != NULL)
+        {
+            p_token->page   = p_next->page;
+            p_token->p_addr = m_pages[p_next->page].p_addr + p_next->offset;
+        }
+    }
+    CRITICAL_SECTION_EXIT();
+
+    if (!(*p_index_used))
+    {
+        return FDS_ERR_NOT_FOUND;
+    }
+
+    if (p_next == NULL)
+    {
+        // Leave the token as record_find() would at the end of the search.
+        p_token->page   = FDS_MAX_PAGES;
+        p_token->p_addr = NULL;
+        return FDS_ERR_NOT_FOUND;
+    }
+
+    p_desc->record_id    = ((fds_header_t*)p_token->p_addr)->record_id;
+    p_desc->p_record     = p_token->p_addr;
+    p_desc->gc_run_count = m_gc.run_count;
+
+    return FDS_SUCCESS;
+}
+
+#else
+
+#define index_record_add(page, p_record)
+#define index_record_remove(page, p_record)
+#define index_page_rebuild(page)
+#define index_rebuild()
+#define index_invalidate()
+
+#endif // FDS_INDEX_SIZE
+
+
 // Find a record given its descriptor and retrive the page in which the record is stored.
 // NOTE: Do not pass NULL as an argument for p_page.
 static bool record_find_by_desc(fds_record_desc_t * const p_desc, uint16_t * const p_page)
@@ -462,6 +732,19 @@ static ret_code_t record_find(uint16_t          const * const p_file_id,
         return FDS_ERR_NULL_ARG;
     }
 
+#if (FDS_INDEX_SIZE > 0)
+    if (p_file_id != NULL)
+    {
+        bool             index_used;
+        ret_code_t const ret = index_find(*p_file_id, p_record_key, p_desc, p_token, &index_used);
+
+        if (index_used)
+        {
+            return ret;
+        }
+    }
+#endif
+
     // Begin (or resume) searching for a record.
     for (; p_token->page < FDS_MAX_PAGES; p_token->page++)
     {
@@ -795,6 +1078,10 @@ static ret_code_t record_find_and_delete(fds_op_t * const p_op)
 
         // Flag the record as dirty.
         ret = record_header_flag_dirty((uint32_t*)desc.p_record);
+        if (ret == FDS_SUCCESS)
+        {
+            index_record_remove(page, desc.p_record);
+        }
 
         // This page can now be garbage collected.
         m_pages[page].can_gc = true;
@@ -825,6 +1112,10 @@ static ret_code_t file_find_and_delete(fds_op_t * const p_op)
     {
          // A record was found: flag it as dirty.
         ret = record_header_flag_dirty((uint32_t*)desc.p_record);
+        if (ret == FDS_SUCCESS)
+        {
+            index_record_remove(tok.page, desc.p_record);
+        }
 
         // This page can now be garbage collected.
         m_pages[tok.page].can_gc = true;
@@ -895,8 +1186,9 @@ static bool crc_verify_success(uint16_t crc, uint16_t len_words, uint32_t const
 static void gc_init(void)
 {
     m_gc.run_count++;
-    m_gc.cur_page = 0;
-    m_gc.resume   = false;
+    m_gc.cur_page    = 0;
+    m_gc.copy_offset = 0;
+    m_gc.resume      = false;
 
     // Setup which pages to GC. Defer checking for open records and the can_gc flag,
     // as other operations might change those while GC is running.
@@ -966,18 +1258,29 @@ static ret_code_t gc_page_erase(void)
 }
 
 
-// Copy the current record to swap.
-static ret_code_t gc_record_copy(void)
+// The number of words of the current record to copy in the next flash operation.
+static uint16_t gc_copy_len(void)
 {
     fds_header_t const * const p_header   = (fds_header_t*)m_gc.p_record_src;
-    uint32_t     const * const p_dest     = m_swap_page.p_addr + m_swap_page.write_offset;
     uint16_t     const         record_len = FDS_HEADER_SIZE + p_header->tl.length_words;
+    uint16_t     const         words_left = record_len - m_gc.copy_offset;
+
+    return (words_left > FDS_GC_COPY_WORDS) ? FDS_GC_COPY_WORDS : words_left;
+}
+
+
+// Copy the current record to swap, at most FDS_GC_COPY_WORDS at a time so that
+// each flash operation is short.
+static ret_code_t gc_record_copy(void)
+{
+    uint32_t const * const p_dest = m_swap_page.p_addr + m_swap_page.write_offset;
 
     m_gc.state = GC_COPY_RECORD;
 
     // Copy the record to swap; it is guaranteed to fit in the destination page,
     // so there is no need to check its size. This will either succeed or timeout.
-    return fs_store(&fs_config, p_dest, m_gc.p_record_src, record_len, NULL);
+    return fs_store(&fs_config, p_dest + m_gc.copy_offset, m_gc.p_record_src + m_gc.copy_offset,
+                    gc_copy_len(), NULL);
 }
 
 
@@ -1026,6 +1329,9 @@ static ret_code_t gc_next_page(void)
         m_gc.cur_page     = 0;
         m_gc.p_record_src = NULL;
 
+        // Rebuild the index, in case it was invalidated.
+        index_rebuild();
+
         return FDS_OP_COMPLETED;
     }
 
@@ -1033,13 +1339,22 @@ static ret_code_t gc_next_page(void)
 }
 
 
-// Update the swap page offeset after a record has been successfully copied to it.
-static void gc_update_swap_offset(void)
+// Update the copy offset after part of a record has been successfully copied to swap, and the
+// swap page offset once all of it has. Returns true if the whole record has been copied.
+static bool gc_update_swap_offset(void)
 {
     fds_header_t const * const p_header   = (fds_header_t*)m_gc.p_record_src;
     uint16_t     const         record_len = FDS_HEADER_SIZE + p_header->tl.length_words;
 
+    m_gc.copy_offset += gc_copy_len();
+    if (m_gc.copy_offset < record_len)
+    {
+        return false;
+    }
+
+    m_gc.copy_offset          = 0;
     m_swap_page.write_offset += record_len;
+    return true;
 }
 
 
@@ -1055,6 +1370,9 @@ static void gc_swap_pages(void)
     // Keep the offset for this page, but reset it for the swap.
     m_pages[m_gc.cur_page].write_offset = m_swap_page.write_offset;
     m_swap_page.write_offset            = FDS_PAGE_TAG_SIZE;
+
+    // The records of this page are now stored in the promoted swap.
+    index_page_rebuild(m_gc.cur_page);
 }
 
 
@@ -1067,10 +1385,12 @@ static void gc_state_advance(void)
             m_gc.state = GC_NEXT_PAGE;
             break;
 
-        // A record was successfully copied.
+        // A record, or part of it, was successfully copied.
         case GC_COPY_RECORD:
-            gc_update_swap_offset();
-            m_gc.state = GC_FIND_NEXT_RECORD;
+            if (gc_update_swap_offset())
+            {
+                m_gc.state = GC_FIND_NEXT_RECORD;
+            }
             break;
 
         // A page was successfully erased. Prepare to promote the swap.
@@ -1134,6 +1454,7 @@ static ret_code_t init_execute(uint32_t prev_ret, fds_op_t * const p_op)
             }
             if (!write_reqd)
             {
+                index_rebuild();
                 flag_set(FDS_FLAG_INITIALIZED);
                 flag_clear(FDS_FLAG_INITIALIZING);
                 return FDS_OP_COMPLETED;
@@ -1199,6 +1520,7 @@ static ret_code_t write_execute(uint32_t prev_ret, fds_op_t * const p_op)
     {
         // The previous operation has timed out, update offsets.
         page_offsets_update(p_page, p_op->write.header.tl.length_words);
+        index_invalidate();
         return FDS_ERR_OPERATION_TIMEOUT;
     }
 
@@ -1243,13 +1565,27 @@ static ret_code_t write_execute(uint32_t prev_ret, fds_op_t * const p_op)
             break;
 
         case FDS_OP_WRITE_FLAG_DIRTY:
+        {
+            uint16_t page;
+
+            // The new record is complete. Replace the old one in the index.
+            index_record_add(p_op->write.page, p_write_addr);
+
             ret = record_header_flag_dirty((uint32_t*)desc.p_record);
+            if ((ret == FDS_SUCCESS) && (page_from_record(&page, desc.p_record) == FDS_SUCCESS))
+            {
+                index_record_remove(page, desc.p_record);
+            }
             p_op->write.step = FDS_OP_WRITE_DONE;
-            break;
+        }
+        break;
 
         case FDS_OP_WRITE_DONE:
             ret = FDS_OP_COMPLETED;
 
+            // Already done for updates, in the previous step.
+            index_record_add(p_op->write.page, p_write_addr);
+
 #if defined(FDS_CRC_ENABLED)
             if (flag_is_set(FDS_FLAG_VERIFY_CRC))
             {
@@ -1286,6 +1622,7 @@ static ret_code_t delete_execute(uint32_t prev_ret, fds_op_t * const p_op)
 
     if (prev_ret != FS_SUCCESS)
     {
+        index_invalidate();
         return FDS_ERR_OPERATION_TIMEOUT;
     }
 
@@ -1319,15 +1656,137 @@ static ret_code_t delete_execute(uint32_t prev_ret, fds_op_t * const p_op)
 }
 
 
+// The number of garbage collection operations in the queue, including the one being executed.
+static uint32_t gc_op_count(void)
+{
+    uint32_t count = 0;
+
+    CRITICAL_SECTION_ENTER();
+    for (uint32_t i = 0; i < m_op_queue.count; i++)
+    {
+        if (m_op_queue.op[(m_op_queue.rp + i) % FDS_OP_QUEUE_SIZE].op_code == FDS_OP_GC)
+        {
+            count++;
+        }
+    }
+    CRITICAL_SECTION_EXIT();
+
+    return count;
+}
+
+
+// Decides whether garbage collection makes way before its next step. Returns:
+// - FDS_OP_YIELDED if it is paused. It stops between pages and leaves the queue.
+// - FDS_OP_DEFERRED if it lets other operations run first. Between pages, it goes to the back of
+//   the queue. Within a page, it only lets the writes at the front of the queue pass: a record
+//   deleted after it was copied to swap would come back.
+// - FDS_OP_EXECUTING if it continues.
+// After it has been resumed, it always takes one step before it makes way again.
+static ret_code_t gc_yield(bool resumed)
+{
+    ret_code_t ret = FDS_OP_EXECUTING;
+
+    if ((m_gc.state == GC_NEXT_PAGE) && m_gc.paused)
+    {
+        // Queued again by fds_gc_pause().
+        m_gc.parked = true;
+        return FDS_OP_YIELDED;
+    }
+
+#if (FDS_GC_INCREMENTAL)
+    if (resumed || (m_op_queue.count < 2))
+    {
+        return FDS_OP_EXECUTING;
+    }
+
+    CRITICAL_SECTION_ENTER();
+    {
+        fds_op_t const gc_op = m_op_queue.op[m_op_queue.rp];
+        uint32_t       count = 0;
+
+        if (m_gc.state == GC_NEXT_PAGE)
+        {
+            count = m_op_queue.count - 1;
+        }
+        else if ((m_gc.state == GC_FIND_NEXT_RECORD) || (m_gc.state == GC_COPY_RECORD))
+        {
+            while ((count < m_op_queue.count - 1) &&
+                   (m_op_queue.op[(m_op_queue.rp + count + 1) % FDS_OP_QUEUE_SIZE].op_code == FDS_OP_WRITE))
+            {
+                count++;
+            }
+        }
+
+        // Move the operations which go first forward by one, keeping their order (and so the
+        // order of their chunks), and put GC behind them.
+        for (uint32_t i = 0; i < count; i++)
+        {
+            m_op_queue.op[(m_op_queue.rp + i) % FDS_OP_QUEUE_SIZE] =
+                m_op_queue.op[(m_op_queue.rp + i + 1) % FDS_OP_QUEUE_SIZE];
+        }
+        if (count != 0)
+        {
+            m_op_queue.op[(m_op_queue.rp + count) % FDS_OP_QUEUE_SIZE] = gc_op;
+            ret = FDS_OP_DEFERRED;
+        }
+    }
+    CRITICAL_SECTION_EXIT();
+#endif
+
+    return ret;
+}
+
+
+#if (FDS_GC_AUTO_PERCENT > 0)
+
+// Queues garbage collection if enough of the data pages are taken by dirty records,
+// unless it is paused or running already.
+static void gc_auto_start(void)
+{
+    uint16_t dirty_records = 0;
+    uint16_t dirty_words   = 0;
+    fds_op_t op;
+
+    if (m_gc.paused || (m_gc.state != GC_BEGIN) || (gc_op_count() != 0))
+    {
+        return;
+    }
+
+    for (uint16_t i = 0; i < FDS_MAX_PAGES; i++)
+    {
+        if (m_pages[i].page_type == FDS_PAGE_DATA)
+        {
+            dirty_records_stat(i, &dirty_records, &dirty_words);
+        }
+    }
+
+    if ((uint32_t)dirty_words * 100 < (uint32_t)FDS_GC_AUTO_PERCENT * FDS_MAX_PAGES * FDS_PAGE_SIZE)
+    {
+        return;
+    }
+
+    // If the queue is full, this is tried again after the next delete or update.
+    op.op_code = FDS_OP_GC;
+    (void)op_enqueue(&op, 0, NULL);
+}
+
+#endif
+
+
 static ret_code_t gc_execute(uint32_t prev_ret)
 {
     ret_code_t ret;
+    bool const resumed = m_gc.resume;
 
     if (prev_ret != FS_SUCCESS)
     {
+        index_invalidate();
         return FDS_ERR_OPERATION_TIMEOUT;
     }
 
+    // Running again, if it was parked.
+    m_gc.parked = false;
+
     if (m_gc.resume)
     {
         m_gc.resume = false;
@@ -1337,6 +1796,14 @@ static ret_code_t gc_execute(uint32_t prev_ret)
         gc_state_advance();
     }
 
+    ret = gc_yield(resumed);
+    if (ret != FDS_OP_EXECUTING)
+    {
+        // Continue with this step.
+        m_gc.resume = true;
+        return ret;
+    }
+
     switch (m_gc.state)
     {
         case GC_NEXT_PAGE:
@@ -1404,26 +1871,47 @@ static void queue_process(fs_ret_t result)
             break;
     }
 
+    if (ret == FDS_OP_DEFERRED)
+    {
+        // Garbage collection moved back in the queue. Run the operation which took its place.
+        queue_process(FS_SUCCESS);
+        return;
+    }
+
     if (ret != FDS_OP_EXECUTING)
     {
         fds_evt_t evt;
 
-        if (ret == FDS_OP_COMPLETED)
+        // Garbage collection which stopped between pages has not completed yet; there is no event.
+        if (ret != FDS_OP_YIELDED)
         {
-            evt.result = FDS_SUCCESS;
-        }
-        else
-        {
-            // Either FDS_ERR_BUSY, FDS_ERR_OPERATION_TIMEOUT,
-            // FDS_ERR_CRC_CHECK_FAILED or FDS_ERR_NOT_FOUND.
-            evt.result = ret;
+            if (ret == FDS_OP_COMPLETED)
+            {
+                evt.result = FDS_SUCCESS;
+            }
+            else
+            {
+                // Either FDS_ERR_BUSY, FDS_ERR_OPERATION_TIMEOUT,
+                // FDS_ERR_CRC_CHECK_FAILED or FDS_ERR_NOT_FOUND.
+                evt.result = ret;
 
-            // If this operation had any chunks in the queue, skip them.
-            chunk_queue_skip(p_op);
+                // If this operation had any chunks in the queue, skip them.
+                chunk_queue_skip(p_op);
+            }
+
+            event_prepare(p_op, &evt);
+            event_send(&evt);
         }
 
-        event_prepare(p_op, &evt);
-        event_send(&evt);
+#if (FDS_GC_AUTO_PERCENT > 0)
+        if ((ret == FDS_OP_COMPLETED) &&
+            ((p_op->op_code == FDS_OP_UPDATE)     ||
+             (p_op->op_code == FDS_OP_DEL_RECORD) ||
+             (p_op->op_code == FDS_OP_DEL_FILE)))
+        {
+            gc_auto_start();
+        }
+#endif
 
         // Advance the queue, and if there are any queued operations, process them.
         if (queue_advance())
@@ -1631,6 +2119,7 @@ ret_code_t fds_init(void)
     if (init_opts == ALREADY_INSTALLED)
     {
         // No initialization is necessary. Notify the application immediately.
+        index_rebuild();
         flag_set(FDS_FLAG_INITIALIZED);
         flag_clear(FDS_FLAG_INITIALIZING);
 
@@ -1929,9 +2418,12 @@ ret_code_t fds_gc(void)
 
     op.op_code = FDS_OP_GC;
 
+    // If GC is in the queue already, it must not retry the step in progress.
+    bool const gc_queued = (gc_op_count() != 0);
+
     if (op_enqueue(&op, 0, NULL))
     {
-        if (m_gc.state != GC_BEGIN)
+        if ((m_gc.state != GC_BEGIN) && !gc_queued)
         {
             // Resume GC by retrying the last step.
             m_gc.resume = true;
@@ -1945,6 +2437,34 @@ ret_code_t fds_gc(void)
 }
 
 
+ret_code_t fds_gc_pause(bool pause)
+{
+    fds_op_t op;
+
+    if (!flag_is_set(FDS_FLAG_INITIALIZED))
+    {
+        return FDS_ERR_NOT_INITIALIZED;
+    }
+
+    m_gc.paused = pause;
+
+    if (!pause && m_gc.parked)
+    {
+        // Continue where GC stopped. m_gc.resume is still set.
+        op.op_code = FDS_OP_GC;
+        if (!op_enqueue(&op, 0, NULL))
+        {
+            return FDS_ERR_NO_SPACE_IN_QUEUES;
+        }
+
+        m_gc.parked = false;
+        queue_start();
+    }
+
+    return FDS_SUCCESS;
+}
+
+
 ret_code_t fds_record_iterate(fds_record_desc_t * const p_desc,
                               fds_find_token_t  * const p_token)
 {
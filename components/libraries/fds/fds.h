@@ -648,6 +648,24 @@ ret_code_t fds_record_close(fds_record_desc_t * const p_desc);
 ret_code_t fds_gc(void);
 
 
+/**@brief   Function for pausing and resuming garbage collection.
+ *
+ * While paused, garbage collection stops at the next page boundary, without sending an event,
+ * so that flash operations do not compete with the radio, e.g. during a high throughput stream.
+ * The page being garbage collected when this function is called is finished first. Other
+ * operations in the queue are run as usual. When resumed, garbage collection continues where it
+ * stopped, and the event is sent when it completes.
+ *
+ * @param[in]   pause   true to pause garbage collection, false to resume it.
+ *
+ * @retval  FDS_SUCCESS                 If garbage collection was paused or resumed successfully.
+ * @retval  FDS_ERR_NOT_INITIALIZED     If the module is not initialized.
+ * @retval  FDS_ERR_NO_SPACE_IN_QUEUES  If garbage collection could not be resumed because the
+ *                                      operation queue is full. Try again later.
+ */
+ret_code_t fds_gc_pause(bool pause);
+
+
 /**@brief   Function for obtaining a descriptor from a record ID.
  *
  * This function can be used to reconstruct a descriptor from a record ID, like the one that is
@@ -67,5 +67,47 @@
 #define FDS_VIRTUAL_PAGE_SIZE
 
 
+/** @brief Number of records in the RAM index.
+ *
+ * Records searched by file ID, with or without record key, are found in a RAM index
+ * instead of by scanning flash. Each record takes 8 bytes of RAM. If there are more records,
+ * flash is scanned until garbage collection makes room. 0 disables the index.
+ *
+ *
+ * @note This is an NRF_CONFIG macro.
+ */
+#define FDS_INDEX_SIZE
+
+
+/** @brief Largest number of words copied by garbage collection in one flash operation.
+ *
+ * Records are copied in parts of this size, so that each flash operation is short.
+ *
+ *
+ * @note This is an NRF_CONFIG macro.
+ */
+#define FDS_GC_COPY_WORDS
+
+
+/** @brief Let queued operations run during garbage collection.
+ *
+ * Set to 1 to activate. Other operations run between pages, and writes between flash
+ * operations, instead of waiting until garbage collection completes.
+ *
+ * @note This is an NRF_CONFIG macro.
+ */
+#define FDS_GC_INCREMENTAL
+
+
+/** @brief Percentage of dirty words that starts garbage collection in the background.
+ *
+ * Checked when a delete or update completes, against the size of the data pages.
+ * 0 disables it.
+ *
+ * @note This is an NRF_CONFIG macro.
+ */
+#define FDS_GC_AUTO_PERCENT
+
+
 
 /** @} */
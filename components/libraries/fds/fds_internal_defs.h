@@ -48,6 +48,8 @@ extern "C" {
 
 #define FDS_OP_EXECUTING        (FS_SUCCESS)
 #define FDS_OP_COMPLETED        (0x1D1D)
+#define FDS_OP_YIELDED          (0x1D1E)    // GC is paused. It stopped between pages and left the queue.
+#define FDS_OP_DEFERRED         (0x1D1F)    // GC moved back in the queue, to let other operations run first.
 
 // The size of a physical page, in 4-byte words.
 #if     defined(NRF51)
@@ -77,6 +79,29 @@ extern "C" {
     #error "FDS requires at least two virtual pages."
 #endif
 
+// The number of records in the RAM index used to find records by file ID and record key.
+// Zero disables the index, and records are always found by scanning flash.
+#ifndef FDS_INDEX_SIZE
+    #define FDS_INDEX_SIZE      (0)
+#endif
+
+// The largest number of words copied by garbage collection in one flash operation.
+#ifndef FDS_GC_COPY_WORDS
+    #define FDS_GC_COPY_WORDS   (FDS_PAGE_SIZE)
+#endif
+
+// If set, garbage collection lets the other queued operations run after each page, and queued
+// writes after each flash operation.
+#ifndef FDS_GC_INCREMENTAL
+    #define FDS_GC_INCREMENTAL  (0)
+#endif
+
+// Garbage collection is started in the background when a delete or update leaves this percentage
+// of the data pages taken by dirty records. Zero disables it.
+#ifndef FDS_GC_AUTO_PERCENT
+    #define FDS_GC_AUTO_PERCENT (0)
+#endif
+
 
 // FDS internal status flags.
 typedef enum
@@ -285,12 +310,38 @@ typedef struct
     fds_gc_state_t   state;                     // The current GC step.
     uint16_t         cur_page;                  // The current page being garbage collected.
     uint32_t const * p_record_src;              // The current record being copied to swap.
+    uint16_t         copy_offset;               // The words of the current record copied so far.
     uint16_t         run_count;                 // Total number of times GC was run.
     bool             do_gc_page[FDS_MAX_PAGES]; // Controls which pages to garbage collect.
     bool             resume;                    // Whether or not GC should be resumed.
+    bool             paused;                    // Stop between pages, see fds_gc_pause().
+    bool             parked;                    // Stopped while paused, and no longer in the queue.
 } fds_gc_data_t;
 
 
+#if (FDS_INDEX_SIZE > 0)
+
+// A record in the RAM index.
+typedef struct
+{
+    uint16_t file_id;
+    uint16_t record_key;
+    uint16_t page;          // The index of the page in m_pages.
+    uint16_t offset;        // The offset of the record from the page address, in 4-byte words.
+} fds_index_entry_t;
+
+
+// The RAM index, sorted by file ID, record key, page and offset.
+typedef struct
+{
+    fds_index_entry_t entry[FDS_INDEX_SIZE];
+    uint16_t          count;
+    bool              valid;  // Cleared if the index is full or out of date. Flash is scanned instead.
+} fds_index_t;
+
+#endif
+
+
 // Macros to enable and disable application interrupts.
 #if defined (FDS_THREADS)
 
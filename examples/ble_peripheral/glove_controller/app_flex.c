@@ -0,0 +1,350 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_flex.h"
+#include "nrf_error.h"
+
+
+
+void app_flex_decimate(int16_t const * p_raw, uint8_t channels, uint8_t oversample, uint16_t num_out, int16_t * p_out)
+{
+    for(uint16_t i = 0; i < num_out; i++)
+    {
+        int16_t const * p_scan = &p_raw[i * oversample * channels];
+
+        // Output i is written over conversions that have already been summed, so this works in place
+        for(uint8_t c = 0; c < channels; c++)
+        {
+            int32_t sum = 0;
+            for(uint8_t k = 0; k < oversample; k++)
+            {
+                int16_t value = p_scan[(k * channels) + c];
+                if(value > 0) sum += value;
+            }
+            p_out[(i * channels) + c] = (int16_t)sum;
+        }
+    }
+}
+
+
+
+void app_flex_calib_reset(app_flex_calib_t * p_calib)
+{
+    for(uint8_t c = 0; c < APP_FLEX_MAX_CHANNELS; c++)
+    {
+        p_calib->min[c] = INT16_MAX;
+        p_calib->max[c] = INT16_MIN;
+    }
+}
+
+
+
+void app_flex_calib_update(app_flex_calib_t * p_calib, int16_t const * p_samples, uint8_t channels, uint16_t num_samples)
+{
+    for(uint16_t i = 0; i < num_samples; i++)
+    {
+        for(uint8_t c = 0; c < channels; c++)
+        {
+            int16_t value = *p_samples++;
+            if(value < p_calib->min[c]) p_calib->min[c] = value;
+            if(value > p_calib->max[c]) p_calib->max[c] = value;
+        }
+    }
+}
+
+
+
+void app_flex_bend_get(app_flex_calib_t const * p_calib, int16_t const * p_sample, uint8_t channels, int16_t * p_bend)
+{
+    for(uint8_t c = 0; c < channels; c++)
+    {
+        int32_t range = (int32_t)p_calib->max[c] - p_calib->min[c];
+        int32_t value = (int32_t)p_sample[c] - p_calib->min[c];
+
+        if(range < APP_FLEX_MIN_RANGE)
+        {
+            p_bend[c] = 0;
+            continue;
+        }
+        if(value < 0)     value = 0;
+        if(value > range) value = range;
+        if(p_calib->invert & (1 << c))
+        {
+            value = range - value;
+        }
+        p_bend[c] = (int16_t)((value * APP_FLEX_BEND_ONE) / range);
+    }
+}
+
+
+
+#if defined(NRF51) || defined(NRF52)
+
+#include "nrf_drv_timer.h"
+#include "nrf_drv_ppi.h"
+#if defined(NRF52)
+#include "nrf_drv_saadc.h"
+#else
+#include "nrf_drv_adc.h"
+#endif
+
+
+typedef struct
+{
+    app_flex_config_t       config;
+    uint16_t                half_size;          // Conversions per block
+    nrf_ppi_channel_t       ppi_trigger;
+#if !defined(NRF52)
+    nrf_drv_adc_channel_t   channels[APP_FLEX_MAX_CHANNELS];    // Linked into the driver, so not on the stack
+#endif
+    bool                    initialized;
+    bool                    running;
+}app_flex_t;
+
+
+static const nrf_drv_timer_t m_trigger_timer = NRF_DRV_TIMER_INSTANCE(APP_FLEX_TIMER_INSTANCE);
+static app_flex_t m_flex;
+
+
+
+static int16_t * block_get(uint8_t block)
+{
+    return m_flex.config.p_buffer + (block * m_flex.half_size);
+}
+
+
+
+static void block_done(int16_t * p_raw)
+{
+    app_flex_decimate(p_raw, m_flex.config.channel_count, m_flex.config.oversample, m_flex.config.depth, p_raw);
+    m_flex.config.evt_handler(p_raw, m_flex.config.depth, m_flex.config.p_context);
+}
+
+
+
+// Only needed to keep the TIMER driver happy. Scans are started by PPI.
+static void trigger_handler(nrf_timer_event_t event_type, void * p_context)
+{
+    ;
+}
+
+
+
+#if defined(NRF52)
+
+static void saadc_handler(nrf_drv_saadc_evt_t const * p_event)
+{
+    if(p_event->type == NRF_DRV_SAADC_EVT_DONE)
+    {
+        int16_t * p_raw = p_event->data.done.p_buffer;
+
+        // Queued behind the block being filled now, so it is not written for another block time
+        (void)nrf_drv_saadc_buffer_convert(p_raw, m_flex.half_size);
+        block_done(p_raw);
+    }
+}
+
+
+
+static uint32_t adc_open(void)
+{
+    uint32_t err_code;
+
+    nrf_drv_saadc_config_t saadc_config = {
+        .resolution         = NRF_SAADC_RESOLUTION_12BIT,
+        .oversample         = NRF_SAADC_OVERSAMPLE_DISABLED, // Hardware oversampling does not work in scan mode
+        .interrupt_priority = m_flex.config.irq_priority,
+        .low_power_mode     = false
+    };
+    err_code = nrf_drv_saadc_init(&saadc_config, saadc_handler);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    for(uint8_t i = 0; i < m_flex.config.channel_count; i++)
+    {
+        // VDD/4 reference and 1/4 gain make the full scale VDD, like the divider
+        nrf_saadc_channel_config_t channel_config =
+            NRF_DRV_SAADC_DEFAULT_CHANNEL_CONFIG_SE((nrf_saadc_input_t)(NRF_SAADC_INPUT_AIN0 + m_flex.config.ain[i]));
+        channel_config.gain      = NRF_SAADC_GAIN1_4;
+        channel_config.reference = NRF_SAADC_REFERENCE_VDD4;
+
+        err_code = nrf_drv_saadc_channel_init(i, &channel_config);
+        if(err_code != NRF_SUCCESS) return err_code;
+    }
+
+    err_code = nrf_drv_saadc_buffer_convert(block_get(0), m_flex.half_size);
+    if(err_code != NRF_SUCCESS) return err_code;
+    return nrf_drv_saadc_buffer_convert(block_get(1), m_flex.half_size);
+}
+
+
+
+static void adc_close(void)
+{
+    nrf_drv_saadc_abort();
+    nrf_drv_saadc_uninit();
+}
+
+
+
+static uint32_t adc_task_get(void)
+{
+    return nrf_drv_saadc_sample_task_get();
+}
+
+#else
+
+static void adc_handler(nrf_drv_adc_evt_t const * p_event)
+{
+    if(p_event->type == NRF_DRV_ADC_EVT_DONE)
+    {
+        int16_t * p_raw = p_event->data.done.p_buffer;
+
+        // The driver takes one buffer at a time, so the other half is armed straight away
+        (void)nrf_drv_adc_buffer_convert((p_raw == block_get(0)) ? block_get(1) : block_get(0), m_flex.half_size);
+        block_done(p_raw);
+    }
+}
+
+
+
+static uint32_t adc_open(void)
+{
+    uint32_t err_code;
+    nrf_drv_adc_config_t adc_config = NRF_DRV_ADC_DEFAULT_CONFIG;
+
+    adc_config.interrupt_priority = m_flex.config.irq_priority;
+    err_code = nrf_drv_adc_init(&adc_config, adc_handler);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    for(uint8_t i = 0; i < m_flex.config.channel_count; i++)
+    {
+        nrf_drv_adc_channel_t * p_channel = &m_flex.channels[i];
+
+        // 1/3 prescaling against VDD/3 makes the full scale VDD, like the divider
+        memset(p_channel, 0, sizeof(*p_channel));
+        p_channel->config.config.resolution = NRF_ADC_CONFIG_RES_10BIT;
+        p_channel->config.config.input      = NRF_ADC_CONFIG_SCALING_INPUT_ONE_THIRD;
+        p_channel->config.config.reference  = NRF_ADC_CONFIG_REF_SUPPLY_ONE_THIRD;
+        p_channel->config.config.ain        = NRF_ADC_CONFIG_INPUT_0 << m_flex.config.ain[i];
+        nrf_drv_adc_channel_enable(p_channel);
+    }
+
+    return nrf_drv_adc_buffer_convert(block_get(0), m_flex.half_size);
+}
+
+
+
+static void adc_close(void)
+{
+    nrf_drv_adc_uninit();
+}
+
+
+
+static uint32_t adc_task_get(void)
+{
+    return nrf_drv_adc_start_task_get();
+}
+
+#endif
+
+
+
+uint32_t app_flex_init(app_flex_config_t const * p_config)
+{
+    uint32_t err_code;
+    uint32_t ticks;
+
+    if(m_flex.initialized) return NRF_ERROR_INVALID_STATE;
+    if(p_config == NULL || p_config->p_buffer == NULL || p_config->evt_handler == NULL) return NRF_ERROR_NULL;
+    if(p_config->channel_count == 0 || p_config->channel_count > APP_FLEX_MAX_CHANNELS) return NRF_ERROR_INVALID_PARAM;
+    if(p_config->oversample == 0 || p_config->oversample > APP_FLEX_MAX_OVERSAMPLE) return NRF_ERROR_INVALID_PARAM;
+    if(p_config->depth == 0 || p_config->scan_period_us == 0) return NRF_ERROR_INVALID_PARAM;
+    if((uint32_t)p_config->channel_count * p_config->depth * p_config->oversample > INT16_MAX) return NRF_ERROR_INVALID_PARAM;
+    for(uint8_t i = 0; i < p_config->channel_count; i++)
+    {
+        if(p_config->ain[i] > 7) return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_flex.config    = *p_config;
+    m_flex.half_size = p_config->channel_count * p_config->depth * p_config->oversample;
+
+    // 1 MHz and 16 bits fit any scan period, on the 16 bit TIMERs of the nRF51 too
+    nrf_drv_timer_config_t timer_config = NRF_DRV_TIMER_DEFAULT_CONFIG;
+    timer_config.frequency = NRF_TIMER_FREQ_1MHz;
+    timer_config.mode      = NRF_TIMER_MODE_TIMER;
+    timer_config.bit_width = NRF_TIMER_BIT_WIDTH_16;
+    err_code = nrf_drv_timer_init(&m_trigger_timer, &timer_config, trigger_handler);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    ticks = nrf_drv_timer_us_to_ticks(&m_trigger_timer, p_config->scan_period_us);
+    nrf_drv_timer_extended_compare(&m_trigger_timer, NRF_TIMER_CC_CHANNEL0, ticks, NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK, false);
+
+    err_code = nrf_drv_ppi_init();
+    if(err_code != NRF_SUCCESS && err_code != NRF_ERROR_MODULE_ALREADY_INITIALIZED) return err_code;
+
+    err_code = nrf_drv_ppi_channel_alloc(&m_flex.ppi_trigger);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_ppi_channel_assign(m_flex.ppi_trigger,
+                                          nrf_drv_timer_event_address_get(&m_trigger_timer, NRF_TIMER_EVENT_COMPARE0),
+                                          adc_task_get());
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    m_flex.initialized = true;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_flex_start(void)
+{
+    uint32_t err_code;
+
+    if(!m_flex.initialized || m_flex.running) return NRF_ERROR_INVALID_STATE;
+
+    err_code = adc_open();
+    if(err_code != NRF_SUCCESS)
+    {
+        adc_close();
+        return err_code;
+    }
+
+    err_code = nrf_drv_ppi_channel_enable(m_flex.ppi_trigger);
+    if(err_code != NRF_SUCCESS)
+    {
+        adc_close();
+        return err_code;
+    }
+
+    nrf_drv_timer_clear(&m_trigger_timer);
+    nrf_drv_timer_enable(&m_trigger_timer);
+    m_flex.running = true;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_flex_stop(void)
+{
+    uint32_t err_code;
+
+    if(!m_flex.running) return NRF_ERROR_INVALID_STATE;
+
+    nrf_drv_timer_disable(&m_trigger_timer);
+    err_code = nrf_drv_ppi_channel_disable(m_flex.ppi_trigger);
+    adc_close();
+    m_flex.running = false;
+    return err_code;
+}
+
+#endif // defined(NRF51) || defined(NRF52)
+
+/**
+  @}
+*/
@@ -0,0 +1,164 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_FLEX_H__
+#define APP_FLEX_H__
+
+/* Finger bend sensing with flex sensors.
+ *
+ * Each flex sensor is read as the middle of a voltage divider from VDD, against a reference
+ * that also follows VDD, so the result does not depend on the battery voltage.
+ *
+ * A TIMER compare event starts a scan of all channels through PPI. The conversions are
+ * written to one half of the buffer while the application handles the other half.
+ *  - nRF52: the SAADC scans the channels and writes them by EasyDMA. The CPU is only woken
+ *    when a block is complete.
+ *  - nRF51: the ADC has neither scan mode nor DMA. The driver moves on to the next channel
+ *    in the ADC interrupt, so the CPU is woken once per conversion, but only briefly.
+ *
+ * Every 'oversample' scans are summed into one output sample, which cuts noise and adds
+ * resolution. min/max calibration then maps each finger to a bend from 0 to APP_FLEX_BEND_ONE.
+ *
+ * Requires the ADC (nRF51) or SAADC (nRF52), PPI, TIMER and the TIMER instance below to be
+ * enabled in sdk_config.h.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define APP_FLEX_MAX_CHANNELS           8
+
+#if defined(NRF52)
+#define APP_FLEX_RAW_MAX                4095    // 12 bit SAADC
+#ifndef APP_FLEX_TIMER_INSTANCE
+#define APP_FLEX_TIMER_INSTANCE         3       // TIMER1 and TIMER2 are used by app_mpu_dma
+#endif
+#else
+#define APP_FLEX_RAW_MAX                1023    // 10 bit ADC
+#ifndef APP_FLEX_TIMER_INSTANCE
+#define APP_FLEX_TIMER_INSTANCE         1       // TIMER0 is used by the SoftDevice
+#endif
+#endif
+
+#define APP_FLEX_MAX_OVERSAMPLE         (INT16_MAX / APP_FLEX_RAW_MAX)  // Keeps the sum within int16_t
+#define APP_FLEX_BEND_ONE               INT16_MAX                       // Fully bent. Q15
+#ifndef APP_FLEX_MIN_RANGE
+#define APP_FLEX_MIN_RANGE              64      // Min peak to peak of a channel, in output units, before it reports a bend
+#endif
+
+/**@brief Size of the buffer in int16_t for two blocks of 'depth' output samples */
+#define APP_FLEX_BUFFER_SIZE(channels, depth, oversample)   (2 * (channels) * (depth) * (oversample))
+
+/**@brief Handler called from the ADC interrupt with 'num_samples' output samples of all channels,
+ * sample after sample. The block stays untouched until the other half has been filled,
+ * i.e. for 'depth' output sample periods after the event.
+ */
+typedef void (* app_flex_evt_handler_t)(int16_t const * p_block, uint16_t num_samples, void * p_context);
+
+/**@brief Acquisition engine configuration
+ */
+typedef struct
+{
+    uint8_t                 channel_count;                      // 1 to APP_FLEX_MAX_CHANNELS
+    uint8_t                 ain[APP_FLEX_MAX_CHANNELS];         // Analog input of each channel, 0 for AIN0 to 7 for AIN7
+    uint16_t                scan_period_us;                     // Time between scans
+    uint8_t                 oversample;                         // Scans per output sample. 1 to APP_FLEX_MAX_OVERSAMPLE
+    uint16_t                depth;                              // Output samples per block
+    int16_t               * p_buffer;                           // APP_FLEX_BUFFER_SIZE(channel_count, depth, oversample) values, in RAM
+    app_flex_evt_handler_t  evt_handler;
+    void                  * p_context;                          // Passed to evt_handler
+    uint8_t                 irq_priority;                       // Priority of the ADC interrupt
+}app_flex_config_t;
+
+/**@brief Per finger calibration. All arrays are indexed by channel
+ */
+typedef struct
+{
+    int16_t     min[APP_FLEX_MAX_CHANNELS];     // Output seen with the finger straight, or bent if inverted
+    int16_t     max[APP_FLEX_MAX_CHANNELS];
+    uint8_t     invert;                         // Bit per channel whose output falls as the finger bends
+}app_flex_calib_t;
+
+
+
+/**@brief Function for summing every 'oversample' scans into one output sample
+ *
+ * Runs in place when p_out is p_raw. Negative conversions are counted as 0.
+ *
+ * @param[in]   p_raw           num_out * oversample scans of 'channels' conversions
+ * @param[in]   channels        Conversions per scan
+ * @param[in]   oversample      Scans per output sample
+ * @param[in]   num_out         Output samples
+ * @param[out]  p_out           num_out samples of 'channels' values
+ */
+void app_flex_decimate(int16_t const * p_raw, uint8_t channels, uint8_t oversample, uint16_t num_out, int16_t * p_out);
+
+
+
+/**@brief Function for clearing the range seen by a calibration. The invert bits are kept
+ *
+ * @param[out]  p_calib         Calibration
+ */
+void app_flex_calib_reset(app_flex_calib_t * p_calib);
+
+
+
+/**@brief Function for widening the calibration range with output samples
+ *
+ * Bend each finger fully a few times while this is fed, and again whenever the sensors shift.
+ *
+ * @param[in]   p_calib         Calibration
+ * @param[in]   p_samples       num_samples samples of 'channels' values
+ * @param[in]   channels        Values per sample
+ * @param[in]   num_samples     Samples
+ */
+void app_flex_calib_update(app_flex_calib_t * p_calib, int16_t const * p_samples, uint8_t channels, uint16_t num_samples);
+
+
+
+/**@brief Function for converting one output sample to bends
+ *
+ * @param[in]   p_calib         Calibration
+ * @param[in]   p_sample        'channels' values
+ * @param[in]   channels        Values per sample
+ * @param[out]  p_bend          Bend of each finger, 0 straight to APP_FLEX_BEND_ONE fully bent.
+ *                              0 while the calibration range is below APP_FLEX_MIN_RANGE
+ */
+void app_flex_bend_get(app_flex_calib_t const * p_calib, int16_t const * p_sample, uint8_t channels, int16_t * p_bend);
+
+
+
+/**@brief Function for initiating the acquisition engine
+ *
+ * Takes over the ADC or SAADC, the TIMER instance and one PPI channel.
+ *
+ * @param[in]   p_config        Engine configuration
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_PARAM if a count, period or input is out of range
+ */
+uint32_t app_flex_init(app_flex_config_t const * p_config);
+
+
+
+/**@brief Function for starting sampling from the start of the buffer
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_flex_start(void);
+
+
+
+/**@brief Function for stopping sampling. Samples in a partially filled block are discarded
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_flex_stop(void);
+
+
+#endif /* APP_FLEX_H__ */
+
+/**
+  @}
+*/
@@ -0,0 +1,280 @@
+ /*
+  * This code is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_frame.h"
+#include "app_util.h"
+#include "nordic_common.h"
+#include "nrf_error.h"
+
+#define VARINT_MAX_LEN_16   3   // Bytes for a 16 bit value
+#define VARINT_MAX_LEN_24   4   // Bytes for a 24 bit value
+#define HEADER_MAX_LEN      (APP_FRAME_HEADER_SIZE + VARINT_MAX_LEN_24 + VARINT_MAX_LEN_16)
+
+
+
+static uint8_t varint_encode(uint32_t value, uint8_t * p_out)
+{
+    uint8_t len = 0;
+
+    while(value >= 0x80)
+    {
+        p_out[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    p_out[len++] = (uint8_t)value;
+    return len;
+}
+
+
+
+/**@brief Function for reading a varint of at most max_bytes bytes
+ * @retval uint8_t Bytes read. 0 if the varint runs past len or is longer than max_bytes
+ */
+static uint8_t varint_decode(uint8_t const * p_in, uint16_t len, uint8_t max_bytes, uint32_t * p_value)
+{
+    uint32_t value = 0;
+
+    for(uint8_t i = 0; i < max_bytes && i < len; i++)
+    {
+        value |= (uint32_t)(p_in[i] & 0x7F) << (7 * i);
+        if(!(p_in[i] & 0x80))
+        {
+            *p_value = value;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+
+
+static uint16_t zigzag_encode(int16_t value)
+{
+    return (uint16_t)(((uint16_t)value << 1) ^ (uint16_t)(value >> 15));
+}
+
+
+
+static int16_t zigzag_decode(uint32_t value)
+{
+    return (int16_t)((value >> 1) ^ (0U - (value & 1)));
+}
+
+
+
+uint32_t app_frame_encoder_init(app_frame_encoder_t * p_encoder, uint8_t stream, uint8_t channels, uint8_t key_interval)
+{
+    if(stream >= APP_FRAME_STREAM_COUNT) return NRF_ERROR_INVALID_PARAM;
+    if(channels == 0 || channels > APP_FRAME_MAX_CHANNELS || key_interval == 0) return NRF_ERROR_INVALID_PARAM;
+
+    memset(p_encoder, 0, sizeof(*p_encoder));
+    p_encoder->stream        = stream;
+    p_encoder->channels      = channels;
+    p_encoder->key_interval  = key_interval;
+    p_encoder->key_countdown = 0;
+    return NRF_SUCCESS;
+}
+
+
+
+void app_frame_key_request(app_frame_encoder_t * p_encoder)
+{
+    p_encoder->key_countdown = 0;
+}
+
+
+
+uint16_t app_frame_encode(app_frame_encoder_t * p_encoder, uint8_t * p_frame, uint16_t max_len,
+                          uint32_t timestamp, uint16_t period, int16_t const * p_samples,
+                          uint16_t stride, uint16_t count, uint16_t * p_packed)
+{
+    uint8_t  sample[APP_FRAME_MAX_CHANNELS * VARINT_MAX_LEN_16];
+    bool     key    = (p_encoder->key_countdown == 0);
+    uint16_t packed = 0;
+    uint16_t len    = APP_FRAME_HEADER_SIZE;
+
+    *p_packed = 0;
+    if(max_len > APP_FRAME_MAX_LEN) max_len = APP_FRAME_MAX_LEN;
+    if(count > UINT8_MAX) count = UINT8_MAX;
+    if(max_len < HEADER_MAX_LEN || count == 0) return 0;
+
+    timestamp &= APP_FRAME_TIMESTAMP_MASK;
+    if(key)
+    {
+        len += uint32_encode(timestamp, &p_frame[len]);
+    }
+    else
+    {
+        len += varint_encode((timestamp - p_encoder->timestamp) & APP_FRAME_TIMESTAMP_MASK, &p_frame[len]);
+    }
+    len += varint_encode(period, &p_frame[len]);
+
+    for(; packed < count; packed++)
+    {
+        int16_t const * p_sample = &p_samples[packed * stride];
+        uint8_t sample_len = 0;
+
+        for(uint8_t c = 0; c < p_encoder->channels; c++)
+        {
+            if(key && packed == 0)
+            {
+                sample_len += uint16_encode((uint16_t)p_sample[c], &sample[sample_len]);
+            }
+            else
+            {
+                // The difference wraps like the decoder's sum, so it always fits 16 bits
+                int16_t delta = (int16_t)(uint16_t)((uint16_t)p_sample[c] - (uint16_t)p_encoder->last[c]);
+                sample_len += varint_encode(zigzag_encode(delta), &sample[sample_len]);
+            }
+        }
+        if(len + sample_len > max_len) break;
+
+        memcpy(&p_frame[len], sample, sample_len);
+        memcpy(p_encoder->last, p_sample, p_encoder->channels * sizeof(int16_t));
+        len += sample_len;
+    }
+    if(packed == 0) return 0;
+
+    p_frame[0] = (uint8_t)(len - 1);
+    p_frame[1] = (key ? APP_FRAME_FLAG_KEY : 0) | (p_encoder->stream << APP_FRAME_STREAM_POS) | p_encoder->channels;
+    p_frame[2] = p_encoder->seq++;
+    p_frame[3] = (uint8_t)packed;
+
+    p_encoder->timestamp     = timestamp;
+    p_encoder->key_countdown = (key ? p_encoder->key_interval : p_encoder->key_countdown) - 1;
+    *p_packed = packed;
+    return len;
+}
+
+
+
+void app_frame_decoder_init(app_frame_decoder_t * p_decoder)
+{
+    memset(p_decoder, 0, sizeof(*p_decoder));
+}
+
+
+
+uint32_t app_frame_decode(app_frame_decoder_t * p_decoder, uint8_t const * p_frame, uint16_t len,
+                          app_frame_header_t * p_header, int16_t * p_samples, uint16_t max_values)
+{
+    app_frame_header_t header;
+    uint16_t pos = APP_FRAME_HEADER_SIZE;
+    uint32_t value;
+    uint8_t  n;
+
+    if(len < APP_FRAME_HEADER_SIZE || p_frame[0] + 1 < APP_FRAME_HEADER_SIZE || p_frame[0] + 1 > len) return NRF_ERROR_INVALID_DATA;
+    len = p_frame[0] + 1;
+
+    header.key      = (p_frame[1] & APP_FRAME_FLAG_KEY) != 0;
+    header.stream   = APP_FRAME_STREAM_GET(p_frame);
+    header.channels = p_frame[1] & APP_FRAME_CHANNELS_MASK;
+    header.seq      = p_frame[2];
+    header.count    = p_frame[3];
+
+    if(header.seq != p_decoder->seq)
+    {
+        p_decoder->synced = false; // Frames were lost
+    }
+    p_decoder->seq = header.seq + 1;
+
+    if(header.channels == 0 || header.channels > APP_FRAME_MAX_CHANNELS || header.count == 0)
+    {
+        p_decoder->synced = false;
+        return NRF_ERROR_INVALID_DATA;
+    }
+    if(!header.key && (!p_decoder->synced || header.channels != p_decoder->channels))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    // Everything below rebuilds the decoder state, so a failure leaves it unsynced until the next keyframe
+    p_decoder->synced = false;
+    if(header.count * header.channels > max_values) return NRF_ERROR_INVALID_DATA;
+
+    if(header.key)
+    {
+        if(pos + sizeof(uint32_t) > len) return NRF_ERROR_INVALID_DATA;
+        header.timestamp = uint32_decode(&p_frame[pos]) & APP_FRAME_TIMESTAMP_MASK;
+        pos += sizeof(uint32_t);
+    }
+    else
+    {
+        n = varint_decode(&p_frame[pos], len - pos, VARINT_MAX_LEN_24, &value);
+        if(n == 0) return NRF_ERROR_INVALID_DATA;
+        header.timestamp = (p_decoder->timestamp + value) & APP_FRAME_TIMESTAMP_MASK;
+        pos += n;
+    }
+    n = varint_decode(&p_frame[pos], len - pos, VARINT_MAX_LEN_16, &value);
+    if(n == 0 || value > UINT16_MAX) return NRF_ERROR_INVALID_DATA;
+    header.period = (uint16_t)value;
+    pos += n;
+
+    for(uint16_t i = 0; i < header.count; i++)
+    {
+        for(uint8_t c = 0; c < header.channels; c++)
+        {
+            if(header.key && i == 0)
+            {
+                if(pos + sizeof(int16_t) > len) return NRF_ERROR_INVALID_DATA;
+                p_decoder->last[c] = (int16_t)uint16_decode(&p_frame[pos]);
+                pos += sizeof(int16_t);
+            }
+            else
+            {
+                n = varint_decode(&p_frame[pos], len - pos, VARINT_MAX_LEN_16, &value);
+                if(n == 0 || value > UINT16_MAX) return NRF_ERROR_INVALID_DATA;
+                p_decoder->last[c] = (int16_t)(uint16_t)((uint16_t)p_decoder->last[c] + (uint16_t)zigzag_decode(value));
+                pos += n;
+            }
+            *p_samples++ = p_decoder->last[c];
+        }
+    }
+    if(pos != len) return NRF_ERROR_INVALID_DATA;
+
+    p_decoder->synced    = true;
+    p_decoder->channels  = header.channels;
+    p_decoder->timestamp = header.timestamp;
+    *p_header = header;
+    return NRF_SUCCESS;
+}
+
+
+
+uint16_t app_frame_raw_encode(uint8_t stream, uint8_t * p_frame, uint16_t max_len,
+                              uint8_t const * p_data, uint16_t len, uint16_t * p_packed)
+{
+    *p_packed = 0;
+    if(stream >= APP_FRAME_STREAM_COUNT) return 0;
+    if(max_len > APP_FRAME_MAX_LEN) max_len = APP_FRAME_MAX_LEN;
+    if(max_len <= APP_FRAME_RAW_HEADER_SIZE || len == 0) return 0;
+
+    len = MIN(len, max_len - APP_FRAME_RAW_HEADER_SIZE);
+    p_frame[0] = (uint8_t)(len + APP_FRAME_RAW_HEADER_SIZE - 1);
+    p_frame[1] = (uint8_t)(stream << APP_FRAME_STREAM_POS);
+    memcpy(&p_frame[APP_FRAME_RAW_HEADER_SIZE], p_data, len);
+
+    *p_packed = len;
+    return len + APP_FRAME_RAW_HEADER_SIZE;
+}
+
+
+
+uint32_t app_frame_raw_decode(uint8_t const * p_frame, uint16_t len, uint8_t const ** pp_data, uint16_t * p_data_len)
+{
+    if(len < APP_FRAME_RAW_HEADER_SIZE || !APP_FRAME_IS_RAW(p_frame)) return NRF_ERROR_INVALID_DATA;
+    if(p_frame[0] + 1 > len || p_frame[0] + 1 < APP_FRAME_RAW_HEADER_SIZE) return NRF_ERROR_INVALID_DATA;
+
+    *pp_data    = &p_frame[APP_FRAME_RAW_HEADER_SIZE];
+    *p_data_len = p_frame[0] + 1 - APP_FRAME_RAW_HEADER_SIZE;
+    return NRF_SUCCESS;
+}
+
+/**
+  @}
+*/
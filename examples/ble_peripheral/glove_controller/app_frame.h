@@ -0,0 +1,200 @@
+ /*
+  * This code is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_FRAME_H__
+#define APP_FRAME_H__
+
+/* Compact binary frames of sensor samples, shared by the BLE, UART and flash uplinks.
+ *
+ * A sample is a fixed number of int16_t channels, e.g. an imu_sample_t or finger values.
+ * Each frame carries a sequence number and the timestamp of its first sample. In a keyframe
+ * the first sample is sent as is. Every other sample is sent as the difference from the
+ * sample before it, in the same or the previous frame. Differences are zig-zag encoded so
+ * small negative values stay small, and then written as varints of 7 bits per byte. A sample
+ * that changes slowly costs one byte per channel instead of two.
+ *
+ * A decoder that misses a frame can not rebuild the samples that follow it, so the encoder
+ * sends a keyframe every key_interval frames and the decoder waits for it after a gap.
+ *
+ * Up to four streams, e.g. the IMU and the fingers, can share one link. Each has its own
+ * encoder and decoder, and the stream id in the flags tells the frames apart.
+ *
+ * A frame of 0 channels is a raw frame. It carries bytes that are not samples, e.g. from the
+ * UART, on a stream of their own, so they can share the link without breaking the framing.
+ *
+ * Frame layout, little endian:
+ *   uint8_t    length      bytes that follow. Delimits frames in a byte stream
+ *   uint8_t    flags       APP_FRAME_FLAG_KEY | stream << APP_FRAME_STREAM_POS | number of channels
+ *   uint8_t    seq         incremented for each frame
+ *   uint8_t    count       number of samples
+ *   keyframe:  uint32_t    timestamp of the first sample
+ *   else:      varint      timestamp ticks since the previous frame
+ *   varint     period      ticks between samples
+ *   keyframe:  channels x int16_t, then (count - 1) x channels x varint
+ *   else:      count x channels x varint
+ *
+ * Raw frame layout:
+ *   uint8_t    length      bytes that follow
+ *   uint8_t    flags       stream << APP_FRAME_STREAM_POS
+ *   length - 1 bytes of data
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define APP_FRAME_MAX_CHANNELS      16
+#define APP_FRAME_MAX_LEN           256         // Length byte included
+#define APP_FRAME_HEADER_SIZE       4           // Up to and including count
+#define APP_FRAME_RAW_HEADER_SIZE   2           // Length and flags of a raw frame
+#define APP_FRAME_FLAG_KEY          0x80
+#define APP_FRAME_STREAM_MASK       0x60
+#define APP_FRAME_STREAM_POS        5
+#define APP_FRAME_STREAM_COUNT      4
+#define APP_FRAME_CHANNELS_MASK     0x1F
+#define APP_FRAME_TIMESTAMP_MASK    0x00FFFFFF  // app_timer runs on the 24 bit RTC counter
+
+#ifndef APP_FRAME_KEY_INTERVAL
+#define APP_FRAME_KEY_INTERVAL      16          // Frames between keyframes
+#endif
+
+/**@brief Stream id of a frame, to pick the decoder to pass it to */
+#define APP_FRAME_STREAM_GET(p_frame)   (((p_frame)[1] & APP_FRAME_STREAM_MASK) >> APP_FRAME_STREAM_POS)
+
+/**@brief True for a raw frame, to be passed to app_frame_raw_decode() */
+#define APP_FRAME_IS_RAW(p_frame)       (((p_frame)[1] & APP_FRAME_CHANNELS_MASK) == 0)
+
+/**@brief Frame header as decoded */
+typedef struct
+{
+    bool        key;
+    uint8_t     stream;
+    uint8_t     channels;
+    uint8_t     seq;
+    uint8_t     count;
+    uint32_t    timestamp;      // Of the first sample
+    uint16_t    period;
+}app_frame_header_t;
+
+/**@brief Encoder state. One per stream
+ */
+typedef struct
+{
+    uint8_t     stream;
+    uint8_t     channels;
+    uint8_t     key_interval;
+    uint8_t     seq;
+    uint8_t     key_countdown;  // Frames until the next keyframe. 0 sends one next
+    uint32_t    timestamp;      // Of the last frame
+    int16_t     last[APP_FRAME_MAX_CHANNELS];
+}app_frame_encoder_t;
+
+/**@brief Decoder state. One per stream
+ */
+typedef struct
+{
+    uint8_t     channels;
+    uint8_t     seq;            // Expected next
+    bool        synced;         // A keyframe has been seen since the last gap
+    uint32_t    timestamp;
+    int16_t     last[APP_FRAME_MAX_CHANNELS];
+}app_frame_decoder_t;
+
+
+
+/**@brief Function for initiating an encoder. The first frame is a keyframe
+ *
+ * @param[out]  p_encoder       Encoder state
+ * @param[in]   stream          Stream id, 0 to APP_FRAME_STREAM_COUNT - 1
+ * @param[in]   channels        Channels per sample, 1 to APP_FRAME_MAX_CHANNELS
+ * @param[in]   key_interval    Frames between keyframes. 1 makes every frame a keyframe
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_frame_encoder_init(app_frame_encoder_t * p_encoder, uint8_t stream, uint8_t channels, uint8_t key_interval);
+
+
+
+/**@brief Function for making the next frame a keyframe. Call when a frame has been lost before it was sent
+ *
+ * @param[in]   p_encoder       Encoder state
+ */
+void app_frame_key_request(app_frame_encoder_t * p_encoder);
+
+
+
+/**@brief Function for encoding as many samples as fit in one frame
+ *
+ * @param[in]   p_encoder       Encoder state
+ * @param[out]  p_frame         Buffer for the frame
+ * @param[in]   max_len         Size of the buffer. At most APP_FRAME_MAX_LEN is used
+ * @param[in]   timestamp       Time of the first sample, in app_timer ticks
+ * @param[in]   period          Ticks between samples
+ * @param[in]   p_samples       First channel of the first sample
+ * @param[in]   stride          int16_t values from one sample to the next
+ * @param[in]   count           Samples available
+ * @param[out]  p_packed        Samples encoded
+ * @retval      uint16_t        Length of the frame. 0 if not even one sample fits
+ */
+uint16_t app_frame_encode(app_frame_encoder_t * p_encoder, uint8_t * p_frame, uint16_t max_len,
+                          uint32_t timestamp, uint16_t period, int16_t const * p_samples,
+                          uint16_t stride, uint16_t count, uint16_t * p_packed);
+
+
+
+/**@brief Function for initiating a decoder. Frames are skipped until a keyframe is seen
+ *
+ * @param[out]  p_decoder       Decoder state
+ */
+void app_frame_decoder_init(app_frame_decoder_t * p_decoder);
+
+
+
+/**@brief Function for decoding a frame
+ *
+ * @param[in]   p_decoder       Decoder state
+ * @param[in]   p_frame         Frame, starting with the length byte
+ * @param[in]   len             Bytes available. Must cover the whole frame
+ * @param[out]  p_header        Frame header
+ * @param[out]  p_samples       Buffer for count x channels values, sample after sample
+ * @param[in]   max_values      Size of the buffer in int16_t
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_DATA if the frame is malformed or does not fit,
+ *                              NRF_ERROR_INVALID_STATE if frames were lost and no keyframe has arrived since
+ */
+uint32_t app_frame_decode(app_frame_decoder_t * p_decoder, uint8_t const * p_frame, uint16_t len,
+                          app_frame_header_t * p_header, int16_t * p_samples, uint16_t max_values);
+
+
+
+/**@brief Function for putting bytes in a raw frame
+ *
+ * @param[in]   stream          Stream id, 0 to APP_FRAME_STREAM_COUNT - 1
+ * @param[out]  p_frame         Buffer for the frame
+ * @param[in]   max_len         Size of the buffer. At most APP_FRAME_MAX_LEN is used
+ * @param[in]   p_data          Bytes to send
+ * @param[in]   len             Number of bytes
+ * @param[out]  p_packed        Bytes put in the frame
+ * @retval      uint16_t        Length of the frame. 0 if there is nothing to send or not even one byte fits
+ */
+uint16_t app_frame_raw_encode(uint8_t stream, uint8_t * p_frame, uint16_t max_len,
+                              uint8_t const * p_data, uint16_t len, uint16_t * p_packed);
+
+
+
+/**@brief Function for getting the bytes of a raw frame
+ *
+ * @param[in]   p_frame         Frame, starting with the length byte
+ * @param[in]   len             Bytes available. Must cover the whole frame
+ * @param[out]  pp_data         Set to the first byte of data in the frame
+ * @param[out]  p_data_len      Number of bytes of data
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_DATA if it is not a raw frame or is cut short
+ */
+uint32_t app_frame_raw_decode(uint8_t const * p_frame, uint16_t len, uint8_t const ** pp_data, uint16_t * p_data_len);
+
+
+#endif /* APP_FRAME_H__ */
+
+/**
+  @}
+*/
@@ -0,0 +1,437 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_gesture.h"
+#include "nrf_error.h"
+#include "app_util.h"
+#include "fds.h"
+#include "crc16.h"
+
+STATIC_ASSERT((sizeof(app_gesture_model_t) % sizeof(uint32_t)) == 0);
+
+static uint32_t         m_record_data[BYTES_TO_WORDS(sizeof(app_gesture_model_t))];    // Copy being written. FDS needs it word aligned until done
+static volatile bool    m_save_pending;
+
+
+
+static int32_t clamp(uint64_t value)
+{
+    return (value > INT32_MAX) ? INT32_MAX : (int32_t)value;
+}
+
+
+
+uint32_t app_gesture_model_check(app_gesture_model_t const * p_model, uint8_t channels)
+{
+    uint8_t features = p_model->signal_count * APP_GESTURE_FEATURE_COUNT;
+
+    if(p_model->version != APP_GESTURE_MODEL_VERSION) return NRF_ERROR_INVALID_DATA;
+    if(p_model->signal_count == 0 || p_model->signal_count > APP_GESTURE_MAX_SIGNALS) return NRF_ERROR_INVALID_DATA;
+    if(p_model->node_count == 0 || p_model->node_count > APP_GESTURE_MAX_NODES) return NRF_ERROR_INVALID_DATA;
+    if(p_model->window < 2 || p_model->window > APP_GESTURE_MAX_WINDOW) return NRF_ERROR_INVALID_DATA;
+    if(p_model->hop == 0 || p_model->votes == 0) return NRF_ERROR_INVALID_DATA;
+
+    for(uint8_t i = 0; i < p_model->signal_count; i++)
+    {
+        if(p_model->signals[i] >= channels) return NRF_ERROR_INVALID_DATA;
+    }
+    for(uint8_t i = 0; i < p_model->node_count; i++)
+    {
+        app_gesture_node_t const * p_node = &p_model->nodes[i];
+
+        if(p_node->feature == APP_GESTURE_LEAF) continue;
+        if(p_node->feature >= features) return NRF_ERROR_INVALID_DATA;
+        // Children after their parent, so every walk ends in a leaf
+        if(p_node->left  <= i || p_node->left  >= p_model->node_count) return NRF_ERROR_INVALID_DATA;
+        if(p_node->right <= i || p_node->right >= p_model->node_count) return NRF_ERROR_INVALID_DATA;
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_gesture_init(app_gesture_t * p_gesture, app_gesture_model_t const * p_model, uint8_t channels)
+{
+    uint32_t err_code;
+
+    err_code = app_gesture_model_check(p_model, channels);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    p_gesture->p_model  = p_model;
+    p_gesture->channels = channels;
+    app_gesture_reset(p_gesture);
+    return NRF_SUCCESS;
+}
+
+
+
+void app_gesture_reset(app_gesture_t * p_gesture)
+{
+    p_gesture->head      = 0;
+    p_gesture->count     = 0;
+    p_gesture->since_hop = 0;
+    p_gesture->candidate = APP_GESTURE_NONE;
+    p_gesture->streak    = 0;
+    p_gesture->holdoff   = 0;
+}
+
+
+
+void app_gesture_features_get(app_gesture_t const * p_gesture, int32_t * p_features)
+{
+    app_gesture_model_t const * p_model = p_gesture->p_model;
+    uint8_t n     = p_model->window;
+    uint8_t first = (p_gesture->head + APP_GESTURE_MAX_WINDOW - n) % APP_GESTURE_MAX_WINDOW; // Oldest sample
+
+    for(uint8_t s = 0; s < p_model->signal_count; s++)
+    {
+        int32_t *   p_out = &p_features[s * APP_GESTURE_FEATURE_COUNT];
+        int32_t     sum = 0;
+        uint64_t    squares = 0;
+        uint64_t    deviations = 0;
+        int32_t     mean;
+        int32_t     peak = 0;
+        int32_t     crossings = 0;
+        int8_t      last_sign = 0;
+        uint8_t     slot;
+
+        slot = first;
+        for(uint8_t i = 0; i < n; i++)
+        {
+            int32_t x = p_gesture->window[slot][s];
+            sum     += x;
+            squares += (uint64_t)(x * x);
+            slot = (slot + 1) % APP_GESTURE_MAX_WINDOW;
+        }
+        mean = sum / n;
+
+        slot = first;
+        for(uint8_t i = 0; i < n; i++)
+        {
+            int32_t d = p_gesture->window[slot][s] - mean;
+            int8_t  sign = (d > 0) - (d < 0);
+
+            deviations += (uint64_t)((int64_t)d * d);
+            if(abs(d) > peak) peak = abs(d);
+            if(sign != 0)
+            {
+                if(last_sign != 0 && sign != last_sign) crossings++;
+                last_sign = sign;
+            }
+            slot = (slot + 1) % APP_GESTURE_MAX_WINDOW;
+        }
+
+        p_out[APP_GESTURE_FEATURE_MEAN]           = mean;
+        p_out[APP_GESTURE_FEATURE_VARIANCE]       = clamp(deviations / n);
+        p_out[APP_GESTURE_FEATURE_ENERGY]         = clamp(squares / n);
+        p_out[APP_GESTURE_FEATURE_ZERO_CROSSINGS] = crossings;
+        p_out[APP_GESTURE_FEATURE_PEAK]           = peak;
+    }
+}
+
+
+
+static uint8_t classify(app_gesture_t const * p_gesture)
+{
+    app_gesture_model_t const * p_model = p_gesture->p_model;
+    int32_t features[APP_GESTURE_MAX_FEATURES];
+    uint8_t i = 0;
+
+    app_gesture_features_get(p_gesture, features);
+
+    // Checked by app_gesture_model_check(): children come after their parent, so this ends in a leaf
+    while(p_model->nodes[i].feature != APP_GESTURE_LEAF)
+    {
+        app_gesture_node_t const * p_node = &p_model->nodes[i];
+        i = (features[p_node->feature] <= p_node->threshold) ? p_node->left : p_node->right;
+    }
+    return p_model->nodes[i].left;
+}
+
+
+
+uint8_t app_gesture_push(app_gesture_t * p_gesture, int16_t const * p_sample)
+{
+    app_gesture_model_t const * p_model = p_gesture->p_model;
+    uint8_t gesture;
+
+    for(uint8_t s = 0; s < p_model->signal_count; s++)
+    {
+        p_gesture->window[p_gesture->head][s] = p_sample[p_model->signals[s]];
+    }
+    p_gesture->head = (p_gesture->head + 1) % APP_GESTURE_MAX_WINDOW;
+    if(p_gesture->count < p_model->window) p_gesture->count++;
+    if(p_gesture->since_hop < UINT8_MAX) p_gesture->since_hop++;
+
+    if(p_gesture->count < p_model->window || p_gesture->since_hop < p_model->hop) return APP_GESTURE_NONE;
+    p_gesture->since_hop = 0;
+
+    gesture = classify(p_gesture);
+    if(gesture == p_gesture->candidate)
+    {
+        if(p_gesture->streak < UINT8_MAX) p_gesture->streak++;
+    }
+    else
+    {
+        p_gesture->candidate = gesture;
+        p_gesture->streak    = 1;
+    }
+
+    if(p_gesture->holdoff > 0)
+    {
+        p_gesture->holdoff--;
+        return APP_GESTURE_NONE;
+    }
+    // Only when the streak reaches votes, so a held fist is reported once
+    if(gesture != APP_GESTURE_NONE && p_gesture->streak == p_model->votes)
+    {
+        p_gesture->holdoff = p_model->holdoff;
+        return gesture;
+    }
+    return APP_GESTURE_NONE;
+}
+
+
+
+uint16_t app_gesture_model_encode(app_gesture_model_t const * p_model, uint8_t * p_image, uint16_t max_len)
+{
+    uint16_t length;
+
+    if(p_model->signal_count > APP_GESTURE_MAX_SIGNALS || p_model->node_count > APP_GESTURE_MAX_NODES) return 0;
+    length = APP_GESTURE_WIRE_HEADER_SIZE + p_model->signal_count + p_model->node_count * APP_GESTURE_WIRE_NODE_SIZE;
+    if(length > max_len) return 0;
+
+    p_image[0] = APP_GESTURE_WIRE_VERSION;
+    p_image[1] = p_model->signal_count;
+    p_image[2] = p_model->node_count;
+    p_image[3] = p_model->window;
+    p_image[4] = p_model->hop;
+    p_image[5] = p_model->votes;
+    p_image[6] = p_model->holdoff;
+    p_image += APP_GESTURE_WIRE_HEADER_SIZE;
+    memcpy(p_image, p_model->signals, p_model->signal_count);
+    p_image += p_model->signal_count;
+
+    for(uint8_t i = 0; i < p_model->node_count; i++)
+    {
+        app_gesture_node_t const * p_node = &p_model->nodes[i];
+
+        p_image[0] = p_node->feature;
+        p_image[1] = p_node->left;
+        p_image[2] = p_node->right;
+        (void)uint32_encode((uint32_t)p_node->threshold, &p_image[3]);
+        p_image += APP_GESTURE_WIRE_NODE_SIZE;
+    }
+    return length;
+}
+
+
+
+uint32_t app_gesture_model_decode(uint8_t const * p_image, uint16_t length, app_gesture_model_t * p_model)
+{
+    uint8_t signal_count;
+    uint8_t node_count;
+
+    if(length < APP_GESTURE_WIRE_HEADER_SIZE || p_image[0] != APP_GESTURE_WIRE_VERSION) return NRF_ERROR_INVALID_DATA;
+    signal_count = p_image[1];
+    node_count   = p_image[2];
+    if(signal_count > APP_GESTURE_MAX_SIGNALS || node_count > APP_GESTURE_MAX_NODES) return NRF_ERROR_INVALID_DATA;
+    if(length != APP_GESTURE_WIRE_HEADER_SIZE + signal_count + node_count * APP_GESTURE_WIRE_NODE_SIZE) return NRF_ERROR_INVALID_DATA;
+
+    memset(p_model, 0, sizeof(app_gesture_model_t));
+    p_model->version      = APP_GESTURE_MODEL_VERSION;
+    p_model->signal_count = signal_count;
+    p_model->node_count   = node_count;
+    p_model->window       = p_image[3];
+    p_model->hop          = p_image[4];
+    p_model->votes        = p_image[5];
+    p_model->holdoff      = p_image[6];
+    p_image += APP_GESTURE_WIRE_HEADER_SIZE;
+    memcpy(p_model->signals, p_image, signal_count);
+    p_image += signal_count;
+
+    for(uint8_t i = 0; i < node_count; i++)
+    {
+        app_gesture_node_t * p_node = &p_model->nodes[i];
+
+        p_node->feature   = p_image[0];
+        p_node->left      = p_image[1];
+        p_node->right     = p_image[2];
+        p_node->threshold = (int32_t)uint32_decode(&p_image[3]);
+        p_image += APP_GESTURE_WIRE_NODE_SIZE;
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+void app_gesture_upload_reset(app_gesture_upload_t * p_upload)
+{
+    p_upload->length = 0;
+}
+
+
+
+uint32_t app_gesture_upload_command(app_gesture_upload_t * p_upload, uint8_t const * p_data, uint16_t length,
+                                    uint8_t channels, app_gesture_model_t * p_model, bool * p_committed)
+{
+    uint8_t const * p_payload = &p_data[2];
+    uint8_t         payload_len;
+    uint16_t        crc;
+    uint32_t        err_code;
+
+    *p_committed = false;
+    if(length == 0 || (p_data[0] != APP_GESTURE_CMD_WRITE && p_data[0] != APP_GESTURE_CMD_COMMIT)) return NRF_ERROR_NOT_SUPPORTED;
+
+    // The frame: command, payload length, payload, CRC16
+    if(length < APP_GESTURE_CMD_OVERHEAD || p_data[1] != length - APP_GESTURE_CMD_OVERHEAD)
+    {
+        app_gesture_upload_reset(p_upload);
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    payload_len = p_data[1];
+    crc = crc16_compute(p_data, 2 + payload_len, NULL);
+    if(crc != uint16_decode(&p_payload[payload_len]))
+    {
+        app_gesture_upload_reset(p_upload);
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    if(p_data[0] == APP_GESTURE_CMD_WRITE)
+    {
+        uint16_t offset;
+        uint16_t size;
+
+        if(payload_len < sizeof(uint16_t))
+        {
+            app_gesture_upload_reset(p_upload);
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+        offset = uint16_decode(p_payload);
+        size   = payload_len - sizeof(uint16_t);
+        if(offset == 0)
+        {
+            app_gesture_upload_reset(p_upload);
+        }
+        if(offset != p_upload->length || size > sizeof(p_upload->image) - offset)
+        {
+            app_gesture_upload_reset(p_upload);
+            return NRF_ERROR_INVALID_STATE;
+        }
+        memcpy(&p_upload->image[offset], &p_payload[sizeof(uint16_t)], size);
+        p_upload->length += size;
+        return NRF_SUCCESS;
+    }
+
+    // Commit
+    err_code = NRF_ERROR_INVALID_DATA;
+    if(payload_len == 2 * sizeof(uint16_t) &&
+       uint16_decode(&p_payload[0]) == p_upload->length &&
+       uint16_decode(&p_payload[2]) == crc16_compute(p_upload->image, p_upload->length, NULL) &&
+       app_gesture_model_decode(p_upload->image, p_upload->length, p_model) == NRF_SUCCESS)
+    {
+        err_code = app_gesture_model_check(p_model, channels);
+        *p_committed = (err_code == NRF_SUCCESS);
+    }
+    app_gesture_upload_reset(p_upload);
+    return err_code;
+}
+
+
+
+static void fds_evt_handler(fds_evt_t const * p_evt)
+{
+    if((p_evt->id == FDS_EVT_WRITE || p_evt->id == FDS_EVT_UPDATE) &&
+       (p_evt->write.file_id == APP_GESTURE_FILE_ID))
+    {
+        m_save_pending = false;
+    }
+}
+
+
+
+uint32_t app_gesture_storage_init(void)
+{
+    return fds_register(fds_evt_handler);
+}
+
+
+
+uint32_t app_gesture_model_load(app_gesture_model_t * p_model)
+{
+    fds_record_desc_t   desc;
+    fds_find_token_t    token;
+    fds_flash_record_t  record;
+
+    memset(&token, 0, sizeof(token));
+    if(fds_record_find(APP_GESTURE_FILE_ID, APP_GESTURE_RECORD_KEY, &desc, &token) != FDS_SUCCESS) return NRF_ERROR_NOT_FOUND;
+    if(fds_record_open(&desc, &record) != FDS_SUCCESS) return NRF_ERROR_NOT_FOUND;
+
+    if(record.p_header->tl.length_words != BYTES_TO_WORDS(sizeof(app_gesture_model_t)) ||
+       ((app_gesture_model_t const *)record.p_data)->version != APP_GESTURE_MODEL_VERSION)
+    {
+        (void)fds_record_close(&desc);
+        return NRF_ERROR_NOT_FOUND;
+    }
+    memcpy(p_model, record.p_data, sizeof(app_gesture_model_t));
+    (void)fds_record_close(&desc);
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_gesture_model_save(app_gesture_model_t const * p_model)
+{
+    uint32_t            err_code;
+    fds_record_desc_t   desc;
+    fds_find_token_t    token;
+    fds_record_chunk_t  chunk;
+    fds_record_t        record;
+
+    if(m_save_pending) return NRF_ERROR_BUSY;
+
+    memcpy(m_record_data, p_model, sizeof(app_gesture_model_t));
+
+    chunk.p_data            = m_record_data;
+    chunk.length_words      = BYTES_TO_WORDS(sizeof(app_gesture_model_t));
+    record.file_id          = APP_GESTURE_FILE_ID;
+    record.key              = APP_GESTURE_RECORD_KEY;
+    record.data.p_chunks    = &chunk;
+    record.data.num_chunks  = 1;
+
+    // Set before the write is queued, as FDS may report it done before the call returns
+    m_save_pending = true;
+
+    memset(&token, 0, sizeof(token));
+    if(fds_record_find(APP_GESTURE_FILE_ID, APP_GESTURE_RECORD_KEY, &desc, &token) == FDS_SUCCESS)
+    {
+        err_code = fds_record_update(&desc, &record);
+    }
+    else
+    {
+        err_code = fds_record_write(&desc, &record);
+    }
+
+    if(err_code != FDS_SUCCESS)
+    {
+        m_save_pending = false;
+    }
+    if(err_code == FDS_ERR_NO_SPACE_IN_FLASH)
+    {
+        (void)fds_gc(); // Try again when garbage collection is done
+        return NRF_ERROR_NO_MEM;
+    }
+    return err_code;
+}
+
+
+/**
+  @}
+*/
@@ -0,0 +1,284 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_GESTURE_H__
+#define APP_GESTURE_H__
+
+/* Gesture recognition on the aligned IMU and finger samples.
+ *
+ * The samples pass a sliding window of model.window samples. Every model.hop samples five
+ * features are worked out for each signal the model uses:
+ *   mean, variance, energy (mean of the squares), zero crossings around the mean and peak
+ *   (largest distance from the mean)
+ * The feature vector holds them signal after signal, so feature f of signal s is found at
+ * s * APP_GESTURE_FEATURE_COUNT + f.
+ *
+ * A decision tree then picks a gesture. Each node compares one feature with a threshold and
+ * goes left when the feature is less or equal. A gesture is reported when model.votes
+ * windows in a row agree on it, and not again within model.holdoff windows, so one swipe
+ * gives one event.
+ *
+ * The model is plain data. It is trained on a PC from recorded samples with the same
+ * features, and stored in one FDS record, so gestures can be retrained without building
+ * new firmware.
+ *
+ * tools/gesture_model.py trains a model and uploads it as an image in a packed wire format,
+ * which does not depend on the layout of app_gesture_model_t. Little endian:
+ *   uint8_t    format version, APP_GESTURE_WIRE_VERSION
+ *   uint8_t    signal_count, node_count, window, hop, votes, holdoff
+ *   uint8_t    signals[signal_count]
+ *   node_count nodes of uint8_t feature, left, right and int32_t threshold
+ *
+ * The image is written in pieces with framed commands:
+ *   uint8_t command, uint8_t payload length, payload, uint16_t CRC16 of command, length and payload
+ * where the payload of
+ *   APP_GESTURE_CMD_WRITE      is a uint16_t offset and image bytes. In order, offset 0 starts over
+ *   APP_GESTURE_CMD_COMMIT     is the uint16_t image length and the uint16_t CRC16 of the image
+ * The CRC16 is the CCITT one of crc16_compute(), started at 0xFFFF.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef APP_GESTURE_MAX_SIGNALS
+#define APP_GESTURE_MAX_SIGNALS     8       // Signals a model can use
+#endif
+#ifndef APP_GESTURE_MAX_WINDOW
+#define APP_GESTURE_MAX_WINDOW      48      // Samples
+#endif
+#ifndef APP_GESTURE_MAX_NODES
+#define APP_GESTURE_MAX_NODES       48
+#endif
+
+#define APP_GESTURE_FEATURE_COUNT   5
+#define APP_GESTURE_MAX_FEATURES    (APP_GESTURE_MAX_SIGNALS * APP_GESTURE_FEATURE_COUNT)
+#define APP_GESTURE_LEAF            0xFF    // node.feature of a leaf. node.left holds the gesture
+#define APP_GESTURE_MODEL_VERSION   1
+#define APP_GESTURE_FILE_ID         0x4753  // Below the peer manager range from 0xC000
+#define APP_GESTURE_RECORD_KEY      0x0001
+
+#define APP_GESTURE_WIRE_VERSION        1
+#define APP_GESTURE_WIRE_HEADER_SIZE    7
+#define APP_GESTURE_WIRE_NODE_SIZE      7
+#define APP_GESTURE_WIRE_MAX_SIZE       (APP_GESTURE_WIRE_HEADER_SIZE + APP_GESTURE_MAX_SIGNALS + \
+                                         APP_GESTURE_MAX_NODES * APP_GESTURE_WIRE_NODE_SIZE)
+#define APP_GESTURE_CMD_WRITE           0xA7
+#define APP_GESTURE_CMD_COMMIT          0xA8
+#define APP_GESTURE_CMD_OVERHEAD        4       // Command, payload length and CRC16
+
+#define APP_GESTURE_FEATURE_INDEX(signal, feature)  ((signal) * APP_GESTURE_FEATURE_COUNT + (feature))
+
+/**@brief Node initializers, for models built into the firmware */
+#define APP_GESTURE_NODE_SPLIT(signal, feature, threshold, left, right) \
+    {APP_GESTURE_FEATURE_INDEX(signal, feature), (left), (right), 0, (threshold)}
+#define APP_GESTURE_NODE_LEAF(gesture) \
+    {APP_GESTURE_LEAF, (gesture), 0, 0, 0}
+
+/**@brief Features of a signal, in the order they have in the feature vector */
+typedef enum
+{
+    APP_GESTURE_FEATURE_MEAN,
+    APP_GESTURE_FEATURE_VARIANCE,
+    APP_GESTURE_FEATURE_ENERGY,
+    APP_GESTURE_FEATURE_ZERO_CROSSINGS,
+    APP_GESTURE_FEATURE_PEAK
+}app_gesture_feature_t;
+
+/**@brief Gestures. A model can use other ids, up to 254 */
+typedef enum
+{
+    APP_GESTURE_NONE,
+    APP_GESTURE_SWIPE_LEFT,
+    APP_GESTURE_SWIPE_RIGHT,
+    APP_GESTURE_SWIPE_UP,
+    APP_GESTURE_SWIPE_DOWN,
+    APP_GESTURE_TAP,
+    APP_GESTURE_ROTATE_CW,
+    APP_GESTURE_ROTATE_CCW,
+    APP_GESTURE_GRAB,
+    APP_GESTURE_RELEASE
+}app_gesture_id_t;
+
+/**@brief Decision tree node */
+typedef struct
+{
+    uint8_t     feature;        // Index in the feature vector, or APP_GESTURE_LEAF
+    uint8_t     left;           // Node when the feature is <= threshold. The gesture of a leaf
+    uint8_t     right;          // Node when the feature is > threshold
+    uint8_t     reserved;
+    int32_t     threshold;
+}app_gesture_node_t;
+
+/**@brief Model, as stored in flash. Little endian */
+typedef struct
+{
+    uint16_t            version;                            // APP_GESTURE_MODEL_VERSION
+    uint8_t             signal_count;
+    uint8_t             node_count;                         // Node 0 is the root
+    uint8_t             signals[APP_GESTURE_MAX_SIGNALS];   // Channel of each signal in the input samples
+    uint8_t             window;                             // Samples the features are worked out over
+    uint8_t             hop;                                // Samples between two classifications
+    uint8_t             votes;                              // Classifications in a row that must agree
+    uint8_t             holdoff;                            // Classifications after an event without a new one
+    app_gesture_node_t  nodes[APP_GESTURE_MAX_NODES];
+}app_gesture_model_t;
+
+/**@brief Recognizer state */
+typedef struct
+{
+    app_gesture_model_t const * p_model;
+    uint8_t                     channels;                   // Channels per input sample
+    uint8_t                     head;                       // Next slot in window
+    uint8_t                     count;                      // Samples in window
+    uint8_t                     since_hop;
+    uint8_t                     candidate;                  // Gesture of the last classifications
+    uint8_t                     streak;                     // Classifications in a row that gave candidate
+    uint8_t                     holdoff;                    // Classifications left before a new event
+    int16_t                     window[APP_GESTURE_MAX_WINDOW][APP_GESTURE_MAX_SIGNALS];
+}app_gesture_t;
+
+/**@brief Model upload in progress */
+typedef struct
+{
+    uint16_t                    length;                     // Image bytes received, in order
+    uint8_t                     image[APP_GESTURE_WIRE_MAX_SIZE];
+}app_gesture_upload_t;
+
+
+
+/**@brief Function for checking that a model is complete and its tree can not run off
+ *
+ * @param[in]   p_model         Model
+ * @param[in]   channels        Channels per input sample
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_DATA if the model can not be used
+ */
+uint32_t app_gesture_model_check(app_gesture_model_t const * p_model, uint8_t channels);
+
+
+
+/**@brief Function for initiating a recognizer
+ *
+ * @param[out]  p_gesture       Recognizer state
+ * @param[in]   p_model         Model. Must stay valid while the recognizer is used
+ * @param[in]   channels        Channels per input sample
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_DATA if the model can not be used
+ */
+uint32_t app_gesture_init(app_gesture_t * p_gesture, app_gesture_model_t const * p_model, uint8_t channels);
+
+
+
+/**@brief Function for emptying the window, e.g. after a gap in the samples
+ *
+ * @param[in]   p_gesture       Recognizer state
+ */
+void app_gesture_reset(app_gesture_t * p_gesture);
+
+
+
+/**@brief Function for adding a sample
+ *
+ * @param[in]   p_gesture       Recognizer state
+ * @param[in]   p_sample        Sample of p_gesture->channels values
+ * @retval      uint8_t         Gesture recognized with this sample. APP_GESTURE_NONE most of the time
+ */
+uint8_t app_gesture_push(app_gesture_t * p_gesture, int16_t const * p_sample);
+
+
+
+/**@brief Function for working out the features of the window, e.g. to record training data on the glove
+ *
+ * @param[in]   p_gesture       Recognizer state
+ * @param[out]  p_features      signal_count * APP_GESTURE_FEATURE_COUNT features
+ */
+void app_gesture_features_get(app_gesture_t const * p_gesture, int32_t * p_features);
+
+
+
+/**@brief Function for packing a model in the wire format
+ *
+ * @param[in]   p_model         Model
+ * @param[out]  p_image         Image
+ * @param[in]   max_len         Size of p_image
+ * @retval      uint16_t        Length of the image. 0 if it does not fit or the model is too large
+ */
+uint16_t app_gesture_model_encode(app_gesture_model_t const * p_model, uint8_t * p_image, uint16_t max_len);
+
+
+
+/**@brief Function for unpacking a model from the wire format
+ *
+ * The tree is not checked, see app_gesture_model_check().
+ *
+ * @param[in]   p_image         Image
+ * @param[in]   length          Length of the image
+ * @param[out]  p_model         Model
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_DATA if the version or the length is wrong
+ */
+uint32_t app_gesture_model_decode(uint8_t const * p_image, uint16_t length, app_gesture_model_t * p_model);
+
+
+
+/**@brief Function for dropping an upload, e.g. when the link goes down
+ *
+ * @param[out]  p_upload        Upload
+ */
+void app_gesture_upload_reset(app_gesture_upload_t * p_upload);
+
+
+
+/**@brief Function for taking an upload command
+ *
+ * A command that is not framed right, or writes out of order, drops the upload, and the host
+ * starts over from offset 0. So does a commit, whether the model is taken or not.
+ *
+ * @param[in]   p_upload        Upload
+ * @param[in]   p_data          Command
+ * @param[in]   length          Length of the command
+ * @param[in]   channels        Channels per input sample, for app_gesture_model_check()
+ * @param[out]  p_model         The uploaded model. Only valid when p_committed is set
+ * @param[out]  p_committed     Whether a commit was taken
+ * @retval      uint32_t        Error code. NRF_ERROR_NOT_SUPPORTED if p_data is not an upload command,
+ *                              NRF_ERROR_INVALID_LENGTH or NRF_ERROR_INVALID_DATA if it is not framed
+ *                              right, NRF_ERROR_INVALID_STATE for a write out of order,
+ *                              NRF_ERROR_INVALID_DATA for a commit with a bad image or model
+ */
+uint32_t app_gesture_upload_command(app_gesture_upload_t * p_upload, uint8_t const * p_data, uint16_t length,
+                                    uint8_t channels, app_gesture_model_t * p_model, bool * p_committed);
+
+
+
+/**@brief Function for registering with FDS. Must be called before fds_init(), i.e. before pm_init()
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_gesture_storage_init(void);
+
+
+
+/**@brief Function for reading the stored model
+ *
+ * @param[out]  p_model         Model
+ * @retval      uint32_t        Error code. NRF_ERROR_NOT_FOUND if no model of this version is stored
+ */
+uint32_t app_gesture_model_load(app_gesture_model_t * p_model);
+
+
+
+/**@brief Function for storing a model
+ *
+ * The model is copied, and written to flash in the background.
+ *
+ * @param[in]   p_model         Model
+ * @retval      uint32_t        Error code. NRF_ERROR_BUSY if the last model is still being written
+ */
+uint32_t app_gesture_model_save(app_gesture_model_t const * p_model);
+
+
+#endif /* APP_GESTURE_H__ */
+
+/**
+  @}
+*/
@@ -0,0 +1,196 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_hid_map.h"
+#include "nrf_error.h"
+
+#define Q14_ONE         16384
+#define MOVE_LIMIT      ((int32_t)INT16_MAX * Q14_ONE)     // Motion kept while the link is busy
+
+
+
+/**@brief Function for taking a Q28 product to Q14, rounded so slow turns are not biased towards zero */
+static int32_t q28_to_q14(int32_t value)
+{
+    return (value + ((value < 0) ? -(Q14_ONE / 2) : (Q14_ONE / 2))) / Q14_ONE;
+}
+
+
+
+static int32_t clamp(int32_t value, int32_t limit)
+{
+    if(value > limit) return limit;
+    if(value < -limit) return -limit;
+    return value;
+}
+
+
+
+uint32_t app_hid_map_init(app_hid_map_t * p_map, app_hid_map_config_t const * p_config)
+{
+    if(p_config->axis_x > 2 || p_config->axis_y > 2) return NRF_ERROR_INVALID_PARAM;
+
+    p_map->config = *p_config;
+    app_hid_map_reset(p_map);
+    return NRF_SUCCESS;
+}
+
+
+
+void app_hid_map_reset(app_hid_map_t * p_map)
+{
+    p_map->last_valid = false;
+    p_map->move_x     = 0;
+    p_map->move_y     = 0;
+    p_map->stick_x    = 0;
+    p_map->stick_y    = 0;
+    p_map->pressed    = 0;
+    p_map->held       = 0;
+    p_map->clicks     = 0;
+    memset(&p_map->sent, 0, sizeof(p_map->sent));
+}
+
+
+
+/**@brief Function for adding the rotation about one axis to the mouse motion */
+static void move_add(int32_t * p_move, int32_t angle, int16_t gain, uint16_t deadzone)
+{
+    if(abs(angle) <= deadzone) return;
+    *p_move = clamp(*p_move + angle * gain, MOVE_LIMIT);
+}
+
+
+
+/**@brief Function for the stick position from the gravity along one axis */
+static int16_t stick_get(int32_t gravity, int16_t gain, uint16_t deadzone)
+{
+    if(abs(gravity) <= deadzone) return 0;
+    return (int16_t)clamp((gravity * gain) / Q14_ONE, APP_HID_MAP_STICK_MAX);
+}
+
+
+
+void app_hid_map_orientation_add(app_hid_map_t * p_map, app_mpu_fusion_quat_t const * p_quat)
+{
+    app_hid_map_config_t const * p_config = &p_map->config;
+    int32_t w = p_quat->w;
+    int32_t x = p_quat->x;
+    int32_t y = p_quat->y;
+    int32_t z = p_quat->z;
+
+    if(p_config->mode == APP_HID_MAP_GAMEPAD)
+    {
+        int32_t gravity[3];
+
+        // Earth z axis in the glove frame, the last row of the rotation matrix. Q14
+        gravity[0] = q28_to_q14(2 * (x * z - w * y));
+        gravity[1] = q28_to_q14(2 * (y * z + w * x));
+        gravity[2] = q28_to_q14(w * w - x * x - y * y + z * z);
+        p_map->stick_x = stick_get(gravity[p_config->axis_x], p_config->gain_x, p_config->deadzone);
+        p_map->stick_y = stick_get(gravity[p_config->axis_y], p_config->gain_y, p_config->deadzone);
+        return;
+    }
+
+    if(p_map->last_valid)
+    {
+        int32_t lw = p_map->last.w;
+        int32_t lx = p_map->last.x;
+        int32_t ly = p_map->last.y;
+        int32_t lz = p_map->last.z;
+        int32_t angle[3];
+        int32_t sign;
+
+        // Rotation since the last update in the glove frame, conj(last) * quat. Q14
+        sign     = ((lw * w + lx * x + ly * y + lz * z) < 0) ? -1 : 1; // Same rotation the short way
+        angle[0] = sign * q28_to_q14(2 * (lw * x - lx * w - ly * z + lz * y));  // Twice the vector part is the angle for small rotations
+        angle[1] = sign * q28_to_q14(2 * (lw * y + lx * z - ly * w - lz * x));
+        angle[2] = sign * q28_to_q14(2 * (lw * z - lx * y + ly * x - lz * w));
+        move_add(&p_map->move_x, angle[p_config->axis_x], p_config->gain_x, p_config->deadzone);
+        move_add(&p_map->move_y, angle[p_config->axis_y], p_config->gain_y, p_config->deadzone);
+    }
+    p_map->last       = *p_quat;
+    p_map->last_valid = true;
+}
+
+
+
+void app_hid_map_fingers_set(app_hid_map_t * p_map, int16_t const * p_bend, uint8_t count)
+{
+    app_hid_map_config_t const * p_config = &p_map->config;
+    uint8_t held = 0;
+
+    for(uint8_t i = 0; i < count && i < APP_HID_MAP_MAX_FINGERS; i++)
+    {
+        uint8_t mask = 1 << i;
+
+        // Hysteresis, so a finger held at the threshold does not chatter
+        if(p_bend[i] >= p_config->press_bend)
+        {
+            p_map->pressed |= mask;
+        }
+        else if(p_bend[i] < p_config->release_bend)
+        {
+            p_map->pressed &= ~mask;
+        }
+        if(p_map->pressed & mask)
+        {
+            held |= p_config->finger_buttons[i];
+        }
+    }
+    p_map->held = held;
+}
+
+
+
+void app_hid_map_gesture_add(app_hid_map_t * p_map, uint8_t gesture)
+{
+    if(gesture < APP_HID_MAP_MAX_GESTURES)
+    {
+        p_map->clicks |= p_map->config.gesture_buttons[gesture] & ~p_map->held; // A button held by a finger is down already
+    }
+}
+
+
+
+bool app_hid_map_report_get(app_hid_map_t const * p_map, int16_t max_move, app_hid_map_report_t * p_report)
+{
+    // A click on a button the last report has down waits for the release to be sent, so two clicks stay two
+    p_report->buttons = p_map->held | (p_map->clicks & ~p_map->sent.buttons);
+
+    if(p_map->config.mode == APP_HID_MAP_GAMEPAD)
+    {
+        p_report->x = p_map->stick_x;
+        p_report->y = p_map->stick_y;
+        return (p_report->buttons != p_map->sent.buttons) ||
+               (p_report->x != p_map->sent.x) || (p_report->y != p_map->sent.y);
+    }
+
+    // Whole counts only. The fraction stays for the next report
+    p_report->x = (int16_t)clamp(p_map->move_x / Q14_ONE, max_move);
+    p_report->y = (int16_t)clamp(p_map->move_y / Q14_ONE, max_move);
+    return (p_report->buttons != p_map->sent.buttons) || (p_report->x != 0) || (p_report->y != 0);
+}
+
+
+
+void app_hid_map_report_sent(app_hid_map_t * p_map, app_hid_map_report_t const * p_report)
+{
+    if(p_map->config.mode == APP_HID_MAP_MOUSE)
+    {
+        p_map->move_x -= (int32_t)p_report->x * Q14_ONE;
+        p_map->move_y -= (int32_t)p_report->y * Q14_ONE;
+    }
+    p_map->clicks &= ~p_report->buttons; // Released in the next report
+    p_map->sent    = *p_report;
+}
+
+/**
+  @}
+*/
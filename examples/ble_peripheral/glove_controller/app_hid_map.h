@@ -0,0 +1,161 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_HID_MAP_H__
+#define APP_HID_MAP_H__
+
+/* Mapping of the glove motion to HID mouse and gamepad reports.
+ *
+ * Mouse: the rotation between two orientation updates moves the cursor, so turning the hand
+ * left and right moves it sideways and tilting it up and down moves it up and down. The
+ * motion is kept in fixed point, so slow turns that move less than one count per update
+ * still add up.
+ * Gamepad: the tilt of the hand deflects the stick, from the direction of gravity in the
+ * glove frame.
+ * Both: bending a finger past press_bend holds its buttons until it is straightened past
+ * release_bend. A recognized gesture clicks its buttons, pressed in one report and released
+ * in the next. Another click of a button that is still down is pressed after the release.
+ *
+ * The reports are coalesced. The inputs only update the state, and app_hid_map_report_get()
+ * makes one report of all that changed since the last report sent. Call it when the link can
+ * take a report, e.g. once per connection event, and call app_hid_map_report_sent() when the
+ * report was queued. No report waits in a queue while newer motion is known, and no motion is
+ * lost when the link is busy.
+ *
+ * The module has no hardware dependencies, so it can be run on a PC.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "app_mpu_fusion.h"
+
+#ifndef APP_HID_MAP_MAX_FINGERS
+#define APP_HID_MAP_MAX_FINGERS     5
+#endif
+#ifndef APP_HID_MAP_MAX_GESTURES
+#define APP_HID_MAP_MAX_GESTURES    16      // Gesture ids that can click buttons
+#endif
+
+#define APP_HID_MAP_STICK_MAX       127     // Gamepad stick range is +-APP_HID_MAP_STICK_MAX
+
+/**@brief Report to make */
+typedef enum
+{
+    APP_HID_MAP_MOUSE,                  // Relative motion from turning the hand
+    APP_HID_MAP_GAMEPAD                 // Absolute stick from tilting the hand
+}app_hid_map_mode_t;
+
+/**@brief Mapping configuration structure */
+typedef struct
+{
+    app_hid_map_mode_t  mode;
+    uint8_t             axis_x;                                     // Glove axis, 0 to 2 for x to z. Mouse: turning about it moves the cursor sideways. Gamepad: tilting it deflects the stick sideways
+    uint8_t             axis_y;                                     // Same for up and down
+    int16_t             gain_x;                                     // Mouse: counts per radian. Gamepad: stick deflection at 90 degrees tilt. Negative to flip
+    int16_t             gain_y;
+    uint16_t            deadzone;                                   // Mouse: Q14 radians per update ignored, for tremor. Gamepad: Q14 sine of the tilt ignored
+    int16_t             press_bend;                                 // Q15 finger bend from app_flex that presses its buttons
+    int16_t             release_bend;                               // Q15 finger bend that releases them. Below press_bend
+    uint8_t             finger_buttons[APP_HID_MAP_MAX_FINGERS];    // Buttons held by each finger. Bit 0 is button 1
+    uint8_t             gesture_buttons[APP_HID_MAP_MAX_GESTURES];  // Buttons clicked by each app_gesture_id_t
+}app_hid_map_config_t;
+
+/**@brief Report contents */
+typedef struct
+{
+    uint8_t     buttons;        // Bit 0 is button 1
+    int16_t     x;              // Mouse: counts moved. Gamepad: stick position
+    int16_t     y;
+}app_hid_map_report_t;
+
+/**@brief Mapping state */
+typedef struct
+{
+    app_hid_map_config_t    config;
+    app_mpu_fusion_quat_t   last;           // Orientation at the last update
+    bool                    last_valid;
+    int32_t                 move_x;         // Mouse: Q14 counts not sent yet
+    int32_t                 move_y;
+    int16_t                 stick_x;        // Gamepad: stick position
+    int16_t                 stick_y;
+    uint8_t                 pressed;        // Bit per finger past press_bend
+    uint8_t                 held;           // Buttons held by the fingers
+    uint8_t                 clicks;         // Buttons clicked by gestures, not sent yet
+    app_hid_map_report_t    sent;           // Last report sent
+}app_hid_map_t;
+
+
+
+/**@brief Function for initiating the mapping
+ *
+ * @param[out]  p_map           Mapping state
+ * @param[in]   p_config        Pointer to configuration structure
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_PARAM if an axis is out of range
+ */
+uint32_t app_hid_map_init(app_hid_map_t * p_map, app_hid_map_config_t const * p_config);
+
+
+
+/**@brief Function for forgetting the motion and buttons, e.g. on a new connection or after a gap in the samples
+ *
+ * @param[in]   p_map           Mapping state
+ */
+void app_hid_map_reset(app_hid_map_t * p_map);
+
+
+
+/**@brief Function for adding an orientation from app_mpu_fusion
+ *
+ * @param[in]   p_map           Mapping state
+ * @param[in]   p_quat          Orientation
+ */
+void app_hid_map_orientation_add(app_hid_map_t * p_map, app_mpu_fusion_quat_t const * p_quat);
+
+
+
+/**@brief Function for adding the finger bends
+ *
+ * @param[in]   p_map           Mapping state
+ * @param[in]   p_bend          Q15 bend of each finger, from app_flex_bend_get()
+ * @param[in]   count           Number of fingers
+ */
+void app_hid_map_fingers_set(app_hid_map_t * p_map, int16_t const * p_bend, uint8_t count);
+
+
+
+/**@brief Function for adding a recognized gesture
+ *
+ * @param[in]   p_map           Mapping state
+ * @param[in]   gesture         app_gesture_id_t
+ */
+void app_hid_map_gesture_add(app_hid_map_t * p_map, uint8_t gesture);
+
+
+
+/**@brief Function for making a report of all that changed since the last report sent
+ *
+ * @param[in]   p_map           Mapping state
+ * @param[in]   max_move        Largest mouse motion a report can hold. The rest is left for the next report
+ * @param[out]  p_report        Report
+ * @retval      bool            false if there is nothing new to report
+ */
+bool app_hid_map_report_get(app_hid_map_t const * p_map, int16_t max_move, app_hid_map_report_t * p_report);
+
+
+
+/**@brief Function for marking a report from app_hid_map_report_get() as sent
+ *
+ * @param[in]   p_map           Mapping state
+ * @param[in]   p_report        Report that was queued
+ */
+void app_hid_map_report_sent(app_hid_map_t * p_map, app_hid_map_report_t const * p_report);
+
+
+#endif /* APP_HID_MAP_H__ */
+
+/**
+  @}
+*/
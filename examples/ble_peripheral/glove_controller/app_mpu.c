@@ -9,13 +9,17 @@
 #include <string.h>
 #include "app_mpu.h"
 #include "nrf_gpio.h"
+#include "nrf_delay.h"
 #include "nrf_drv_mpu.h"
 #include "nrf_error.h"
+#include "app_util.h"
 #include "sdk_config.h"
 
+STATIC_ASSERT(sizeof(imu_sample_t) == MPU_SAMPLE_SIZE);
 
 
-uint32_t mpu_config(mpu_config_t * config)
+
+uint32_t app_mpu_config(app_mpu_config_t * config)
 {
     uint8_t *data;
     data = (uint8_t*)config;
@@ -24,7 +28,7 @@ uint32_t mpu_config(mpu_config_t * config)
 
 
 
-uint32_t mpu_int_cfg_pin(mpu_int_pin_cfg_t *cfg)
+uint32_t app_mpu_int_cfg_pin(app_mpu_int_pin_cfg_t *cfg)
 {
     uint8_t *data;
     data = (uint8_t*)cfg;
@@ -34,7 +38,7 @@ uint32_t mpu_int_cfg_pin(mpu_int_pin_cfg_t *cfg)
 
 
 
-uint32_t mpu_int_enable(mpu_int_enable_t *cfg)
+uint32_t app_mpu_int_enable(app_mpu_int_enable_t *cfg)
 {
     uint8_t *data;
     data = (uint8_t*)cfg;
@@ -43,7 +47,7 @@ uint32_t mpu_int_enable(mpu_int_enable_t *cfg)
 
 
 
-uint32_t mpu_init(void)
+uint32_t app_mpu_init(void)
 {
     uint32_t err_code;
 	
@@ -64,7 +68,21 @@ uint32_t mpu_init(void)
 
 
 
-uint32_t mpu_read_accel(accel_values_t * accel_values)
+/**@brief Function for turning big endian register values into a value struct.
+ * The value structs are in reverse register order, so reversing the bytes does both jobs.
+ */
+static void reorganize_sensor_values(uint8_t * p_values, uint8_t const * p_raw_values, uint8_t length)
+{
+    for(uint8_t i = 0; i<length; i++)
+    {
+        *p_values = p_raw_values[length-1-i];
+        p_values++;
+    }
+}
+
+
+
+uint32_t app_mpu_read_accel(accel_values_t * accel_values)
 {
     uint32_t err_code;
     uint8_t raw_values[6];
@@ -72,19 +90,13 @@ uint32_t mpu_read_accel(accel_values_t * accel_values)
     if(err_code != NRF_SUCCESS) return err_code;
 
     // Reorganize read sensor values and put them into value struct
-    uint8_t *data;
-    data = (uint8_t*)accel_values;
-    for(uint8_t i = 0; i<6; i++)
-    {
-        *data = raw_values[5-i];
-        data++;
-    }
+    reorganize_sensor_values((uint8_t*)accel_values, raw_values, 6);
     return NRF_SUCCESS;
 }
 
 
 
-uint32_t mpu_read_gyro(gyro_values_t * gyro_values)
+uint32_t app_mpu_read_gyro(gyro_values_t * gyro_values)
 {
     uint32_t err_code;
     uint8_t raw_values[6];
@@ -92,19 +104,104 @@ uint32_t mpu_read_gyro(gyro_values_t * gyro_values)
     if(err_code != NRF_SUCCESS) return err_code;
 
     // Reorganize read sensor values and put them into value struct
-    uint8_t *data;
-    data = (uint8_t*)gyro_values;
-    for(uint8_t i = 0; i<6; i++)
+    reorganize_sensor_values((uint8_t*)gyro_values, raw_values, 6);
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_mpu_read_all(imu_sample_t * p_sample)
+{
+    uint32_t err_code;
+    uint8_t raw_values[MPU_SAMPLE_SIZE];
+    // Accelerometer, temperature and gyroscope registers are contiguous, so one burst gets them all
+    err_code = nrf_drv_mpu_read_registers(MPU_REG_ACCEL_XOUT_H, raw_values, MPU_SAMPLE_SIZE);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    reorganize_sensor_values((uint8_t*)p_sample, raw_values, MPU_SAMPLE_SIZE);
+    return NRF_SUCCESS;
+}
+
+
+
+/**@brief State of a scheduled sensor read. */
+typedef struct
+{
+    uint8_t                 raw_values[MPU_SAMPLE_SIZE];
+    uint8_t                 length;
+    uint8_t               * p_values;
+    app_mpu_evt_handler_t   evt_handler;
+    void                  * p_context;
+    volatile bool           busy;
+}app_mpu_async_read_t;
+
+static app_mpu_async_read_t m_accel_read;
+static app_mpu_async_read_t m_gyro_read;
+static app_mpu_async_read_t m_all_read;
+
+
+static void async_read_handler(uint32_t result, void * p_context)
+{
+    app_mpu_async_read_t * p_read = (app_mpu_async_read_t *)p_context;
+
+    if(result == NRF_SUCCESS)
     {
-        *data = raw_values[5-i];
-        data++;
+        reorganize_sensor_values(p_read->p_values, p_read->raw_values, p_read->length);
+    }
+    p_read->busy = false;
+
+    if(p_read->evt_handler != NULL)
+    {
+        p_read->evt_handler(result, p_read->p_context);
     }
-    return NRF_SUCCESS;
 }
 
 
+static uint32_t async_read_start(app_mpu_async_read_t * p_read, uint8_t reg, uint8_t * p_values, uint8_t length,
+                                 app_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    uint32_t err_code;
+
+    if(p_read->busy) return NRF_ERROR_BUSY;
+
+    p_read->length      = length;
+    p_read->p_values    = p_values;
+    p_read->evt_handler = evt_handler;
+    p_read->p_context   = p_context;
+    p_read->busy        = true;
 
-uint32_t mpu_read_temp(temp_value_t * temperature)
+    err_code = nrf_drv_mpu_read_registers_async(reg, p_read->raw_values, length, async_read_handler, p_read);
+    if(err_code != NRF_SUCCESS)
+    {
+        p_read->busy = false;
+    }
+    return err_code;
+}
+
+
+
+uint32_t app_mpu_read_accel_async(accel_values_t * accel_values, app_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return async_read_start(&m_accel_read, MPU_REG_ACCEL_XOUT_H, (uint8_t*)accel_values, 6, evt_handler, p_context);
+}
+
+
+
+uint32_t app_mpu_read_gyro_async(gyro_values_t * gyro_values, app_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return async_read_start(&m_gyro_read, MPU_REG_GYRO_XOUT_H, (uint8_t*)gyro_values, 6, evt_handler, p_context);
+}
+
+
+
+uint32_t app_mpu_read_all_async(imu_sample_t * p_sample, app_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return async_read_start(&m_all_read, MPU_REG_ACCEL_XOUT_H, (uint8_t*)p_sample, MPU_SAMPLE_SIZE, evt_handler, p_context);
+}
+
+
+
+uint32_t app_mpu_read_temp(temp_value_t * temperature)
 {
     uint32_t err_code;
     uint8_t raw_values[2];
@@ -118,15 +215,286 @@ uint32_t mpu_read_temp(temp_value_t * temperature)
 
 
 
-uint32_t mpu_read_int_source(uint8_t * int_source)
+uint32_t app_mpu_read_int_source(uint8_t * int_source)
 {
     return nrf_drv_mpu_read_registers(MPU_REG_INT_STATUS, int_source, 1);
 }
 
 
+/*********************************************************************************************************************
+ * FUNCTIONS FOR FIFO STREAMING.
+ */
+
+#define MPU_USER_CTRL_FIFO_EN       0x40 // Enables FIFO operation mode.
+#define MPU_USER_CTRL_FIFO_RST      0x04 // Resets the FIFO buffer. Cleared automatically.
+#define MPU_FIFO_COUNT_MASK         0x1FFF
+
+static uint8_t m_user_ctrl;         // Last value written to MPU_REG_USER_CTRL
+static uint8_t m_fifo_frame_size;   // Bytes pushed to the FIFO pr sample with the current FIFO_EN setting
+static app_mpu_fifo_en_t m_fifo_en; // Current FIFO_EN setting. Decides which parts of imu_sample_t a frame holds
+
+
+uint32_t app_mpu_fifo_enable(app_mpu_fifo_en_t * cfg)
+{
+    uint32_t err_code;
+    uint8_t fifo_en = *(uint8_t*)cfg;
+
+    // Stop the FIFO while it is reconfigured, so it does not fill up with frames of the old format
+    m_user_ctrl &= ~MPU_USER_CTRL_FIFO_EN;
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, m_user_ctrl | MPU_USER_CTRL_FIFO_RST);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_FIFO_EN, fifo_en);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    m_fifo_en = *cfg;
+    m_fifo_frame_size = (cfg->accel * 6) + (cfg->temp * 2) + ((cfg->gyro_x + cfg->gyro_y + cfg->gyro_z) * 2);
+
+    m_user_ctrl |= MPU_USER_CTRL_FIFO_EN;
+    return nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, m_user_ctrl | MPU_USER_CTRL_FIFO_RST);
+}
+
+
+
+uint32_t app_mpu_fifo_disable(void)
+{
+    uint32_t err_code;
+
+    m_user_ctrl &= ~MPU_USER_CTRL_FIFO_EN;
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, m_user_ctrl | MPU_USER_CTRL_FIFO_RST);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    m_fifo_frame_size = 0;
+    memset(&m_fifo_en, 0, sizeof(m_fifo_en));
+    return nrf_drv_mpu_write_single_register(MPU_REG_FIFO_EN, 0);
+}
+
+
+
+uint32_t app_mpu_fifo_reset(void)
+{
+    return nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, m_user_ctrl | MPU_USER_CTRL_FIFO_RST);
+}
+
+
+
+uint32_t app_mpu_fifo_count_get(uint16_t * p_count)
+{
+    uint32_t err_code;
+    uint8_t raw_values[2];
+    err_code = nrf_drv_mpu_read_registers(MPU_REG_FIFO_COUNTH, raw_values, 2);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    *p_count = ((raw_values[0] << 8) | raw_values[1]) & MPU_FIFO_COUNT_MASK;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_mpu_fifo_read(uint8_t * p_data, uint16_t length)
+{
+    uint32_t err_code;
+
+    while(length > 0)
+    {
+        uint16_t chunk = (length > MPU_MAX_READ_LENGTH) ? MPU_MAX_READ_LENGTH : length;
+
+        // FIFO_R_W does not auto increment, so a burst read keeps popping bytes from the FIFO
+        err_code = nrf_drv_mpu_read_registers(MPU_REG_FIFO_R_W, p_data, chunk);
+        if(err_code != NRF_SUCCESS) return err_code;
+
+        p_data += chunk;
+        length -= chunk;
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+/**@brief State of a scheduled FIFO drain. */
+typedef struct
+{
+    uint8_t                 count_raw[2];
+    imu_sample_t          * p_samples;
+    uint16_t                max_samples;
+    uint16_t                frames_left;    // Frames counted in the FIFO that are not read yet
+    uint16_t                frames_read;
+    uint16_t                frames_in_transfer;
+    uint16_t              * p_num_samples;
+    app_mpu_evt_handler_t   evt_handler;
+    void                  * p_context;
+    volatile bool           busy;
+}app_mpu_fifo_drain_t;
+
+static app_mpu_fifo_drain_t m_fifo_drain;
+
+
+static void fifo_drain_finish(uint32_t result)
+{
+    if(m_fifo_drain.p_num_samples != NULL)
+    {
+        *m_fifo_drain.p_num_samples = m_fifo_drain.frames_read;
+    }
+    m_fifo_drain.busy = false;
+
+    if(m_fifo_drain.evt_handler != NULL)
+    {
+        m_fifo_drain.evt_handler(result, m_fifo_drain.p_context);
+    }
+}
+
+
+static void fifo_drain_overflow_handler(uint32_t result, void * p_context)
+{
+    fifo_drain_finish((result == NRF_SUCCESS) ? MPU_FIFO_OVERFLOW : result);
+}
+
+
+/**@brief Function for turning a FIFO frame into an imu_sample_t
+ * A frame holds the enabled sensors in register order, from MPU_REG_ACCEL_XOUT_H to MPU_REG_GYRO_ZOUT_L.
+ * The sensors that are not in the FIFO are set to 0.
+ */
+static void fifo_frame_expand(imu_sample_t * p_sample, uint8_t const * p_frame)
+{
+    uint8_t raw_values[MPU_SAMPLE_SIZE] = {0};
+    uint8_t const part_enabled[5] = {m_fifo_en.accel, m_fifo_en.temp, m_fifo_en.gyro_x, m_fifo_en.gyro_y, m_fifo_en.gyro_z};
+    uint8_t const part_size[5]    = {6, 2, 2, 2, 2};
+    uint8_t offset = 0;
+
+    for(uint8_t i = 0; i < sizeof(part_size); i++)
+    {
+        if(part_enabled[i])
+        {
+            memcpy(&raw_values[offset], p_frame, part_size[i]);
+            p_frame += part_size[i];
+        }
+        offset += part_size[i];
+    }
+    reorganize_sensor_values((uint8_t*)p_sample, raw_values, MPU_SAMPLE_SIZE);
+}
+
+
+static void fifo_drain_next(void);
+
+static void fifo_drain_data_handler(uint32_t result, void * p_context)
+{
+    uint16_t frames = m_fifo_drain.frames_in_transfer;
+    imu_sample_t * p_samples = &m_fifo_drain.p_samples[m_fifo_drain.frames_read];
+
+    if(result != NRF_SUCCESS)
+    {
+        fifo_drain_finish(result);
+        return;
+    }
+
+    // The frames were read packed into the start of the sample buffer. A frame is never larger
+    // than a sample, so expanding from the last frame and backwards never overwrites a frame
+    // that has not been expanded yet.
+    for(uint16_t i = frames; i > 0; i--)
+    {
+        fifo_frame_expand(&p_samples[i - 1], (uint8_t*)p_samples + ((i - 1) * m_fifo_frame_size));
+    }
+    m_fifo_drain.frames_read += frames;
+    m_fifo_drain.frames_left -= frames;
+
+    fifo_drain_next();
+}
+
+
+static void fifo_drain_next(void)
+{
+    uint32_t err_code;
+    uint16_t frames = m_fifo_drain.frames_left;
+
+    if(frames == 0)
+    {
+        fifo_drain_finish(NRF_SUCCESS);
+        return;
+    }
+    if(frames > (MPU_MAX_READ_LENGTH / m_fifo_frame_size)) // Whole frames that fit in one bus transaction
+    {
+        frames = MPU_MAX_READ_LENGTH / m_fifo_frame_size;
+    }
+
+    m_fifo_drain.frames_in_transfer = frames;
+    err_code = nrf_drv_mpu_read_registers_async(MPU_REG_FIFO_R_W,
+                                                (uint8_t*)&m_fifo_drain.p_samples[m_fifo_drain.frames_read],
+                                                frames * m_fifo_frame_size,
+                                                fifo_drain_data_handler,
+                                                NULL);
+    if(err_code != NRF_SUCCESS)
+    {
+        fifo_drain_finish(err_code);
+    }
+}
+
+
+static void fifo_drain_count_handler(uint32_t result, void * p_context)
+{
+    uint32_t err_code;
+
+    if(result != NRF_SUCCESS)
+    {
+        fifo_drain_finish(result);
+        return;
+    }
+
+    uint16_t count = ((m_fifo_drain.count_raw[0] << 8) | m_fifo_drain.count_raw[1]) & MPU_FIFO_COUNT_MASK;
+
+    // A full FIFO has either dropped new samples or overwritten old ones. In the last case
+    // the frame boundaries are lost, so throw everything away and start over from a clean FIFO.
+    if(count >= MPU_FIFO_SIZE)
+    {
+        uint8_t user_ctrl = m_user_ctrl | MPU_USER_CTRL_FIFO_RST;
+        err_code = nrf_drv_mpu_write_registers_async(MPU_REG_USER_CTRL, &user_ctrl, 1, fifo_drain_overflow_handler, NULL);
+        if(err_code != NRF_SUCCESS)
+        {
+            fifo_drain_finish(err_code);
+        }
+        return;
+    }
+
+    // Only whole frames are read. A partly written frame is left for the next drain.
+    m_fifo_drain.frames_left = count / m_fifo_frame_size;
+    if(m_fifo_drain.frames_left > m_fifo_drain.max_samples)
+    {
+        m_fifo_drain.frames_left = m_fifo_drain.max_samples;
+    }
+    fifo_drain_next();
+}
+
+
+uint32_t app_mpu_fifo_read_samples_async(imu_sample_t * p_samples, uint16_t max_samples, uint16_t * p_num_samples,
+                                         app_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    uint32_t err_code;
+
+    // Slave data would make the frame larger than an imu_sample_t
+    if(m_fifo_frame_size == 0 || m_fifo_en.slv0 || m_fifo_en.slv1 || m_fifo_en.slv2) return NRF_ERROR_INVALID_STATE;
+    if(m_fifo_drain.busy) return NRF_ERROR_BUSY;
+
+    m_fifo_drain.p_samples     = p_samples;
+    m_fifo_drain.max_samples   = max_samples;
+    m_fifo_drain.frames_left   = 0;
+    m_fifo_drain.frames_read   = 0;
+    m_fifo_drain.p_num_samples = p_num_samples;
+    m_fifo_drain.evt_handler   = evt_handler;
+    m_fifo_drain.p_context     = p_context;
+    m_fifo_drain.busy          = true;
+
+    err_code = nrf_drv_mpu_read_registers_async(MPU_REG_FIFO_COUNTH, m_fifo_drain.count_raw, 2, fifo_drain_count_handler, NULL);
+    if(err_code != NRF_SUCCESS)
+    {
+        m_fifo_drain.busy = false;
+    }
+    return err_code;
+}
+
+
+
 // Function does not work on MPU60x0 and MPU9255
 #if defined(MPU9150)
-uint32_t mpu_config_ff_detection(uint16_t mg, uint8_t duration)
+uint32_t app_mpu_config_ff_detection(uint16_t mg, uint8_t duration)
 {
     uint32_t err_code;
     uint8_t threshold = (uint8_t)(mg/MPU_MG_PR_LSB_FF_THR);
@@ -147,31 +515,77 @@ uint32_t mpu_config_ff_detection(uint16_t mg, uint8_t duration)
  * are similar, but AK8963 has adjustable resoultion (14 and 16 bits) while AK8975C has 13 bit resolution fixed. 
  */
 
-#if defined(MPU9150) || defined(MPU9255) && (TWI_COUNT >= 1) // Magnetometer only works with TWI so check if TWI is enabled
+#if defined(MPU9255) || (defined(MPU9150) && (MPU_USES_TWI)) // Over SPI the magnetometer is only reachable through the MPU9255 I2C master
+
+#if defined(MPU9255)
+#define MPU_USER_CTRL_I2C_MST_EN        0x20 // Enables the I2C master that reads the magnetometer.
+#define MPU_USER_CTRL_I2C_IF_DIS        0x10 // Puts the serial interface in SPI only mode.
+#define MPU_I2C_MST_CTRL_WAIT_FOR_ES    0x40 // Delays the data ready interrupt until the external sensor data is loaded.
+#define MPU_I2C_MST_CTRL_CLK_400KHZ     0x0D
+#define MPU_I2C_SLV_EN                  0x80 // I2C_SLVx_EN in I2C_SLVx_CTRL
+#define MPU_I2C_SLV_READ                0x80 // I2C_SLVx_RNW in I2C_SLVx_ADDR
+#define MPU_I2C_MST_STATUS_SLV4_DONE    0x40
+#define MPU_I2C_MST_STATUS_SLV4_NACK    0x10
+#define MPU_MAGN_READ_LENGTH            7    // HXL to HZH and ST2. Reading ST2 releases the next measurement
+#define MPU_SLV4_TIMEOUT_MS             100
 
-uint32_t mpu_magnetometer_init(mpu_magn_config_t * p_magnetometer_conf)
+static bool m_magn_master;  // The magnetometer is read by the MPU I2C master into EXT_SENS_DATA
+#endif
+
+static uint8_t m_magn_cntl; // Last configuration written to MPU_AK89XX_REG_CNTL by the init functions
+
+#if (MPU_USES_TWI)
+uint32_t app_mpu_magnetometer_init(app_mpu_magn_config_t * p_magnetometer_conf)
 {	
 	uint32_t err_code;
 	
 	// Read out MPU configuration register
-	mpu_int_pin_cfg_t bypass_config;
+	app_mpu_int_pin_cfg_t bypass_config;
 	err_code = nrf_drv_mpu_read_registers(MPU_REG_INT_PIN_CFG, (uint8_t *)&bypass_config, 1);
 	
 	// Set I2C bypass enable bit to be able to communicate with magnetometer via I2C
 	bypass_config.i2c_bypass_en = 1;
 	// Write config value back to MPU config register
-	err_code = mpu_int_cfg_pin(&bypass_config);
+	err_code = app_mpu_int_cfg_pin(&bypass_config);
 	if (err_code != NRF_SUCCESS) return err_code;
+#if defined(MPU9255)
+    m_magn_master = false;
+#endif
 	
 	// Write magnetometer config data	
 	uint8_t *data;
     data = (uint8_t*)p_magnetometer_conf;	
+    m_magn_cntl = *data;
     return nrf_drv_mpu_write_magnetometer_register(MPU_AK89XX_REG_CNTL, *data);
 }
 
-uint32_t mpu_read_magnetometer(magn_values_t * p_magnetometer_values, mpu_magn_read_status_t * p_read_status)
+// Test function for development purposes
+uint32_t app_mpu_read_magnetometer_test(uint8_t reg, uint8_t * registers, uint8_t len)
+{
+    return nrf_drv_mpu_read_magnetometer_registers(reg, registers, len);
+}
+#endif // (MPU_USES_TWI)
+
+uint32_t app_mpu_read_magnetometer(magn_values_t * p_magnetometer_values, app_mpu_magn_read_status_t * p_read_status)
 {
 	uint32_t err_code;
+
+#if defined(MPU9255)
+    if(m_magn_master)
+    {
+        uint8_t data[MPU_MAGN_READ_LENGTH];
+
+        err_code = nrf_drv_mpu_read_registers(MPU_REG_EXT_SENS_DATA_00, data, sizeof(data));
+        if(err_code != NRF_SUCCESS) return err_code;
+
+        // Little endian, as read from the magnetometer
+        memcpy(p_magnetometer_values, data, sizeof(magn_values_t));
+        if(p_read_status != NULL) *(uint8_t *)p_read_status = data[MPU_MAGN_READ_LENGTH - 1];
+        return NRF_SUCCESS;
+    }
+#endif
+
+#if (MPU_USES_TWI)
 	err_code = nrf_drv_mpu_read_magnetometer_registers(MPU_AK89XX_REG_HXL, (uint8_t *)p_magnetometer_values, 6);
 	if(err_code != NRF_SUCCESS) return err_code;
         
@@ -191,15 +605,299 @@ uint32_t mpu_read_magnetometer(magn_values_t * p_magnetometer_values, mpu_magn_r
 		err_code = nrf_drv_mpu_read_magnetometer_registers(MPU_AK89XX_REG_ST2, (uint8_t *)p_read_status, 1);
 	}
 	return err_code;
+#else
+    return NRF_ERROR_INVALID_STATE; // app_mpu_magnetometer_master_init() has not been called
+#endif
 }
 
-// Test function for development purposes
-uint32_t mpu_read_magnetometer_test(uint8_t reg, uint8_t * registers, uint8_t len)
+
+
+#if defined(MPU9255)
+/**@brief Function for writing a magnetometer register with slave 4 of the MPU I2C master.
+ * Slave 4 does one transfer at the next sample and reports when it is done.
+ */
+static uint32_t magn_master_write(uint8_t reg, uint8_t value)
 {
-    return nrf_drv_mpu_read_magnetometer_registers(reg, registers, len);
+    uint32_t err_code;
+    uint8_t  status = 0;
+
+    uint8_t slv4[3] = {MPU_AK89XX_MAGN_ADDRESS, reg, value};
+    err_code = nrf_drv_mpu_write_registers(MPU_REG_I2C_SLV4_ADDR, slv4, sizeof(slv4));
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_I2C_SLV4_CTRL, MPU_I2C_SLV_EN);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    for(uint8_t i = 0; !(status & MPU_I2C_MST_STATUS_SLV4_DONE); i++)
+    {
+        if(i >= MPU_SLV4_TIMEOUT_MS) return NRF_ERROR_TIMEOUT;
+        nrf_delay_ms(1);
+        err_code = nrf_drv_mpu_read_registers(MPU_REG_I2C_MST_STATUS, &status, 1);
+        if(err_code != NRF_SUCCESS) return err_code;
+    }
+    if(status & MPU_I2C_MST_STATUS_SLV4_NACK) return NRF_ERROR_INTERNAL;
+
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_mpu_magnetometer_master_init(app_mpu_magn_config_t * p_magnetometer_conf)
+{
+    uint32_t err_code;
+
+    // Bypass mode connects the auxiliary bus to the nRF, so it must be off for the I2C master to drive it
+    app_mpu_int_pin_cfg_t pin_config;
+    err_code = nrf_drv_mpu_read_registers(MPU_REG_INT_PIN_CFG, (uint8_t *)&pin_config, 1);
+    if(err_code != NRF_SUCCESS) return err_code;
+    pin_config.i2c_bypass_en = 0;
+    err_code = app_mpu_int_cfg_pin(&pin_config);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_I2C_MST_CTRL, MPU_I2C_MST_CTRL_WAIT_FOR_ES | MPU_I2C_MST_CTRL_CLK_400KHZ);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    // Kept in m_user_ctrl so the FIFO functions leave the I2C master running
+    m_user_ctrl |= MPU_USER_CTRL_I2C_MST_EN;
+#if defined(MPU_USES_SPI)
+    m_user_ctrl |= MPU_USER_CTRL_I2C_IF_DIS;
+#endif
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, m_user_ctrl);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    err_code = magn_master_write(MPU_AK89XX_REG_CNTL, *(uint8_t *)p_magnetometer_conf);
+    if(err_code != NRF_SUCCESS) return err_code;
+    m_magn_cntl = *(uint8_t *)p_magnetometer_conf;
+
+    // Read HXL to ST2 into EXT_SENS_DATA_00 to EXT_SENS_DATA_06 at every sample with slave 0
+    uint8_t slv0[3] = {MPU_I2C_SLV_READ | MPU_AK89XX_MAGN_ADDRESS, MPU_AK89XX_REG_HXL, MPU_I2C_SLV_EN | MPU_MAGN_READ_LENGTH};
+    err_code = nrf_drv_mpu_write_registers(MPU_REG_I2C_SLV0_ADDR, slv0, sizeof(slv0));
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    m_magn_master = true;
+    return NRF_SUCCESS;
 }
 
-#endif // defined(MPU9150) || defined(MPU9255) && (TWI_COUNT >= 1) 
+
+
+uint32_t app_mpu_read_all_magn(imu_sample_t * p_sample, magn_values_t * p_magn, app_mpu_magn_read_status_t * p_read_status)
+{
+    uint32_t err_code;
+    uint8_t raw_values[MPU_SAMPLE_MAGN_SIZE];
+
+    if(!m_magn_master) return NRF_ERROR_INVALID_STATE;
+
+    err_code = nrf_drv_mpu_read_registers(MPU_REG_ACCEL_XOUT_H, raw_values, MPU_SAMPLE_MAGN_SIZE);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    reorganize_sensor_values((uint8_t *)p_sample, raw_values, MPU_SAMPLE_SIZE);
+    memcpy(p_magn, &raw_values[MPU_SAMPLE_SIZE], sizeof(magn_values_t));
+    if(p_read_status != NULL) *(uint8_t *)p_read_status = raw_values[MPU_SAMPLE_MAGN_SIZE - 1];
+    return NRF_SUCCESS;
+}
+#endif // defined(MPU9255)
+
+
+
+/**@brief Function for powering the magnetometer down, or back up in the mode set by the init functions */
+static uint32_t magn_power_set(bool on)
+{
+    uint8_t cntl = on ? m_magn_cntl : POWER_DOWN_MODE;
+
+    if(m_magn_cntl == POWER_DOWN_MODE) return NRF_SUCCESS; // The magnetometer has not been started
+
+#if defined(MPU9255)
+    if(m_magn_master)
+    {
+        return magn_master_write(MPU_AK89XX_REG_CNTL, cntl);
+    }
+#endif
+#if (MPU_USES_TWI)
+    return nrf_drv_mpu_write_magnetometer_register(MPU_AK89XX_REG_CNTL, cntl);
+#else
+    return NRF_SUCCESS;
+#endif
+}
+
+#endif // defined(MPU9255) || (defined(MPU9150) && (MPU_USES_TWI))
+
+
+
+/*********************************************************************************************************************
+ * FUNCTIONS FOR LOW POWER MOTION DETECTION.
+ */
+
+#define MPU_PWR_MGMT_1_CYCLE            0x20 // Sleeps between single accelerometer samples at the low power rate.
+#define MPU_PWR_MGMT_1_TEMP_DIS         0x08
+#define MPU_PWR_MGMT_1_CLKSEL_PLL       0x01 // PLL with X axis gyroscope reference, as set by app_mpu_init()
+#define MPU_PWR_MGMT_2_STBY_G           0x07 // Gyroscope axes in standby
+#define MPU_INT_ENABLE_MOT_EN           0x40 // MOT_EN, WOM_EN on MPU9255
+#define MPU_INT_PIN_CFG_LATCH_INT_EN    0x20
+
+#if defined(MPU9255)
+#define MPU_ACCEL_CONFIG_2_LP           0x09 // ACCEL_FCHOICE_B = 1 and A_DLPF_CFG = 1, required by Wake-on-Motion
+#define MPU_MOT_DETECT_CTRL_WOM         0xC0 // ACCEL_INTEL_EN and ACCEL_INTEL_MODE, compare with the previous sample
+#define MPU_REG_MOT_THR                 MPU_REG_WOM_THR
+#define MPU_REG_ACCEL_LP                MPU_REG_ACCEL_CONFIG_2
+#else
+#define MPU_ACCEL_CONFIG_HPF_MASK       0x07
+#define MPU_ACCEL_CONFIG_HPF_5HZ        0x01 // Motion is detected on the high pass filtered accelerometer values
+#define MPU_REG_ACCEL_LP                MPU_REG_ACCEL_CONFIG
+#define MPU_PWR_MGMT_2_LP_WAKE_POS      6
+#endif
+
+/**@brief Registers that are changed for low power cycle mode, and their values before */
+typedef struct
+{
+    bool        enabled;
+    uint8_t     int_enable;
+    uint8_t     int_pin_cfg;
+    uint8_t     accel_lp;       // ACCEL_CONFIG_2 on MPU9255 and ACCEL_CONFIG on the others
+}lp_motion_state_t;
+
+static lp_motion_state_t m_lp_motion;
+
+
+/**@brief Function for keeping the first error of a sequence that goes on past failed transfers */
+static void first_error_keep(uint32_t * p_err_code, uint32_t err_code)
+{
+    if(*p_err_code == NRF_SUCCESS)
+    {
+        *p_err_code = err_code;
+    }
+}
+
+
+
+/**@brief Function for writing back the configuration saved by app_mpu_lp_motion_enable().
+ * Goes on past a failed transfer, so one NACK does not leave the MPU half way in low power cycle mode.
+ */
+static uint32_t lp_motion_restore(void)
+{
+    uint32_t err_code = NRF_SUCCESS;
+    uint8_t  int_status;
+
+    // Gyroscope and clock first, as they take longest to start
+    first_error_keep(&err_code, nrf_drv_mpu_write_single_register(MPU_REG_PWR_MGMT_1, MPU_PWR_MGMT_1_CLKSEL_PLL));
+    first_error_keep(&err_code, nrf_drv_mpu_write_single_register(MPU_REG_PWR_MGMT_2, 0));
+
+    first_error_keep(&err_code, nrf_drv_mpu_write_single_register(MPU_REG_INT_ENABLE, m_lp_motion.int_enable));
+    first_error_keep(&err_code, app_mpu_read_int_source(&int_status)); // Releases the latched INT pin
+    first_error_keep(&err_code, nrf_drv_mpu_write_single_register(MPU_REG_INT_PIN_CFG, m_lp_motion.int_pin_cfg));
+#if defined(MPU9255)
+    first_error_keep(&err_code, nrf_drv_mpu_write_single_register(MPU_REG_MOT_DETECT_CTRL, 0));
+#endif
+    first_error_keep(&err_code, nrf_drv_mpu_write_single_register(MPU_REG_ACCEL_LP, m_lp_motion.accel_lp));
+
+#if defined(MPU9255)
+    first_error_keep(&err_code, nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, m_user_ctrl));
+#endif
+#if defined(MPU_MAGN_AVAILABLE)
+    first_error_keep(&err_code, magn_power_set(true));
+#endif
+    return err_code;
+}
+
+
+
+/**@brief Function for the register writes of app_mpu_lp_motion_enable(). Stops at the first failed transfer */
+static uint32_t lp_motion_setup(app_mpu_lp_motion_config_t const * p_config, uint8_t threshold)
+{
+    uint32_t err_code;
+    uint8_t  int_status;
+#if defined(MPU9255)
+    uint8_t  pwr_mgmt_2 = MPU_PWR_MGMT_2_STBY_G; // The rate has its own register, LP_ACCEL_ODR
+#else
+    uint8_t  pwr_mgmt_2 = (uint8_t)(p_config->wake_rate << MPU_PWR_MGMT_2_LP_WAKE_POS) | MPU_PWR_MGMT_2_STBY_G;
+#endif
+
+    err_code = app_mpu_fifo_disable();
+    if(err_code != NRF_SUCCESS) return err_code;
+
+#if defined(MPU_MAGN_AVAILABLE)
+    err_code = magn_power_set(false);
+    if(err_code != NRF_SUCCESS) return err_code;
+#endif
+#if defined(MPU9255)
+    // Nothing for the I2C master to read with the magnetometer off. m_user_ctrl keeps it for lp_motion_restore()
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, m_user_ctrl & ~MPU_USER_CTRL_I2C_MST_EN);
+    if(err_code != NRF_SUCCESS) return err_code;
+#endif
+
+    // Accelerometer on and gyroscope in standby before the motion detection is set up
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_PWR_MGMT_1, MPU_PWR_MGMT_1_CLKSEL_PLL);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_PWR_MGMT_2, pwr_mgmt_2);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+#if defined(MPU9255)
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_ACCEL_CONFIG_2, MPU_ACCEL_CONFIG_2_LP);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_MOT_DETECT_CTRL, MPU_MOT_DETECT_CTRL_WOM);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_LP_ACCEL_ODR, p_config->wake_rate);
+    if(err_code != NRF_SUCCESS) return err_code;
+#else
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_ACCEL_CONFIG,
+                                                 (m_lp_motion.accel_lp & ~MPU_ACCEL_CONFIG_HPF_MASK) | MPU_ACCEL_CONFIG_HPF_5HZ);
+    if(err_code != NRF_SUCCESS) return err_code;
+#endif
+#if defined(MPU9150)
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_MOT_DUR, p_config->duration_ms);
+    if(err_code != NRF_SUCCESS) return err_code;
+#endif
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_MOT_THR, threshold);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_INT_PIN_CFG, m_lp_motion.int_pin_cfg | MPU_INT_PIN_CFG_LATCH_INT_EN);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_mpu_write_single_register(MPU_REG_INT_ENABLE, MPU_INT_ENABLE_MOT_EN);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = app_mpu_read_int_source(&int_status); // Releases the INT pin if an earlier interrupt holds it
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    return nrf_drv_mpu_write_single_register(MPU_REG_PWR_MGMT_1, MPU_PWR_MGMT_1_CYCLE | MPU_PWR_MGMT_1_TEMP_DIS);
+}
+
+
+
+uint32_t app_mpu_lp_motion_enable(app_mpu_lp_motion_config_t const * p_config)
+{
+    uint32_t err_code;
+    uint8_t  threshold;
+
+    if(m_lp_motion.enabled) return NRF_ERROR_INVALID_STATE;
+    if(p_config->threshold_mg / MPU_MG_PR_LSB_MOT_THR > 255) return MPU_BAD_PARAMETER;
+    threshold = (uint8_t)(p_config->threshold_mg / MPU_MG_PR_LSB_MOT_THR);
+
+    // Saved before anything is changed, so a failure on the way can be rolled back
+    err_code = nrf_drv_mpu_read_registers(MPU_REG_INT_ENABLE, &m_lp_motion.int_enable, 1);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_mpu_read_registers(MPU_REG_INT_PIN_CFG, &m_lp_motion.int_pin_cfg, 1);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_mpu_read_registers(MPU_REG_ACCEL_LP, &m_lp_motion.accel_lp, 1);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    err_code = lp_motion_setup(p_config, threshold);
+    if(err_code != NRF_SUCCESS)
+    {
+        (void)lp_motion_restore();
+        return err_code;
+    }
+
+    m_lp_motion.enabled = true;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_mpu_lp_motion_disable(void)
+{
+    if(!m_lp_motion.enabled) return NRF_ERROR_INVALID_STATE;
+
+    // Cleared also if a transfer fails, so app_mpu_lp_motion_enable() can be tried again
+    m_lp_motion.enabled = false;
+    return lp_motion_restore();
+}
 
 /**
   @}
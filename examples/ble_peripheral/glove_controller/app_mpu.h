@@ -16,18 +16,30 @@
 #if defined(MPU60x0)
     #include "mpu60x0_register_map.h"
 	#define MPU_MG_PR_LSB_FF_THR    1
+	#define MPU_FIFO_SIZE           1024
 #elif defined(MPU9150)
     #include "mpu9150_register_map.h"
 	#define MPU_MG_PR_LSB_FF_THR    32
+	#define MPU_FIFO_SIZE           1024
 #elif defined(MPU9255)
     #include "mpu9255_register_map.h"
 	#define MPU_MG_PR_LSB_FF_THR    4
+	#define MPU_FIFO_SIZE           512
 #else 
     #error "No MPU defined. Please define MPU in Target Options C/C++ Defines"
 #endif
 
 #define MPU_MPU_BASE_NUM    		0x4000
 #define MPU_BAD_PARAMETER       	(MPU_MPU_BASE_NUM + 0) // An invalid paramameter has been passed to function.
+#define MPU_FIFO_OVERFLOW       	(MPU_MPU_BASE_NUM + 1) // The FIFO overflowed and has been reset. Samples have been lost.
+
+
+/**@brief Callback invoked from interrupt context when a scheduled read is finished.
+ *
+ * @param[in]   result          NRF_SUCCESS, or the error reported by the bus
+ * @param[in]   p_context       Context pointer given when the read was scheduled
+ */
+typedef void (* app_mpu_evt_handler_t)(uint32_t result, void * p_context);
 
 
 /**@brief Enum defining Accelerometer's Full Scale range posibillities in Gs. */
@@ -75,6 +87,20 @@ typedef struct
 /**@brief Simple typedef to hold temperature values */
 typedef int16_t temp_value_t;
 
+/**@brief Number of bytes from MPU_REG_ACCEL_XOUT_H to the end of the gyroscope registers. */
+#define MPU_SAMPLE_SIZE     14
+
+/**@brief Structure to hold accelerometer, temperature and gyroscope values from one burst read.
+ * The members are in reverse register order for the same reason as
+ * in accel_values_t and gyro_values_t.
+*/
+typedef struct
+{
+    gyro_values_t   gyro;
+    temp_value_t    temp;
+    accel_values_t  accel;
+}imu_sample_t;
+
 /**@brief MPU driver digital low pass fileter and external Frame Synchronization (FSYNC) pin sampling configuration structure */
 typedef struct
 {
@@ -241,6 +267,32 @@ typedef struct
     .mot_en         = 0,    \
     .ff_en          = 0,    \
 }
+
+/**@brief MPU driver FIFO enable structure. Selects which sensor values are pushed to the FIFO at each sample. */
+typedef struct
+{
+    uint8_t slv0            :1; // When set to 1, this bit enables EXT_SENS_DATA registers associated with Slave 0 to be written into the FIFO buffer.
+    uint8_t slv1            :1; // When set to 1, this bit enables EXT_SENS_DATA registers associated with Slave 1 to be written into the FIFO buffer.
+    uint8_t slv2            :1; // When set to 1, this bit enables EXT_SENS_DATA registers associated with Slave 2 to be written into the FIFO buffer.
+    uint8_t accel           :1; // When set to 1, this bit enables ACCEL_XOUT_H, ACCEL_XOUT_L, ACCEL_YOUT_H, ACCEL_YOUT_L, ACCEL_ZOUT_H, and ACCEL_ZOUT_L to be written into the FIFO buffer.
+    uint8_t gyro_z          :1; // When set to 1, this bit enables GYRO_ZOUT_H and GYRO_ZOUT_L to be written into the FIFO buffer.
+    uint8_t gyro_y          :1; // When set to 1, this bit enables GYRO_YOUT_H and GYRO_YOUT_L to be written into the FIFO buffer.
+    uint8_t gyro_x          :1; // When set to 1, this bit enables GYRO_XOUT_H and GYRO_XOUT_L to be written into the FIFO buffer.
+    uint8_t temp            :1; // When set to 1, this bit enables TEMP_OUT_H and TEMP_OUT_L to be written into the FIFO buffer.
+}app_mpu_fifo_en_t;
+
+/**@brief MPU FIFO default configuration. Each FIFO frame is one imu_sample_t. */
+#define MPU_DEFAULT_FIFO_EN_CONFIG()    \
+{                           \
+    .slv0           = 0,    \
+    .slv1           = 0,    \
+    .slv2           = 0,    \
+    .accel          = 1,    \
+    .gyro_z         = 1,    \
+    .gyro_y         = 1,    \
+    .gyro_x         = 1,    \
+    .temp           = 1,    \
+}
  
 
 /**@brief Function for initiating MPU and MPU library
@@ -310,6 +362,32 @@ uint32_t app_mpu_read_accel(accel_values_t * accel_values);
 uint32_t app_mpu_read_gyro(gyro_values_t * gyro_values);
 
 
+/**@brief Function for scheduling a read of MPU accelerometer data without waiting for it.
+ *
+ * Only one accelerometer read can be pending at a time. accel_values is filled
+ * in before evt_handler is called.
+ *
+ * @param[out]  accel_values    Pointer to variable to hold accelerometer data. Must stay valid until evt_handler is called
+ * @param[in]   evt_handler     Function called when the read is finished. Can be NULL
+ * @param[in]   p_context       Context passed to evt_handler
+ * @retval      uint32_t        Error code. NRF_ERROR_BUSY if a read is already pending
+ */
+uint32_t app_mpu_read_accel_async(accel_values_t * accel_values, app_mpu_evt_handler_t evt_handler, void * p_context);
+
+
+/**@brief Function for scheduling a read of MPU gyroscope data without waiting for it.
+ *
+ * Only one gyroscope read can be pending at a time. gyro_values is filled
+ * in before evt_handler is called.
+ *
+ * @param[out]  gyro_values     Pointer to variable to hold gyroscope data. Must stay valid until evt_handler is called
+ * @param[in]   evt_handler     Function called when the read is finished. Can be NULL
+ * @param[in]   p_context       Context passed to evt_handler
+ * @retval      uint32_t        Error code. NRF_ERROR_BUSY if a read is already pending
+ */
+uint32_t app_mpu_read_gyro_async(gyro_values_t * gyro_values, app_mpu_evt_handler_t evt_handler, void * p_context);
+
+
 /**@brief Function for reading MPU temperature data.
  *
  * @param[in]   temp_values     Pointer to variable to hold temperature data
@@ -317,6 +395,97 @@ uint32_t app_mpu_read_gyro(gyro_values_t * gyro_values);
  */
 uint32_t app_mpu_read_temp(temp_value_t * temp_values);
 
+
+/**@brief Function for reading MPU accelerometer, temperature and gyroscope data in one burst.
+ *
+ * The registers are contiguous from MPU_REG_ACCEL_XOUT_H, so all 14 bytes
+ * are fetched in a single bus transaction.
+ *
+ * @param[out]  p_sample        Pointer to variable to hold the sample
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_read_all(imu_sample_t * p_sample);
+
+
+/**@brief Function for scheduling a burst read of accelerometer, temperature and gyroscope data.
+ *
+ * @param[out]  p_sample        Pointer to variable to hold the sample. Must stay valid until evt_handler is called
+ * @param[in]   evt_handler     Function called when the read is finished. Can be NULL
+ * @param[in]   p_context       Context passed to evt_handler
+ * @retval      uint32_t        Error code. NRF_ERROR_BUSY if a read is already pending
+ */
+uint32_t app_mpu_read_all_async(imu_sample_t * p_sample, app_mpu_evt_handler_t evt_handler, void * p_context);
+
+/**@brief Function for enabling the MPU FIFO
+ *
+ * The FIFO is reset and then filled with the selected sensor values at the sample rate set
+ * by app_mpu_config(). Instead of waking up on every data ready interrupt the application can
+ * let the FIFO buffer a number of samples and drain them all at once, e.g. from an app_timer
+ * running at (sample rate / samples pr wakeup). The drain interval must be short enough that
+ * the FIFO (MPU_FIFO_SIZE bytes) does not fill up. Enable fifo_oflow_en in app_mpu_int_enable()
+ * to be woken up if it does anyway.
+ *
+ * With MPU9255 sync_dlpf_gonfig.fifo_mode in app_mpu_config_t selects whether a full FIFO
+ * drops new or overwrites old samples.
+ *
+ * @param[in]   cfg             Pointer to FIFO enable structure
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_fifo_enable(app_mpu_fifo_en_t * cfg);
+
+
+/**@brief Function for disabling and emptying the MPU FIFO
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_fifo_disable(void);
+
+
+/**@brief Function for throwing away all data in the MPU FIFO
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_fifo_reset(void);
+
+
+/**@brief Function for reading the number of bytes in the MPU FIFO
+ *
+ * @param[out]  p_count         Pointer to variable to hold the number of bytes
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_fifo_count_get(uint16_t * p_count);
+
+
+/**@brief Function for reading raw bytes from the MPU FIFO
+ *
+ * @param[out]  p_data          Pointer to buffer to hold the data
+ * @param[in]   length          Number of bytes to read. Use app_mpu_fifo_count_get() to find out how many are available
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_fifo_read(uint8_t * p_data, uint16_t length);
+
+
+/**@brief Function for scheduling a drain of all whole samples in the MPU FIFO
+ *
+ * Reads FIFO_COUNT and then as many whole frames as fit in p_samples, using as few
+ * bus transactions as the transport allows. Each frame becomes one imu_sample_t. Sensors
+ * that are not enabled in the FIFO are left at 0, so only the sensors that are needed
+ * have to be read.
+ *
+ * If the FIFO is found full it is reset, no samples are returned and evt_handler gets
+ * MPU_FIFO_OVERFLOW. Streaming continues from the reset FIFO with correct frame alignment.
+ *
+ * @param[out]  p_samples       Buffer to hold the samples. Must stay valid until evt_handler is called
+ * @param[in]   max_samples     Number of samples p_samples can hold
+ * @param[out]  p_num_samples   Number of samples read. Set before evt_handler is called
+ * @param[in]   evt_handler     Function called when the drain is finished. Can be NULL
+ * @param[in]   p_context       Context passed to evt_handler
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_STATE if the FIFO is disabled or holds slave data
+ */
+uint32_t app_mpu_fifo_read_samples_async(imu_sample_t * p_samples, uint16_t max_samples, uint16_t * p_num_samples,
+                                         app_mpu_evt_handler_t evt_handler, void * p_context);
+
+
 /**@brief Function for reading the source of the MPU generated interrupts.
  *
  * @param[in]   int_source      Pointer to variable to hold interrupt source
@@ -337,6 +506,78 @@ uint32_t app_mpu_config_ff_detection(uint16_t mg, uint8_t duration);
 #endif
 
 
+
+/*********************************************************************************************************************
+ * FUNCTIONS FOR LOW POWER MOTION DETECTION.
+ * In low power cycle mode the gyroscope is in standby and the accelerometer wakes up at a low rate,
+ * takes one sample and compares it with the motion threshold. MPU9255 calls this Wake-on-Motion.
+ */
+
+#if defined(MPU9255)
+#define MPU_MG_PR_LSB_MOT_THR   4
+
+/**@brief Enum defining the accelerometer sample rate in low power cycle mode, LP_ACCEL_ODR */
+enum lp_wake_rate {
+  LP_WAKE_0_24HZ = 0,   // 0.24 Hz
+  LP_WAKE_0_49HZ,       // 0.49 Hz
+  LP_WAKE_0_98HZ,       // 0.98 Hz
+  LP_WAKE_1_95HZ,       // 1.95 Hz
+  LP_WAKE_3_91HZ,       // 3.91 Hz
+  LP_WAKE_7_81HZ,       // 7.81 Hz
+  LP_WAKE_15_63HZ,      // 15.63 Hz
+  LP_WAKE_31_25HZ,      // 31.25 Hz
+  LP_WAKE_62_5HZ,       // 62.5 Hz
+  LP_WAKE_125HZ,        // 125 Hz
+  LP_WAKE_250HZ,        // 250 Hz
+  LP_WAKE_500HZ         // 500 Hz
+};
+#else
+#define MPU_MG_PR_LSB_MOT_THR   32
+
+/**@brief Enum defining the accelerometer sample rate in low power cycle mode, LP_WAKE_CTRL */
+enum lp_wake_rate {
+  LP_WAKE_1_25HZ = 0,   // 1.25 Hz
+  LP_WAKE_5HZ,          // 5 Hz
+  LP_WAKE_20HZ,         // 20 Hz
+  LP_WAKE_40HZ          // 40 Hz
+};
+#endif
+
+/**@brief MPU driver low power motion detection configuration structure. */
+typedef struct
+{
+    uint16_t    threshold_mg;   // Change in acceleration that counts as motion. Rounded down to MPU_MG_PR_LSB_MOT_THR
+    uint8_t     wake_rate;      // lp_wake_rate. How often the accelerometer samples
+    uint8_t     duration_ms;    // How long the threshold must be exceeded. Only used by MPU9150, 1 ms pr LSB
+}app_mpu_lp_motion_config_t;
+
+/**@brief Function for putting the MPU in low power cycle mode with motion detection
+ *
+ * The FIFO is disabled, the gyroscope put in standby and the magnetometer powered down.
+ * Only the motion interrupt is enabled, and the INT pin is latched until INT_STATUS is read,
+ * so a sleeping nRF can not miss it. Call between FIFO drains, as the transfers are blocking.
+ * If a transfer fails on the way, the configuration from before is written back and the
+ * error returned, except for the FIFO, which stays disabled.
+ *
+ * @param[in]   p_config        Pointer to configuration structure
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_STATE if the MPU is already in low power cycle mode
+ */
+uint32_t app_mpu_lp_motion_enable(app_mpu_lp_motion_config_t const * p_config);
+
+
+/**@brief Function for returning the MPU to full rate sampling
+ *
+ * Restores the interrupt, accelerometer and magnetometer configuration from before
+ * app_mpu_lp_motion_enable(). The FIFO stays disabled. Restart it with app_mpu_fifo_enable().
+ * Accelerometer samples are valid at once, but the gyroscope needs about 35 ms to start up.
+ * A failed transfer does not stop the rest from being written. The first error is returned,
+ * and the MPU no longer counts as in low power cycle mode either way.
+ *
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_STATE if the MPU is not in low power cycle mode
+ */
+uint32_t app_mpu_lp_motion_disable(void);
+
+
 /*********************************************************************************************************************
  * FUNCTIONS FOR MAGNETOMETER.
  * MPU9150 has an AK8975C and MPU9255 an AK8963 internal magnetometer. Their register maps
@@ -344,7 +585,9 @@ uint32_t app_mpu_config_ff_detection(uint16_t mg, uint8_t duration);
  */
 
 
-#if (defined(MPU9150) || defined(MPU9255)) && (MPU_USES_TWI) // Magnetometer only works with TWI so check if TWI is enabled
+#if defined(MPU9255) || (defined(MPU9150) && (MPU_USES_TWI)) // Over SPI the magnetometer is only reachable through the MPU9255 I2C master
+
+#define MPU_MAGN_AVAILABLE  1   // The magnetometer functions below can be used
 
 /**@brief Enum defining possible magnetometer operating modes */
 enum magn_op_mode {
@@ -395,15 +638,25 @@ typedef struct
 }app_mpu_magn_read_status_t;
 
 
+#if (MPU_USES_TWI)
 /**@brief Function for enabling and starting the magnetometer
+ *
+ * The MPU is put in I2C bypass mode and the magnetometer is read directly on the TWI bus.
  *
  * @param[in]   app_mpu_magn_config_t 	Magnetometer config struct
  * @retval      uint32_t        	Error code
  */
 uint32_t app_mpu_magnetometer_init(app_mpu_magn_config_t * p_magnetometer_conf);
 
+// Test function for development purposes
+uint32_t app_mpu_read_magnetometer_test(uint8_t reg, uint8_t * registers, uint8_t len);
+#endif
+
 
 /**@brief Function for reading out magnetometer values
+ *
+ * Reads EXT_SENS_DATA when the magnetometer was started with app_mpu_magnetometer_master_init(),
+ * and the magnetometer itself in bypass mode.
  *
  * @param[in]   magn_values_t *				Magnetometer values struct
  * @param[in]   app_mpu_magn_read_status_t *	Value of status register 2 (MPU_AK89XX_REG_ST2) after magnetometer data is read. NULL can be passed as argument if status is not needed
@@ -411,8 +664,37 @@ uint32_t app_mpu_magnetometer_init(app_mpu_magn_config_t * p_magnetometer_conf);
  */
 uint32_t app_mpu_read_magnetometer(magn_values_t * p_magnetometer_values, app_mpu_magn_read_status_t * p_read_status);
 
-// Test function for development purposes
-uint32_t app_mpu_read_magnetometer_test(uint8_t reg, uint8_t * registers, uint8_t len);
+
+#if defined(MPU9255)
+/**@brief Number of bytes from MPU_REG_ACCEL_XOUT_H to the end of the magnetometer values in EXT_SENS_DATA.
+ * HXL to HZH and ST2 are read into EXT_SENS_DATA_00 to EXT_SENS_DATA_06.
+ */
+#define MPU_SAMPLE_MAGN_SIZE    (MPU_REG_EXT_SENS_DATA_06 - MPU_REG_ACCEL_XOUT_H + 1)
+
+/**@brief Function for enabling and starting the magnetometer through the MPU I2C master
+ *
+ * The MPU I2C master writes the magnetometer config with slave 4, and then reads HXL to ST2
+ * into EXT_SENS_DATA_00 to EXT_SENS_DATA_06 with slave 0 at every sample, without help from
+ * the nRF. Works over both TWI and SPI. Call after app_mpu_config(), as the slave 4 write is
+ * done at the sample rate.
+ *
+ * @param[in]   p_magnetometer_conf     Magnetometer config struct
+ * @retval      uint32_t                Error code. NRF_ERROR_TIMEOUT if the MPU never finished the slave 4 write,
+ *                                      NRF_ERROR_INTERNAL if the magnetometer did not acknowledge it
+ */
+uint32_t app_mpu_magnetometer_master_init(app_mpu_magn_config_t * p_magnetometer_conf);
+
+/**@brief Function for reading accelerometer, temperature, gyroscope and magnetometer values in one burst
+ *
+ * Requires app_mpu_magnetometer_master_init().
+ *
+ * @param[out]  p_sample        Accelerometer, temperature and gyroscope values
+ * @param[out]  p_magn          Magnetometer values
+ * @param[out]  p_read_status   Value of ST2. Can be NULL
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_read_all_magn(imu_sample_t * p_sample, magn_values_t * p_magn, app_mpu_magn_read_status_t * p_read_status);
+#endif // defined(MPU9255)
 
 #endif
 
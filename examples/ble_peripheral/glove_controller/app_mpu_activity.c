@@ -0,0 +1,144 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_mpu_activity.h"
+#include "app_mpu.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_error.h"
+
+static app_mpu_activity_config_t            m_config;
+static volatile app_mpu_activity_state_t    m_state;
+static volatile uint32_t                    m_wake_time;    // When the INT pin went high, or app_mpu_activity_wake() was called
+static uint32_t                             m_idle_time;    // When the idle state was entered
+static app_mpu_activity_stats_t             m_stats;
+
+
+
+/**@brief Function for marking a wake up. Full rate sampling is restored by the main loop */
+static void wake_mark(void)
+{
+    CRITICAL_REGION_ENTER();
+    if(m_state == APP_MPU_ACTIVITY_IDLE)
+    {
+        m_wake_time = app_timer_cnt_get();
+        m_state     = APP_MPU_ACTIVITY_WAKING;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+
+static void int_pin_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+{
+    wake_mark();
+}
+
+
+
+uint32_t app_mpu_activity_init(app_mpu_activity_config_t const * p_config)
+{
+    uint32_t err_code;
+    nrf_drv_gpiote_in_config_t pin_config = GPIOTE_CONFIG_IN_SENSE_LOTOHI(false); // PORT event, no extra current
+
+    m_config = *p_config;
+    m_state  = APP_MPU_ACTIVITY_ACTIVE;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    if(!nrf_drv_gpiote_is_init())
+    {
+        err_code = nrf_drv_gpiote_init();
+        if(err_code != NRF_SUCCESS) return err_code;
+    }
+    pin_config.pull = NRF_GPIO_PIN_PULLDOWN; // INT is push-pull and active high, as set by MPU_DEFAULT_INT_PIN_CONFIG()
+    return nrf_drv_gpiote_in_init(m_config.int_pin, &pin_config, int_pin_handler);
+}
+
+
+
+uint32_t app_mpu_activity_idle_enter(void)
+{
+    uint32_t err_code;
+
+    if(m_state != APP_MPU_ACTIVITY_ACTIVE) return NRF_ERROR_INVALID_STATE;
+
+    err_code = app_mpu_lp_motion_enable(&m_config.lp_motion);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    m_idle_time = app_timer_cnt_get();
+    m_state     = APP_MPU_ACTIVITY_IDLE;
+    m_stats.idle_count++;
+    nrf_drv_gpiote_in_event_enable(m_config.int_pin, true);
+    if(nrf_drv_gpiote_in_is_set(m_config.int_pin))
+    {
+        wake_mark(); // Moved before the event was enabled. The pin is latched, so no edge comes
+    }
+
+    if(m_config.evt_handler != NULL)
+    {
+        m_config.evt_handler(APP_MPU_ACTIVITY_IDLE);
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+void app_mpu_activity_wake(void)
+{
+    wake_mark();
+}
+
+
+
+uint32_t app_mpu_activity_process(void)
+{
+    uint32_t err_code;
+    uint32_t now;
+    uint32_t latency;
+    uint32_t idle;
+
+    if(m_state != APP_MPU_ACTIVITY_WAKING) return NRF_SUCCESS;
+
+    nrf_drv_gpiote_in_event_disable(m_config.int_pin);
+    err_code = app_mpu_lp_motion_disable();
+
+    now = app_timer_cnt_get();
+    (void)app_timer_cnt_diff_compute(now, m_wake_time, &latency);
+    (void)app_timer_cnt_diff_compute(m_wake_time, m_idle_time, &idle);
+    m_stats.wake_latency_last = latency;
+    m_stats.wake_latency_max  = MAX(m_stats.wake_latency_max, latency);
+    m_stats.idle_ticks       += idle;
+    m_state = APP_MPU_ACTIVITY_ACTIVE;
+
+    // Also on error, so the application restarts its drains and the next idle_enter() tries again
+    if(m_config.evt_handler != NULL)
+    {
+        m_config.evt_handler(APP_MPU_ACTIVITY_ACTIVE);
+    }
+    return err_code;
+}
+
+
+
+app_mpu_activity_state_t app_mpu_activity_state_get(void)
+{
+    return m_state;
+}
+
+
+
+void app_mpu_activity_stats_get(app_mpu_activity_stats_t * p_stats)
+{
+    *p_stats = m_stats;
+}
+
+/**
+  @}
+*/
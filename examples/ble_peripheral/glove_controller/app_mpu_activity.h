@@ -0,0 +1,112 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_MPU_ACTIVITY_H__
+#define APP_MPU_ACTIVITY_H__
+
+/* Activity state machine that lets the glove sleep while the hand is still.
+ *
+ *   ACTIVE --app_mpu_activity_idle_enter()--> IDLE --motion on INT pin--> WAKING --app_mpu_activity_process()--> ACTIVE
+ *
+ * The application decides when the hand is still, e.g. from app_mpu_calib_collector_t.still_windows,
+ * and calls app_mpu_activity_idle_enter() between two FIFO drains. The MPU is then put in low power
+ * cycle mode with app_mpu_lp_motion_enable(), and the nRF can sleep in sd_app_evt_wait() until
+ * the MPU INT pin goes high on motion. The pin is sensed by GPIOTE in low power PORT mode, so it
+ * costs nothing while waiting.
+ *
+ * The INT pin interrupt only marks the wake up. The main loop wakes up from sd_app_evt_wait()
+ * right after, and app_mpu_activity_process() returns the MPU to full rate sampling with blocking
+ * transfers and calls the event handler, so the application can restart its FIFO and drains.
+ * This takes about 1 ms, well within one sample period.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "app_mpu.h"
+
+/**@brief Activity states */
+typedef enum
+{
+    APP_MPU_ACTIVITY_ACTIVE,        // Full rate sampling
+    APP_MPU_ACTIVITY_IDLE,          // Low power cycle mode, waiting for motion
+    APP_MPU_ACTIVITY_WAKING         // Motion seen. Full rate sampling is restored by app_mpu_activity_process()
+}app_mpu_activity_state_t;
+
+/**@brief Called when the state has changed to APP_MPU_ACTIVITY_IDLE or APP_MPU_ACTIVITY_ACTIVE */
+typedef void (*app_mpu_activity_evt_handler_t)(app_mpu_activity_state_t state);
+
+/**@brief Activity configuration structure */
+typedef struct
+{
+    uint32_t                        int_pin;        // nRF pin connected to the MPU INT pin
+    app_mpu_lp_motion_config_t      lp_motion;      // Motion threshold and sample rate while idle
+    app_mpu_activity_evt_handler_t  evt_handler;
+}app_mpu_activity_config_t;
+
+/**@brief Activity statistics. Times are in app_timer ticks */
+typedef struct
+{
+    uint32_t    idle_count;             // Times the idle state was entered
+    uint32_t    idle_ticks;             // Total time spent idle, up to the last wake up
+    uint32_t    wake_latency_last;      // From the INT pin interrupt to full rate sampling
+    uint32_t    wake_latency_max;
+}app_mpu_activity_stats_t;
+
+
+
+/**@brief Function for initiating the activity state machine. The MPU must have been set up with app_mpu_init()
+ *
+ * @param[in]   p_config        Pointer to configuration structure
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_activity_init(app_mpu_activity_config_t const * p_config);
+
+
+
+/**@brief Function for putting the MPU in low power cycle mode until it sees motion
+ *
+ * Call between FIFO drains, as the transfers are blocking. The FIFO is disabled.
+ *
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_STATE if not active
+ */
+uint32_t app_mpu_activity_idle_enter(void);
+
+
+
+/**@brief Function for waking up without motion, e.g. when a peer subscribes to a sensor
+ */
+void app_mpu_activity_wake(void);
+
+
+
+/**@brief Function for finishing a wake up. Call from the main loop, after every wake up from sd_app_evt_wait()
+ *
+ * @retval      uint32_t        Error code from app_mpu_lp_motion_disable(). NRF_SUCCESS if there was nothing to do
+ */
+uint32_t app_mpu_activity_process(void);
+
+
+
+/**@brief Function for reading the current state
+ *
+ * @retval      app_mpu_activity_state_t    State
+ */
+app_mpu_activity_state_t app_mpu_activity_state_get(void);
+
+
+
+/**@brief Function for reading the statistics
+ *
+ * @param[out]  p_stats         Statistics
+ */
+void app_mpu_activity_stats_get(app_mpu_activity_stats_t * p_stats);
+
+
+#endif /* APP_MPU_ACTIVITY_H__ */
+
+/**
+  @}
+*/
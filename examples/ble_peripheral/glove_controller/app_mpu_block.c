@@ -0,0 +1,86 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "app_mpu_block.h"
+#include "app_util.h"       // nrf_balloc.h uses ALIGN_NUM and STATIC_ASSERT without including it
+#include "nrf_balloc.h"
+#include "app_util_platform.h"
+#include "app_error.h"
+
+
+NRF_BALLOC_DEF(m_block_pool, sizeof(app_mpu_block_t), APP_MPU_BLOCK_POOL_SIZE);
+
+
+
+uint32_t app_mpu_block_pool_init(void)
+{
+    return nrf_balloc_init(&m_block_pool);
+}
+
+
+
+app_mpu_block_t * app_mpu_block_alloc(void)
+{
+    app_mpu_block_t * p_block = nrf_balloc_alloc(&m_block_pool);
+
+    if(p_block != NULL)
+    {
+        p_block->ref_count   = 1;
+        p_block->num_samples = 0;
+        p_block->timestamp   = 0;
+    }
+    return p_block;
+}
+
+
+
+void app_mpu_block_retain(app_mpu_block_t * p_block)
+{
+    // Cortex-M0 has no exclusive access instructions, so the count is protected by a critical region
+    CRITICAL_REGION_ENTER();
+    ASSERT(p_block->ref_count < UINT8_MAX);
+    p_block->ref_count++;
+    CRITICAL_REGION_EXIT();
+}
+
+
+
+void app_mpu_block_release(app_mpu_block_t * p_block)
+{
+    uint8_t ref_count;
+
+    CRITICAL_REGION_ENTER();
+    ASSERT(p_block->ref_count > 0);
+    ref_count = --p_block->ref_count;
+    CRITICAL_REGION_EXIT();
+
+    if(ref_count == 0)
+    {
+        nrf_balloc_free(&m_block_pool, p_block);
+    }
+}
+
+
+
+uint8_t app_mpu_block_max_utilization_get(void)
+{
+    return nrf_balloc_max_utilization_get(&m_block_pool);
+}
+
+
+
+uint32_t app_mpu_block_fifo_read_async(app_mpu_block_t * p_block, app_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return app_mpu_fifo_read_samples_async(p_block->samples, APP_MPU_BLOCK_SAMPLES, &p_block->num_samples,
+                                           evt_handler, p_context);
+}
+
+
+/**
+  @}
+*/
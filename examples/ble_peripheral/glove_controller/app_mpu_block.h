@@ -0,0 +1,104 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_MPU_BLOCK_H__
+#define APP_MPU_BLOCK_H__
+
+/* Pool of reference counted sample blocks.
+ *
+ * The producer allocates a block and reads samples straight into it. Each consumer
+ * (BLE, logging, fusion) that keeps the block after the producer hands it over calls
+ * app_mpu_block_retain(), and app_mpu_block_release() when it is done. The block goes
+ * back to the pool when the last reference is released, so the samples are never copied
+ * between the consumers.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_mpu.h"
+
+#ifndef APP_MPU_BLOCK_SAMPLES
+#define APP_MPU_BLOCK_SAMPLES       16  // Samples per block. 16 samples is 16 ms at 1 kHz
+#endif
+#ifndef APP_MPU_BLOCK_POOL_SIZE
+#define APP_MPU_BLOCK_POOL_SIZE     4   // Two blocks being consumed while one is filled, and one spare
+#endif
+
+
+/**@brief Block of samples, stored as app_mpu_read_all() returns them
+ */
+typedef struct
+{
+    volatile uint8_t    ref_count;
+    uint16_t            num_samples;                        // Number of valid samples
+    uint32_t            timestamp;                          // app_timer ticks when the last sample was taken. Set by the producer
+    imu_sample_t        samples[APP_MPU_BLOCK_SAMPLES];
+}app_mpu_block_t;
+
+
+
+/**@brief Function for initiating the block pool
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_block_pool_init(void);
+
+
+
+/**@brief Function for getting a free block
+ *
+ * Safe to call from interrupt context.
+ *
+ * @retval      app_mpu_block_t*    Block with one reference and no samples. NULL if the pool is empty
+ */
+app_mpu_block_t * app_mpu_block_alloc(void);
+
+
+
+/**@brief Function for adding a reference to a block
+ *
+ * @param[in]   p_block         Block to keep
+ */
+void app_mpu_block_retain(app_mpu_block_t * p_block);
+
+
+
+/**@brief Function for dropping a reference to a block
+ *
+ * The block is returned to the pool when the last reference is dropped.
+ *
+ * @param[in]   p_block         Block that is no longer needed
+ */
+void app_mpu_block_release(app_mpu_block_t * p_block);
+
+
+
+/**@brief Function for getting the highest number of blocks that have been in use at the same time
+ */
+uint8_t app_mpu_block_max_utilization_get(void);
+
+
+
+/**@brief Function for draining the MPU FIFO straight into a block
+ *
+ * Same as app_mpu_fifo_read_samples_async(), with p_block->samples as the destination
+ * and p_block->num_samples set to the number of samples read. The caller's reference
+ * must be held until evt_handler is called.
+ *
+ * @param[in]   p_block         Block to fill
+ * @param[in]   evt_handler     Function called when the drain is finished. Can be NULL
+ * @param[in]   p_context       Context passed to evt_handler
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_block_fifo_read_async(app_mpu_block_t * p_block, app_mpu_evt_handler_t evt_handler, void * p_context);
+
+
+#endif /* APP_MPU_BLOCK_H__ */
+
+/**
+  @}
+*/
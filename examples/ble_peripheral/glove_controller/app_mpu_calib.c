@@ -0,0 +1,379 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_mpu_calib.h"
+#include "nrf_drv_mpu.h"
+#include "nrf_error.h"
+#include "app_util.h"
+#include "fds.h"
+
+STATIC_ASSERT((sizeof(app_mpu_calib_t) % sizeof(uint32_t)) == 0);
+
+static uint32_t         m_record_data[BYTES_TO_WORDS(sizeof(app_mpu_calib_t))];    // Copy being written. FDS needs it word aligned until done
+static volatile bool    m_save_pending;
+
+
+
+static int16_t saturate(int32_t value)
+{
+    if(value > INT16_MAX) return INT16_MAX;
+    if(value < INT16_MIN) return INT16_MIN;
+    return (int16_t)value;
+}
+
+
+
+static int16_t mean_get(int32_t sum, uint16_t count)
+{
+    return saturate((sum + ((sum >= 0) ? (count / 2) : -(count / 2))) / count);
+}
+
+
+
+void app_mpu_calib_defaults(app_mpu_calib_t * p_calib, app_mpu_config_t const * p_config)
+{
+    memset(p_calib, 0, sizeof(app_mpu_calib_t));
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        p_calib->accel_scale[i] = APP_MPU_CALIB_SCALE_ONE;
+        p_calib->magn_scale[i]  = APP_MPU_CALIB_SCALE_ONE;
+    }
+    p_calib->gyro_fs  = p_config->gyro_config.fs_sel;
+    p_calib->accel_fs = p_config->accel_config.afs_sel;
+    p_calib->version  = APP_MPU_CALIB_VERSION;
+}
+
+
+
+void app_mpu_calib_collector_init(app_mpu_calib_collector_t * p_collector)
+{
+    memset(p_collector, 0, sizeof(app_mpu_calib_collector_t));
+}
+
+
+
+/**@brief Function for storing the mean of a still window if gravity is along one axis.
+ * Fits offset and scale when all six positions have been seen.
+ */
+static bool accel_position_add(app_mpu_calib_collector_t * p_collector, app_mpu_calib_t * p_calib, int16_t const * p_mean)
+{
+    int16_t one_g = 16384 >> p_calib->accel_fs;
+    uint8_t axis  = 0;
+
+    for(uint8_t i = 1; i < 3; i++)
+    {
+        if(abs(p_mean[i]) > abs(p_mean[axis])) axis = i;
+    }
+    if(abs(p_mean[axis]) < (one_g / 2)) return false;
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        if(i != axis && abs(p_mean[i]) > (one_g / 4)) return false; // Not resting on a side
+    }
+
+    uint8_t pos = (axis * 2) + ((p_mean[axis] < 0) ? 1 : 0);
+    p_collector->accel_pos[pos]  = p_mean[axis];
+    p_collector->accel_pos_seen |= (1 << pos);
+
+    if(p_collector->accel_pos_seen != 0x3F) return false;
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        int32_t plus  = p_collector->accel_pos[2 * i];
+        int32_t minus = p_collector->accel_pos[(2 * i) + 1];
+
+        p_calib->accel_offset[i] = (int16_t)((plus + minus) / 2);
+        p_calib->accel_scale[i]  = saturate(((int32_t)one_g * APP_MPU_CALIB_SCALE_ONE) / ((plus - minus) / 2));
+    }
+    p_calib->valid |= APP_MPU_CALIB_VALID_ACCEL;
+    return true;
+}
+
+
+
+uint8_t app_mpu_calib_sample_add(app_mpu_calib_collector_t * p_collector, app_mpu_calib_t * p_calib,
+                                 accel_values_t const * p_accel, gyro_values_t const * p_gyro)
+{
+    int16_t const accel[3] = {p_accel->x, p_accel->y, p_accel->z};
+    int16_t const gyro[3]  = {p_gyro->x, p_gyro->y, p_gyro->z};
+    uint8_t updated = 0;
+    bool    still   = true;
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        if(p_collector->count == 0)
+        {
+            p_collector->gyro_min[i] = gyro[i];
+            p_collector->gyro_max[i] = gyro[i];
+        }
+        if(gyro[i] < p_collector->gyro_min[i]) p_collector->gyro_min[i] = gyro[i];
+        if(gyro[i] > p_collector->gyro_max[i]) p_collector->gyro_max[i] = gyro[i];
+        p_collector->gyro_sum[i]  += gyro[i];
+        p_collector->accel_sum[i] += accel[i];
+    }
+    if(++p_collector->count < APP_MPU_CALIB_WINDOW) return 0;
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        if((p_collector->gyro_max[i] - p_collector->gyro_min[i]) > APP_MPU_CALIB_STILL_RANGE) still = false;
+    }
+
+    if(!still)
+    {
+        p_collector->still_windows = 0;
+    }
+    else if(p_collector->still_windows < UINT16_MAX)
+    {
+        p_collector->still_windows++;
+    }
+
+    if(still)
+    {
+        int16_t accel_mean[3];
+
+        for(uint8_t i = 0; i < 3; i++)
+        {
+#if APP_MPU_CALIB_GYRO_HW
+            // The offset registers already remove gyro_bias, so the mean is what is left of it
+            p_collector->gyro_bias[i] = p_calib->gyro_bias[i] + mean_get(p_collector->gyro_sum[i], p_collector->count);
+#else
+            p_collector->gyro_bias[i] = mean_get(p_collector->gyro_sum[i], p_collector->count);
+#endif
+            accel_mean[i] = mean_get(p_collector->accel_sum[i], p_collector->count);
+        }
+        updated |= APP_MPU_CALIB_VALID_GYRO;
+
+        if(accel_position_add(p_collector, p_calib, accel_mean))
+        {
+            updated |= APP_MPU_CALIB_VALID_ACCEL;
+        }
+    }
+
+    memset(p_collector->gyro_sum, 0, sizeof(p_collector->gyro_sum));
+    memset(p_collector->accel_sum, 0, sizeof(p_collector->accel_sum));
+    p_collector->count = 0;
+    return updated;
+}
+
+
+
+void app_mpu_calib_magn_add(app_mpu_calib_collector_t * p_collector, int16_t const * p_magn)
+{
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        if(p_collector->magn_count == 0 || p_magn[i] < p_collector->magn_min[i]) p_collector->magn_min[i] = p_magn[i];
+        if(p_collector->magn_count == 0 || p_magn[i] > p_collector->magn_max[i]) p_collector->magn_max[i] = p_magn[i];
+    }
+    if(p_collector->magn_count < UINT16_MAX) p_collector->magn_count++;
+}
+
+
+
+uint32_t app_mpu_calib_magn_fit(app_mpu_calib_collector_t const * p_collector, app_mpu_calib_t * p_calib)
+{
+    int32_t radius[3];
+    int32_t radius_avg = 0;
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        int32_t range = (int32_t)p_collector->magn_max[i] - p_collector->magn_min[i];
+
+        if(p_collector->magn_count == 0 || range < APP_MPU_CALIB_MAGN_MIN_RANGE) return NRF_ERROR_INVALID_STATE;
+        radius[i]   = range / 2;
+        radius_avg += radius[i];
+    }
+    radius_avg /= 3;
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        p_calib->magn_offset[i] = (int16_t)(((int32_t)p_collector->magn_max[i] + p_collector->magn_min[i]) / 2);
+        p_calib->magn_scale[i]  = saturate((radius_avg * APP_MPU_CALIB_SCALE_ONE) / radius[i]);
+    }
+    p_calib->valid |= APP_MPU_CALIB_VALID_MAGN;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_mpu_calib_apply(app_mpu_calib_t const * p_calib)
+{
+#if APP_MPU_CALIB_GYRO_HW
+    uint8_t data[6];
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        // The registers are in 1000 dps units of 4 LSB: OffsetLSB = X_OFFS_USR * 4 / 2^FS_SEL
+        int32_t offset = 0;
+        if(p_calib->valid & APP_MPU_CALIB_VALID_GYRO)
+        {
+            offset = -(p_calib->gyro_bias[i] * (1 << p_calib->gyro_fs)) / 4;
+        }
+        data[2 * i]       = (uint8_t)(offset >> 8);
+        data[(2 * i) + 1] = (uint8_t)offset;
+    }
+    return nrf_drv_mpu_write_registers(MPU_REG_XG_OFFSET_H, data, sizeof(data));
+#else
+    return NRF_SUCCESS;
+#endif
+}
+
+
+
+uint32_t app_mpu_calib_gyro_apply(app_mpu_calib_collector_t const * p_collector, app_mpu_calib_t * p_calib)
+{
+    uint32_t err_code;
+    app_mpu_calib_t calib = *p_calib;
+
+    memcpy(calib.gyro_bias, p_collector->gyro_bias, sizeof(calib.gyro_bias));
+    calib.valid |= APP_MPU_CALIB_VALID_GYRO;
+
+    err_code = app_mpu_calib_apply(&calib);
+    if(err_code == NRF_SUCCESS)
+    {
+        *p_calib = calib;
+    }
+    return err_code;
+}
+
+
+
+static int16_t correct(int16_t value, int16_t offset, int16_t scale)
+{
+    return saturate((((int32_t)value - offset) * scale) / APP_MPU_CALIB_SCALE_ONE);
+}
+
+
+
+void app_mpu_calib_correct(app_mpu_calib_t const * p_calib, accel_values_t * p_accel,
+                           gyro_values_t * p_gyro, int16_t * p_magn)
+{
+    if(p_accel != NULL && (p_calib->valid & APP_MPU_CALIB_VALID_ACCEL))
+    {
+        p_accel->x = correct(p_accel->x, p_calib->accel_offset[0], p_calib->accel_scale[0]);
+        p_accel->y = correct(p_accel->y, p_calib->accel_offset[1], p_calib->accel_scale[1]);
+        p_accel->z = correct(p_accel->z, p_calib->accel_offset[2], p_calib->accel_scale[2]);
+    }
+#if !APP_MPU_CALIB_GYRO_HW
+    if(p_gyro != NULL && (p_calib->valid & APP_MPU_CALIB_VALID_GYRO))
+    {
+        p_gyro->x = saturate((int32_t)p_gyro->x - p_calib->gyro_bias[0]);
+        p_gyro->y = saturate((int32_t)p_gyro->y - p_calib->gyro_bias[1]);
+        p_gyro->z = saturate((int32_t)p_gyro->z - p_calib->gyro_bias[2]);
+    }
+#else
+    (void)p_gyro;   // The offset registers have removed the bias
+#endif
+    if(p_magn != NULL && (p_calib->valid & APP_MPU_CALIB_VALID_MAGN))
+    {
+        for(uint8_t i = 0; i < 3; i++)
+        {
+            p_magn[i] = correct(p_magn[i], p_calib->magn_offset[i], p_calib->magn_scale[i]);
+        }
+    }
+}
+
+
+
+static void fds_evt_handler(fds_evt_t const * p_evt)
+{
+    if((p_evt->id == FDS_EVT_WRITE || p_evt->id == FDS_EVT_UPDATE) &&
+       (p_evt->write.file_id == APP_MPU_CALIB_FILE_ID))
+    {
+        m_save_pending = false;
+    }
+}
+
+
+
+uint32_t app_mpu_calib_storage_init(void)
+{
+    return fds_register(fds_evt_handler);
+}
+
+
+
+uint32_t app_mpu_calib_load(app_mpu_calib_t * p_calib, app_mpu_config_t const * p_config)
+{
+    fds_record_desc_t   desc;
+    fds_find_token_t    token;
+    fds_flash_record_t  record;
+    app_mpu_calib_t     calib;
+
+    memset(&token, 0, sizeof(token));
+    if(fds_record_find(APP_MPU_CALIB_FILE_ID, APP_MPU_CALIB_RECORD_KEY, &desc, &token) != FDS_SUCCESS) return NRF_ERROR_NOT_FOUND;
+    if(fds_record_open(&desc, &record) != FDS_SUCCESS) return NRF_ERROR_NOT_FOUND;
+
+    if(record.p_header->tl.length_words != BYTES_TO_WORDS(sizeof(app_mpu_calib_t)))
+    {
+        (void)fds_record_close(&desc);
+        return NRF_ERROR_NOT_FOUND;
+    }
+    memcpy(&calib, record.p_data, sizeof(calib));
+    (void)fds_record_close(&desc);
+
+    if(calib.version != APP_MPU_CALIB_VERSION ||
+       calib.gyro_fs  != p_config->gyro_config.fs_sel ||
+       calib.accel_fs != p_config->accel_config.afs_sel)
+    {
+        return NRF_ERROR_NOT_FOUND; // Collected with other ranges. Start over
+    }
+    *p_calib = calib;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_mpu_calib_save(app_mpu_calib_t const * p_calib)
+{
+    uint32_t            err_code;
+    fds_record_desc_t   desc;
+    fds_find_token_t    token;
+    fds_record_chunk_t  chunk;
+    fds_record_t        record;
+
+    if(m_save_pending) return NRF_ERROR_BUSY;
+
+    memcpy(m_record_data, p_calib, sizeof(app_mpu_calib_t));
+
+    chunk.p_data            = m_record_data;
+    chunk.length_words      = BYTES_TO_WORDS(sizeof(app_mpu_calib_t));
+    record.file_id          = APP_MPU_CALIB_FILE_ID;
+    record.key              = APP_MPU_CALIB_RECORD_KEY;
+    record.data.p_chunks    = &chunk;
+    record.data.num_chunks  = 1;
+
+    // Set before the write is queued, as FDS may report it done before the call returns
+    m_save_pending = true;
+
+    memset(&token, 0, sizeof(token));
+    if(fds_record_find(APP_MPU_CALIB_FILE_ID, APP_MPU_CALIB_RECORD_KEY, &desc, &token) == FDS_SUCCESS)
+    {
+        err_code = fds_record_update(&desc, &record);
+    }
+    else
+    {
+        err_code = fds_record_write(&desc, &record);
+    }
+
+    if(err_code != FDS_SUCCESS)
+    {
+        m_save_pending = false;
+    }
+    if(err_code == FDS_ERR_NO_SPACE_IN_FLASH)
+    {
+        (void)fds_gc(); // Try again when garbage collection is done
+        return NRF_ERROR_NO_MEM;
+    }
+    return err_code;
+}
+
+
+/**
+  @}
+*/
@@ -0,0 +1,222 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_MPU_CALIB_H__
+#define APP_MPU_CALIB_H__
+
+/* Sensor calibration.
+ *
+ * Samples are fed to a collector in windows of APP_MPU_CALIB_WINDOW samples. A window in
+ * which the gyroscope stays within APP_MPU_CALIB_STILL_RANGE on all axes counts as still:
+ *  - the gyroscope mean of the window becomes the gyroscope bias.
+ *  - if gravity is along one of the sensor axes, the accelerometer mean is stored for that
+ *    of the six positions (+x, -x, +y, -y, +z, -z). When all six have been seen, the
+ *    accelerometer offset and scale of each axis are fitted from the opposite pairs.
+ * The magnetometer hard iron offset and soft iron scale are fitted from the extremes seen
+ * while the sensor is turned through all orientations.
+ *
+ * Where the MPU has gyroscope offset registers, app_mpu_calib_apply() writes the bias there
+ * so the samples come out corrected. The accelerometer offset registers hold a factory trim,
+ * so the accelerometer and magnetometer are corrected by app_mpu_calib_correct().
+ *
+ * The calibration is stored in one FDS record next to the peer manager data, so the
+ * sensor is calibrated right from boot.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_mpu.h"
+
+#if defined(MPU_REG_XG_OFFSET_H)
+#define APP_MPU_CALIB_GYRO_HW       1   // Gyroscope bias is removed by the MPU
+#else
+#define APP_MPU_CALIB_GYRO_HW       0
+#endif
+
+#ifndef APP_MPU_CALIB_WINDOW
+#define APP_MPU_CALIB_WINDOW        64  // Samples per stillness window
+#endif
+#ifndef APP_MPU_CALIB_STILL_RANGE
+#define APP_MPU_CALIB_STILL_RANGE   16  // Max gyroscope peak to peak in LSB for a window to count as still. 1 dps at 2000 dps
+#endif
+#ifndef APP_MPU_CALIB_MAGN_MIN_RANGE
+#define APP_MPU_CALIB_MAGN_MIN_RANGE 200 // Min magnetometer peak to peak on each axis before a fit is made
+#endif
+
+#define APP_MPU_CALIB_FILE_ID       0x4D50  // Below the peer manager range from 0xC000
+#define APP_MPU_CALIB_RECORD_KEY    0x0001
+#define APP_MPU_CALIB_VERSION       1
+
+#define APP_MPU_CALIB_VALID_GYRO    (1 << 0)
+#define APP_MPU_CALIB_VALID_ACCEL   (1 << 1)
+#define APP_MPU_CALIB_VALID_MAGN    (1 << 2)
+
+#define APP_MPU_CALIB_SCALE_ONE     16384   // Q14
+
+
+
+/**@brief Calibration of one sensor, as stored in flash. All arrays are x, y, z
+ */
+typedef struct
+{
+    int16_t     gyro_bias[3];       // LSB at gyro_fs
+    int16_t     accel_offset[3];    // LSB at accel_fs
+    int16_t     accel_scale[3];     // Q14 gain that scales 1 g to the nominal LSB per g
+    int16_t     magn_offset[3];     // Hard iron offset in magnetometer LSB
+    int16_t     magn_scale[3];      // Soft iron gain per axis, Q14
+    uint8_t     gyro_fs;            // enum gyro_range the values were collected with
+    uint8_t     accel_fs;           // enum accel_range the values were collected with
+    uint8_t     valid;              // APP_MPU_CALIB_VALID_ bits
+    uint8_t     version;
+    uint8_t     reserved[2];        // Pads the record to whole flash words
+}app_mpu_calib_t;
+
+/**@brief State of a calibration in progress
+ */
+typedef struct
+{
+    int32_t     gyro_sum[3];
+    int32_t     accel_sum[3];
+    int16_t     gyro_min[3];
+    int16_t     gyro_max[3];
+    uint16_t    count;
+    uint16_t    still_windows;      // Still windows in a row. 0 once a window with motion ends
+    int16_t     accel_pos[6];       // Mean along gravity in each of the positions +x, -x, +y, -y, +z, -z
+    uint8_t     accel_pos_seen;     // Bit per position
+    int16_t     magn_min[3];
+    int16_t     magn_max[3];
+    uint16_t    magn_count;
+    int16_t     gyro_bias[3];       // Bias from the last still window, until app_mpu_calib_gyro_apply() has written it
+}app_mpu_calib_collector_t;
+
+
+
+/**@brief Function for setting a calibration that leaves samples untouched
+ *
+ * @param[out]  p_calib         Calibration
+ * @param[in]   p_config        MPU configuration the calibration will be collected with
+ */
+void app_mpu_calib_defaults(app_mpu_calib_t * p_calib, app_mpu_config_t const * p_config);
+
+
+
+/**@brief Function for starting a calibration
+ *
+ * @param[out]  p_collector     Collector state
+ */
+void app_mpu_calib_collector_init(app_mpu_calib_collector_t * p_collector);
+
+
+
+/**@brief Function for feeding an accelerometer and gyroscope sample to a collector
+ *
+ * Samples must be passed as read from the MPU, before app_mpu_calib_correct().
+ * A new gyroscope bias is kept in the collector until app_mpu_calib_gyro_apply() is called.
+ *
+ * @param[in]   p_collector     Collector state
+ * @param[in]   p_calib         Calibration to update
+ * @param[in]   p_accel         Accelerometer values
+ * @param[in]   p_gyro          Gyroscope values
+ * @retval      uint8_t         APP_MPU_CALIB_VALID_ bits of the values updated by this sample.
+ *                              APP_MPU_CALIB_VALID_GYRO if a new gyroscope bias is waiting
+ */
+uint8_t app_mpu_calib_sample_add(app_mpu_calib_collector_t * p_collector, app_mpu_calib_t * p_calib,
+                                 accel_values_t const * p_accel, gyro_values_t const * p_gyro);
+
+
+
+/**@brief Function for feeding a magnetometer sample to a collector
+ *
+ * @param[in]   p_collector     Collector state
+ * @param[in]   p_magn          Magnetometer x, y and z, as read
+ */
+void app_mpu_calib_magn_add(app_mpu_calib_collector_t * p_collector, int16_t const * p_magn);
+
+
+
+/**@brief Function for fitting the magnetometer hard and soft iron correction
+ *
+ * @param[in]   p_collector     Collector state
+ * @param[in]   p_calib         Calibration to update
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_STATE if the sensor has not been turned enough
+ */
+uint32_t app_mpu_calib_magn_fit(app_mpu_calib_collector_t const * p_collector, app_mpu_calib_t * p_calib);
+
+
+
+/**@brief Function for writing the gyroscope bias to the MPU offset registers
+ *
+ * Must be called after app_mpu_init() and whenever the gyroscope bias changes.
+ * Does nothing on MPUs without gyroscope offset registers.
+ *
+ * @param[in]   p_calib         Calibration
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_calib_apply(app_mpu_calib_t const * p_calib);
+
+
+
+/**@brief Function for taking the gyroscope bias of the last still window into use
+ *
+ * Call it when app_mpu_calib_sample_add() reports APP_MPU_CALIB_VALID_GYRO. Where the MPU has
+ * gyroscope offset registers the new bias is written there first, and it only replaces the
+ * bias in p_calib if the write succeeds. Until then the registers and p_calib keep agreeing,
+ * so the next still window measures what is left over the bias that is really in use.
+ *
+ * @param[in]   p_collector     Collector state
+ * @param[in]   p_calib         Calibration to update
+ * @retval      uint32_t        Error code of the register write. p_calib is unchanged if it failed
+ */
+uint32_t app_mpu_calib_gyro_apply(app_mpu_calib_collector_t const * p_collector, app_mpu_calib_t * p_calib);
+
+
+
+/**@brief Function for correcting a sample with the calibration
+ *
+ * @param[in]   p_calib         Calibration
+ * @param[in]   p_accel         Accelerometer values to correct. Can be NULL
+ * @param[in]   p_gyro          Gyroscope values to correct. Can be NULL
+ * @param[in]   p_magn          Magnetometer x, y and z to correct. Can be NULL
+ */
+void app_mpu_calib_correct(app_mpu_calib_t const * p_calib, accel_values_t * p_accel,
+                           gyro_values_t * p_gyro, int16_t * p_magn);
+
+
+
+/**@brief Function for registering with FDS. Must be called before fds_init(), i.e. before pm_init()
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_calib_storage_init(void);
+
+
+
+/**@brief Function for reading the stored calibration
+ *
+ * @param[out]  p_calib         Calibration
+ * @param[in]   p_config        MPU configuration in use. The stored calibration must match its ranges
+ * @retval      uint32_t        Error code. NRF_ERROR_NOT_FOUND if nothing usable is stored
+ */
+uint32_t app_mpu_calib_load(app_mpu_calib_t * p_calib, app_mpu_config_t const * p_config);
+
+
+
+/**@brief Function for storing a calibration
+ *
+ * The calibration is copied, and written to flash in the background.
+ *
+ * @param[in]   p_calib         Calibration
+ * @retval      uint32_t        Error code. NRF_ERROR_BUSY if the last calibration is still being written
+ */
+uint32_t app_mpu_calib_save(app_mpu_calib_t const * p_calib);
+
+
+#endif /* APP_MPU_CALIB_H__ */
+
+/**
+  @}
+*/
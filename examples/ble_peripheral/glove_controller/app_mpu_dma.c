@@ -0,0 +1,377 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include "app_mpu_dma.h"
+
+#if defined(NRF52)
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "nrf_drv_twi.h"
+#include "nrf_drv_timer.h"
+#include "nrf_drv_ppi.h"
+#include "nrf_ppi.h"
+#include "nrf_twim.h"
+#include "nrf_drv_mpu.h"
+#include "app_util_platform.h"
+
+
+/**@brief Resources app_mpu_dma_init() has taken, so they can be released again */
+#define RESOURCE_TWI                (1 << 0)
+#define RESOURCE_COUNTER_TIMER      (1 << 1)
+#define RESOURCE_TRIGGER_TIMER      (1 << 2)
+#define RESOURCE_PPI_TRIGGER        (1 << 3)
+#define RESOURCE_PPI_COUNT          (1 << 4)
+#define RESOURCE_PPI_STOP           (1 << 5)
+#define RESOURCE_PPI_MISS           (1 << 6)
+#define RESOURCE_GROUP_RUN          (1 << 7)
+#define RESOURCE_GROUP_MISS         (1 << 8)
+
+
+typedef struct
+{
+    app_mpu_dma_config_t    config;
+    uint8_t                 tx_buffer[1];       // Register address written before each read
+    nrf_ppi_channel_t       ppi_trigger;        // Trigger event to TWIM start. In group_run
+    nrf_ppi_channel_t       ppi_count;          // TWIM STOPPED to counter COUNT
+    nrf_ppi_channel_t       ppi_stop;           // Counter COMPARE1 to group_run DISABLE and group_miss ENABLE
+    nrf_ppi_channel_t       ppi_miss;           // Trigger event to counter COUNT. In group_miss
+    nrf_ppi_channel_group_t group_run;
+    nrf_ppi_channel_group_t group_miss;
+    uint32_t                resources;          // RESOURCE_ flags
+    volatile bool           running;
+    bool                    initialized;
+}app_mpu_dma_t;
+
+
+static const nrf_drv_twi_t m_twi_instance = NRF_DRV_TWI_INSTANCE(APP_MPU_DMA_TWI_INSTANCE);
+static const nrf_drv_timer_t m_trigger_timer = NRF_DRV_TIMER_INSTANCE(APP_MPU_DMA_TRIGGER_TIMER_INSTANCE);
+static const nrf_drv_timer_t m_counter_timer = NRF_DRV_TIMER_INSTANCE(APP_MPU_DMA_COUNTER_TIMER_INSTANCE);
+static app_mpu_dma_t m_dma;
+
+
+
+static uint8_t * block_get(uint8_t block)
+{
+    return m_dma.config.p_buffer + (block * m_dma.config.depth * m_dma.config.sample_size);
+}
+
+
+
+static void evt_send(app_mpu_dma_evt_type_t type, uint8_t const * p_block, uint16_t num_samples)
+{
+    app_mpu_dma_evt_t evt;
+
+    evt.type        = type;
+    evt.p_block     = p_block;
+    evt.num_samples = num_samples;
+    m_dma.config.evt_handler(&evt, m_dma.config.p_context);
+}
+
+
+
+/**@brief Counter handler.
+ * COMPARE0 fires when the first half is full. The TWIM just continues into the second half.
+ * COMPARE1 fires when the second half is full. Through PPI it has already cleared the counter and
+ * disabled the trigger channel, so no read can run past the end of the buffer however late this
+ * handler is. While the trigger is off the counter counts the triggers that are missed instead.
+ * The RX pointer is moved back to the first half before the trigger is enabled again.
+ */
+static void counter_handler(nrf_timer_event_t event_type, void * p_context)
+{
+    if(event_type == NRF_TIMER_EVENT_COMPARE0)
+    {
+        // Reached by counting missed triggers while parked, or after app_mpu_dma_stop()
+        if(nrf_ppi_channel_enable_get(m_dma.ppi_trigger) == NRF_PPI_CHANNEL_DISABLED) return;
+
+        evt_send(APP_MPU_DMA_EVT_BLOCK_DONE, block_get(0), m_dma.config.depth);
+    }
+    else if(event_type == NRF_TIMER_EVENT_COMPARE1)
+    {
+        // No read is in progress, the last one ended with the STOPPED event that got us here
+        nrf_twim_rx_buffer_set(m_twi_instance.reg.p_twim, block_get(0), m_dma.config.sample_size);
+
+        // Stop counting missed triggers before the count is read. A trigger in the few cycles
+        // until group_run is enabled again is neither read nor counted
+        (void)nrf_drv_ppi_group_disable(m_dma.group_miss);
+        uint32_t missed = nrf_drv_timer_capture(&m_counter_timer, NRF_TIMER_CC_CHANNEL2);
+        if(missed != 0)
+        {
+            nrf_drv_timer_clear(&m_counter_timer);
+        }
+        if(m_dma.running)
+        {
+            (void)nrf_drv_ppi_group_enable(m_dma.group_run);
+        }
+
+        evt_send(APP_MPU_DMA_EVT_BLOCK_DONE, block_get(1), m_dma.config.depth);
+        if(missed != 0)
+        {
+            evt_send(APP_MPU_DMA_EVT_OVERRUN, NULL, missed);
+        }
+    }
+}
+
+
+
+// Only needed to keep the TWI driver non-blocking. Transfers are started and counted by PPI.
+static void trigger_handler(nrf_timer_event_t event_type, void * p_context)
+{
+    ;
+}
+
+
+
+static void twi_handler(nrf_drv_twi_evt_t const * p_event, void * p_context)
+{
+    // With NRF_DRV_TWI_FLAG_NO_XFER_EVT_HANDLER only errors are reported
+    if(p_event->type != NRF_DRV_TWI_EVT_DONE)
+    {
+        evt_send(APP_MPU_DMA_EVT_ERROR, NULL, 0);
+    }
+}
+
+
+
+static uint32_t xfer_arm(void)
+{
+    nrf_drv_twi_xfer_desc_t xfer = NRF_DRV_TWI_XFER_DESC_TXRX(MPU_ADDRESS,
+                                                              m_dma.tx_buffer, sizeof(m_dma.tx_buffer),
+                                                              block_get(0), m_dma.config.sample_size);
+
+    uint32_t flags =    NRF_DRV_TWI_FLAG_NO_XFER_EVT_HANDLER    | // Don't wake the CPU after each read
+                        NRF_DRV_TWI_FLAG_HOLD_XFER              | // Started by PPI
+                        NRF_DRV_TWI_FLAG_RX_POSTINC             | // ArrayList. Move RX pointer one sample after each read
+                        NRF_DRV_TWI_FLAG_REPEATED_XFER;
+
+    return nrf_drv_twi_xfer(&m_twi_instance, &xfer, flags);
+}
+
+
+
+/**@brief Function for releasing what app_mpu_dma_init() has taken so far */
+static void resources_release(void)
+{
+    if(m_dma.resources & RESOURCE_PPI_TRIGGER)   (void)nrf_drv_ppi_channel_free(m_dma.ppi_trigger);
+    if(m_dma.resources & RESOURCE_PPI_COUNT)     (void)nrf_drv_ppi_channel_free(m_dma.ppi_count);
+    if(m_dma.resources & RESOURCE_PPI_STOP)      (void)nrf_drv_ppi_channel_free(m_dma.ppi_stop);
+    if(m_dma.resources & RESOURCE_PPI_MISS)      (void)nrf_drv_ppi_channel_free(m_dma.ppi_miss);
+    if(m_dma.resources & RESOURCE_GROUP_RUN)     (void)nrf_drv_ppi_group_free(m_dma.group_run);
+    if(m_dma.resources & RESOURCE_GROUP_MISS)    (void)nrf_drv_ppi_group_free(m_dma.group_miss);
+    if(m_dma.resources & RESOURCE_TRIGGER_TIMER) nrf_drv_timer_uninit(&m_trigger_timer);
+    if(m_dma.resources & RESOURCE_COUNTER_TIMER) nrf_drv_timer_uninit(&m_counter_timer);
+    if(m_dma.resources & RESOURCE_TWI)           nrf_drv_twi_uninit(&m_twi_instance);
+    m_dma.resources = 0;
+}
+
+
+
+static uint32_t ppi_channel_setup(nrf_ppi_channel_t * p_channel, uint32_t resource, uint32_t eep, uint32_t tep)
+{
+    uint32_t err_code;
+
+    err_code = nrf_drv_ppi_channel_alloc(p_channel);
+    if(err_code != NRF_SUCCESS) return err_code;
+    m_dma.resources |= resource;
+
+    return nrf_drv_ppi_channel_assign(*p_channel, eep, tep);
+}
+
+
+
+static uint32_t ppi_setup(uint32_t trigger_event)
+{
+    uint32_t err_code;
+
+    err_code = nrf_drv_ppi_group_alloc(&m_dma.group_run);
+    if(err_code != NRF_SUCCESS) return err_code;
+    m_dma.resources |= RESOURCE_GROUP_RUN;
+
+    err_code = nrf_drv_ppi_group_alloc(&m_dma.group_miss);
+    if(err_code != NRF_SUCCESS) return err_code;
+    m_dma.resources |= RESOURCE_GROUP_MISS;
+
+    err_code = ppi_channel_setup(&m_dma.ppi_trigger, RESOURCE_PPI_TRIGGER, trigger_event,
+                                 nrf_drv_twi_start_task_get(&m_twi_instance, NRF_DRV_TWI_XFER_TXRX));
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_ppi_channel_include_in_group(m_dma.ppi_trigger, m_dma.group_run);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    err_code = ppi_channel_setup(&m_dma.ppi_count, RESOURCE_PPI_COUNT, nrf_drv_twi_stopped_event_get(&m_twi_instance),
+                                 nrf_drv_timer_task_address_get(&m_counter_timer, NRF_TIMER_TASK_COUNT));
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    // The last read into the buffer parks the trigger in hardware, and counts what is missed
+    err_code = ppi_channel_setup(&m_dma.ppi_stop, RESOURCE_PPI_STOP,
+                                 nrf_drv_timer_event_address_get(&m_counter_timer, NRF_TIMER_EVENT_COMPARE1),
+                                 nrf_drv_ppi_task_addr_group_disable_get(m_dma.group_run));
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_ppi_channel_fork_assign(m_dma.ppi_stop, nrf_drv_ppi_task_addr_group_enable_get(m_dma.group_miss));
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    err_code = ppi_channel_setup(&m_dma.ppi_miss, RESOURCE_PPI_MISS, trigger_event,
+                                 nrf_drv_timer_task_address_get(&m_counter_timer, NRF_TIMER_TASK_COUNT));
+    if(err_code != NRF_SUCCESS) return err_code;
+    return nrf_drv_ppi_channel_include_in_group(m_dma.ppi_miss, m_dma.group_miss);
+}
+
+
+
+static uint32_t peripherals_setup(app_mpu_dma_config_t const * p_config)
+{
+    uint32_t err_code;
+
+    const nrf_drv_twi_config_t twi_config = {
+       .scl                = MPU_TWI_SCL_PIN,
+       .sda                = MPU_TWI_SDA_PIN,
+       .frequency          = NRF_TWI_FREQ_400K,
+       .interrupt_priority = p_config->irq_priority
+    };
+    err_code = nrf_drv_twi_init(&m_twi_instance, &twi_config, twi_handler, NULL);
+    if(err_code != NRF_SUCCESS) return err_code;
+    m_dma.resources |= RESOURCE_TWI;
+    nrf_drv_twi_enable(&m_twi_instance);
+
+    // Counter counting finished reads. Interrupts when each half of the buffer is full
+    nrf_drv_timer_config_t counter_config = NRF_DRV_TIMER_DEFAULT_CONFIG;
+    counter_config.mode                 = NRF_TIMER_MODE_COUNTER;
+    counter_config.interrupt_priority   = p_config->irq_priority;
+    err_code = nrf_drv_timer_init(&m_counter_timer, &counter_config, counter_handler);
+    if(err_code != NRF_SUCCESS) return err_code;
+    m_dma.resources |= RESOURCE_COUNTER_TIMER;
+
+    nrf_drv_timer_extended_compare(&m_counter_timer, NRF_TIMER_CC_CHANNEL0, p_config->depth, (nrf_timer_short_mask_t)0, true);
+    nrf_drv_timer_extended_compare(&m_counter_timer, NRF_TIMER_CC_CHANNEL1, 2 * p_config->depth, NRF_TIMER_SHORT_COMPARE1_CLEAR_MASK, true);
+
+    // Timer triggering each read, unless an external trigger is used
+    if(p_config->trigger_event == 0)
+    {
+        nrf_drv_timer_config_t trigger_config = NRF_DRV_TIMER_DEFAULT_CONFIG;
+        err_code = nrf_drv_timer_init(&m_trigger_timer, &trigger_config, trigger_handler);
+        if(err_code != NRF_SUCCESS) return err_code;
+        m_dma.resources |= RESOURCE_TRIGGER_TIMER;
+
+        uint32_t ticks = nrf_drv_timer_us_to_ticks(&m_trigger_timer, p_config->sample_period_us);
+        nrf_drv_timer_extended_compare(&m_trigger_timer, NRF_TIMER_CC_CHANNEL0, ticks, NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK, false);
+    }
+
+    // Ignore error if the PPI driver is already initialized
+    err_code = nrf_drv_ppi_init();
+    if(err_code != NRF_SUCCESS && err_code != NRF_ERROR_MODULE_ALREADY_INITIALIZED) return err_code;
+
+    uint32_t trigger_event = p_config->trigger_event;
+    if(trigger_event == 0)
+    {
+        trigger_event = nrf_drv_timer_event_address_get(&m_trigger_timer, NRF_TIMER_EVENT_COMPARE0);
+    }
+    return ppi_setup(trigger_event);
+}
+
+
+
+uint32_t app_mpu_dma_init(app_mpu_dma_config_t const * p_config)
+{
+    uint32_t err_code;
+
+    if(m_dma.initialized) return NRF_ERROR_INVALID_STATE;
+    if(p_config == NULL || p_config->p_buffer == NULL || p_config->evt_handler == NULL) return NRF_ERROR_NULL;
+    if(p_config->sample_size == 0 || p_config->sample_size > MPU_SAMPLE_SIZE) return MPU_BAD_PARAMETER;
+    if(p_config->depth == 0) return MPU_BAD_PARAMETER;
+    if(p_config->trigger_event == 0 && p_config->sample_period_us == 0) return MPU_BAD_PARAMETER;
+
+    m_dma.config = *p_config;
+    m_dma.tx_buffer[0] = p_config->start_reg;
+
+    err_code = peripherals_setup(p_config);
+    if(err_code != NRF_SUCCESS)
+    {
+        resources_release();
+        return err_code;
+    }
+
+    m_dma.initialized = true;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_mpu_dma_start(void)
+{
+    uint32_t err_code;
+
+    if(!m_dma.initialized) return NRF_ERROR_INVALID_STATE;
+
+    err_code = xfer_arm();
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    nrf_drv_timer_clear(&m_counter_timer);
+    nrf_drv_timer_enable(&m_counter_timer);
+
+    err_code = nrf_drv_ppi_group_disable(m_dma.group_miss);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_ppi_channel_enable(m_dma.ppi_count);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_ppi_channel_enable(m_dma.ppi_stop);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    m_dma.running = true;
+    err_code = nrf_drv_ppi_group_enable(m_dma.group_run);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    if(m_dma.config.trigger_event == 0)
+    {
+        nrf_drv_timer_clear(&m_trigger_timer);
+        nrf_drv_timer_enable(&m_trigger_timer);
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t app_mpu_dma_stop(void)
+{
+    uint32_t err_code;
+
+    if(!m_dma.initialized) return NRF_ERROR_INVALID_STATE;
+
+    // Keeps a pending COMPARE1 handler from enabling the trigger again
+    m_dma.running = false;
+    if(m_dma.config.trigger_event == 0)
+    {
+        nrf_drv_timer_disable(&m_trigger_timer);
+    }
+
+    err_code = nrf_drv_ppi_group_disable(m_dma.group_run);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_ppi_group_disable(m_dma.group_miss);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_ppi_channel_disable(m_dma.ppi_stop);
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_ppi_channel_disable(m_dma.ppi_count);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    nrf_drv_timer_disable(&m_counter_timer);
+    return NRF_SUCCESS;
+}
+
+
+
+void app_mpu_dma_uninit(void)
+{
+    if(!m_dma.initialized) return;
+
+    (void)app_mpu_dma_stop();
+    resources_release();
+
+    m_dma.initialized = false;
+}
+
+#endif // defined(NRF52)
+
+/**
+  @}
+*/
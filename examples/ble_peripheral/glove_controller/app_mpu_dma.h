@@ -0,0 +1,158 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_MPU_DMA_H__
+#define APP_MPU_DMA_H__
+
+/* Autonomous MPU sampling on nRF52.
+ *
+ * A TIMER compare event (or any other event, e.g. a GPIOTE event from the MPU INT pin)
+ * starts a TWIM register read through PPI. The TWIM STOPPED event is counted by a second
+ * TIMER in counter mode, and TWIM ArrayList mode moves the RX pointer one sample forward
+ * after each read. The CPU is only woken when a block of samples is complete.
+ *
+ * The buffer is split in two halves. While the application handles one half, the
+ * TWIM writes into the other, so the CPU never reads a block that is being written.
+ * The read that fills the second half disables the trigger through a PPI group, so
+ * nothing is written past the end of the buffer until the CPU has moved the RX pointer
+ * back to the start. If that takes longer than a sample period, the triggers that are
+ * missed meanwhile are counted and reported with APP_MPU_DMA_EVT_OVERRUN.
+ *
+ * Requires TWIM (TWI0_USE_EASY_DMA), PPI and the two TIMER instances below to be enabled
+ * in sdk_config.h. The TWI instance must be released with nrf_drv_mpu_uninit() before
+ * app_mpu_dma_init() is called, and the MPU must be configured before that.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_mpu.h"
+#include "app_util_platform.h"
+
+#if defined(NRF52)
+
+#ifndef APP_MPU_DMA_TWI_INSTANCE
+#define APP_MPU_DMA_TWI_INSTANCE            0   // Same instance as nrf_drv_mpu_twi.c uses
+#endif
+#ifndef APP_MPU_DMA_TRIGGER_TIMER_INSTANCE
+#define APP_MPU_DMA_TRIGGER_TIMER_INSTANCE  1   // TIMER0 is used by the SoftDevice
+#endif
+#ifndef APP_MPU_DMA_COUNTER_TIMER_INSTANCE
+#define APP_MPU_DMA_COUNTER_TIMER_INSTANCE  2
+#endif
+
+/**@brief Size of the buffer needed for two blocks of 'depth' samples of 'sample_size' bytes each.
+ */
+#define APP_MPU_DMA_BUFFER_SIZE(sample_size, depth)     (2 * (depth) * (sample_size))
+
+/**@brief Register ranges that are useful to sample. Any range within MPU_SAMPLE_SIZE bytes can be used. */
+#define APP_MPU_DMA_ACCEL_REG       MPU_REG_ACCEL_XOUT_H
+#define APP_MPU_DMA_ACCEL_SIZE      6
+#define APP_MPU_DMA_GYRO_REG        MPU_REG_GYRO_XOUT_H
+#define APP_MPU_DMA_GYRO_SIZE       6
+#define APP_MPU_DMA_ALL_REG         MPU_REG_ACCEL_XOUT_H
+#define APP_MPU_DMA_ALL_SIZE        MPU_SAMPLE_SIZE
+
+
+
+/**@brief Events reported by the acquisition engine
+ */
+typedef enum
+{
+    APP_MPU_DMA_EVT_BLOCK_DONE,     // p_block holds num_samples samples in the MPUs big endian register order
+    APP_MPU_DMA_EVT_OVERRUN,        // num_samples triggers were missed because a block was re-armed late. Counts up to 2 * depth
+    APP_MPU_DMA_EVT_ERROR           // The MPU did not acknowledge a read. Sampling continues
+}app_mpu_dma_evt_type_t;
+
+typedef struct
+{
+    app_mpu_dma_evt_type_t  type;
+    uint8_t const         * p_block;
+    uint16_t                num_samples;
+}app_mpu_dma_evt_t;
+
+/**@brief Handler called from the counter TIMER interrupt.
+ * A block stays untouched by the TWIM until the other half has been filled,
+ * i.e. for 'depth' sample periods after the event.
+ */
+typedef void (* app_mpu_dma_evt_handler_t)(app_mpu_dma_evt_t const * p_evt, void * p_context);
+
+
+
+/**@brief Acquisition engine configuration
+ */
+typedef struct
+{
+    uint8_t                     start_reg;          // First MPU register of each sample
+    uint8_t                     sample_size;        // Bytes per sample. 1 to MPU_SAMPLE_SIZE
+    uint16_t                    depth;              // Samples per block
+    uint32_t                    sample_period_us;   // Sample period of the trigger timer. Not used if trigger_event is set
+    uint32_t                    trigger_event;      // Address of an event to trigger each read on instead of the timer. 0 to use the timer
+    uint8_t                   * p_buffer;           // APP_MPU_DMA_BUFFER_SIZE(sample_size, depth) bytes, in RAM
+    app_mpu_dma_evt_handler_t   evt_handler;
+    void                      * p_context;          // Passed to evt_handler
+    uint8_t                     irq_priority;       // Priority of the counter interrupt that re-arms the TWIM
+}app_mpu_dma_config_t;
+
+/**@brief Accelerometer, temperature and gyroscope sampled at 1 kHz, 32 samples per block */
+#define APP_MPU_DMA_DEFAULT_CONFIG(buffer, handler)     \
+    {                                                   \
+        .start_reg          = APP_MPU_DMA_ALL_REG,      \
+        .sample_size        = APP_MPU_DMA_ALL_SIZE,     \
+        .depth              = 32,                       \
+        .sample_period_us   = 1000,                     \
+        .trigger_event      = 0,                        \
+        .p_buffer           = buffer,                   \
+        .evt_handler        = handler,                  \
+        .p_context          = NULL,                     \
+        .irq_priority       = APP_IRQ_PRIORITY_HIGH     \
+    }
+
+
+
+/**@brief Function for initiating the acquisition engine
+ *
+ * Takes over the TWI instance, the two TIMER instances, four PPI channels and two PPI groups.
+ * If it fails, whatever it had taken is released again.
+ *
+ * @param[in]   p_config        Engine configuration
+ * @retval      uint32_t        Error code. MPU_BAD_PARAMETER if the sample size or depth is invalid
+ */
+uint32_t app_mpu_dma_init(app_mpu_dma_config_t const * p_config);
+
+
+
+/**@brief Function for starting sampling from the start of the buffer
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_dma_start(void);
+
+
+
+/**@brief Function for stopping sampling
+ *
+ * A read that is in progress is allowed to finish. Samples in a partially filled block are discarded.
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_mpu_dma_stop(void);
+
+
+
+/**@brief Function for releasing the TWI instance, TIMERs, PPI channels and PPI groups
+ *
+ * nrf_drv_mpu_init() can be called afterwards to use the blocking and queued app_mpu functions again.
+ */
+void app_mpu_dma_uninit(void);
+
+#endif // defined(NRF52)
+
+#endif /* APP_MPU_DMA_H__ */
+
+/**
+  @}
+*/
@@ -0,0 +1,301 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <math.h>
+#include "app_mpu_fusion.h"
+#include "nrf_error.h"
+
+#define FUSION_PI           3.14159265f
+
+typedef app_mpu_fusion_num_t num_t;
+
+/* The filter below is written once with these operations, so both paths run the same math.
+ * Unit vectors and the quaternion are kept within [-1, 1].
+ */
+#if APP_MPU_FUSION_USE_FLOAT
+
+#define NUM_ONE             1.0f
+#define NUM_HALF            0.5f
+#define MUL(a, b)           ((a) * (b))
+#define HALVE(a)            ((a) * 0.5f)
+#define GYRO(raw, scale)    ((raw) * (scale))
+#define NUM_FROM_FLOAT(f)   (f)
+
+#else
+
+#define NUM_ONE             (1L << 30)
+#define NUM_HALF            (1L << 29)
+#define MUL(a, b)           ((int32_t)(((int64_t)(a) * (b)) >> 30))
+#define HALVE(a)            ((a) >> 1)
+#define GYRO(raw, scale)    ((int32_t)(((int64_t)(raw) * (scale)) >> 16))    // Q46 scale to Q30
+#define NUM_FROM_FLOAT(f)   ((int32_t)((f) * (float)NUM_ONE))
+
+#endif
+
+
+
+#if APP_MPU_FUSION_USE_FLOAT
+
+static bool vector_normalize(int16_t x, int16_t y, int16_t z, num_t * p_out)
+{
+    float norm = sqrtf(((float)x * x) + ((float)y * y) + ((float)z * z));
+
+    if(norm == 0.0f) return false;
+
+    norm = 1.0f / norm;
+    p_out[0] = x * norm;
+    p_out[1] = y * norm;
+    p_out[2] = z * norm;
+    return true;
+}
+
+
+
+static num_t num_sqrt(num_t a)
+{
+    return sqrtf(a);
+}
+
+
+
+static void quat_normalize(num_t * q)
+{
+    float norm = 1.0f / sqrtf((q[0] * q[0]) + (q[1] * q[1]) + (q[2] * q[2]) + (q[3] * q[3]));
+
+    for(uint8_t i = 0; i < 4; i++)
+    {
+        q[i] *= norm;
+    }
+}
+
+#else
+
+static uint32_t isqrt(uint32_t a)
+{
+    uint32_t root = 0;
+    uint32_t bit  = 1UL << 30;
+
+    while(bit > a)
+    {
+        bit >>= 2;
+    }
+    while(bit != 0)
+    {
+        if(a >= root + bit)
+        {
+            a   -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+
+
+static bool vector_normalize(int16_t x, int16_t y, int16_t z, num_t * p_out)
+{
+    // Each square is at most 2^30, so the sum fits in 32 bits
+    uint32_t norm = isqrt((uint32_t)(x * x) + (uint32_t)(y * y) + (uint32_t)(z * z));
+    int64_t  inv;
+
+    if(norm == 0) return false;
+
+    // One division for all three components. |x| <= norm, so x * inv <= 2^46
+    inv = ((int64_t)1 << 46) / norm;
+    p_out[0] = (int32_t)((x * inv) >> 16);
+    p_out[1] = (int32_t)((y * inv) >> 16);
+    p_out[2] = (int32_t)((z * inv) >> 16);
+    return true;
+}
+
+
+
+static num_t num_sqrt(num_t a)
+{
+    // sqrt of a Q30 value is Q15. 15 bits are plenty for the magnetic reference
+    return (a > 0) ? (int32_t)(isqrt((uint32_t)a) << 15) : 0;
+}
+
+
+
+static void quat_normalize(num_t * q)
+{
+    // The quaternion only drifts slightly from unit length each update, so one
+    // Newton step for 1/sqrt(n2) around 1 is enough: 1/sqrt(n2) ~ (3 - n2) / 2
+    int32_t n2     = MUL(q[0], q[0]) + MUL(q[1], q[1]) + MUL(q[2], q[2]) + MUL(q[3], q[3]);
+    int32_t factor = NUM_ONE + ((NUM_ONE - n2) >> 1);
+
+    for(uint8_t i = 0; i < 4; i++)
+    {
+        q[i] = MUL(q[i], factor);
+    }
+}
+
+#endif
+
+
+
+static void fusion_update(app_mpu_fusion_t * p_fusion, int16_t ax, int16_t ay, int16_t az,
+                          int16_t gx, int16_t gy, int16_t gz, int16_t const * p_magn)
+{
+    num_t * q = p_fusion->q;
+    num_t   a[3];
+    num_t   e[3] = {0};     // Half the error between the measured and estimated directions
+    num_t   h[3];
+    num_t   q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3];
+
+    num_t q0q0 = MUL(q0, q0);
+    num_t q0q1 = MUL(q0, q1);
+    num_t q0q2 = MUL(q0, q2);
+    num_t q0q3 = MUL(q0, q3);
+    num_t q1q1 = MUL(q1, q1);
+    num_t q1q2 = MUL(q1, q2);
+    num_t q1q3 = MUL(q1, q3);
+    num_t q2q2 = MUL(q2, q2);
+    num_t q2q3 = MUL(q2, q3);
+    num_t q3q3 = MUL(q3, q3);
+
+    if(vector_normalize(ax, ay, az, a))
+    {
+        // Direction of gravity in the sensor frame as estimated from the quaternion
+        num_t vx = 2 * (q1q3 - q0q2);
+        num_t vy = 2 * (q0q1 + q2q3);
+        num_t vz = q0q0 - q1q1 - q2q2 + q3q3;
+
+        e[0] = HALVE(MUL(a[1], vz) - MUL(a[2], vy));
+        e[1] = HALVE(MUL(a[2], vx) - MUL(a[0], vz));
+        e[2] = HALVE(MUL(a[0], vy) - MUL(a[1], vx));
+
+        num_t m[3];
+        if(p_magn != NULL && vector_normalize(p_magn[0], p_magn[1], p_magn[2], m))
+        {
+            // Magnetic field in the earth frame, with the east component folded into north
+            num_t hx = 2 * (MUL(m[0], NUM_HALF - q2q2 - q3q3) + MUL(m[1], q1q2 - q0q3) + MUL(m[2], q1q3 + q0q2));
+            num_t hy = 2 * (MUL(m[0], q1q2 + q0q3) + MUL(m[1], NUM_HALF - q1q1 - q3q3) + MUL(m[2], q2q3 - q0q1));
+            num_t bz = 2 * (MUL(m[0], q1q3 - q0q2) + MUL(m[1], q2q3 + q0q1) + MUL(m[2], NUM_HALF - q1q1 - q2q2));
+            num_t bx = num_sqrt(MUL(hx, hx) + MUL(hy, hy));
+
+            // ... and back in the sensor frame
+            num_t wx = 2 * (MUL(bx, NUM_HALF - q2q2 - q3q3) + MUL(bz, q1q3 - q0q2));
+            num_t wy = 2 * (MUL(bx, q1q2 - q0q3) + MUL(bz, q0q1 + q2q3));
+            num_t wz = 2 * (MUL(bx, q0q2 + q1q3) + MUL(bz, NUM_HALF - q1q1 - q2q2));
+
+            e[0] += HALVE(MUL(m[1], wz) - MUL(m[2], wy));
+            e[1] += HALVE(MUL(m[2], wx) - MUL(m[0], wz));
+            e[2] += HALVE(MUL(m[0], wy) - MUL(m[1], wx));
+        }
+
+        for(uint8_t i = 0; i < 3; i++)
+        {
+            p_fusion->integral[i] += MUL(p_fusion->ki, e[i]);
+        }
+    }
+
+    // Half the rotation during this sample, with the PI feedback added
+    h[0] = GYRO(gx, p_fusion->gyro_scale) + MUL(p_fusion->kp, e[0]) + p_fusion->integral[0];
+    h[1] = GYRO(gy, p_fusion->gyro_scale) + MUL(p_fusion->kp, e[1]) + p_fusion->integral[1];
+    h[2] = GYRO(gz, p_fusion->gyro_scale) + MUL(p_fusion->kp, e[2]) + p_fusion->integral[2];
+
+    // q += q * (0, h)
+    q[0] = q0 - MUL(q1, h[0]) - MUL(q2, h[1]) - MUL(q3, h[2]);
+    q[1] = q1 + MUL(q0, h[0]) + MUL(q2, h[2]) - MUL(q3, h[1]);
+    q[2] = q2 + MUL(q0, h[1]) - MUL(q1, h[2]) + MUL(q3, h[0]);
+    q[3] = q3 + MUL(q0, h[2]) + MUL(q1, h[1]) - MUL(q2, h[0]);
+
+    quat_normalize(q);
+}
+
+
+
+uint32_t app_mpu_fusion_init(app_mpu_fusion_t * p_fusion, app_mpu_fusion_config_t const * p_config)
+{
+    float dt;
+    float gyro_scale;
+
+    if(p_config->sample_period_us == 0 || p_config->gyro_fs > GFS_2000DPS) return MPU_BAD_PARAMETER;
+
+    // Half the angle turned per gyroscope LSB in one sample period
+    dt         = p_config->sample_period_us * 1e-6f;
+    gyro_scale = ((250 << p_config->gyro_fs) * (FUSION_PI / 180.0f) / 32768.0f) * (dt / 2.0f);
+
+#if APP_MPU_FUSION_USE_FLOAT
+    p_fusion->gyro_scale = gyro_scale;
+#else
+    gyro_scale *= (float)(1ULL << 46);
+    if(gyro_scale >= (float)INT32_MAX) return MPU_BAD_PARAMETER;
+    p_fusion->gyro_scale = (int32_t)(gyro_scale + 0.5f);
+#endif
+
+    // The error is kept halved, so the gains are doubled from kp * dt / 2 and ki * dt * dt / 2
+    p_fusion->kp = NUM_FROM_FLOAT(p_config->kp * dt);
+    p_fusion->ki = NUM_FROM_FLOAT(p_config->ki * dt * dt);
+
+    p_fusion->q[0] = NUM_ONE;
+    p_fusion->q[1] = 0;
+    p_fusion->q[2] = 0;
+    p_fusion->q[3] = 0;
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        p_fusion->integral[i] = 0;
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+void app_mpu_fusion_update(app_mpu_fusion_t * p_fusion, accel_values_t const * p_accel,
+                           gyro_values_t const * p_gyro, int16_t const * p_magn)
+{
+    fusion_update(p_fusion, p_accel->x, p_accel->y, p_accel->z, p_gyro->x, p_gyro->y, p_gyro->z, p_magn);
+}
+
+
+
+void app_mpu_fusion_update_burst(app_mpu_fusion_t * p_fusion, uint8_t const * p_burst, int16_t const * p_magn)
+{
+    int16_t v[MPU_SAMPLE_SIZE / 2];
+
+    // Big endian accel x, y, z, temp, gyro x, y, z
+    for(uint8_t i = 0; i < MPU_SAMPLE_SIZE / 2; i++)
+    {
+        v[i] = (int16_t)((p_burst[2 * i] << 8) | p_burst[(2 * i) + 1]);
+    }
+    fusion_update(p_fusion, v[0], v[1], v[2], v[4], v[5], v[6], p_magn);
+}
+
+
+
+void app_mpu_fusion_quat_get(app_mpu_fusion_t const * p_fusion, app_mpu_fusion_quat_t * p_quat)
+{
+    int16_t q14[4];
+
+    for(uint8_t i = 0; i < 4; i++)
+    {
+#if APP_MPU_FUSION_USE_FLOAT
+        float v = p_fusion->q[i] * 16384.0f;
+        q14[i] = (int16_t)((v >= 0.0f) ? (v + 0.5f) : (v - 0.5f));
+#else
+        q14[i] = (int16_t)((p_fusion->q[i] + (1L << 15)) >> 16);
+#endif
+    }
+    p_quat->w = q14[0];
+    p_quat->x = q14[1];
+    p_quat->y = q14[2];
+    p_quat->z = q14[3];
+}
+
+
+/**
+  @}
+*/
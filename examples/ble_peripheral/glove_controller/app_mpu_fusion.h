@@ -0,0 +1,130 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_MPU_FUSION_H__
+#define APP_MPU_FUSION_H__
+
+/* Orientation estimation (AHRS) with a Mahony complementary filter.
+ *
+ * The gyroscope is integrated into a quaternion at the sample rate. The error between the
+ * measured and the estimated direction of gravity (and of magnetic north, when magnetometer
+ * values are given) is fed back through a PI controller to cancel gyroscope drift.
+ *
+ * The nRF51 Cortex-M0 has no FPU, so the filter runs in fixed point there. The quaternion
+ * and all unit vectors are Q30 and the products are formed with 32x32->64 bit multiplies.
+ * The nRF52 Cortex-M4F runs the same filter in single precision float.
+ * Define APP_MPU_FUSION_USE_FLOAT to 0 or 1 to override the choice.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_mpu.h"
+
+#ifndef APP_MPU_FUSION_USE_FLOAT
+#if defined(NRF52)
+#define APP_MPU_FUSION_USE_FLOAT    1   // Cortex-M4F
+#else
+#define APP_MPU_FUSION_USE_FLOAT    0   // Cortex-M0 has no FPU
+#endif
+#endif
+
+#if APP_MPU_FUSION_USE_FLOAT
+typedef float   app_mpu_fusion_num_t;
+#else
+typedef int32_t app_mpu_fusion_num_t;   // Q30
+#endif
+
+
+
+/**@brief Orientation quaternion in Q14 fixed point, so 1.0 is 16384 */
+typedef struct
+{
+    int16_t w;
+    int16_t x;
+    int16_t y;
+    int16_t z;
+}app_mpu_fusion_quat_t;
+
+/**@brief Filter configuration. Only used by app_mpu_fusion_init(), so the fixed point path pays for the floats once
+ */
+typedef struct
+{
+    uint32_t    sample_period_us;   // Time between the samples passed to the update functions
+    uint8_t     gyro_fs;            // enum gyro_range the MPU is configured with
+    float       kp;                 // Proportional gain. Higher trusts the accelerometer and magnetometer more
+    float       ki;                 // Integral gain. Corrects gyroscope bias. 0 to disable
+}app_mpu_fusion_config_t;
+
+/**@brief Gains commonly used with Mahony's filter */
+#define APP_MPU_FUSION_DEFAULT_CONFIG(period_us)    \
+    {                                               \
+        .sample_period_us   = period_us,            \
+        .gyro_fs            = GFS_2000DPS,          \
+        .kp                 = 1.0f,                 \
+        .ki                 = 0.0f,                 \
+    }
+
+/**@brief Filter state. One per sensor
+ */
+typedef struct
+{
+    app_mpu_fusion_num_t    q[4];           // w, x, y, z
+    app_mpu_fusion_num_t    integral[3];    // Integral feedback, as half angle per sample
+    app_mpu_fusion_num_t    gyro_scale;     // Half angle per sample per gyroscope LSB. Q46 in the fixed point path
+    app_mpu_fusion_num_t    kp;             // kp * dt / 2
+    app_mpu_fusion_num_t    ki;             // ki * dt * dt / 2
+}app_mpu_fusion_t;
+
+
+
+/**@brief Function for initiating a filter at the identity orientation
+ *
+ * @param[out]  p_fusion        Filter state
+ * @param[in]   p_config        Filter configuration
+ * @retval      uint32_t        Error code. MPU_BAD_PARAMETER if the sample period or gyro_fs is out of range
+ */
+uint32_t app_mpu_fusion_init(app_mpu_fusion_t * p_fusion, app_mpu_fusion_config_t const * p_config);
+
+
+
+/**@brief Function for running the filter on one accelerometer and gyroscope sample
+ *
+ * @param[in]   p_fusion        Filter state
+ * @param[in]   p_accel         Accelerometer values. Any full scale range
+ * @param[in]   p_gyro          Gyroscope values, in the range given by gyro_fs
+ * @param[in]   p_magn          Magnetometer x, y and z, rotated into the accelerometer axes.
+ *                              Any unit. NULL for 6-axis fusion
+ */
+void app_mpu_fusion_update(app_mpu_fusion_t * p_fusion, accel_values_t const * p_accel,
+                           gyro_values_t const * p_gyro, int16_t const * p_magn);
+
+
+
+/**@brief Function for running the filter on one burst read sample
+ *
+ * @param[in]   p_fusion        Filter state
+ * @param[in]   p_burst         MPU_SAMPLE_SIZE bytes from MPU_REG_ACCEL_XOUT_H in register order,
+ *                              as the app_mpu_dma engine delivers them
+ * @param[in]   p_magn          As for app_mpu_fusion_update()
+ */
+void app_mpu_fusion_update_burst(app_mpu_fusion_t * p_fusion, uint8_t const * p_burst, int16_t const * p_magn);
+
+
+
+/**@brief Function for getting the current orientation
+ *
+ * @param[in]   p_fusion        Filter state
+ * @param[out]  p_quat          Orientation of the sensor relative to the earth frame
+ */
+void app_mpu_fusion_quat_get(app_mpu_fusion_t const * p_fusion, app_mpu_fusion_quat_t * p_quat);
+
+
+#endif /* APP_MPU_FUSION_H__ */
+
+/**
+  @}
+*/
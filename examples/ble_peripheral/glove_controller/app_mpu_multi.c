@@ -0,0 +1,170 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_mpu_multi.h"
+#include "nrf_error.h"
+#include "app_util_platform.h"
+
+
+/**@brief State of the reads in progress */
+typedef struct
+{
+    app_mpu_t             * p_mpus;
+    uint8_t                 count;
+    uint8_t                 scheduled;      // Reads queued in the bus driver, or failed to queue
+    uint8_t                 done;           // Reads finished
+    uint32_t                result;         // Of the first read that failed
+    app_mpu_evt_handler_t   evt_handler;
+    void                  * p_context;
+    volatile bool           busy;
+}app_mpu_multi_t;
+
+static app_mpu_multi_t m_multi;
+
+
+
+uint32_t app_mpu_multi_init(app_mpu_t * p_mpus, uint8_t count)
+{
+    uint32_t err_code;
+
+    if(p_mpus == NULL) return NRF_ERROR_NULL;
+    if(count == 0 || count > APP_MPU_MULTI_MAX) return MPU_BAD_PARAMETER;
+    if(m_multi.busy) return NRF_ERROR_BUSY;
+
+    for(uint8_t i = 0; i < count; i++)
+    {
+        app_mpu_t * p_mpu = &p_mpus[i];
+
+        err_code = nrf_drv_mpu_dev_init(p_mpu->dev);
+        if(err_code != NRF_SUCCESS) return err_code;
+
+        uint8_t reset_value = 7; // Resets gyro, accelerometer and temperature sensor signal paths.
+        err_code = nrf_drv_mpu_dev_write_registers(p_mpu->dev, MPU_REG_SIGNAL_PATH_RESET, &reset_value, 1);
+        if(err_code != NRF_SUCCESS) return err_code;
+
+        // Chose  PLL with X axis gyroscope reference as clock source
+        uint8_t pwr_mgmt_1 = 1;
+        err_code = nrf_drv_mpu_dev_write_registers(p_mpu->dev, MPU_REG_PWR_MGMT_1, &pwr_mgmt_1, 1);
+        if(err_code != NRF_SUCCESS) return err_code;
+
+        err_code = nrf_drv_mpu_dev_write_registers(p_mpu->dev, MPU_REG_SMPLRT_DIV, (uint8_t*)&p_mpu->config, 4);
+        if(err_code != NRF_SUCCESS) return err_code;
+
+        p_mpu->result = NRF_ERROR_INVALID_STATE; // Not read yet
+    }
+
+    m_multi.p_mpus = p_mpus;
+    m_multi.count  = count;
+    return NRF_SUCCESS;
+}
+
+
+
+static void reads_schedule(void);
+
+static void read_handler(uint32_t result, void * p_context)
+{
+    app_mpu_t * p_mpu = (app_mpu_t *)p_context;
+
+    p_mpu->result = result;
+
+    CRITICAL_REGION_ENTER();
+    if(result != NRF_SUCCESS && m_multi.result == NRF_SUCCESS)
+    {
+        m_multi.result = result;
+    }
+    m_multi.done++;
+    CRITICAL_REGION_EXIT();
+
+    reads_schedule();
+}
+
+
+
+/**@brief Function for queueing the next reads, round-robin, as long as the bus driver takes them.
+ * Called when the reads are started and when each read is done, so the queue is kept full.
+ */
+static void reads_schedule(void)
+{
+    bool finished = false;
+
+    CRITICAL_REGION_ENTER();
+    while(m_multi.scheduled < m_multi.count)
+    {
+        app_mpu_t * p_mpu = &m_multi.p_mpus[m_multi.scheduled];
+        uint32_t err_code;
+
+        err_code = nrf_drv_mpu_dev_read_registers_async(p_mpu->dev, MPU_REG_ACCEL_XOUT_H, p_mpu->raw, MPU_SAMPLE_SIZE,
+                                                        read_handler, p_mpu);
+        if(err_code == NRF_ERROR_BUSY && m_multi.scheduled > m_multi.done)
+        {
+            break; // Queue full. The next read that is done queues this one
+        }
+        m_multi.scheduled++;
+        if(err_code != NRF_SUCCESS)
+        {
+            p_mpu->result = err_code;
+            if(m_multi.result == NRF_SUCCESS) m_multi.result = err_code;
+            m_multi.done++;
+        }
+    }
+    if(m_multi.busy && m_multi.done == m_multi.count)
+    {
+        m_multi.busy = false;
+        finished = true;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(finished && m_multi.evt_handler != NULL)
+    {
+        m_multi.evt_handler(m_multi.result, m_multi.p_context);
+    }
+}
+
+
+
+uint32_t app_mpu_multi_read_async(app_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    if(m_multi.count == 0) return NRF_ERROR_INVALID_STATE;
+    if(m_multi.busy) return NRF_ERROR_BUSY;
+
+    m_multi.scheduled   = 0;
+    m_multi.done        = 0;
+    m_multi.result      = NRF_SUCCESS;
+    m_multi.evt_handler = evt_handler;
+    m_multi.p_context   = p_context;
+    m_multi.busy        = true;
+
+    reads_schedule();
+    return NRF_SUCCESS;
+}
+
+
+
+bool app_mpu_multi_busy(void)
+{
+    return m_multi.busy;
+}
+
+
+
+void app_mpu_multi_sample_get(app_mpu_t const * p_mpu, imu_sample_t * p_sample)
+{
+    uint8_t * p_values = (uint8_t *)p_sample;
+
+    // imu_sample_t is in reverse register order, so reversing the bytes also swaps them to little endian
+    for(uint8_t i = 0; i < MPU_SAMPLE_SIZE; i++)
+    {
+        p_values[i] = p_mpu->raw[MPU_SAMPLE_SIZE - 1 - i];
+    }
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,100 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_MPU_MULTI_H__
+#define APP_MPU_MULTI_H__
+
+/* Several MPUs on one bus, e.g. one on the back of the hand and one on each finger.
+ *
+ * Each MPU has an app_mpu_t handle with its place on the bus and its configuration. On TWI that
+ * is the address, MPU_ADDRESS or MPU_ADDRESS_AD0_HIGH, so two MPUs per bus. On SPI it is the CS
+ * pin, so as many as there are pins. The app_mpu functions keep working on the MPU at
+ * NRF_DRV_MPU_DEV_DEFAULT, which can be in the list as well.
+ *
+ * app_mpu_multi_read_async() reads accelerometer, temperature and gyroscope of every MPU, one
+ * burst read per MPU. The reads are queued in the bus driver round-robin, as many as the queue
+ * takes, and each read that is done queues the next one. So the bus runs the reads back to back,
+ * and the handles are set up once, in app_mpu_multi_init(), and not for each read.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_mpu.h"
+#include "nrf_drv_mpu.h"
+
+#ifndef APP_MPU_MULTI_MAX
+#define APP_MPU_MULTI_MAX       8   // MPUs in one list
+#endif
+
+
+/**@brief One MPU
+ */
+typedef struct
+{
+    nrf_drv_mpu_dev_t   dev;                    // TWI address or SPI CS pin
+    app_mpu_config_t    config;
+    uint8_t             raw[MPU_SAMPLE_SIZE];   // Last read, in the MPUs big endian register order
+    uint32_t            result;                 // Error code of the last read
+}app_mpu_t;
+
+/**@brief Handle of an MPU with the default configuration */
+#define APP_MPU_INSTANCE(dev_)                  \
+    {                                           \
+        .dev    = dev_,                         \
+        .config = MPU_DEFAULT_CONFIG(),         \
+    }
+
+
+
+/**@brief Function for setting up the MPUs
+ *
+ * Call after app_mpu_init(), which starts the bus. Each MPU has its signal paths reset, is woken
+ * up with the gyroscope PLL as clock and gets its configuration. The list must stay valid
+ * while it is used.
+ *
+ * @param[in]   p_mpus          MPUs
+ * @param[in]   count           Number of MPUs. 1 to APP_MPU_MULTI_MAX
+ * @retval      uint32_t        Error code of the first MPU that failed
+ */
+uint32_t app_mpu_multi_init(app_mpu_t * p_mpus, uint8_t count);
+
+
+
+/**@brief Function for reading all the MPUs without waiting for it
+ *
+ * The result of each read is in its handle. evt_handler gets NRF_SUCCESS if all were read, or
+ * the error code of the first that failed.
+ *
+ * @param[in]   evt_handler     Function called from interrupt context when all reads are done. Can be NULL
+ * @param[in]   p_context       Context passed to evt_handler
+ * @retval      uint32_t        Error code. NRF_ERROR_BUSY if the last reads are not done
+ */
+uint32_t app_mpu_multi_read_async(app_mpu_evt_handler_t evt_handler, void * p_context);
+
+
+
+/**@brief Function for finding out if reads are in progress
+ *
+ * @retval      bool            true until the handler of app_mpu_multi_read_async() is called
+ */
+bool app_mpu_multi_busy(void);
+
+
+
+/**@brief Function for the last sample read from an MPU
+ *
+ * @param[in]   p_mpu           MPU
+ * @param[out]  p_sample        Sample, as app_mpu_read_all() returns it
+ */
+void app_mpu_multi_sample_get(app_mpu_t const * p_mpu, imu_sample_t * p_sample);
+
+
+#endif /* APP_MPU_MULTI_H__ */
+
+/**
+  @}
+*/
@@ -0,0 +1,118 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_sync.h"
+#include "nrf_error.h"
+
+
+
+/**@brief Function for the signed number of ticks from b to a, across a wrap of the counter
+ */
+static int32_t tick_diff(uint32_t a, uint32_t b)
+{
+    return (int32_t)(((a - b) & APP_SYNC_TIMESTAMP_MASK) << 8) >> 8;
+}
+
+
+
+static uint8_t slot_get(app_sync_stream_t const * p_stream, uint8_t n)
+{
+    return (p_stream->oldest + n) % APP_SYNC_HISTORY_SIZE;
+}
+
+
+
+uint32_t app_sync_stream_init(app_sync_stream_t * p_stream, uint8_t channels, app_sync_mode_t mode)
+{
+    if(channels == 0 || channels > APP_SYNC_MAX_CHANNELS) return NRF_ERROR_INVALID_PARAM;
+
+    memset(p_stream, 0, sizeof(*p_stream));
+    p_stream->channels = channels;
+    p_stream->mode     = mode;
+    return NRF_SUCCESS;
+}
+
+
+
+void app_sync_stream_reset(app_sync_stream_t * p_stream)
+{
+    p_stream->oldest = 0;
+    p_stream->count  = 0;
+}
+
+
+
+void app_sync_push(app_sync_stream_t * p_stream, uint32_t timestamp, int16_t const * p_values)
+{
+    uint8_t slot;
+
+    timestamp &= APP_SYNC_TIMESTAMP_MASK;
+    if(p_stream->count > 0 && tick_diff(timestamp, p_stream->timestamp[slot_get(p_stream, p_stream->count - 1)]) < 0)
+    {
+        return;
+    }
+
+    if(p_stream->count == APP_SYNC_HISTORY_SIZE)
+    {
+        p_stream->oldest = slot_get(p_stream, 1);
+        p_stream->count--;
+    }
+    slot = slot_get(p_stream, p_stream->count++);
+    p_stream->timestamp[slot] = timestamp;
+    memcpy(p_stream->values[slot], p_values, p_stream->channels * sizeof(int16_t));
+}
+
+
+
+bool app_sync_resample(app_sync_stream_t const * p_stream, uint32_t timestamp, int16_t * p_values)
+{
+    uint8_t n;
+    uint8_t before;
+    uint8_t after;
+    int32_t span;
+    int32_t offset;
+
+    if(p_stream->count == 0) return false;
+
+    // Newest sample at or before the timestamp. Held if the timestamp is before the history
+    n = p_stream->count - 1;
+    while(n > 0 && tick_diff(timestamp, p_stream->timestamp[slot_get(p_stream, n)]) < 0)
+    {
+        n--;
+    }
+    before = slot_get(p_stream, n);
+
+    if(p_stream->mode == APP_SYNC_MODE_HOLD || n == p_stream->count - 1)
+    {
+        memcpy(p_values, p_stream->values[before], p_stream->channels * sizeof(int16_t));
+        return true;
+    }
+
+    after  = slot_get(p_stream, n + 1);
+    span   = tick_diff(p_stream->timestamp[after], p_stream->timestamp[before]);
+    offset = tick_diff(timestamp, p_stream->timestamp[before]);
+    if(offset < 0)    offset = 0;
+    if(offset > span) offset = span;
+    while(span > INT16_MAX)
+    {
+        span   >>= 1; // Keeps delta * offset within int32_t after a long gap
+        offset >>= 1;
+    }
+    for(uint8_t c = 0; c < p_stream->channels; c++)
+    {
+        int32_t delta = (int32_t)p_stream->values[after][c] - p_stream->values[before][c];
+        p_values[c] = (span == 0) ? p_stream->values[after][c] :
+                      (int16_t)(p_stream->values[before][c] + ((delta * offset) / span));
+    }
+    return true;
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,102 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_SYNC_H__
+#define APP_SYNC_H__
+
+/* Alignment of sensors that run on different clocks onto one timeline.
+ *
+ * The IMU samples on the MPU clock, the magnetometer on its own and the flex sensors on a
+ * TIMER. Each sample is stamped with app_timer_cnt_get() when it is captured and pushed to
+ * the history of its stream. The slower streams are then resampled at the timestamps of the
+ * IMU samples, so each IMU sample can be sent with the other sensors as one tuple.
+ *
+ *  - APP_SYNC_MODE_HOLD:   the newest sample taken at or before the timestamp
+ *  - APP_SYNC_MODE_LINEAR: interpolated between the samples either side of the timestamp
+ *
+ * Outside the history the oldest or newest sample is held, there is no extrapolation.
+ * Timestamps are 24 bit RTC ticks and may wrap, as long as the history spans less than half
+ * the counter range.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define APP_SYNC_MAX_CHANNELS       8
+#define APP_SYNC_TIMESTAMP_MASK     0x00FFFFFF  // app_timer runs on the 24 bit RTC counter
+
+#ifndef APP_SYNC_HISTORY_SIZE
+#define APP_SYNC_HISTORY_SIZE       16          // Samples kept per stream. Must span the delay before the IMU samples are aligned
+#endif
+
+/**@brief Resampling modes
+ */
+typedef enum
+{
+    APP_SYNC_MODE_HOLD,
+    APP_SYNC_MODE_LINEAR
+}app_sync_mode_t;
+
+/**@brief History of one stream. Oldest sample at 'oldest', in time order
+ */
+typedef struct
+{
+    app_sync_mode_t mode;
+    uint8_t         channels;
+    uint8_t         oldest;
+    uint8_t         count;
+    uint32_t        timestamp[APP_SYNC_HISTORY_SIZE];
+    int16_t         values[APP_SYNC_HISTORY_SIZE][APP_SYNC_MAX_CHANNELS];
+}app_sync_stream_t;
+
+
+
+/**@brief Function for initiating a stream with an empty history
+ *
+ * @param[out]  p_stream        Stream state
+ * @param[in]   channels        Values per sample, 1 to APP_SYNC_MAX_CHANNELS
+ * @param[in]   mode            How the stream is resampled
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_sync_stream_init(app_sync_stream_t * p_stream, uint8_t channels, app_sync_mode_t mode);
+
+
+
+/**@brief Function for emptying the history of a stream, e.g. when the sensor is restarted
+ *
+ * @param[in]   p_stream        Stream state
+ */
+void app_sync_stream_reset(app_sync_stream_t * p_stream);
+
+
+
+/**@brief Function for adding a sample. The oldest is dropped when the history is full
+ *
+ * Samples must be pushed in time order. A sample older than the newest one is ignored.
+ *
+ * @param[in]   p_stream        Stream state
+ * @param[in]   timestamp       app_timer ticks when the sample was captured
+ * @param[in]   p_values        'channels' values
+ */
+void app_sync_push(app_sync_stream_t * p_stream, uint32_t timestamp, int16_t const * p_values);
+
+
+
+/**@brief Function for resampling a stream at a timestamp
+ *
+ * @param[in]   p_stream        Stream state
+ * @param[in]   timestamp       app_timer ticks to resample at
+ * @param[out]  p_values        'channels' values. Left untouched if the history is empty
+ * @retval      bool            false if the history is empty
+ */
+bool app_sync_resample(app_sync_stream_t const * p_stream, uint32_t timestamp, int16_t * p_values);
+
+
+#endif /* APP_SYNC_H__ */
+
+/**
+  @}
+*/
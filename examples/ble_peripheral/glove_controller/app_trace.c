@@ -0,0 +1,268 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_trace.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "nrf.h"
+#include "nrf_error.h"
+
+#define BUFFER_MASK                 (APP_TRACE_BUFFER_SIZE - 1)
+
+#if defined(NRF52)
+#define TIME_MASK                   0xFFFFFFFF  // DWT cycle counter, wraps after 67 s at 64 MHz
+#define TICKS_TO_US(ticks)          ((ticks) / (SystemCoreClock / 1000000))
+#else
+#define TIMER_PRESCALER             7           // 125 kHz. The 16 bit counter wraps after 524 ms
+#define TIME_MASK                   0xFFFF
+#define TICKS_TO_US(ticks)          ((ticks) * 8)
+#endif
+
+STATIC_ASSERT((APP_TRACE_BUFFER_SIZE & BUFFER_MASK) == 0);
+#if !defined(NRF52)
+STATIC_ASSERT(TICKS_TO_US(TIME_MASK + 1) == APP_TRACE_TIME_WRAP_US);
+#endif
+
+/**@brief One event. lap is written last, so the reader can tell a finished record from a stale one
+ */
+typedef struct
+{
+    uint32_t            time;
+    uint16_t            id;
+    uint8_t             evt;
+    volatile uint8_t    lap;
+}trace_record_t;
+
+typedef struct
+{
+    uint32_t            time;
+    uint16_t            id;
+    bool                valid;
+}trace_last_t;
+
+static trace_record_t       m_ring[APP_TRACE_BUFFER_SIZE];
+static volatile uint32_t    m_write;                            // Next slot to reserve
+static uint32_t             m_read;                             // Next slot to process
+static trace_last_t         m_last[APP_TRACE_EVT_COUNT];        // Latest event of each stage
+static app_trace_stats_t    m_stats[APP_TRACE_EVT_COUNT];
+static app_trace_dump_handler_t m_dump_handler;
+
+
+
+/**@brief Lap of the ring an index falls in. Starts at 1 so zeroed slots never match */
+static uint8_t lap_get(uint32_t index)
+{
+    return (uint8_t)((index / APP_TRACE_BUFFER_SIZE) + 1);
+}
+
+
+
+static uint32_t time_get(void)
+{
+#if defined(NRF52)
+    return DWT->CYCCNT;
+#else
+    // One capture register for thread mode and one for interrupts, so the main loop is not
+    // disturbed by an interrupt stamping in between its capture and read
+    uint8_t cc = (__get_IPSR() == 0) ? 0 : 1;
+
+    APP_TRACE_TIMER->TASKS_CAPTURE[cc] = 1;
+    return APP_TRACE_TIMER->CC[cc];
+#endif
+}
+
+
+
+static uint8_t bucket_get(uint32_t us)
+{
+    uint8_t bucket = 0;
+
+    while(us > 1 && bucket < APP_TRACE_HISTOGRAM_SIZE - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+
+
+static void stats_add(app_trace_stats_t * p_stats, uint32_t us)
+{
+    uint8_t bucket = bucket_get(us);
+
+    if(p_stats->count == 0 || us < p_stats->min) p_stats->min = us;
+    if(us > p_stats->max) p_stats->max = us;
+    p_stats->count++;
+    p_stats->sum += us;
+    if(p_stats->histogram[bucket] < UINT16_MAX)
+    {
+        p_stats->histogram[bucket]++;
+    }
+}
+
+
+
+static void record_handle(trace_record_t const * p_record)
+{
+    if(p_record->evt >= APP_TRACE_EVT_COUNT) return;
+
+    if(m_dump_handler != NULL)
+    {
+        m_dump_handler((app_trace_evt_t)p_record->evt, p_record->id, TICKS_TO_US(p_record->time & TIME_MASK));
+    }
+
+    // Latency from the latest earlier stage this id has passed. Stages can be skipped, e.g. fusion
+    for(int8_t k = (int8_t)p_record->evt - 1; k >= 0; k--)
+    {
+        trace_last_t const * p_last = &m_last[k];
+
+        if(p_last->valid && (p_record->id == APP_TRACE_ID_NONE || p_last->id == APP_TRACE_ID_NONE || p_last->id == p_record->id))
+        {
+            stats_add(&m_stats[p_record->evt], TICKS_TO_US((p_record->time - p_last->time) & TIME_MASK));
+            break;
+        }
+    }
+
+    m_last[p_record->evt].time  = p_record->time;
+    m_last[p_record->evt].id    = p_record->id;
+    m_last[p_record->evt].valid = true;
+}
+
+
+
+uint32_t app_trace_init(void)
+{
+#if defined(NRF52)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT       = 0;
+    DWT->CTRL        |= DWT_CTRL_CYCCNTENA_Msk;
+#else
+    APP_TRACE_TIMER->MODE        = TIMER_MODE_MODE_Timer;
+    APP_TRACE_TIMER->BITMODE     = TIMER_BITMODE_BITMODE_16Bit;
+    APP_TRACE_TIMER->PRESCALER   = TIMER_PRESCALER;
+    APP_TRACE_TIMER->TASKS_CLEAR = 1;
+    APP_TRACE_TIMER->TASKS_START = 1;
+#endif
+    app_trace_stats_reset();
+    return NRF_SUCCESS;
+}
+
+
+
+void app_trace_record(app_trace_evt_t evt, uint16_t id)
+{
+    uint32_t         time = time_get();
+    uint32_t         index;
+    trace_record_t * p_record;
+
+#if defined(NRF52)
+    do
+    {
+        index = __LDREXW((uint32_t *)&m_write);
+    } while(__STREXW(index + 1, (uint32_t *)&m_write) != 0);
+#else
+    CRITICAL_REGION_ENTER(); // No LDREX/STREX on Cortex-M0
+    index = m_write++;
+    CRITICAL_REGION_EXIT();
+#endif
+
+    p_record       = &m_ring[index & BUFFER_MASK];
+    p_record->time = time;
+    p_record->id   = id;
+    p_record->evt  = (uint8_t)evt;
+    __DMB();
+    p_record->lap  = lap_get(index);
+}
+
+
+
+uint32_t app_trace_process(void)
+{
+    uint32_t lost = 0;
+
+    for(;;)
+    {
+        trace_record_t * p_slot   = &m_ring[m_read & BUFFER_MASK];
+        uint8_t          expected = lap_get(m_read);
+        uint8_t          lap      = p_slot->lap;
+        trace_record_t   record;
+
+        if(lap != expected)
+        {
+            if((int8_t)(lap - expected) <= 0)
+            {
+                break; // Not written yet
+            }
+            lost++; // Written over by a later lap before it was read
+            m_read++;
+            continue;
+        }
+
+        __DMB();
+        record = *p_slot;
+        __DMB();
+        if(p_slot->lap != lap)
+        {
+            lost++; // Written over while it was copied
+        }
+        else
+        {
+            record_handle(&record);
+        }
+        m_read++;
+    }
+    return lost;
+}
+
+
+
+void app_trace_dump_set(app_trace_dump_handler_t handler)
+{
+    m_dump_handler = handler;
+}
+
+
+
+void app_trace_stats_get(app_trace_evt_t evt, app_trace_stats_t * p_stats)
+{
+    *p_stats = m_stats[evt];
+}
+
+
+
+uint32_t app_trace_percentile_get(app_trace_stats_t const * p_stats, uint8_t percent)
+{
+    uint32_t target = ((p_stats->count * percent) + 99) / 100;
+    uint32_t sum    = 0;
+
+    if(p_stats->count == 0) return 0;
+
+    for(uint8_t bucket = 0; bucket < APP_TRACE_HISTOGRAM_SIZE; bucket++)
+    {
+        sum += p_stats->histogram[bucket];
+        if(sum >= target)
+        {
+            uint32_t upper = (2UL << bucket) - 1;
+            return MIN(upper, p_stats->max);
+        }
+    }
+    return p_stats->max; // Histogram buckets saturated
+}
+
+
+
+void app_trace_stats_reset(void)
+{
+    memset(m_stats, 0, sizeof(m_stats));
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,156 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef APP_TRACE_H__
+#define APP_TRACE_H__
+
+/* Latency tracing of the sample pipeline, from the FIFO drain to the notification on air.
+ *
+ * APP_TRACE() stamps an event into a ring buffer. It is cheap enough for interrupt handlers:
+ * the slot is reserved with LDREX/STREX on Cortex-M4 and in a short critical region on
+ * Cortex-M0. The clock is the DWT cycle counter on the nRF52 and a TIMER on the nRF51.
+ *
+ * app_trace_process() empties the ring from the main loop. Each event is matched with the
+ * latest earlier stage of the same id, e.g. the same block, and the time between them is
+ * added to the statistics of the stage. Events with APP_TRACE_ID_NONE, like notifications
+ * that mix bytes of several blocks, are matched with the latest earlier stage of any id.
+ *
+ * A dump handler can be set to see every event as it is matched, e.g. to log them over RTT
+ * for tools/trace_report.py, which computes the same report with exact percentiles.
+ *
+ * Set APP_TRACE_ENABLED to 1 to compile it in. APP_TRACE() is empty otherwise.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef APP_TRACE_ENABLED
+#define APP_TRACE_ENABLED           0
+#endif
+
+#ifndef APP_TRACE_BUFFER_SIZE
+#define APP_TRACE_BUFFER_SIZE       128     // Events. Must be a power of two
+#endif
+
+#if !defined(NRF52) && !defined(APP_TRACE_TIMER)
+#define APP_TRACE_TIMER             NRF_TIMER2  // TIMER0 is used by the SoftDevice and TIMER1 by app_flex
+#endif
+
+#if defined(NRF52)
+#define APP_TRACE_TIME_WRAP_US      0x4000000UL // DWT cycle counter at 64 MHz
+#else
+#define APP_TRACE_TIME_WRAP_US      0x80000UL   // 16 bit TIMER at 125 kHz
+#endif
+
+#define APP_TRACE_ID_NONE           0xFFFF
+#define APP_TRACE_HISTOGRAM_SIZE    20      // Bucket n counts latencies from 2^n to 2^(n+1) - 1 us
+
+/**@brief Pipeline stages, in the order a sample passes them
+ */
+typedef enum
+{
+    APP_TRACE_EVT_DRAIN,            // FIFO drain timer fired
+    APP_TRACE_EVT_BUS_START,        // FIFO read scheduled on the bus
+    APP_TRACE_EVT_BUS_END,          // FIFO read finished, in the bus interrupt
+    APP_TRACE_EVT_PROCESS,          // Block taken by the main loop
+    APP_TRACE_EVT_FUSION,           // Orientation updated
+    APP_TRACE_EVT_PACK,             // Frames encoded and queued on the NUS stream
+    APP_TRACE_EVT_HVX,              // Notification accepted by sd_ble_gatts_hvx()
+    APP_TRACE_EVT_TX_COMPLETE,      // Notification sent, BLE_EVT_TX_COMPLETE
+    APP_TRACE_EVT_COUNT
+}app_trace_evt_t;
+
+/**@brief Latency of one stage from the stage before it, in microseconds
+ */
+typedef struct
+{
+    uint32_t    count;
+    uint32_t    min;
+    uint32_t    max;
+    uint32_t    sum;
+    uint16_t    histogram[APP_TRACE_HISTOGRAM_SIZE];
+}app_trace_stats_t;
+
+/**@brief Handler called by app_trace_process() for each event before it is matched
+ *
+ * @param[in]   evt             Stage
+ * @param[in]   id              Id it was stamped with
+ * @param[in]   time_us         Time stamp in us. Wraps at APP_TRACE_TIME_WRAP_US
+ */
+typedef void (* app_trace_dump_handler_t)(app_trace_evt_t evt, uint16_t id, uint32_t time_us);
+
+#if APP_TRACE_ENABLED
+#define APP_TRACE(evt, id)          app_trace_record((evt), (id))
+#else
+#define APP_TRACE(evt, id)
+#endif
+
+
+
+/**@brief Function for starting the trace clock
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t app_trace_init(void);
+
+
+
+/**@brief Function for stamping an event. Use APP_TRACE() so it compiles away when disabled
+ *
+ * @param[in]   evt             Stage reached
+ * @param[in]   id              What passed it, e.g. the block address, or APP_TRACE_ID_NONE
+ */
+void app_trace_record(app_trace_evt_t evt, uint16_t id);
+
+
+
+/**@brief Function for emptying the ring into the statistics. Call from the main loop only
+ *
+ * @retval      uint32_t        Events lost because the ring was full since the last call
+ */
+uint32_t app_trace_process(void);
+
+
+
+/**@brief Function for setting the handler that sees every event app_trace_process() handles
+ *
+ * @param[in]   handler         Dump handler, or NULL for none
+ */
+void app_trace_dump_set(app_trace_dump_handler_t handler);
+
+
+
+/**@brief Function for reading the statistics of a stage
+ *
+ * @param[in]   evt             Stage
+ * @param[out]  p_stats         Statistics
+ */
+void app_trace_stats_get(app_trace_evt_t evt, app_trace_stats_t * p_stats);
+
+
+
+/**@brief Function for the latency that a fraction of a stage's events stays below
+ *
+ * The histogram has one bucket per power of two, so this is the upper end of the bucket.
+ *
+ * @param[in]   p_stats         Statistics
+ * @param[in]   percent         E.g. 99
+ * @retval      uint32_t        Latency in us. 0 if there are no events
+ */
+uint32_t app_trace_percentile_get(app_trace_stats_t const * p_stats, uint8_t percent);
+
+
+
+/**@brief Function for clearing the statistics, e.g. after they have been reported
+ */
+void app_trace_stats_reset(void);
+
+
+#endif /* APP_TRACE_H__ */
+
+/**
+  @}
+*/
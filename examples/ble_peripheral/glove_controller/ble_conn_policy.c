@@ -0,0 +1,121 @@
+ /*
+  * This code is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdint.h>
+#include <string.h>
+#include "ble_conn_policy.h"
+#include "ble_conn_params.h"
+#include "nrf_error.h"
+
+#define UNIT_1_25_MS_US     1250
+
+
+
+static void conn_params_set(ble_conn_policy_t * p_policy, ble_gap_conn_params_t const * p_params)
+{
+    bool changed = (p_policy->conn_params.max_conn_interval != p_params->max_conn_interval) ||
+                   (p_policy->conn_params.slave_latency     != p_params->slave_latency);
+
+    p_policy->conn_params = *p_params;
+    if(changed && p_policy->evt_handler != NULL)
+    {
+        p_policy->evt_handler(p_policy, ble_conn_policy_interval_get(p_policy), p_params->slave_latency);
+    }
+}
+
+
+
+static uint32_t params_request(ble_conn_policy_t * p_policy)
+{
+    ble_gap_conn_params_t params = p_policy->moving ? p_policy->active_params : p_policy->idle_params;
+
+    if(p_policy->conn_handle == BLE_CONN_HANDLE_INVALID)
+    {
+        return NRF_SUCCESS; // Requested when the next connection is made
+    }
+    // Retried by ble_conn_params until the central grants them or the attempts run out
+    return ble_conn_params_change_conn_params(&params);
+}
+
+
+
+void ble_conn_policy_init(ble_conn_policy_t * p_policy, ble_gap_conn_params_t const * p_active_params,
+                          ble_gap_conn_params_t const * p_idle_params, ble_conn_policy_evt_handler_t evt_handler)
+{
+    memset(p_policy, 0, sizeof(*p_policy));
+    p_policy->active_params = *p_active_params;
+    p_policy->idle_params   = *p_idle_params;
+    p_policy->evt_handler   = evt_handler;
+    p_policy->conn_handle   = BLE_CONN_HANDLE_INVALID;
+    p_policy->moving        = true;
+}
+
+
+
+uint32_t ble_conn_policy_motion_set(ble_conn_policy_t * p_policy, bool moving)
+{
+    if(moving == p_policy->moving) return NRF_SUCCESS;
+
+    p_policy->moving = moving;
+    return params_request(p_policy);
+}
+
+
+
+uint32_t ble_conn_policy_interval_get(ble_conn_policy_t const * p_policy)
+{
+    if(p_policy->conn_handle == BLE_CONN_HANDLE_INVALID) return 0;
+
+    // The central picks one interval from the requested range and reports it as both min and max
+    return (uint32_t)p_policy->conn_params.max_conn_interval * UNIT_1_25_MS_US;
+}
+
+
+
+uint32_t ble_conn_policy_batch_period_get(ble_conn_policy_t const * p_policy, uint32_t min_us, uint32_t max_us)
+{
+    uint32_t interval_us = ble_conn_policy_interval_get(p_policy);
+
+    if(interval_us == 0) return max_us;
+
+    // Slave latency is left out: the glove wakes for every event while it has data to send
+    if(interval_us < min_us) return min_us;
+    if(interval_us > max_us) return max_us;
+    return interval_us;
+}
+
+
+
+void ble_conn_policy_on_ble_evt(ble_conn_policy_t * p_policy, ble_evt_t * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            p_policy->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            memset(&p_policy->conn_params, 0, sizeof(p_policy->conn_params));
+            conn_params_set(p_policy, &p_ble_evt->evt.gap_evt.params.connected.conn_params);
+            (void)params_request(p_policy); // The central connects with its own choice
+            break;
+        case BLE_GAP_EVT_DISCONNECTED:
+            p_policy->conn_handle = BLE_CONN_HANDLE_INVALID;
+            memset(&p_policy->conn_params, 0, sizeof(p_policy->conn_params));
+            if(p_policy->evt_handler != NULL)
+            {
+                p_policy->evt_handler(p_policy, 0, 0);
+            }
+            break;
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+            conn_params_set(p_policy, &p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params);
+            break;
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+/**
+  @}
+*/
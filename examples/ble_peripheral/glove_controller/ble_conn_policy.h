@@ -0,0 +1,105 @@
+ /*
+  * This code is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef BLE_CONN_POLICY_H__
+#define BLE_CONN_POLICY_H__
+
+/* Connection parameters that follow the hand.
+ *
+ * While the hand moves, the samples must reach the peer quickly, so a short connection
+ * interval is requested. Once the hand has been still for a while, a long interval with
+ * slave latency is requested instead, which lets the radio sleep through most connection
+ * events. The requests go through ble_conn_params, which retries them and checks what the
+ * central grants.
+ *
+ * The central has the last word, so the interval in use is taken from the connection and
+ * BLE_GAP_EVT_CONN_PARAM_UPDATE events and passed to the event handler. The application
+ * can then size its batches to one connection interval with ble_conn_policy_batch_period_get().
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "ble_gap.h"
+
+typedef struct ble_conn_policy_s ble_conn_policy_t;
+
+/**@brief Called when the connection interval in use changes
+ *
+ * @param[in]   p_policy        Policy state
+ * @param[in]   interval_us     Connection interval in microseconds. 0 on disconnection
+ * @param[in]   slave_latency   Connection events the glove may skip
+ */
+typedef void (*ble_conn_policy_evt_handler_t)(ble_conn_policy_t * p_policy, uint32_t interval_us, uint16_t slave_latency);
+
+/**@brief Policy state */
+struct ble_conn_policy_s
+{
+    ble_gap_conn_params_t           active_params;      // Requested while the hand moves
+    ble_gap_conn_params_t           idle_params;        // Requested while the hand is still
+    ble_conn_policy_evt_handler_t   evt_handler;
+    uint16_t                        conn_handle;
+    bool                            moving;
+    ble_gap_conn_params_t           conn_params;        // In use on the connection
+};
+
+
+
+/**@brief Function for initiating the policy. The hand counts as moving until told otherwise
+ *
+ * @param[out]  p_policy        Policy state
+ * @param[in]   p_active_params Connection parameters while the hand moves
+ * @param[in]   p_idle_params   Connection parameters while the hand is still
+ * @param[in]   evt_handler     Called when the interval in use changes. Can be NULL
+ */
+void ble_conn_policy_init(ble_conn_policy_t * p_policy, ble_gap_conn_params_t const * p_active_params,
+                          ble_gap_conn_params_t const * p_idle_params, ble_conn_policy_evt_handler_t evt_handler);
+
+
+
+/**@brief Function for telling the policy whether the hand moves. Parameters are only requested on a change
+ *
+ * @param[in]   p_policy        Policy state
+ * @param[in]   moving          true while the hand moves
+ * @retval      uint32_t        Error code from ble_conn_params_change_conn_params()
+ */
+uint32_t ble_conn_policy_motion_set(ble_conn_policy_t * p_policy, bool moving);
+
+
+
+/**@brief Function for the connection interval in use
+ *
+ * @param[in]   p_policy        Policy state
+ * @retval      uint32_t        Connection interval in microseconds. 0 when not connected
+ */
+uint32_t ble_conn_policy_interval_get(ble_conn_policy_t const * p_policy);
+
+
+
+/**@brief Function for the period to batch samples over, so one batch is ready for each connection event
+ *
+ * @param[in]   p_policy        Policy state
+ * @param[in]   min_us          Shortest period, used while connection events come faster
+ * @param[in]   max_us          Longest period, also used when not connected
+ * @retval      uint32_t        Connection interval in use, clamped to min_us and max_us
+ */
+uint32_t ble_conn_policy_batch_period_get(ble_conn_policy_t const * p_policy, uint32_t min_us, uint32_t max_us);
+
+
+
+/**@brief Function for handling the BLE events. Call after ble_conn_params_on_ble_evt()
+ *
+ * @param[in]   p_policy        Policy state
+ * @param[in]   p_ble_evt       Event received from the BLE stack
+ */
+void ble_conn_policy_on_ble_evt(ble_conn_policy_t * p_policy, ble_evt_t * p_ble_evt);
+
+
+#endif /* BLE_CONN_POLICY_H__ */
+
+/**
+  @}
+*/
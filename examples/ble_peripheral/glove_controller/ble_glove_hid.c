@@ -0,0 +1,319 @@
+ /*
+  * This code is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ble_glove_hid.h"
+#include "ble_srv_common.h"
+#include "app_error.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+#define BASE_USB_HID_SPEC_VERSION   0x0101
+
+#define REP_INDEX_MOUSE             0           // Index in the input report array
+#define REP_INDEX_GAMEPAD           1
+#define REP_COUNT                   2
+#define REP_MOUSE_LEN               5
+#define REP_GAMEPAD_LEN             3
+#define NOTIFICATION_BOOT           0x80        // Bit in ble_glove_hid_t.notifications of the boot mouse report
+
+static uint8_t m_report_map[] =
+{
+    0x05, 0x01,         // Usage Page (Generic Desktop)
+    0x09, 0x02,         // Usage (Mouse)
+    0xA1, 0x01,         // Collection (Application)
+    0x85, BLE_GLOVE_HID_MOUSE_REPORT_ID,
+    0x09, 0x01,         //   Usage (Pointer)
+    0xA1, 0x00,         //   Collection (Physical)
+    0x05, 0x09,         //     Usage Page (Buttons)
+    0x19, 0x01,         //     Usage Minimum (1)
+    0x29, 0x08,         //     Usage Maximum (8)
+    0x15, 0x00,         //     Logical Minimum (0)
+    0x25, 0x01,         //     Logical Maximum (1)
+    0x95, 0x08,         //     Report Count (8)
+    0x75, 0x01,         //     Report Size (1)
+    0x81, 0x02,         //     Input (Data, Variable, Absolute)
+    0x05, 0x01,         //     Usage Page (Generic Desktop)
+    0x09, 0x30,         //     Usage (X)
+    0x09, 0x31,         //     Usage (Y)
+    0x16, 0x01, 0x80,   //     Logical Minimum (-32767)
+    0x26, 0xFF, 0x7F,   //     Logical Maximum (32767)
+    0x95, 0x02,         //     Report Count (2)
+    0x75, 0x10,         //     Report Size (16)
+    0x81, 0x06,         //     Input (Data, Variable, Relative)
+    0xC0,               //   End Collection
+    0xC0,               // End Collection
+
+    0x05, 0x01,         // Usage Page (Generic Desktop)
+    0x09, 0x05,         // Usage (Game Pad)
+    0xA1, 0x01,         // Collection (Application)
+    0x85, BLE_GLOVE_HID_GAMEPAD_REPORT_ID,
+    0x05, 0x09,         //   Usage Page (Buttons)
+    0x19, 0x01,         //   Usage Minimum (1)
+    0x29, 0x08,         //   Usage Maximum (8)
+    0x15, 0x00,         //   Logical Minimum (0)
+    0x25, 0x01,         //   Logical Maximum (1)
+    0x95, 0x08,         //   Report Count (8)
+    0x75, 0x01,         //   Report Size (1)
+    0x81, 0x02,         //   Input (Data, Variable, Absolute)
+    0x05, 0x01,         //   Usage Page (Generic Desktop)
+    0x09, 0x30,         //   Usage (X)
+    0x09, 0x31,         //   Usage (Y)
+    0x15, 0x81,         //   Logical Minimum (-127)
+    0x25, 0x7F,         //   Logical Maximum (127)
+    0x95, 0x02,         //   Report Count (2)
+    0x75, 0x08,         //   Report Size (8)
+    0x81, 0x02,         //   Input (Data, Variable, Absolute)
+    0xC0                // End Collection
+};
+
+
+
+static void notifications_set(ble_glove_hid_t * p_hid, uint8_t notifications)
+{
+    if(notifications == p_hid->notifications) return;
+
+    p_hid->notifications = notifications;
+    if(p_hid->evt_handler != NULL)
+    {
+        p_hid->evt_handler(p_hid);
+    }
+}
+
+
+
+/**@brief Function for reading the CCCDs, which a bonded host does not write again on reconnection */
+static void notifications_read(ble_glove_hid_t * p_hid)
+{
+    uint16_t handles[REP_COUNT + 1];
+    uint8_t  masks[REP_COUNT + 1] = {1 << REP_INDEX_MOUSE, 1 << REP_INDEX_GAMEPAD, NOTIFICATION_BOOT};
+    uint8_t  notifications = 0;
+
+    handles[REP_INDEX_MOUSE]   = p_hid->hids.inp_rep_array[REP_INDEX_MOUSE].char_handles.cccd_handle;
+    handles[REP_INDEX_GAMEPAD] = p_hid->hids.inp_rep_array[REP_INDEX_GAMEPAD].char_handles.cccd_handle;
+    handles[REP_COUNT]         = p_hid->hids.boot_mouse_inp_rep_handles.cccd_handle;
+
+    for(uint8_t i = 0; i < REP_COUNT + 1; i++)
+    {
+        uint8_t           cccd[BLE_CCCD_VALUE_LEN];
+        ble_gatts_value_t value;
+
+        memset(&value, 0, sizeof(value));
+        value.len     = sizeof(cccd);
+        value.p_value = cccd;
+        if(sd_ble_gatts_value_get(p_hid->hids.conn_handle, handles[i], &value) == NRF_SUCCESS &&
+           ble_srv_is_notification_enabled(cccd))
+        {
+            notifications |= masks[i];
+        }
+    }
+    notifications_set(p_hid, notifications);
+}
+
+
+
+static uint8_t notification_mask(ble_hids_char_id_t const * p_char_id)
+{
+    if(p_char_id->uuid == BLE_UUID_BOOT_MOUSE_INPUT_REPORT_CHAR) return NOTIFICATION_BOOT;
+    if(p_char_id->uuid == BLE_UUID_REPORT_CHAR && p_char_id->rep_type == BLE_HIDS_REP_TYPE_INPUT)
+    {
+        return 1 << p_char_id->rep_index;
+    }
+    return 0;
+}
+
+
+
+static void on_hids_evt(ble_hids_t * p_hids, ble_hids_evt_t * p_evt)
+{
+    ble_glove_hid_t * p_hid = (ble_glove_hid_t *)p_hids;
+
+    switch (p_evt->evt_type)
+    {
+        case BLE_HIDS_EVT_BOOT_MODE_ENTERED:
+            p_hid->boot_mode = true;
+            if(p_hid->evt_handler != NULL) p_hid->evt_handler(p_hid);
+            break;
+        case BLE_HIDS_EVT_REPORT_MODE_ENTERED:
+            p_hid->boot_mode = false;
+            if(p_hid->evt_handler != NULL) p_hid->evt_handler(p_hid);
+            break;
+        case BLE_HIDS_EVT_NOTIF_ENABLED:
+            notifications_set(p_hid, p_hid->notifications | notification_mask(&p_evt->params.notification.char_id));
+            break;
+        case BLE_HIDS_EVT_NOTIF_DISABLED:
+            notifications_set(p_hid, p_hid->notifications & ~notification_mask(&p_evt->params.notification.char_id));
+            break;
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+
+static void service_error_handler(uint32_t nrf_error)
+{
+    APP_ERROR_HANDLER(nrf_error);
+}
+
+
+
+static void input_report_init(ble_hids_inp_rep_init_t * p_report, uint16_t max_len, uint8_t report_id)
+{
+    p_report->max_len             = max_len;
+    p_report->rep_ref.report_id   = report_id;
+    p_report->rep_ref.report_type = BLE_HIDS_REP_TYPE_INPUT;
+
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&p_report->security_mode.cccd_write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&p_report->security_mode.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&p_report->security_mode.write_perm);
+}
+
+
+
+uint32_t ble_glove_hid_init(ble_glove_hid_t * p_hid, app_hid_map_mode_t mode, ble_glove_hid_evt_handler_t evt_handler)
+{
+    ble_hids_init_t         hids_init;
+    ble_hids_inp_rep_init_t input_reports[REP_COUNT];
+
+    memset(p_hid, 0, sizeof(*p_hid));
+    p_hid->mode        = mode;
+    p_hid->evt_handler = evt_handler;
+
+    memset(input_reports, 0, sizeof(input_reports));
+    input_report_init(&input_reports[REP_INDEX_MOUSE],   REP_MOUSE_LEN,   BLE_GLOVE_HID_MOUSE_REPORT_ID);
+    input_report_init(&input_reports[REP_INDEX_GAMEPAD], REP_GAMEPAD_LEN, BLE_GLOVE_HID_GAMEPAD_REPORT_ID);
+
+    memset(&hids_init, 0, sizeof(hids_init));
+    hids_init.evt_handler                    = on_hids_evt;
+    hids_init.error_handler                  = service_error_handler;
+    hids_init.is_mouse                       = true;    // Adds the boot mouse report and the protocol mode
+    hids_init.inp_rep_count                  = REP_COUNT;
+    hids_init.p_inp_rep_array                = input_reports;
+    hids_init.rep_map.data_len               = sizeof(m_report_map);
+    hids_init.rep_map.p_data                 = m_report_map;
+    hids_init.hid_information.bcd_hid        = BASE_USB_HID_SPEC_VERSION;
+    hids_init.hid_information.b_country_code = 0;
+    hids_init.hid_information.flags          = HID_INFO_FLAG_REMOTE_WAKE_MSK | HID_INFO_FLAG_NORMALLY_CONNECTABLE_MSK;
+
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&hids_init.rep_map.security_mode.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&hids_init.rep_map.security_mode.write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&hids_init.hid_information.security_mode.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&hids_init.hid_information.security_mode.write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&hids_init.security_mode_boot_mouse_inp_rep.cccd_write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&hids_init.security_mode_boot_mouse_inp_rep.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&hids_init.security_mode_boot_mouse_inp_rep.write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&hids_init.security_mode_protocol.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&hids_init.security_mode_protocol.write_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&hids_init.security_mode_ctrl_point.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_ENC_NO_MITM(&hids_init.security_mode_ctrl_point.write_perm);
+
+    return ble_hids_init(&p_hid->hids, &hids_init);
+}
+
+
+
+void ble_glove_hid_on_ble_evt(ble_glove_hid_t * p_hid, ble_evt_t * p_ble_evt)
+{
+    ble_hids_on_ble_evt(&p_hid->hids, p_ble_evt);
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            p_hid->boot_mode  = false;  // Report protocol is the default on each connection
+            p_hid->tx_pending = false;
+            break;
+        case BLE_GAP_EVT_DISCONNECTED:
+            p_hid->tx_pending = false;
+            notifications_set(p_hid, 0);
+            break;
+        case BLE_GAP_EVT_CONN_SEC_UPDATE:
+            notifications_read(p_hid);
+            break;
+        case BLE_EVT_TX_COMPLETE:
+            // The connection event that carried the report is over. It may have been another
+            // notification, but then the report is first in line for the next event
+            p_hid->tx_pending = false;
+            break;
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+
+bool ble_glove_hid_enabled(ble_glove_hid_t const * p_hid)
+{
+    if(p_hid->hids.conn_handle == BLE_CONN_HANDLE_INVALID) return false;
+    if(p_hid->boot_mode)
+    {
+        // Boot protocol has no gamepad
+        return (p_hid->mode == APP_HID_MAP_MOUSE) && (p_hid->notifications & NOTIFICATION_BOOT);
+    }
+    return (p_hid->notifications & (1 << ((p_hid->mode == APP_HID_MAP_MOUSE) ? REP_INDEX_MOUSE : REP_INDEX_GAMEPAD))) != 0;
+}
+
+
+
+bool ble_glove_hid_ready(ble_glove_hid_t const * p_hid)
+{
+    return !p_hid->tx_pending && ble_glove_hid_enabled(p_hid);
+}
+
+
+
+int16_t ble_glove_hid_move_max(ble_glove_hid_t const * p_hid)
+{
+    return p_hid->boot_mode ? BLE_GLOVE_HID_BOOT_MOVE_MAX : INT16_MAX;
+}
+
+
+
+uint32_t ble_glove_hid_report_send(ble_glove_hid_t * p_hid, app_hid_map_report_t const * p_report)
+{
+    uint32_t err_code;
+
+    if(p_hid->tx_pending) return NRF_ERROR_BUSY;
+    if(!ble_glove_hid_enabled(p_hid)) return NRF_ERROR_INVALID_STATE;
+
+    if(p_hid->boot_mode)
+    {
+        err_code = ble_hids_boot_mouse_inp_rep_send(&p_hid->hids, p_report->buttons,
+                                                    (int8_t)p_report->x, (int8_t)p_report->y, 0, NULL);
+    }
+    else if(p_hid->mode == APP_HID_MAP_MOUSE)
+    {
+        uint8_t data[REP_MOUSE_LEN];
+
+        data[0] = p_report->buttons;
+        (void)uint16_encode((uint16_t)p_report->x, &data[1]);
+        (void)uint16_encode((uint16_t)p_report->y, &data[3]);
+        err_code = ble_hids_inp_rep_send(&p_hid->hids, REP_INDEX_MOUSE, sizeof(data), data);
+    }
+    else
+    {
+        uint8_t data[REP_GAMEPAD_LEN];
+
+        data[0] = p_report->buttons;
+        data[1] = (uint8_t)(int8_t)p_report->x;
+        data[2] = (uint8_t)(int8_t)p_report->y;
+        err_code = ble_hids_inp_rep_send(&p_hid->hids, REP_INDEX_GAMEPAD, sizeof(data), data);
+    }
+
+    if(err_code == NRF_SUCCESS)
+    {
+        p_hid->tx_pending = true;
+    }
+    return err_code;
+}
+
+/**
+  @}
+*/
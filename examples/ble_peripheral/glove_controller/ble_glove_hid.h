@@ -0,0 +1,110 @@
+ /*
+  * This code is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef BLE_GLOVE_HID_H__
+#define BLE_GLOVE_HID_H__
+
+/* HID over GATT, so the glove works as an air mouse or gamepad without a driver on the host.
+ *
+ * The report map holds a mouse (report id 1: buttons, 16 bit x and y motion) and a gamepad
+ * (report id 2: buttons, 8 bit x and y stick). The service also has the boot mouse report,
+ * which hosts in boot protocol read instead. Reports are made by app_hid_map.
+ *
+ * Only one report at a time waits in the SoftDevice. The next one can be sent when the
+ * connection event that carried it is over, i.e. on BLE_EVT_TX_COMPLETE, so reports go out at
+ * the connection event rate. Motion in between is coalesced by app_hid_map into the next report.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ble.h"
+#include "ble_hids.h"
+#include "app_hid_map.h"
+
+#define BLE_GLOVE_HID_MOUSE_REPORT_ID       1
+#define BLE_GLOVE_HID_GAMEPAD_REPORT_ID     2
+#define BLE_GLOVE_HID_BOOT_MOVE_MAX         127     // Boot mouse report motion is 8 bit
+
+typedef struct ble_glove_hid_s ble_glove_hid_t;
+
+/**@brief Called when the host enables or disables the reports, or changes protocol mode */
+typedef void (*ble_glove_hid_evt_handler_t)(ble_glove_hid_t * p_hid);
+
+/**@brief Service state */
+struct ble_glove_hid_s
+{
+    ble_hids_t                  hids;           // First, so the ble_hids events lead back here
+    app_hid_map_mode_t          mode;           // Report sent
+    ble_glove_hid_evt_handler_t evt_handler;
+    bool                        boot_mode;      // The host uses the boot protocol
+    uint8_t                     notifications;  // Bit per input report, and bit 7 for the boot mouse report
+    bool                        tx_pending;     // A report waits in the SoftDevice
+};
+
+
+
+/**@brief Function for initiating the service
+ *
+ * @param[out]  p_hid           Service state
+ * @param[in]   mode            Report to send
+ * @param[in]   evt_handler     Called when the host enables or disables the reports. Can be NULL
+ * @retval      uint32_t        Error code from ble_hids_init()
+ */
+uint32_t ble_glove_hid_init(ble_glove_hid_t * p_hid, app_hid_map_mode_t mode, ble_glove_hid_evt_handler_t evt_handler);
+
+
+
+/**@brief Function for handling the BLE events
+ *
+ * @param[in]   p_hid           Service state
+ * @param[in]   p_ble_evt       Event received from the BLE stack
+ */
+void ble_glove_hid_on_ble_evt(ble_glove_hid_t * p_hid, ble_evt_t * p_ble_evt);
+
+
+
+/**@brief Function for finding out if the host listens to the report of the mode
+ *
+ * @param[in]   p_hid           Service state
+ * @retval      bool            true if reports can be sent
+ */
+bool ble_glove_hid_enabled(ble_glove_hid_t const * p_hid);
+
+
+
+/**@brief Function for finding out if a report can be sent now
+ *
+ * @param[in]   p_hid           Service state
+ * @retval      bool            true if the host listens and no report is waiting in the SoftDevice
+ */
+bool ble_glove_hid_ready(ble_glove_hid_t const * p_hid);
+
+
+
+/**@brief Function for the largest mouse motion a report can hold in the current protocol mode
+ *
+ * @param[in]   p_hid           Service state
+ * @retval      int16_t         Largest motion
+ */
+int16_t ble_glove_hid_move_max(ble_glove_hid_t const * p_hid);
+
+
+
+/**@brief Function for sending a report
+ *
+ * @param[in]   p_hid           Service state
+ * @param[in]   p_report        Report from app_hid_map_report_get()
+ * @retval      uint32_t        Error code. NRF_ERROR_BUSY if a report is still waiting,
+ *                              NRF_ERROR_INVALID_STATE if the host does not listen to the report
+ */
+uint32_t ble_glove_hid_report_send(ble_glove_hid_t * p_hid, app_hid_map_report_t const * p_report);
+
+
+#endif /* BLE_GLOVE_HID_H__ */
+
+/**
+  @}
+*/
@@ -1,78 +1,366 @@
- /* 
-  * This code is not extensively tested and only 
-  * meant as a simple explanation and for inspiration. 
-  * NO WARRANTY of ANY KIND is provided. 
+ /*
+  * This code is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
   */
 
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include "nrf_gpio.h"
 #include "ble_mpu.h"
 #include "ble_srv_common.h"
 #include "app_error.h"
+#include "app_util.h"
+#include "app_util_platform.h"
 #include "app_mpu.h"
 
 
+#define BLE_MPU_TIMESTAMP_MASK      0x00FFFFFF  // app_timer runs on the 24 bit RTC counter
+#define BLE_MPU_BLOCK_SENSOR_COUNT  3           // Accel, gyro and temp are sent from app_mpu_block_t
+#define BLE_MPU_BLOCK_SENSORS       (BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_ACCEL) | \
+                                     BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_GYRO)  | \
+                                     BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_TEMP))
+
+/**@brief Characteristic and sample layout of each sensor */
+typedef struct
+{
+    uint16_t    uuid;
+    uint8_t     size;           // Bytes per sample
+    uint8_t     block_offset;   // Offset in imu_sample_t. Only used for the block sensors
+}ble_mpu_sensor_info_t;
+
+static const ble_mpu_sensor_info_t m_sensor_info[BLE_MPU_SENSOR_COUNT] =
+{
+    {BLE_UUID_ACCEL_CHARACTERISTC_UUID, sizeof(accel_values_t), offsetof(imu_sample_t, accel)},
+    {BLE_UUID_GYRO_CHARACTERISTC_UUID,  sizeof(gyro_values_t),  offsetof(imu_sample_t, gyro)},
+    {BLE_UUID_TEMP_CHARACTERISTC_UUID,  sizeof(temp_value_t),   offsetof(imu_sample_t, temp)},
+    {BLE_UUID_MAGN_CHARACTERISTC_UUID,  3 * sizeof(int16_t),    0},
+    {BLE_UUID_QUAT_CHARACTERISTC_UUID,  sizeof(ble_mpu_quat_t), 0},
+    {BLE_UUID_GESTURE_CHARACTERISTC_UUID, sizeof(uint8_t),      0},
+};
+
+uint16_t ble_mpu_packet_encode(uint8_t * p_packet, uint16_t max_len, uint32_t timestamp, uint16_t period,
+                               uint8_t const * p_elements, uint8_t element_size, uint16_t stride,
+                               uint16_t count, uint16_t * p_packed)
+{
+    uint16_t capacity = 0;
+    uint16_t len;
+
+    if(max_len > BLE_MPU_PACKET_HEADER_SIZE && element_size > 0)
+    {
+        capacity = (max_len - BLE_MPU_PACKET_HEADER_SIZE) / element_size;
+    }
+    if(capacity > UINT8_MAX) capacity = UINT8_MAX;
+    if(count > capacity) count = capacity;
+
+    len  = uint32_encode(timestamp, &p_packet[0]);
+    len += uint16_encode(period, &p_packet[len]);
+    p_packet[len++] = (uint8_t)count;
+
+    for(uint16_t i = 0; i < count; i++)
+    {
+        memcpy(&p_packet[len], p_elements, element_size);
+        len        += element_size;
+        p_elements += stride;
+    }
+
+    *p_packed = count;
+    return len;
+}
+
+
+
+uint8_t const * ble_mpu_packet_decode(uint8_t const * p_packet, uint16_t len, uint8_t element_size,
+                                      ble_mpu_packet_header_t * p_header)
+{
+    if(len < BLE_MPU_PACKET_HEADER_SIZE) return NULL;
+
+    p_header->timestamp = uint32_decode(&p_packet[0]);
+    p_header->period    = uint16_decode(&p_packet[4]);
+    p_header->count     = p_packet[6];
+
+    if(len != BLE_MPU_PACKET_HEADER_SIZE + (p_header->count * element_size)) return NULL;
+
+    return &p_packet[BLE_MPU_PACKET_HEADER_SIZE];
+}
+
+
+
+static void tx_queue_pop(ble_mpu_t * p_mpu)
+{
+    app_mpu_block_release(p_mpu->tx_queue[p_mpu->tx_head]);
+    p_mpu->tx_head = (p_mpu->tx_head + 1) % BLE_MPU_TX_QUEUE_SIZE;
+    p_mpu->tx_count--;
+    p_mpu->tx_sensor = 0;
+    p_mpu->tx_sample = 0;
+}
+
+
+
+static void tx_queue_flush(ble_mpu_t * p_mpu)
+{
+    CRITICAL_REGION_ENTER();
+    while(p_mpu->tx_count > 0)
+    {
+        tx_queue_pop(p_mpu);
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+
+
+static uint32_t notify(ble_mpu_t * p_mpu, ble_mpu_sensor_t sensor, uint8_t * p_packet, uint16_t len)
+{
+    ble_gatts_hvx_params_t hvx_params;
+    memset(&hvx_params, 0, sizeof(hvx_params));
+
+    hvx_params.handle = p_mpu->char_handles[sensor].value_handle;
+    hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
+    hvx_params.offset = 0;
+    hvx_params.p_len  = &len;
+    hvx_params.p_data = p_packet;
+
+    return sd_ble_gatts_hvx(p_mpu->conn_handle, &hvx_params);
+}
+
+
+
+/**@brief Function for claiming the next notification of the queued blocks. Finished blocks are
+ * popped and sensors nobody is subscribed to skipped on the way. Only one notification is claimed
+ * at a time, so they go out in order, and a caller that finds one claimed leaves the rest to the
+ * claimant, as it looks again after each notification. Must be called in a critical region.
+ *
+ * @retval      app_mpu_block_t*    Block to send tx_sensor from, starting at tx_sample. The caller holds
+ *                                  a reference to it until the claim is committed. NULL if there is nothing to send now
+ */
+static app_mpu_block_t * tx_claim(ble_mpu_t * p_mpu)
+{
+    if(p_mpu->tx_busy)
+    {
+        return NULL;
+    }
+    while(p_mpu->tx_count > 0)
+    {
+        app_mpu_block_t * p_block = p_mpu->tx_queue[p_mpu->tx_head];
+
+        if(p_mpu->tx_sensor >= BLE_MPU_BLOCK_SENSOR_COUNT)
+        {
+            tx_queue_pop(p_mpu);
+            continue;
+        }
+        if(p_mpu->tx_sample >= p_block->num_samples || !(p_mpu->subscriptions & BLE_MPU_SENSOR_MASK(p_mpu->tx_sensor)))
+        {
+            p_mpu->tx_sensor++;
+            p_mpu->tx_sample = 0;
+            continue;
+        }
+        // Kept while the SoftDevice is called, in case the queue is flushed in the meantime
+        app_mpu_block_retain(p_block);
+        p_mpu->tx_busy  = true;
+        p_mpu->tx_retry = false;
+        return p_block;
+    }
+    return NULL;
+}
+
+
+
+/**@brief Function for handing queued samples to the SoftDevice until it runs out of TX buffers.
+ * Each block is sent one subscribed sensor at a time. Called both when a block is queued and on
+ * BLE_EVT_TX_COMPLETE, from any priority. The critical regions only cover claiming the notification
+ * and committing the result, it is encoded and the SoftDevice called outside them.
+ */
+static void tx_process(ble_mpu_t * p_mpu)
+{
+    for(;;)
+    {
+        app_mpu_block_t             * p_block;
+        ble_mpu_sensor_info_t const * p_info;
+        uint8_t                       sensor;
+        uint16_t                      sample;
+        uint16_t                      remaining;
+        uint16_t                      packed;
+        uint16_t                      len;
+        uint32_t                      timestamp;
+        uint32_t                      err_code;
+        bool                          retry;
+
+        CRITICAL_REGION_ENTER();
+        p_block = tx_claim(p_mpu);
+        sensor  = p_mpu->tx_sensor;
+        sample  = p_mpu->tx_sample;
+        CRITICAL_REGION_EXIT();
+        if(p_block == NULL)
+        {
+            return;
+        }
+
+        // Time of the first sample in this notification, counted back from the last sample in the block
+        p_info    = &m_sensor_info[sensor];
+        remaining = p_block->num_samples - sample;
+        timestamp = (p_block->timestamp - ((remaining - 1) * p_mpu->sample_period)) & BLE_MPU_TIMESTAMP_MASK;
+        len       = ble_mpu_packet_encode(p_mpu->packet, p_mpu->max_payload_len, timestamp, p_mpu->sample_period,
+                                          (uint8_t const *)&p_block->samples[sample] + p_info->block_offset,
+                                          p_info->size, sizeof(imu_sample_t), remaining, &packed);
+
+        err_code = notify(p_mpu, (ble_mpu_sensor_t)sensor, p_mpu->packet, len);
+
+        CRITICAL_REGION_ENTER();
+        p_mpu->tx_busy = false;
+        retry = p_mpu->tx_retry; // TX buffers were freed while the SoftDevice was called
+        // Unless the queue was flushed in the meantime
+        if(p_mpu->tx_count > 0 && p_mpu->tx_queue[p_mpu->tx_head] == p_block &&
+           p_mpu->tx_sensor == sensor && p_mpu->tx_sample == sample)
+        {
+            if(err_code == NRF_SUCCESS)
+            {
+                p_mpu->tx_sample += packed;
+            }
+            else if(err_code != BLE_ERROR_NO_TX_PACKETS)
+            {
+                p_mpu->tx_sample = p_block->num_samples; // The peer can not receive this sensor. Skip it
+            }
+        }
+        CRITICAL_REGION_EXIT();
+        app_mpu_block_release(p_block);
+
+        if(err_code == BLE_ERROR_NO_TX_PACKETS && !retry)
+        {
+            return; // Continued on BLE_EVT_TX_COMPLETE
+        }
+    }
+}
+
+
+
+static void subscriptions_set(ble_mpu_t * p_mpu, uint8_t subscriptions)
+{
+    if(subscriptions == p_mpu->subscriptions) return;
+
+    p_mpu->subscriptions = subscriptions;
+    if(!(subscriptions & BLE_MPU_BLOCK_SENSORS))
+    {
+        tx_queue_flush(p_mpu);
+    }
+    if(p_mpu->evt_handler != NULL)
+    {
+        p_mpu->evt_handler(p_mpu);
+    }
+}
+
+
+
+static void on_write(ble_mpu_t * p_mpu, ble_evt_t * p_ble_evt)
+{
+    ble_gatts_evt_write_t * p_evt_write = &p_ble_evt->evt.gatts_evt.params.write;
+
+    if(p_evt_write->len != 2) return;
+
+    for(uint8_t i = 0; i < BLE_MPU_SENSOR_COUNT; i++)
+    {
+        if(p_evt_write->handle == p_mpu->char_handles[i].cccd_handle)
+        {
+            uint8_t subscriptions = p_mpu->subscriptions & ~BLE_MPU_SENSOR_MASK(i);
+            if(ble_srv_is_notification_enabled(p_evt_write->data))
+            {
+                subscriptions |= BLE_MPU_SENSOR_MASK(i);
+            }
+            subscriptions_set(p_mpu, subscriptions);
+        }
+    }
+}
+
+
+
 void ble_mpu_on_ble_evt(ble_mpu_t * p_mpu, ble_evt_t * p_ble_evt)
 {
     switch (p_ble_evt->header.evt_id)
     {
         case BLE_GAP_EVT_CONNECTED:
             p_mpu->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            p_mpu->max_payload_len = GATT_MTU_SIZE_DEFAULT - 3;
+            // A bonded peer keeps its subscriptions without writing the CCCDs again
+            ble_mpu_subscriptions_read(p_mpu);
             break;
         case BLE_GAP_EVT_DISCONNECTED:
             p_mpu->conn_handle = BLE_CONN_HANDLE_INVALID;
+            subscriptions_set(p_mpu, 0);
+            tx_queue_flush(p_mpu);
+            break;
+        case BLE_GATTS_EVT_WRITE:
+            on_write(p_mpu, p_ble_evt);
+            break;
+        case BLE_EVT_TX_COMPLETE:
+            CRITICAL_REGION_ENTER();
+            p_mpu->tx_retry = true; // In case a notification is refused for want of them right now
+            CRITICAL_REGION_EXIT();
+            tx_process(p_mpu);
+            break;
         default:
             // No implementation needed.
             break;
     }
 }
 
-/**@brief Function for adding our new characterstic to "Our service" that we initiated in the previous tutorial. 
+
+
+void ble_mpu_on_gatt_evt(ble_mpu_t * p_mpu, nrf_ble_gatt_evt_t const * p_evt)
+{
+    if(p_evt->conn_handle == p_mpu->conn_handle)
+    {
+        p_mpu->max_payload_len = MIN(p_evt->att_mtu_effective - 3, BLE_MPU_MAX_PAYLOAD_LEN);
+    }
+}
+
+/**@brief Function for adding the characteristic of a sensor to "Our service" that we initiated in the previous tutorial.
  *
  * @param[in]   p_mpu        mpu structure.
+ * @param[in]   sensor       Sensor to add a characteristic for. Each has its own CCCD.
  *
  */
-static uint32_t ble_char_accel_add(ble_mpu_t * p_mpu)
+static uint32_t ble_char_sensor_add(ble_mpu_t * p_mpu, ble_mpu_sensor_t sensor)
 {
     uint32_t   err_code = 0; // Variable to hold return codes from library and softdevice functions
-    
-    ble_uuid_t          char_uuid;   
-    BLE_UUID_BLE_ASSIGN(char_uuid, BLE_UUID_ACCEL_CHARACTERISTC_UUID);
-    
+
+    ble_uuid_t          char_uuid;
+    BLE_UUID_BLE_ASSIGN(char_uuid, m_sensor_info[sensor].uuid);
+
     ble_gatts_char_md_t char_md;
     memset(&char_md, 0, sizeof(char_md));
     char_md.char_props.read = 1;
     char_md.char_props.write = 1;
-    
+
     ble_gatts_attr_md_t cccd_md;
+    memset(&cccd_md, 0, sizeof(cccd_md));
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.read_perm);
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&cccd_md.write_perm);
-    cccd_md.vloc                = BLE_GATTS_VLOC_STACK;    
+    cccd_md.vloc                = BLE_GATTS_VLOC_STACK;
     char_md.p_cccd_md           = &cccd_md;
     char_md.char_props.notify   = 1;
-        
+
     ble_gatts_attr_md_t attr_md;
     memset(&attr_md, 0, sizeof(attr_md));
-    attr_md.vloc = BLE_GATTS_VLOC_STACK;    
-    
+    attr_md.vloc = BLE_GATTS_VLOC_STACK;
+    attr_md.vlen = 1;   // Notifications carry as many samples as the ATT MTU allows
+
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
     BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.write_perm);
-    
+
     ble_gatts_attr_t    attr_char_value;
     memset(&attr_char_value, 0, sizeof(attr_char_value));
     attr_char_value.p_uuid      = &char_uuid;
     attr_char_value.p_attr_md   = &attr_md;
-    attr_char_value.max_len     = sizeof(accel_values_t);
-    attr_char_value.init_len    = sizeof(accel_values_t);
-    uint8_t value[6]            = {0};
+    attr_char_value.max_len     = BLE_MPU_MAX_PAYLOAD_LEN;
+    attr_char_value.init_len    = BLE_MPU_PACKET_HEADER_SIZE;
+    uint8_t value[BLE_MPU_PACKET_HEADER_SIZE] = {0};
     attr_char_value.p_value     = value;
 
     err_code = sd_ble_gatts_characteristic_add(p_mpu->service_handle,
                                        &char_md,
                                        &attr_char_value,
-                                       &p_mpu->accel_char_handles);
-    APP_ERROR_CHECK(err_code);   
+                                       &p_mpu->char_handles[sensor]);
+    APP_ERROR_CHECK(err_code);
 
     return NRF_SUCCESS;
 }
@@ -83,7 +371,7 @@ static uint32_t ble_char_accel_add(ble_mpu_t * p_mpu)
  * @param[in]   p_mpu        Our Service structure.
  *
  */
-void ble_mpu_service_init(ble_mpu_t * p_mpu)
+void ble_mpu_service_init(ble_mpu_t * p_mpu, ble_mpu_init_t const * p_mpu_init)
 {
     uint32_t   err_code; // Variable to hold return codes from library and softdevice functions
 
@@ -91,36 +379,112 @@ void ble_mpu_service_init(ble_mpu_t * p_mpu)
     ble_uuid128_t     base_uuid = BLE_UUID_BASE_UUID;
     service_uuid.uuid = BLE_UUID_MPU_SERVICE_UUID;
     err_code = sd_ble_uuid_vs_add(&base_uuid, &service_uuid.type);
-    APP_ERROR_CHECK(err_code);    
+    APP_ERROR_CHECK(err_code);
 
-    p_mpu->conn_handle = BLE_CONN_HANDLE_INVALID;
+    p_mpu->conn_handle                  = BLE_CONN_HANDLE_INVALID;
+    p_mpu->subscriptions                = 0;
+    p_mpu->evt_handler                  = p_mpu_init->evt_handler;
+    p_mpu->max_payload_len              = GATT_MTU_SIZE_DEFAULT - 3;
+    p_mpu->sample_period                = p_mpu_init->sample_period;
+    p_mpu->tx_head                      = 0;
+    p_mpu->tx_count                     = 0;
+    p_mpu->tx_sensor                    = 0;
+    p_mpu->tx_sample                    = 0;
+    p_mpu->tx_busy                      = false;
+    p_mpu->tx_retry                     = false;
 
     err_code = sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY,
                                         &service_uuid,
                                         &p_mpu->service_handle);
-    
+
     APP_ERROR_CHECK(err_code);
-    
-    ble_char_accel_add(p_mpu);
+
+    for(uint8_t i = 0; i < BLE_MPU_SENSOR_COUNT; i++)
+    {
+        ble_char_sensor_add(p_mpu, (ble_mpu_sensor_t)i);
+    }
+}
+
+
+
+uint8_t ble_mpu_subscriptions_get(ble_mpu_t * p_mpu)
+{
+    return (p_mpu->conn_handle != BLE_CONN_HANDLE_INVALID) ? p_mpu->subscriptions : 0;
+}
+
+
+
+void ble_mpu_subscriptions_read(ble_mpu_t * p_mpu)
+{
+    uint8_t subscriptions = 0;
+
+    if(p_mpu->conn_handle == BLE_CONN_HANDLE_INVALID) return;
+
+    for(uint8_t i = 0; i < BLE_MPU_SENSOR_COUNT; i++)
+    {
+        uint8_t           cccd[BLE_CCCD_VALUE_LEN] = {0};
+        ble_gatts_value_t value;
+
+        value.len     = sizeof(cccd);
+        value.offset  = 0;
+        value.p_value = cccd;
+
+        // Fails until the system attributes are set. Not subscribed until then
+        if(sd_ble_gatts_value_get(p_mpu->conn_handle, p_mpu->char_handles[i].cccd_handle, &value) == NRF_SUCCESS &&
+           ble_srv_is_notification_enabled(cccd))
+        {
+            subscriptions |= BLE_MPU_SENSOR_MASK(i);
+        }
+    }
+    subscriptions_set(p_mpu, subscriptions);
 }
 
-// ALREADY_DONE_FOR_YOU: Function to be called when updating characteristic value
-void ble_mpu_update(ble_mpu_t *p_mpu, accel_values_t * accel_values)
+
+
+uint32_t ble_mpu_block_send(ble_mpu_t * p_mpu, app_mpu_block_t * p_block)
 {
-    // Send value if connected and notifying
-    if (p_mpu->conn_handle != BLE_CONN_HANDLE_INVALID)
+    uint32_t err_code = NRF_SUCCESS;
+
+    if(!(ble_mpu_subscriptions_get(p_mpu) & BLE_MPU_BLOCK_SENSORS))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    CRITICAL_REGION_ENTER();
+    if(p_mpu->tx_count < BLE_MPU_TX_QUEUE_SIZE)
+    {
+        app_mpu_block_retain(p_block);
+        p_mpu->tx_queue[(p_mpu->tx_head + p_mpu->tx_count) % BLE_MPU_TX_QUEUE_SIZE] = p_block;
+        p_mpu->tx_count++;
+    }
+    else
+    {
+        err_code = NRF_ERROR_NO_MEM;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(err_code == NRF_SUCCESS)
     {
-        uint16_t               len = sizeof(accel_values_t);
-        ble_gatts_hvx_params_t hvx_params;
-        memset(&hvx_params, 0, sizeof(hvx_params));
+        tx_process(p_mpu);
+    }
+    return err_code;
+}
+
+
 
-        hvx_params.handle = p_mpu->accel_char_handles.value_handle;
-        hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
-        hvx_params.offset = 0;
-        hvx_params.p_len  = &len;
-        hvx_params.p_data = (uint8_t*)accel_values;  
+uint32_t ble_mpu_sample_send(ble_mpu_t * p_mpu, ble_mpu_sensor_t sensor, void const * p_value, uint32_t timestamp)
+{
+    uint8_t  packet[BLE_MPU_PACKET_HEADER_SIZE + sizeof(ble_mpu_quat_t)]; // Each call has its own, so it can be called from any priority
+    uint16_t packed;
+    uint16_t len;
+
+    if(sensor >= BLE_MPU_SENSOR_COUNT) return NRF_ERROR_INVALID_PARAM;
+    if(!(ble_mpu_subscriptions_get(p_mpu) & BLE_MPU_SENSOR_MASK(sensor)))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
 
-        sd_ble_gatts_hvx(p_mpu->conn_handle, &hvx_params);
-    } 
-    
+    len = ble_mpu_packet_encode(packet, MIN(p_mpu->max_payload_len, sizeof(packet)), timestamp & BLE_MPU_TIMESTAMP_MASK, 0,
+                                p_value, m_sensor_info[sensor].size, 0, 1, &packed);
+    return notify(p_mpu, sensor, packet, len);
 }
@@ -1,28 +1,100 @@
- /* 
-  * This code is not extensively tested and only 
-  * meant as a simple explanation and for inspiration. 
-  * NO WARRANTY of ANY KIND is provided. 
+ /*
+  * This code is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
   */
 
 #ifndef MPU_SERVICE_H__
 #define MPU_SERVICE_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "ble.h"
 #include "ble_srv_common.h"
+#include "nrf_ble_gatt.h"
 #include "app_mpu.h"
+#include "app_mpu_block.h"
+#include "app_mpu_fusion.h"
 
 #define BLE_UUID_BASE_UUID              {0x23, 0xD1, 0x13, 0xEF, 0x5F, 0x78, 0x23, 0x15, 0xDE, 0xEF, 0x12, 0x12, 0x00, 0x00, 0x00, 0x00} // 128-bit base UUID
 #define BLE_UUID_MPU_SERVICE_UUID                0xF00D // Just a random, but recognizable value
 
 #define BLE_UUID_ACCEL_CHARACTERISTC_UUID          0xACCE // Just a random, but recognizable value
+#define BLE_UUID_GYRO_CHARACTERISTC_UUID           0x6790
+#define BLE_UUID_TEMP_CHARACTERISTC_UUID           0x7E30
+#define BLE_UUID_MAGN_CHARACTERISTC_UUID           0x3A60
+#define BLE_UUID_QUAT_CHARACTERISTC_UUID           0x0A7E
+#define BLE_UUID_GESTURE_CHARACTERISTC_UUID        0x6E57
+
+#define BLE_MPU_TX_QUEUE_SIZE           APP_MPU_BLOCK_POOL_SIZE             // Blocks waiting to be notified
+#define BLE_MPU_MAX_PAYLOAD_LEN         (NRF_BLE_GATT_MAX_MTU_SIZE - 3)     // Largest notification. ATT MTU minus opcode and handle
+
+/* Notification format, little endian:
+ *   uint32_t   timestamp   app_timer ticks when the first sample was taken
+ *   uint16_t   period      app_timer ticks between samples
+ *   uint8_t    count       number of samples that follow
+ *   count samples of the characteristic's sample type
+ *
+ * With the default ATT MTU of 23 two accel_values_t fit in each notification.
+ * With an ATT MTU of 247 39 fit.
+ */
+#define BLE_MPU_PACKET_HEADER_SIZE      7
+
+typedef struct
+{
+    uint32_t    timestamp;
+    uint16_t    period;
+    uint8_t     count;
+}ble_mpu_packet_header_t;
+
+/**@brief Sensors with a characteristic each. Samples are sent in the types listed. */
+typedef enum
+{
+    BLE_MPU_SENSOR_ACCEL,       // accel_values_t
+    BLE_MPU_SENSOR_GYRO,        // gyro_values_t
+    BLE_MPU_SENSOR_TEMP,        // temp_value_t
+    BLE_MPU_SENSOR_MAGN,        // magn_values_t
+    BLE_MPU_SENSOR_QUAT,        // ble_mpu_quat_t
+    BLE_MPU_SENSOR_GESTURE,     // uint8_t app_gesture_id_t of a recognized gesture
+    BLE_MPU_SENSOR_COUNT
+}ble_mpu_sensor_t;
+
+#define BLE_MPU_SENSOR_MASK(sensor)     (1 << (sensor))
+
+/**@brief Orientation quaternion in Q14 fixed point, so 1.0 is 16384 */
+typedef app_mpu_fusion_quat_t ble_mpu_quat_t;
+
+typedef struct ble_mpu_s ble_mpu_t;
+
+/**@brief Handler called when the peer subscribes to or unsubscribes from a characteristic.
+ * Use ble_mpu_subscriptions_get() to find out which sensors still have to be read.
+ */
+typedef void (* ble_mpu_evt_handler_t)(ble_mpu_t * p_mpu);
 
 typedef struct
+{
+    uint16_t                    sample_period;  /**< app_timer ticks between the samples in the blocks that will be sent. */
+    ble_mpu_evt_handler_t       evt_handler;    /**< Called when the subscriptions change. Can be NULL. */
+}ble_mpu_init_t;
+
+struct ble_mpu_s
 {
     uint16_t                    conn_handle;    /**< Handle of the current connection (as provided by the BLE stack, is BLE_CONN_HANDLE_INVALID if not in a connection).*/
     uint16_t                    service_handle; /**< Handle of ble Service (as provided by the BLE stack). */
-    ble_gatts_char_handles_t    accel_char_handles;   /**< Handles related to the our new characteristic. */
-}ble_mpu_t;
+    ble_gatts_char_handles_t    char_handles[BLE_MPU_SENSOR_COUNT];     /**< Handles of the characteristic of each sensor. */
+    uint8_t                     subscriptions;                          /**< BLE_MPU_SENSOR_MASK() of the characteristics with notifications enabled. */
+    ble_mpu_evt_handler_t       evt_handler;
+    uint16_t                    max_payload_len;                        /**< Largest notification on the current connection. */
+    uint16_t                    sample_period;                          /**< app_timer ticks between samples in the blocks that are sent. */
+    app_mpu_block_t           * tx_queue[BLE_MPU_TX_QUEUE_SIZE];        /**< Blocks being sent. The service holds a reference to each. */
+    uint8_t                     tx_head;
+    uint8_t                     tx_count;
+    uint8_t                     tx_sensor;                              /**< Sensor being sent from tx_queue[tx_head]. */
+    uint16_t                    tx_sample;                              /**< Next sample of tx_sensor to send from tx_queue[tx_head]. */
+    volatile bool               tx_busy;                                /**< A notification of tx_queue is being handed to the SoftDevice, from packet. */
+    volatile bool               tx_retry;                               /**< BLE_EVT_TX_COMPLETE came in since the notification was claimed. */
+    uint8_t                     packet[BLE_MPU_MAX_PAYLOAD_LEN];        /**< Notification being sent from tx_queue. Only written by the one that claimed it. */
+};
 
 /**@brief Function for handling BLE Stack events related to mpu service and characteristic.
  *
@@ -33,19 +105,95 @@ typedef struct
  */
 void ble_mpu_on_ble_evt(ble_mpu_t * p_mpu, ble_evt_t * p_ble_evt);
 
+/**@brief Function for handling ATT MTU changes from the nrf_ble_gatt module.
+ *
+ * @param[in]   p_mpu       mpu structure.
+ * @param[in]   p_evt       Event received from nrf_ble_gatt.
+ */
+void ble_mpu_on_gatt_evt(ble_mpu_t * p_mpu, nrf_ble_gatt_evt_t const * p_evt);
+
 /**@brief Function for initializing our new service.
  *
- * @param[in]   p_mpu       Pointer to ble mpu structure.
+ * @param[in]   p_mpu           Pointer to ble mpu structure.
+ * @param[in]   p_mpu_init      Service settings.
  */
-void ble_mpu_service_init(ble_mpu_t * p_mpu);
+void ble_mpu_service_init(ble_mpu_t * p_mpu, ble_mpu_init_t const * p_mpu_init);
 
-/**@brief Function for updating and sending new characteristic values
+/**@brief Function for getting the sensors the peer is subscribed to
  *
- * @details The application calls this function whenever our timer_timeout_handler triggers
+ * @param[in]   p_mpu       mpu structure.
+ * @retval      uint8_t     BLE_MPU_SENSOR_MASK() of each subscribed sensor. 0 when not connected.
+ */
+uint8_t ble_mpu_subscriptions_get(ble_mpu_t * p_mpu);
+
+/**@brief Function for reading the subscriptions from the CCCDs
+ *
+ * @details The subscriptions are otherwise only picked up from CCCD writes. A bonded peer
+ * does not write them again on reconnect, its CCCDs are restored with the system attributes.
+ * Called on BLE_GAP_EVT_CONNECTED, and by the application when the Peer Manager has secured
+ * the link or applied the system attributes. The event handler is called if they changed.
+ *
+ * @param[in]   p_mpu       mpu structure.
+ */
+void ble_mpu_subscriptions_read(ble_mpu_t * p_mpu);
+
+
+
+/**@brief Function for sending a block of samples
+ *
+ * @details The accelerometer, gyroscope and temperature values of the block are sent on each
+ * of those characteristics the peer is subscribed to, packed into as few notifications as the
+ * ATT MTU allows. The service takes its own reference to the block and releases it when the
+ * last sample has been handed to the SoftDevice, so the caller can release its reference
+ * right away. When the SoftDevice runs out of TX buffers the rest of the block is sent on
+ * BLE_EVT_TX_COMPLETE.
+ *
+ * @param[in]   p_mpu       mpu structure.
+ * @param[in]   p_block     Samples to send. p_block->timestamp is the time of the last sample.
+ * @retval      uint32_t    Error code. NRF_ERROR_INVALID_STATE if nobody is subscribed to the block sensors,
+ *                          NRF_ERROR_NO_MEM if the queue is full.
+ */
+uint32_t ble_mpu_block_send(ble_mpu_t * p_mpu, app_mpu_block_t * p_block);
+
+/**@brief Function for sending a single sample
+ *
+ * @details Used for the sensors that are not part of app_mpu_block_t, the magnetometer, the
+ * orientation quaternion and the recognized gestures. The sample is dropped if the SoftDevice has no free TX buffer.
+ *
+ * @param[in]   p_mpu       mpu structure.
+ * @param[in]   sensor      BLE_MPU_SENSOR_MAGN, BLE_MPU_SENSOR_QUAT or BLE_MPU_SENSOR_GESTURE.
+ * @param[in]   p_value     Sample, of the type listed in ble_mpu_sensor_t.
+ * @param[in]   timestamp   app_timer ticks when the sample was taken.
+ * @retval      uint32_t    Error code. NRF_ERROR_INVALID_STATE if nobody is subscribed to the sensor.
+ */
+uint32_t ble_mpu_sample_send(ble_mpu_t * p_mpu, ble_mpu_sensor_t sensor, void const * p_value, uint32_t timestamp);
+
+/**@brief Function for packing samples into a notification
+ *
+ * @param[out]  p_packet        Buffer for the notification
+ * @param[in]   max_len         Size of p_packet
+ * @param[in]   timestamp       app_timer ticks when the first sample was taken
+ * @param[in]   period          app_timer ticks between samples
+ * @param[in]   p_elements      First sample to pack
+ * @param[in]   element_size    Bytes per sample
+ * @param[in]   stride          Bytes from one sample to the next in p_elements
+ * @param[in]   count           Number of samples available
+ * @param[out]  p_packed        Number of samples packed. Limited by max_len
+ * @retval      uint16_t        Length of the notification
+ */
+uint16_t ble_mpu_packet_encode(uint8_t * p_packet, uint16_t max_len, uint32_t timestamp, uint16_t period,
+                               uint8_t const * p_elements, uint8_t element_size, uint16_t stride,
+                               uint16_t count, uint16_t * p_packed);
+
+/**@brief Function for unpacking a notification
  *
- * @param[in]   p_mpu                     mpu structure.
- * @param[in]   characteristic_value     New characteristic value.
+ * @param[in]   p_packet        Notification
+ * @param[in]   len             Length of the notification
+ * @param[in]   element_size    Bytes per sample
+ * @param[out]  p_header        Header of the notification
+ * @retval      uint8_t const*  First sample in the notification. NULL if the length does not match the header
  */
-void ble_mpu_update(ble_mpu_t *p_mpu, accel_values_t * accel_values);
+uint8_t const * ble_mpu_packet_decode(uint8_t const * p_packet, uint16_t len, uint8_t element_size,
+                                      ble_mpu_packet_header_t * p_header);
 
 #endif  /* _ MPU_SERVICE_H__ */
@@ -0,0 +1,253 @@
+ /*
+  * This code is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdint.h>
+#include <string.h>
+#include "ble_nus_stream.h"
+#include "app_util_platform.h"
+#include "app_trace.h"
+#include "nrf_error.h"
+
+#define BUFFER_MASK     (BLE_NUS_STREAM_BUFFER_SIZE - 1)
+
+STATIC_ASSERT((BLE_NUS_STREAM_BUFFER_SIZE & BUFFER_MASK) == 0);
+
+static void buffer_flush(ble_nus_stream_t * p_stream)
+{
+    CRITICAL_REGION_ENTER();
+    p_stream->head = p_stream->tail;
+    CRITICAL_REGION_EXIT();
+}
+
+
+
+static void enabled_update(ble_nus_stream_t * p_stream)
+{
+    bool enabled = (p_stream->p_nus->conn_handle != BLE_CONN_HANDLE_INVALID) && p_stream->p_nus->is_notification_enabled;
+
+    if(enabled == p_stream->enabled) return;
+
+    p_stream->enabled = enabled;
+    if(!enabled)
+    {
+        buffer_flush(p_stream);
+    }
+    if(p_stream->evt_handler != NULL)
+    {
+        p_stream->evt_handler(p_stream, enabled);
+    }
+}
+
+
+
+/**@brief Function for claiming the next notification from the ring buffer
+ *
+ * Only one caller at a time holds the claim, so notifications go out in order. The others
+ * leave their data to it, as it looks again after each notification. Must be called in a
+ * critical region.
+ *
+ * @retval      uint16_t        Bytes claimed from p_stream->head. 0 if there is nothing to send now
+ */
+static uint16_t tx_claim(ble_nus_stream_t * p_stream)
+{
+    uint32_t pending = p_stream->tail - p_stream->head;
+    uint16_t len     = MIN(pending, p_stream->max_payload_len);
+
+    if(!p_stream->enabled || p_stream->tx_busy)
+    {
+        return 0;
+    }
+    // A short notification is only sent when the link would otherwise be idle. While
+    // packets are in flight more data is likely to arrive before the next one is due.
+    if(len == 0 || (len < p_stream->max_payload_len && p_stream->tx_in_flight > 0))
+    {
+        return 0;
+    }
+    // Counted in flight already, in case its BLE_EVT_TX_COMPLETE comes before the result is committed
+    p_stream->tx_busy  = true;
+    p_stream->tx_retry = false;
+    p_stream->tx_in_flight++;
+    return len;
+}
+
+
+
+/**@brief Function for handing the ring buffer to the SoftDevice until it runs out of TX buffers.
+ * Called both when data is written and on BLE_EVT_TX_COMPLETE, from any priority. The critical
+ * regions only cover claiming the data and committing the result, the SoftDevice is called outside them.
+ */
+static void tx_process(ble_nus_stream_t * p_stream)
+{
+    ble_nus_t * p_nus = p_stream->p_nus;
+
+    for(;;)
+    {
+        ble_gatts_hvx_params_t hvx_params;
+        uint32_t head;
+        uint32_t offset;
+        uint16_t first;
+        uint16_t len;
+        uint32_t err_code;
+        bool     retry;
+
+        CRITICAL_REGION_ENTER();
+        head = p_stream->head;
+        len  = tx_claim(p_stream);
+        CRITICAL_REGION_EXIT();
+        if(len == 0)
+        {
+            return;
+        }
+
+        // The claimed bytes are not written to until head moves past them
+        offset = head & BUFFER_MASK;
+        first  = MIN(len, BLE_NUS_STREAM_BUFFER_SIZE - offset);
+        memcpy(p_stream->packet, &p_stream->buffer[offset], first);
+        memcpy(&p_stream->packet[first], p_stream->buffer, len - first);
+
+        memset(&hvx_params, 0, sizeof(hvx_params));
+        hvx_params.handle = p_nus->rx_handles.value_handle; // Notified to the peer, named from its side
+        hvx_params.type   = BLE_GATT_HVX_NOTIFICATION;
+        hvx_params.p_len  = &len;
+        hvx_params.p_data = p_stream->packet;
+
+        err_code = sd_ble_gatts_hvx(p_nus->conn_handle, &hvx_params);
+
+        CRITICAL_REGION_ENTER();
+        p_stream->tx_busy = false;
+        retry = p_stream->tx_retry; // TX buffers were freed while the SoftDevice was called
+        if(err_code == NRF_SUCCESS)
+        {
+            // Unless the buffer was flushed in the meantime
+            if(p_stream->head == head)
+            {
+                p_stream->head += len;
+            }
+            p_stream->bytes_sent += len;
+        }
+        else
+        {
+            if(p_stream->tx_in_flight > 0)
+            {
+                p_stream->tx_in_flight--;
+            }
+            if(err_code != BLE_ERROR_NO_TX_PACKETS)
+            {
+                p_stream->head = p_stream->tail; // The peer can not receive. Drop what is queued
+            }
+        }
+        CRITICAL_REGION_EXIT();
+
+        if(err_code == NRF_SUCCESS)
+        {
+            APP_TRACE(APP_TRACE_EVT_HVX, APP_TRACE_ID_NONE);
+        }
+        else if(!retry)
+        {
+            return; // Continued on BLE_EVT_TX_COMPLETE if the SoftDevice is out of TX buffers
+        }
+    }
+}
+
+
+
+void ble_nus_stream_init(ble_nus_stream_t * p_stream, ble_nus_t * p_nus, ble_nus_stream_evt_handler_t evt_handler)
+{
+    memset(p_stream, 0, sizeof(*p_stream));
+    p_stream->p_nus           = p_nus;
+    p_stream->evt_handler     = evt_handler;
+    p_stream->max_payload_len = GATT_MTU_SIZE_DEFAULT - 3;
+}
+
+
+
+uint32_t ble_nus_stream_write(ble_nus_stream_t * p_stream, uint8_t const * p_data, uint16_t length)
+{
+    uint32_t err_code = NRF_SUCCESS;
+
+    CRITICAL_REGION_ENTER();
+    if(!p_stream->enabled)
+    {
+        err_code = NRF_ERROR_INVALID_STATE;
+    }
+    else if(length > BLE_NUS_STREAM_BUFFER_SIZE - (p_stream->tail - p_stream->head))
+    {
+        p_stream->bytes_dropped += length;
+        err_code = NRF_ERROR_NO_MEM;
+    }
+    else
+    {
+        uint32_t offset = p_stream->tail & BUFFER_MASK;
+        uint16_t first  = MIN(length, BLE_NUS_STREAM_BUFFER_SIZE - offset);
+
+        memcpy(&p_stream->buffer[offset], p_data, first);
+        memcpy(p_stream->buffer, &p_data[first], length - first);
+        p_stream->tail += length;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(err_code == NRF_SUCCESS)
+    {
+        tx_process(p_stream);
+    }
+    return err_code;
+}
+
+
+
+uint32_t ble_nus_stream_pending_get(ble_nus_stream_t const * p_stream)
+{
+    return p_stream->tail - p_stream->head;
+}
+
+
+
+void ble_nus_stream_on_ble_evt(ble_nus_stream_t * p_stream, ble_evt_t * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            p_stream->max_payload_len = GATT_MTU_SIZE_DEFAULT - 3;
+            p_stream->tx_in_flight    = 0;
+            break;
+        case BLE_GAP_EVT_DISCONNECTED:
+            p_stream->tx_in_flight = 0;
+            enabled_update(p_stream);
+            break;
+        case BLE_GATTS_EVT_WRITE:
+            enabled_update(p_stream);
+            break;
+        case BLE_EVT_TX_COMPLETE:
+        {
+            uint8_t count = p_ble_evt->evt.common_evt.params.tx_complete.count;
+
+            APP_TRACE(APP_TRACE_EVT_TX_COMPLETE, APP_TRACE_ID_NONE);
+            CRITICAL_REGION_ENTER();
+            // Also counts notifications from the other services, so it may run ahead
+            p_stream->tx_in_flight = (count < p_stream->tx_in_flight) ? (p_stream->tx_in_flight - count) : 0;
+            p_stream->tx_retry     = true; // In case a notification is refused for want of them right now
+            CRITICAL_REGION_EXIT();
+            tx_process(p_stream);
+        } break;
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+
+
+void ble_nus_stream_on_gatt_evt(ble_nus_stream_t * p_stream, nrf_ble_gatt_evt_t const * p_evt)
+{
+    if(p_evt->conn_handle == p_stream->p_nus->conn_handle)
+    {
+        p_stream->max_payload_len = MIN(p_evt->att_mtu_effective - 3, BLE_NUS_STREAM_MAX_PAYLOAD_LEN);
+    }
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,112 @@
+ /*
+  * This code is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef BLE_NUS_STREAM_H__
+#define BLE_NUS_STREAM_H__
+
+/* Byte stream over the Nordic UART Service.
+ *
+ * Writers append to a ring buffer, from any priority. The buffer is drained into NUS
+ * notifications of the full payload size, and only sent short when nothing else is in
+ * flight, so small writes (sensor frames, UART bytes) are coalesced while the link is busy.
+ * Notifications are queued until the SoftDevice returns BLE_ERROR_NO_TX_PACKETS and the
+ * rest stays in the ring buffer until the next BLE_EVT_TX_COMPLETE, so the SoftDevice
+ * always has packets for the next connection event and nothing is dropped.
+ *
+ * A write is all or nothing, so a frame is never cut when the buffer is full.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nordic_common.h"
+#include "ble.h"
+#include "ble_nus.h"
+#include "nrf_ble_gatt.h"
+
+#ifndef BLE_NUS_STREAM_BUFFER_SIZE
+#define BLE_NUS_STREAM_BUFFER_SIZE      1024    // Must be a power of two
+#endif
+
+#define BLE_NUS_STREAM_MAX_PAYLOAD_LEN  MIN(NRF_BLE_GATT_MAX_MTU_SIZE - 3, BLE_NUS_MAX_DATA_LEN) // Limited by the NUS characteristic length
+
+typedef struct ble_nus_stream_s ble_nus_stream_t;
+
+/**@brief Called when the peer enables or disables notifications, or disconnects. */
+typedef void (*ble_nus_stream_evt_handler_t)(ble_nus_stream_t * p_stream, bool enabled);
+
+/**@brief Stream state */
+struct ble_nus_stream_s
+{
+    ble_nus_t *         p_nus;
+    ble_nus_stream_evt_handler_t evt_handler;
+    bool                enabled;            // The peer receives notifications
+    uint8_t             buffer[BLE_NUS_STREAM_BUFFER_SIZE];
+    volatile uint32_t   head;               // Read index. Free running, wraps on the buffer size
+    volatile uint32_t   tail;               // Write index
+    uint16_t            max_payload_len;    // Notification size at the current ATT MTU
+    uint8_t             tx_in_flight;       // Notifications queued in the SoftDevice
+    volatile bool       tx_busy;            // A notification is being handed to the SoftDevice, from packet
+    volatile bool       tx_retry;           // BLE_EVT_TX_COMPLETE came in since the notification was claimed
+    uint8_t             packet[BLE_NUS_STREAM_MAX_PAYLOAD_LEN];
+    uint32_t            bytes_sent;         // Handed to the SoftDevice since init. Wraps
+    uint32_t            bytes_dropped;      // Rejected by ble_nus_stream_write() since init. Wraps
+};
+
+
+
+/**@brief Function for initiating a stream on a Nordic UART Service
+ *
+ * @param[out]  p_stream        Stream state
+ * @param[in]   p_nus           Initiated Nordic UART Service
+ * @param[in]   evt_handler     Function called when the stream is enabled or disabled. Can be NULL
+ */
+void ble_nus_stream_init(ble_nus_stream_t * p_stream, ble_nus_t * p_nus, ble_nus_stream_evt_handler_t evt_handler);
+
+
+
+/**@brief Function for appending data to the stream
+ *
+ * @param[in]   p_stream        Stream state
+ * @param[in]   p_data          Data
+ * @param[in]   length          Number of bytes
+ * @retval      uint32_t        Error code. NRF_ERROR_INVALID_STATE if the peer has not enabled notifications,
+ *                              NRF_ERROR_NO_MEM if the data does not fit in the ring buffer. Nothing is written then
+ */
+uint32_t ble_nus_stream_write(ble_nus_stream_t * p_stream, uint8_t const * p_data, uint16_t length);
+
+
+
+/**@brief Function for getting the number of bytes waiting in the ring buffer
+ *
+ * @param[in]   p_stream        Stream state
+ * @retval      uint32_t        Bytes not yet handed to the SoftDevice
+ */
+uint32_t ble_nus_stream_pending_get(ble_nus_stream_t const * p_stream);
+
+
+
+/**@brief Function for handling BLE events. Must be called after ble_nus_on_ble_evt()
+ *
+ * @param[in]   p_stream        Stream state
+ * @param[in]   p_ble_evt       Event received from the BLE stack
+ */
+void ble_nus_stream_on_ble_evt(ble_nus_stream_t * p_stream, ble_evt_t * p_ble_evt);
+
+
+
+/**@brief Function for handling GATT module events, to follow the ATT MTU
+ *
+ * @param[in]   p_stream        Stream state
+ * @param[in]   p_evt           Event from the GATT module
+ */
+void ble_nus_stream_on_gatt_evt(ble_nus_stream_t * p_stream, nrf_ble_gatt_evt_t const * p_evt);
+
+
+#endif /* BLE_NUS_STREAM_H__ */
+
+/**
+  @}
+*/
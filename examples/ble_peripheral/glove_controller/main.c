@@ -43,6 +43,23 @@
 #include "nrf_delay.h"
 #include "mpu6050.h"
 #include "twi_master.h"
+#include "nrf_ble_gatt.h"
+#include "app_mpu.h"
+#include "nrf_drv_mpu.h"
+#include "app_mpu_block.h"
+#include "app_mpu_fusion.h"
+#include "app_mpu_calib.h"
+#include "app_mpu_activity.h"
+#include "ble_mpu.h"
+#include "ble_nus_stream.h"
+#include "ble_conn_policy.h"
+#include "app_frame.h"
+#include "app_flex.h"
+#include "app_sync.h"
+#include "app_trace.h"
+#include "app_gesture.h"
+#include "app_hid_map.h"
+#include "ble_glove_hid.h"
 
 #define NRF_LOG_MODULE_NAME "APP"
 #include "nrf_log.h"
@@ -51,7 +68,7 @@
 #define IS_SRVC_CHANGED_CHARACT_PRESENT 1                                           /// Include or not the service_changed characteristic. if not enabled, the server's database cannot be changed for the lifetime of the device
 
 #if (NRF_SD_BLE_API_VERSION == 3)
-#define NRF_BLE_MAX_MTU_SIZE            GATT_MTU_SIZE_DEFAULT                       // Maximum Transmission Unit size used in the softdevice enabling and to reply to a BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST event
+#define NRF_BLE_MAX_MTU_SIZE            NRF_BLE_GATT_MAX_MTU_SIZE                   // Maximum Transmission Unit size used in the softdevice enabling and requested by nrf_ble_gatt
 #endif
 
 #define APP_FEATURE_NOT_SUPPORTED       BLE_GATT_STATUS_ATTERR_APP_BEGIN + 2        // Reply when unsupported features are requested. 
@@ -70,11 +87,17 @@
 #define APP_TIMER_PRESCALER             0                                           // Value of the RTC1 PRESCALER register. 
 #define APP_TIMER_OP_QUEUE_SIZE         4                                           // Size of timer operation queues. 
 
-#define MIN_CONN_INTERVAL               MSEC_TO_UNITS(100, UNIT_1_25_MS)            // Minimum acceptable connection interval (0.1 seconds). 
-#define MAX_CONN_INTERVAL               MSEC_TO_UNITS(200, UNIT_1_25_MS)            // Maximum acceptable connection interval (0.2 second). 
+#define MIN_CONN_INTERVAL               MSEC_TO_UNITS(7.5, UNIT_1_25_MS)            // Minimum acceptable connection interval while the hand moves (7.5 ms). 
+#define MAX_CONN_INTERVAL               MSEC_TO_UNITS(15, UNIT_1_25_MS)             // Maximum acceptable connection interval while the hand moves (15 ms). 
 #define SLAVE_LATENCY                   0                                           // Slave latency. 
 #define CONN_SUP_TIMEOUT                MSEC_TO_UNITS(4000, UNIT_10_MS)             // Connection supervisory timeout (4000 milliseconds). 
 
+#define IDLE_MIN_CONN_INTERVAL          MSEC_TO_UNITS(200, UNIT_1_25_MS)            // Connection interval while the hand is still (0.2 to 0.4 seconds). 
+#define IDLE_MAX_CONN_INTERVAL          MSEC_TO_UNITS(400, UNIT_1_25_MS)
+#define IDLE_SLAVE_LATENCY              4                                           // Connection events the glove may skip while the hand is still. 
+#define IDLE_CONN_SUP_TIMEOUT           MSEC_TO_UNITS(6000, UNIT_10_MS)             // Must be longer than 2 x (1 + IDLE_SLAVE_LATENCY) x IDLE_MAX_CONN_INTERVAL. 
+#define IDLE_STILL_WINDOWS              4                                           // Still calibration windows in a row before the idle parameters are requested. 
+
 #define FIRST_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER)  // Time from initiating event (connect or start of notification) to first time sd_ble_gap_conn_param_update is called (5000 milliseconds). 
 #define NEXT_CONN_PARAMS_UPDATE_DELAY   APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER) // Time between each call to sd_ble_gap_conn_param_update after the first call (30000 seconds). 
 #define MAX_CONN_PARAMS_UPDATE_COUNT    3                                           // Number of attempts before giving up the connection parameter negotiation. 
@@ -91,20 +114,168 @@
 #define DEAD_BEEF                       0xDEADBEEF                                  // Value used as error code on stack dump, can be used to identify stack location on stack unwind. 
 
 #define UART_TX_BUF_SIZE                256                                         // UART TX buffer size.
-#define UART_RX_BUF_SIZE                1                                        // UART RX buffer size.
+#define UART_RX_BUF_SIZE                64                                          // UART RX buffer size. Holds the bytes received while the UART interrupt is held off
+
+#define MPU_SAMPLE_PERIOD_MS            10                                          // MPU sample rate is 1 kHz / (1 + MPU_SMPLRT_DIV)
+#define MPU_SMPLRT_DIV                  9
+#define MPU_SAMPLE_PERIOD               APP_TIMER_TICKS(MPU_SAMPLE_PERIOD_MS, APP_TIMER_PRESCALER)
+#define MPU_DRAIN_INTERVAL_MS           100                                         // How often the MPU FIFO is read. Must be shorter than APP_MPU_BLOCK_SAMPLES sample periods
+#define MPU_DRAIN_INTERVAL              APP_TIMER_TICKS(MPU_DRAIN_INTERVAL_MS, APP_TIMER_PRESCALER)
+#define MPU_DRAIN_INTERVAL_MIN_MS       20                                          // Drains follow the connection interval down to this, so each block fills one connection event
+#define MPU_IDLE_WINDOWS                8                                           // Still calibration windows in a row before the MPU is put in low power cycle mode (5 s)
+#define MPU_WAKE_THRESHOLD_MG           64                                          // Change in acceleration that wakes the MPU from low power cycle mode
+#if defined(MPU9255)
+#define MPU_WAKE_RATE                   LP_WAKE_31_25HZ                             // Accelerometer rate in low power cycle mode
+#else
+#define MPU_WAKE_RATE                   LP_WAKE_20HZ
+#endif
+#define MPU_READY_QUEUE_SIZE            APP_MPU_BLOCK_POOL_SIZE                     // Filled blocks waiting to be handed to the services
+#define MPU_CHANNELS                    (sizeof(imu_sample_t) / sizeof(int16_t))    // Each imu_sample_t is sent whole in the NUS frames
+#define NUS_STATS_INTERVAL_MS           1000                                        // How often the NUS stream throughput is logged
+#define TRACE_REPORT_INTERVAL           10                                          // NUS stats intervals between latency reports, with APP_TRACE_ENABLED
+#define TRACE_DUMP                      0                                           // 1 also logs every traced event, for tools/trace_report.py
+#define TRACE_ID(p_block)               ((uint16_t)(uintptr_t)(p_block))            // Tells the blocks in flight apart in the latency trace
+
+#define FRAME_STREAM_SYNC               0                                           // app_frame stream id of the aligned samples on the NUS stream
+#define FRAME_STREAM_UART               1                                           // app_frame stream id of the raw frames of bytes from the UART
+
+#define FLEX_SCAN_PERIOD_US             1250                                        // Flex sample period is FLEX_SCAN_PERIOD_US * FLEX_OVERSAMPLE
+#define FLEX_OVERSAMPLE                 8
+#define FLEX_SAMPLE_PERIOD_MS           10
+#define FLEX_SAMPLE_PERIOD              APP_TIMER_TICKS(FLEX_SAMPLE_PERIOD_MS, APP_TIMER_PRESCALER)
+#define FLEX_DEPTH                      5                                           // Flex samples per block handed to the main loop
+#define FLEX_INVERT                     0x00                                        // Bit per finger whose divider output falls as it bends
+#if defined(NRF52)
+#define FLEX_AIN                        {0, 3, 4, 5, 6}                             // AIN1 and AIN2 are the MPU TWI pins
+#else
+#define FLEX_AIN                        {4, 5, 6, 7}                                // AIN0 and AIN1 hold the 32 kHz crystal, AIN2 and AIN3 are the MPU TWI pins
+#endif
+
+#define GESTURE_ROTATE_RATE             1476                                        // Default model: 90 deg/s at GFS_2000DPS
+#define GESTURE_TAP_PEAK                3072                                        // Default model: 1.5 g at AFS_16G
+#define GESTURE_GRAB_BEND               19660                                       // Default model: 60 % of the calibrated finger range
+
+#ifndef HID_ENABLED
+#define HID_ENABLED                     0                                           // 1 to add the HID service, so the glove works as an air mouse or gamepad
+#endif
+#define HID_MODE                        APP_HID_MAP_MOUSE                           // APP_HID_MAP_MOUSE or APP_HID_MAP_GAMEPAD
+#define HID_ATTR_TAB_EXTRA              0x300                                       // GATT table room for the HID service. Move the RAM start up as much
+#define HID_MOUSE_GAIN                  -600                                        // Cursor counts per radian the hand turns (about 10 per degree)
+#define HID_STICK_GAIN                  254                                         // Full stick at 30 degrees tilt
+#define HID_DEADZONE                    8                                           // Q14. Mouse: radians per update. Gamepad: sine of the tilt
+#define HID_RELEASE_BEND                13107                                       // 40 % of the finger range. Pressed at GESTURE_GRAB_BEND
 
 static uint16_t m_conn_handle = BLE_CONN_HANDLE_INVALID;                            // Handle of the current connection.
 
 //: Declare all services structure the application is using such as mpu6050 and uart
 static ble_nus_t                        m_nus;                                      // Structure to identify the Nordic UART Service. 
+static ble_mpu_t                        m_mpu;                                      // Structure to identify the MPU service.
+static ble_nus_stream_t                 m_nus_stream;                               // Ring buffered stream of NUS notifications.
+static nrf_ble_gatt_t                   m_gatt;                                     // GATT module instance. Negotiates the ATT MTU.
+static ble_conn_policy_t                m_conn_policy;                              // Short connection interval while the hand moves, long while it is still.
+
+APP_TIMER_DEF(m_mpu_drain_timer_id);                                                // Timer reading the MPU FIFO.
+APP_TIMER_DEF(m_nus_stats_timer_id);                                                // Timer logging the NUS stream throughput.
+
+// Blocks filled from the TWI interrupt, handed to the services from the main loop
+static app_mpu_block_t * volatile       m_ready_blocks[MPU_READY_QUEUE_SIZE];
+static volatile uint8_t                 m_ready_head;
+static volatile uint8_t                 m_ready_tail;
+
+static volatile bool                    m_mpu_drain_pending;                        // A FIFO drain is in flight on the TWI bus
+static volatile bool                    m_mpu_fifo_update;                          // m_mpu_fifo_config changed and must be written to the MPU
+static volatile bool                    m_mpu_idle_request;                         // The main loop puts the MPU in low power cycle mode between two drains
+static volatile uint32_t                m_mpu_drain_interval = MPU_DRAIN_INTERVAL;  // Follows the connection interval
+static app_mpu_fifo_en_t                m_mpu_fifo_config;                          // Sensors the subscribed characteristics need from the FIFO
+static app_mpu_fusion_t                 m_mpu_fusion;                               // Orientation for the quaternion characteristic
+static app_mpu_calib_t                  m_mpu_calib;                                // Loaded from flash at boot and refined while the glove is still
+static app_mpu_calib_collector_t        m_mpu_calib_collector;
+static bool                             m_mpu_calib_dirty;                          // m_mpu_calib has changed since it was saved
+static app_frame_encoder_t              m_frame_encoder;                            // Aligned samples sent as frames on the NUS stream
+static uint8_t                          m_frame[APP_FRAME_MAX_LEN];
+static volatile bool                    m_nus_frames_enabled;                       // The peer has enabled NUS notifications
+static bool                             m_fds_gc_resume_pending;                    // Garbage collection is to resume once the FDS queue has room
+
+static const uint8_t                    m_flex_ain[] = FLEX_AIN;                    // Analog input of each finger
+#define FLEX_CHANNELS                   sizeof(m_flex_ain)
+static int16_t                          m_flex_buffer[APP_FLEX_BUFFER_SIZE(FLEX_CHANNELS, FLEX_DEPTH, FLEX_OVERSAMPLE)];
+#if defined(MPU_MAGN_AVAILABLE)
+#define MAGN_CHANNELS                   (sizeof(magn_values_t) / sizeof(int16_t))
+#else
+#define MAGN_CHANNELS                   0
+#endif
+#define SYNC_CHANNELS                   (MPU_CHANNELS + MAGN_CHANNELS + FLEX_CHANNELS)  // Each IMU sample, then the magnetometer and fingers resampled at its timestamp
+static int16_t const * volatile         m_flex_block;                               // Filled in the ADC interrupt, taken by the main loop
+static volatile uint32_t                m_flex_block_timestamp;                     // Of the last sample in m_flex_block
+static bool                             m_flex_running;
+static app_flex_calib_t                 m_flex_calib;                               // Widened while the glove is worn
+static app_sync_stream_t                m_sync_flex;                                // Finger bends waiting to be aligned with the IMU samples
+#if defined(MPU_MAGN_AVAILABLE)
+static app_sync_stream_t                m_sync_magn;
+static volatile bool                    m_magn_read_request;                        // Set by the drain timer, read by the main loop
+#endif
+static int16_t                          m_sync_tuples[APP_MPU_BLOCK_SAMPLES * SYNC_CHANNELS];
+static app_gesture_model_t              m_gesture_model;                            // Loaded from flash at boot, or the default model
+static app_gesture_t                    m_gesture;                                  // Recognizer running on the aligned samples
+static app_gesture_upload_t             m_gesture_upload;                           // Model image written over NUS by the host training tools
+static app_gesture_model_t              m_gesture_uploaded;                         // Model of the last committed upload
+static volatile bool                    m_gesture_upload_ready;                     // m_gesture_uploaded is checked and replaces m_gesture_model from the main loop
+#if HID_ENABLED
+static ble_glove_hid_t                  m_hid;                                      // HID service
+static app_hid_map_t                    m_hid_map;                                  // Hand motion, fingers and gestures to HID reports
+#endif
+#if APP_TRACE_ENABLED
+static volatile bool                    m_trace_report_pending;                     // Set by the NUS stats timer, reported from the main loop
+#endif
+
+STATIC_ASSERT(SYNC_CHANNELS <= APP_FRAME_MAX_CHANNELS);
+STATIC_ASSERT(UART_RX_BUF_SIZE + APP_FRAME_RAW_HEADER_SIZE <= APP_FRAME_MAX_LEN);  // The UART bytes go in one raw frame
+
+// Default gesture model, used until a trained one is stored. Grab from the index and middle fingers,
+// rotation from the mean roll rate and tap from the peak vertical acceleration. Swipes need a trained model.
+#define GESTURE_SIGNAL_ROLL             0
+#define GESTURE_SIGNAL_VERTICAL         1
+#define GESTURE_SIGNAL_INDEX            2
+#define GESTURE_SIGNAL_MIDDLE           3
+static const app_gesture_model_t        m_gesture_default_model =
+{
+    .version        = APP_GESTURE_MODEL_VERSION,
+    .signal_count   = 4,
+    .node_count     = 11,
+    .signals        = {offsetof(imu_sample_t, gyro.x) / sizeof(int16_t),
+                       offsetof(imu_sample_t, accel.z) / sizeof(int16_t),
+                       MPU_CHANNELS + MAGN_CHANNELS + 1,                            // Second and third finger in FLEX_AIN
+                       MPU_CHANNELS + MAGN_CHANNELS + 2},
+    .window         = 32,                                                           // 320 ms
+    .hop            = 4,
+    .votes          = 2,
+    .holdoff        = 10,
+    .nodes          =
+    {
+        APP_GESTURE_NODE_SPLIT(GESTURE_SIGNAL_INDEX,    APP_GESTURE_FEATURE_MEAN, GESTURE_GRAB_BEND,    1, 2),  // 0
+        APP_GESTURE_NODE_SPLIT(GESTURE_SIGNAL_ROLL,     APP_GESTURE_FEATURE_MEAN, -GESTURE_ROTATE_RATE, 5, 6),  // 1
+        APP_GESTURE_NODE_SPLIT(GESTURE_SIGNAL_MIDDLE,   APP_GESTURE_FEATURE_MEAN, GESTURE_GRAB_BEND,    3, 4),  // 2
+        APP_GESTURE_NODE_LEAF(APP_GESTURE_NONE),                                                                 // 3
+        APP_GESTURE_NODE_LEAF(APP_GESTURE_GRAB),                                                                 // 4
+        APP_GESTURE_NODE_LEAF(APP_GESTURE_ROTATE_CCW),                                                           // 5
+        APP_GESTURE_NODE_SPLIT(GESTURE_SIGNAL_ROLL,     APP_GESTURE_FEATURE_MEAN, GESTURE_ROTATE_RATE,  7, 8),  // 6
+        APP_GESTURE_NODE_SPLIT(GESTURE_SIGNAL_VERTICAL, APP_GESTURE_FEATURE_PEAK, GESTURE_TAP_PEAK,     9, 10), // 7
+        APP_GESTURE_NODE_LEAF(APP_GESTURE_ROTATE_CW),                                                            // 8
+        APP_GESTURE_NODE_LEAF(APP_GESTURE_NONE),                                                                 // 9
+        APP_GESTURE_NODE_LEAF(APP_GESTURE_TAP),                                                                  // 10
+    },
+};
 
 // Need to include UUIDs for sensor and uart services
-static ble_uuid_t m_adv_uuids[] = {{BLE_UUID_DEVICE_INFORMATION_SERVICE, BLE_UUID_TYPE_BLE}}; /**< Universally unique service identifiers. */
+static ble_uuid_t m_adv_uuids[] = {{BLE_UUID_DEVICE_INFORMATION_SERVICE, BLE_UUID_TYPE_BLE}, /**< Universally unique service identifiers. */
+#if HID_ENABLED
+                                   {BLE_UUID_HUMAN_INTERFACE_DEVICE_SERVICE, BLE_UUID_TYPE_BLE},
+#endif
+                                  };
 
 // starts advertising BLE
 static void advertising_start(void);
 
-static uint32_t status = 0xFFFFFFFF; 
 
 // Callback function for asserts in the SoftDevice.
 // This function will be called in case of an assert in the SoftDevice.
@@ -130,6 +301,13 @@ static void pm_evt_handler(pm_evt_t const * p_evt){
                          ble_conn_state_role(p_evt->conn_handle),
                          p_evt->conn_handle,
                          p_evt->params.conn_sec_succeeded.procedure);
+            // The CCCDs of a bonded peer are restored by now
+            ble_mpu_subscriptions_read(&m_mpu);
+        } break;
+
+        case PM_EVT_LOCAL_DB_CACHE_APPLIED:
+        {
+            ble_mpu_subscriptions_read(&m_mpu);
         } break;
 
         case PM_EVT_CONN_SEC_FAILED:
@@ -201,7 +379,6 @@ static void pm_evt_handler(pm_evt_t const * p_evt){
         case PM_EVT_CONN_SEC_START:
         case PM_EVT_PEER_DATA_UPDATE_SUCCEEDED:
         case PM_EVT_PEER_DELETE_SUCCEEDED:
-        case PM_EVT_LOCAL_DB_CACHE_APPLIED:
         case PM_EVT_SERVICE_CHANGED_IND_SENT:
         case PM_EVT_SERVICE_CHANGED_IND_CONFIRMED:
         default:
@@ -210,13 +387,506 @@ static void pm_evt_handler(pm_evt_t const * p_evt){
 }
 
 
+// Called from the TWI interrupt when a FIFO drain is finished. Passes the block on to the main loop.
+static void mpu_block_ready_handler(uint32_t result, void * p_context)
+{
+    app_mpu_block_t * p_block = (app_mpu_block_t *)p_context;
+    uint8_t next = (m_ready_tail + 1) % MPU_READY_QUEUE_SIZE;
+
+    APP_TRACE(APP_TRACE_EVT_BUS_END, TRACE_ID(p_block));
+    p_block->timestamp = app_timer_cnt_get();
+    m_mpu_drain_pending = false;
+
+    if(result != NRF_SUCCESS || p_block->num_samples == 0 || next == m_ready_head)
+    {
+        app_mpu_block_release(p_block);
+        return;
+    }
+    m_ready_blocks[m_ready_tail] = p_block;
+    m_ready_tail = next;
+}
+
+
+// Whether the host listens to the HID reports.
+static bool hid_enabled(void)
+{
+#if HID_ENABLED
+    return ble_glove_hid_enabled(&m_hid);
+#else
+    return false;
+#endif
+}
+
+
+// Whether the gesture recognizer is needed, for the gesture characteristic or the HID buttons.
+static bool gestures_enabled(void)
+{
+    return hid_enabled() || (ble_mpu_subscriptions_get(&m_mpu) & BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_GESTURE));
+}
+
+
+// Whether the aligned samples are needed, for the NUS frames or the gesture recognizer.
+static bool sync_enabled(void)
+{
+    return m_nus_frames_enabled || gestures_enabled();
+}
+
+
+// Writes the FIFO configuration picked by ble_mpu_evt_handler(). Only called between drains,
+// as app_mpu_fifo_enable() uses the blocking TWI transfers. If the write fails, for instance
+// because the TWI is busy with a main loop transfer, it is tried again on the next drain.
+static void mpu_fifo_update(void)
+{
+    uint32_t err_code;
+    app_mpu_fifo_en_t fifo_config;
+
+    // Taken together, so a change made while writing is not lost
+    CRITICAL_REGION_ENTER();
+    fifo_config = m_mpu_fifo_config;
+    m_mpu_fifo_update = false;
+    CRITICAL_REGION_EXIT();
+
+    if(fifo_config.accel || fifo_config.gyro_x || fifo_config.temp)
+    {
+        err_code = app_mpu_fifo_enable(&fifo_config);
+    }
+    else
+    {
+        err_code = app_mpu_fifo_disable();
+    }
+    if(err_code != NRF_SUCCESS)
+    {
+        m_mpu_fifo_update = true;
+    }
+}
+
+
+// Puts the MPU in low power cycle mode and stops the drains until it sees motion. See mpu_activity_evt_handler().
+// Runs from the main loop, as the register writes are blocking. The drains are stopped first, so none
+// runs in between. If a write fails, the MPU has been put back as it was and the drains start again.
+static void mpu_idle_enter(void)
+{
+    uint32_t err_code;
+
+    err_code = app_timer_stop(m_mpu_drain_timer_id);
+    APP_ERROR_CHECK(err_code);
+    if(m_mpu_drain_pending)
+    {
+        // Tried again on the next pass of the main loop
+        err_code = app_timer_start(m_mpu_drain_timer_id, m_mpu_drain_interval, NULL);
+        APP_ERROR_CHECK(err_code);
+        return;
+    }
+
+    m_mpu_idle_request = false;
+    if(app_mpu_activity_idle_enter() != NRF_SUCCESS)
+    {
+        m_mpu_fifo_update = true; // The FIFO may have been disabled on the way
+        err_code = app_timer_start(m_mpu_drain_timer_id, m_mpu_drain_interval, NULL);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+#if defined(MPU_MAGN_AVAILABLE)
+// Reads the magnetometer once per drain. Runs from the main loop and not the drain timer, as a blocking
+// read from the timer interrupt would find the bus taken by one from the main loop and fail with NRF_ERROR_BUSY.
+// A failed read is tried again on the next pass of the main loop.
+static void mpu_magn_process(void)
+{
+    magn_values_t magn_values;
+    uint32_t      timestamp;
+
+    if(!m_magn_read_request)
+    {
+        return;
+    }
+    if(app_mpu_read_magnetometer(&magn_values, NULL) != NRF_SUCCESS)
+    {
+        return;
+    }
+    m_magn_read_request = false;
+    timestamp = app_timer_cnt_get();
+
+    app_mpu_calib_magn_add(&m_mpu_calib_collector, &magn_values.x);
+    app_mpu_calib_correct(&m_mpu_calib, NULL, NULL, &magn_values.x);
+    (void)ble_mpu_sample_send(&m_mpu, BLE_MPU_SENSOR_MAGN, &magn_values, timestamp);
+    app_sync_push(&m_sync_magn, timestamp, &magn_values.x);
+}
+#endif
+
+
+// Starts reading the samples that have collected in the MPU FIFO into a new block.
+static void mpu_drain_timeout_handler(void * p_context)
+{
+    uint32_t err_code;
+    app_mpu_block_t * p_block;
+
+    if(m_mpu_drain_pending || app_mpu_activity_state_get() != APP_MPU_ACTIVITY_ACTIVE)
+    {
+        return; // Last drain is not finished yet, or the MPU is idle
+    }
+    APP_TRACE(APP_TRACE_EVT_DRAIN, APP_TRACE_ID_NONE);
+    if(m_mpu_fifo_update)
+    {
+        mpu_fifo_update();
+    }
+
+#if defined(MPU_MAGN_AVAILABLE)
+    if(sync_enabled() || (ble_mpu_subscriptions_get(&m_mpu) & BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_MAGN)))
+    {
+        m_magn_read_request = true; // The read is blocking, see mpu_magn_process()
+    }
+#endif
+
+    if(!(m_mpu_fifo_config.accel || m_mpu_fifo_config.gyro_x || m_mpu_fifo_config.temp))
+    {
+        return; // Nobody needs the FIFO sensors, so the FIFO is off
+    }
+
+    p_block = app_mpu_block_alloc();
+    if(p_block == NULL)
+    {
+        return; // All blocks are still in use. The samples stay in the FIFO until next time
+    }
+
+    m_mpu_drain_pending = true;
+    APP_TRACE(APP_TRACE_EVT_BUS_START, TRACE_ID(p_block));
+    err_code = app_mpu_block_fifo_read_async(p_block, mpu_block_ready_handler, p_block);
+    if(err_code != NRF_SUCCESS)
+    {
+        m_mpu_drain_pending = false;
+        app_mpu_block_release(p_block);
+    }
+}
+
+
+// Refines the calibration with a block of raw samples and then corrects them.
+// Returns the error of writing a new gyroscope bias. The next still window tries again.
+static uint32_t mpu_block_calibrate(app_mpu_block_t * p_block)
+{
+    uint32_t err_code = NRF_SUCCESS;
+    bool    accel   = m_mpu_fifo_config.accel;
+    bool    gyro    = m_mpu_fifo_config.gyro_x;
+    uint8_t valid   = m_mpu_calib.valid;
+    uint8_t updated = 0;
+
+    for(uint16_t i = 0; i < p_block->num_samples; i++)
+    {
+        imu_sample_t * p_sample = &p_block->samples[i];
+
+        if(accel && gyro)
+        {
+            updated |= app_mpu_calib_sample_add(&m_mpu_calib_collector, &m_mpu_calib, &p_sample->accel, &p_sample->gyro);
+        }
+        app_mpu_calib_correct(&m_mpu_calib, accel ? &p_sample->accel : NULL, gyro ? &p_sample->gyro : NULL, NULL);
+    }
+
+    if(updated & APP_MPU_CALIB_VALID_GYRO)
+    {
+        err_code = app_mpu_calib_gyro_apply(&m_mpu_calib_collector, &m_mpu_calib);
+    }
+    // Save new fits, but not every small gyroscope bias update, to spare the flash
+    if((updated & APP_MPU_CALIB_VALID_ACCEL) || (m_mpu_calib.valid != valid))
+    {
+        m_mpu_calib_dirty = true;
+    }
+    return err_code;
+}
+
+
+// Sends samples as frames on the NUS stream. A frame that does not fit in the stream is lost,
+// so the next one is made a keyframe for the peer to resynchronise on.
+static void frames_send(app_frame_encoder_t * p_encoder, uint32_t timestamp, uint16_t period,
+                        int16_t const * p_samples, uint16_t stride, uint16_t num_samples)
+{
+    uint16_t sent = 0;
+
+    while(sent < num_samples)
+    {
+        uint16_t packed;
+        uint16_t len = app_frame_encode(p_encoder, m_frame, sizeof(m_frame),
+                                        timestamp + (sent * period), period,
+                                        &p_samples[sent * stride], stride,
+                                        num_samples - sent, &packed);
+        if(len == 0)
+        {
+            break;
+        }
+        if(ble_nus_stream_write(&m_nus_stream, m_frame, len) != NRF_SUCCESS)
+        {
+            app_frame_key_request(p_encoder);
+        }
+        sent += packed;
+    }
+}
+
+
+// Fills m_sync_tuples with each IMU sample of a block and the magnetometer and fingers resampled at its timestamp.
+// A sensor with no samples yet is 0. Returns the time of the first sample.
+static uint32_t mpu_block_sync(app_mpu_block_t * p_block)
+{
+    // Time of the first sample, counted back from the last sample in the block
+    uint32_t timestamp = p_block->timestamp - ((p_block->num_samples - 1) * MPU_SAMPLE_PERIOD);
+
+    memset(m_sync_tuples, 0, sizeof(m_sync_tuples));
+    for(uint16_t i = 0; i < p_block->num_samples; i++)
+    {
+        int16_t * p_tuple           = &m_sync_tuples[i * SYNC_CHANNELS];
+        uint32_t  sample_timestamp  = timestamp + (i * MPU_SAMPLE_PERIOD);
+
+        memcpy(p_tuple, &p_block->samples[i], sizeof(imu_sample_t));
+#if defined(MPU_MAGN_AVAILABLE)
+        (void)app_sync_resample(&m_sync_magn, sample_timestamp, &p_tuple[MPU_CHANNELS]);
+#endif
+        (void)app_sync_resample(&m_sync_flex, sample_timestamp, &p_tuple[MPU_CHANNELS + MAGN_CHANNELS]);
+    }
+    return timestamp;
+}
+
+
+// Runs the gesture recognizer over the aligned samples in m_sync_tuples and sends each gesture it recognizes.
+static void gestures_process(uint32_t timestamp, uint16_t num_samples)
+{
+    if(!gestures_enabled())
+    {
+        app_gesture_reset(&m_gesture); // Samples from before the pause must not be mixed with new ones
+        return;
+    }
+
+    for(uint16_t i = 0; i < num_samples; i++)
+    {
+        uint8_t gesture = app_gesture_push(&m_gesture, &m_sync_tuples[i * SYNC_CHANNELS]);
+        if(gesture != APP_GESTURE_NONE)
+        {
+            NRF_LOG_INFO("Gesture %u\r\n", gesture);
+            (void)ble_mpu_sample_send(&m_mpu, BLE_MPU_SENSOR_GESTURE, &gesture, timestamp + (i * MPU_SAMPLE_PERIOD));
+#if HID_ENABLED
+            app_hid_map_gesture_add(&m_hid_map, gesture);
+#endif
+        }
+    }
+}
+
+
+// Starts using a model written over NUS. The recognizer is only used from the main loop, so the model is swapped here.
+static void gesture_model_update(void)
+{
+    uint32_t err_code;
+
+    if(!m_gesture_upload_ready)
+    {
+        return;
+    }
+    m_gesture_model = m_gesture_uploaded;
+    err_code = app_gesture_init(&m_gesture, &m_gesture_model, SYNC_CHANNELS);
+    APP_ERROR_CHECK(err_code); // Checked before m_gesture_upload_ready was set
+    m_gesture_upload_ready = false;
+    NRF_LOG_INFO("Gesture model with %u nodes\r\n", m_gesture_model.node_count);
+}
+
+
+// Hands the filled blocks to the services. Each service keeps its own reference if it needs the block longer.
+static void mpu_blocks_process(void)
+{
+    if(!(m_mpu_calib.valid & APP_MPU_CALIB_VALID_MAGN) &&
+       app_mpu_calib_magn_fit(&m_mpu_calib_collector, &m_mpu_calib) == NRF_SUCCESS)
+    {
+        m_mpu_calib_dirty = true;
+    }
+    if(m_mpu_calib_dirty && app_mpu_calib_save(&m_mpu_calib) == NRF_SUCCESS)
+    {
+        m_mpu_calib_dirty = false;
+    }
+
+    while(m_ready_head != m_ready_tail)
+    {
+        app_mpu_block_t * p_block = m_ready_blocks[m_ready_head];
+        m_ready_head = (m_ready_head + 1) % MPU_READY_QUEUE_SIZE;
+        APP_TRACE(APP_TRACE_EVT_PROCESS, TRACE_ID(p_block));
+
+        if(mpu_block_calibrate(p_block) != NRF_SUCCESS)
+        {
+            NRF_LOG_INFO("Gyroscope bias not written\r\n");
+        }
+        (void)ble_mpu_block_send(&m_mpu, p_block);
+        if(sync_enabled())
+        {
+            uint32_t timestamp = mpu_block_sync(p_block);
+            if(m_nus_frames_enabled)
+            {
+                frames_send(&m_frame_encoder, timestamp, MPU_SAMPLE_PERIOD, m_sync_tuples, SYNC_CHANNELS, p_block->num_samples);
+                APP_TRACE(APP_TRACE_EVT_PACK, TRACE_ID(p_block));
+            }
+            gestures_process(timestamp, p_block->num_samples);
+        }
+
+        if(hid_enabled() || (ble_mpu_subscriptions_get(&m_mpu) & BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_QUAT)))
+        {
+            ble_mpu_quat_t quat;
+            for(uint16_t i = 0; i < p_block->num_samples; i++)
+            {
+                app_mpu_fusion_update(&m_mpu_fusion, &p_block->samples[i].accel, &p_block->samples[i].gyro, NULL);
+            }
+            APP_TRACE(APP_TRACE_EVT_FUSION, TRACE_ID(p_block));
+            app_mpu_fusion_quat_get(&m_mpu_fusion, &quat);
+            (void)ble_mpu_sample_send(&m_mpu, BLE_MPU_SENSOR_QUAT, &quat, p_block->timestamp);
+#if HID_ENABLED
+            app_hid_map_orientation_add(&m_hid_map, &quat);
+#endif
+        }
+        app_mpu_block_release(p_block);
+    }
+}
+
+
+// Called from the ADC interrupt. The block stays valid for FLEX_DEPTH sample periods, long enough for the main loop.
+static void flex_block_handler(int16_t const * p_block, uint16_t num_samples, void * p_context)
+{
+    m_flex_block_timestamp = app_timer_cnt_get();
+    m_flex_block           = p_block;
+}
+
+
+// Samples the fingers while the peer listens on the NUS stream or for gestures, and queues their bends to be aligned with the IMU samples.
+static void flex_process(void)
+{
+    int16_t const * p_block;
+    uint32_t        timestamp;
+    int16_t         bend[FLEX_DEPTH * FLEX_CHANNELS];
+    uint32_t        err_code;
+    bool            enabled = sync_enabled();
+
+    if(m_flex_running != enabled)
+    {
+        err_code = enabled ? app_flex_start() : app_flex_stop();
+        APP_ERROR_CHECK(err_code);
+        m_flex_running = enabled;
+        m_flex_block   = NULL;
+        // Samples from before the pause must not be interpolated with new ones
+        app_sync_stream_reset(&m_sync_flex);
+#if defined(MPU_MAGN_AVAILABLE)
+        app_sync_stream_reset(&m_sync_magn);
+#endif
+    }
+
+    CRITICAL_REGION_ENTER();
+    p_block      = m_flex_block;
+    timestamp    = m_flex_block_timestamp;
+    m_flex_block = NULL;
+    CRITICAL_REGION_EXIT();
+
+    if(p_block == NULL || !m_flex_running)
+    {
+        return;
+    }
+
+    app_flex_calib_update(&m_flex_calib, p_block, FLEX_CHANNELS, FLEX_DEPTH);
+    for(uint16_t i = 0; i < FLEX_DEPTH; i++)
+    {
+        app_flex_bend_get(&m_flex_calib, &p_block[i * FLEX_CHANNELS], FLEX_CHANNELS, &bend[i * FLEX_CHANNELS]);
+    }
+
+    // The last sample was taken when the block was handed over, the others one period apart before it
+    for(uint16_t i = 0; i < FLEX_DEPTH; i++)
+    {
+        app_sync_push(&m_sync_flex, timestamp - ((FLEX_DEPTH - 1 - i) * FLEX_SAMPLE_PERIOD), &bend[i * FLEX_CHANNELS]);
+    }
+#if HID_ENABLED
+    app_hid_map_fingers_set(&m_hid_map, &bend[(FLEX_DEPTH - 1) * FLEX_CHANNELS], FLEX_CHANNELS);
+#endif
+}
+
+
+// Function for logging the bytes per second handed to the SoftDevice by the NUS stream.
+static void nus_stats_timeout_handler(void * p_context)
+{
+    static uint32_t last_sent;
+    static uint32_t last_dropped;
+    uint32_t sent    = m_nus_stream.bytes_sent;
+    uint32_t dropped = m_nus_stream.bytes_dropped;
+
+    if(sent != last_sent || dropped != last_dropped)
+    {
+        NRF_LOG_INFO("NUS %u B/s, %u B dropped, %u B queued\r\n",
+                     (sent - last_sent) * 1000 / NUS_STATS_INTERVAL_MS,
+                     dropped - last_dropped,
+                     ble_nus_stream_pending_get(&m_nus_stream));
+    }
+    last_sent    = sent;
+    last_dropped = dropped;
+
+#if APP_TRACE_ENABLED
+    static uint8_t intervals;
+    if(++intervals >= TRACE_REPORT_INTERVAL)
+    {
+        intervals = 0;
+        m_trace_report_pending = true;
+    }
+#endif
+}
+
+
+#if APP_TRACE_ENABLED && TRACE_DUMP
+// Function for logging one traced event as tools/trace_report.py reads it. Called from the main loop
+// by app_trace_process(). Flushed at once, as a ring full of events would overrun the deferred log buffer.
+static void trace_dump_handler(app_trace_evt_t evt, uint16_t id, uint32_t time_us)
+{
+    NRF_LOG_RAW_INFO("trace %u %u %u\r\n", evt, id, time_us);
+    NRF_LOG_FLUSH();
+}
+#endif
+
+
+#if APP_TRACE_ENABLED
+// Function for logging the latency of each pipeline stage since the last report, from the main loop.
+static void trace_process(void)
+{
+    static const char * const stage_names[APP_TRACE_EVT_COUNT] =
+        {"drain", "bus start", "bus end", "process", "fusion", "pack", "hvx", "tx complete"};
+    static uint32_t lost;
+
+    lost += app_trace_process();
+    if(!m_trace_report_pending)
+    {
+        return;
+    }
+    m_trace_report_pending = false;
+
+    for(uint8_t evt = 0; evt < APP_TRACE_EVT_COUNT; evt++)
+    {
+        app_trace_stats_t stats;
+        app_trace_stats_get((app_trace_evt_t)evt, &stats);
+        if(stats.count > 0)
+        {
+            NRF_LOG_INFO("%s: n %u min %u avg %u p99 %u max %u us\r\n", (uint32_t)stage_names[evt], stats.count,
+                         stats.min, stats.sum / stats.count, app_trace_percentile_get(&stats, 99), stats.max);
+        }
+    }
+    if(lost > 0)
+    {
+        NRF_LOG_INFO("trace: %u events lost\r\n", lost);
+    }
+    lost = 0;
+    app_trace_stats_reset();
+}
+#endif
+
+
 //Function for the Timer initialization. creates and starts application timers
 //We likely will need one for the sensor
 static void timers_init(void){
 
+    uint32_t err_code;
+
     // Initialize timer module.
     APP_TIMER_INIT(APP_TIMER_PRESCALER, APP_TIMER_OP_QUEUE_SIZE, false);
 
+    err_code = app_timer_create(&m_mpu_drain_timer_id, APP_TIMER_MODE_REPEATED, mpu_drain_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_timer_create(&m_nus_stats_timer_id, APP_TIMER_MODE_REPEATED, nus_stats_timeout_handler);
+    APP_ERROR_CHECK(err_code);
 }
 
 
@@ -236,6 +906,10 @@ static void gap_params_init(void){
     /* Add an appearance value matching the application's use case.
        err_code = sd_ble_gap_appearance_set(BLE_APPEARANCE_);
        APP_ERROR_CHECK(err_code); */
+#if HID_ENABLED
+    err_code = sd_ble_gap_appearance_set((HID_MODE == APP_HID_MAP_MOUSE) ? BLE_APPEARANCE_HID_MOUSE : BLE_APPEARANCE_HID_GAMEPAD);
+    APP_ERROR_CHECK(err_code);
+#endif
 
     memset(&gap_conn_params, 0, sizeof(gap_conn_params));
 
@@ -251,9 +925,153 @@ static void gap_params_init(void){
 
 //Create service event hadler for mpu6050 and uart
 
+// Function for choosing the sensors pushed to the FIFO. Only the sensors that are subscribed to,
+// directly or through the orientation quaternion, or that go out in the NUS frames or feed the
+// gesture recognizer, are read. The new configuration is written by the drain timer, between two drains.
+static void mpu_fifo_config_set(void)
+{
+    uint8_t subscriptions = ble_mpu_subscriptions_get(&m_mpu);
+    bool sync  = sync_enabled();
+    bool accel = sync || (subscriptions & (BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_ACCEL) | BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_QUAT)));
+    bool gyro  = sync || (subscriptions & (BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_GYRO)  | BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_QUAT)));
+    bool temp  = m_nus_frames_enabled || (subscriptions & BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_TEMP));
+
+    memset(&m_mpu_fifo_config, 0, sizeof(m_mpu_fifo_config));
+    m_mpu_fifo_config.accel  = accel;
+    m_mpu_fifo_config.gyro_x = gyro;
+    m_mpu_fifo_config.gyro_y = gyro;
+    m_mpu_fifo_config.gyro_z = gyro;
+    m_mpu_fifo_config.temp   = temp;
+    m_mpu_fifo_update = true;
+
+    // Start the sensors at once for a new subscriber
+    m_mpu_idle_request = false;
+    if(m_nus_frames_enabled || subscriptions != 0 || hid_enabled())
+    {
+        app_mpu_activity_wake();
+    }
+}
+
+// Function for handling subscription changes on the MPU service.
+static void ble_mpu_evt_handler(ble_mpu_t * p_mpu)
+{
+    mpu_fifo_config_set();
+}
+
+#if HID_ENABLED
+// Function for handling the host enabling or disabling the HID reports. The motion starts over on each change.
+static void hid_evt_handler(ble_glove_hid_t * p_hid)
+{
+    app_hid_map_reset(&m_hid_map);
+    mpu_fifo_config_set();
+}
+
+
+// Sends one report of all that changed since the last one, once the last report is out. Called from the main loop,
+// which runs after each BLE event, so reports follow the connection events.
+static void hid_process(void)
+{
+    app_hid_map_report_t report;
+
+    if(!ble_glove_hid_ready(&m_hid) ||
+       !app_hid_map_report_get(&m_hid_map, ble_glove_hid_move_max(&m_hid), &report))
+    {
+        return;
+    }
+    if(ble_glove_hid_report_send(&m_hid, &report) == NRF_SUCCESS)
+    {
+        app_hid_map_report_sent(&m_hid_map, &report); // Otherwise the motion stays for the next try
+    }
+}
+#endif
+
+// Function for pausing or resuming flash garbage collection. Resuming queues it again, which fails while the
+// FDS queue is full. It is then retried on each FDS event until the queue has room.
+static void fds_gc_pause_set(bool pause)
+{
+    uint32_t err_code = fds_gc_pause(pause);
+
+    m_fds_gc_resume_pending = (err_code == FDS_ERR_NO_SPACE_IN_QUEUES);
+    if(!m_fds_gc_resume_pending)
+    {
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+// Function for handling FDS events, to resume garbage collection that could not be resumed when the stream stopped.
+static void fds_evt_handler(fds_evt_t const * p_evt)
+{
+    if(m_fds_gc_resume_pending && !m_nus_frames_enabled)
+    {
+        fds_gc_pause_set(false);
+    }
+}
+
+// Function for handling the peer enabling or disabling the NUS stream. The first frame after enabling is a keyframe.
+// Flash garbage collection waits while the stream runs, so it does not compete with the radio.
+static void nus_stream_evt_handler(ble_nus_stream_t * p_stream, bool enabled)
+{
+    if(enabled)
+    {
+        app_frame_key_request(&m_frame_encoder);
+    }
+    m_nus_frames_enabled = enabled;
+    mpu_fifo_config_set();
+    fds_gc_pause_set(enabled);
+}
+
+// Whether the peer may change the gesture model: the link must be encrypted, and with a bonded peer,
+// so a device in range can not swap in a model of its own.
+static bool gesture_upload_allowed(uint16_t conn_handle)
+{
+    pm_conn_sec_status_t status;
+
+    if(pm_conn_sec_status_get(conn_handle, &status) != NRF_SUCCESS)
+    {
+        return false;
+    }
+    return status.encrypted && status.bonded;
+}
+
+// Function for taking a gesture model from the host training tools, tools/gesture_model.py. The model image
+// comes in framed APP_GESTURE_CMD_WRITE pieces and is taken with APP_GESTURE_CMD_COMMIT, see app_gesture.h.
+// Returns false for other data.
+static bool gesture_model_command(uint16_t conn_handle, uint8_t const * p_data, uint16_t length)
+{
+    uint32_t err_code;
+    bool     committed;
+
+    if(length == 0 || (p_data[0] != APP_GESTURE_CMD_WRITE && p_data[0] != APP_GESTURE_CMD_COMMIT))
+    {
+        return false;
+    }
+    if(!gesture_upload_allowed(conn_handle) || m_gesture_upload_ready)
+    {
+        NRF_LOG_INFO("Gesture model command refused\r\n");
+        app_gesture_upload_reset(&m_gesture_upload);
+        return true;
+    }
+
+    err_code = app_gesture_upload_command(&m_gesture_upload, p_data, length, SYNC_CHANNELS, &m_gesture_uploaded, &committed);
+    if(committed)
+    {
+        NRF_LOG_INFO("Gesture model stored: %u\r\n", app_gesture_model_save(&m_gesture_uploaded));
+        m_gesture_upload_ready = true;
+    }
+    else if(err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_INFO("Gesture model rejected: %u\r\n", err_code);
+    }
+    return true;
+}
+
 // Function for handling the data from the Nordic UART Service.This function will process the data received from the Nordic UART BLE Service and send it to the UART module.
 static void nus_data_handler(ble_nus_t * p_nus, uint8_t * p_data, uint16_t length)
 {
+    if(gesture_model_command(p_nus->conn_handle, p_data, length))
+    {
+        return;
+    }
 		uint8_t array[] = {1,2,3};
     for (uint32_t i = 0; i < length; i++)
     {
@@ -277,6 +1095,174 @@ static void services_init(void){
 
     err_code = ble_nus_init(&m_nus, &nus_init);
     APP_ERROR_CHECK(err_code);
+    ble_nus_stream_init(&m_nus_stream, &m_nus, nus_stream_evt_handler);
+
+    ble_mpu_init_t mpu_init;
+
+    mpu_init.sample_period = MPU_SAMPLE_PERIOD;
+    mpu_init.evt_handler   = ble_mpu_evt_handler;
+
+    ble_mpu_service_init(&m_mpu, &mpu_init);
+
+#if HID_ENABLED
+    err_code = ble_glove_hid_init(&m_hid, HID_MODE, hid_evt_handler);
+    APP_ERROR_CHECK(err_code);
+
+    app_hid_map_config_t hid_map_config;
+    memset(&hid_map_config, 0, sizeof(hid_map_config));
+    hid_map_config.mode         = HID_MODE;
+    // Mouse: turning the hand left and right about the glove z axis, tilting it up and down about y.
+    // Gamepad: rolling the hand about x tips gravity towards y, tilting it about y tips it towards x.
+    // Not z, which points up when the hand is level and would hold the stick at full deflection
+    hid_map_config.axis_x       = (HID_MODE == APP_HID_MAP_MOUSE) ? 2 : 1;
+    hid_map_config.axis_y       = (HID_MODE == APP_HID_MAP_MOUSE) ? 1 : 0;
+    hid_map_config.gain_x       = (HID_MODE == APP_HID_MAP_MOUSE) ? HID_MOUSE_GAIN : HID_STICK_GAIN;
+    hid_map_config.gain_y       = hid_map_config.gain_x;
+    hid_map_config.deadzone     = HID_DEADZONE;
+    hid_map_config.press_bend   = GESTURE_GRAB_BEND;
+    hid_map_config.release_bend = HID_RELEASE_BEND;
+    hid_map_config.finger_buttons[1] = 0x01;            // Second finger in FLEX_AIN is the left button, third the right
+    hid_map_config.finger_buttons[2] = 0x02;
+    hid_map_config.gesture_buttons[APP_GESTURE_TAP]  = 0x01;
+    hid_map_config.gesture_buttons[APP_GESTURE_GRAB] = 0x04;
+    err_code = app_hid_map_init(&m_hid_map, &hid_map_config);
+    APP_ERROR_CHECK(err_code);
+#endif
+}
+
+
+// Function for handling events from the GATT module.
+static void gatt_evt_handler(nrf_ble_gatt_t * p_gatt, nrf_ble_gatt_evt_t * p_evt)
+{
+    ble_mpu_on_gatt_evt(&m_mpu, p_evt);
+    ble_nus_stream_on_gatt_evt(&m_nus_stream, p_evt);
+}
+
+
+// Function for initializing the GATT module. Requests the largest ATT MTU the SoftDevice is configured for.
+static void gatt_init(void)
+{
+    uint32_t err_code = nrf_ble_gatt_init(&m_gatt, gatt_evt_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+// Function for handling the MPU activity state. On wake up the FIFO and the drains are restarted at once,
+// as the drain timer is stopped and nothing else uses the bus.
+static void mpu_activity_evt_handler(app_mpu_activity_state_t state)
+{
+    uint32_t err_code;
+
+    if(state == APP_MPU_ACTIVITY_IDLE)
+    {
+        NRF_LOG_INFO("MPU idle\r\n");
+        return;
+    }
+
+    app_mpu_activity_stats_t stats;
+    app_mpu_activity_stats_get(&stats);
+    NRF_LOG_INFO("MPU woke in %u us\r\n",
+                 (uint32_t)(((uint64_t)stats.wake_latency_last * 1000000 * (APP_TIMER_PRESCALER + 1)) / APP_TIMER_CLOCK_FREQ));
+
+    app_mpu_calib_collector_init(&m_mpu_calib_collector); // Counts the still windows from the wake up
+    app_gesture_reset(&m_gesture);
+#if HID_ENABLED
+    app_hid_map_reset(&m_hid_map); // The orientation jumped while idle
+#endif
+    mpu_fifo_update(); // Retried from the drain timer if it fails
+    err_code = app_timer_start(m_mpu_drain_timer_id, m_mpu_drain_interval, NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+// Function for setting up the MPU and its FIFO. Samples are read from the FIFO by m_mpu_drain_timer_id.
+static void mpu_init(void)
+{
+    uint32_t err_code;
+
+    err_code = app_mpu_block_pool_init();
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_mpu_init();
+    APP_ERROR_CHECK(err_code);
+
+    app_mpu_config_t mpu_config = MPU_DEFAULT_CONFIG();
+    mpu_config.smplrt_div = MPU_SMPLRT_DIV;
+    err_code = app_mpu_config(&mpu_config);
+    APP_ERROR_CHECK(err_code);
+
+    // Start from the stored calibration, so no warm-up is needed
+    if(app_mpu_calib_load(&m_mpu_calib, &mpu_config) != NRF_SUCCESS)
+    {
+        app_mpu_calib_defaults(&m_mpu_calib, &mpu_config);
+    }
+    app_mpu_calib_collector_init(&m_mpu_calib_collector);
+    err_code = app_mpu_calib_apply(&m_mpu_calib);
+    APP_ERROR_CHECK(err_code);
+
+    app_mpu_fusion_config_t fusion_config = APP_MPU_FUSION_DEFAULT_CONFIG(MPU_SAMPLE_PERIOD_MS * 1000);
+    fusion_config.gyro_fs = mpu_config.gyro_config.fs_sel;
+    err_code = app_mpu_fusion_init(&m_mpu_fusion, &fusion_config);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_frame_encoder_init(&m_frame_encoder, FRAME_STREAM_SYNC, SYNC_CHANNELS, APP_FRAME_KEY_INTERVAL);
+    APP_ERROR_CHECK(err_code);
+
+    // A stored model that does not fit these channels is from other firmware
+    if(app_gesture_model_load(&m_gesture_model) != NRF_SUCCESS ||
+       app_gesture_model_check(&m_gesture_model, SYNC_CHANNELS) != NRF_SUCCESS)
+    {
+        m_gesture_model = m_gesture_default_model;
+    }
+    err_code = app_gesture_init(&m_gesture, &m_gesture_model, SYNC_CHANNELS);
+    APP_ERROR_CHECK(err_code);
+
+#if defined(MPU_MAGN_AVAILABLE)
+    app_mpu_magn_config_t magn_config;
+    magn_config.mode       = CONTINUOUS_MEASUREMENT_100Hz_MODE;
+#if defined(MPU9255)
+    magn_config.resolution = OUTPUT_RESOLUTION_16bit;
+    err_code = app_mpu_magnetometer_master_init(&magn_config); // The MPU reads the magnetometer, so one read gets it over TWI and SPI
+#else
+    err_code = app_mpu_magnetometer_init(&magn_config);
+#endif
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_sync_stream_init(&m_sync_magn, MAGN_CHANNELS, APP_SYNC_MODE_LINEAR);
+    APP_ERROR_CHECK(err_code);
+#endif
+
+    // The FIFO stays off until a peer subscribes to one of the sensors. See mpu_fifo_config_set()
+
+    app_mpu_activity_config_t activity_config;
+    activity_config.int_pin                = MPU_INT_PIN;
+    activity_config.lp_motion.threshold_mg = MPU_WAKE_THRESHOLD_MG;
+    activity_config.lp_motion.wake_rate    = MPU_WAKE_RATE;
+    activity_config.lp_motion.duration_ms  = 1;
+    activity_config.evt_handler            = mpu_activity_evt_handler;
+    err_code = app_mpu_activity_init(&activity_config);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+// Function for putting the MPU in low power cycle mode while the hand is still or nobody needs its samples,
+// and for waking it up again. Called from the main loop, so the wake up is handled right after the INT pin interrupt.
+static void mpu_activity_update(void)
+{
+    uint8_t subscriptions = ble_mpu_subscriptions_get(&m_mpu);
+    bool    streaming     = m_nus_frames_enabled || (subscriptions != 0) || hid_enabled();
+    bool    still         = m_mpu_calib_collector.still_windows >= MPU_IDLE_WINDOWS;
+
+    (void)app_mpu_activity_process(); // Restarts streaming through mpu_activity_evt_handler() also on error
+
+    if(app_mpu_activity_state_get() == APP_MPU_ACTIVITY_ACTIVE && !m_mpu_idle_request && (!streaming || still))
+    {
+        m_mpu_idle_request = true;
+    }
+    if(m_mpu_idle_request && app_mpu_activity_state_get() == APP_MPU_ACTIVITY_ACTIVE)
+    {
+        mpu_idle_enter();
+    }
 }
 
 
@@ -292,6 +1278,38 @@ static void on_conn_params_evt(ble_conn_params_evt_t * p_evt){
 }
 
 
+// Function for following the connection interval granted by the central. The FIFO is drained once per
+// connection event, or every MPU_DRAIN_INTERVAL_MIN_MS if events come faster, so a block is ready for each event.
+static void conn_policy_evt_handler(ble_conn_policy_t * p_policy, uint32_t interval_us, uint16_t slave_latency)
+{
+    uint32_t err_code;
+    uint32_t drain_us = ble_conn_policy_batch_period_get(p_policy, MPU_DRAIN_INTERVAL_MIN_MS * 1000, MPU_DRAIN_INTERVAL_MS * 1000);
+    uint32_t drain_interval = APP_TIMER_TICKS(drain_us / 1000, APP_TIMER_PRESCALER);
+
+    NRF_LOG_INFO("Connection interval %u us, latency %u\r\n", interval_us, slave_latency);
+
+    m_mpu_drain_interval = drain_interval;
+    if(app_mpu_activity_state_get() != APP_MPU_ACTIVITY_ACTIVE)
+    {
+        return; // Started with the new interval on wake up
+    }
+    err_code = app_timer_stop(m_mpu_drain_timer_id);
+    APP_ERROR_CHECK(err_code);
+    err_code = app_timer_start(m_mpu_drain_timer_id, drain_interval, NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+// Function for asking for the idle connection parameters while the hand is still, or nothing is streamed.
+static void conn_policy_update(void)
+{
+    bool streaming = m_mpu_fifo_config.accel || m_mpu_fifo_config.gyro_x;
+    bool moving    = streaming && (m_mpu_calib_collector.still_windows < IDLE_STILL_WINDOWS);
+
+    (void)ble_conn_policy_motion_set(&m_conn_policy, moving); // ble_conn_params reports failures
+}
+
+
 ///Function for handling a Connection Parameters error.
 static void conn_params_error_handler(uint32_t nrf_error){
     APP_ERROR_HANDLER(nrf_error);
@@ -316,12 +1334,22 @@ static void conn_params_init(void){
 
     err_code = ble_conn_params_init(&cp_init);
     APP_ERROR_CHECK(err_code);
+
+    ble_gap_conn_params_t const active_params = {MIN_CONN_INTERVAL, MAX_CONN_INTERVAL, SLAVE_LATENCY, CONN_SUP_TIMEOUT};
+    ble_gap_conn_params_t const idle_params   = {IDLE_MIN_CONN_INTERVAL, IDLE_MAX_CONN_INTERVAL, IDLE_SLAVE_LATENCY, IDLE_CONN_SUP_TIMEOUT};
+    ble_conn_policy_init(&m_conn_policy, &active_params, &idle_params, conn_policy_evt_handler);
 }
 
 
 // Function for starting timers.
 static void application_timers_start(void){
-  //Need a timer for mpu6050  
+    uint32_t err_code;
+
+    err_code = app_timer_start(m_mpu_drain_timer_id, MPU_DRAIN_INTERVAL, NULL);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = app_timer_start(m_nus_stats_timer_id, APP_TIMER_TICKS(NUS_STATS_INTERVAL_MS, APP_TIMER_PRESCALER), NULL);
+    APP_ERROR_CHECK(err_code);
 	//Need one for button too possibly
 
 }
@@ -374,6 +1402,7 @@ static void on_ble_evt(ble_evt_t * p_ble_evt){
             NRF_LOG_INFO("Disconnected.\r\n");
             err_code = bsp_indication_set(BSP_INDICATE_IDLE);
             APP_ERROR_CHECK(err_code);
+            app_gesture_upload_reset(&m_gesture_upload); // The next peer starts over
             break; // BLE_GAP_EVT_DISCONNECTED
 
         case BLE_GAP_EVT_CONNECTED: {
@@ -381,7 +1410,6 @@ static void on_ble_evt(ble_evt_t * p_ble_evt){
             err_code = bsp_indication_set(BSP_INDICATE_CONNECTED);
             APP_ERROR_CHECK(err_code);
             m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
-            status = ble_nus_string_send(&m_nus, (uint8_t*)"Hello", 6);
             break; // BLE_GAP_EVT_CONNECTED
 					}
         case BLE_GATTC_EVT_TIMEOUT:
@@ -429,14 +1457,6 @@ static void on_ble_evt(ble_evt_t * p_ble_evt){
             }
         } break; // BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST
 
-#if (NRF_SD_BLE_API_VERSION == 3)
-        case BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST:
-            err_code = sd_ble_gatts_exchange_mtu_reply(p_ble_evt->evt.gatts_evt.conn_handle,
-                                                       NRF_BLE_MAX_MTU_SIZE);
-            APP_ERROR_CHECK(err_code);
-            break; // BLE_GATTS_EVT_EXCHANGE_MTU_REQUEST
-#endif
-
         default:
             // No implementation needed.
             break;
@@ -451,8 +1471,15 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt){
      * Remember to call ble_conn_state_on_ble_evt before calling any ble_conns_state_* functions. */
     ble_conn_state_on_ble_evt(p_ble_evt);
     pm_on_ble_evt(p_ble_evt);
+    nrf_ble_gatt_on_ble_evt(&m_gatt, p_ble_evt);
+    ble_mpu_on_ble_evt(&m_mpu, p_ble_evt);
+#if HID_ENABLED
+    ble_glove_hid_on_ble_evt(&m_hid, p_ble_evt);
+#endif
 		ble_nus_on_ble_evt(&m_nus, p_ble_evt);
+    ble_nus_stream_on_ble_evt(&m_nus_stream, p_ble_evt);
     ble_conn_params_on_ble_evt(p_ble_evt);
+    ble_conn_policy_on_ble_evt(&m_conn_policy, p_ble_evt);
     bsp_btn_ble_on_ble_evt(p_ble_evt);
     on_ble_evt(p_ble_evt);
     ble_advertising_on_ble_evt(p_ble_evt);
@@ -492,6 +1519,12 @@ static void ble_stack_init(void){
                                                     &ble_enable_params);
     APP_ERROR_CHECK(err_code);
 
+    // Nordic UART Service and MPU service each use a vendor specific base UUID
+    ble_enable_params.common_enable_params.vs_uuid_count = 2;
+#if HID_ENABLED
+    ble_enable_params.gatts_enable_params.attr_tab_size = BLE_GATTS_ATTR_TAB_SIZE_DEFAULT + HID_ATTR_TAB_EXTRA;
+#endif
+
     // Check the ram settings against the used number of links
     CHECK_RAM_START_ADDR(CENTRAL_LINK_COUNT, PERIPHERAL_LINK_COUNT);
 
@@ -583,25 +1616,27 @@ static void bsp_event_handler(bsp_event_t event){
 // Function for handling app_uart events.
 void uart_event_handle(app_uart_evt_t * p_event)
 {
-    static uint8_t data_array[BLE_NUS_MAX_DATA_LEN];
-    static uint8_t index = 0;
-    uint32_t       err_code;
+    uint8_t  data_array[UART_RX_BUF_SIZE];
+    uint8_t  frame[UART_RX_BUF_SIZE + APP_FRAME_RAW_HEADER_SIZE];
+    uint16_t index = 0;
+    uint16_t len;
+    uint16_t packed;
 
     switch (p_event->evt_type)
     {
         case APP_UART_DATA_READY:
-            UNUSED_VARIABLE(app_uart_get(&data_array[index]));
-            index++;
-
-            if ((data_array[index - 1] == '\n') || (index >= (BLE_NUS_MAX_DATA_LEN)))
+            // Everything received so far goes to the stream in one raw frame of its own stream id,
+            // so the peer can tell it from the sensor frames. The stream coalesces it with them into
+            // full notifications. A write is all or nothing, so the frames are never mixed.
+            while ((index < UART_RX_BUF_SIZE) && (app_uart_get(&data_array[index]) == NRF_SUCCESS))
             {
-                err_code = ble_nus_string_send(&m_nus, data_array, index);
-                if (err_code != NRF_ERROR_INVALID_STATE)
-                {
-                    APP_ERROR_CHECK(err_code);
-                }
-
-                index = 0;
+                index++;
+            }
+            len = app_frame_raw_encode(FRAME_STREAM_UART, frame, sizeof(frame), data_array, index, &packed);
+            if(len > 0)
+            {
+                // Nobody listening, or the link is backed up. Lost either way, like a UART overrun
+                (void)ble_nus_stream_write(&m_nus_stream, frame, len);
             }
             break;
 
@@ -688,13 +1723,6 @@ static void buttons_leds_init(bool * p_erase_bonds){
     *p_erase_bonds = (startup_event == BSP_EVENT_CLEAR_BONDING_DATA);
 }
 
-//Function for sending string to peer
-uint32_t ble_nus_string_send(ble_nus_t* p_nus, uint8_t* p_string, uint16_t length){
-	
-	
-	return NRF_SUCCESS;
-}
-
 // Function for the Power manager.
 static void power_manage(void)
 {
@@ -713,6 +1741,32 @@ static void advertising_start(void)
 }
 
 
+// Function for setting up the flex sensor acquisition. Sampling starts when the peer enables NUS notifications.
+static void flex_init(void)
+{
+    uint32_t err_code;
+    app_flex_config_t flex_config;
+
+    memset(&flex_config, 0, sizeof(flex_config));
+    memcpy(flex_config.ain, m_flex_ain, sizeof(m_flex_ain));
+    flex_config.channel_count  = FLEX_CHANNELS;
+    flex_config.scan_period_us = FLEX_SCAN_PERIOD_US;
+    flex_config.oversample     = FLEX_OVERSAMPLE;
+    flex_config.depth          = FLEX_DEPTH;
+    flex_config.p_buffer       = m_flex_buffer;
+    flex_config.evt_handler    = flex_block_handler;
+    flex_config.irq_priority   = APP_IRQ_PRIORITY_LOW;
+    err_code = app_flex_init(&flex_config);
+    APP_ERROR_CHECK(err_code);
+
+    app_flex_calib_reset(&m_flex_calib);
+    m_flex_calib.invert = FLEX_INVERT;
+
+    err_code = app_sync_stream_init(&m_sync_flex, FLEX_CHANNELS, APP_SYNC_MODE_LINEAR);
+    APP_ERROR_CHECK(err_code);
+}
+
+
 // Function for application main entry.
  
 int main(void)
@@ -730,15 +1784,32 @@ int main(void)
     timers_init();
     buttons_leds_init(&erase_bonds);
     ble_stack_init();
+    err_code = app_mpu_calib_storage_init(); // Registers with FDS before pm_init() initializes it
+    APP_ERROR_CHECK(err_code);
+    err_code = app_gesture_storage_init();
+    APP_ERROR_CHECK(err_code);
+    err_code = fds_register(fds_evt_handler);
+    APP_ERROR_CHECK(err_code);
     peer_manager_init(erase_bonds);
     if (erase_bonds == true)
     {
         NRF_LOG_INFO("Bonds erased!\r\n");
     }
     gap_params_init();
+    gatt_init();
     advertising_init();
     services_init();
     conn_params_init();
+#if APP_TRACE_ENABLED
+    err_code = app_trace_init();
+    APP_ERROR_CHECK(err_code);
+#if TRACE_DUMP
+    NRF_LOG_RAW_INFO("trace wrap %u\r\n", APP_TRACE_TIME_WRAP_US);
+    app_trace_dump_set(trace_dump_handler);
+#endif
+#endif
+    mpu_init();
+    flex_init();
 		
     // Start execution.
     NRF_LOG_INFO("Template started\r\n");
@@ -749,6 +1820,20 @@ int main(void)
 		
     // Enter main loop.
    for (;;) {
+		 flex_process();       // Before the IMU blocks, so the bends they are aligned with are up to date
+		 gesture_model_update();
+#if defined(MPU_MAGN_AVAILABLE)
+		 mpu_magn_process();   // Before the IMU blocks, for the same reason
+#endif
+		 mpu_blocks_process();
+		 mpu_activity_update();
+		 conn_policy_update();
+#if HID_ENABLED
+		 hid_process();
+#endif
+#if APP_TRACE_ENABLED
+		 trace_process();
+#endif
 		 if (NRF_LOG_PROCESS() == false){
             power_manage();
     }
@@ -1,7 +1,7 @@
- /* 
-  * The library is not extensively tested and only 
-  * meant as a simple explanation and for inspiration. 
-  * NO WARRANTY of ANY KIND is provided. 
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
   */
 
 #ifndef NRF_DRV_MPU__
@@ -11,14 +11,84 @@
 #include <stdbool.h>
 #include <stdint.h>
 
- 
+
+/* Pins to connect MPU. Pinout is different for nRF51 DK and nRF52 DK
+ * and therefore I have added a conditional statement defining different pins
+ * for each board. This is only for my own convenience.
+ */
+#if defined(BOARD_PCA10040)
+#define MPU_TWI_SCL_PIN 3
+#define MPU_TWI_SDA_PIN 4
+#define MPU_INT_PIN     26      // MPU INT. Wakes the nRF on motion
+#else
+#define MPU_TWI_SCL_PIN 1
+#define MPU_TWI_SDA_PIN 2
+#define MPU_INT_PIN     0       // MPU INT. Wakes the nRF on motion
+#endif
+
+#if defined(BOARD_PCA10040)
+#define MPU_SPI_MISO_PIN    28 // MPU SDO. 'AD0' on MPU breakout board silk screen
+#define MPU_SPI_MOSI_PIN    4  // MPU SDI. 'SDA' on MPU breakout board silk screen
+#define MPU_SPI_SCL_PIN     3  // MPU SCLK. 'SCL' on MPU breakout board silk screen
+#define MPU_SPI_CS_PIN      29 // MPU nCS. 'NCS' on MPU breakout board silk screen
+#else // If PCA10028
+#define MPU_SPI_MISO_PIN    3 // MPU SDO. 'AD0' on MPU breakout board silk screen
+#define MPU_SPI_MOSI_PIN    2  // MPU SDI. 'SDA' on MPU breakout board silk screen
+#define MPU_SPI_SCL_PIN     1  // MPU SCLK. 'SCL' on MPU breakout board silk screen
+#define MPU_SPI_CS_PIN      4 // MPU nCS. 'NCS' on MPU breakout board silk screen
+#endif
+
+#define MPU_ADDRESS     0x68    // TWI address of the MPU with AD0 pulled low
+#define MPU_ADDRESS_AD0_HIGH        0x69    // TWI address of a second MPU on the same bus, with AD0 pulled high
+#define MPU_AK89XX_MAGN_ADDRESS     0x0C    // I2C address of the magnetometer, in bypass mode and behind the MPU I2C master
+
+
+/**@brief Longest register read a single transaction can do.
+ * app_twi and nrf_drv_spi transfers are limited to 255 bytes.
+ */
+#define MPU_MAX_READ_LENGTH     255
+
+
+
+/**@brief An MPU on the bus. The TWI address, e.g. MPU_ADDRESS or MPU_ADDRESS_AD0_HIGH, or the SPI CS pin.
+ * The functions without a device argument talk to NRF_DRV_MPU_DEV_DEFAULT.
+ */
+typedef uint8_t nrf_drv_mpu_dev_t;
+
+#if defined(MPU_USES_SPI)
+#define NRF_DRV_MPU_DEV_DEFAULT     MPU_SPI_CS_PIN
+#else
+#define NRF_DRV_MPU_DEV_DEFAULT     MPU_ADDRESS
+#endif
+
+
+
+/**@brief Callback invoked when a scheduled MPU transaction is finished
+ *
+ * @param[in]   result          NRF_SUCCESS, or the error reported by the bus
+ * @param[in]   p_context       Context pointer given when the transaction was scheduled
+ */
+typedef void (* nrf_drv_mpu_evt_handler_t)(uint32_t result, void * p_context);
+
+
 
 /**@brief Function to initiate TWI drivers
  *
  * @retval      uint32_t        Error code
  */
 uint32_t nrf_drv_mpu_init(void);
-	
+
+
+
+/**@brief Function to release the bus driver
+ *
+ * Used when another module, like app_mpu_dma, needs to take over the bus peripheral.
+ * nrf_drv_mpu_init() must be called again before any other function in this file is used.
+ *
+ * @retval      uint32_t        Error code
+ */
+uint32_t nrf_drv_mpu_uninit(void);
+
 
 
 /**@brief Function for reading an arbitrary register
@@ -50,7 +120,119 @@ uint32_t nrf_drv_mpu_write_single_register(uint8_t reg, uint8_t data);
  * @retval      uint32_t        Error code
  */
 uint32_t nrf_drv_mpu_read_registers(uint8_t reg, uint8_t * p_data, uint32_t length);
-    
+
+
+
+/**@brief Function for scheduling a read of arbitrary register(s) without waiting for it
+ *
+ * The transaction is queued behind any pending transactions and the function returns
+ * immediately. p_data must stay valid until evt_handler has been called.
+ *
+ * @param[in]   reg             Register to read
+ * @param[out]  p_data          Pointer to place to store value(s)
+ * @param[in]   length          Number of registers to read
+ * @param[in]   evt_handler     Function called from interrupt context when the read is done. Can be NULL
+ * @param[in]   p_context       Context passed to evt_handler
+ * @retval      uint32_t        Error code. NRF_ERROR_BUSY if the transaction queue is full
+ */
+uint32_t nrf_drv_mpu_read_registers_async(uint8_t reg, uint8_t * p_data, uint32_t length,
+                                          nrf_drv_mpu_evt_handler_t evt_handler, void * p_context);
+
+
+
+/**@brief Function for scheduling a write of arbitrary register(s) without waiting for it
+ *
+ * p_data is copied into the driver before the function returns.
+ *
+ * @param[in]   reg             Register to write
+ * @param[in]   p_data          Value(s)
+ * @param[in]   length          Number of bytes to write
+ * @param[in]   evt_handler     Function called from interrupt context when the write is done. Can be NULL
+ * @param[in]   p_context       Context passed to evt_handler
+ * @retval      uint32_t        Error code. NRF_ERROR_BUSY if the transaction queue is full
+ */
+uint32_t nrf_drv_mpu_write_registers_async(uint8_t reg, uint8_t * p_data, uint32_t length,
+                                           nrf_drv_mpu_evt_handler_t evt_handler, void * p_context);
+
+
+/**@brief Function for preparing the bus for another MPU than NRF_DRV_MPU_DEV_DEFAULT
+ *
+ * Call after nrf_drv_mpu_init(). With SPI the CS pin is set up as an output, high. With TWI
+ * there is nothing to set up, as the address goes with each transaction.
+ *
+ * @param[in]   dev             MPU
+ * @retval      uint32_t        Error code
+ */
+uint32_t nrf_drv_mpu_dev_init(nrf_drv_mpu_dev_t dev);
+
+
+
+/**@brief Same as nrf_drv_mpu_write_registers(), on the given MPU */
+uint32_t nrf_drv_mpu_dev_write_registers(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length);
+
+
+
+/**@brief Same as nrf_drv_mpu_read_registers(), on the given MPU */
+uint32_t nrf_drv_mpu_dev_read_registers(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length);
+
+
+
+/**@brief Same as nrf_drv_mpu_read_registers_async(), on the given MPU.
+ * Transactions to different MPUs share the queue and run back to back.
+ */
+uint32_t nrf_drv_mpu_dev_read_registers_async(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length,
+                                              nrf_drv_mpu_evt_handler_t evt_handler, void * p_context);
+
+
+
+/**@brief Same as nrf_drv_mpu_write_registers_async(), on the given MPU */
+uint32_t nrf_drv_mpu_dev_write_registers_async(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length,
+                                               nrf_drv_mpu_evt_handler_t evt_handler, void * p_context);
+
+
+
+#if defined(MPU_USES_SPI) && defined(NRF52)
+/**@brief Function for letting an event start register reads of NRF_DRV_MPU_DEV_DEFAULT through PPI, without the CPU (SPIM only)
+ *
+ * E.g. the GPIOTE event of MPU_INT_PIN, so data ready starts the read. Each read clocks the
+ * register byte out and 'length' registers in, and takes length + 1 bytes of p_buffer. The
+ * first byte is clocked in while the register byte goes out and holds no data. The RX pointer
+ * moves one read forward after each read (ArrayList), so count the reads on
+ * nrf_drv_mpu_trigger_end_event_get() and call nrf_drv_mpu_trigger_rewind() before the
+ * buffer is full. Takes two PPI channels and a GPIOTE channel for CS. The other functions
+ * in this file return NRF_ERROR_BUSY until nrf_drv_mpu_trigger_disable() is called.
+ *
+ * @param[in]   trigger_event   Address of the event that starts each read
+ * @param[in]   reg             Register to read
+ * @param[out]  p_buffer        Reads of length + 1 bytes each, in RAM
+ * @param[in]   length          Number of registers per read
+ * @retval      uint32_t        Error code
+ */
+uint32_t nrf_drv_mpu_trigger_enable(uint32_t trigger_event, uint8_t reg, uint8_t * p_buffer, uint8_t length);
+
+
+
+/**@brief Function for moving the RX pointer of the triggered reads back to the start of the buffer
+ *
+ * Takes effect from the next read. A read in progress is not affected.
+ */
+void nrf_drv_mpu_trigger_rewind(void);
+
+
+
+/**@brief Function for the address of the event at the end of each triggered read
+ *
+ * @retval      uint32_t        Address of the SPIM END event
+ */
+uint32_t nrf_drv_mpu_trigger_end_event_get(void);
+
+
+
+/**@brief Function for stopping the triggered reads and giving the bus back to the other functions
+ */
+void nrf_drv_mpu_trigger_disable(void);
+#endif
+
 
 uint32_t nrf_drv_mpu_read_magnetometer_registers(uint8_t reg, uint8_t * p_data, uint32_t length);
 uint32_t nrf_drv_mpu_write_magnetometer_register(uint8_t reg, uint8_t data);
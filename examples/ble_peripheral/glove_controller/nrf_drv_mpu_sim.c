@@ -0,0 +1,1009 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "nrf_drv_mpu.h"
+#include "nrf_drv_mpu_sim.h"
+#include "sdk_errors.h"
+
+#if defined(MPU60x0)
+    #include "mpu60x0_register_map.h"
+    #define SIM_WHO_AM_I            0x68
+    #define SIM_FIFO_SIZE           1024
+    #define SIM_MG_PR_LSB_MOT_THR   32
+#elif defined(MPU9150)
+    #include "mpu9150_register_map.h"
+    #define SIM_WHO_AM_I            0x68
+    #define SIM_FIFO_SIZE           1024
+    #define SIM_MAGN                1   // AK8975, single measurements only
+    #define SIM_MG_PR_LSB_MOT_THR   32
+#elif defined(MPU9255)
+    #include "mpu9255_register_map.h"
+    #define SIM_WHO_AM_I            0x73
+    #define SIM_FIFO_SIZE           512
+    #define SIM_MAGN                1   // AK8963
+    #define SIM_MG_PR_LSB_MOT_THR   4
+    #define MPU_REG_MOT_THR         MPU_REG_WOM_THR
+#else
+    #error "No MPU defined. Please define MPU in Target Options C/C++ Defines"
+#endif
+
+#define SIM_WRITE_BUFFER_SIZE       14  // Same limit as the TWI driver
+
+#define PWR_MGMT_1_H_RESET          0x80
+#define PWR_MGMT_1_SLEEP            0x40
+#define PWR_MGMT_1_CYCLE            0x20
+#define PWR_MGMT_2_STBY_G           0x07
+#define PWR_MGMT_2_LP_WAKE_POS      6
+#define ACCEL_CONFIG_AFS_POS        3
+#define ACCEL_CONFIG_AFS_MASK       0x03
+#define CONFIG_FIFO_MODE            0x40 // Drop new data instead of the oldest when the FIFO is full
+#define CONFIG_DLPF_CFG_MASK        0x07
+#define USER_CTRL_FIFO_EN           0x40
+#define USER_CTRL_I2C_MST_EN        0x20
+#define USER_CTRL_RESETS            0x07 // FIFO_RST, I2C_MST_RST and SIG_COND_RST clear themselves
+#define USER_CTRL_FIFO_RST          0x04
+#define INT_PIN_CFG_BYPASS_EN       0x02
+#define INT_PIN_CFG_LATCH_INT_EN    0x20
+#define INT_STATUS_MOT              0x40 // MOT_INT, WOM_INT on MPU9255
+#define INT_STATUS_FIFO_OFLOW       0x10
+#define INT_STATUS_RAW_DATA_RDY     0x01
+#define FIFO_EN_TEMP                0x80
+#define FIFO_EN_XG                  0x40
+#define FIFO_EN_YG                  0x20
+#define FIFO_EN_ZG                  0x10
+#define FIFO_EN_ACCEL               0x08
+#define FIFO_EN_SLV0                0x01
+#define I2C_SLV_EN                  0x80
+#define I2C_SLV_RNW                 0x80
+#define I2C_SLV_LEN_MASK            0x0F
+#define I2C_MST_STATUS_SLV4_DONE    0x40
+#define I2C_MST_STATUS_SLV4_NACK    0x10
+#define I2C_MST_STATUS_SLV0_NACK    0x01
+
+#define MAGN_REG_COUNT              (MPU_AK89XX_REG_ASAZ + 1)
+#define MAGN_WIA                    0x48
+#define MAGN_ST1_DRDY               0x01
+#define MAGN_CNTL_MODE_MASK         0x0F
+#define MAGN_MODE_SINGLE            0x01
+#define MAGN_MODE_8HZ               0x02
+#define MAGN_MODE_100HZ             0x06
+#define MAGN_SINGLE_TIME_US         7200    // Max time of a single measurement
+#define MAGN_RESET                  0x01    // Soft reset bit in the AK8963 CNTL2 register
+#define MAGN_CNTL_BIT               0x10    // 16 bit output on the AK8963, mirrored in BITM of ST2
+
+
+/**@brief A queued asynchronous transaction
+ */
+typedef struct
+{
+    bool                        read;
+    nrf_drv_mpu_dev_t           address;
+    uint8_t                     reg;
+    uint8_t                   * p_data;                         // Read into
+    uint8_t                     data[SIM_WRITE_BUFFER_SIZE];    // Copy of the data to write
+    uint32_t                    length;
+    nrf_drv_mpu_evt_handler_t   evt_handler;
+    void                      * p_context;
+}sim_transaction_t;
+
+/**@brief One virtual MPU, with its magnetometer */
+typedef struct
+{
+    nrf_drv_mpu_dev_t               dev;                        // Bus address, or CS pin
+    bool                            powered;
+    uint8_t                         regs[128];
+    uint8_t                         fifo[SIM_FIFO_SIZE];
+    uint16_t                        fifo_head;                  // Oldest byte
+    uint16_t                        fifo_count;
+#if (SIM_MAGN)
+    uint8_t                         magn_regs[MAGN_REG_COUNT];
+    uint32_t                        next_magn_us;
+    bool                            magn_pending;               // A measurement is due at next_magn_us
+#endif
+    uint32_t                        time_us;
+    uint32_t                        next_sample_us;
+    int16_t                         motion_ref[3];              // Accelerometer sample the motion detection compares with
+    bool                            motion_ref_valid;           // The first sample after the detection is set up only becomes the reference
+    bool                            int_pulse;                  // An enabled interrupt has fired since nrf_drv_mpu_sim_int_get()
+    nrf_drv_mpu_sim_motion_t        motion;
+    nrf_drv_mpu_sim_motion_handler_t motion_handler;
+    void                          * p_motion_context;
+}sim_dev_t;
+
+/**@brief The bus, shared by the virtual MPUs */
+typedef struct
+{
+    sim_dev_t                       devs[NRF_DRV_MPU_SIM_DEVICES];
+    uint8_t                         dev_count;
+    sim_dev_t                     * p_selected;                 // Device the nrf_drv_mpu_sim functions work on
+    uint32_t                        time_us;
+    sim_transaction_t               queue[NRF_DRV_MPU_SIM_QUEUE_SIZE];
+    uint8_t                         queue_head;
+    uint8_t                         queue_count;
+    uint32_t                        fault_skip;
+    uint32_t                        fault_count;
+    uint32_t                        fault_err_code;
+    nrf_drv_mpu_sim_stats_t         stats;
+}sim_t;
+
+static sim_t m_sim;
+static sim_dev_t * m_p_dev = &m_sim.devs[0];   // Device the bus or the clock is working on
+
+
+
+/**@brief Function for telling if time a has been reached at time b, across a wrap of the counter
+ */
+static bool time_reached(uint32_t a, uint32_t b)
+{
+    return (int32_t)(b - a) >= 0;
+}
+
+
+
+static bool cycle_mode(void)
+{
+    return (m_p_dev->regs[MPU_REG_PWR_MGMT_1] & (PWR_MGMT_1_SLEEP | PWR_MGMT_1_CYCLE)) == PWR_MGMT_1_CYCLE;
+}
+
+
+
+static uint32_t sample_period_us(void)
+{
+    uint8_t dlpf = m_p_dev->regs[MPU_REG_CONFIG] & CONFIG_DLPF_CFG_MASK;
+
+    if(cycle_mode())
+    {
+#if defined(MPU9255)
+        uint8_t odr = m_p_dev->regs[MPU_REG_LP_ACCEL_ODR] & 0x0F;
+
+        return 4096000 >> ((odr > 11) ? 11 : odr); // 0.24 Hz, doubled for each step up to 500 Hz
+#else
+        static const uint32_t lp_wake_us[4] = {800000, 200000, 50000, 25000}; // 1.25, 5, 20 and 40 Hz
+
+        return lp_wake_us[m_p_dev->regs[MPU_REG_PWR_MGMT_2] >> PWR_MGMT_2_LP_WAKE_POS];
+#endif
+    }
+
+    // The gyroscope output rate is 8 kHz with the low pass filter off, 1 kHz with it on
+    return ((dlpf == 0 || dlpf == 7) ? 125 : 1000) * (1 + m_p_dev->regs[MPU_REG_SMPLRT_DIV]);
+}
+
+
+
+static void fifo_push(uint8_t const * p_data, uint8_t length, bool * p_overflow)
+{
+    for(uint8_t i = 0; i < length; i++)
+    {
+        if(m_p_dev->fifo_count == SIM_FIFO_SIZE)
+        {
+            *p_overflow = true;
+            if(m_p_dev->regs[MPU_REG_CONFIG] & CONFIG_FIFO_MODE)
+            {
+                return;
+            }
+            m_p_dev->fifo_head = (m_p_dev->fifo_head + 1) % SIM_FIFO_SIZE; // Oldest byte is overwritten
+            m_p_dev->fifo_count--;
+        }
+        m_p_dev->fifo[(m_p_dev->fifo_head + m_p_dev->fifo_count) % SIM_FIFO_SIZE] = p_data[i];
+        m_p_dev->fifo_count++;
+    }
+}
+
+
+
+static uint8_t fifo_pop(void)
+{
+    uint8_t data;
+
+    if(m_p_dev->fifo_count == 0) return 0;
+
+    data = m_p_dev->fifo[m_p_dev->fifo_head];
+    m_p_dev->fifo_head = (m_p_dev->fifo_head + 1) % SIM_FIFO_SIZE;
+    m_p_dev->fifo_count--;
+    return data;
+}
+
+
+
+static void fifo_reset(void)
+{
+    m_p_dev->fifo_head  = 0;
+    m_p_dev->fifo_count = 0;
+}
+
+
+
+static void int16_be_put(uint8_t * p_reg, int16_t value)
+{
+    p_reg[0] = (uint8_t)((uint16_t)value >> 8);
+    p_reg[1] = (uint8_t)value;
+}
+
+
+
+static void motion_update(void)
+{
+    if(m_p_dev->motion_handler != NULL)
+    {
+        m_p_dev->motion_handler(m_p_dev->time_us, &m_p_dev->motion, m_p_dev->p_motion_context);
+    }
+}
+
+
+
+static void int_raise(uint8_t int_status)
+{
+    m_p_dev->regs[MPU_REG_INT_STATUS] |= int_status;
+    if(m_p_dev->regs[MPU_REG_INT_ENABLE] & int_status)
+    {
+        m_p_dev->int_pulse = true;
+    }
+}
+
+
+
+/**@brief Motion detection. Compares each axis with the previous sample, like the MPU9255 Wake-on-Motion
+ * logic. On MPU60x0 and MPU9150 the high pass filter does about the same at the low power rates.
+ */
+static void motion_detect(void)
+{
+    uint8_t  afs         = (m_p_dev->regs[MPU_REG_ACCEL_CONFIG] >> ACCEL_CONFIG_AFS_POS) & ACCEL_CONFIG_AFS_MASK;
+    uint32_t lsb_per_g   = 16384 >> afs;
+    uint32_t threshold   = m_p_dev->regs[MPU_REG_MOT_THR] * SIM_MG_PR_LSB_MOT_THR;
+    bool     moved       = false;
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        int32_t  delta = (int32_t)m_p_dev->motion.accel[i] - m_p_dev->motion_ref[i];
+        uint32_t mg    = (uint32_t)((delta < 0) ? -delta : delta) * 1000 / lsb_per_g;
+
+        if(m_p_dev->motion_ref_valid && mg > threshold) moved = true;
+        m_p_dev->motion_ref[i] = m_p_dev->motion.accel[i];
+    }
+    m_p_dev->motion_ref_valid = true;
+    if(moved)
+    {
+        int_raise(INT_STATUS_MOT);
+    }
+}
+
+
+
+#if (SIM_MAGN)
+
+static void magn_reset(void)
+{
+    memset(m_p_dev->magn_regs, 0, sizeof(m_p_dev->magn_regs));
+    m_p_dev->magn_regs[MPU_AK89XX_REG_WIA]  = MAGN_WIA;
+    m_p_dev->magn_regs[MPU_AK89XX_REG_ASAX] = 128; // No sensitivity adjustment
+    m_p_dev->magn_regs[MPU_AK89XX_REG_ASAY] = 128;
+    m_p_dev->magn_regs[MPU_AK89XX_REG_ASAZ] = 128;
+    m_p_dev->magn_pending = false;
+}
+
+
+
+static uint32_t magn_period_us(void)
+{
+    switch(m_p_dev->magn_regs[MPU_AK89XX_REG_CNTL] & MAGN_CNTL_MODE_MASK)
+    {
+#if defined(MPU9255)
+        case MAGN_MODE_8HZ:   return 125000;
+        case MAGN_MODE_100HZ: return 10000;
+#endif
+        default:              return 0;
+    }
+}
+
+
+
+static void magn_sample(void)
+{
+    uint8_t * p_data = &m_p_dev->magn_regs[MPU_AK89XX_REG_HXL];
+
+    motion_update();
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        p_data[(2 * i)]     = (uint8_t)m_p_dev->motion.magn[i]; // Little endian, unlike the MPU
+        p_data[(2 * i) + 1] = (uint8_t)((uint16_t)m_p_dev->motion.magn[i] >> 8);
+    }
+    m_p_dev->magn_regs[MPU_AK89XX_REG_ST1] |= MAGN_ST1_DRDY;
+#if defined(MPU9255)
+    m_p_dev->magn_regs[MPU_AK89XX_REG_ST2] = m_p_dev->magn_regs[MPU_AK89XX_REG_CNTL] & MAGN_CNTL_BIT;
+#endif
+
+    if((m_p_dev->magn_regs[MPU_AK89XX_REG_CNTL] & MAGN_CNTL_MODE_MASK) == MAGN_MODE_SINGLE)
+    {
+        m_p_dev->magn_regs[MPU_AK89XX_REG_CNTL] &= ~MAGN_CNTL_MODE_MASK; // Back to power down
+        m_p_dev->magn_pending = false;
+    }
+    else
+    {
+        m_p_dev->next_magn_us += magn_period_us();
+    }
+}
+
+
+
+static uint8_t magn_read(uint8_t reg)
+{
+    uint8_t data;
+
+    if(reg >= MAGN_REG_COUNT) return 0;
+
+    data = m_p_dev->magn_regs[reg];
+    if(reg == MPU_AK89XX_REG_ST2)
+    {
+        m_p_dev->magn_regs[MPU_AK89XX_REG_ST1] &= ~MAGN_ST1_DRDY; // Reading ST2 ends the data read
+    }
+    return data;
+}
+
+
+
+static void magn_write(uint8_t reg, uint8_t data)
+{
+    if(reg == MPU_AK89XX_REG_CNTL)
+    {
+        m_p_dev->magn_regs[reg] = data;
+        switch(data & MAGN_CNTL_MODE_MASK)
+        {
+            case MAGN_MODE_SINGLE:
+                m_p_dev->next_magn_us = m_p_dev->time_us + MAGN_SINGLE_TIME_US;
+                m_p_dev->magn_pending = true;
+                break;
+            default:
+                m_p_dev->next_magn_us = m_p_dev->time_us + magn_period_us();
+                m_p_dev->magn_pending = (magn_period_us() != 0);
+                break;
+        }
+    }
+#if defined(MPU9255)
+    else if(reg == MPU_AK89XX_REG_RST && (data & MAGN_RESET))
+    {
+        magn_reset();
+    }
+#endif
+    else if(reg == MPU_AK89XX_REG_ASTC)
+    {
+        m_p_dev->magn_regs[reg] = data;
+    }
+}
+
+
+
+/**@brief Slave 0 of the MPU I2C master, run on every sample */
+static void i2c_master_slv0_run(void)
+{
+    uint8_t address = m_p_dev->regs[MPU_REG_I2C_SLV0_ADDR];
+    uint8_t reg     = m_p_dev->regs[MPU_REG_I2C_SLV0_REG];
+    uint8_t length  = m_p_dev->regs[MPU_REG_I2C_SLV0_CTRL] & I2C_SLV_LEN_MASK;
+
+    if((address & ~I2C_SLV_RNW) != MPU_AK89XX_MAGN_ADDRESS)
+    {
+        m_p_dev->regs[MPU_REG_I2C_MST_STATUS] |= I2C_MST_STATUS_SLV0_NACK;
+        return;
+    }
+    for(uint8_t i = 0; i < length; i++)
+    {
+        if(address & I2C_SLV_RNW)
+        {
+            m_p_dev->regs[MPU_REG_EXT_SENS_DATA_00 + i] = magn_read(reg + i);
+        }
+        else
+        {
+            magn_write(reg + i, m_p_dev->regs[MPU_REG_I2C_SLV0_DO]);
+        }
+    }
+}
+
+
+
+/**@brief Slave 4 of the MPU I2C master, run once when it is enabled */
+static void i2c_master_slv4_run(void)
+{
+    uint8_t address = m_p_dev->regs[MPU_REG_I2C_SLV4_ADDR];
+    uint8_t reg     = m_p_dev->regs[MPU_REG_I2C_SLV4_REG];
+
+    if((address & ~I2C_SLV_RNW) != MPU_AK89XX_MAGN_ADDRESS)
+    {
+        m_p_dev->regs[MPU_REG_I2C_MST_STATUS] |= I2C_MST_STATUS_SLV4_NACK | I2C_MST_STATUS_SLV4_DONE;
+        return;
+    }
+    if(address & I2C_SLV_RNW)
+    {
+        m_p_dev->regs[MPU_REG_I2C_SLV4_DI] = magn_read(reg);
+    }
+    else
+    {
+        magn_write(reg, m_p_dev->regs[MPU_REG_I2C_SLV4_DO]);
+    }
+    m_p_dev->regs[MPU_REG_I2C_MST_STATUS] |= I2C_MST_STATUS_SLV4_DONE;
+}
+
+#endif // (SIM_MAGN)
+
+
+
+static void sample_take(void)
+{
+    uint8_t fifo_en  = m_p_dev->regs[MPU_REG_FIFO_EN];
+    bool    overflow = false;
+    bool    gyro;
+
+    m_p_dev->next_sample_us += sample_period_us();
+    if(m_p_dev->regs[MPU_REG_PWR_MGMT_1] & PWR_MGMT_1_SLEEP)
+    {
+        return;
+    }
+
+    motion_update();
+    gyro = !cycle_mode() && !(m_p_dev->regs[MPU_REG_PWR_MGMT_2] & PWR_MGMT_2_STBY_G);
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        int16_be_put(&m_p_dev->regs[MPU_REG_ACCEL_XOUT_H + (2 * i)], m_p_dev->motion.accel[i]);
+        if(gyro) int16_be_put(&m_p_dev->regs[MPU_REG_GYRO_XOUT_H + (2 * i)], m_p_dev->motion.gyro[i]);
+    }
+    int16_be_put(&m_p_dev->regs[MPU_REG_TEMP_OUT_H], m_p_dev->motion.temp);
+    if(m_p_dev->regs[MPU_REG_INT_ENABLE] & INT_STATUS_MOT)
+    {
+        motion_detect();
+    }
+
+#if (SIM_MAGN)
+    if((m_p_dev->regs[MPU_REG_USER_CTRL] & USER_CTRL_I2C_MST_EN) && (m_p_dev->regs[MPU_REG_I2C_SLV0_CTRL] & I2C_SLV_EN))
+    {
+        i2c_master_slv0_run();
+    }
+#endif
+    int_raise(INT_STATUS_RAW_DATA_RDY);
+
+    if(!(m_p_dev->regs[MPU_REG_USER_CTRL] & USER_CTRL_FIFO_EN))
+    {
+        return;
+    }
+    // Same order as the data registers
+    if(fifo_en & FIFO_EN_ACCEL) fifo_push(&m_p_dev->regs[MPU_REG_ACCEL_XOUT_H], 6, &overflow);
+    if(fifo_en & FIFO_EN_TEMP)  fifo_push(&m_p_dev->regs[MPU_REG_TEMP_OUT_H], 2, &overflow);
+    if(fifo_en & FIFO_EN_XG)    fifo_push(&m_p_dev->regs[MPU_REG_GYRO_XOUT_H], 2, &overflow);
+    if(fifo_en & FIFO_EN_YG)    fifo_push(&m_p_dev->regs[MPU_REG_GYRO_YOUT_H], 2, &overflow);
+    if(fifo_en & FIFO_EN_ZG)    fifo_push(&m_p_dev->regs[MPU_REG_GYRO_ZOUT_H], 2, &overflow);
+    if(fifo_en & FIFO_EN_SLV0)  fifo_push(&m_p_dev->regs[MPU_REG_EXT_SENS_DATA_00],
+                                          m_p_dev->regs[MPU_REG_I2C_SLV0_CTRL] & I2C_SLV_LEN_MASK, &overflow);
+    if(overflow)
+    {
+        int_raise(INT_STATUS_FIFO_OFLOW);
+        m_sim.stats.fifo_overflows++;
+    }
+}
+
+
+
+static void device_reset(void)
+{
+    memset(m_p_dev->regs, 0, sizeof(m_p_dev->regs));
+    m_p_dev->regs[MPU_REG_PWR_MGMT_1] = PWR_MGMT_1_SLEEP;
+    m_p_dev->regs[MPU_REG_WHO_AM_I]   = SIM_WHO_AM_I;
+    m_p_dev->next_sample_us           = m_p_dev->time_us + sample_period_us();
+    fifo_reset();
+#if (SIM_MAGN)
+    magn_reset();
+#endif
+}
+
+
+
+static uint8_t reg_read(uint8_t reg)
+{
+    uint8_t data;
+
+    switch(reg)
+    {
+        case MPU_REG_FIFO_R_W:
+            return fifo_pop();
+        case MPU_REG_FIFO_COUNTH:
+            return (uint8_t)(m_p_dev->fifo_count >> 8);
+        case MPU_REG_FIFO_COUNTL:
+            return (uint8_t)m_p_dev->fifo_count;
+        case MPU_REG_INT_STATUS:
+        case MPU_REG_I2C_MST_STATUS:
+            data = m_p_dev->regs[reg];
+            m_p_dev->regs[reg] = 0; // Cleared when read
+            return data;
+        default:
+            return m_p_dev->regs[reg & 0x7F];
+    }
+}
+
+
+
+static void reg_write(uint8_t reg, uint8_t data)
+{
+    reg &= 0x7F;
+    if((reg >= MPU_REG_INT_STATUS && reg <= MPU_REG_EXT_SENS_DATA_23) || reg == MPU_REG_WHO_AM_I ||
+       reg == MPU_REG_I2C_SLV4_DI || reg == MPU_REG_I2C_MST_STATUS || reg == MPU_REG_FIFO_R_W)
+    {
+        return; // Read only
+    }
+
+    switch(reg)
+    {
+        case MPU_REG_PWR_MGMT_1:
+            if(data & PWR_MGMT_1_H_RESET)
+            {
+                device_reset();
+                return;
+            }
+            break;
+        case MPU_REG_USER_CTRL:
+            if(data & USER_CTRL_FIFO_RST)
+            {
+                fifo_reset();
+            }
+            data &= ~USER_CTRL_RESETS;
+            break;
+        default:
+            break;
+    }
+    m_p_dev->regs[reg] = data;
+
+    if(reg == MPU_REG_INT_ENABLE || reg == MPU_REG_PWR_MGMT_1)
+    {
+        m_p_dev->motion_ref_valid = false;
+    }
+    if(reg == MPU_REG_SMPLRT_DIV || reg == MPU_REG_CONFIG || reg == MPU_REG_PWR_MGMT_1 || reg == MPU_REG_PWR_MGMT_2
+#if defined(MPU9255)
+       || reg == MPU_REG_LP_ACCEL_ODR
+#endif
+       )
+    {
+        m_p_dev->next_sample_us = m_p_dev->time_us + sample_period_us();
+    }
+#if (SIM_MAGN)
+    if(reg == MPU_REG_I2C_SLV4_CTRL && (data & I2C_SLV_EN) && (m_p_dev->regs[MPU_REG_USER_CTRL] & USER_CTRL_I2C_MST_EN))
+    {
+        i2c_master_slv4_run();
+        m_p_dev->regs[reg] &= ~I2C_SLV_EN;
+    }
+#endif
+}
+
+
+
+static bool fault_take(void)
+{
+    if(m_sim.fault_count == 0) return false;
+    if(m_sim.fault_skip > 0)
+    {
+        m_sim.fault_skip--;
+        return false;
+    }
+    m_sim.fault_count--;
+    return true;
+}
+
+
+
+static sim_dev_t * dev_find(nrf_drv_mpu_dev_t dev)
+{
+    for(uint8_t i = 0; i < m_sim.dev_count; i++)
+    {
+        if(m_sim.devs[i].dev == dev) return &m_sim.devs[i];
+    }
+    return NULL;
+}
+
+
+
+/**@brief Function for powering up a new virtual MPU. Like the real device, it keeps its
+ * registers when the bus driver is initiated again.
+ */
+static uint32_t dev_add(nrf_drv_mpu_dev_t dev)
+{
+    if(dev_find(dev) != NULL) return NRF_SUCCESS;
+    if(m_sim.dev_count == NRF_DRV_MPU_SIM_DEVICES) return NRF_ERROR_NO_MEM;
+
+    m_p_dev = &m_sim.devs[m_sim.dev_count++];
+    memset(m_p_dev, 0, sizeof(sim_dev_t));
+    m_p_dev->dev     = dev;
+    m_p_dev->powered = true;
+    m_p_dev->time_us = m_sim.time_us;
+    device_reset();
+    if(m_sim.p_selected == NULL)
+    {
+        m_sim.p_selected = m_p_dev;
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+/**@brief Function for running one bus transaction on the virtual devices */
+static uint32_t transaction_run(bool read, nrf_drv_mpu_dev_t address, uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+#if defined(MPU_USES_SPI)
+    // Register, then the data, while CS is low
+    uint32_t clocks = (1 + length) * 8;
+#else
+    // Start, slave address, register, then a repeated start and slave address again when reading
+    uint32_t clocks = (((read ? 3 : 2) + length) * 9) + 2;
+#endif
+
+    m_sim.stats.transactions++;
+    m_sim.stats.bytes       += 1 + length;
+    m_sim.stats.bus_time_us += (uint32_t)(((uint64_t)clocks * 1000000) / NRF_DRV_MPU_SIM_BUS_HZ);
+
+    if(fault_take())
+    {
+        m_sim.stats.errors++;
+        return m_sim.fault_err_code;
+    }
+
+    m_p_dev = dev_find(address);
+    if(m_p_dev != NULL)
+    {
+        for(uint32_t i = 0; i < length; i++)
+        {
+            if(read) p_data[i] = reg_read(reg);
+            else     reg_write(reg, p_data[i]);
+            if(reg != MPU_REG_FIFO_R_W) reg++; // Burst reads of the FIFO stay on FIFO_R_W
+        }
+        return NRF_SUCCESS;
+    }
+#if (SIM_MAGN)
+    // The magnetometer is only on the bus in bypass mode with the MPU I2C master off
+    for(uint8_t d = 0; d < m_sim.dev_count && address == MPU_AK89XX_MAGN_ADDRESS; d++)
+    {
+        m_p_dev = &m_sim.devs[d];
+        if(!(m_p_dev->regs[MPU_REG_INT_PIN_CFG] & INT_PIN_CFG_BYPASS_EN) ||
+           (m_p_dev->regs[MPU_REG_USER_CTRL] & USER_CTRL_I2C_MST_EN))
+        {
+            continue;
+        }
+        for(uint32_t i = 0; i < length; i++)
+        {
+            if(read) p_data[i] = magn_read(reg + i);
+            else     magn_write(reg + i, p_data[i]);
+        }
+        return NRF_SUCCESS;
+    }
+#endif
+    m_sim.stats.errors++;
+    return NRF_ERROR_DRV_TWI_ERR_ANACK;
+}
+
+
+
+static uint32_t perform(bool read, nrf_drv_mpu_dev_t address, uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    if(read && (length == 0 || length > UINT8_MAX))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if(!read && length > SIM_WRITE_BUFFER_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    return transaction_run(read, address, reg, p_data, length);
+}
+
+
+
+static uint32_t schedule(bool read, nrf_drv_mpu_dev_t address, uint8_t reg, uint8_t * p_data, uint32_t length,
+                         nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    sim_transaction_t * p_trans;
+
+    if(read && (length == 0 || length > UINT8_MAX))
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if(!read && length > SIM_WRITE_BUFFER_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    if(m_sim.queue_count == NRF_DRV_MPU_SIM_QUEUE_SIZE)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    p_trans = &m_sim.queue[(m_sim.queue_head + m_sim.queue_count) % NRF_DRV_MPU_SIM_QUEUE_SIZE];
+    p_trans->read        = read;
+    p_trans->address     = address;
+    p_trans->reg         = reg;
+    p_trans->length      = length;
+    p_trans->p_data      = read ? p_data : p_trans->data;
+    p_trans->evt_handler = evt_handler;
+    p_trans->p_context   = p_context;
+    if(!read)
+    {
+        memcpy(p_trans->data, p_data, length);
+    }
+    m_sim.queue_count++;
+    return NRF_SUCCESS;
+}
+
+
+
+/**@brief Function for the device the nrf_drv_mpu_sim functions work on. They can be called
+ * before nrf_drv_mpu_init(), so NRF_DRV_MPU_DEV_DEFAULT is powered up if nothing is on the bus yet.
+ */
+static sim_dev_t * selected_get(void)
+{
+    if(m_sim.p_selected == NULL)
+    {
+        (void)dev_add(NRF_DRV_MPU_DEV_DEFAULT);
+    }
+    return m_sim.p_selected;
+}
+
+
+
+void nrf_drv_mpu_sim_select(nrf_drv_mpu_dev_t dev)
+{
+    if(dev_find(dev) == NULL)
+    {
+        (void)dev_add(dev);
+    }
+    m_sim.p_selected = dev_find(dev);
+}
+
+
+
+void nrf_drv_mpu_sim_motion_set(nrf_drv_mpu_sim_motion_handler_t handler, void * p_context)
+{
+    sim_dev_t * p_dev = selected_get();
+
+    p_dev->motion_handler   = handler;
+    p_dev->p_motion_context = p_context;
+}
+
+
+
+/**@brief Function for adding time to the power mode the MPU is in */
+static void power_time_add(uint32_t time_us)
+{
+    if(cycle_mode())
+    {
+        m_sim.stats.cycle_time_us += time_us;
+    }
+    else if(!(m_p_dev->regs[MPU_REG_PWR_MGMT_1] & PWR_MGMT_1_SLEEP))
+    {
+        m_sim.stats.active_time_us += time_us;
+    }
+}
+
+
+
+/**@brief Function for moving the clock of one device to end_us. Samples falling due are taken */
+static void dev_time_advance(uint32_t end_us)
+{
+    if(!m_p_dev->powered)
+    {
+        m_p_dev->time_us = end_us;
+        return;
+    }
+
+    for(;;)
+    {
+        uint32_t next_us = m_p_dev->next_sample_us;
+#if (SIM_MAGN)
+        bool magn = m_p_dev->magn_pending && time_reached(m_p_dev->next_magn_us, next_us); // First when both are due
+
+        if(magn) next_us = m_p_dev->next_magn_us;
+#endif
+        if(!time_reached(next_us, end_us))
+        {
+            break;
+        }
+
+        power_time_add(next_us - m_p_dev->time_us);
+        m_p_dev->time_us = next_us;
+#if (SIM_MAGN)
+        if(magn)
+        {
+            magn_sample();
+            continue;
+        }
+#endif
+        sample_take();
+    }
+    power_time_add(end_us - m_p_dev->time_us);
+    m_p_dev->time_us = end_us;
+}
+
+
+
+void nrf_drv_mpu_sim_time_advance(uint32_t time_us)
+{
+    m_sim.time_us += time_us;
+    for(uint8_t i = 0; i < m_sim.dev_count; i++)
+    {
+        m_p_dev = &m_sim.devs[i];
+        dev_time_advance(m_sim.time_us);
+    }
+}
+
+
+
+uint32_t nrf_drv_mpu_sim_process(void)
+{
+    // Only what is queued now, so a handler that schedules a new transaction does not loop forever
+    uint32_t count = m_sim.queue_count;
+
+    for(uint32_t i = 0; i < count; i++)
+    {
+        sim_transaction_t trans = m_sim.queue[m_sim.queue_head];
+        uint32_t result;
+
+        // Released before the handler is called, so the handler can schedule a new transaction
+        m_sim.queue_head = (m_sim.queue_head + 1) % NRF_DRV_MPU_SIM_QUEUE_SIZE;
+        m_sim.queue_count--;
+
+        result = transaction_run(trans.read, trans.address, trans.reg, trans.read ? trans.p_data : trans.data, trans.length);
+        if(trans.evt_handler != NULL)
+        {
+            trans.evt_handler(result, trans.p_context);
+        }
+    }
+    return count;
+}
+
+
+
+void nrf_drv_mpu_sim_fault_set(uint32_t skip, uint32_t count, uint32_t err_code)
+{
+    m_sim.fault_skip     = skip;
+    m_sim.fault_count    = count;
+    m_sim.fault_err_code = err_code;
+}
+
+
+
+void nrf_drv_mpu_sim_stats_get(nrf_drv_mpu_sim_stats_t * p_stats)
+{
+    *p_stats = m_sim.stats;
+}
+
+
+
+uint8_t nrf_drv_mpu_sim_register_get(uint8_t reg)
+{
+    return selected_get()->regs[reg & 0x7F];
+}
+
+
+
+bool nrf_drv_mpu_sim_int_get(void)
+{
+    sim_dev_t * p_dev = selected_get();
+    bool pulse = p_dev->int_pulse;
+
+    p_dev->int_pulse = false;
+    if(p_dev->regs[MPU_REG_INT_PIN_CFG] & INT_PIN_CFG_LATCH_INT_EN)
+    {
+        return (p_dev->regs[MPU_REG_INT_STATUS] & p_dev->regs[MPU_REG_INT_ENABLE]) != 0;
+    }
+    return pulse;
+}
+
+
+
+/**
+ * @brief Powers the virtual MPU at NRF_DRV_MPU_DEV_DEFAULT up the first time.
+ */
+uint32_t nrf_drv_mpu_init(void)
+{
+    uint32_t err_code;
+
+    err_code = dev_add(NRF_DRV_MPU_DEV_DEFAULT);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    memset(&m_sim.stats, 0, sizeof(m_sim.stats));
+    return NRF_SUCCESS;
+}
+
+
+
+/**
+ * @brief Pending transactions are dropped without calling their handlers, like app_twi_uninit().
+ */
+uint32_t nrf_drv_mpu_uninit(void)
+{
+    m_sim.queue_head  = 0;
+    m_sim.queue_count = 0;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_mpu_dev_init(nrf_drv_mpu_dev_t dev)
+{
+    return dev_add(dev);
+}
+
+
+
+uint32_t nrf_drv_mpu_dev_write_registers(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    return perform(false, dev, reg, p_data, length);
+}
+
+
+uint32_t nrf_drv_mpu_dev_read_registers(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    return perform(true, dev, reg, p_data, length);
+}
+
+
+uint32_t nrf_drv_mpu_dev_read_registers_async(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length,
+                                              nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return schedule(true, dev, reg, p_data, length, evt_handler, p_context);
+}
+
+
+uint32_t nrf_drv_mpu_dev_write_registers_async(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length,
+                                               nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return schedule(false, dev, reg, p_data, length, evt_handler, p_context);
+}
+
+
+
+uint32_t nrf_drv_mpu_write_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    return perform(false, NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length);
+}
+
+uint32_t nrf_drv_mpu_write_single_register(uint8_t reg, uint8_t data)
+{
+    return perform(false, NRF_DRV_MPU_DEV_DEFAULT, reg, &data, 1);
+}
+
+
+uint32_t nrf_drv_mpu_read_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    return perform(true, NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length);
+}
+
+
+uint32_t nrf_drv_mpu_read_registers_async(uint8_t reg, uint8_t * p_data, uint32_t length,
+                                          nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return schedule(true, NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length, evt_handler, p_context);
+}
+
+
+uint32_t nrf_drv_mpu_write_registers_async(uint8_t reg, uint8_t * p_data, uint32_t length,
+                                           nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return schedule(false, NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length, evt_handler, p_context);
+}
+
+
+#if (SIM_MAGN)
+
+uint32_t nrf_drv_mpu_read_magnetometer_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    return perform(true, MPU_AK89XX_MAGN_ADDRESS, reg, p_data, length);
+}
+
+
+uint32_t nrf_drv_mpu_write_magnetometer_register(uint8_t reg, uint8_t data)
+{
+    return perform(false, MPU_AK89XX_MAGN_ADDRESS, reg, &data, 1);
+}
+
+#endif // (SIM_MAGN)
+
+
+/**
+  @}
+*/
@@ -0,0 +1,168 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef NRF_DRV_MPU_SIM__
+#define NRF_DRV_MPU_SIM__
+
+/* Simulated MPU behind the nrf_drv_mpu.h interface.
+ *
+ * Link nrf_drv_mpu_sim.c instead of nrf_drv_mpu_twi.c or nrf_drv_mpu_spi.c to run app_mpu.c,
+ * app_mpu_block.c and the code above them without a board, e.g. on a PC. It only needs
+ * sdk_errors.h, sdk_config.h and the register map of the MPU selected with MPU60x0, MPU9150
+ * or MPU9255.
+ *
+ * The virtual MPU models:
+ *  - the sample rate from SMPLRT_DIV and CONFIG, and the sleep bit in PWR_MGMT_1
+ *  - the data registers, RAW_DATA_RDY and FIFO_OFLOW in INT_STATUS, cleared when read
+ *  - the FIFO, filled as selected by FIFO_EN and USER_CTRL, with FIFO_MODE and FIFO_RST
+ *  - the AK89xx magnetometer (MPU9150 and MPU9255) with its own 8 or 100 Hz rate, DRDY and BITM.
+ *    It is reached in bypass mode, or by the MPU I2C master through slave 0 into
+ *    EXT_SENS_DATA and FIFO, and slave 4 for single transfers
+ *  - low power cycle mode from CYCLE in PWR_MGMT_1, with its own accelerometer rate, the gyroscope
+ *    in standby, and the motion interrupt that app_mpu_lp_motion_enable() sets up
+ *  - the INT pin, read with nrf_drv_mpu_sim_int_get()
+ *
+ * More MPUs can be put on the bus with nrf_drv_mpu_dev_init(), each a virtual MPU of its own at
+ * that address or CS pin. nrf_drv_mpu_sim_select() picks the one the functions below work on.
+ *
+ * Time only moves when nrf_drv_mpu_sim_time_advance() is called. Asynchronous transactions
+ * are queued and run when nrf_drv_mpu_sim_process() is called. Neither is thread safe, so
+ * call them from the same context as the driver functions.
+ *
+ * Sensor values come from a motion handler, so a test can play back a recorded or scripted
+ * trace. Bus errors are injected with nrf_drv_mpu_sim_fault_set(). The statistics tell how long the
+ * MPU has been in each power mode, so the current draw of a trace can be worked out from the
+ * supply currents in the datasheet.
+ *
+ * The host tests in test/ are built on top of it. Run them with 'make -C test'.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nrf_drv_mpu.h"
+
+#ifndef NRF_DRV_MPU_SIM_QUEUE_SIZE
+#define NRF_DRV_MPU_SIM_QUEUE_SIZE      8       // Asynchronous transactions that can be pending, like the TWI driver
+#endif
+#ifndef NRF_DRV_MPU_SIM_DEVICES
+#define NRF_DRV_MPU_SIM_DEVICES         8       // Virtual MPUs that can be on the bus
+#endif
+#ifndef NRF_DRV_MPU_SIM_BUS_HZ
+#if defined(MPU_USES_SPI)
+#define NRF_DRV_MPU_SIM_BUS_HZ          8000000 // Bus clock used for the bus time statistics. The SPI clock of sensor reads in nrf_drv_mpu_spi.c
+#else
+#define NRF_DRV_MPU_SIM_BUS_HZ          400000  // Bus clock used for the bus time statistics
+#endif
+#endif
+
+/**@brief Sensor values in raw LSB, as they appear in the registers
+ */
+typedef struct
+{
+    int16_t     accel[3];
+    int16_t     temp;
+    int16_t     gyro[3];
+    int16_t     magn[3];
+}nrf_drv_mpu_sim_motion_t;
+
+/**@brief Handler called for every new MPU or magnetometer sample with the simulated time in microseconds.
+ * p_motion holds the previous values, so a handler only needs to change what moves.
+ */
+typedef void (* nrf_drv_mpu_sim_motion_handler_t)(uint32_t time_us, nrf_drv_mpu_sim_motion_t * p_motion, void * p_context);
+
+/**@brief Bus statistics since nrf_drv_mpu_init()
+ */
+typedef struct
+{
+    uint32_t    transactions;
+    uint32_t    bytes;              // Register address and data bytes
+    uint32_t    bus_time_us;        // At NRF_DRV_MPU_SIM_BUS_HZ. TWI: 9 clocks per byte plus start, slave address and stop. SPI: 8 clocks per byte
+    uint32_t    errors;             // Injected faults and NACKs
+    uint32_t    fifo_overflows;
+    uint32_t    active_time_us;     // Sampling at the full rate, with or without the gyroscope in standby. Summed over the MPUs
+    uint32_t    cycle_time_us;      // In low power cycle mode. The rest of the time the MPU is asleep. Summed over the MPUs
+}nrf_drv_mpu_sim_stats_t;
+
+
+
+/**@brief Function for choosing the virtual MPU that the other nrf_drv_mpu_sim functions work on
+ *
+ * The first MPU powered up is selected until this is called. An MPU that is not on the bus yet is
+ * powered up.
+ *
+ * @param[in]   dev             MPU
+ */
+void nrf_drv_mpu_sim_select(nrf_drv_mpu_dev_t dev);
+
+
+
+/**@brief Function for setting the handler that provides the sensor values
+ *
+ * @param[in]   handler         Motion handler. NULL keeps the values constant
+ * @param[in]   p_context       Passed to the handler
+ */
+void nrf_drv_mpu_sim_motion_set(nrf_drv_mpu_sim_motion_handler_t handler, void * p_context);
+
+
+
+/**@brief Function for moving the simulated time forward. Samples falling due are taken
+ *
+ * @param[in]   time_us         Microseconds to advance
+ */
+void nrf_drv_mpu_sim_time_advance(uint32_t time_us);
+
+
+
+/**@brief Function for running the queued asynchronous transactions and calling their handlers
+ *
+ * @retval      uint32_t        Number of transactions run
+ */
+uint32_t nrf_drv_mpu_sim_process(void);
+
+
+
+/**@brief Function for making transactions fail
+ *
+ * @param[in]   skip            Transactions that succeed before the first failure
+ * @param[in]   count           Transactions that fail. 0 turns fault injection off
+ * @param[in]   err_code        Returned by the failing transactions, e.g. NRF_ERROR_DRV_TWI_ERR_ANACK
+ */
+void nrf_drv_mpu_sim_fault_set(uint32_t skip, uint32_t count, uint32_t err_code);
+
+
+
+/**@brief Function for reading the bus statistics
+ *
+ * @param[out]  p_stats         Statistics
+ */
+void nrf_drv_mpu_sim_stats_get(nrf_drv_mpu_sim_stats_t * p_stats);
+
+
+
+/**@brief Function for peeking at a register without the side effects of a bus read
+ *
+ * @param[in]   reg             MPU register
+ * @retval      uint8_t         Value
+ */
+uint8_t nrf_drv_mpu_sim_register_get(uint8_t reg);
+
+
+
+/**@brief Function for reading the INT pin, e.g. after each nrf_drv_mpu_sim_time_advance()
+ *
+ * With LATCH_INT_EN in INT_PIN_CFG the pin is high until INT_STATUS is read. Without it the
+ * pin only pulses, and true means a pulse has come since the last call.
+ *
+ * @retval      bool            true if the pin is high, active high as after reset
+ */
+bool nrf_drv_mpu_sim_int_get(void);
+
+
+#endif /* NRF_DRV_MPU_SIM__ */
+
+/**
+  @}
+*/
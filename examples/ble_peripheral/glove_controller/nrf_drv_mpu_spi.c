@@ -12,75 +12,239 @@
 #include "app_util_platform.h"
 #include "nrf_gpio.h"
 
-#if defined(MPU9150)
-#error "MPU9150 does not support SPI"
+#if defined(MPU60x0)
+    #include "mpu60x0_register_map.h"
+#elif defined(MPU9150)
+    #error "MPU9150 does not support SPI"
+#elif defined(MPU9255)
+    #include "mpu9255_register_map.h"
+#else
+    #error "No MPU defined. Please define MPU in Target Options C/C++ Defines"
 #endif
 
-/* Pins to connect MPU. Pinout is different for nRF51 DK and nRF52 DK
- * and therefore I have added a conditional statement defining different pins
- * for each board. This is only for my own convenience and might be subject to changes as I devleop. 
- */
-#if defined(BOARD_PCA10040)
-#define MPU_SPI_MISO_PIN    28 // MPU SDO. 'AD0' on MPU breakout board silk screen
-#define MPU_SPI_MOSI_PIN    4  // MPU SDI. 'SDA' on MPU breakout board silk screen
-#define MPU_SPI_SCL_PIN     3  // MPU SCLK. 'SCL' on MPU breakout board silk screen
-#define MPU_SPI_CS_PIN      29 // MPU nCS. 'NCS' on MPU breakout board silk screen
-#else // If PCA10028
-#define MPU_SPI_MISO_PIN    3 // MPU SDO. 'AD0' on MPU breakout board silk screen
-#define MPU_SPI_MOSI_PIN    2  // MPU SDI. 'SDA' on MPU breakout board silk screen
-#define MPU_SPI_SCL_PIN     1  // MPU SCLK. 'SCL' on MPU breakout board silk screen
-#define MPU_SPI_CS_PIN      4 // MPU nCS. 'NCS' on MPU breakout board silk screen
+#if defined(SPIM_PRESENT) && SPI0_USE_EASY_DMA
+#define MPU_SPI_USES_EASY_DMA   1
+#include "nrf_spim.h"
+#include "nrf_drv_ppi.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_delay.h"
+#else
+#define MPU_SPI_USES_EASY_DMA   0
+#include "nrf_spi.h"
 #endif
 
+/* The MPU takes register writes, and reads of most registers, at up to 1 MHz. Sensor data,
+ * interrupt status and the FIFO can be read at up to 20 MHz. The clock is set before each
+ * transaction from the registers it touches.
+ */
+#ifndef MPU_SPI_FREQ_CONFIG
+#define MPU_SPI_FREQ_CONFIG     NRF_DRV_SPI_FREQ_1M
+#endif
+#ifndef MPU_SPI_FREQ_DATA
+#define MPU_SPI_FREQ_DATA       NRF_DRV_SPI_FREQ_8M     // Fastest clock of the nRF5 SPI and SPIM
+#endif
 
-#define MPU_SPI_BUFFER_SIZE     14 // 14 byte buffers will suffice to read acceleromter, gyroscope and temperature data in one transmission.
+#define MPU_SPI_BUFFER_SIZE     22 // Register byte + acceleromter, temperature, gyroscope and magnetometer data in one transmission.
 #define MPU_SPI_WRITE_BIT       0x00
 #define MPU_SPI_READ_BIT        0x80
 #define MPU_SPI_TIMEOUT         5000 
 
 
 static const nrf_drv_spi_t m_spi_instance = NRF_DRV_SPI_INSTANCE(0);
-volatile static bool spi_tx_done = false;
 
 
 uint8_t spi_tx_buffer[MPU_SPI_BUFFER_SIZE];
 uint8_t spi_rx_buffer[MPU_SPI_BUFFER_SIZE];
 
 
+/**@brief Transfer in progress. The SPI driver only handles one transfer at a time.
+ *
+ * Writes and short reads are one SPI transfer through the buffers above. Longer reads, like
+ * FIFO drains, are two transfers with CS held low in between: the register byte, and then
+ * the data clocked straight into the callers buffer. With SPIM that is EasyDMA into the
+ * callers buffer and no copy.
+ */
+typedef struct
+{
+    nrf_drv_mpu_evt_handler_t   evt_handler;
+    void                      * p_context;
+    uint8_t                   * p_data;     // Where to copy read data from spi_rx_buffer. NULL for writes and direct reads
+    uint8_t                   * p_direct;   // Where to read data directly after the register byte. NULL when done
+    uint32_t                    length;
+    uint32_t                    result;
+    uint8_t                     cs_pin;
+    volatile bool               in_progress;
+}mpu_spi_transfer_t;
+
+static mpu_spi_transfer_t m_transfer;
+
+#if MPU_SPI_USES_EASY_DMA
+/**@brief Reads started through PPI */
+typedef struct
+{
+    uint8_t                     tx_buffer[1];   // Register byte. EasyDMA needs it in RAM
+    uint8_t                   * p_buffer;
+    uint8_t                     length;
+    nrf_ppi_channel_t           ppi_start;
+    nrf_ppi_channel_t           ppi_end;
+    bool                        enabled;
+}mpu_spi_trigger_t;
+
+static mpu_spi_trigger_t m_trigger;
+#endif
+
+
+
+static void frequency_set(nrf_drv_spi_frequency_t frequency)
+{
+#if MPU_SPI_USES_EASY_DMA
+    nrf_spim_frequency_set((NRF_SPIM_Type *)m_spi_instance.p_registers, (nrf_spim_frequency_t)frequency);
+#else
+    nrf_spi_frequency_set((NRF_SPI_Type *)m_spi_instance.p_registers, (nrf_spi_frequency_t)frequency);
+#endif
+}
+
+
+
+/**@brief Function for the fastest clock the MPU allows for a read of 'length' registers from 'reg' */
+static nrf_drv_spi_frequency_t read_frequency_get(uint8_t reg, uint32_t length)
+{
+    uint32_t last = reg + length - 1;
+
+    if(reg >= MPU_REG_INT_STATUS && last <= MPU_REG_EXT_SENS_DATA_23) return MPU_SPI_FREQ_DATA;
+    if(reg >= MPU_REG_FIFO_COUNTH && last <= MPU_REG_FIFO_R_W) return MPU_SPI_FREQ_DATA;
+    if(reg == MPU_REG_FIFO_R_W) return MPU_SPI_FREQ_DATA; // Does not auto increment, so any length is FIFO data
+    return MPU_SPI_FREQ_CONFIG;
+}
+
+
+
+static bool busy(void)
+{
+#if MPU_SPI_USES_EASY_DMA
+    if(m_trigger.enabled) return true;
+#endif
+    return m_transfer.in_progress;
+}
+
+
+
+static void transfer_finish(uint32_t result)
+{
+    nrf_drv_mpu_evt_handler_t evt_handler = m_transfer.evt_handler;
+
+    nrf_gpio_pin_set(m_transfer.cs_pin);
+    m_transfer.result      = result;
+    m_transfer.in_progress = false;
+
+    if(evt_handler != NULL)
+    {
+        evt_handler(result, m_transfer.p_context);
+    }
+}
+
+
+
 void nrf_drv_mpu_spi_event_handler(const nrf_drv_spi_evt_t *evt)
 {
-    if(evt->type == NRF_DRV_SPI_EVENT_DONE)
+    uint32_t err_code;
+
+    if(!m_transfer.in_progress || evt->type != NRF_DRV_SPI_EVENT_DONE) return;
+
+    if(m_transfer.p_direct != NULL)
     {
-        spi_tx_done = true;
+        uint8_t * p_direct = m_transfer.p_direct;
+
+        // The register byte is out. CS stays low while the data is clocked in
+        m_transfer.p_direct = NULL;
+        err_code = nrf_drv_spi_transfer(&m_spi_instance, NULL, 0, p_direct, m_transfer.length);
+        if(err_code != NRF_SUCCESS)
+        {
+            transfer_finish(err_code);
+        }
+        return;
     }
-    else
+
+    if(m_transfer.p_data != NULL)
     {
-        // Something is wrong
+        memcpy(m_transfer.p_data, &spi_rx_buffer[1], m_transfer.length);
     }
+    transfer_finish(NRF_SUCCESS);
 }
 
 
 
-/**
- * @brief SPI initialization.
- * Just the usual way. Nothing special here
+/**@brief Function for initializing the SPI driver.
+ * CS is driven by this file and not by the SPI driver, so it can stay low across the two
+ * transfers of a direct read.
  */
-uint32_t nrf_drv_mpu_init(void)
+static uint32_t spi_init(void)
 {
-    
-    const nrf_drv_spi_config_t spi_mpu_config = {                                                            \
-        .sck_pin      = MPU_SPI_SCL_PIN, 
+    const nrf_drv_spi_config_t spi_mpu_config = {
+        .sck_pin      = MPU_SPI_SCL_PIN,
         .mosi_pin     = MPU_SPI_MOSI_PIN,
         .miso_pin     = MPU_SPI_MISO_PIN,
-        .ss_pin       = MPU_SPI_CS_PIN,
-        .irq_priority = APP_IRQ_PRIORITY_HIGH, 
-        .orc          = 0xFF,                                    
-        .frequency    = NRF_DRV_SPI_FREQ_1M,                     
-        .mode         = NRF_DRV_SPI_MODE_0,                      
-        .bit_order    = NRF_DRV_SPI_BIT_ORDER_MSB_FIRST,         
+        .ss_pin       = NRF_DRV_SPI_PIN_NOT_USED,
+        .irq_priority = APP_IRQ_PRIORITY_HIGH,
+        .orc          = 0xFF,
+        .frequency    = MPU_SPI_FREQ_CONFIG,
+        .mode         = NRF_DRV_SPI_MODE_0,
+        .bit_order    = NRF_DRV_SPI_BIT_ORDER_MSB_FIRST,
     };
-    
-    return nrf_drv_spi_init(&m_spi_instance, &spi_mpu_config, nrf_drv_mpu_spi_event_handler);  
+
+    return nrf_drv_spi_init(&m_spi_instance, &spi_mpu_config, nrf_drv_mpu_spi_event_handler);
+}
+
+
+
+/**@brief Function for giving up on a transfer that did not finish.
+ * The SPI driver of this SDK has no abort, so the peripheral is stopped by uninitializing the
+ * driver, which also drops its own transfer in progress, and initialized again. CS is raised
+ * so the MPU starts the next transaction from a register byte.
+ */
+static uint32_t transfer_abort(void)
+{
+    nrf_drv_spi_uninit(&m_spi_instance);
+    nrf_gpio_pin_set(m_transfer.cs_pin);
+    m_transfer.p_direct    = NULL;
+    m_transfer.in_progress = false;
+    return spi_init();
+}
+
+
+
+static uint32_t transfer_wait(void)
+{
+    uint32_t timeout = MPU_SPI_TIMEOUT;
+    uint32_t err_code;
+
+    while(m_transfer.in_progress && --timeout);
+    if(m_transfer.in_progress)
+    {
+        // Otherwise every later transfer is turned away as busy, with the MPU selected
+        err_code = transfer_abort();
+        return (err_code != NRF_SUCCESS) ? err_code : NRF_ERROR_TIMEOUT;
+    }
+    return m_transfer.result;
+}
+
+
+
+uint32_t nrf_drv_mpu_init(void)
+{
+    nrf_gpio_pin_set(MPU_SPI_CS_PIN);
+    nrf_gpio_cfg_output(MPU_SPI_CS_PIN);
+    memset(&m_transfer, 0, sizeof(m_transfer));
+
+    return spi_init();
+}
+
+
+
+uint32_t nrf_drv_mpu_uninit(void)
+{
+    nrf_drv_spi_uninit(&m_spi_instance);
+    return NRF_SUCCESS;
 }
 
 
@@ -94,81 +258,320 @@ static void merge_register_and_data(uint8_t * new_buffer, uint8_t reg, uint8_t *
 }
 
 
-/**@brief Function to write a series of bytes. The function merges 
- * the register and the data.
+
+/**@brief Function to start a write. p_data is copied, so it can be reused when the function returns
  */
-uint32_t nrf_drv_mpu_write_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
+static uint32_t write_start(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length,
+                            nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
 {
     uint32_t err_code;
-    
+
     if(length > MPU_SPI_BUFFER_SIZE - 1) // Must be space for register byte in buffer
     {
         return NRF_ERROR_DATA_SIZE;
     }
-    
-    uint32_t timeout = MPU_SPI_TIMEOUT;
-    // Add write bit to register. 
-    reg = reg | MPU_SPI_WRITE_BIT;
-    
-    merge_register_and_data(spi_tx_buffer, reg, p_data, length + 1);
-    
+    if(busy())
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    m_transfer.evt_handler = evt_handler;
+    m_transfer.p_context   = p_context;
+    m_transfer.p_data      = NULL;
+    m_transfer.p_direct    = NULL;
+    m_transfer.length      = 0;
+    m_transfer.cs_pin      = dev;
+    m_transfer.in_progress = true;
+
+    merge_register_and_data(spi_tx_buffer, reg | MPU_SPI_WRITE_BIT, p_data, length);
+
+    frequency_set(MPU_SPI_FREQ_CONFIG);
+    nrf_gpio_pin_clear(dev);
     err_code = nrf_drv_spi_transfer(&m_spi_instance, spi_tx_buffer, length + 1, NULL, 0);
-    if(err_code != NRF_SUCCESS) return err_code;
+    if(err_code != NRF_SUCCESS)
+    {
+        nrf_gpio_pin_set(dev);
+        m_transfer.in_progress = false;
+    }
+    return err_code;
+}
 
 
-    while((!spi_tx_done) && --timeout);
-    if(!timeout) return NRF_ERROR_TIMEOUT;
-    spi_tx_done = false;
 
+/**@brief Function to start a read. Reads that fit in spi_rx_buffer are copied from it,
+ * longer reads go directly into p_data.
+ */
+static uint32_t read_start(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length,
+                           nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    uint32_t err_code;
+    bool     direct = (length > MPU_SPI_BUFFER_SIZE - 1);
+
+    if(length == 0 || length > MPU_MAX_READ_LENGTH)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+    if(busy())
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    m_transfer.evt_handler = evt_handler;
+    m_transfer.p_context   = p_context;
+    m_transfer.p_data      = direct ? NULL : p_data;
+    m_transfer.p_direct    = direct ? p_data : NULL;
+    m_transfer.length      = length;
+    m_transfer.cs_pin      = dev;
+    m_transfer.in_progress = true;
+
+    spi_tx_buffer[0] = reg | MPU_SPI_READ_BIT;
+
+    frequency_set(read_frequency_get(reg, length));
+    nrf_gpio_pin_clear(dev);
+    if(direct)
+    {
+        err_code = nrf_drv_spi_transfer(&m_spi_instance, spi_tx_buffer, 1, NULL, 0);
+    }
+    else
+    {
+        // Length + 1 because register byte has to be clocked out before MPU returns data of length 'length'
+        err_code = nrf_drv_spi_transfer(&m_spi_instance, spi_tx_buffer, 1, spi_rx_buffer, length + 1);
+    }
+    if(err_code != NRF_SUCCESS)
+    {
+        nrf_gpio_pin_set(dev);
+        m_transfer.in_progress = false;
+    }
     return err_code;
 }
 
-uint32_t nrf_drv_mpu_write_single_register(uint8_t reg, uint8_t data)
+
+uint32_t nrf_drv_mpu_dev_init(nrf_drv_mpu_dev_t dev)
+{
+    nrf_gpio_pin_set(dev);
+    nrf_gpio_cfg_output(dev);
+    return NRF_SUCCESS;
+}
+
+
+
+/**@brief Function to write a series of bytes. The function merges 
+ * the register and the data.
+ */
+uint32_t nrf_drv_mpu_dev_write_registers(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length)
 {
     uint32_t err_code;
-    uint32_t timeout = MPU_SPI_TIMEOUT;
 
-    uint8_t packet[2] = {reg, data};
+    err_code = write_start(dev, reg, p_data, length, NULL, NULL);
+    if(err_code != NRF_SUCCESS) return err_code;
 
-    // Add write bit to register. 
-    reg = reg | MPU_SPI_WRITE_BIT;
-    
-    err_code = nrf_drv_spi_transfer(&m_spi_instance, packet, 2, NULL, 0);
+    return transfer_wait();
+}
+
+
+uint32_t nrf_drv_mpu_dev_read_registers(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    uint32_t err_code;
+
+    err_code = read_start(dev, reg, p_data, length, NULL, NULL);
     if(err_code != NRF_SUCCESS) return err_code;
 
-    while((!spi_tx_done) && --timeout);
-    if(!timeout) return NRF_ERROR_TIMEOUT;
+    return transfer_wait();
+}
 
-    spi_tx_done = false;
 
-    return err_code;
+uint32_t nrf_drv_mpu_dev_read_registers_async(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length,
+                                              nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return read_start(dev, reg, p_data, length, evt_handler, p_context);
+}
+
+
+uint32_t nrf_drv_mpu_dev_write_registers_async(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length,
+                                               nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return write_start(dev, reg, p_data, length, evt_handler, p_context);
+}
+
+
+
+uint32_t nrf_drv_mpu_write_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    return nrf_drv_mpu_dev_write_registers(NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length);
+}
+
+uint32_t nrf_drv_mpu_write_single_register(uint8_t reg, uint8_t data)
+{
+    return nrf_drv_mpu_dev_write_registers(NRF_DRV_MPU_DEV_DEFAULT, reg, &data, 1);
 }
 
 
 uint32_t nrf_drv_mpu_read_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    return nrf_drv_mpu_dev_read_registers(NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length);
+}
+
+
+uint32_t nrf_drv_mpu_read_registers_async(uint8_t reg, uint8_t * p_data, uint32_t length,
+                                          nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return nrf_drv_mpu_dev_read_registers_async(NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length, evt_handler, p_context);
+}
+
+
+uint32_t nrf_drv_mpu_write_registers_async(uint8_t reg, uint8_t * p_data, uint32_t length,
+                                           nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return nrf_drv_mpu_dev_write_registers_async(NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length, evt_handler, p_context);
+}
+
+
+
+#if MPU_SPI_USES_EASY_DMA
+/**@brief Function for handing CS back to GPIO and freeing the PPI channels of the trigger
+ *
+ * @param[in]   ppi_start       Whether m_trigger.ppi_start is allocated
+ * @param[in]   ppi_end         Whether m_trigger.ppi_end is allocated
+ */
+static void trigger_release(bool ppi_start, bool ppi_end)
+{
+    if(ppi_start)
+    {
+        (void)nrf_drv_ppi_channel_disable(m_trigger.ppi_start);
+        (void)nrf_drv_ppi_channel_free(m_trigger.ppi_start);
+    }
+    if(ppi_end)
+    {
+        (void)nrf_drv_ppi_channel_disable(m_trigger.ppi_end);
+        (void)nrf_drv_ppi_channel_free(m_trigger.ppi_end);
+    }
+
+    nrf_drv_gpiote_out_uninit(MPU_SPI_CS_PIN);
+    nrf_gpio_pin_set(MPU_SPI_CS_PIN);
+    nrf_gpio_cfg_output(MPU_SPI_CS_PIN);
+}
+
+
+
+/**@brief Function for setting up the PPI channels of the trigger, and then the transfer they start
+ *
+ * @param[in]   trigger_event   Event that starts a read
+ * @param[out]  p_ppi_start     Whether m_trigger.ppi_start was allocated
+ * @param[out]  p_ppi_end       Whether m_trigger.ppi_end was allocated
+ * @retval      uint32_t        Error code
+ */
+static uint32_t trigger_setup(uint32_t trigger_event, bool * p_ppi_start, bool * p_ppi_end)
 {
     uint32_t err_code;
-    uint32_t timeout = MPU_SPI_TIMEOUT;
-    
-    // Add read bit to register. 
-    reg = reg | MPU_SPI_READ_BIT;
-	
-    // Read data over SPI and store incomming data in spi_rx_buffer
-    err_code = nrf_drv_spi_transfer(&m_spi_instance, &reg, 1, spi_rx_buffer, length + 1); // Length + 1 because register byte has to be clocked out before MPU returns data of length 'length'
+
+    // Ignore error if the PPI driver is already initialized
+    err_code = nrf_drv_ppi_init();
+    if(err_code != NRF_SUCCESS && err_code != NRF_ERROR_MODULE_ALREADY_INITIALIZED) return err_code;
+
+    err_code = nrf_drv_ppi_channel_alloc(&m_trigger.ppi_start);
+    if(err_code != NRF_SUCCESS) return err_code;
+    *p_ppi_start = true;
+    err_code = nrf_drv_ppi_channel_assign(m_trigger.ppi_start, trigger_event,
+                                          nrf_drv_gpiote_clr_task_addr_get(MPU_SPI_CS_PIN));
+    if(err_code != NRF_SUCCESS) return err_code;
+    err_code = nrf_drv_ppi_channel_fork_assign(m_trigger.ppi_start, nrf_drv_spi_start_task_get(&m_spi_instance));
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    err_code = nrf_drv_ppi_channel_alloc(&m_trigger.ppi_end);
+    if(err_code != NRF_SUCCESS) return err_code;
+    *p_ppi_end = true;
+    err_code = nrf_drv_ppi_channel_assign(m_trigger.ppi_end, nrf_drv_spi_end_event_get(&m_spi_instance),
+                                          nrf_drv_gpiote_set_task_addr_get(MPU_SPI_CS_PIN));
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    nrf_drv_spi_xfer_desc_t xfer = NRF_DRV_SPI_XFER_TRX(m_trigger.tx_buffer, 1, m_trigger.p_buffer, m_trigger.length + 1);
+
+    uint32_t flags =    NRF_DRV_SPI_FLAG_NO_XFER_EVT_HANDLER    | // Don't wake the CPU after each read
+                        NRF_DRV_SPI_FLAG_HOLD_XFER              | // Started by PPI
+                        NRF_DRV_SPI_FLAG_RX_POSTINC             | // ArrayList. Move RX pointer one read after each read
+                        NRF_DRV_SPI_FLAG_REPEATED_XFER;
+
+    err_code = nrf_drv_spi_xfer(&m_spi_instance, &xfer, flags);
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    err_code = nrf_drv_ppi_channel_enable(m_trigger.ppi_end);
+    if(err_code != NRF_SUCCESS) return err_code;
+    return nrf_drv_ppi_channel_enable(m_trigger.ppi_start);
+}
+
+
+
+uint32_t nrf_drv_mpu_trigger_enable(uint32_t trigger_event, uint8_t reg, uint8_t * p_buffer, uint8_t length)
+{
+    uint32_t err_code;
+    bool     ppi_start = false;
+    bool     ppi_end   = false;
+
+    if(p_buffer == NULL) return NRF_ERROR_NULL;
+    if(length == 0 || length == UINT8_MAX) return NRF_ERROR_DATA_SIZE; // The register byte slot makes it length + 1
+    if(busy()) return NRF_ERROR_BUSY;
+
+    m_trigger.tx_buffer[0] = reg | MPU_SPI_READ_BIT;
+    m_trigger.p_buffer     = p_buffer;
+    m_trigger.length       = length;
+
+    // CS is handed to GPIOTE, so PPI can pull it low with the start and release it at the end
+    if(!nrf_drv_gpiote_is_init())
+    {
+        err_code = nrf_drv_gpiote_init();
+        if(err_code != NRF_SUCCESS) return err_code;
+    }
+    nrf_drv_gpiote_out_config_t cs_config = GPIOTE_CONFIG_OUT_TASK_TOGGLE(true);
+    err_code = nrf_drv_gpiote_out_init(MPU_SPI_CS_PIN, &cs_config);
     if(err_code != NRF_SUCCESS) return err_code;
+    nrf_drv_gpiote_out_task_enable(MPU_SPI_CS_PIN);
 
-    while((!spi_tx_done) && --timeout);
-    if(!timeout) return NRF_ERROR_TIMEOUT;
-    spi_tx_done = false;
-	
-	// Copy data in spi_rx_buffer over to p_data
-	memcpy(p_data, &spi_rx_buffer[1], length);
+    frequency_set(read_frequency_get(reg, length));
+    err_code = trigger_setup(trigger_event, &ppi_start, &ppi_end);
+    if(err_code != NRF_SUCCESS)
+    {
+        // Nothing is left allocated, and CS is back on GPIO, so the blocking functions work again
+        trigger_release(ppi_start, ppi_end);
+        return err_code;
+    }
 
+    m_trigger.enabled = true;
     return NRF_SUCCESS;
 }
 
 
 
+void nrf_drv_mpu_trigger_rewind(void)
+{
+    // RXD.PTR is double buffered, so a read in progress is not affected
+    nrf_spim_rx_buffer_set((NRF_SPIM_Type *)m_spi_instance.p_registers, m_trigger.p_buffer, m_trigger.length + 1);
+}
+
+
+
+uint32_t nrf_drv_mpu_trigger_end_event_get(void)
+{
+    return nrf_drv_spi_end_event_get(&m_spi_instance);
+}
+
+
+
+void nrf_drv_mpu_trigger_disable(void)
+{
+    if(!m_trigger.enabled) return;
+
+    (void)nrf_drv_ppi_channel_disable(m_trigger.ppi_start);
+
+    // Let a read in progress finish and release CS. 8 us per byte at the slowest clock
+    nrf_delay_us((m_trigger.length + 2) * 8);
+
+    trigger_release(true, true);
+    m_trigger.enabled = false;
+}
+#endif // MPU_SPI_USES_EASY_DMA
+
+
+
 /**
   @}
 */
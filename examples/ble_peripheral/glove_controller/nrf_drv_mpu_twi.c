@@ -8,175 +8,282 @@
 #include <stdint.h>
 #include <string.h>
 #include "nrf_drv_twi.h"
+#include "app_twi.h"
 #include "nrf_drv_mpu.h"
 #include "app_util_platform.h"
 #include "nrf_gpio.h"
 
-/* Pins to connect MPU. Pinout is different for nRF51 DK and nRF52 DK
- * and therefore I have added a conditional statement defining different pins
- * for each board. This is only for my own convenience. 
+#define MPU_TWI_BUFFER_SIZE     	14 // 14 byte buffers will suffice to read acceleromter, gyroscope and temperature data in one transmission.
+#define MPU_TWI_QUEUE_SIZE          8  // Maximum number of transactions that can be pending in the app_twi queue at the same time.
+
+
+/**@brief Storage for one queued transaction.
+ * app_twi only keeps pointers to the descriptors, so they have to live
+ * until the transaction is finished.
  */
-#if defined(BOARD_PCA10040)
-#define MPU_TWI_SCL_PIN 3
-#define MPU_TWI_SDA_PIN 4
-#else
-#define MPU_TWI_SCL_PIN 1
-#define MPU_TWI_SDA_PIN 2
-#endif
+typedef struct
+{
+    app_twi_transaction_t       transaction;
+    app_twi_transfer_t          transfers[2];
+    uint8_t                     buffer[MPU_TWI_BUFFER_SIZE + 1];    // Register address, followed by data if writing
+    nrf_drv_mpu_evt_handler_t   evt_handler;
+    void                      * p_context;
+    bool                        in_use;
+}mpu_twi_transaction_t;
 
 
-#define MPU_TWI_BUFFER_SIZE     	14 // 14 byte buffers will suffice to read acceleromter, gyroscope and temperature data in one transmission.
-#define MPU_TWI_TIMEOUT 			10000 
-#define MPU_ADDRESS     			0x68 
-#define MPU_AK89XX_MAGN_ADDRESS     0x0C
+static app_twi_t m_app_twi = APP_TWI_INSTANCE(0);
+static mpu_twi_transaction_t m_transactions[MPU_TWI_QUEUE_SIZE];
+
+
+
+/**@brief Callback from app_twi. Releases the transaction slot before the user is
+ * notified so that the user can schedule a new transaction from the callback.
+ */
+static void nrf_drv_mpu_twi_transaction_callback(ret_code_t result, void * p_user_data)
+{
+    mpu_twi_transaction_t * p_trans = (mpu_twi_transaction_t *)p_user_data;
+    nrf_drv_mpu_evt_handler_t evt_handler = p_trans->evt_handler;
+    void * p_context = p_trans->p_context;
 
+    p_trans->in_use = false;
 
-static const nrf_drv_twi_t m_twi_instance = NRF_DRV_TWI_INSTANCE(0);
-volatile static bool twi_tx_done = false;
-volatile static bool twi_rx_done = false;
+    if(evt_handler != NULL)
+    {
+        evt_handler(result, p_context);
+    }
+}
 
-uint8_t twi_tx_buffer[MPU_TWI_BUFFER_SIZE];
 
 
-static void nrf_drv_mpu_twi_event_handler(nrf_drv_twi_evt_t const * p_event, void * p_context)
+static mpu_twi_transaction_t * transaction_alloc(nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
 {
-    switch(p_event->type)
+    mpu_twi_transaction_t * p_trans = NULL;
+
+    CRITICAL_REGION_ENTER();
+    for(uint8_t i = 0; i < MPU_TWI_QUEUE_SIZE; i++)
     {
-        case NRF_DRV_TWI_EVT_DONE:
-            switch(p_event->xfer_desc.type)
-            {
-                case NRF_DRV_TWI_XFER_TX:
-                    twi_tx_done = true;
-                    break;
-                case NRF_DRV_TWI_XFER_TXTX:
-                    twi_tx_done = true;
-                    break;
-                case NRF_DRV_TWI_XFER_RX:
-                    twi_rx_done = true;
-                    break;
-                case NRF_DRV_TWI_XFER_TXRX:
-                    twi_rx_done = true;
-                    break;
-                default:
-                    break;
-            }
-            break;
-        case NRF_DRV_TWI_EVT_ADDRESS_NACK:
-            break;
-        case NRF_DRV_TWI_EVT_DATA_NACK:
-            break;
-        default:
+        if(!m_transactions[i].in_use)
+        {
+            p_trans = &m_transactions[i];
+            p_trans->in_use = true;
             break;
+        }
+    }
+    CRITICAL_REGION_EXIT();
+
+    if(p_trans != NULL)
+    {
+        p_trans->evt_handler                     = evt_handler;
+        p_trans->p_context                       = p_context;
+        p_trans->transaction.callback            = nrf_drv_mpu_twi_transaction_callback;
+        p_trans->transaction.p_user_data         = p_trans;
+        p_trans->transaction.p_transfers         = p_trans->transfers;
+    }
+    return p_trans;
+}
+
+
+
+static uint32_t transaction_schedule(mpu_twi_transaction_t * p_trans)
+{
+    uint32_t err_code = app_twi_schedule(&m_app_twi, &p_trans->transaction);
+    if(err_code != NRF_SUCCESS)
+    {
+        p_trans->in_use = false;
+    }
+    return err_code;
+}
+
+
+
+static uint32_t schedule_read(uint8_t address, uint8_t reg, uint8_t * p_data, uint32_t length,
+                              nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    if(length == 0 || length > UINT8_MAX) // app_twi transfers are limited to 255 bytes
+    {
+        return NRF_ERROR_INVALID_LENGTH;
     }
+
+    mpu_twi_transaction_t * p_trans = transaction_alloc(evt_handler, p_context);
+    if(p_trans == NULL) return NRF_ERROR_BUSY;
+
+    p_trans->buffer[0] = reg;
+
+    // Register address write followed by a repeated start and the read
+    app_twi_transfer_t const transfers[2] =
+    {
+        APP_TWI_WRITE(address, p_trans->buffer, 1, APP_TWI_NO_STOP),
+        APP_TWI_READ(address, p_data, length, 0)
+    };
+    memcpy(p_trans->transfers, transfers, sizeof(transfers));
+    p_trans->transaction.number_of_transfers = 2;
+
+    return transaction_schedule(p_trans);
+}
+
+
+
+static uint32_t schedule_write(uint8_t address, uint8_t reg, uint8_t * p_data, uint32_t length,
+                               nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    if(length > MPU_TWI_BUFFER_SIZE) // Must be space for the data behind the register byte
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    mpu_twi_transaction_t * p_trans = transaction_alloc(evt_handler, p_context);
+    if(p_trans == NULL) return NRF_ERROR_BUSY;
+
+    // The TWI driver is not able to do two transmits without repeating the ADDRESS + Write bit byte
+    // Hence we need to merge the MPU register address with the buffer and then transmit all as one transmission
+    p_trans->buffer[0] = reg;
+    memcpy(&p_trans->buffer[1], p_data, length);
+
+    app_twi_transfer_t const transfer = APP_TWI_WRITE(address, p_trans->buffer, length + 1, 0);
+    p_trans->transfers[0] = transfer;
+    p_trans->transaction.number_of_transfers = 1;
+
+    return transaction_schedule(p_trans);
+}
+
+
+
+/**@brief Function for performing a register read or write and waiting for it to finish.
+ * Used for configuration where the caller needs the result before continuing.
+ */
+static uint32_t perform_read(uint8_t address, uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    if(length == 0 || length > UINT8_MAX)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    app_twi_transfer_t const transfers[2] =
+    {
+        APP_TWI_WRITE(address, &reg, 1, APP_TWI_NO_STOP),
+        APP_TWI_READ(address, p_data, length, 0)
+    };
+    return app_twi_perform(&m_app_twi, transfers, 2, NULL);
+}
+
+
+
+static uint32_t perform_write(uint8_t address, uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    uint8_t buffer[MPU_TWI_BUFFER_SIZE + 1];
+
+    if(length > MPU_TWI_BUFFER_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    buffer[0] = reg;
+    memcpy(&buffer[1], p_data, length);
+
+    app_twi_transfer_t const transfer = APP_TWI_WRITE(address, buffer, length + 1, 0);
+    return app_twi_perform(&m_app_twi, &transfer, 1, NULL);
 }
 
 
 
 /**
  * @brief TWI initialization.
- * Just the usual way. Nothing special here
+ * The TWI driver is handed over to the app_twi transaction manager, which
+ * queues transactions and runs them back to back from the TWI interrupt.
  */
 uint32_t nrf_drv_mpu_init(void)
 {
     uint32_t err_code;
-    
+
     const nrf_drv_twi_config_t twi_mpu_config = {
        .scl                = MPU_TWI_SCL_PIN,
        .sda                = MPU_TWI_SDA_PIN,
        .frequency          = NRF_TWI_FREQ_400K,
        .interrupt_priority = APP_IRQ_PRIORITY_HIGHEST
     };
-    
-    err_code = nrf_drv_twi_init(&m_twi_instance, &twi_mpu_config, nrf_drv_mpu_twi_event_handler, NULL);
-    if(err_code != NRF_SUCCESS)
-	{
-		return err_code;
-	}
-    
-    nrf_drv_twi_enable(&m_twi_instance);
-	
-	return NRF_SUCCESS;
-}
 
+    APP_TWI_INIT(&m_app_twi, &twi_mpu_config, MPU_TWI_QUEUE_SIZE, err_code);
 
+	return err_code;
+}
 
 
-// The TWI driver is not able to do two transmits without repeating the ADDRESS + Write bit byte
-// Hence we need to merge the MPU register address with the buffer and then transmit all as one transmission
-static void merge_register_and_data(uint8_t * new_buffer, uint8_t reg, uint8_t * p_data, uint32_t length)
+
+/**
+ * @brief Release the TWI instance and pins so they can be taken over by another driver.
+ * Pending transactions are aborted.
+ */
+uint32_t nrf_drv_mpu_uninit(void)
 {
-    new_buffer[0] = reg;
-    memcpy((new_buffer + 1), p_data, length);
+    app_twi_uninit(&m_app_twi);
+    return NRF_SUCCESS;
 }
 
 
-uint32_t nrf_drv_mpu_write_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
+
+uint32_t nrf_drv_mpu_dev_init(nrf_drv_mpu_dev_t dev)
 {
-    // This burst write function is not optimal and needs improvement.
-    // The new SDK 11 TWI driver is not able to do two transmits without repeating the ADDRESS + Write bit byte
-    uint32_t err_code;
-    uint32_t timeout = MPU_TWI_TIMEOUT;
+    return NRF_SUCCESS;
+}
 
-    // Merging MPU register address and p_data into one buffer.
-    merge_register_and_data(twi_tx_buffer, reg, p_data, length);
 
-    // Setting up transfer
-    nrf_drv_twi_xfer_desc_t xfer_desc;
-    xfer_desc.address = MPU_ADDRESS;
-    xfer_desc.type = NRF_DRV_TWI_XFER_TX;
-    xfer_desc.primary_length = length + 1;
-    xfer_desc.p_primary_buf = twi_tx_buffer;
 
-    // Transferring
-    err_code = nrf_drv_twi_xfer(&m_twi_instance, &xfer_desc, 0);
+uint32_t nrf_drv_mpu_dev_write_registers(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    return perform_write(dev, reg, p_data, length);
+}
 
-    while((!twi_tx_done) && --timeout);
-    if(!timeout) return NRF_ERROR_TIMEOUT;
-    twi_tx_done = false;
 
-    return err_code;
+uint32_t nrf_drv_mpu_dev_read_registers(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    return perform_read(dev, reg, p_data, length);
 }
 
-uint32_t nrf_drv_mpu_write_single_register(uint8_t reg, uint8_t data)
+
+uint32_t nrf_drv_mpu_dev_read_registers_async(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length,
+                                              nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
 {
-    uint32_t err_code;
-    uint32_t timeout = MPU_TWI_TIMEOUT;
+    return schedule_read(dev, reg, p_data, length, evt_handler, p_context);
+}
 
-    uint8_t packet[2] = {reg, data};
 
-    err_code = nrf_drv_twi_tx(&m_twi_instance, MPU_ADDRESS, packet, 2, false);
-    if(err_code != NRF_SUCCESS) return err_code;
+uint32_t nrf_drv_mpu_dev_write_registers_async(nrf_drv_mpu_dev_t dev, uint8_t reg, uint8_t * p_data, uint32_t length,
+                                               nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return schedule_write(dev, reg, p_data, length, evt_handler, p_context);
+}
 
-    while((!twi_tx_done) && --timeout);
-    if(!timeout) return NRF_ERROR_TIMEOUT;
 
-    twi_tx_done = false;
 
-    return err_code;
+uint32_t nrf_drv_mpu_write_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    return perform_write(NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length);
+}
+
+uint32_t nrf_drv_mpu_write_single_register(uint8_t reg, uint8_t data)
+{
+    return perform_write(NRF_DRV_MPU_DEV_DEFAULT, reg, &data, 1);
 }
 
 
 uint32_t nrf_drv_mpu_read_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
 {
-    uint32_t err_code;
-    uint32_t timeout = MPU_TWI_TIMEOUT;
-
-    err_code = nrf_drv_twi_tx(&m_twi_instance, MPU_ADDRESS, &reg, 1, false);
-    if(err_code != NRF_SUCCESS) return err_code;
+    return perform_read(NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length);
+}
 
-    while((!twi_tx_done) && --timeout);
-    if(!timeout) return NRF_ERROR_TIMEOUT;
-    twi_tx_done = false;
 
-    err_code = nrf_drv_twi_rx(&m_twi_instance, MPU_ADDRESS, p_data, length);
-    if(err_code != NRF_SUCCESS) return err_code;
+uint32_t nrf_drv_mpu_read_registers_async(uint8_t reg, uint8_t * p_data, uint32_t length,
+                                          nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return schedule_read(NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length, evt_handler, p_context);
+}
 
-    timeout = MPU_TWI_TIMEOUT;
-    while((!twi_rx_done) && --timeout);
-    if(!timeout) return NRF_ERROR_TIMEOUT;
-    twi_rx_done = false;
 
-    return err_code;
+uint32_t nrf_drv_mpu_write_registers_async(uint8_t reg, uint8_t * p_data, uint32_t length,
+                                           nrf_drv_mpu_evt_handler_t evt_handler, void * p_context)
+{
+    return schedule_write(NRF_DRV_MPU_DEV_DEFAULT, reg, p_data, length, evt_handler, p_context);
 }
 
 
@@ -185,44 +292,13 @@ uint32_t nrf_drv_mpu_read_registers(uint8_t reg, uint8_t * p_data, uint32_t leng
 
 uint32_t nrf_drv_mpu_read_magnetometer_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
 {
-    uint32_t err_code;
-    uint32_t timeout = MPU_TWI_TIMEOUT;
-
-    err_code = nrf_drv_twi_tx(&m_twi_instance, MPU_AK89XX_MAGN_ADDRESS, &reg, 1, false);
-    if(err_code != NRF_SUCCESS) return err_code;
-
-    while((!twi_tx_done) && --timeout);
-    if(!timeout) return NRF_ERROR_TIMEOUT;
-    twi_tx_done = false;
-
-    err_code = nrf_drv_twi_rx(&m_twi_instance, MPU_AK89XX_MAGN_ADDRESS, p_data, length);
-    if(err_code != NRF_SUCCESS) return err_code;
-
-    timeout = MPU_TWI_TIMEOUT;
-    while((!twi_rx_done) && --timeout);
-    if(!timeout) return NRF_ERROR_TIMEOUT;
-    twi_rx_done = false;
-
-    return err_code;
+    return perform_read(MPU_AK89XX_MAGN_ADDRESS, reg, p_data, length);
 }
 
 
 uint32_t nrf_drv_mpu_write_magnetometer_register(uint8_t reg, uint8_t data)
 {
-    uint32_t err_code;
-    uint32_t timeout = MPU_TWI_TIMEOUT;
-
-    uint8_t packet[2] = {reg, data};
-
-    err_code = nrf_drv_twi_tx(&m_twi_instance, MPU_AK89XX_MAGN_ADDRESS, packet, 2, false);
-    if(err_code != NRF_SUCCESS) return err_code;
-
-    while((!twi_tx_done) && --timeout);
-    if(!timeout) return NRF_ERROR_TIMEOUT;
-
-    twi_tx_done = false;
-
-    return err_code;
+    return perform_write(MPU_AK89XX_MAGN_ADDRESS, reg, &data, 1);
 }
 
 #endif // (defined(MPU9150) || defined(MPU9255)) && (TWI_COUNT >= 1) // Magnetometer only works with TWI so check if TWI is enabled
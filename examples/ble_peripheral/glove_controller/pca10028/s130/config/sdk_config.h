@@ -30,6 +30,22 @@
 #define BLE_RACP_ENABLED 0
 #endif
 
+// <e> NRF_BLE_GATT_ENABLED - nrf_ble_gatt - GATT module
+//==========================================================
+#ifndef NRF_BLE_GATT_ENABLED
+#define NRF_BLE_GATT_ENABLED 1
+#endif
+#if  NRF_BLE_GATT_ENABLED
+// <o> NRF_BLE_GATT_MAX_MTU_SIZE - Static maximum MTU size that is passed to the ble_enable function. 
+// <i> S130 only supports the default ATT MTU of 23. S132 supports up to 247.
+
+#ifndef NRF_BLE_GATT_MAX_MTU_SIZE
+#define NRF_BLE_GATT_MAX_MTU_SIZE 23
+#endif
+
+#endif //NRF_BLE_GATT_ENABLED
+// </e>
+
 // <q> NRF_BLE_QWR_ENABLED  - nrf_ble_qwr - Queued writes support module (prepare/execute write)
  
 
@@ -110,7 +126,7 @@
  
 
 #ifndef BLE_HIDS_ENABLED
-#define BLE_HIDS_ENABLED 0
+#define BLE_HIDS_ENABLED 1
 #endif
 
 // <e> BLE_HRS_C_ENABLED - ble_hrs_c - Heart Rate Service Client
@@ -220,7 +236,7 @@
 // <e> ADC_ENABLED - nrf_drv_adc - Driver for ADC peripheral (nRF51)
 //==========================================================
 #ifndef ADC_ENABLED
-#define ADC_ENABLED 0
+#define ADC_ENABLED 1
 #endif
 #if  ADC_ENABLED
 // <o> ADC_CONFIG_IRQ_PRIORITY  - Interrupt priority
@@ -1254,7 +1270,7 @@
 // <e> PPI_ENABLED - nrf_drv_ppi - PPI peripheral driver
 //==========================================================
 #ifndef PPI_ENABLED
-#define PPI_ENABLED 0
+#define PPI_ENABLED 1
 #endif
 #if  PPI_ENABLED
 // <e> PPI_CONFIG_LOG_ENABLED - Enables logging in the module.
@@ -2246,7 +2262,7 @@
 // <e> TIMER_ENABLED - nrf_drv_timer - TIMER periperal driver
 //==========================================================
 #ifndef TIMER_ENABLED
-#define TIMER_ENABLED 0
+#define TIMER_ENABLED 1
 #endif
 #if  TIMER_ENABLED
 // <o> TIMER_DEFAULT_CONFIG_FREQUENCY  - Timer frequency if in Timer mode
@@ -2310,7 +2326,7 @@
  
 
 #ifndef TIMER1_ENABLED
-#define TIMER1_ENABLED 0
+#define TIMER1_ENABLED 1
 #endif
 
 // <q> TIMER2_ENABLED  - Enable TIMER2 instance
@@ -3110,7 +3126,7 @@
  
 
 #ifndef APP_TWI_ENABLED
-#define APP_TWI_ENABLED 0
+#define APP_TWI_ENABLED 1
 #endif
 
 // <e> APP_UART_ENABLED - app_uart - UART driver
@@ -3172,19 +3188,47 @@
 #define BUTTON_ENABLED 1
 #endif
 
-// <q> CRC16_ENABLED  - crc16 - CRC16 calculation routines
- 
-
+// <e> CRC16_ENABLED - crc16 - CRC16 calculation routines
+//==========================================================
 #ifndef CRC16_ENABLED
 #define CRC16_ENABLED 1
 #endif
-
-// <q> CRC32_ENABLED  - crc32 - CRC32 calculation routines
+#if  CRC16_ENABLED
+// <o> CRC16_CONFIG_IMPLEMENTATION  - Implementation
  
 
+// <i> All give the same result. The tables trade flash for speed.
+// <0=> Bitwise 
+// <1=> Table (512 bytes) 
+// <2=> Slicing-by-4 (2048 bytes) 
+
+#ifndef CRC16_CONFIG_IMPLEMENTATION
+#define CRC16_CONFIG_IMPLEMENTATION 1
+#endif
+
+#endif //CRC16_ENABLED
+// </e>
+
+// <e> CRC32_ENABLED - crc32 - CRC32 calculation routines
+//==========================================================
 #ifndef CRC32_ENABLED
 #define CRC32_ENABLED 0
 #endif
+#if  CRC32_ENABLED
+// <o> CRC32_CONFIG_IMPLEMENTATION  - Implementation
+ 
+
+// <i> All give the same result. The tables trade flash for speed.
+// <0=> Bitwise 
+// <1=> Table (1024 bytes) 
+// <2=> Slicing-by-4 (4096 bytes) 
+
+#ifndef CRC32_CONFIG_IMPLEMENTATION
+#define CRC32_CONFIG_IMPLEMENTATION 0
+#endif
+
+#endif //CRC32_ENABLED
+// </e>
 
 // <q> ECC_ENABLED  - ecc - Elliptic Curve Cryptography Library
  
@@ -3238,6 +3282,35 @@
 #define FDS_VIRTUAL_PAGE_SIZE 256
 #endif
 
+// <o> FDS_INDEX_SIZE - Number of records in the RAM index. 
+// <i> Records searched by file ID are found in a RAM index instead of by
+// <i> scanning flash. Each record takes 8 bytes of RAM. 0 disables the index.
+
+#ifndef FDS_INDEX_SIZE
+#define FDS_INDEX_SIZE 32
+#endif
+
+// <o> FDS_GC_COPY_WORDS - Largest number of words copied by garbage collection in one flash operation. 
+#ifndef FDS_GC_COPY_WORDS
+#define FDS_GC_COPY_WORDS 16
+#endif
+
+// <q> FDS_GC_INCREMENTAL  - Let queued operations run during garbage collection
+ 
+
+// <i> Other operations run between pages, and writes between flash operations.
+
+#ifndef FDS_GC_INCREMENTAL
+#define FDS_GC_INCREMENTAL 1
+#endif
+
+// <o> FDS_GC_AUTO_PERCENT - Percentage of dirty words that starts garbage collection in the background. 
+// <i> Checked when a delete or update completes. 0 disables it.
+
+#ifndef FDS_GC_AUTO_PERCENT
+#define FDS_GC_AUTO_PERCENT 25
+#endif
+
 #endif //FDS_ENABLED
 // </e>
 
@@ -3463,6 +3536,22 @@
 #endif //MEM_MANAGER_ENABLED
 // </e>
 
+// <e> NRF_BALLOC_ENABLED - nrf_balloc - Block allocator module
+//==========================================================
+#ifndef NRF_BALLOC_ENABLED
+#define NRF_BALLOC_ENABLED 1
+#endif
+#if  NRF_BALLOC_ENABLED
+// <q> NRF_BALLOC_CONFIG_DEBUG_ENABLED  - Enables debug mode in the module.
+ 
+
+#ifndef NRF_BALLOC_CONFIG_DEBUG_ENABLED
+#define NRF_BALLOC_CONFIG_DEBUG_ENABLED 0
+#endif
+
+#endif //NRF_BALLOC_ENABLED
+// </e>
+
 // <e> NRF_CSENSE_ENABLED - nrf_csense - nrf_csense module
 //==========================================================
 #ifndef NRF_CSENSE_ENABLED
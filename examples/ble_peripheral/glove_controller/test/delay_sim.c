@@ -0,0 +1,29 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* nrf_delay for the tests on the simulated MPU: a delay moves the simulated time */
+
+#include <stdint.h>
+#include "nrf_delay.h"
+#include "nrf_drv_mpu_sim.h"
+
+
+
+void nrf_delay_ms(uint32_t ms)
+{
+    nrf_drv_mpu_sim_time_advance(ms * 1000);
+}
+
+
+
+void nrf_delay_us(uint32_t us)
+{
+    nrf_drv_mpu_sim_time_advance(us);
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,50 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* app_mpu_fusion.c built with APP_MPU_FUSION_USE_FLOAT, see fusion_float.h */
+
+#define APP_MPU_FUSION_USE_FLOAT        1
+#define app_mpu_fusion_init             float_fusion_init
+#define app_mpu_fusion_update           float_fusion_update
+#define app_mpu_fusion_update_burst     float_fusion_update_burst
+#define app_mpu_fusion_quat_get         float_fusion_quat_get
+
+#include "app_mpu_fusion.c"
+#include "fusion_float.h"
+
+static app_mpu_fusion_t m_fusion;
+
+
+
+uint32_t fusion_float_init(app_mpu_fusion_config_t const * p_config)
+{
+    return float_fusion_init(&m_fusion, p_config);
+}
+
+
+
+void fusion_float_update(accel_values_t const * p_accel, gyro_values_t const * p_gyro, int16_t const * p_magn)
+{
+    float_fusion_update(&m_fusion, p_accel, p_gyro, p_magn);
+}
+
+
+
+void fusion_float_update_burst(uint8_t const * p_burst, int16_t const * p_magn)
+{
+    float_fusion_update_burst(&m_fusion, p_burst, p_magn);
+}
+
+
+
+void fusion_float_quat_get(app_mpu_fusion_quat_t * p_quat)
+{
+    float_fusion_quat_get(&m_fusion, p_quat);
+}
+
+/**
+  @}
+*/
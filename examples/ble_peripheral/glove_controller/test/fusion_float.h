@@ -0,0 +1,30 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef FUSION_FLOAT_H__
+#define FUSION_FLOAT_H__
+
+/* The float path of app_mpu_fusion.c, as the nRF52 builds it, under other names so a test can run
+ * it next to the fixed point path of the nRF51. There is one filter, with the same functions as
+ * app_mpu_fusion.h less the state.
+ */
+
+#include <stdint.h>
+#include "app_mpu_fusion.h"
+
+uint32_t fusion_float_init(app_mpu_fusion_config_t const * p_config);
+
+void fusion_float_update(accel_values_t const * p_accel, gyro_values_t const * p_gyro, int16_t const * p_magn);
+
+void fusion_float_update_burst(uint8_t const * p_burst, int16_t const * p_magn);
+
+void fusion_float_quat_get(app_mpu_fusion_quat_t * p_quat);
+
+#endif /* FUSION_FLOAT_H__ */
+
+/**
+  @}
+*/
@@ -0,0 +1,294 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_twi.h"
+#include "nrf_delay.h"
+#include "sdk_errors.h"
+#include "mock_app_twi.h"
+
+typedef struct
+{
+    uint8_t     address;
+    uint8_t     regs[256];
+    uint8_t     pointer;                // Register address set by the last write
+}mock_device_t;
+
+typedef struct
+{
+    uint32_t                        time_us;
+    uint32_t                        bus_free_us;        // End of the transaction on the bus
+    bool                            bus_active;
+    app_twi_t                     * p_app_twi;
+    uint8_t                         head;
+    uint8_t                         count;
+    mock_device_t                   devices[MOCK_APP_TWI_DEVICES];
+    uint8_t                         device_count;
+    mock_app_twi_stats_t            stats;
+}mock_t;
+
+static mock_t m_mock;
+
+
+
+static mock_device_t * device_find(uint8_t address)
+{
+    for(uint8_t i = 0; i < m_mock.device_count; i++)
+    {
+        if(m_mock.devices[i].address == address) return &m_mock.devices[i];
+    }
+    return NULL;
+}
+
+
+
+static uint32_t transfer_time_us(app_twi_transfer_t const * p_transfer)
+{
+    uint32_t bits = (1 + p_transfer->length) * 9 + 2; // Slave address and data, start and stop
+
+    return (uint32_t)(((uint64_t)bits * 1000000 + MOCK_APP_TWI_BUS_HZ - 1) / MOCK_APP_TWI_BUS_HZ);
+}
+
+
+
+static uint32_t transaction_time_us(app_twi_transaction_t const * p_transaction)
+{
+    uint32_t time_us = 0;
+
+    for(uint8_t i = 0; i < p_transaction->number_of_transfers; i++)
+    {
+        time_us += transfer_time_us(&p_transaction->p_transfers[i]);
+    }
+    return time_us;
+}
+
+
+
+/**@brief Function for moving the data of a transaction and the statistics. Stops at the first NACK */
+static ret_code_t transaction_run(app_twi_transaction_t const * p_transaction)
+{
+    m_mock.stats.transactions++;
+    for(uint8_t i = 0; i < p_transaction->number_of_transfers; i++)
+    {
+        app_twi_transfer_t const * p_transfer = &p_transaction->p_transfers[i];
+        mock_device_t * p_device = device_find(APP_TWI_OP_ADDRESS(p_transfer->operation));
+
+        m_mock.stats.transfers++;
+        m_mock.stats.bytes       += 1 + p_transfer->length;
+        m_mock.stats.bus_time_us += transfer_time_us(p_transfer);
+        if(p_device == NULL)
+        {
+            m_mock.stats.nacks++;
+            return NRF_ERROR_DRV_TWI_ERR_ANACK;
+        }
+
+        for(uint8_t j = 0; j < p_transfer->length; j++)
+        {
+            if(APP_TWI_IS_READ_OP(p_transfer->operation))
+            {
+                p_transfer->p_data[j] = p_device->regs[p_device->pointer++];
+            }
+            else if(j == 0)
+            {
+                p_device->pointer = p_transfer->p_data[0];
+            }
+            else
+            {
+                p_device->regs[p_device->pointer++] = p_transfer->p_data[j];
+            }
+        }
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+/**@brief Function for finishing the transaction on the bus and starting the next one in the queue */
+static void queue_step(void)
+{
+    app_twi_transaction_t const * p_transaction = m_mock.p_app_twi->p_queue_buffer[m_mock.head];
+    ret_code_t result;
+
+    m_mock.time_us = m_mock.bus_free_us;
+    result = transaction_run(p_transaction);
+    m_mock.stats.cpu_time_us += MOCK_APP_TWI_IRQ_US * p_transaction->number_of_transfers;
+
+    m_mock.head = (m_mock.head + 1) % m_mock.p_app_twi->queue_size;
+    m_mock.count--;
+    m_mock.bus_active = (m_mock.count > 0);
+    if(m_mock.bus_active)
+    {
+        m_mock.bus_free_us = m_mock.time_us + transaction_time_us(m_mock.p_app_twi->p_queue_buffer[m_mock.head]);
+    }
+
+    if(p_transaction->callback != NULL)
+    {
+        p_transaction->callback(result, p_transaction->p_user_data);
+    }
+}
+
+
+
+void mock_app_twi_reset(void)
+{
+    memset(&m_mock, 0, sizeof(m_mock));
+}
+
+
+
+uint8_t * mock_app_twi_device_add(uint8_t address)
+{
+    mock_device_t * p_device = device_find(address);
+
+    if(p_device == NULL && m_mock.device_count < MOCK_APP_TWI_DEVICES)
+    {
+        p_device = &m_mock.devices[m_mock.device_count++];
+        p_device->address = address;
+    }
+    return (p_device != NULL) ? p_device->regs : NULL;
+}
+
+
+
+void mock_app_twi_time_advance(uint32_t time_us)
+{
+    uint32_t end_us = m_mock.time_us + time_us;
+
+    while(m_mock.bus_active && (int32_t)(end_us - m_mock.bus_free_us) >= 0)
+    {
+        queue_step();
+    }
+    m_mock.time_us = end_us;
+}
+
+
+
+uint32_t mock_app_twi_time_get(void)
+{
+    return m_mock.time_us;
+}
+
+
+
+uint32_t mock_app_twi_pending(void)
+{
+    return m_mock.count;
+}
+
+
+
+void mock_app_twi_stats_get(mock_app_twi_stats_t * p_stats)
+{
+    *p_stats = m_mock.stats;
+}
+
+
+
+ret_code_t app_twi_init(app_twi_t * p_app_twi, nrf_drv_twi_config_t const * p_twi_config,
+                        uint8_t queue_size, app_twi_transaction_t const * * p_queue_buffer)
+{
+    (void)p_twi_config;
+    p_app_twi->p_queue_buffer = p_queue_buffer;
+    p_app_twi->queue_size     = queue_size + 1;
+    m_mock.p_app_twi          = p_app_twi;
+    m_mock.head               = 0;
+    m_mock.count              = 0;
+    m_mock.bus_active         = false;
+    return NRF_SUCCESS;
+}
+
+
+
+void app_twi_uninit(app_twi_t * p_app_twi)
+{
+    (void)p_app_twi;
+    m_mock.count      = 0;
+    m_mock.bus_active = false;
+}
+
+
+
+ret_code_t app_twi_schedule(app_twi_t * p_app_twi, app_twi_transaction_t const * p_transaction)
+{
+    // Like the SDK queue, one slot is kept free to tell a full queue from an empty one
+    if(m_mock.count == p_app_twi->queue_size - 1)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    m_mock.stats.cpu_time_us += MOCK_APP_TWI_SCHEDULE_US;
+    p_app_twi->p_queue_buffer[(m_mock.head + m_mock.count) % p_app_twi->queue_size] = p_transaction;
+    m_mock.count++;
+    if(!m_mock.bus_active)
+    {
+        m_mock.bus_active  = true;
+        m_mock.bus_free_us = m_mock.time_us + transaction_time_us(p_transaction);
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+static void perform_callback(ret_code_t result, void * p_user_data)
+{
+    ret_code_t * p_result = (ret_code_t *)p_user_data;
+
+    *p_result = result;
+}
+
+
+
+ret_code_t app_twi_perform(app_twi_t * p_app_twi, app_twi_transfer_t const * p_transfers,
+                           uint8_t number_of_transfers, void (* user_function)(void))
+{
+    ret_code_t result = NRF_ERROR_INTERNAL; // Replaced by the callback
+    uint32_t   start_us = m_mock.time_us;
+    uint32_t   cpu_us;
+    app_twi_transaction_t transaction =
+    {
+        .callback            = perform_callback,
+        .p_user_data         = &result,
+        .p_transfers         = p_transfers,
+        .number_of_transfers = number_of_transfers
+    };
+    ret_code_t err_code = app_twi_schedule(p_app_twi, &transaction);
+
+    (void)user_function;
+    if(err_code != NRF_SUCCESS) return err_code;
+
+    // Spin until the transaction, and everything queued before it, has been on the bus
+    cpu_us = m_mock.stats.cpu_time_us;
+    while(result == NRF_ERROR_INTERNAL)
+    {
+        queue_step();
+    }
+    // The whole wait is CPU time. The interrupts on the way are part of it, not on top of it
+    m_mock.stats.cpu_time_us = cpu_us + (m_mock.time_us - start_us);
+    return result;
+}
+
+
+
+void nrf_delay_ms(uint32_t ms)
+{
+    nrf_delay_us(ms * 1000);
+}
+
+
+
+void nrf_delay_us(uint32_t us)
+{
+    uint32_t cpu_us = m_mock.stats.cpu_time_us;
+
+    mock_app_twi_time_advance(us);
+    m_mock.stats.cpu_time_us = cpu_us + us; // Spinning
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,78 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef MOCK_APP_TWI_H__
+#define MOCK_APP_TWI_H__
+
+/* Host mock of app_twi with a register file per device on the bus.
+ *
+ * Link it with nrf_drv_mpu_twi.c and the stand-in app_twi.h in stub/ to run the TWI backend on a PC.
+ * Each device is 256 registers with an auto incrementing address, like the MPU outside FIFO_R_W.
+ *
+ * The mock keeps a virtual clock. The bus runs the app_twi queue back to back in the background,
+ * and the callbacks are called when mock_app_twi_time_advance() passes the end of a transaction,
+ * as from the TWI interrupt. app_twi_perform() runs the queue up to and including its own
+ * transaction, so the CPU is busy for the whole wait, like the busy loop in the SDK.
+ *
+ * The CPU time is counted to work out how much of the time the CPU could sleep:
+ *  - app_twi_perform(): all the time it spins
+ *  - app_twi_schedule(): MOCK_APP_TWI_SCHEDULE_US
+ *  - each finished transfer: MOCK_APP_TWI_IRQ_US for the TWI interrupt
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef MOCK_APP_TWI_BUS_HZ
+#define MOCK_APP_TWI_BUS_HZ         400000
+#endif
+#ifndef MOCK_APP_TWI_SCHEDULE_US
+#define MOCK_APP_TWI_SCHEDULE_US    6       // Putting a transaction in the queue, on a 16 MHz Cortex-M0
+#endif
+#ifndef MOCK_APP_TWI_IRQ_US
+#define MOCK_APP_TWI_IRQ_US         8       // TWI interrupt ending a transfer and starting the next
+#endif
+#define MOCK_APP_TWI_DEVICES        4
+
+/**@brief Statistics since mock_app_twi_reset()
+ */
+typedef struct
+{
+    uint32_t    transactions;
+    uint32_t    transfers;
+    uint32_t    bytes;              // Slave address and data bytes on the bus
+    uint32_t    bus_time_us;        // Bus busy. 9 clocks per byte plus start and stop
+    uint32_t    cpu_time_us;        // CPU busy in app_twi, see above
+    uint32_t    nacks;
+}mock_app_twi_stats_t;
+
+
+
+/**@brief Function for clearing the clock, the statistics, the queue and the devices */
+void mock_app_twi_reset(void);
+
+/**@brief Function for putting a device on the bus
+ * @retval      uint8_t *       Its 256 registers
+ */
+uint8_t * mock_app_twi_device_add(uint8_t address);
+
+/**@brief Function for moving the clock forward. Transactions finishing on the way call their callbacks */
+void mock_app_twi_time_advance(uint32_t time_us);
+
+/**@brief Function for the virtual time in microseconds */
+uint32_t mock_app_twi_time_get(void);
+
+/**@brief Function for the number of transactions in the queue, including the one on the bus */
+uint32_t mock_app_twi_pending(void);
+
+/**@brief Function for reading the statistics */
+void mock_app_twi_stats_get(mock_app_twi_stats_t * p_stats);
+
+#endif /* MOCK_APP_TWI_H__ */
+
+/**
+  @}
+*/
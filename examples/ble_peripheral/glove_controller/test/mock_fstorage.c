@@ -0,0 +1,208 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_util.h"
+#include "fstorage.h"
+#include "mock_fstorage.h"
+
+#if defined(NRF51)
+#define PAGE_SIZE_WORDS         256
+#else
+#define PAGE_SIZE_WORDS         1024
+#endif
+#define FLASH_WORDS             (MOCK_FSTORAGE_PAGES * PAGE_SIZE_WORDS)
+
+typedef struct
+{
+    fs_config_t const * p_config;
+    uint32_t          * p_dest;
+    uint32_t const    * p_src;
+    uint32_t            length_words;
+    uint16_t            pages;          // Pages to erase, 0 for a store
+    void              * p_context;
+}mock_op_t;
+
+typedef struct
+{
+    uint32_t                flash[FLASH_WORDS];
+    mock_op_t               queue[MOCK_FSTORAGE_QUEUE_SIZE];
+    uint8_t                 queue_head;
+    uint8_t                 queue_count;
+    uint32_t                time_us;
+    mock_fstorage_stats_t   stats;
+}mock_t;
+
+static mock_t m_mock;
+
+// The only user is FDS
+extern fs_config_t fs_config;
+
+
+
+static bool in_bounds(fs_config_t const * p_config, uint32_t const * p_addr, uint32_t length_words)
+{
+    return (p_addr >= p_config->p_start_addr) && (p_addr + length_words <= p_config->p_end_addr);
+}
+
+
+
+static fs_ret_t enqueue(mock_op_t const * p_op)
+{
+    if(p_op->p_config == NULL) return FS_ERR_NULL_ARG;
+    if(p_op->p_config->p_start_addr == NULL) return FS_ERR_NOT_INITIALIZED;
+    if(((uintptr_t)p_op->p_dest & 3) != 0) return FS_ERR_UNALIGNED_ADDR;
+    if(!in_bounds(p_op->p_config, p_op->p_dest, p_op->length_words))
+    {
+        m_mock.stats.errors++;
+        return FS_ERR_INVALID_ADDR;
+    }
+    if((p_op->pages > 0) && (((p_op->p_dest - m_mock.flash) % PAGE_SIZE_WORDS) != 0)) return FS_ERR_UNALIGNED_ADDR;
+    if(m_mock.queue_count == MOCK_FSTORAGE_QUEUE_SIZE) return FS_ERR_QUEUE_FULL;
+
+    m_mock.queue[(m_mock.queue_head + m_mock.queue_count) % MOCK_FSTORAGE_QUEUE_SIZE] = *p_op;
+    m_mock.queue_count++;
+    return FS_SUCCESS;
+}
+
+
+
+void mock_fstorage_reset(void)
+{
+    memset(&m_mock, 0, sizeof(m_mock));
+    memset(m_mock.flash, 0xFF, sizeof(m_mock.flash));
+}
+
+
+
+bool mock_fstorage_step(void)
+{
+    mock_op_t op;
+    fs_evt_t  evt;
+    uint32_t  time_us;
+
+    if(m_mock.queue_count == 0) return false;
+    op = m_mock.queue[m_mock.queue_head];
+    m_mock.queue_head = (m_mock.queue_head + 1) % MOCK_FSTORAGE_QUEUE_SIZE;
+    m_mock.queue_count--;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.p_context = op.p_context;
+    if(op.pages > 0)
+    {
+        memset(op.p_dest, 0xFF, op.length_words * sizeof(uint32_t));
+        time_us = op.pages * MOCK_FSTORAGE_ERASE_US;
+        m_mock.stats.erase_max_us = MAX(m_mock.stats.erase_max_us, time_us);
+        m_mock.stats.erases += op.pages;
+        evt.id               = FS_EVT_ERASE;
+        evt.erase.first_page = (uint16_t)((op.p_dest - m_mock.flash) / PAGE_SIZE_WORDS);
+        evt.erase.last_page  = evt.erase.first_page + op.pages - 1;
+    }
+    else
+    {
+        // Bits written as 1 keep what they were, FDS relies on it when it flags records dirty
+        for(uint32_t i = 0; i < op.length_words; i++)
+        {
+            op.p_dest[i] &= op.p_src[i];
+        }
+        time_us = op.length_words * MOCK_FSTORAGE_WRITE_US;
+        m_mock.stats.store_max_us = MAX(m_mock.stats.store_max_us, time_us);
+        m_mock.stats.stores++;
+        m_mock.stats.words_written += op.length_words;
+        evt.id                 = FS_EVT_STORE;
+        evt.store.p_data       = op.p_dest;
+        evt.store.length_words = (uint16_t)op.length_words;
+    }
+    m_mock.time_us       += time_us;
+    m_mock.stats.busy_us += time_us;
+    op.p_config->callback(&evt, FS_SUCCESS);
+    return true;
+}
+
+
+
+void mock_fstorage_run(void)
+{
+    while(mock_fstorage_step())
+    {
+    }
+}
+
+
+
+void mock_fstorage_stats_get(mock_fstorage_stats_t * p_stats)
+{
+    *p_stats = m_mock.stats;
+}
+
+
+
+uint32_t mock_fstorage_time_get(void)
+{
+    return m_mock.time_us;
+}
+
+
+
+void mock_fstorage_time_advance(uint32_t time_us)
+{
+    m_mock.time_us += time_us;
+}
+
+
+
+fs_ret_t fs_init(void)
+{
+    if(fs_config.num_pages > MOCK_FSTORAGE_PAGES) return FS_ERR_INVALID_CFG;
+
+    // At the end of the flash, as fstorage gives the highest priority
+    fs_config.p_start_addr = &m_mock.flash[FLASH_WORDS - fs_config.num_pages * PAGE_SIZE_WORDS];
+    fs_config.p_end_addr   = &m_mock.flash[FLASH_WORDS];
+    return FS_SUCCESS;
+}
+
+
+
+fs_ret_t fs_store(fs_config_t const * const p_config, uint32_t const * const p_dest,
+                  uint32_t const * const p_src, uint16_t length_words, void * p_context)
+{
+    mock_op_t op =
+    {
+        .p_config     = p_config,
+        .p_dest       = (uint32_t *)p_dest,
+        .p_src        = p_src,
+        .length_words = length_words,
+        .p_context    = p_context,
+    };
+
+    if(p_src == NULL) return FS_ERR_NULL_ARG;
+    if(length_words == 0) return FS_ERR_INVALID_ARG;
+    return enqueue(&op);
+}
+
+
+
+fs_ret_t fs_erase(fs_config_t const * const p_config, uint32_t const * const p_page_addr,
+                  uint16_t num_pages, void * p_context)
+{
+    mock_op_t op =
+    {
+        .p_config     = p_config,
+        .p_dest       = (uint32_t *)p_page_addr,
+        .length_words = num_pages * PAGE_SIZE_WORDS,
+        .pages        = num_pages,
+        .p_context    = p_context,
+    };
+
+    if(num_pages == 0) return FS_ERR_INVALID_ARG;
+    return enqueue(&op);
+}
+
+/**
+  @}
+*/
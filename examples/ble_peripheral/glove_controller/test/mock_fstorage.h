@@ -0,0 +1,69 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef MOCK_FSTORAGE_H__
+#define MOCK_FSTORAGE_H__
+
+/* Host mock of fstorage, with the flash in RAM, for running FDS on a PC.
+ *
+ * fs_store() and fs_erase() queue the operation, and mock_fstorage_step() runs the oldest one and
+ * calls the handler, as the SoC event of the real flash does. Like flash, a store can only clear
+ * bits, and only an erase sets them again. The flash is the pages FDS asks for, of the physical
+ * page size of the chip.
+ *
+ * Each operation takes the time the nRF51 flash takes at most, and the mock clock moves on by
+ * that much. The CPU, and with it the radio, is blocked while the flash is written or erased, so
+ * the longest operation is the longest the SoftDevice may have to wait for.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MOCK_FSTORAGE_QUEUE_SIZE    4
+#define MOCK_FSTORAGE_PAGES         32
+#define MOCK_FSTORAGE_WRITE_US      46      // Per word
+#define MOCK_FSTORAGE_ERASE_US      22300   // Per page
+
+/**@brief Statistics since mock_fstorage_reset()
+ */
+typedef struct
+{
+    uint32_t    stores;
+    uint32_t    erases;             // Pages erased
+    uint32_t    words_written;
+    uint32_t    errors;             // Operations out of the pages of FDS
+    uint32_t    busy_us;            // Time the flash was written or erased
+    uint32_t    store_max_us;       // Longest store
+    uint32_t    erase_max_us;       // Longest erase
+}mock_fstorage_stats_t;
+
+
+
+/**@brief Function for erasing all of the flash and clearing the queue and statistics */
+void mock_fstorage_reset(void);
+
+/**@brief Function for running the oldest queued operation
+ * @retval  false if the queue was empty
+ */
+bool mock_fstorage_step(void);
+
+/**@brief Function for running operations until the queue is empty, those queued meanwhile included */
+void mock_fstorage_run(void);
+
+/**@brief Function for the statistics since mock_fstorage_reset() */
+void mock_fstorage_stats_get(mock_fstorage_stats_t * p_stats);
+
+/**@brief Function for the time of the mock clock, which flash operations and idle time move on */
+uint32_t mock_fstorage_time_get(void);
+
+/**@brief Function for moving the clock on while the flash is idle */
+void mock_fstorage_time_advance(uint32_t time_us);
+
+#endif /* MOCK_FSTORAGE_H__ */
+
+/**
+  @}
+*/
@@ -0,0 +1,671 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "nrf_drv_twi.h"
+#include "nrf_drv_timer.h"
+#include "nrf_drv_ppi.h"
+#include "nrf_twim.h"
+#include "sdk_errors.h"
+#include "mock_nrf52_dma.h"
+
+// Event and task addresses
+#define ADDR_TIMER_EVENT(id, event)     (0x1000 | ((id) << 4) | (event))
+#define ADDR_TIMER_TASK(id, task)       (0x2000 | ((id) << 4) | (task))
+#define ADDR_TWIM_START                 0x3000
+#define ADDR_TWIM_STOPPED               0x3001
+#define ADDR_GROUP_ENABLE(group)        (0x4000 | (group))
+#define ADDR_GROUP_DISABLE(group)       (0x4100 | (group))
+
+typedef struct
+{
+    bool                        initialized;
+    bool                        enabled;
+    nrf_timer_mode_t            mode;
+    uint32_t                    counter;
+    uint32_t                    cc[TIMER_CC_NUM];
+    uint8_t                     shorts;
+    uint8_t                     int_enabled;
+    uint8_t                     int_pending;
+    uint32_t                    irq_due_us;
+    nrf_timer_event_handler_t   handler;
+    void                      * p_context;
+}mock_timer_t;
+
+typedef struct
+{
+    bool                        allocated;
+    bool                        enabled;
+    uint32_t                    eep;
+    uint32_t                    tep;
+    uint32_t                    fork_tep;
+}mock_ppi_channel_t;
+
+typedef struct
+{
+    bool                        initialized;
+    bool                        enabled;
+    bool                        armed;
+    bool                        busy;
+    uint32_t                    flags;
+    uint8_t                     start_reg;
+    uint8_t                   * p_rx;           // RXD.PTR
+    uint8_t                     rx_length;
+    uint8_t                   * p_rx_latched;   // RXD.PTR when the read was started
+    uint16_t                    sequence;       // Trigger that started the read
+    uint32_t                    done_us;
+    nrf_drv_twi_evt_handler_t   handler;
+}mock_twim_t;
+
+typedef struct
+{
+    uint32_t                    time_us;
+    uint32_t                    irq_latency_us;
+    mock_timer_t                timers[TIMER_COUNT];
+    mock_ppi_channel_t          channels[PPI_CH_NUM];
+    uint32_t                    groups[PPI_GROUP_NUM];  // Channel mask
+    bool                        groups_allocated[PPI_GROUP_NUM];
+    uint8_t                     channel_limit;
+    uint8_t                     group_limit;
+    bool                        ppi_initialized;
+    mock_twim_t                 twim;
+    uint8_t const             * p_buffer;
+    uint32_t                    buffer_size;
+    mock_nrf52_dma_stats_t      stats;
+}mock_t;
+
+static mock_t m_mock;
+
+static void task_run(uint32_t task);
+
+
+
+static void event_send(uint32_t event)
+{
+    for(uint8_t i = 0; i < PPI_CH_NUM; i++)
+    {
+        mock_ppi_channel_t * p_channel = &m_mock.channels[i];
+
+        if(!p_channel->allocated || !p_channel->enabled || p_channel->eep != event) continue;
+        task_run(p_channel->tep);
+        if(p_channel->fork_tep != 0)
+        {
+            task_run(p_channel->fork_tep);
+        }
+    }
+}
+
+
+
+static void group_set(uint8_t group, bool enable)
+{
+    for(uint8_t i = 0; i < PPI_CH_NUM; i++)
+    {
+        if(m_mock.groups[group] & (1UL << i))
+        {
+            m_mock.channels[i].enabled = enable;
+        }
+    }
+}
+
+
+
+/**@brief Function for comparing a TIMER after its counter has moved */
+static void timer_compare(uint8_t id)
+{
+    mock_timer_t * p_timer = &m_mock.timers[id];
+    uint32_t       counter = p_timer->counter;
+
+    for(uint8_t cc = 0; cc < TIMER_CC_NUM; cc++)
+    {
+        if(counter != p_timer->cc[cc]) continue;
+
+        if(p_timer->mode == NRF_TIMER_MODE_TIMER && cc == 0)
+        {
+            m_mock.stats.triggers++;
+        }
+        if(p_timer->shorts & (1 << cc))
+        {
+            p_timer->counter = 0;
+        }
+        if(p_timer->int_enabled & (1 << cc))
+        {
+            if(p_timer->int_pending == 0)
+            {
+                p_timer->irq_due_us = m_mock.time_us + m_mock.irq_latency_us;
+            }
+            p_timer->int_pending |= (1 << cc);
+        }
+        event_send(ADDR_TIMER_EVENT(id, cc));
+    }
+}
+
+
+
+static void twim_start(void)
+{
+    mock_twim_t * p_twim = &m_mock.twim;
+
+    if(!p_twim->enabled || !p_twim->armed || p_twim->busy)
+    {
+        m_mock.stats.busy_starts++;
+        return;
+    }
+
+    // Register address write, repeated start and the read
+    uint32_t bits = (2 + 1 + p_twim->rx_length) * 9 + 4;
+
+    p_twim->busy         = true;
+    p_twim->p_rx_latched = p_twim->p_rx;
+    p_twim->sequence     = (uint16_t)m_mock.stats.triggers;
+    p_twim->done_us      = m_mock.time_us + (bits * 1000000 + MOCK_NRF52_DMA_BUS_HZ - 1) / MOCK_NRF52_DMA_BUS_HZ;
+}
+
+
+
+static void twim_done(void)
+{
+    mock_twim_t * p_twim = &m_mock.twim;
+    uint8_t     * p_rx   = p_twim->p_rx_latched;
+
+    p_twim->busy = false;
+    m_mock.stats.reads++;
+    if(p_rx < m_mock.p_buffer || p_rx + p_twim->rx_length > m_mock.p_buffer + m_mock.buffer_size)
+    {
+        m_mock.stats.out_of_bounds++;
+    }
+    else
+    {
+        p_rx[0] = (uint8_t)(p_twim->sequence >> 8);
+        p_rx[1] = (uint8_t)p_twim->sequence;
+        for(uint8_t i = 2; i < p_twim->rx_length; i++)
+        {
+            p_rx[i] = (uint8_t)(p_twim->start_reg + i);
+        }
+    }
+    if(p_twim->flags & NRF_DRV_TWI_FLAG_RX_POSTINC)
+    {
+        p_twim->p_rx = p_rx + p_twim->rx_length;
+    }
+    event_send(ADDR_TWIM_STOPPED);
+}
+
+
+
+static void task_run(uint32_t task)
+{
+    if(task == ADDR_TWIM_START)
+    {
+        twim_start();
+    }
+    else if((task & 0xFF00) == 0x4000)
+    {
+        group_set(task & 0xFF, true);
+    }
+    else if((task & 0xFF00) == 0x4100)
+    {
+        group_set(task & 0xFF, false);
+    }
+    else if((task & 0xF000) == 0x2000)
+    {
+        uint8_t        id      = (task >> 4) & 0xF;
+        mock_timer_t * p_timer = &m_mock.timers[id];
+
+        if((task & 0xF) == NRF_TIMER_TASK_COUNT && p_timer->enabled && p_timer->mode == NRF_TIMER_MODE_COUNTER)
+        {
+            p_timer->counter++;
+            timer_compare(id);
+        }
+    }
+}
+
+
+
+static void irq_run(uint8_t id)
+{
+    mock_timer_t * p_timer = &m_mock.timers[id];
+
+    m_mock.stats.irqs++;
+    for(uint8_t cc = 0; cc < TIMER_CC_NUM; cc++)
+    {
+        if(p_timer->int_pending & (1 << cc))
+        {
+            p_timer->int_pending &= ~(1 << cc);
+            p_timer->handler((nrf_timer_event_t)cc, p_timer->p_context);
+        }
+    }
+}
+
+
+
+void mock_nrf52_dma_reset(void)
+{
+    memset(&m_mock, 0, sizeof(m_mock));
+    m_mock.channel_limit = PPI_CH_NUM;
+    m_mock.group_limit   = PPI_GROUP_NUM;
+}
+
+
+
+void mock_nrf52_dma_irq_latency_set(uint32_t latency_us)
+{
+    m_mock.irq_latency_us = latency_us;
+}
+
+
+
+void mock_nrf52_dma_ppi_limit_set(uint8_t channels, uint8_t groups)
+{
+    m_mock.channel_limit = channels;
+    m_mock.group_limit   = groups;
+}
+
+
+
+void mock_nrf52_dma_buffer_set(uint8_t const * p_buffer, uint32_t size)
+{
+    m_mock.p_buffer    = p_buffer;
+    m_mock.buffer_size = size;
+}
+
+
+
+void mock_nrf52_dma_time_advance(uint32_t time_us)
+{
+    while(time_us-- > 0)
+    {
+        m_mock.time_us++;
+        for(uint8_t id = 0; id < TIMER_COUNT; id++)
+        {
+            mock_timer_t * p_timer = &m_mock.timers[id];
+
+            if(p_timer->enabled && p_timer->mode == NRF_TIMER_MODE_TIMER)
+            {
+                p_timer->counter++;
+                timer_compare(id);
+            }
+        }
+        if(m_mock.twim.busy && m_mock.twim.done_us == m_mock.time_us)
+        {
+            twim_done();
+        }
+        for(uint8_t id = 0; id < TIMER_COUNT; id++)
+        {
+            if(m_mock.timers[id].int_pending != 0 && m_mock.timers[id].irq_due_us <= m_mock.time_us)
+            {
+                irq_run(id);
+            }
+        }
+    }
+}
+
+
+
+uint32_t mock_nrf52_dma_resources_in_use(void)
+{
+    uint32_t count = m_mock.twim.initialized ? 1 : 0;
+
+    for(uint8_t i = 0; i < TIMER_COUNT; i++)
+    {
+        count += m_mock.timers[i].initialized ? 1 : 0;
+    }
+    for(uint8_t i = 0; i < PPI_CH_NUM; i++)
+    {
+        count += m_mock.channels[i].allocated ? 1 : 0;
+    }
+    for(uint8_t i = 0; i < PPI_GROUP_NUM; i++)
+    {
+        count += m_mock.groups_allocated[i] ? 1 : 0;
+    }
+    return count;
+}
+
+
+
+void mock_nrf52_dma_stats_get(mock_nrf52_dma_stats_t * p_stats)
+{
+    *p_stats = m_mock.stats;
+}
+
+
+
+// TWI driver and TWIM HAL
+
+ret_code_t nrf_drv_twi_init(nrf_drv_twi_t const * p_instance, nrf_drv_twi_config_t const * p_config,
+                            nrf_drv_twi_evt_handler_t event_handler, void * p_context)
+{
+    if(m_mock.twim.initialized) return NRF_ERROR_INVALID_STATE;
+
+    memset(&m_mock.twim, 0, sizeof(m_mock.twim));
+    m_mock.twim.initialized = true;
+    m_mock.twim.handler     = event_handler;
+    return NRF_SUCCESS;
+}
+
+
+
+void nrf_drv_twi_uninit(nrf_drv_twi_t const * p_instance)
+{
+    memset(&m_mock.twim, 0, sizeof(m_mock.twim));
+}
+
+
+
+void nrf_drv_twi_enable(nrf_drv_twi_t const * p_instance)
+{
+    m_mock.twim.enabled = true;
+}
+
+
+
+ret_code_t nrf_drv_twi_xfer(nrf_drv_twi_t const * p_instance, nrf_drv_twi_xfer_desc_t const * p_xfer_desc, uint32_t flags)
+{
+    mock_twim_t * p_twim = &m_mock.twim;
+
+    // Only the held, repeated register reads app_mpu_dma.c starts from PPI are modelled
+    if(!p_twim->enabled || p_twim->busy) return NRF_ERROR_BUSY;
+    if(p_xfer_desc->type != NRF_DRV_TWI_XFER_TXRX || !(flags & NRF_DRV_TWI_FLAG_HOLD_XFER)) return NRF_ERROR_NOT_SUPPORTED;
+
+    p_twim->armed     = true;
+    p_twim->flags     = flags;
+    p_twim->start_reg = p_xfer_desc->p_primary_buf[0];
+    p_twim->p_rx      = p_xfer_desc->p_secondary_buf;
+    p_twim->rx_length = p_xfer_desc->secondary_length;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_twi_start_task_get(nrf_drv_twi_t const * p_instance, nrf_drv_twi_xfer_type_t xfer_type)
+{
+    return ADDR_TWIM_START;
+}
+
+
+
+uint32_t nrf_drv_twi_stopped_event_get(nrf_drv_twi_t const * p_instance)
+{
+    return ADDR_TWIM_STOPPED;
+}
+
+
+
+void nrf_twim_rx_buffer_set(NRF_TWIM_Type * p_reg, uint8_t * p_buffer, uint8_t length)
+{
+    m_mock.twim.p_rx      = p_buffer;
+    m_mock.twim.rx_length = length;
+}
+
+
+
+// TIMER driver
+
+ret_code_t nrf_drv_timer_init(nrf_drv_timer_t const * p_instance, nrf_drv_timer_config_t const * p_config,
+                              nrf_timer_event_handler_t timer_event_handler)
+{
+    mock_timer_t * p_timer = &m_mock.timers[p_instance->instance_id];
+
+    if(p_timer->initialized) return NRF_ERROR_INVALID_STATE;
+
+    memset(p_timer, 0, sizeof(*p_timer));
+    p_timer->initialized = true;
+    p_timer->mode        = p_config->mode;
+    p_timer->handler     = timer_event_handler;
+    p_timer->p_context   = p_config->p_context;
+    for(uint8_t cc = 0; cc < TIMER_CC_NUM; cc++)
+    {
+        p_timer->cc[cc] = UINT32_MAX;
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+void nrf_drv_timer_uninit(nrf_drv_timer_t const * p_instance)
+{
+    memset(&m_mock.timers[p_instance->instance_id], 0, sizeof(mock_timer_t));
+}
+
+
+
+void nrf_drv_timer_enable(nrf_drv_timer_t const * p_instance)
+{
+    m_mock.timers[p_instance->instance_id].enabled = true;
+}
+
+
+
+void nrf_drv_timer_disable(nrf_drv_timer_t const * p_instance)
+{
+    m_mock.timers[p_instance->instance_id].enabled = false;
+}
+
+
+
+void nrf_drv_timer_clear(nrf_drv_timer_t const * p_instance)
+{
+    m_mock.timers[p_instance->instance_id].counter = 0;
+}
+
+
+
+uint32_t nrf_drv_timer_capture(nrf_drv_timer_t const * p_instance, nrf_timer_cc_channel_t cc_channel)
+{
+    mock_timer_t * p_timer = &m_mock.timers[p_instance->instance_id];
+
+    p_timer->cc[cc_channel] = p_timer->counter;
+    return p_timer->counter;
+}
+
+
+
+void nrf_drv_timer_extended_compare(nrf_drv_timer_t const * p_instance, nrf_timer_cc_channel_t cc_channel,
+                                    uint32_t cc_value, nrf_timer_short_mask_t timer_short_mask, bool enable_int)
+{
+    mock_timer_t * p_timer = &m_mock.timers[p_instance->instance_id];
+
+    p_timer->cc[cc_channel] = cc_value;
+    p_timer->shorts         = (p_timer->shorts & ~(1 << cc_channel)) | (timer_short_mask & (1 << cc_channel));
+    if(enable_int)
+    {
+        p_timer->int_enabled |= (1 << cc_channel);
+    }
+    else
+    {
+        p_timer->int_enabled &= ~(1 << cc_channel);
+    }
+}
+
+
+
+uint32_t nrf_drv_timer_us_to_ticks(nrf_drv_timer_t const * p_instance, uint32_t time_us)
+{
+    return time_us;
+}
+
+
+
+uint32_t nrf_drv_timer_event_address_get(nrf_drv_timer_t const * p_instance, nrf_timer_event_t timer_event)
+{
+    return ADDR_TIMER_EVENT(p_instance->instance_id, timer_event);
+}
+
+
+
+uint32_t nrf_drv_timer_task_address_get(nrf_drv_timer_t const * p_instance, nrf_timer_task_t timer_task)
+{
+    return ADDR_TIMER_TASK(p_instance->instance_id, timer_task);
+}
+
+
+
+// PPI driver and HAL
+
+uint32_t nrf_drv_ppi_init(void)
+{
+    if(m_mock.ppi_initialized) return NRF_ERROR_MODULE_ALREADY_INITIALIZED;
+
+    m_mock.ppi_initialized = true;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_alloc(nrf_ppi_channel_t * p_channel)
+{
+    for(uint8_t i = 0; i < m_mock.channel_limit; i++)
+    {
+        if(!m_mock.channels[i].allocated)
+        {
+            memset(&m_mock.channels[i], 0, sizeof(mock_ppi_channel_t));
+            m_mock.channels[i].allocated = true;
+            *p_channel = (nrf_ppi_channel_t)i;
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_NO_MEM;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_free(nrf_ppi_channel_t channel)
+{
+    if(!m_mock.channels[channel].allocated) return NRF_ERROR_INVALID_STATE;
+
+    memset(&m_mock.channels[channel], 0, sizeof(mock_ppi_channel_t));
+    for(uint8_t i = 0; i < PPI_GROUP_NUM; i++)
+    {
+        m_mock.groups[i] &= ~(1UL << channel);
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_assign(nrf_ppi_channel_t channel, uint32_t eep, uint32_t tep)
+{
+    if(!m_mock.channels[channel].allocated) return NRF_ERROR_INVALID_STATE;
+
+    m_mock.channels[channel].eep = eep;
+    m_mock.channels[channel].tep = tep;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_fork_assign(nrf_ppi_channel_t channel, uint32_t fork_tep)
+{
+    if(!m_mock.channels[channel].allocated) return NRF_ERROR_INVALID_STATE;
+
+    m_mock.channels[channel].fork_tep = fork_tep;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_enable(nrf_ppi_channel_t channel)
+{
+    if(!m_mock.channels[channel].allocated) return NRF_ERROR_INVALID_STATE;
+
+    m_mock.channels[channel].enabled = true;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_disable(nrf_ppi_channel_t channel)
+{
+    if(!m_mock.channels[channel].allocated) return NRF_ERROR_INVALID_STATE;
+
+    m_mock.channels[channel].enabled = false;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_group_alloc(nrf_ppi_channel_group_t * p_group)
+{
+    for(uint8_t i = 0; i < m_mock.group_limit; i++)
+    {
+        if(!m_mock.groups_allocated[i])
+        {
+            m_mock.groups_allocated[i] = true;
+            m_mock.groups[i]           = 0;
+            *p_group = (nrf_ppi_channel_group_t)i;
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_NO_MEM;
+}
+
+
+
+uint32_t nrf_drv_ppi_group_free(nrf_ppi_channel_group_t group)
+{
+    if(!m_mock.groups_allocated[group]) return NRF_ERROR_INVALID_STATE;
+
+    group_set(group, false);
+    m_mock.groups_allocated[group] = false;
+    m_mock.groups[group]           = 0;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_include_in_group(nrf_ppi_channel_t channel, nrf_ppi_channel_group_t group)
+{
+    if(!m_mock.channels[channel].allocated || !m_mock.groups_allocated[group]) return NRF_ERROR_INVALID_STATE;
+
+    m_mock.groups[group] |= (1UL << channel);
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_group_enable(nrf_ppi_channel_group_t group)
+{
+    if(!m_mock.groups_allocated[group]) return NRF_ERROR_INVALID_STATE;
+
+    group_set(group, true);
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_group_disable(nrf_ppi_channel_group_t group)
+{
+    if(!m_mock.groups_allocated[group]) return NRF_ERROR_INVALID_STATE;
+
+    group_set(group, false);
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_task_addr_group_enable_get(nrf_ppi_channel_group_t group)
+{
+    return ADDR_GROUP_ENABLE(group);
+}
+
+
+
+uint32_t nrf_drv_ppi_task_addr_group_disable_get(nrf_ppi_channel_group_t group)
+{
+    return ADDR_GROUP_DISABLE(group);
+}
+
+
+
+nrf_ppi_channel_enable_t nrf_ppi_channel_enable_get(nrf_ppi_channel_t channel)
+{
+    return m_mock.channels[channel].enabled ? NRF_PPI_CHANNEL_ENABLED : NRF_PPI_CHANNEL_DISABLED;
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,72 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef MOCK_NRF52_DMA_H__
+#define MOCK_NRF52_DMA_H__
+
+/* Host model of the nRF52 TWIM, TIMER and PPI peripherals that app_mpu_dma.c drives.
+ *
+ * Link it with app_mpu_dma.c and the stand-in driver headers in stub/, built with NRF52 defined.
+ *
+ * The model steps a virtual clock one microsecond at a time:
+ *  - TIMERs in timer mode count 1 MHz ticks, TIMERs in counter mode count COUNT tasks.
+ *    Compare events run their shorts, go out on PPI and pend the interrupt if it is enabled.
+ *  - PPI channels connect an event to a task and a fork task. Groups enable and disable their
+ *    channels, from the driver or from the group tasks.
+ *  - The TWIM runs a held, repeated TX RX transfer on each START task. The RX pointer is latched
+ *    at START, and moved one read on at the end of it with RX_POSTINC. A read takes the time of
+ *    the register write and the read on a 400 kHz bus, and ends with the STOPPED event.
+ *  - A pending TIMER interrupt runs its handler after the interrupt latency.
+ *
+ * Each read stores the number of the trigger that started it, big endian, in its first two bytes,
+ * and the register address plus the byte number in the rest, so lost, repeated and reordered
+ * samples show. Reads outside the buffer given to mock_nrf52_dma_buffer_set() are counted and
+ * not written. Triggers are the COMPARE0 events of the TIMERs in timer mode.
+ */
+
+#include <stdint.h>
+
+#define MOCK_NRF52_DMA_BUS_HZ       400000
+
+/**@brief Statistics since mock_nrf52_dma_reset()
+ */
+typedef struct
+{
+    uint32_t    triggers;
+    uint32_t    reads;
+    uint32_t    out_of_bounds;      // Reads that would have written outside the buffer
+    uint32_t    busy_starts;        // START tasks while a read was in progress
+    uint32_t    irqs;               // TIMER interrupt handler runs
+}mock_nrf52_dma_stats_t;
+
+
+
+/**@brief Function for resetting the clock, the statistics and all peripherals */
+void mock_nrf52_dma_reset(void);
+
+/**@brief Function for setting the time from a TIMER event to its interrupt handler */
+void mock_nrf52_dma_irq_latency_set(uint32_t latency_us);
+
+/**@brief Function for limiting the PPI channels and groups that can be allocated, to test error paths */
+void mock_nrf52_dma_ppi_limit_set(uint8_t channels, uint8_t groups);
+
+/**@brief Function for the buffer the TWIM is allowed to write into */
+void mock_nrf52_dma_buffer_set(uint8_t const * p_buffer, uint32_t size);
+
+/**@brief Function for moving the clock forward */
+void mock_nrf52_dma_time_advance(uint32_t time_us);
+
+/**@brief Function for the number of TWIs, TIMERs, PPI channels and PPI groups in use */
+uint32_t mock_nrf52_dma_resources_in_use(void);
+
+/**@brief Function for reading the statistics */
+void mock_nrf52_dma_stats_get(mock_nrf52_dma_stats_t * p_stats);
+
+#endif /* MOCK_NRF52_DMA_H__ */
+
+/**
+  @}
+*/
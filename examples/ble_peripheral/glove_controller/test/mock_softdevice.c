@@ -0,0 +1,200 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ble.h"
+#include "ble_gatts.h"
+#include "ble_srv_common.h"
+#include "mock_softdevice.h"
+
+typedef struct
+{
+    uint16_t                    next_handle;
+    uint16_t                    cccd[MOCK_SOFTDEVICE_ATTRIBUTES];   // By handle. 0 for attributes that are not CCCDs
+    bool                        is_cccd[MOCK_SOFTDEVICE_ATTRIBUTES];
+    bool                        sys_attr_set;
+    uint8_t                     tx_free;
+    uint8_t                     tx_in_use;
+    mock_softdevice_hvx_sink_t  sink;
+    mock_softdevice_irq_t       irq;
+    bool                        in_irq;
+    mock_softdevice_stats_t     stats;
+}mock_t;
+
+static mock_t m_mock;
+
+
+
+void mock_softdevice_reset(void)
+{
+    memset(&m_mock, 0, sizeof(m_mock));
+    m_mock.next_handle = 1;
+    m_mock.tx_free     = MOCK_SOFTDEVICE_TX_BUFFERS;
+}
+
+
+
+void mock_softdevice_tx_buffers_set(uint8_t count)
+{
+    m_mock.tx_free = count;
+}
+
+
+
+void mock_softdevice_tx_complete(uint8_t count)
+{
+    if(count > m_mock.tx_in_use) count = m_mock.tx_in_use;
+    m_mock.tx_in_use -= count;
+    m_mock.tx_free   += count;
+}
+
+
+
+uint8_t mock_softdevice_tx_in_use(void)
+{
+    return m_mock.tx_in_use;
+}
+
+
+
+void mock_softdevice_hvx_sink_set(mock_softdevice_hvx_sink_t sink)
+{
+    m_mock.sink = sink;
+}
+
+
+
+void mock_softdevice_hvx_irq_set(mock_softdevice_irq_t irq)
+{
+    m_mock.irq = irq;
+}
+
+
+
+void mock_softdevice_cccd_set(uint16_t cccd_handle, uint16_t value)
+{
+    m_mock.cccd[cccd_handle] = value;
+}
+
+
+
+void mock_softdevice_sys_attr_set(bool set)
+{
+    m_mock.sys_attr_set = set;
+}
+
+
+
+void mock_softdevice_stats_get(mock_softdevice_stats_t * p_stats)
+{
+    *p_stats = m_mock.stats;
+}
+
+
+
+// SoftDevice calls
+
+uint32_t sd_ble_uuid_vs_add(ble_uuid128_t const * p_vs_uuid, uint8_t * p_uuid_type)
+{
+    *p_uuid_type = BLE_UUID_TYPE_VENDOR_BEGIN;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t sd_ble_gatts_service_add(uint8_t type, ble_uuid_t const * p_uuid, uint16_t * p_handle)
+{
+    *p_handle = m_mock.next_handle++;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t sd_ble_gatts_characteristic_add(uint16_t service_handle, ble_gatts_char_md_t const * p_char_md,
+                                         ble_gatts_attr_t const * p_attr_char_value, ble_gatts_char_handles_t * p_handles)
+{
+    if(m_mock.next_handle + 3 > MOCK_SOFTDEVICE_ATTRIBUTES) return NRF_ERROR_NO_MEM;
+
+    memset(p_handles, 0, sizeof(*p_handles));
+    m_mock.next_handle++;                               // Declaration
+    p_handles->value_handle = m_mock.next_handle++;
+    if(p_char_md->char_props.notify || p_char_md->char_props.indicate)
+    {
+        p_handles->cccd_handle = m_mock.next_handle++;
+        m_mock.is_cccd[p_handles->cccd_handle] = true;
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t sd_ble_gatts_value_get(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t * p_value)
+{
+    if(handle >= MOCK_SOFTDEVICE_ATTRIBUTES || !m_mock.is_cccd[handle]) return BLE_ERROR_INVALID_ATTR_HANDLE;
+    if(!m_mock.sys_attr_set) return BLE_ERROR_GATTS_SYS_ATTR_MISSING;
+    if(p_value->offset != 0 || p_value->len < BLE_CCCD_VALUE_LEN) return NRF_ERROR_INVALID_PARAM;
+
+    p_value->len = uint16_encode(m_mock.cccd[handle], p_value->p_value);
+    return NRF_SUCCESS;
+}
+
+
+
+static uint32_t hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params)
+{
+    uint16_t cccd_handle = p_hvx_params->handle + 1;
+
+    if(conn_handle == BLE_CONN_HANDLE_INVALID) return BLE_ERROR_INVALID_CONN_HANDLE;
+    if(cccd_handle >= MOCK_SOFTDEVICE_ATTRIBUTES || !m_mock.is_cccd[cccd_handle]) return BLE_ERROR_INVALID_ATTR_HANDLE;
+    if(!m_mock.sys_attr_set) return BLE_ERROR_GATTS_SYS_ATTR_MISSING;
+    if(!(m_mock.cccd[cccd_handle] & BLE_GATT_HVX_NOTIFICATION)) return NRF_ERROR_INVALID_STATE;
+    if(m_mock.tx_free == 0)
+    {
+        m_mock.stats.no_tx_packets++;
+        return BLE_ERROR_NO_TX_PACKETS;
+    }
+
+    m_mock.tx_free--;
+    m_mock.tx_in_use++;
+    m_mock.stats.notifications++;
+    m_mock.stats.bytes += *p_hvx_params->p_len;
+    if(m_mock.sink != NULL)
+    {
+        m_mock.sink(p_hvx_params->handle, p_hvx_params->p_data, *p_hvx_params->p_len);
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t sd_ble_gatts_hvx(uint16_t conn_handle, ble_gatts_hvx_params_t const * p_hvx_params)
+{
+    uint32_t err_code = hvx(conn_handle, p_hvx_params);
+
+    // Not taken again from the calls it makes itself
+    if(m_mock.irq != NULL && !m_mock.in_irq)
+    {
+        m_mock.in_irq = true;
+        m_mock.irq();
+        m_mock.in_irq = false;
+    }
+    return err_code;
+}
+
+
+
+// Stand-in for the one function of ble_srv_common.c the services use
+
+bool ble_srv_is_notification_enabled(uint8_t const * p_encoded_data)
+{
+    return (uint16_decode(p_encoded_data) & BLE_GATT_HVX_NOTIFICATION) != 0;
+}
+
+/**
+  @}
+*/
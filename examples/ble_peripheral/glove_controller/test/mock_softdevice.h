@@ -0,0 +1,80 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef MOCK_SOFTDEVICE_H__
+#define MOCK_SOFTDEVICE_H__
+
+/* Host mock of the SoftDevice GATT server calls the BLE services use.
+ *
+ * Build with SVCALL_AS_NORMAL_FUNCTION defined, so the SoftDevice headers declare plain functions.
+ *
+ * Characteristics get consecutive handles: the declaration, the value and then the CCCD.
+ * CCCDs are kept by the mock and read back through sd_ble_gatts_value_get(). Until
+ * mock_softdevice_sys_attr_set() is called for a connection, reading them fails with
+ * BLE_ERROR_GATTS_SYS_ATTR_MISSING, like before the Peer Manager restores a bonded peer.
+ *
+ * Notifications go to the sink set with mock_softdevice_hvx_sink_set(). Each takes a TX buffer
+ * until mock_softdevice_tx_complete() gives it back. sd_ble_gatts_hvx() fails with
+ * BLE_ERROR_NO_TX_PACKETS when there are none left, and with NRF_ERROR_INVALID_STATE when the
+ * peer has not enabled notifications in the CCCD.
+ *
+ * An interrupt can be set with mock_softdevice_hvx_irq_set(). It runs at the end of each
+ * sd_ble_gatts_hvx() call, once the result is decided, like an event or a higher priority
+ * writer that comes in while the caller is in the SoftDevice.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MOCK_SOFTDEVICE_TX_BUFFERS      7       // s130 default
+#define MOCK_SOFTDEVICE_ATTRIBUTES      64
+
+typedef void (* mock_softdevice_hvx_sink_t)(uint16_t handle, uint8_t const * p_data, uint16_t len);
+typedef void (* mock_softdevice_irq_t)(void);
+
+/**@brief Statistics since mock_softdevice_reset()
+ */
+typedef struct
+{
+    uint32_t    notifications;
+    uint32_t    bytes;
+    uint32_t    no_tx_packets;      // sd_ble_gatts_hvx() calls refused for want of a TX buffer
+}mock_softdevice_stats_t;
+
+
+
+/**@brief Function for clearing the attribute table, the CCCDs, the sink and the statistics */
+void mock_softdevice_reset(void);
+
+/**@brief Function for setting the number of free TX buffers */
+void mock_softdevice_tx_buffers_set(uint8_t count);
+
+/**@brief Function for giving TX buffers back, as on BLE_EVT_TX_COMPLETE */
+void mock_softdevice_tx_complete(uint8_t count);
+
+/**@brief Function for the number of TX buffers in use */
+uint8_t mock_softdevice_tx_in_use(void);
+
+/**@brief Function for setting where notifications go. NULL to drop them */
+void mock_softdevice_hvx_sink_set(mock_softdevice_hvx_sink_t sink);
+
+/**@brief Function for setting the interrupt taken in sd_ble_gatts_hvx(). NULL for none */
+void mock_softdevice_hvx_irq_set(mock_softdevice_irq_t irq);
+
+/**@brief Function for writing a CCCD the way the peer or the restored system attributes would */
+void mock_softdevice_cccd_set(uint16_t cccd_handle, uint16_t value);
+
+/**@brief Function for marking whether the system attributes of the connection are set */
+void mock_softdevice_sys_attr_set(bool set);
+
+/**@brief Function for reading the statistics */
+void mock_softdevice_stats_get(mock_softdevice_stats_t * p_stats);
+
+#endif /* MOCK_SOFTDEVICE_H__ */
+
+/**
+  @}
+*/
@@ -0,0 +1,629 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "nrf_drv_spi.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_drv_ppi.h"
+#include "nrf_spi.h"
+#include "nrf_spim.h"
+#include "nrf_gpio.h"
+#include "nrf_delay.h"
+#include "nrf_drv_mpu.h"
+#include "sdk_errors.h"
+#include "mock_spi.h"
+
+#define SPI_TASK_START          0x40003010
+#define SPI_EVENT_END           0x40003118
+#define GPIOTE_TASK_SET         0x40006030
+#define GPIOTE_TASK_CLR         0x40006060
+#define MPU_REG_FIFO            0x74
+#define MPU_WRITE_FREQ_MAX      NRF_DRV_SPI_FREQ_1M
+
+typedef struct
+{
+    bool                allocated;
+    bool                enabled;
+    uint32_t            eep;
+    uint32_t            tep;
+    uint32_t            fork;
+}mock_ppi_channel_t;
+
+typedef struct
+{
+    uint8_t const     * p_tx;
+    uint8_t             tx_length;
+    uint8_t           * p_rx;
+    uint8_t             rx_length;
+    uint32_t            flags;
+}mock_xfer_t;
+
+typedef struct
+{
+    // MPU
+    uint8_t                 regs[256];
+    uint8_t                 reg;
+    bool                    read;
+    bool                    reg_pending;        // The next byte is the register byte
+    uint8_t                 fifo_seq;
+    bool                    cs;
+    bool                    cs_output;
+    // SPI driver
+    bool                    initialized;
+    nrf_drv_spi_handler_t   handler;
+    uint32_t                frequency;
+    bool                    busy;
+    bool                    pending;
+    bool                    in_irq;
+    bool                    hold;
+    bool                    hang;
+    mock_xfer_t             xfer;
+    bool                    held;               // xfer is set up to be started by PPI
+    // GPIOTE and PPI
+    bool                    gpiote_init;
+    bool                    gpiote_out;
+    bool                    gpiote_task;
+    bool                    ppi_init;
+    mock_ppi_channel_t      channels[MOCK_SPI_PPI_CHANNELS];
+    // Faults
+    uint32_t                calls;
+    uint32_t                fail_call;
+    mock_spi_stats_t        stats;
+}mock_t;
+
+static mock_t m_mock;
+
+
+
+/**@brief Counts a call that can fail, and fails it when it is the one asked for */
+static bool call_fails(void)
+{
+    m_mock.calls++;
+    return m_mock.calls == m_mock.fail_call;
+}
+
+
+
+static void cs_set(bool level)
+{
+    if(!m_mock.cs && level)
+    {
+        m_mock.stats.frames++;
+    }
+    if(m_mock.cs && !level)
+    {
+        m_mock.reg_pending       = true;
+        m_mock.stats.frame_bytes = 0;
+    }
+    m_mock.cs = level;
+}
+
+
+
+static uint8_t clock_byte(uint8_t out)
+{
+    uint8_t in = 0;
+
+    if(m_mock.cs)
+    {
+        m_mock.stats.errors++; // Nobody is listening
+        return 0xFF;
+    }
+    m_mock.stats.frame_bytes++;
+
+    if(m_mock.reg_pending)
+    {
+        m_mock.reg         = out & 0x7F;
+        m_mock.read        = (out & 0x80) != 0;
+        m_mock.reg_pending = false;
+        return 0;
+    }
+    if(m_mock.read)
+    {
+        in = (m_mock.reg == MPU_REG_FIFO) ? m_mock.fifo_seq++ : m_mock.regs[m_mock.reg];
+    }
+    else
+    {
+        if(m_mock.frequency > MPU_WRITE_FREQ_MAX) m_mock.stats.errors++;
+        m_mock.regs[m_mock.reg] = out;
+    }
+    if(m_mock.reg != MPU_REG_FIFO) m_mock.reg++;
+    return in;
+}
+
+
+
+/**@brief Clocks a transfer. Bytes past the TX buffer are the over-read character 0xFF */
+static void clock_xfer(mock_xfer_t const * p_xfer)
+{
+    uint8_t length = (p_xfer->tx_length > p_xfer->rx_length) ? p_xfer->tx_length : p_xfer->rx_length;
+
+    for(uint8_t i = 0; i < length; i++)
+    {
+        uint8_t in = clock_byte((i < p_xfer->tx_length) ? p_xfer->p_tx[i] : 0xFF);
+        if(i < p_xfer->rx_length) p_xfer->p_rx[i] = in;
+    }
+}
+
+
+
+/**@brief Finishes the transfers in turn, as the SPI interrupt. The handler may start the next one */
+static void transfers_run(void)
+{
+    nrf_drv_spi_evt_t evt;
+
+    if(m_mock.in_irq) return;
+    m_mock.in_irq = true;
+    while(m_mock.pending && !m_mock.hang)
+    {
+        m_mock.pending = false;
+        clock_xfer(&m_mock.xfer);
+        m_mock.busy = false;
+
+        evt.type = NRF_DRV_SPI_EVENT_DONE;
+        m_mock.handler(&evt);
+    }
+    m_mock.in_irq = false;
+}
+
+
+
+static void task_run(uint32_t task)
+{
+    switch(task)
+    {
+        case GPIOTE_TASK_CLR:
+            if(m_mock.gpiote_out && m_mock.gpiote_task) cs_set(false);
+            break;
+
+        case GPIOTE_TASK_SET:
+            if(m_mock.gpiote_out && m_mock.gpiote_task) cs_set(true);
+            break;
+
+        case SPI_TASK_START:
+            if(!m_mock.held) break;
+            m_mock.stats.transfers++;
+            clock_xfer(&m_mock.xfer);
+            if(m_mock.xfer.flags & NRF_DRV_SPI_FLAG_RX_POSTINC)
+            {
+                m_mock.xfer.p_rx += m_mock.xfer.rx_length;
+            }
+            mock_spi_event(SPI_EVENT_END);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+
+void mock_spi_reset(void)
+{
+    memset(&m_mock, 0, sizeof(m_mock));
+    m_mock.cs = true;
+}
+
+
+
+uint8_t * mock_spi_registers(void)
+{
+    return m_mock.regs;
+}
+
+
+
+void mock_spi_hold_set(bool hold)
+{
+    m_mock.hold = hold;
+}
+
+
+
+void mock_spi_hang_set(bool hang)
+{
+    m_mock.hang = hang;
+}
+
+
+
+void mock_spi_run(void)
+{
+    transfers_run();
+}
+
+
+
+void mock_spi_fail_set(uint32_t call)
+{
+    m_mock.calls     = 0;
+    m_mock.fail_call = call;
+}
+
+
+
+uint32_t mock_spi_calls_get(void)
+{
+    return m_mock.calls;
+}
+
+
+
+void mock_spi_event(uint32_t event)
+{
+    for(uint8_t i = 0; i < MOCK_SPI_PPI_CHANNELS; i++)
+    {
+        mock_ppi_channel_t const * p_channel = &m_mock.channels[i];
+
+        if(p_channel->allocated && p_channel->enabled && p_channel->eep == event)
+        {
+            task_run(p_channel->tep);
+            task_run(p_channel->fork);
+        }
+    }
+}
+
+
+
+uint8_t mock_spi_ppi_in_use(void)
+{
+    uint8_t count = 0;
+
+    for(uint8_t i = 0; i < MOCK_SPI_PPI_CHANNELS; i++)
+    {
+        if(m_mock.channels[i].allocated) count++;
+    }
+    return count;
+}
+
+
+
+bool mock_spi_gpiote_in_use(void)
+{
+    return m_mock.gpiote_out;
+}
+
+
+
+bool mock_spi_cs_get(void)
+{
+    return m_mock.cs;
+}
+
+
+
+bool mock_spi_cs_output_get(void)
+{
+    return m_mock.cs_output;
+}
+
+
+
+uint32_t mock_spi_frequency_get(void)
+{
+    return m_mock.frequency;
+}
+
+
+
+void mock_spi_stats_get(mock_spi_stats_t * p_stats)
+{
+    *p_stats = m_mock.stats;
+}
+
+
+
+// SPI driver
+
+uint32_t nrf_drv_spi_init(nrf_drv_spi_t const * p_instance, nrf_drv_spi_config_t const * p_config,
+                          nrf_drv_spi_handler_t handler)
+{
+    if(m_mock.initialized) return NRF_ERROR_INVALID_STATE;
+    if(p_config->ss_pin != NRF_DRV_SPI_PIN_NOT_USED || handler == NULL) m_mock.stats.errors++;
+
+    m_mock.initialized = true;
+    m_mock.handler     = handler;
+    m_mock.frequency   = p_config->frequency;
+    m_mock.busy        = false;
+    m_mock.held        = false;
+    m_mock.stats.inits++;
+    return NRF_SUCCESS;
+}
+
+
+
+void nrf_drv_spi_uninit(nrf_drv_spi_t const * p_instance)
+{
+    if(m_mock.pending || m_mock.busy)
+    {
+        m_mock.stats.dropped++;
+    }
+    m_mock.initialized = false;
+    m_mock.pending     = false;
+    m_mock.busy        = false;
+    m_mock.held        = false;
+}
+
+
+
+uint32_t nrf_drv_spi_xfer(nrf_drv_spi_t const * p_instance, nrf_drv_spi_xfer_desc_t const * p_xfer_desc, uint32_t flags)
+{
+    if(call_fails()) return NRF_ERROR_INTERNAL;
+    if(!m_mock.initialized)
+    {
+        m_mock.stats.errors++;
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if(m_mock.busy) return NRF_ERROR_BUSY;
+
+    m_mock.xfer.p_tx      = p_xfer_desc->p_tx_buffer;
+    m_mock.xfer.tx_length = p_xfer_desc->tx_length;
+    m_mock.xfer.p_rx      = p_xfer_desc->p_rx_buffer;
+    m_mock.xfer.rx_length = p_xfer_desc->rx_length;
+    m_mock.xfer.flags     = flags;
+    if(flags & NRF_DRV_SPI_FLAG_HOLD_XFER)
+    {
+        m_mock.held = true;
+        return NRF_SUCCESS;
+    }
+
+    if(m_mock.cs) m_mock.stats.errors++; // Clocked with nobody selected
+    m_mock.held    = false;
+    m_mock.busy    = true;
+    m_mock.pending = true;
+    m_mock.stats.transfers++;
+    if(!m_mock.hold)
+    {
+        transfers_run();
+    }
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_spi_transfer(nrf_drv_spi_t const * p_instance, uint8_t const * p_tx_buffer, uint8_t tx_buffer_length,
+                              uint8_t * p_rx_buffer, uint8_t rx_buffer_length)
+{
+    nrf_drv_spi_xfer_desc_t xfer = NRF_DRV_SPI_XFER_TRX(p_tx_buffer, tx_buffer_length, p_rx_buffer, rx_buffer_length);
+
+    return nrf_drv_spi_xfer(p_instance, &xfer, 0);
+}
+
+
+
+uint32_t nrf_drv_spi_start_task_get(nrf_drv_spi_t const * p_instance)
+{
+    return SPI_TASK_START;
+}
+
+
+
+uint32_t nrf_drv_spi_end_event_get(nrf_drv_spi_t const * p_instance)
+{
+    return SPI_EVENT_END;
+}
+
+
+
+void nrf_spi_frequency_set(NRF_SPI_Type * p_spi, nrf_spi_frequency_t frequency)
+{
+    m_mock.frequency = frequency;
+}
+
+
+
+void nrf_spim_frequency_set(NRF_SPIM_Type * p_spim, nrf_spim_frequency_t frequency)
+{
+    m_mock.frequency = frequency;
+}
+
+
+
+void nrf_spim_rx_buffer_set(NRF_SPIM_Type * p_spim, uint8_t * p_buffer, uint8_t length)
+{
+    m_mock.xfer.p_rx      = p_buffer;
+    m_mock.xfer.rx_length = length;
+}
+
+
+
+// GPIO and GPIOTE. Only the MPU CS pin is modelled
+
+void nrf_gpio_pin_set(uint32_t pin_number)
+{
+    if(pin_number == MPU_SPI_CS_PIN) cs_set(true);
+}
+
+
+
+void nrf_gpio_pin_clear(uint32_t pin_number)
+{
+    if(pin_number == MPU_SPI_CS_PIN) cs_set(false);
+}
+
+
+
+void nrf_gpio_cfg_output(uint32_t pin_number)
+{
+    if(pin_number == MPU_SPI_CS_PIN) m_mock.cs_output = true;
+}
+
+
+
+bool nrf_drv_gpiote_is_init(void)
+{
+    return m_mock.gpiote_init;
+}
+
+
+
+uint32_t nrf_drv_gpiote_init(void)
+{
+    if(call_fails()) return NRF_ERROR_INTERNAL;
+    if(m_mock.gpiote_init) return NRF_ERROR_INVALID_STATE;
+    m_mock.gpiote_init = true;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_gpiote_out_init(uint32_t pin, nrf_drv_gpiote_out_config_t const * p_config)
+{
+    if(call_fails()) return NRF_ERROR_NO_MEM;
+    if(!m_mock.gpiote_init || pin != MPU_SPI_CS_PIN) return NRF_ERROR_INVALID_STATE;
+    if(m_mock.gpiote_out) return NRF_ERROR_INVALID_STATE;
+    m_mock.gpiote_out  = true;
+    m_mock.gpiote_task = false;
+    cs_set(p_config->init_state);
+    return NRF_SUCCESS;
+}
+
+
+
+void nrf_drv_gpiote_out_uninit(uint32_t pin)
+{
+    if(pin != MPU_SPI_CS_PIN) return;
+    m_mock.gpiote_out  = false;
+    m_mock.gpiote_task = false;
+    m_mock.cs_output   = false; // Back to the default input
+}
+
+
+
+void nrf_drv_gpiote_out_task_enable(uint32_t pin)
+{
+    if(pin == MPU_SPI_CS_PIN && m_mock.gpiote_out) m_mock.gpiote_task = true;
+}
+
+
+
+uint32_t nrf_drv_gpiote_clr_task_addr_get(uint32_t pin)
+{
+    return GPIOTE_TASK_CLR;
+}
+
+
+
+uint32_t nrf_drv_gpiote_set_task_addr_get(uint32_t pin)
+{
+    return GPIOTE_TASK_SET;
+}
+
+
+
+// PPI
+
+uint32_t nrf_drv_ppi_init(void)
+{
+    if(call_fails()) return NRF_ERROR_INTERNAL;
+    if(m_mock.ppi_init) return NRF_ERROR_MODULE_ALREADY_INITIALIZED;
+    m_mock.ppi_init = true;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_alloc(nrf_ppi_channel_t * p_channel)
+{
+    if(call_fails()) return NRF_ERROR_NO_MEM;
+    for(uint8_t i = 0; i < MOCK_SPI_PPI_CHANNELS; i++)
+    {
+        if(!m_mock.channels[i].allocated)
+        {
+            memset(&m_mock.channels[i], 0, sizeof(mock_ppi_channel_t));
+            m_mock.channels[i].allocated = true;
+            *p_channel = (nrf_ppi_channel_t)i;
+            return NRF_SUCCESS;
+        }
+    }
+    return NRF_ERROR_NO_MEM;
+}
+
+
+
+static mock_ppi_channel_t * channel_get(nrf_ppi_channel_t channel)
+{
+    if((uint32_t)channel >= MOCK_SPI_PPI_CHANNELS || !m_mock.channels[channel].allocated) return NULL;
+    return &m_mock.channels[channel];
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_free(nrf_ppi_channel_t channel)
+{
+    mock_ppi_channel_t * p_channel = channel_get(channel);
+
+    if(p_channel == NULL) return NRF_ERROR_INVALID_STATE;
+    p_channel->allocated = false;
+    p_channel->enabled   = false;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_assign(nrf_ppi_channel_t channel, uint32_t eep, uint32_t tep)
+{
+    mock_ppi_channel_t * p_channel = channel_get(channel);
+
+    if(call_fails()) return NRF_ERROR_INTERNAL;
+    if(p_channel == NULL) return NRF_ERROR_INVALID_STATE;
+    p_channel->eep = eep;
+    p_channel->tep = tep;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_fork_assign(nrf_ppi_channel_t channel, uint32_t fork_tep)
+{
+    mock_ppi_channel_t * p_channel = channel_get(channel);
+
+    if(call_fails()) return NRF_ERROR_NOT_SUPPORTED; // As on the nRF51
+    if(p_channel == NULL) return NRF_ERROR_INVALID_STATE;
+    p_channel->fork = fork_tep;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_enable(nrf_ppi_channel_t channel)
+{
+    mock_ppi_channel_t * p_channel = channel_get(channel);
+
+    if(call_fails()) return NRF_ERROR_INTERNAL;
+    if(p_channel == NULL) return NRF_ERROR_INVALID_STATE;
+    p_channel->enabled = true;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_ppi_channel_disable(nrf_ppi_channel_t channel)
+{
+    mock_ppi_channel_t * p_channel = channel_get(channel);
+
+    if(p_channel == NULL) return NRF_ERROR_INVALID_STATE;
+    p_channel->enabled = false;
+    return NRF_SUCCESS;
+}
+
+
+
+void nrf_delay_us(uint32_t us)
+{
+}
+
+
+
+void nrf_delay_ms(uint32_t ms)
+{
+}
+
+/**
+  @}
+*/
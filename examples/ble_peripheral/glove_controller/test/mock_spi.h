@@ -0,0 +1,91 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef MOCK_SPI_H__
+#define MOCK_SPI_H__
+
+/* Host mock of the SPI driver with an MPU on the bus, and the GPIO, GPIOTE and PPI it is driven with.
+ *
+ * Link it with nrf_drv_mpu_spi.c and the stand-in headers in stub/ to run the SPI backend on a PC.
+ * The MPU decodes the bytes clocked while its CS is low: the register byte with the read bit, then
+ * data to or from 256 registers with an auto incrementing address. FIFO_R_W does not increment, and
+ * reads of it give a counting byte sequence. Writes at more than 1 MHz are counted as errors.
+ *
+ * A transfer finishes as soon as it is started, with the event handler called as from the SPI
+ * interrupt, unless mock_spi_hold_set() holds it until mock_spi_run(). With mock_spi_hang_set() a
+ * transfer never finishes. The PPI channels run their tasks when mock_spi_event() is given their
+ * event, and a transfer held for PPI clocks when its start task runs.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MOCK_SPI_PPI_CHANNELS       4
+#define MOCK_SPI_EVENT_TRIGGER      0x40008140  // E.g. TIMER COMPARE[0], for the tests to trigger reads with
+
+/**@brief Statistics since mock_spi_reset()
+ */
+typedef struct
+{
+    uint32_t    frames;             // CS low to high
+    uint32_t    frame_bytes;        // Bytes clocked in the last frame, register byte included
+    uint32_t    transfers;
+    uint32_t    inits;
+    uint32_t    dropped;            // Transfers stopped by nrf_drv_spi_uninit()
+    uint32_t    errors;             // Transfers while not initialized or with CS high, fast writes
+}mock_spi_stats_t;
+
+
+
+/**@brief Function for clearing the bus, the MPU registers, PPI and GPIOTE */
+void mock_spi_reset(void);
+
+/**@brief Function for the 256 registers of the MPU */
+uint8_t * mock_spi_registers(void);
+
+/**@brief Function for holding transfers until mock_spi_run(), to check what happens while they run */
+void mock_spi_hold_set(bool hold);
+
+/**@brief Function for making transfers never finish, like a stuck peripheral */
+void mock_spi_hang_set(bool hang);
+
+/**@brief Function for finishing the transfers held by mock_spi_hold_set() */
+void mock_spi_run(void);
+
+/**@brief Function for failing a call into the GPIOTE, PPI or SPI drivers
+ * @param[in]   call            Which call from now fails, counting from 1. 0 for none
+ */
+void mock_spi_fail_set(uint32_t call);
+
+/**@brief Function for the calls into the GPIOTE, PPI and SPI drivers that can fail, since mock_spi_fail_set() */
+uint32_t mock_spi_calls_get(void);
+
+/**@brief Function for signalling an event to the PPI channels */
+void mock_spi_event(uint32_t event);
+
+/**@brief Function for the PPI channels allocated */
+uint8_t mock_spi_ppi_in_use(void);
+
+/**@brief Function for whether CS is a GPIOTE task output */
+bool mock_spi_gpiote_in_use(void);
+
+/**@brief Function for the level of CS */
+bool mock_spi_cs_get(void);
+
+/**@brief Function for whether CS is configured as a GPIO output */
+bool mock_spi_cs_output_get(void);
+
+/**@brief Function for the clock of the last transfer */
+uint32_t mock_spi_frequency_get(void);
+
+/**@brief Function for the statistics since mock_spi_reset() */
+void mock_spi_stats_get(mock_spi_stats_t * p_stats);
+
+#endif /* MOCK_SPI_H__ */
+
+/**
+  @}
+*/
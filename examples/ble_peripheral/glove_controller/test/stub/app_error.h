@@ -0,0 +1,20 @@
+/* Host stand-in for app_error.h. The test provides app_error_handler_bare() */
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+#include <stdint.h>
+#include "sdk_errors.h"
+
+void app_error_handler_bare(uint32_t error_code);
+
+#define APP_ERROR_CHECK(ERR_CODE)                           \
+    do                                                      \
+    {                                                       \
+        const uint32_t LOCAL_ERR_CODE = (ERR_CODE);         \
+        if(LOCAL_ERR_CODE != NRF_SUCCESS)                   \
+        {                                                   \
+            app_error_handler_bare(LOCAL_ERR_CODE);         \
+        }                                                   \
+    } while(0)
+
+#endif
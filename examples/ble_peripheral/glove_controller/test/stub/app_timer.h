@@ -0,0 +1,13 @@
+/* Host stand-in for app_timer.h, the RTC1 counter only. The tests that need it count it on their own clock */
+#ifndef APP_TIMER_H__
+#define APP_TIMER_H__
+
+#include <stdint.h>
+
+#define APP_TIMER_CLOCK_FREQ        32768
+#define APP_TIMER_TICKS(MS, PRESCALER)  ((uint32_t)((((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ) + (((PRESCALER) + 1) * 500)) / (((PRESCALER) + 1) * 1000)))
+
+uint32_t app_timer_cnt_get(void);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff);
+
+#endif
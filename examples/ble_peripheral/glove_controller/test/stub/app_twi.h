@@ -0,0 +1,70 @@
+/* Host stand-in for app_twi.h. The same descriptors as the SDK, implemented by mock_app_twi.c */
+#ifndef APP_TWI_H__
+#define APP_TWI_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nrf_drv_twi.h"
+#include "sdk_errors.h"
+
+#define APP_TWI_NO_STOP                 0x01
+
+#define APP_TWI_TRANSFER(_operation, _p_data, _length, _flags) \
+{                                                              \
+    .p_data    = (uint8_t *)(_p_data),                         \
+    .length    = _length,                                      \
+    .operation = _operation,                                   \
+    .flags     = _flags                                        \
+}
+#define APP_TWI_WRITE_OP(address)       (((address) << 1) | 0)
+#define APP_TWI_READ_OP(address)        (((address) << 1) | 1)
+#define APP_TWI_IS_READ_OP(operation)   ((operation) & 1)
+#define APP_TWI_OP_ADDRESS(operation)   ((operation) >> 1)
+#define APP_TWI_WRITE(address, p_data, length, flags) \
+    APP_TWI_TRANSFER(APP_TWI_WRITE_OP(address), p_data, length, flags)
+#define APP_TWI_READ(address, p_data, length, flags) \
+    APP_TWI_TRANSFER(APP_TWI_READ_OP(address), p_data, length, flags)
+
+typedef void (* app_twi_callback_t)(ret_code_t result, void * p_user_data);
+
+typedef struct
+{
+    uint8_t * p_data;
+    uint8_t   length;
+    uint8_t   operation;
+    uint8_t   flags;
+}app_twi_transfer_t;
+
+typedef struct
+{
+    app_twi_callback_t         callback;
+    void *                     p_user_data;
+    app_twi_transfer_t const * p_transfers;
+    uint8_t                    number_of_transfers;
+}app_twi_transaction_t;
+
+typedef struct
+{
+    app_twi_transaction_t const * * p_queue_buffer;
+    uint8_t                         queue_size;
+    nrf_drv_twi_t const             twi;
+}app_twi_t;
+
+#define APP_TWI_INSTANCE(twi_idx)   { .twi = NRF_DRV_TWI_INSTANCE(twi_idx) }
+
+#define APP_TWI_INIT(p_app_twi, p_twi_config, queue_size, err_code)         \
+    do                                                                      \
+    {                                                                       \
+        static app_twi_transaction_t const * queue_buffer[queue_size + 1];  \
+        err_code = app_twi_init(p_app_twi, p_twi_config,                    \
+                                queue_size, queue_buffer);                  \
+    } while (0)
+
+ret_code_t app_twi_init(app_twi_t * p_app_twi, nrf_drv_twi_config_t const * p_twi_config,
+                        uint8_t queue_size, app_twi_transaction_t const * * p_queue_buffer);
+void       app_twi_uninit(app_twi_t * p_app_twi);
+ret_code_t app_twi_schedule(app_twi_t * p_app_twi, app_twi_transaction_t const * p_transaction);
+ret_code_t app_twi_perform(app_twi_t * p_app_twi, app_twi_transfer_t const * p_transfers,
+                           uint8_t number_of_transfers, void (* user_function)(void));
+
+#endif
@@ -0,0 +1,65 @@
+/* Host stand-in for app_util.h with the macros and encoders the tested modules use */
+#ifndef APP_UTIL_H__
+#define APP_UTIL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nordic_common.h"
+
+#ifndef __STATIC_INLINE
+#define __STATIC_INLINE             static inline
+#endif
+
+#define STATIC_ASSERT(x)            _Static_assert(x, #x)
+#ifndef MIN
+#define MIN(a, b)                   ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b)                   ((a) > (b) ? (a) : (b))
+#endif
+#define ARRAY_SIZE(arr)             (sizeof(arr) / sizeof((arr)[0]))
+#define CEIL_DIV(a, b)              ((((a) - 1) / (b)) + 1)
+#define IS_POWER_OF_TWO(a)          (((a) != 0) && ((((a) - 1) & (a)) == 0))
+#define ROUNDED_DIV(a, b)           (((a) + ((b) / 2)) / (b))
+#define BYTES_TO_WORDS(n_bytes)     (((n_bytes) + 3) >> 2)
+#define ALIGN_NUM(alignment, number) ((number - 1) + alignment - ((number - 1) % alignment))
+#ifndef UNUSED_PARAMETER
+#define UNUSED_PARAMETER(x)         ((void)(x))
+#endif
+#ifndef UNUSED_VARIABLE
+#define UNUSED_VARIABLE(x)          ((void)(x))
+#endif
+
+static inline uint8_t uint16_encode(uint16_t value, uint8_t * p_encoded_data)
+{
+    p_encoded_data[0] = (uint8_t)value;
+    p_encoded_data[1] = (uint8_t)(value >> 8);
+    return sizeof(uint16_t);
+}
+
+static inline uint8_t uint32_encode(uint32_t value, uint8_t * p_encoded_data)
+{
+    p_encoded_data[0] = (uint8_t)value;
+    p_encoded_data[1] = (uint8_t)(value >> 8);
+    p_encoded_data[2] = (uint8_t)(value >> 16);
+    p_encoded_data[3] = (uint8_t)(value >> 24);
+    return sizeof(uint32_t);
+}
+
+static inline uint16_t uint16_decode(const uint8_t * p_encoded_data)
+{
+    return (uint16_t)(p_encoded_data[0] | (p_encoded_data[1] << 8));
+}
+
+static inline uint32_t uint32_decode(const uint8_t * p_encoded_data)
+{
+    return (uint32_t)p_encoded_data[0]          | ((uint32_t)p_encoded_data[1] << 8) |
+           ((uint32_t)p_encoded_data[2] << 16)  | ((uint32_t)p_encoded_data[3] << 24);
+}
+
+static inline bool is_word_aligned(void const * p)
+{
+    return (((uintptr_t)p & 0x03) == 0);
+}
+
+#endif
@@ -0,0 +1,27 @@
+/* Host stand-in for app_util_platform.h. The tests are single threaded, so critical regions are empty.
+ * With TEST_CRITICAL_REGION_HOOKS defined they call functions the test provides instead, so it can
+ * check what runs inside them.
+ */
+#ifndef APP_UTIL_PLATFORM_H__
+#define APP_UTIL_PLATFORM_H__
+
+#include "app_util.h"
+#include "nrf_assert.h"
+
+#define APP_IRQ_PRIORITY_HIGH       2
+#define APP_IRQ_PRIORITY_LOW        3
+#if defined(TEST_CRITICAL_REGION_HOOKS)
+void test_critical_region_enter(void);
+void test_critical_region_exit(void);
+#define CRITICAL_REGION_ENTER()     test_critical_region_enter()
+#define CRITICAL_REGION_EXIT()      test_critical_region_exit()
+#else
+#define CRITICAL_REGION_ENTER()
+#define CRITICAL_REGION_EXIT()
+#endif
+#define CRITICAL_SECTION_ENTER()
+#define CRITICAL_SECTION_EXIT()
+#define ANON_UNIONS_ENABLE
+#define ANON_UNIONS_DISABLE
+
+#endif
@@ -0,0 +1,29 @@
+/* Host stand-in for nrf.h with the nRF51 TIMER registers and the CMSIS intrinsics app_trace.c uses.
+ * TASKS_CAPTURE does nothing, so the test sets the capture registers to the time it wants stamped.
+ */
+#ifndef NRF_H
+#define NRF_H
+
+#include <stdint.h>
+
+typedef struct
+{
+    volatile uint32_t TASKS_START;
+    volatile uint32_t TASKS_CLEAR;
+    volatile uint32_t TASKS_CAPTURE[4];
+    volatile uint32_t MODE;
+    volatile uint32_t BITMODE;
+    volatile uint32_t PRESCALER;
+    volatile uint32_t CC[4];
+}NRF_TIMER_Type;
+
+extern NRF_TIMER_Type test_timer2;
+#define NRF_TIMER2                      (&test_timer2)
+
+#define TIMER_MODE_MODE_Timer           0
+#define TIMER_BITMODE_BITMODE_16Bit     0
+
+#define __get_IPSR()                    0
+#define __DMB()                         __sync_synchronize()
+
+#endif
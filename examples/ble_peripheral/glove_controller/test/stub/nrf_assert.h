@@ -0,0 +1,18 @@
+/* Host stand-in for nrf_assert.h. A failed ASSERT stops the test with the line it failed on */
+#ifndef NRF_ASSERT_H_
+#define NRF_ASSERT_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ASSERT(expr)                                                            \
+if(expr)                                                                        \
+{                                                                               \
+}                                                                               \
+else                                                                            \
+{                                                                               \
+    printf("%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #expr);         \
+    abort();                                                                    \
+}
+
+#endif
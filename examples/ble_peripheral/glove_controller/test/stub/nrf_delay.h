@@ -0,0 +1,10 @@
+/* Host stand-in for nrf_delay.h. The bus model linked into the test moves its clock instead of spinning */
+#ifndef NRF_DELAY_H__
+#define NRF_DELAY_H__
+
+#include <stdint.h>
+
+void nrf_delay_ms(uint32_t ms);
+void nrf_delay_us(uint32_t us);
+
+#endif
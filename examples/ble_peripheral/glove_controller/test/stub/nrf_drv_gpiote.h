@@ -0,0 +1,54 @@
+/* Host stand-in for nrf_drv_gpiote.h. The task outputs are modelled in mock_spi.c, the input pins in
+ * the tests that sense them */
+#ifndef NRF_DRV_GPIOTE_H__
+#define NRF_DRV_GPIOTE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nrf_gpio.h"
+#include "sdk_errors.h"
+
+typedef struct
+{
+    bool        init_state;
+    bool        task_pin;
+}nrf_drv_gpiote_out_config_t;
+
+#define GPIOTE_CONFIG_OUT_TASK_TOGGLE(init_high)    {(init_high), true}
+
+typedef uint32_t nrf_drv_gpiote_pin_t;
+
+typedef enum
+{
+    NRF_GPIOTE_POLARITY_LOTOHI = 1,
+    NRF_GPIOTE_POLARITY_HITOLO,
+    NRF_GPIOTE_POLARITY_TOGGLE
+}nrf_gpiote_polarity_t;
+
+typedef struct
+{
+    nrf_gpiote_polarity_t   sense;
+    nrf_gpio_pin_pull_t     pull;
+    bool                    is_watcher;
+    bool                    hi_accuracy;
+}nrf_drv_gpiote_in_config_t;
+
+#define GPIOTE_CONFIG_IN_SENSE_LOTOHI(hi_accu)      {.sense = NRF_GPIOTE_POLARITY_LOTOHI, .pull = NRF_GPIO_PIN_NOPULL, \
+                                                     .is_watcher = false, .hi_accuracy = (hi_accu)}
+
+typedef void (*nrf_drv_gpiote_evt_handler_t)(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+
+bool nrf_drv_gpiote_is_init(void);
+uint32_t nrf_drv_gpiote_init(void);
+uint32_t nrf_drv_gpiote_out_init(uint32_t pin, nrf_drv_gpiote_out_config_t const * p_config);
+void nrf_drv_gpiote_out_uninit(uint32_t pin);
+void nrf_drv_gpiote_out_task_enable(uint32_t pin);
+uint32_t nrf_drv_gpiote_clr_task_addr_get(uint32_t pin);
+uint32_t nrf_drv_gpiote_set_task_addr_get(uint32_t pin);
+uint32_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, nrf_drv_gpiote_in_config_t const * p_config,
+                                nrf_drv_gpiote_evt_handler_t evt_handler);
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable);
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin);
+bool nrf_drv_gpiote_in_is_set(nrf_drv_gpiote_pin_t pin);
+
+#endif
@@ -0,0 +1,24 @@
+/* Host stand-in for nrf_drv_ppi.h. PPI is modelled in mock_nrf52_dma.c */
+#ifndef NRF_DRV_PPI_H__
+#define NRF_DRV_PPI_H__
+
+#include <stdint.h>
+#include "sdk_errors.h"
+#include "nrf_ppi.h"
+
+uint32_t nrf_drv_ppi_init(void);
+uint32_t nrf_drv_ppi_channel_alloc(nrf_ppi_channel_t * p_channel);
+uint32_t nrf_drv_ppi_channel_free(nrf_ppi_channel_t channel);
+uint32_t nrf_drv_ppi_channel_assign(nrf_ppi_channel_t channel, uint32_t eep, uint32_t tep);
+uint32_t nrf_drv_ppi_channel_fork_assign(nrf_ppi_channel_t channel, uint32_t fork_tep);
+uint32_t nrf_drv_ppi_channel_enable(nrf_ppi_channel_t channel);
+uint32_t nrf_drv_ppi_channel_disable(nrf_ppi_channel_t channel);
+uint32_t nrf_drv_ppi_group_alloc(nrf_ppi_channel_group_t * p_group);
+uint32_t nrf_drv_ppi_group_free(nrf_ppi_channel_group_t group);
+uint32_t nrf_drv_ppi_channel_include_in_group(nrf_ppi_channel_t channel, nrf_ppi_channel_group_t group);
+uint32_t nrf_drv_ppi_group_enable(nrf_ppi_channel_group_t group);
+uint32_t nrf_drv_ppi_group_disable(nrf_ppi_channel_group_t group);
+uint32_t nrf_drv_ppi_task_addr_group_enable_get(nrf_ppi_channel_group_t group);
+uint32_t nrf_drv_ppi_task_addr_group_disable_get(nrf_ppi_channel_group_t group);
+
+#endif
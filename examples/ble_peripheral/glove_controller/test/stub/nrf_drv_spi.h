@@ -0,0 +1,90 @@
+/* Host stand-in for nrf_drv_spi.h. The SPI bus and an MPU on it are modelled in mock_spi.c */
+#ifndef NRF_DRV_SPI_H__
+#define NRF_DRV_SPI_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdk_errors.h"
+
+typedef struct
+{
+    void *      p_registers;
+    uint8_t     drv_inst_idx;
+}nrf_drv_spi_t;
+
+#define NRF_DRV_SPI_INSTANCE(id)                {NULL, (id)}
+#define NRF_DRV_SPI_PIN_NOT_USED                0xFF
+
+typedef enum
+{
+    NRF_DRV_SPI_FREQ_125K   = 0x02000000UL,
+    NRF_DRV_SPI_FREQ_250K   = 0x04000000UL,
+    NRF_DRV_SPI_FREQ_500K   = 0x08000000UL,
+    NRF_DRV_SPI_FREQ_1M     = 0x10000000UL,
+    NRF_DRV_SPI_FREQ_2M     = 0x20000000UL,
+    NRF_DRV_SPI_FREQ_4M     = 0x40000000UL,
+    NRF_DRV_SPI_FREQ_8M     = 0x80000000UL
+}nrf_drv_spi_frequency_t;
+
+typedef enum
+{
+    NRF_DRV_SPI_MODE_0
+}nrf_drv_spi_mode_t;
+
+typedef enum
+{
+    NRF_DRV_SPI_BIT_ORDER_MSB_FIRST
+}nrf_drv_spi_bit_order_t;
+
+typedef struct
+{
+    uint8_t                 sck_pin;
+    uint8_t                 mosi_pin;
+    uint8_t                 miso_pin;
+    uint8_t                 ss_pin;
+    uint8_t                 irq_priority;
+    uint8_t                 orc;
+    nrf_drv_spi_frequency_t frequency;
+    nrf_drv_spi_mode_t      mode;
+    nrf_drv_spi_bit_order_t bit_order;
+}nrf_drv_spi_config_t;
+
+typedef struct
+{
+    uint8_t *   p_tx_buffer;
+    uint8_t     tx_length;
+    uint8_t *   p_rx_buffer;
+    uint8_t     rx_length;
+}nrf_drv_spi_xfer_desc_t;
+
+#define NRF_DRV_SPI_XFER_TRX(p_tx_buf, tx_length, p_rx_buf, rx_length) \
+    {(uint8_t *)(p_tx_buf), (tx_length), (p_rx_buf), (rx_length)}
+
+#define NRF_DRV_SPI_FLAG_TX_POSTINC             (1UL << 0)
+#define NRF_DRV_SPI_FLAG_RX_POSTINC             (1UL << 1)
+#define NRF_DRV_SPI_FLAG_NO_XFER_EVT_HANDLER    (1UL << 2)
+#define NRF_DRV_SPI_FLAG_HOLD_XFER              (1UL << 3)
+#define NRF_DRV_SPI_FLAG_REPEATED_XFER          (1UL << 4)
+
+typedef enum
+{
+    NRF_DRV_SPI_EVENT_DONE
+}nrf_drv_spi_evt_type_t;
+
+typedef struct
+{
+    nrf_drv_spi_evt_type_t  type;
+}nrf_drv_spi_evt_t;
+
+typedef void (* nrf_drv_spi_handler_t)(nrf_drv_spi_evt_t const * p_event);
+
+uint32_t nrf_drv_spi_init(nrf_drv_spi_t const * p_instance, nrf_drv_spi_config_t const * p_config,
+                          nrf_drv_spi_handler_t handler);
+void nrf_drv_spi_uninit(nrf_drv_spi_t const * p_instance);
+uint32_t nrf_drv_spi_transfer(nrf_drv_spi_t const * p_instance, uint8_t const * p_tx_buffer, uint8_t tx_buffer_length,
+                              uint8_t * p_rx_buffer, uint8_t rx_buffer_length);
+uint32_t nrf_drv_spi_xfer(nrf_drv_spi_t const * p_instance, nrf_drv_spi_xfer_desc_t const * p_xfer_desc, uint32_t flags);
+uint32_t nrf_drv_spi_start_task_get(nrf_drv_spi_t const * p_instance);
+uint32_t nrf_drv_spi_end_event_get(nrf_drv_spi_t const * p_instance);
+
+#endif
@@ -0,0 +1,81 @@
+/* Host stand-in for nrf_drv_timer.h. The TIMERs are modelled in mock_nrf52_dma.c and count 1 MHz ticks */
+#ifndef NRF_DRV_TIMER_H__
+#define NRF_DRV_TIMER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sdk_errors.h"
+
+#define TIMER_COUNT         3
+#define TIMER_CC_NUM        4
+
+typedef enum
+{
+    NRF_TIMER_CC_CHANNEL0,
+    NRF_TIMER_CC_CHANNEL1,
+    NRF_TIMER_CC_CHANNEL2,
+    NRF_TIMER_CC_CHANNEL3
+}nrf_timer_cc_channel_t;
+
+typedef enum
+{
+    NRF_TIMER_EVENT_COMPARE0,
+    NRF_TIMER_EVENT_COMPARE1,
+    NRF_TIMER_EVENT_COMPARE2,
+    NRF_TIMER_EVENT_COMPARE3
+}nrf_timer_event_t;
+
+typedef enum
+{
+    NRF_TIMER_TASK_START,
+    NRF_TIMER_TASK_STOP,
+    NRF_TIMER_TASK_COUNT,
+    NRF_TIMER_TASK_CLEAR
+}nrf_timer_task_t;
+
+typedef enum
+{
+    NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK = (1 << 0),
+    NRF_TIMER_SHORT_COMPARE1_CLEAR_MASK = (1 << 1),
+    NRF_TIMER_SHORT_COMPARE2_CLEAR_MASK = (1 << 2),
+    NRF_TIMER_SHORT_COMPARE3_CLEAR_MASK = (1 << 3)
+}nrf_timer_short_mask_t;
+
+typedef enum
+{
+    NRF_TIMER_MODE_TIMER,
+    NRF_TIMER_MODE_COUNTER
+}nrf_timer_mode_t;
+
+typedef struct
+{
+    uint8_t             instance_id;
+}nrf_drv_timer_t;
+
+#define NRF_DRV_TIMER_INSTANCE(id)      { .instance_id = (id) }
+
+typedef struct
+{
+    nrf_timer_mode_t    mode;
+    uint8_t             interrupt_priority;
+    void              * p_context;
+}nrf_drv_timer_config_t;
+
+#define NRF_DRV_TIMER_DEFAULT_CONFIG    { .mode = NRF_TIMER_MODE_TIMER, .interrupt_priority = 6, .p_context = NULL }
+
+typedef void (* nrf_timer_event_handler_t)(nrf_timer_event_t event_type, void * p_context);
+
+ret_code_t nrf_drv_timer_init(nrf_drv_timer_t const * p_instance, nrf_drv_timer_config_t const * p_config,
+                              nrf_timer_event_handler_t timer_event_handler);
+void nrf_drv_timer_uninit(nrf_drv_timer_t const * p_instance);
+void nrf_drv_timer_enable(nrf_drv_timer_t const * p_instance);
+void nrf_drv_timer_disable(nrf_drv_timer_t const * p_instance);
+void nrf_drv_timer_clear(nrf_drv_timer_t const * p_instance);
+uint32_t nrf_drv_timer_capture(nrf_drv_timer_t const * p_instance, nrf_timer_cc_channel_t cc_channel);
+void nrf_drv_timer_extended_compare(nrf_drv_timer_t const * p_instance, nrf_timer_cc_channel_t cc_channel,
+                                    uint32_t cc_value, nrf_timer_short_mask_t timer_short_mask, bool enable_int);
+uint32_t nrf_drv_timer_us_to_ticks(nrf_drv_timer_t const * p_instance, uint32_t time_us);
+uint32_t nrf_drv_timer_event_address_get(nrf_drv_timer_t const * p_instance, nrf_timer_event_t timer_event);
+uint32_t nrf_drv_timer_task_address_get(nrf_drv_timer_t const * p_instance, nrf_timer_task_t timer_task);
+
+#endif
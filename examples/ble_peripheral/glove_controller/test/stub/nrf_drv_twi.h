@@ -0,0 +1,98 @@
+/* Host stand-in for nrf_drv_twi.h with the configuration types nrf_drv_mpu_twi.c uses, and the
+ * transfer API app_mpu_dma.c uses. The transfer functions are in mock_nrf52_dma.c */
+#ifndef NRF_DRV_TWI_H__
+#define NRF_DRV_TWI_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdk_errors.h"
+#include "nrf_twim.h"
+
+#define TWI_COUNT                   2
+#define APP_IRQ_PRIORITY_HIGHEST    1
+
+typedef enum
+{
+    NRF_TWI_FREQ_100K,
+    NRF_TWI_FREQ_250K,
+    NRF_TWI_FREQ_400K
+}nrf_twi_frequency_t;
+
+typedef struct
+{
+    uint32_t            scl;
+    uint32_t            sda;
+    nrf_twi_frequency_t frequency;
+    uint8_t             interrupt_priority;
+}nrf_drv_twi_config_t;
+
+typedef struct
+{
+    union
+    {
+        NRF_TWIM_Type * p_twim;
+    }                   reg;
+    uint8_t             instance_id;
+}nrf_drv_twi_t;
+
+#define NRF_DRV_TWI_INSTANCE(id)    { .reg = { .p_twim = NULL }, .instance_id = (id) }
+
+#define NRF_DRV_TWI_FLAG_TX_POSTINC             (1UL << 0)
+#define NRF_DRV_TWI_FLAG_RX_POSTINC             (1UL << 1)
+#define NRF_DRV_TWI_FLAG_NO_XFER_EVT_HANDLER    (1UL << 2)
+#define NRF_DRV_TWI_FLAG_REPEATED_XFER          (1UL << 3)
+#define NRF_DRV_TWI_FLAG_HOLD_XFER              (1UL << 4)
+#define NRF_DRV_TWI_FLAG_TX_NO_STOP             (1UL << 5)
+
+typedef enum
+{
+    NRF_DRV_TWI_EVT_DONE,
+    NRF_DRV_TWI_EVT_ADDRESS_NACK,
+    NRF_DRV_TWI_EVT_DATA_NACK
+}nrf_drv_twi_evt_type_t;
+
+typedef enum
+{
+    NRF_DRV_TWI_XFER_TX,
+    NRF_DRV_TWI_XFER_RX,
+    NRF_DRV_TWI_XFER_TXRX,
+    NRF_DRV_TWI_XFER_TXTX
+}nrf_drv_twi_xfer_type_t;
+
+typedef struct
+{
+    nrf_drv_twi_xfer_type_t type;
+    uint8_t                 address;
+    uint8_t                 primary_length;
+    uint8_t                 secondary_length;
+    uint8_t               * p_primary_buf;
+    uint8_t               * p_secondary_buf;
+}nrf_drv_twi_xfer_desc_t;
+
+#define NRF_DRV_TWI_XFER_DESC_TXRX(addr, p_tx, tx_len, p_rx, rx_len)    \
+    {                                                                   \
+        .type             = NRF_DRV_TWI_XFER_TXRX,                      \
+        .address          = (addr),                                     \
+        .primary_length   = (tx_len),                                   \
+        .secondary_length = (rx_len),                                   \
+        .p_primary_buf    = (p_tx),                                     \
+        .p_secondary_buf  = (p_rx)                                      \
+    }
+
+typedef struct
+{
+    nrf_drv_twi_evt_type_t  type;
+    nrf_drv_twi_xfer_desc_t xfer_desc;
+}nrf_drv_twi_evt_t;
+
+typedef void (* nrf_drv_twi_evt_handler_t)(nrf_drv_twi_evt_t const * p_event, void * p_context);
+
+ret_code_t nrf_drv_twi_init(nrf_drv_twi_t const * p_instance, nrf_drv_twi_config_t const * p_config,
+                            nrf_drv_twi_evt_handler_t event_handler, void * p_context);
+void nrf_drv_twi_uninit(nrf_drv_twi_t const * p_instance);
+void nrf_drv_twi_enable(nrf_drv_twi_t const * p_instance);
+ret_code_t nrf_drv_twi_xfer(nrf_drv_twi_t const * p_instance, nrf_drv_twi_xfer_desc_t const * p_xfer_desc, uint32_t flags);
+uint32_t nrf_drv_twi_start_task_get(nrf_drv_twi_t const * p_instance, nrf_drv_twi_xfer_type_t xfer_type);
+uint32_t nrf_drv_twi_stopped_event_get(nrf_drv_twi_t const * p_instance);
+
+#endif
@@ -0,0 +1,18 @@
+/* Host stand-in for nrf_gpio.h. The pins the tested modules drive are modelled in the mocks that use them */
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+
+#include <stdint.h>
+
+typedef enum
+{
+    NRF_GPIO_PIN_NOPULL   = 0,
+    NRF_GPIO_PIN_PULLDOWN = 1,
+    NRF_GPIO_PIN_PULLUP   = 3
+}nrf_gpio_pin_pull_t;
+
+void nrf_gpio_pin_set(uint32_t pin_number);
+void nrf_gpio_pin_clear(uint32_t pin_number);
+void nrf_gpio_cfg_output(uint32_t pin_number);
+
+#endif
@@ -0,0 +1,10 @@
+/* Host stand-in for nrf_log.h, for the SDK libraries built into the tests. Logging is compiled out */
+#ifndef NRF_LOG_H_
+#define NRF_LOG_H_
+
+#define NRF_LOG_ERROR(...)
+#define NRF_LOG_WARNING(...)
+#define NRF_LOG_INFO(...)
+#define NRF_LOG_DEBUG(...)
+
+#endif
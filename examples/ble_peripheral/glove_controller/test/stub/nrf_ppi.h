@@ -0,0 +1,28 @@
+/* Host stand-in for nrf_ppi.h. PPI is modelled in mock_nrf52_dma.c */
+#ifndef NRF_PPI_H__
+#define NRF_PPI_H__
+
+#include <stdint.h>
+
+#define PPI_CH_NUM          20
+#define PPI_GROUP_NUM       6
+
+typedef enum
+{
+    NRF_PPI_CHANNEL0 = 0
+}nrf_ppi_channel_t;
+
+typedef enum
+{
+    NRF_PPI_CHANNEL_GROUP0 = 0
+}nrf_ppi_channel_group_t;
+
+typedef enum
+{
+    NRF_PPI_CHANNEL_DISABLED = 0,
+    NRF_PPI_CHANNEL_ENABLED  = 1
+}nrf_ppi_channel_enable_t;
+
+nrf_ppi_channel_enable_t nrf_ppi_channel_enable_get(nrf_ppi_channel_t channel);
+
+#endif
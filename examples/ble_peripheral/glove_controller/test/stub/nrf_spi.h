@@ -0,0 +1,16 @@
+/* Host stand-in for nrf_spi.h. The SPI bus is modelled in mock_spi.c */
+#ifndef NRF_SPI_H__
+#define NRF_SPI_H__
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t    unused;
+}NRF_SPI_Type;
+
+typedef uint32_t nrf_spi_frequency_t;
+
+void nrf_spi_frequency_set(NRF_SPI_Type * p_spi, nrf_spi_frequency_t frequency);
+
+#endif
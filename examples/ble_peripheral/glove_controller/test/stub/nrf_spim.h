@@ -0,0 +1,17 @@
+/* Host stand-in for nrf_spim.h. The SPI bus is modelled in mock_spi.c */
+#ifndef NRF_SPIM_H__
+#define NRF_SPIM_H__
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t    unused;
+}NRF_SPIM_Type;
+
+typedef uint32_t nrf_spim_frequency_t;
+
+void nrf_spim_frequency_set(NRF_SPIM_Type * p_spim, nrf_spim_frequency_t frequency);
+void nrf_spim_rx_buffer_set(NRF_SPIM_Type * p_spim, uint8_t * p_buffer, uint8_t length);
+
+#endif
@@ -0,0 +1,12 @@
+/* Host stand-in for nrf_twim.h. The TWIM is modelled in mock_nrf52_dma.c */
+#ifndef NRF_TWIM_H__
+#define NRF_TWIM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct NRF_TWIM_Type NRF_TWIM_Type;
+
+void nrf_twim_rx_buffer_set(NRF_TWIM_Type * p_reg, uint8_t * p_buffer, uint8_t length);
+
+#endif
@@ -0,0 +1,15 @@
+/* Host stand-in for sdk_common.h, for the SDK libraries built into the tests. The modules are
+ * configured by sdk_config.h of the glove */
+#ifndef SDK_COMMON_H__
+#define SDK_COMMON_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "sdk_config.h"
+#include "nordic_common.h"
+#include "sdk_errors.h"
+#include "app_util.h"
+#include "sdk_macros.h"
+
+#endif
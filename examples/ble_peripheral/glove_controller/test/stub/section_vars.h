@@ -0,0 +1,7 @@
+/* Host stand-in for section_vars.h. Variables registered in a section are plain variables */
+#ifndef SECTION_VARS_H__
+#define SECTION_VARS_H__
+
+#define NRF_SECTION_VARS_REGISTER_VAR(section_name, type_def)   type_def
+
+#endif
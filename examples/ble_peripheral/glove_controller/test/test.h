@@ -0,0 +1,48 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+#ifndef TEST_H__
+#define TEST_H__
+
+/* Minimal checks for the host tests. Each test is a program that returns TEST_RESULT() from main(),
+ * so the Makefile stops at the first test that fails.
+ */
+
+#include <stdio.h>
+
+static int m_test_failures;
+
+#define TEST_CHECK(cond)                                                    \
+    do                                                                      \
+    {                                                                       \
+        if(!(cond))                                                         \
+        {                                                                   \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            m_test_failures++;                                              \
+        }                                                                   \
+    } while(0)
+
+#define TEST_CHECK_EQUAL(expected, actual)                                  \
+    do                                                                      \
+    {                                                                       \
+        long long e_ = (long long)(expected);                               \
+        long long a_ = (long long)(actual);                                 \
+        if(e_ != a_)                                                        \
+        {                                                                   \
+            printf("%s:%d: %s is %lld, expected %lld\n",                    \
+                   __FILE__, __LINE__, #actual, a_, e_);                    \
+            m_test_failures++;                                              \
+        }                                                                   \
+    } while(0)
+
+#define TEST_RESULT()                                                       \
+    (printf("%s: %s\n", __FILE__, (m_test_failures == 0) ? "ok" : "FAILED"), (m_test_failures != 0))
+
+#endif /* TEST_H__ */
+
+/**
+  @}
+*/
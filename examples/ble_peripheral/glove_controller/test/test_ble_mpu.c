@@ -0,0 +1,646 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the MPU service, ble_mpu.c, on the SoftDevice mock. Checks that the notification codec
+ * round trips for every sensor and ATT MTU, that blocks come out of the notifications sample for
+ * sample with the right timestamps, also when the SoftDevice runs out of TX buffers, and that the
+ * subscriptions are picked up from CCCD writes and read back from the CCCDs of a bonded peer on
+ * connect and once the system attributes have been restored.
+ *
+ * Then streams blocks over a saturated link, where connection events carry a few link layer
+ * packets and give the TX buffers back, and reports the sample bytes per second for each ATT MTU
+ * and number of TX buffers. Checks that no sample is lost or sent twice when blocks, single samples,
+ * BLE_EVT_TX_COMPLETE and a disconnect come in while a notification is handed to the SoftDevice,
+ * which is outside the critical regions.
+ *
+ * Built with the ATT MTU of the glove, and with an ATT MTU of 247.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ble.h"
+#include "ble_mpu.h"
+#include "app_mpu_block.h"
+#include "sdk_errors.h"
+#include "mock_softdevice.h"
+#include "test.h"
+
+#define CONN_HANDLE             3
+#define SAMPLE_PERIOD           33      // app_timer ticks, 1 ms at 32768 Hz
+#define MAX_RECEIVED            (4 * APP_MPU_BLOCK_SAMPLES)
+#define CONN_INTERVAL_US        7500
+#define LL_PACKETS_PR_EVENT     6       // Taken by the peer in each connection event
+#define LL_PAYLOAD_LEN          27      // No data length extension on the nRF51
+#define L2CAP_ATT_HEADER_LEN    7       // L2CAP length and channel, ATT opcode and handle
+#define STREAM_BLOCKS           (BLE_MPU_TX_QUEUE_SIZE + 1)
+#define STREAM_US               5000000
+
+typedef union
+{
+    ble_evt_t   evt;
+    uint8_t     raw[sizeof(ble_evt_t) + BLE_CCCD_VALUE_LEN];   // Room for the write data
+}evt_buffer_t;
+
+static ble_mpu_t       m_mpu;
+static uint32_t        m_evt_count;
+static int32_t         m_block_refs;
+static accel_values_t  m_received[MAX_RECEIVED];
+static uint32_t        m_received_timestamps[MAX_RECEIVED];
+static uint16_t        m_received_count;
+static uint32_t        m_critical_depth;
+static bool            m_in_sink;
+static app_mpu_block_t m_blocks[STREAM_BLOCKS];     // Streamed, each reused once the service lets go of it
+static uint32_t        m_produced;                  // Samples put in blocks so far
+static uint32_t        m_next[BLE_MPU_SENSOR_COUNT];// Sample expected next on each block sensor
+static uint32_t        m_sample_bytes;
+static uint16_t        m_in_flight[MOCK_SOFTDEVICE_TX_BUFFERS];    // Link layer packets left of each notification in the SoftDevice
+static uint8_t         m_in_flight_head;
+static uint8_t         m_in_flight_count;
+static uint32_t        m_ll_packets;
+
+
+
+void app_error_handler_bare(uint32_t error_code)
+{
+    TEST_CHECK_EQUAL(NRF_SUCCESS, error_code);
+}
+
+
+
+void app_mpu_block_retain(app_mpu_block_t * p_block)
+{
+    p_block->ref_count++;
+    m_block_refs++;
+}
+
+
+
+void app_mpu_block_release(app_mpu_block_t * p_block)
+{
+    TEST_CHECK(p_block->ref_count > 0);
+    p_block->ref_count--;
+    m_block_refs--;
+}
+
+
+
+void test_critical_region_enter(void)
+{
+    m_critical_depth++;
+}
+
+
+
+void test_critical_region_exit(void)
+{
+    TEST_CHECK(m_critical_depth > 0);
+    m_critical_depth--;
+}
+
+
+
+static void evt_handler(ble_mpu_t * p_mpu)
+{
+    m_evt_count++;
+}
+
+
+
+/**@brief Unpacks the accelerometer notifications the way the central does */
+static void hvx_sink(uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    ble_mpu_packet_header_t header;
+    uint8_t const *         p_samples;
+
+    TEST_CHECK(len <= m_mpu.max_payload_len);
+    TEST_CHECK_EQUAL(0, m_critical_depth);
+    if(handle != m_mpu.char_handles[BLE_MPU_SENSOR_ACCEL].value_handle) return;
+
+    p_samples = ble_mpu_packet_decode(p_data, len, sizeof(accel_values_t), &header);
+    TEST_CHECK(p_samples != NULL);
+    if(p_samples == NULL) return;
+    TEST_CHECK_EQUAL(SAMPLE_PERIOD, header.period);
+    for(uint8_t i = 0; i < header.count && m_received_count < MAX_RECEIVED; i++)
+    {
+        memcpy(&m_received[m_received_count], p_samples + (i * sizeof(accel_values_t)), sizeof(accel_values_t));
+        m_received_timestamps[m_received_count] = header.timestamp + (i * header.period);
+        m_received_count++;
+    }
+}
+
+
+
+static void evt_send(uint16_t evt_id)
+{
+    evt_buffer_t buffer;
+
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.evt.header.evt_id = evt_id;
+    buffer.evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+    ble_mpu_on_ble_evt(&m_mpu, &buffer.evt);
+}
+
+
+
+static void cccd_write(ble_mpu_sensor_t sensor, uint16_t value)
+{
+    evt_buffer_t buffer;
+    ble_gatts_evt_write_t * p_write = &buffer.evt.evt.gatts_evt.params.write;
+
+    memset(&buffer, 0, sizeof(buffer));
+    mock_softdevice_cccd_set(m_mpu.char_handles[sensor].cccd_handle, value);
+    buffer.evt.header.evt_id = BLE_GATTS_EVT_WRITE;
+    buffer.evt.evt.gatts_evt.conn_handle = CONN_HANDLE;
+    p_write->handle = m_mpu.char_handles[sensor].cccd_handle;
+    p_write->len    = uint16_encode(value, p_write->data);
+    ble_mpu_on_ble_evt(&m_mpu, &buffer.evt);
+}
+
+
+
+static void setup(void)
+{
+    ble_mpu_init_t init = {.sample_period = SAMPLE_PERIOD, .evt_handler = evt_handler};
+
+    mock_softdevice_reset();
+    mock_softdevice_hvx_sink_set(hvx_sink);
+    memset(&m_mpu, 0, sizeof(m_mpu));
+    ble_mpu_service_init(&m_mpu, &init);
+    m_evt_count      = 0;
+    m_block_refs     = 0;
+    m_received_count = 0;
+}
+
+
+
+static void test_codec(void)
+{
+    static const uint8_t sizes[] = {sizeof(accel_values_t), sizeof(temp_value_t), sizeof(ble_mpu_quat_t), 1};
+    static const uint16_t mtus[] = {GATT_MTU_SIZE_DEFAULT, 100, NRF_BLE_GATT_MAX_MTU_SIZE};
+    imu_sample_t            samples[APP_MPU_BLOCK_SAMPLES];
+    uint8_t                 packet[BLE_MPU_MAX_PAYLOAD_LEN];
+    ble_mpu_packet_header_t header;
+
+    for(uint16_t i = 0; i < sizeof(samples); i++)
+    {
+        ((uint8_t *)samples)[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    for(uint8_t m = 0; m < ARRAY_SIZE(mtus); m++)
+    {
+        uint16_t max_len = MIN(mtus[m] - 3, BLE_MPU_MAX_PAYLOAD_LEN);
+
+        for(uint8_t s = 0; s < ARRAY_SIZE(sizes); s++)
+        {
+            uint16_t packed;
+            uint16_t expected = MIN(APP_MPU_BLOCK_SAMPLES, (max_len - BLE_MPU_PACKET_HEADER_SIZE) / sizes[s]);
+            uint8_t const * p_first = (uint8_t const *)&samples[1].gyro;
+            uint16_t len = ble_mpu_packet_encode(packet, max_len, 0xABCDEF, SAMPLE_PERIOD, p_first, sizes[s],
+                                                 sizeof(imu_sample_t), APP_MPU_BLOCK_SAMPLES - 1, &packed);
+
+            // As many as fit, strided out of the samples
+            TEST_CHECK_EQUAL(MIN(expected, APP_MPU_BLOCK_SAMPLES - 1), packed);
+            TEST_CHECK_EQUAL(BLE_MPU_PACKET_HEADER_SIZE + (packed * sizes[s]), len);
+            TEST_CHECK(len <= max_len);
+
+            uint8_t const * p_decoded = ble_mpu_packet_decode(packet, len, sizes[s], &header);
+            TEST_CHECK(p_decoded != NULL);
+            if(p_decoded == NULL) continue;
+            TEST_CHECK_EQUAL(0xABCDEF, header.timestamp);
+            TEST_CHECK_EQUAL(SAMPLE_PERIOD, header.period);
+            TEST_CHECK_EQUAL(packed, header.count);
+            for(uint16_t i = 0; i < packed; i++)
+            {
+                TEST_CHECK(memcmp(p_decoded + (i * sizes[s]), p_first + (i * sizeof(imu_sample_t)), sizes[s]) == 0);
+            }
+
+            // A length that does not match the count is refused
+            TEST_CHECK(ble_mpu_packet_decode(packet, len - 1, sizes[s], &header) == NULL);
+            TEST_CHECK(ble_mpu_packet_decode(packet, len + sizes[s], sizes[s], &header) == NULL);
+        }
+    }
+    TEST_CHECK(ble_mpu_packet_decode(packet, BLE_MPU_PACKET_HEADER_SIZE - 1, 1, &header) == NULL);
+}
+
+
+
+static void test_block_send(void)
+{
+    app_mpu_block_t block;
+    mock_softdevice_stats_t stats;
+
+    setup();
+    mock_softdevice_sys_attr_set(true);
+    evt_send(BLE_GAP_EVT_CONNECTED);
+    cccd_write(BLE_MPU_SENSOR_ACCEL, BLE_GATT_HVX_NOTIFICATION);
+    TEST_CHECK_EQUAL(BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_ACCEL), ble_mpu_subscriptions_get(&m_mpu));
+
+    memset(&block, 0, sizeof(block));
+    block.num_samples = APP_MPU_BLOCK_SAMPLES;
+    block.timestamp   = 1000 + ((APP_MPU_BLOCK_SAMPLES - 1) * SAMPLE_PERIOD);
+    for(uint16_t i = 0; i < APP_MPU_BLOCK_SAMPLES; i++)
+    {
+        block.samples[i].accel.x = (int16_t)i;
+        block.samples[i].accel.y = (int16_t)-i;
+        block.samples[i].accel.z = (int16_t)(i * 1000);
+    }
+
+    // With the default ATT MTU two samples fit in each notification. Three TX buffers, then wait
+    mock_softdevice_tx_buffers_set(3);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, ble_mpu_block_send(&m_mpu, &block));
+    TEST_CHECK_EQUAL(6, m_received_count);
+    TEST_CHECK_EQUAL(1, m_block_refs);
+    while(mock_softdevice_tx_in_use() > 0)
+    {
+        mock_softdevice_tx_complete(mock_softdevice_tx_in_use());
+        evt_send(BLE_EVT_TX_COMPLETE);
+    }
+    mock_softdevice_stats_get(&stats);
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_SAMPLES / 2, stats.notifications);
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_SAMPLES, m_received_count);
+    TEST_CHECK_EQUAL(0, m_block_refs);
+    for(uint16_t i = 0; i < APP_MPU_BLOCK_SAMPLES; i++)
+    {
+        TEST_CHECK(memcmp(&block.samples[i].accel, &m_received[i], sizeof(accel_values_t)) == 0);
+        TEST_CHECK_EQUAL(1000 + (i * SAMPLE_PERIOD), m_received_timestamps[i]);
+    }
+
+    // Nobody subscribed to the block sensors
+    cccd_write(BLE_MPU_SENSOR_ACCEL, 0);
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, ble_mpu_block_send(&m_mpu, &block));
+    TEST_CHECK_EQUAL(0, m_block_refs);
+}
+
+
+
+static void test_subscriptions(void)
+{
+    uint8_t both = BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_ACCEL) | BLE_MPU_SENSOR_MASK(BLE_MPU_SENSOR_QUAT);
+
+    // CCCD writes
+    setup();
+    mock_softdevice_sys_attr_set(true);
+    evt_send(BLE_GAP_EVT_CONNECTED);
+    TEST_CHECK_EQUAL(0, ble_mpu_subscriptions_get(&m_mpu));
+    TEST_CHECK_EQUAL(0, m_evt_count);
+    cccd_write(BLE_MPU_SENSOR_ACCEL, BLE_GATT_HVX_NOTIFICATION);
+    cccd_write(BLE_MPU_SENSOR_QUAT, BLE_GATT_HVX_NOTIFICATION);
+    TEST_CHECK_EQUAL(both, ble_mpu_subscriptions_get(&m_mpu));
+    TEST_CHECK_EQUAL(2, m_evt_count);
+    evt_send(BLE_GAP_EVT_DISCONNECTED);
+    TEST_CHECK_EQUAL(0, ble_mpu_subscriptions_get(&m_mpu));
+    TEST_CHECK_EQUAL(3, m_evt_count);
+
+    // A bonded peer reconnects with its CCCDs already restored, and writes nothing
+    evt_send(BLE_GAP_EVT_CONNECTED);
+    TEST_CHECK_EQUAL(both, ble_mpu_subscriptions_get(&m_mpu));
+    TEST_CHECK_EQUAL(4, m_evt_count);
+    evt_send(BLE_GAP_EVT_DISCONNECTED);
+
+    // The system attributes are restored after the connection, when the link is secured
+    mock_softdevice_sys_attr_set(false);
+    evt_send(BLE_GAP_EVT_CONNECTED);
+    TEST_CHECK_EQUAL(0, ble_mpu_subscriptions_get(&m_mpu));
+    mock_softdevice_sys_attr_set(true);
+    ble_mpu_subscriptions_read(&m_mpu);
+    TEST_CHECK_EQUAL(both, ble_mpu_subscriptions_get(&m_mpu));
+
+    // Reading again without a change does not call the handler
+    m_evt_count = 0;
+    ble_mpu_subscriptions_read(&m_mpu);
+    TEST_CHECK_EQUAL(0, m_evt_count);
+    evt_send(BLE_GAP_EVT_DISCONNECTED);
+    ble_mpu_subscriptions_read(&m_mpu);
+    TEST_CHECK_EQUAL(0, ble_mpu_subscriptions_get(&m_mpu));
+}
+
+
+
+/**@brief Checks that the block sensors come out in order, each sample once. Each sample holds its
+ * number in its first value, and is timestamped by it
+ */
+static void stream_sink(uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    ble_mpu_packet_header_t header;
+    uint8_t const *         p_samples;
+
+    TEST_CHECK(!m_in_sink);
+    TEST_CHECK_EQUAL(0, m_critical_depth);
+    TEST_CHECK(len <= m_mpu.max_payload_len);
+
+    m_in_sink = true;
+    m_in_flight[(m_in_flight_head + m_in_flight_count++) % MOCK_SOFTDEVICE_TX_BUFFERS] =
+        CEIL_DIV(len + L2CAP_ATT_HEADER_LEN, LL_PAYLOAD_LEN);
+
+    for(uint8_t sensor = BLE_MPU_SENSOR_ACCEL; sensor <= BLE_MPU_SENSOR_TEMP; sensor++)
+    {
+        uint8_t size = (sensor == BLE_MPU_SENSOR_TEMP) ? sizeof(temp_value_t) : sizeof(accel_values_t);
+
+        if(handle != m_mpu.char_handles[sensor].value_handle) continue;
+
+        p_samples = ble_mpu_packet_decode(p_data, len, size, &header);
+        TEST_CHECK(p_samples != NULL);
+        if(p_samples == NULL) break;
+        TEST_CHECK_EQUAL((m_next[sensor] * SAMPLE_PERIOD) & 0x00FFFFFF, header.timestamp);
+        for(uint8_t i = 0; i < header.count; i++)
+        {
+            uint16_t index = uint16_decode(p_samples + (i * size));
+
+            if(index != (uint16_t)m_next[sensor])
+            {
+                printf("  sensor %u: sample %u, expected %u\n", sensor, index, (uint16_t)m_next[sensor]);
+                TEST_CHECK(false);
+            }
+            m_next[sensor]++;
+        }
+        m_sample_bytes += header.count * size;
+    }
+    m_in_sink = false;
+}
+
+
+
+/**@brief Function for connecting with the block sensors and the quaternion subscribed, at an ATT MTU */
+static void stream_connect(uint16_t att_mtu, uint8_t tx_buffers)
+{
+    nrf_ble_gatt_evt_t gatt_evt = {.conn_handle = CONN_HANDLE, .att_mtu_effective = att_mtu};
+
+    setup();
+    mock_softdevice_hvx_sink_set(stream_sink);
+    mock_softdevice_sys_attr_set(true);
+    mock_softdevice_tx_buffers_set(tx_buffers);
+    evt_send(BLE_GAP_EVT_CONNECTED);
+    for(uint8_t sensor = BLE_MPU_SENSOR_ACCEL; sensor <= BLE_MPU_SENSOR_QUAT; sensor++)
+    {
+        if(sensor != BLE_MPU_SENSOR_MAGN) cccd_write((ble_mpu_sensor_t)sensor, BLE_GATT_HVX_NOTIFICATION);
+    }
+    ble_mpu_on_gatt_evt(&m_mpu, &gatt_evt);
+    TEST_CHECK_EQUAL(MIN(att_mtu - 3, BLE_MPU_MAX_PAYLOAD_LEN), m_mpu.max_payload_len);
+
+    memset(m_blocks, 0, sizeof(m_blocks));
+    memset(m_next, 0, sizeof(m_next));
+    m_produced        = 0;
+    m_sample_bytes    = 0;
+    m_in_flight_head  = 0;
+    m_in_flight_count = 0;
+    m_ll_packets      = 0;
+}
+
+
+
+/**@brief Function for sending the next block, if one is free and the service takes it
+ * @retval  true if a block was sent
+ */
+static bool block_produce(void)
+{
+    app_mpu_block_t * p_block = NULL;
+
+    for(uint8_t i = 0; i < STREAM_BLOCKS && p_block == NULL; i++)
+    {
+        if(m_blocks[i].ref_count == 0) p_block = &m_blocks[i];
+    }
+    if(p_block == NULL) return false;
+
+    p_block->num_samples = APP_MPU_BLOCK_SAMPLES;
+    for(uint16_t i = 0; i < APP_MPU_BLOCK_SAMPLES; i++)
+    {
+        p_block->samples[i].accel.z = (int16_t)(m_produced + i);
+        p_block->samples[i].gyro.z  = (int16_t)(m_produced + i);
+        p_block->samples[i].temp    = (int16_t)(m_produced + i);
+    }
+    p_block->timestamp = (m_produced + APP_MPU_BLOCK_SAMPLES - 1) * SAMPLE_PERIOD;
+
+    // Taken before the send, as the irqs send from inside it. A failed send runs no irqs
+    m_produced += APP_MPU_BLOCK_SAMPLES;
+
+    // Held while it is handed over, as main.c does
+    app_mpu_block_retain(p_block);
+    if(ble_mpu_block_send(&m_mpu, p_block) == NRF_SUCCESS)
+    {
+        app_mpu_block_release(p_block);
+        return true;
+    }
+    m_produced -= APP_MPU_BLOCK_SAMPLES;
+    app_mpu_block_release(p_block);
+    return false;
+}
+
+
+
+/**@brief The peer takes up to LL_PACKETS_PR_EVENT link layer packets. The notifications they
+ * finish give their TX buffers back
+ */
+static void conn_event(void)
+{
+    uint8_t  done    = 0;
+    uint16_t packets = LL_PACKETS_PR_EVENT;
+
+    while(m_in_flight_count > 0 && packets > 0)
+    {
+        uint16_t * p_left = &m_in_flight[m_in_flight_head];
+        uint16_t   sent   = MIN(*p_left, packets);
+
+        *p_left        -= sent;
+        packets        -= sent;
+        m_ll_packets   += sent;
+        if(*p_left == 0)
+        {
+            m_in_flight_head = (m_in_flight_head + 1) % MOCK_SOFTDEVICE_TX_BUFFERS;
+            m_in_flight_count--;
+            done++;
+        }
+    }
+    if(done > 0)
+    {
+        mock_softdevice_tx_complete(done);
+        evt_send(BLE_EVT_TX_COMPLETE);
+    }
+}
+
+
+
+/**@brief Runs connection events until all samples are through, and checks that each got there */
+static void stream_drain(void)
+{
+    for(uint32_t i = 0; i < 1000 && (m_mpu.tx_count > 0 || mock_softdevice_tx_in_use() > 0); i++)
+    {
+        conn_event();
+    }
+    TEST_CHECK_EQUAL(0, m_mpu.tx_count);
+    TEST_CHECK_EQUAL(0, m_block_refs);
+    TEST_CHECK_EQUAL(0, m_critical_depth);
+    for(uint8_t sensor = BLE_MPU_SENSOR_ACCEL; sensor <= BLE_MPU_SENSOR_TEMP; sensor++)
+    {
+        TEST_CHECK_EQUAL(m_produced, m_next[sensor]);
+    }
+}
+
+
+
+/**@brief Blocks are sent as fast as the service takes them */
+static void test_throughput(void)
+{
+    static const uint16_t mtus[]       = {GATT_MTU_SIZE_DEFAULT, 65, 158, 247};
+    static const uint8_t  tx_buffers[] = {1, 3, MOCK_SOFTDEVICE_TX_BUFFERS};
+
+    for(uint8_t m = 0; m < ARRAY_SIZE(mtus); m++)
+    {
+        if(mtus[m] > NRF_BLE_GATT_MAX_MTU_SIZE) continue;
+
+        for(uint8_t b = 0; b < ARRAY_SIZE(tx_buffers); b++)
+        {
+            uint32_t events = STREAM_US / CONN_INTERVAL_US;
+
+            stream_connect(mtus[m], tx_buffers[b]);
+            for(uint32_t event = 0; event < events; event++)
+            {
+                while(block_produce())
+                {
+                }
+                conn_event();
+            }
+            printf("  ATT MTU %3u, %u TX buffers: %6u sample bytes/s, %3u%% of the link layer packets\n",
+                   mtus[m], tx_buffers[b], (unsigned)(m_sample_bytes / (STREAM_US / 1000000)),
+                   (unsigned)(m_ll_packets * 100 / (events * LL_PACKETS_PR_EVENT)));
+
+            // With a TX buffer per link layer packet of a connection event the link is kept full
+            if(tx_buffers[b] >= LL_PACKETS_PR_EVENT)
+            {
+                TEST_CHECK(m_ll_packets * 100 >= events * LL_PACKETS_PR_EVENT * 98);
+            }
+            stream_drain();
+        }
+    }
+}
+
+
+
+/**@brief Blocks from a higher priority, quaternions and the TX_COMPLETE event come in while the
+ * SoftDevice is called. A block takes some 20 notifications, so the blocks come in slower than
+ * the notifications go, or the service would never catch up
+ */
+static void preempt_irq(void)
+{
+    static uint32_t count;
+    ble_mpu_quat_t  quat = {0};
+
+    count++;
+    if(count % 32 == 0)
+    {
+        (void)block_produce();
+    }
+    if(count % 3 == 0)
+    {
+        conn_event();
+    }
+    if(count % 5 == 0)
+    {
+        (void)ble_mpu_sample_send(&m_mpu, BLE_MPU_SENSOR_QUAT, &quat, 0);
+    }
+}
+
+
+
+static void test_preempt(void)
+{
+    stream_connect(NRF_BLE_GATT_MAX_MTU_SIZE, MOCK_SOFTDEVICE_TX_BUFFERS);
+    mock_softdevice_hvx_irq_set(preempt_irq);
+    for(uint32_t event = 0; event < 1000; event++)
+    {
+        (void)block_produce();
+        conn_event();
+    }
+    mock_softdevice_hvx_irq_set(NULL);
+    printf("  preempted: %u samples through\n", (unsigned)m_produced);
+    TEST_CHECK(m_produced > 0);
+    stream_drain();
+}
+
+
+
+/**@brief All TX buffers come back while the notification that found none is still in the SoftDevice */
+static void tx_complete_irq(void)
+{
+    mock_softdevice_hvx_irq_set(NULL);
+    m_in_flight_count = 0;
+    mock_softdevice_tx_complete(MOCK_SOFTDEVICE_TX_BUFFERS);
+    evt_send(BLE_EVT_TX_COMPLETE);
+}
+
+
+
+static void test_tx_complete_race(void)
+{
+    mock_softdevice_stats_t stats;
+
+    // A block takes more notifications than there are TX buffers
+    stream_connect(GATT_MTU_SIZE_DEFAULT, MOCK_SOFTDEVICE_TX_BUFFERS);
+    TEST_CHECK(block_produce());
+    TEST_CHECK_EQUAL(MOCK_SOFTDEVICE_TX_BUFFERS, mock_softdevice_tx_in_use());
+
+    // The next block finds no TX buffers, and the event that gives them back is turned away
+    mock_softdevice_hvx_irq_set(tx_complete_irq);
+    TEST_CHECK(block_produce());
+    mock_softdevice_stats_get(&stats);
+    TEST_CHECK(stats.no_tx_packets > 0);
+
+    // It must not wait for a TX_COMPLETE that is not coming
+    TEST_CHECK_EQUAL(MOCK_SOFTDEVICE_TX_BUFFERS, mock_softdevice_tx_in_use());
+    stream_drain();
+}
+
+
+
+/**@brief The link goes down while a notification is in the SoftDevice */
+static void disconnect_irq(void)
+{
+    mock_softdevice_hvx_irq_set(NULL);
+    evt_send(BLE_GAP_EVT_DISCONNECTED);
+
+    // The queue is flushed, but the block being sent is held by the producer and the claim until the result is committed
+    TEST_CHECK_EQUAL(0, m_mpu.tx_count);
+    TEST_CHECK_EQUAL(2, m_block_refs);
+}
+
+
+
+static void test_disconnect(void)
+{
+    stream_connect(GATT_MTU_SIZE_DEFAULT, MOCK_SOFTDEVICE_TX_BUFFERS);
+    mock_softdevice_hvx_irq_set(disconnect_irq);
+    TEST_CHECK(block_produce());
+    TEST_CHECK(block_produce() == false);
+
+    // The queued blocks and the one being sent are all let go of
+    TEST_CHECK_EQUAL(0, m_mpu.tx_count);
+    TEST_CHECK_EQUAL(0, m_block_refs);
+    TEST_CHECK(!m_mpu.tx_busy);
+    TEST_CHECK_EQUAL(0, m_critical_depth);
+
+    // Nothing left over for the next connection
+    stream_connect(GATT_MTU_SIZE_DEFAULT, MOCK_SOFTDEVICE_TX_BUFFERS);
+    TEST_CHECK(block_produce());
+    stream_drain();
+}
+
+
+
+int main(void)
+{
+    test_codec();
+    test_block_send();
+    test_subscriptions();
+    test_throughput();
+    test_preempt();
+    test_tx_complete_race();
+    test_disconnect();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
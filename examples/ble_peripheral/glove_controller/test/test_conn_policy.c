@@ -0,0 +1,303 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the connection policy, ble_conn_policy.c, set up as main.c sets it up. A motion trace of
+ * still and moving calibration windows decides the motion the way conn_policy_update() does, and a
+ * scripted central answers each request with BLE_GAP_EVT_CONN_PARAM_UPDATE a few windows later.
+ * At each step it checks the parameters requested, ble_conn_policy_interval_get() and the FIFO
+ * drain period conn_policy_evt_handler() takes from ble_conn_policy_batch_period_get().
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ble.h"
+#include "ble_conn_params.h"
+#include "ble_conn_policy.h"
+#include "nrf_error.h"
+#include "test.h"
+
+// Connection parameters of main.c, in 1.25 ms and 10 ms units
+#define ACTIVE_MIN_INTERVAL     6                                           // 7.5 ms
+#define ACTIVE_MAX_INTERVAL     12                                          // 15 ms
+#define IDLE_MIN_INTERVAL       160                                         // 200 ms
+#define IDLE_MAX_INTERVAL       320                                         // 400 ms
+#define IDLE_SLAVE_LATENCY      4
+#define IDLE_STILL_WINDOWS      4
+#define DRAIN_MIN_US            20000                                       // MPU_DRAIN_INTERVAL_MIN_MS
+#define DRAIN_MAX_US            100000                                      // MPU_DRAIN_INTERVAL_MS
+
+#define WINDOW_MS               640                                         // APP_MPU_CALIB_WINDOW samples of 10 ms
+#define CONN_HANDLE             3
+
+/**@brief What a central does with a request */
+typedef struct
+{
+    char const *    name;
+    uint16_t        floor;              // Shortest interval it grants, in 1.25 ms units. Requests below are refused
+    uint8_t         delay;              // Windows before it answers
+}central_t;
+
+static ble_gap_conn_params_t const m_active = {ACTIVE_MIN_INTERVAL, ACTIVE_MAX_INTERVAL, 0, 400};
+static ble_gap_conn_params_t const m_idle   = {IDLE_MIN_INTERVAL, IDLE_MAX_INTERVAL, IDLE_SLAVE_LATENCY, 600};
+
+static ble_conn_policy_t        m_policy;
+static ble_gap_conn_params_t    m_requested;
+static uint32_t                 m_requests;
+static uint32_t                 m_handler_calls;
+static uint32_t                 m_handler_interval_us;
+static uint16_t                 m_handler_latency;
+static uint32_t                 m_drain_us;
+
+
+
+// Stands in for ble_conn_params, which would send the request to the central
+uint32_t ble_conn_params_change_conn_params(ble_gap_conn_params_t * new_params)
+{
+    m_requested = *new_params;
+    m_requests++;
+    return NRF_SUCCESS;
+}
+
+
+
+// conn_policy_evt_handler() of main.c without the timer restart
+static void policy_evt_handler(ble_conn_policy_t * p_policy, uint32_t interval_us, uint16_t slave_latency)
+{
+    m_handler_calls++;
+    m_handler_interval_us = interval_us;
+    m_handler_latency     = slave_latency;
+    m_drain_us            = ble_conn_policy_batch_period_get(p_policy, DRAIN_MIN_US, DRAIN_MAX_US);
+}
+
+
+
+static void gap_evt_send(uint16_t evt_id, uint16_t interval, uint16_t slave_latency)
+{
+    ble_evt_t             evt;
+    ble_gap_conn_params_t params = {interval, interval, slave_latency, 400};
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id          = evt_id;
+    evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+    if(evt_id == BLE_GAP_EVT_CONNECTED)
+    {
+        evt.evt.gap_evt.params.connected.conn_params = params;
+    }
+    else if(evt_id == BLE_GAP_EVT_CONN_PARAM_UPDATE)
+    {
+        evt.evt.gap_evt.params.conn_param_update.conn_params = params;
+    }
+    ble_conn_policy_on_ble_evt(&m_policy, &evt);
+}
+
+
+
+static bool is_requested(ble_gap_conn_params_t const * p_params)
+{
+    return memcmp(&m_requested, p_params, sizeof(m_requested)) == 0;
+}
+
+
+
+// The central's answer to a request: the shortest interval in it that it allows, 0 if it refuses
+static uint16_t grant(central_t const * p_central, ble_gap_conn_params_t const * p_params)
+{
+    if(p_central->floor > p_params->max_conn_interval) return 0;
+
+    return (p_central->floor > p_params->min_conn_interval) ? p_central->floor : p_params->min_conn_interval;
+}
+
+
+
+// Each step of the glove's life once, with a central that grants what is asked for
+static void test_steps(void)
+{
+    ble_conn_policy_init(&m_policy, &m_active, &m_idle, policy_evt_handler);
+
+    // Not connected: nothing is requested, and drains run at the longest period
+    TEST_CHECK_EQUAL(NRF_SUCCESS, ble_conn_policy_motion_set(&m_policy, false));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, ble_conn_policy_motion_set(&m_policy, true));
+    TEST_CHECK_EQUAL(0, m_requests);
+    TEST_CHECK_EQUAL(0, ble_conn_policy_interval_get(&m_policy));
+    TEST_CHECK_EQUAL(DRAIN_MAX_US, ble_conn_policy_batch_period_get(&m_policy, DRAIN_MIN_US, DRAIN_MAX_US));
+
+    // The central connects with 50 ms. The hand counts as moving, so the active parameters are asked for
+    gap_evt_send(BLE_GAP_EVT_CONNECTED, 40, 0);
+    TEST_CHECK_EQUAL(1, m_handler_calls);
+    TEST_CHECK_EQUAL(50000, m_handler_interval_us);
+    TEST_CHECK_EQUAL(50000, ble_conn_policy_interval_get(&m_policy));
+    TEST_CHECK_EQUAL(50000, m_drain_us);
+    TEST_CHECK_EQUAL(1, m_requests);
+    TEST_CHECK(is_requested(&m_active));
+
+    // 7.5 ms granted. Faster than the drains can usefully follow, so they stay at 20 ms
+    gap_evt_send(BLE_GAP_EVT_CONN_PARAM_UPDATE, ACTIVE_MIN_INTERVAL, 0);
+    TEST_CHECK_EQUAL(2, m_handler_calls);
+    TEST_CHECK_EQUAL(7500, ble_conn_policy_interval_get(&m_policy));
+    TEST_CHECK_EQUAL(DRAIN_MIN_US, m_drain_us);
+
+    // Telling it the same motion again does not ask again
+    TEST_CHECK_EQUAL(NRF_SUCCESS, ble_conn_policy_motion_set(&m_policy, true));
+    TEST_CHECK_EQUAL(1, m_requests);
+
+    // Still: the idle parameters, with slave latency
+    TEST_CHECK_EQUAL(NRF_SUCCESS, ble_conn_policy_motion_set(&m_policy, false));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, ble_conn_policy_motion_set(&m_policy, false));
+    TEST_CHECK_EQUAL(2, m_requests);
+    TEST_CHECK(is_requested(&m_idle));
+
+    // Until the central answers, the 7.5 ms interval stays in use
+    TEST_CHECK_EQUAL(7500, ble_conn_policy_interval_get(&m_policy));
+    gap_evt_send(BLE_GAP_EVT_CONN_PARAM_UPDATE, IDLE_MIN_INTERVAL, IDLE_SLAVE_LATENCY);
+    TEST_CHECK_EQUAL(3, m_handler_calls);
+    TEST_CHECK_EQUAL(200000, m_handler_interval_us);
+    TEST_CHECK_EQUAL(IDLE_SLAVE_LATENCY, m_handler_latency);
+    TEST_CHECK_EQUAL(DRAIN_MAX_US, m_drain_us);
+
+    // An update that changes nothing the glove uses is not reported. A latency change is
+    gap_evt_send(BLE_GAP_EVT_CONN_PARAM_UPDATE, IDLE_MIN_INTERVAL, IDLE_SLAVE_LATENCY);
+    TEST_CHECK_EQUAL(3, m_handler_calls);
+    gap_evt_send(BLE_GAP_EVT_CONN_PARAM_UPDATE, IDLE_MIN_INTERVAL, 0);
+    TEST_CHECK_EQUAL(4, m_handler_calls);
+    TEST_CHECK_EQUAL(0, m_handler_latency);
+
+    // Moving again
+    TEST_CHECK_EQUAL(NRF_SUCCESS, ble_conn_policy_motion_set(&m_policy, true));
+    TEST_CHECK_EQUAL(3, m_requests);
+    TEST_CHECK(is_requested(&m_active));
+    gap_evt_send(BLE_GAP_EVT_CONN_PARAM_UPDATE, ACTIVE_MAX_INTERVAL, 0);
+    TEST_CHECK_EQUAL(15000, ble_conn_policy_interval_get(&m_policy));
+    TEST_CHECK_EQUAL(DRAIN_MIN_US, m_drain_us);
+
+    // The central's own 62.5 ms lies between the limits and is followed as is
+    gap_evt_send(BLE_GAP_EVT_CONN_PARAM_UPDATE, 50, 0);
+    TEST_CHECK_EQUAL(62500, m_drain_us);
+
+    // Disconnected: the handler gets 0 and the drains fall back to the longest period
+    gap_evt_send(BLE_GAP_EVT_DISCONNECTED, 0, 0);
+    TEST_CHECK_EQUAL(0, m_handler_interval_us);
+    TEST_CHECK_EQUAL(0, ble_conn_policy_interval_get(&m_policy));
+    TEST_CHECK_EQUAL(DRAIN_MAX_US, m_drain_us);
+
+    // The hand stops while disconnected. Nothing is sent, but the next connection asks for idle at once
+    TEST_CHECK_EQUAL(NRF_SUCCESS, ble_conn_policy_motion_set(&m_policy, false));
+    TEST_CHECK_EQUAL(3, m_requests);
+    gap_evt_send(BLE_GAP_EVT_CONNECTED, 24, 0);
+    TEST_CHECK_EQUAL(4, m_requests);
+    TEST_CHECK(is_requested(&m_idle));
+    TEST_CHECK_EQUAL(30000, m_drain_us);
+    gap_evt_send(BLE_GAP_EVT_DISCONNECTED, 0, 0);
+}
+
+
+
+// A motion trace of calibration windows, 'M' moving and 'S' still, through conn_policy_update() and a
+// central. Reports the time spent at each drain period
+static void trace_run(central_t const * p_central, char const * p_trace, uint32_t * p_requests_out)
+{
+    uint16_t    still_windows = 0;
+    uint32_t    requests      = 0;
+    uint32_t    transitions   = 0;
+    uint32_t    short_ms      = 0;                              // Draining at DRAIN_MIN_US
+    uint32_t    long_ms       = 0;                              // Draining at DRAIN_MAX_US
+    uint32_t    other_ms      = 0;
+    int32_t     answer_in     = -1;                             // Windows until the central answers
+    bool        moving        = true;
+
+    ble_conn_policy_init(&m_policy, &m_active, &m_idle, policy_evt_handler);
+    m_requests = 0;
+    gap_evt_send(BLE_GAP_EVT_CONNECTED, 40, 0);
+    if(m_requests > 0)
+    {
+        answer_in = p_central->delay;
+    }
+
+    for(char const * p = p_trace; *p != '\0'; p++)
+    {
+        uint32_t requests_before = m_requests;
+        bool     was_moving      = moving;
+
+        still_windows = (*p == 'S') ? still_windows + 1 : 0;
+        moving        = (still_windows < IDLE_STILL_WINDOWS);
+        TEST_CHECK_EQUAL(NRF_SUCCESS, ble_conn_policy_motion_set(&m_policy, moving));
+
+        // Asked exactly when the motion changes, for the parameters of the new motion
+        TEST_CHECK_EQUAL((moving != was_moving) ? 1 : 0, m_requests - requests_before);
+        if(moving != was_moving)
+        {
+            transitions++;
+            TEST_CHECK(is_requested(moving ? &m_active : &m_idle));
+            answer_in = p_central->delay;
+        }
+
+        if(answer_in == 0 && grant(p_central, &m_requested) != 0)
+        {
+            uint16_t interval = grant(p_central, &m_requested);
+            gap_evt_send(BLE_GAP_EVT_CONN_PARAM_UPDATE, interval, m_requested.slave_latency);
+            TEST_CHECK_EQUAL((uint32_t)interval * 1250, ble_conn_policy_interval_get(&m_policy));
+        }
+        if(answer_in >= 0) answer_in--;
+
+        // The drains follow what is in use, never what was asked for
+        uint32_t expected = ble_conn_policy_interval_get(&m_policy);
+        if(expected < DRAIN_MIN_US) expected = DRAIN_MIN_US;
+        if(expected > DRAIN_MAX_US) expected = DRAIN_MAX_US;
+        TEST_CHECK_EQUAL(expected, m_drain_us);
+        TEST_CHECK(m_drain_us >= DRAIN_MIN_US && m_drain_us <= DRAIN_MAX_US);
+
+        if(m_drain_us == DRAIN_MIN_US)      short_ms += WINDOW_MS;
+        else if(m_drain_us == DRAIN_MAX_US) long_ms  += WINDOW_MS;
+        else                                other_ms += WINDOW_MS;
+    }
+    requests = m_requests;
+    TEST_CHECK_EQUAL(transitions + 1, requests);                // One on connection, then one per change
+
+    printf("  %-8s %u requests, %u ms in use at the end, drains of 20 ms for %u ms, 100 ms for %u ms, other %u ms\n",
+           p_central->name, (unsigned)requests, (unsigned)(ble_conn_policy_interval_get(&m_policy) / 1000),
+           (unsigned)short_ms, (unsigned)long_ms, (unsigned)other_ms);
+    *p_requests_out = requests;
+}
+
+
+
+static void test_trace(void)
+{
+    // Typing, a pause, reaching and pointing, a long rest with a twitch that must not ask, then moving again
+    static char const trace[] = "MMMMMMSSSMMMSSSSSSSSSSMMMMMMMMSSSSSSSSSSSSSSSSSSSSSSSSSSSSMSSSSSSSSSSSSSMMMMMM";
+    static const central_t centrals[] =
+    {
+        {"fast",     6,   1},                   // Grants anything, the shortest it is allowed
+        {"15 ms",    12,  2},                   // Grants 15 ms while moving
+        {"30 ms",    24,  2},                   // Refuses the active parameters, so moving keeps the interval in use
+        {"refuses",  400, 0},                   // Keeps the 50 ms it connected with
+    };
+    uint32_t requests[4];
+
+    for(uint8_t i = 0; i < 4; i++)
+    {
+        trace_run(&centrals[i], trace, &requests[i]);
+    }
+
+    // The requests only depend on the trace, not on the answers
+    TEST_CHECK_EQUAL(requests[0], requests[1]);
+    TEST_CHECK_EQUAL(requests[0], requests[2]);
+    TEST_CHECK_EQUAL(requests[0], requests[3]);
+    TEST_CHECK_EQUAL(7, requests[0]);
+}
+
+
+
+int main(void)
+{
+    test_steps();
+    test_trace();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
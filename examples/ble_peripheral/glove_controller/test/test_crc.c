@@ -0,0 +1,177 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Equivalence test and benchmark of the CRC16 and CRC32 implementations in the SDK, one build per
+ * CRC16_CONFIG_IMPLEMENTATION and CRC32_CONFIG_IMPLEMENTATION. Each is checked against the bitwise
+ * loops the SDK had before the tables, copied below: every byte from every 16 bit CRC16 state and
+ * from 64k CRC32 states, all lengths up to 300 at every alignment, and blocks fed in over several
+ * calls. Then both are timed on 4 kB blocks against the bitwise loops.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "crc16.h"
+#include "crc32.h"
+#include "test.h"
+
+#define MAX_LENGTH              300
+#define MAX_OFFSET              8
+#define BENCH_SIZE              4096
+#define BENCH_ROUNDS            2000
+
+static uint8_t  m_data[BENCH_SIZE + MAX_OFFSET];
+
+
+
+/**@brief crc16_compute() as it was, bit by bit */
+static uint16_t crc16_ref(uint8_t const * p_data, uint32_t size, uint16_t const * p_crc)
+{
+    uint16_t crc = (p_crc == NULL) ? 0xFFFF : *p_crc;
+
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc  = (uint8_t)(crc >> 8) | (crc << 8);
+        crc ^= p_data[i];
+        crc ^= (uint8_t)(crc & 0xFF) >> 4;
+        crc ^= (crc << 8) << 4;
+        crc ^= ((crc & 0xFF) << 4) << 1;
+    }
+
+    return crc;
+}
+
+
+
+/**@brief crc32_compute() as it was, bit by bit */
+static uint32_t crc32_ref(uint8_t const * p_data, uint32_t size, uint32_t const * p_crc)
+{
+    uint32_t crc;
+
+    crc = (p_crc == NULL) ? 0xFFFFFFFF : ~(*p_crc);
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc = crc ^ p_data[i];
+        for (uint32_t j = 8; j > 0; j--)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320U & ((crc & 1) ? 0xFFFFFFFF : 0));
+        }
+    }
+    return ~crc;
+}
+
+
+
+/**@brief Every byte from every state. One byte is one lookup in the first table, so this checks all of it */
+static void test_bytes(void)
+{
+    uint32_t failures16 = 0;
+    uint32_t failures32 = 0;
+
+    for(uint32_t state = 0; state <= 0xFFFF; state++)
+    {
+        uint16_t crc16 = (uint16_t)state;
+        uint32_t crc32 = state * 0x9E3779B9U;   // Spread over all 32 bits
+
+        for(uint32_t byte = 0; byte <= 0xFF; byte++)
+        {
+            uint8_t data = (uint8_t)byte;
+
+            failures16 += (crc16_compute(&data, 1, &crc16) != crc16_ref(&data, 1, &crc16));
+            failures32 += (crc32_compute(&data, 1, &crc32) != crc32_ref(&data, 1, &crc32));
+        }
+    }
+    TEST_CHECK_EQUAL(0, failures16);
+    TEST_CHECK_EQUAL(0, failures32);
+}
+
+
+
+/**@brief All lengths at all alignments, so the word loop and the bytes before and after it are covered */
+static void test_blocks(void)
+{
+    uint32_t failures = 0;
+
+    for(uint32_t offset = 0; offset < MAX_OFFSET; offset++)
+    {
+        for(uint32_t length = 0; length <= MAX_LENGTH; length++)
+        {
+            uint8_t const * p_data = &m_data[offset];
+            uint32_t        split  = length / 3;
+            uint16_t        crc16  = crc16_compute(p_data, split, NULL);
+            uint32_t        crc32  = crc32_compute(p_data, split, NULL);
+
+            failures += (crc16_compute(p_data, length, NULL) != crc16_ref(p_data, length, NULL));
+            failures += (crc32_compute(p_data, length, NULL) != crc32_ref(p_data, length, NULL));
+
+            // In two calls, the second starting unaligned
+            crc16 = crc16_compute(p_data + split, length - split, &crc16);
+            crc32 = crc32_compute(p_data + split, length - split, &crc32);
+            failures += (crc16 != crc16_ref(p_data, length, NULL));
+            failures += (crc32 != crc32_ref(p_data, length, NULL));
+        }
+    }
+    TEST_CHECK_EQUAL(0, failures);
+
+    // The check values of CRC-16/CCITT-FALSE and CRC-32
+    TEST_CHECK_EQUAL(0x29B1, crc16_compute((uint8_t const *)"123456789", 9, NULL));
+    TEST_CHECK_EQUAL(0xCBF43926, crc32_compute((uint8_t const *)"123456789", 9, NULL));
+}
+
+
+
+static double seconds(clock_t start)
+{
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+
+static void bench(void)
+{
+    volatile uint32_t sink = 0;
+    double            ref16;
+    double            ref32;
+    double            time16;
+    double            time32;
+    double            mbytes = (double)BENCH_SIZE * BENCH_ROUNDS / 1e6;
+    clock_t           start;
+
+    start = clock();
+    for(uint32_t i = 0; i < BENCH_ROUNDS; i++) sink += crc16_ref(m_data, BENCH_SIZE, NULL);
+    ref16 = seconds(start);
+    start = clock();
+    for(uint32_t i = 0; i < BENCH_ROUNDS; i++) sink += crc16_compute(m_data, BENCH_SIZE, NULL);
+    time16 = seconds(start);
+    start = clock();
+    for(uint32_t i = 0; i < BENCH_ROUNDS; i++) sink += crc32_ref(m_data, BENCH_SIZE, NULL);
+    ref32 = seconds(start);
+    start = clock();
+    for(uint32_t i = 0; i < BENCH_ROUNDS; i++) sink += crc32_compute(m_data, BENCH_SIZE, NULL);
+    time32 = seconds(start);
+    (void)sink;
+
+    printf("  implementation %d: crc16 %.0f MB/s, %.1fx bitwise. crc32 %.0f MB/s, %.1fx bitwise\n",
+           CRC16_CONFIG_IMPLEMENTATION, mbytes / time16, ref16 / time16, mbytes / time32, ref32 / time32);
+}
+
+
+
+int main(void)
+{
+    srand(1);
+    for(uint32_t i = 0; i < sizeof(m_data); i++) m_data[i] = (uint8_t)rand();
+
+    test_bytes();
+    test_blocks();
+    bench();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,313 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the record lookups of FDS on the fstorage mock, one build with the RAM index off, one
+ * with an index too small for the records and one that holds them all. Writes 500 records in 10
+ * files, then updates and deletes some, deletes a file and runs garbage collection, and after each
+ * step checks that fds_record_find() and fds_record_find_in_file() find exactly the records that
+ * should be there, with their data. Then times lookups by file ID and key.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "fds.h"
+#include "mock_fstorage.h"
+#include "test.h"
+
+#define NUM_RECORDS             500
+#define NUM_CHANGES             100
+#define NUM_FILES               10
+#define NUM_KEYS                50
+#define KEY_UPDATED             (NUM_KEYS + 1)
+#define BENCH_ROUNDS            200
+
+/**@brief A record as the test expects to find it */
+typedef struct
+{
+    uint32_t    record_id;
+    uint16_t    file_id;
+    uint16_t    key;
+    bool        live;
+    bool        found;
+}record_t;
+
+static record_t     m_records[NUM_RECORDS + NUM_CHANGES + NUM_FILES];
+static uint16_t     m_num_records;
+static uint32_t     m_data[NUM_RECORDS + NUM_CHANGES + NUM_FILES];  // Record i holds m_data[i] = i
+static uint32_t     m_evts;
+static uint32_t     m_evt_errors;
+
+
+
+static void fds_evt_handler(fds_evt_t const * const p_evt)
+{
+    if(p_evt->result != FDS_SUCCESS)
+    {
+        printf("  event %d failed with %u\n", p_evt->id, (unsigned)p_evt->result);
+        m_evt_errors++;
+    }
+    m_evts++;
+}
+
+
+
+/**@brief Function for writing a record of the model, and running flash until it is done */
+static void record_write(uint16_t file_id, uint16_t key)
+{
+    uint16_t            i     = m_num_records++;
+    fds_record_chunk_t  chunk = {.p_data = &m_data[i], .length_words = 1};
+    fds_record_t        record =
+    {
+        .file_id = file_id,
+        .key     = key,
+        .data    = {.p_chunks = &chunk, .num_chunks = 1},
+    };
+    fds_record_desc_t   desc;
+
+    m_data[i] = i;
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_record_write(&desc, &record));
+    mock_fstorage_run();
+    m_records[i] = (record_t){.record_id = desc.record_id, .file_id = file_id, .key = key, .live = true};
+}
+
+
+
+static record_t * record_get(uint32_t record_id)
+{
+    for(uint16_t i = 0; i < m_num_records; i++)
+    {
+        if(m_records[i].record_id == record_id) return &m_records[i];
+    }
+    return NULL;
+}
+
+
+
+/**@brief Function for checking a record found against the model, and marking it found */
+static void record_check(fds_record_desc_t * p_desc, uint16_t file_id, uint16_t key, uint32_t * p_errors)
+{
+    record_t          * p_record = record_get(p_desc->record_id);
+    fds_flash_record_t  flash_record;
+
+    if((p_record == NULL) || !p_record->live || p_record->found ||
+       (p_record->file_id != file_id) || ((key != 0) && (p_record->key != key)))
+    {
+        (*p_errors)++;
+        return;
+    }
+    p_record->found = true;
+
+    if(fds_record_open(p_desc, &flash_record) != FDS_SUCCESS)
+    {
+        (*p_errors)++;
+        return;
+    }
+    if((flash_record.p_header->tl.record_key != p_record->key) ||
+       (flash_record.p_header->ic.file_id != file_id) ||
+       (*(uint32_t const *)flash_record.p_data != (uint32_t)(p_record - m_records)))
+    {
+        (*p_errors)++;
+    }
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_record_close(p_desc));
+}
+
+
+
+/**@brief Function for checking that every lookup finds the live records of the model, each once
+ * and nothing else. Key 0 means all of the file
+ */
+static void records_check(char const * p_step)
+{
+    uint32_t              errors  = 0;
+    uint32_t              missing = 0;
+    uint32_t              live    = 0;
+    mock_fstorage_stats_t stats;
+
+    for(uint16_t file_id = 1; file_id <= NUM_FILES + 1; file_id++)
+    {
+        for(uint16_t key = 0; key <= KEY_UPDATED + 1; key++)
+        {
+            fds_find_token_t  token = {0};
+            fds_record_desc_t desc;
+
+            for(uint16_t i = 0; i < m_num_records; i++) m_records[i].found = false;
+            if(key == 0)
+            {
+                while(fds_record_find_in_file(file_id, &desc, &token) == FDS_SUCCESS)
+                {
+                    record_check(&desc, file_id, key, &errors);
+                }
+            }
+            else
+            {
+                while(fds_record_find(file_id, key, &desc, &token) == FDS_SUCCESS)
+                {
+                    record_check(&desc, file_id, key, &errors);
+                }
+            }
+            for(uint16_t i = 0; i < m_num_records; i++)
+            {
+                record_t const * p_record = &m_records[i];
+
+                if(p_record->live && (p_record->file_id == file_id) && ((key == 0) || (p_record->key == key)))
+                {
+                    missing += !p_record->found;
+                }
+            }
+        }
+    }
+    for(uint16_t i = 0; i < m_num_records; i++) live += m_records[i].live;
+
+    printf("  %-14s %u records\n", p_step, (unsigned)live);
+    TEST_CHECK_EQUAL(0, errors);
+    TEST_CHECK_EQUAL(0, missing);
+    TEST_CHECK_EQUAL(0, m_evt_errors);
+    mock_fstorage_stats_get(&stats);
+    TEST_CHECK_EQUAL(0, stats.errors);
+}
+
+
+
+static void setup(void)
+{
+    mock_fstorage_reset();
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_register(fds_evt_handler));
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_init());
+    mock_fstorage_run();
+    TEST_CHECK_EQUAL(1, m_evts);
+}
+
+
+
+static void test_write(void)
+{
+    for(uint16_t i = 0; i < NUM_RECORDS; i++)
+    {
+        record_write(1 + i % NUM_FILES, 1 + i % NUM_KEYS);
+    }
+    records_check("written");
+}
+
+
+
+static void test_update_delete(void)
+{
+    for(uint16_t i = 0; i < NUM_CHANGES; i++)
+    {
+        uint16_t           file_id = 1 + i % NUM_FILES;
+        uint16_t           key     = file_id + NUM_FILES * ((i / NUM_FILES) % (NUM_KEYS / NUM_FILES));
+        fds_find_token_t   token   = {0};
+        fds_record_desc_t  desc;
+        record_t         * p_record;
+
+        // Each key of a file has records, the first is changed
+        TEST_CHECK_EQUAL(FDS_SUCCESS, fds_record_find(file_id, key, &desc, &token));
+        p_record = record_get(desc.record_id);
+        TEST_CHECK(p_record != NULL);
+        if(p_record == NULL) continue;
+
+        if(i & 1)
+        {
+            // Moved to another key, under a new record ID
+            uint16_t            new_i = m_num_records++;
+            fds_record_chunk_t  chunk = {.p_data = &m_data[new_i], .length_words = 1};
+            fds_record_t        record =
+            {
+                .file_id = file_id,
+                .key     = KEY_UPDATED,
+                .data    = {.p_chunks = &chunk, .num_chunks = 1},
+            };
+
+            m_data[new_i] = new_i;
+            TEST_CHECK_EQUAL(FDS_SUCCESS, fds_record_update(&desc, &record));
+            mock_fstorage_run();
+            m_records[new_i] = (record_t){.record_id = desc.record_id, .file_id = file_id, .key = KEY_UPDATED, .live = true};
+        }
+        else
+        {
+            TEST_CHECK_EQUAL(FDS_SUCCESS, fds_record_delete(&desc));
+            mock_fstorage_run();
+        }
+        p_record->live = false;
+    }
+    records_check("updated");
+}
+
+
+
+static void test_file_delete(void)
+{
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_file_delete(3));
+    mock_fstorage_run();
+    for(uint16_t i = 0; i < m_num_records; i++)
+    {
+        if(m_records[i].file_id == 3) m_records[i].live = false;
+    }
+    records_check("file deleted");
+}
+
+
+
+static void test_gc(void)
+{
+    fds_stat_t stat;
+
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_gc());
+    mock_fstorage_run();
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_stat(&stat));
+    TEST_CHECK_EQUAL(0, stat.dirty_records);
+    records_check("collected");
+
+    // Records written after garbage collection are found as well, in the deleted file too
+    for(uint16_t file_id = 1; file_id <= NUM_FILES; file_id++)
+    {
+        record_write(file_id, KEY_UPDATED + 1);
+    }
+    records_check("written again");
+}
+
+
+
+static void bench(void)
+{
+    volatile uint32_t found = 0;
+    clock_t           start = clock();
+
+    for(uint32_t round = 0; round < BENCH_ROUNDS; round++)
+    {
+        for(uint16_t file_id = 1; file_id <= NUM_FILES; file_id++)
+        {
+            for(uint16_t key = 1; key <= NUM_KEYS; key++)
+            {
+                fds_find_token_t  token = {0};
+                fds_record_desc_t desc;
+
+                found += (fds_record_find(file_id, key, &desc, &token) == FDS_SUCCESS);
+            }
+        }
+    }
+    printf("  FDS_INDEX_SIZE %d: %.3f us per lookup\n", FDS_INDEX_SIZE,
+           (double)(clock() - start) * 1e6 / CLOCKS_PER_SEC / (BENCH_ROUNDS * NUM_FILES * NUM_KEYS));
+}
+
+
+
+int main(void)
+{
+    setup();
+    test_write();
+    test_update_delete();
+    test_file_delete();
+    test_gc();
+    bench();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,274 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of FDS garbage collection while records are logged, on the fstorage mock and its flash
+ * timing. A record is written and an old one deleted every 5 ms, one flash operation at a time,
+ * so garbage collection starts in the background and runs between the writes. Checks the longest
+ * flash operation and the longest a write waits, and that the records are intact afterwards.
+ *
+ * Then garbage collection is paused the way the glove does while the NUS stream runs: it stops at
+ * a page boundary without an event while writes go on. Resuming fails while the FDS queue is full,
+ * and is retried on the next FDS event, as main.c does, until garbage collection completes.
+ *
+ * Built with the glove configuration, and with garbage collection running each page to the end
+ * in one go, to compare the waits.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "fds.h"
+#include "mock_fstorage.h"
+#include "test.h"
+
+#define NUM_KEYS                100     // Records kept
+#define NUM_TICKS               400
+#define TICK_US                 5000
+#define RECORD_WORDS            8
+#define WAITS                   16      // Writes in flight
+
+static uint32_t     m_data[NUM_KEYS + NUM_TICKS + 32][RECORD_WORDS];
+static uint16_t     m_num_data;
+static uint16_t     m_live[NUM_KEYS + 1];       // Data written last under each key, 0 for none
+static uint32_t     m_write_time[WAITS];        // When the writes in flight were queued
+static uint8_t      m_writes_queued;
+static uint8_t      m_writes_done;
+static uint32_t     m_write_wait_max;
+static uint32_t     m_gc_evts;
+static uint32_t     m_evt_errors;
+static bool         m_gc_resume_pending;
+static uint32_t     m_gc_resume_retries;
+
+
+
+static void fds_evt_handler(fds_evt_t const * const p_evt)
+{
+    if(p_evt->result != FDS_SUCCESS)
+    {
+        printf("  event %d failed with %u\n", p_evt->id, (unsigned)p_evt->result);
+        m_evt_errors++;
+    }
+    switch(p_evt->id)
+    {
+        case FDS_EVT_WRITE:
+        {
+            uint32_t wait = mock_fstorage_time_get() - m_write_time[m_writes_done++ % WAITS];
+
+            m_write_wait_max = MAX(m_write_wait_max, wait);
+        } break;
+
+        case FDS_EVT_GC:
+            m_gc_evts++;
+            break;
+
+        default:
+            break;
+    }
+
+    // Garbage collection could not resume while the queue was full. Try again, as main.c does
+    if(m_gc_resume_pending)
+    {
+        m_gc_resume_pending = (fds_gc_pause(false) == FDS_ERR_NO_SPACE_IN_QUEUES);
+        m_gc_resume_retries++;
+    }
+}
+
+
+
+/**@brief Function for queueing a write, running flash while the queue is full
+ * @retval  false if the write could not be queued
+ */
+static bool record_write(uint16_t key, bool wait)
+{
+    uint16_t            i     = ++m_num_data;
+    fds_record_chunk_t  chunk = {.p_data = m_data[i], .length_words = RECORD_WORDS};
+    fds_record_t        record =
+    {
+        .file_id = 1,
+        .key     = key,
+        .data    = {.p_chunks = &chunk, .num_chunks = 1},
+    };
+    fds_record_desc_t   desc;
+    ret_code_t          ret;
+
+    for(uint32_t j = 0; j < RECORD_WORDS; j++) m_data[i][j] = i * RECORD_WORDS + j;
+    m_write_time[m_writes_queued % WAITS] = mock_fstorage_time_get();
+    while((ret = fds_record_write(&desc, &record)) == FDS_ERR_NO_SPACE_IN_QUEUES)
+    {
+        if(!wait || !mock_fstorage_step()) break;
+    }
+    if(ret != FDS_SUCCESS)
+    {
+        m_num_data--;
+        return false;
+    }
+    m_writes_queued++;
+    if(key <= NUM_KEYS) m_live[key] = i;
+    return true;
+}
+
+
+
+static void record_delete(uint16_t key)
+{
+    fds_find_token_t  token = {0};
+    fds_record_desc_t desc;
+
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_record_find(1, key, &desc, &token));
+    while(fds_record_delete(&desc) == FDS_ERR_NO_SPACE_IN_QUEUES)
+    {
+        TEST_CHECK(mock_fstorage_step());
+    }
+    m_live[key] = 0;
+}
+
+
+
+/**@brief Function for checking that the file holds exactly the live records, with their data */
+static void records_check(void)
+{
+    fds_find_token_t    token  = {0};
+    fds_record_desc_t   desc;
+    fds_flash_record_t  flash_record;
+    uint16_t            found  = 0;
+    uint16_t            live   = 0;
+    uint32_t            errors = 0;
+
+    while(fds_record_find_in_file(1, &desc, &token) == FDS_SUCCESS)
+    {
+        uint16_t        key;
+        uint32_t const *p_data;
+
+        TEST_CHECK_EQUAL(FDS_SUCCESS, fds_record_open(&desc, &flash_record));
+        key    = flash_record.p_header->tl.record_key;
+        p_data = flash_record.p_data;
+        if((key > NUM_KEYS) || (m_live[key] == 0) || (p_data[0] != m_live[key] * RECORD_WORDS) ||
+           (p_data[RECORD_WORDS - 1] != m_live[key] * RECORD_WORDS + RECORD_WORDS - 1))
+        {
+            errors++;
+        }
+        TEST_CHECK_EQUAL(FDS_SUCCESS, fds_record_close(&desc));
+        found++;
+    }
+    for(uint16_t key = 1; key <= NUM_KEYS; key++) live += (m_live[key] != 0);
+
+    TEST_CHECK_EQUAL(0, errors);
+    TEST_CHECK_EQUAL(live, found);
+    TEST_CHECK_EQUAL(0, m_evt_errors);
+}
+
+
+
+static void setup(void)
+{
+    mock_fstorage_reset();
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_register(fds_evt_handler));
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_init());
+    mock_fstorage_run();
+
+    for(uint16_t key = 1; key <= NUM_KEYS; key++)
+    {
+        TEST_CHECK(record_write(key, true));
+        mock_fstorage_run();
+    }
+    records_check();
+}
+
+
+
+/**@brief Logging: every tick an old record is replaced, and flash runs one operation at a time */
+static void test_logging(void)
+{
+    mock_fstorage_stats_t stats;
+    uint32_t              next = mock_fstorage_time_get();
+    uint32_t              tick = 0;
+
+    m_write_wait_max = 0;
+    while((tick < NUM_TICKS) || mock_fstorage_step())
+    {
+        if((tick < NUM_TICKS) && ((int32_t)(mock_fstorage_time_get() - next) >= 0))
+        {
+            uint16_t key = 1 + (tick * 7) % NUM_KEYS;
+
+            record_delete(key);
+            TEST_CHECK(record_write(key, true));
+            tick++;
+            next += TICK_US;
+        }
+        else if(!mock_fstorage_step())
+        {
+            mock_fstorage_time_advance(next - mock_fstorage_time_get());
+        }
+    }
+    mock_fstorage_stats_get(&stats);
+
+    printf("  logging: %u garbage collections, longest store %u us, longest erase %u us, longest write wait %u us\n",
+           (unsigned)m_gc_evts, (unsigned)stats.store_max_us, (unsigned)stats.erase_max_us, (unsigned)m_write_wait_max);
+    TEST_CHECK(m_gc_evts > 0);
+    TEST_CHECK_EQUAL(0, stats.errors);
+#if (FDS_GC_INCREMENTAL)
+    // Records are copied in parts, and a write waits for no more than an erase and a few parts
+    TEST_CHECK(stats.store_max_us <= MAX(FDS_GC_COPY_WORDS, RECORD_WORDS) * MOCK_FSTORAGE_WRITE_US);
+    TEST_CHECK(m_write_wait_max < 2 * MOCK_FSTORAGE_ERASE_US);
+#endif
+    records_check();
+}
+
+
+
+/**@brief Pausing, as while the NUS stream runs, and resuming while the FDS queue is full */
+static void test_pause(void)
+{
+    fds_stat_t stat;
+    uint32_t   gc_evts;
+    uint16_t   writes = 0;
+
+    // Stops at a page boundary, without an event, and writes still go through
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_gc_pause(true));
+    gc_evts = m_gc_evts;
+    for(uint16_t key = 1; key <= NUM_KEYS / 2; key++)
+    {
+        record_delete(key);
+        mock_fstorage_run();
+    }
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_gc());
+    mock_fstorage_run();
+    TEST_CHECK(record_write(1, true));
+    mock_fstorage_run();
+    TEST_CHECK_EQUAL(gc_evts, m_gc_evts);
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_stat(&stat));
+    TEST_CHECK(stat.dirty_records > 0);
+    records_check();
+
+    // The stream stops while writes fill the queue, so garbage collection cannot resume yet
+    while(record_write(2 + writes, false)) writes++;
+    TEST_CHECK(writes > 0);
+    TEST_CHECK_EQUAL(FDS_ERR_NO_SPACE_IN_QUEUES, fds_gc_pause(false));
+    m_gc_resume_pending = true;
+
+    // It is resumed from the events of the writes, and completes
+    mock_fstorage_run();
+    printf("  paused: resumed after %u tries\n", (unsigned)m_gc_resume_retries);
+    TEST_CHECK(!m_gc_resume_pending);
+    TEST_CHECK_EQUAL(gc_evts + 1, m_gc_evts);
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_stat(&stat));
+    TEST_CHECK_EQUAL(0, stat.dirty_records);
+    records_check();
+}
+
+
+
+int main(void)
+{
+    setup();
+    test_logging();
+    test_pause();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,322 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the flex sensor math in app_flex.c: the oversample decimation, the min/max calibration
+ * and the bend it reports. The ADC is stood in for by known ramps per channel, laid out scan after
+ * scan as the ADC interrupt writes them, and the blocks go through the same calls as block_done()
+ * and flex_block_handle() in main.c. The acquisition engine is not built, as it needs the ADC.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_flex.h"
+#include "test.h"
+
+#define CHANNELS                5                                           // FLEX_AIN of the glove
+#define OVERSAMPLE              8
+#define DEPTH                   5
+#define FULL_SCALE              (APP_FLEX_RAW_MAX * OVERSAMPLE)             // Output of a channel at the top of the ADC range
+
+static int16_t m_buffer[APP_FLEX_BUFFER_SIZE(CHANNELS, DEPTH, OVERSAMPLE)];
+
+// Conversion of channel c in scan k. Each channel ramps at its own slope from its own base,
+// channel 4 runs downwards as a finger whose divider output falls as it bends
+static int16_t ramp(uint8_t c, uint32_t k)
+{
+    int32_t value;
+
+    if(c == 4)
+    {
+        value = 900 - (int32_t)k;
+    }
+    else
+    {
+        value = (100 * c) + (int32_t)(k * (c + 1));
+    }
+    if(value < 0)                value = 0;
+    if(value > APP_FLEX_RAW_MAX) value = APP_FLEX_RAW_MAX;
+    return (int16_t)value;
+}
+
+
+
+// Fills one block of raw conversions from scan 'first' on
+static void block_fill(int16_t * p_raw, uint32_t first, uint8_t oversample)
+{
+    for(uint32_t k = 0; k < (uint32_t)DEPTH * oversample; k++)
+    {
+        for(uint8_t c = 0; c < CHANNELS; c++)
+        {
+            p_raw[(k * CHANNELS) + c] = ramp(c, first + k);
+        }
+    }
+}
+
+
+
+// Sums against the ramps, with each oversample factor and in place as block_done() runs it
+static void test_decimate(void)
+{
+    static const uint8_t oversamples[] = {1, 2, 8, APP_FLEX_MAX_OVERSAMPLE};
+    int16_t              raw[DEPTH * APP_FLEX_MAX_OVERSAMPLE * CHANNELS];
+    int16_t              out[DEPTH * CHANNELS];
+
+    TEST_CHECK(APP_FLEX_MAX_OVERSAMPLE * APP_FLEX_RAW_MAX <= INT16_MAX);
+
+    for(uint8_t i = 0; i < sizeof(oversamples); i++)
+    {
+        uint8_t oversample = oversamples[i];
+
+        block_fill(raw, 40, oversample);
+        app_flex_decimate(raw, CHANNELS, oversample, DEPTH, out);
+        for(uint16_t n = 0; n < DEPTH; n++)
+        {
+            for(uint8_t c = 0; c < CHANNELS; c++)
+            {
+                int32_t expected = 0;
+                for(uint8_t k = 0; k < oversample; k++)
+                {
+                    expected += ramp(c, 40 + (n * oversample) + k);
+                }
+                TEST_CHECK_EQUAL(expected, out[(n * CHANNELS) + c]);
+            }
+        }
+
+        // In place gives the same
+        app_flex_decimate(raw, CHANNELS, oversample, DEPTH, raw);
+        TEST_CHECK(memcmp(raw, out, sizeof(out)) == 0);
+    }
+
+    // A ramp of slope 1 from 100, 8 scans: 8 * 100 + (0 + 1 + ... + 7)
+    for(uint8_t k = 0; k < OVERSAMPLE; k++)
+    {
+        raw[k] = 100 + k;
+    }
+    app_flex_decimate(raw, 1, OVERSAMPLE, 1, out);
+    TEST_CHECK_EQUAL(828, out[0]);
+
+    // The ADC can return small negative values near 0 V, they count as 0 and not against the sum
+    static const int16_t noisy[OVERSAMPLE] = {3, -2, 0, -1, 5, -4, 2, 1};
+    app_flex_decimate(noisy, 1, OVERSAMPLE, 1, out);
+    TEST_CHECK_EQUAL(11, out[0]);
+
+    // The top of the ADC range at the largest oversample still fits
+    for(uint8_t k = 0; k < APP_FLEX_MAX_OVERSAMPLE; k++)
+    {
+        raw[k] = APP_FLEX_RAW_MAX;
+    }
+    app_flex_decimate(raw, 1, APP_FLEX_MAX_OVERSAMPLE, 1, out);
+    TEST_CHECK_EQUAL(APP_FLEX_MAX_OVERSAMPLE * APP_FLEX_RAW_MAX, out[0]);
+}
+
+
+
+static void test_calib(void)
+{
+    app_flex_calib_t calib;
+    int16_t          samples[3 * 2] = {500, -20, 300, 40, 700, 10};
+    int16_t          bend[CHANNELS];
+
+    memset(&calib, 0, sizeof(calib));
+    calib.invert = 0x12;
+    app_flex_calib_reset(&calib);
+    TEST_CHECK_EQUAL(0x12, calib.invert);
+    for(uint8_t c = 0; c < APP_FLEX_MAX_CHANNELS; c++)
+    {
+        TEST_CHECK_EQUAL(INT16_MAX, calib.min[c]);
+        TEST_CHECK_EQUAL(INT16_MIN, calib.max[c]);
+    }
+    calib.invert = 0;
+
+    // Nothing seen yet, so no bend however the sample looks
+    app_flex_bend_get(&calib, samples, 2, bend);
+    TEST_CHECK_EQUAL(0, bend[0]);
+    TEST_CHECK_EQUAL(0, bend[1]);
+
+    // min/max per channel over samples interleaved channel after channel
+    app_flex_calib_update(&calib, samples, 2, 3);
+    TEST_CHECK_EQUAL(300, calib.min[0]);
+    TEST_CHECK_EQUAL(700, calib.max[0]);
+    TEST_CHECK_EQUAL(-20, calib.min[1]);
+    TEST_CHECK_EQUAL(40,  calib.max[1]);
+    TEST_CHECK_EQUAL(INT16_MAX, calib.min[2]);
+
+    // Only widens
+    app_flex_calib_update(&calib, &samples[2], 2, 1);
+    TEST_CHECK_EQUAL(300, calib.min[0]);
+    TEST_CHECK_EQUAL(700, calib.max[0]);
+
+    // Channel 1 has 60 of range, below APP_FLEX_MIN_RANGE, so it stays at 0. Channel 0 has 400
+    {
+        int16_t sample[2] = {400, 40};
+
+        app_flex_bend_get(&calib, sample, 2, bend);
+        TEST_CHECK_EQUAL((100 * APP_FLEX_BEND_ONE) / 400, bend[0]);
+        TEST_CHECK_EQUAL(0, bend[1]);
+    }
+
+    // Exactly APP_FLEX_MIN_RANGE starts reporting
+    {
+        int16_t sample[2] = {700, -20 + APP_FLEX_MIN_RANGE};
+
+        app_flex_calib_update(&calib, sample, 2, 1);
+        app_flex_bend_get(&calib, sample, 2, bend);
+        TEST_CHECK_EQUAL(APP_FLEX_BEND_ONE, bend[0]);
+        TEST_CHECK_EQUAL(APP_FLEX_BEND_ONE, bend[1]);
+    }
+
+    // Outside the range is clamped, to 0 below and to APP_FLEX_BEND_ONE above
+    {
+        int16_t sample[2] = {200, 1000};
+
+        app_flex_bend_get(&calib, sample, 2, bend);
+        TEST_CHECK_EQUAL(0, bend[0]);
+        TEST_CHECK_EQUAL(APP_FLEX_BEND_ONE, bend[1]);
+    }
+
+    // Channel 1 inverted: its minimum is fully bent
+    calib.invert = 0x02;
+    {
+        int16_t sample[2] = {300, -20};
+
+        app_flex_bend_get(&calib, sample, 2, bend);
+        TEST_CHECK_EQUAL(0, bend[0]);
+        TEST_CHECK_EQUAL(APP_FLEX_BEND_ONE, bend[1]);
+        sample[1] = -20 + (APP_FLEX_MIN_RANGE / 4);
+        app_flex_bend_get(&calib, sample, 2, bend);
+        TEST_CHECK_EQUAL((3 * APP_FLEX_BEND_ONE) / 4, bend[1]);
+        sample[1] = -100;
+        app_flex_bend_get(&calib, sample, 2, bend);
+        TEST_CHECK_EQUAL(APP_FLEX_BEND_ONE, bend[1]);
+    }
+}
+
+
+
+// Blocks of the ramps through decimation, calibration and bend, the way the glove runs them.
+// A first pass over the sweep calibrates, a replay of it must then report the ramps as bends
+static void test_pipeline(void)
+{
+    app_flex_calib_t calib;
+    int16_t          bend[DEPTH * CHANNELS];
+    int16_t        * p_block = m_buffer;
+    uint32_t         scan    = 0;
+    int32_t          min[CHANNELS];
+    int32_t          max[CHANNELS];
+    int32_t          worst = 0;
+
+    calib.invert = 0x10;                                    // Channel 4 falls as it bends
+    app_flex_calib_reset(&calib);
+
+    // Calibration sweep: the ramps of channels 0 to 3 rise and channel 4 falls over 20 blocks
+    for(uint16_t b = 0; b < 20; b++)
+    {
+        block_fill(p_block, scan, OVERSAMPLE);
+        scan += DEPTH * OVERSAMPLE;
+        app_flex_decimate(p_block, CHANNELS, OVERSAMPLE, DEPTH, p_block);
+        app_flex_calib_update(&calib, p_block, CHANNELS, DEPTH);
+    }
+    for(uint8_t c = 0; c < CHANNELS; c++)
+    {
+        int32_t first = 0;
+        int32_t last  = 0;
+        for(uint8_t k = 0; k < OVERSAMPLE; k++)
+        {
+            first += ramp(c, k);
+            last  += ramp(c, scan - OVERSAMPLE + k);
+        }
+        min[c] = (first < last) ? first : last;
+        max[c] = (first < last) ? last : first;
+        TEST_CHECK_EQUAL(min[c], calib.min[c]);
+        TEST_CHECK_EQUAL(max[c], calib.max[c]);
+        TEST_CHECK(max[c] <= FULL_SCALE);
+    }
+    printf("  calibrated range after %u scans:", (unsigned)scan);
+    for(uint8_t c = 0; c < CHANNELS; c++)
+    {
+        printf(" %d..%d", (int)min[c], (int)max[c]);
+    }
+    printf("\n");
+
+    // Replay the sweep. Every bend must be the position in the range, and rise with each ramp
+    scan = 0;
+    for(uint16_t b = 0; b < 20; b++)
+    {
+        block_fill(p_block, scan, OVERSAMPLE);
+        app_flex_decimate(p_block, CHANNELS, OVERSAMPLE, DEPTH, p_block);
+        app_flex_calib_update(&calib, p_block, CHANNELS, DEPTH);
+        for(uint16_t i = 0; i < DEPTH; i++)
+        {
+            app_flex_bend_get(&calib, &p_block[i * CHANNELS], CHANNELS, &bend[i * CHANNELS]);
+        }
+
+        for(uint16_t i = 0; i < DEPTH; i++)
+        {
+            for(uint8_t c = 0; c < CHANNELS; c++)
+            {
+                int32_t value    = p_block[(i * CHANNELS) + c] - min[c];
+                int32_t range    = max[c] - min[c];
+                double  position = (double)value / range;
+                int32_t expected;
+
+                if(c == 4) position = 1.0 - position;
+                expected = (int32_t)(position * APP_FLEX_BEND_ONE);
+                int32_t error = bend[(i * CHANNELS) + c] - expected;
+                if(error < 0) error = -error;
+                if(error > worst) worst = error;
+                TEST_CHECK(error <= 1);
+                TEST_CHECK(bend[(i * CHANNELS) + c] >= 0);
+            }
+        }
+        if(b == 0)
+        {
+            for(uint8_t c = 0; c < CHANNELS; c++)
+            {
+                TEST_CHECK_EQUAL(0, bend[c]);
+            }
+        }
+        if(b == 19)
+        {
+            for(uint8_t c = 0; c < CHANNELS; c++)
+            {
+                TEST_CHECK_EQUAL(APP_FLEX_BEND_ONE, bend[((DEPTH - 1) * CHANNELS) + c]);
+            }
+        }
+        for(uint16_t i = 1; i < DEPTH; i++)
+        {
+            for(uint8_t c = 0; c < CHANNELS; c++)
+            {
+                TEST_CHECK(bend[(i * CHANNELS) + c] >= bend[((i - 1) * CHANNELS) + c]);
+            }
+        }
+        scan += DEPTH * OVERSAMPLE;
+    }
+    printf("  replayed sweep: worst bend error %d of %d\n", (int)worst, APP_FLEX_BEND_ONE);
+
+    // After a reset a sensor that shifted is learned again from scratch
+    app_flex_calib_reset(&calib);
+    TEST_CHECK_EQUAL(0x10, calib.invert);
+    app_flex_bend_get(&calib, p_block, CHANNELS, bend);
+    for(uint8_t c = 0; c < CHANNELS; c++)
+    {
+        TEST_CHECK_EQUAL(0, bend[c]);
+    }
+}
+
+
+
+int main(void)
+{
+    test_decimate();
+    test_calib();
+    test_pipeline();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
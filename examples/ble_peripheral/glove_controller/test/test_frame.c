@@ -0,0 +1,284 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Round trip test of the sensor frames, app_frame.c. Encodes random walk samples with jumps into
+ * frames of varying size, with the timestamp wrapping on the 24 bit RTC and a frame lost on the way,
+ * and checks that the decoder gives back every sample after the next keyframe. Then mixes sample
+ * frames and raw frames of UART bytes in one byte stream, the way they share the NUS stream, and
+ * checks that the peer can split them by length and stream id and get both back whole.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_frame.h"
+#include "app_util.h"
+#include "sdk_errors.h"
+#include "test.h"
+
+#define CHANNELS                7
+#define SAMPLES                 1000
+#define PERIOD                  10
+#define LOST_FRAME              7
+#define STREAM_SAMPLES          0
+#define STREAM_RAW              1
+
+static int16_t m_samples[SAMPLES * CHANNELS];
+static int16_t m_decoded[UINT8_MAX * CHANNELS];
+
+
+
+static void samples_make(void)
+{
+    int16_t value[CHANNELS] = {0};
+
+    srand(1);
+    for(uint16_t i = 0; i < SAMPLES; i++)
+    {
+        for(uint8_t c = 0; c < CHANNELS; c++)
+        {
+            value[c] += (rand() % 41) - 20;
+            if(rand() % 50 == 0)
+            {
+                value[c] = (int16_t)rand(); // Jumps that take the full varint
+            }
+            m_samples[i * CHANNELS + c] = value[c];
+        }
+    }
+}
+
+
+
+static void test_round_trip(void)
+{
+    app_frame_encoder_t encoder;
+    app_frame_decoder_t decoder;
+    app_frame_header_t  header;
+    uint8_t             frame[APP_FRAME_MAX_LEN];
+    uint32_t            timestamp = 0x00FFFF00; // Wraps after a few frames
+    uint16_t            done      = 0;
+    uint16_t            frames    = 0;
+    uint16_t            decoded   = 0;
+    uint16_t            skipped   = 0;
+    uint32_t            bytes     = 0;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_frame_encoder_init(&encoder, STREAM_SAMPLES, CHANNELS, 4));
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_PARAM, app_frame_encoder_init(&encoder, APP_FRAME_STREAM_COUNT, CHANNELS, 4));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_frame_encoder_init(&encoder, STREAM_SAMPLES, CHANNELS, 4));
+    app_frame_decoder_init(&decoder);
+
+    while(done < SAMPLES)
+    {
+        uint16_t max_len = 40 + (frames % 3) * 100;
+        uint16_t packed;
+        uint16_t len = app_frame_encode(&encoder, frame, max_len, timestamp + done * PERIOD, PERIOD,
+                                        &m_samples[done * CHANNELS], CHANNELS, SAMPLES - done, &packed);
+        uint32_t err_code;
+
+        TEST_CHECK(len > 0 && len <= max_len);
+        TEST_CHECK_EQUAL(len - 1, frame[0]);
+        TEST_CHECK_EQUAL(STREAM_SAMPLES, APP_FRAME_STREAM_GET(frame));
+        TEST_CHECK(!APP_FRAME_IS_RAW(frame));
+        if(len == 0) break;
+        frames++;
+        bytes += len;
+
+        if(frames == LOST_FRAME)
+        {
+            done += packed;
+            continue;
+        }
+        err_code = app_frame_decode(&decoder, frame, len, &header, m_decoded, sizeof(m_decoded) / sizeof(int16_t));
+        if(err_code == NRF_SUCCESS)
+        {
+            TEST_CHECK_EQUAL(packed, header.count);
+            TEST_CHECK_EQUAL(CHANNELS, header.channels);
+            TEST_CHECK_EQUAL((timestamp + done * PERIOD) & APP_FRAME_TIMESTAMP_MASK, header.timestamp);
+            TEST_CHECK_EQUAL(PERIOD, header.period);
+            TEST_CHECK(memcmp(m_decoded, &m_samples[done * CHANNELS], packed * CHANNELS * sizeof(int16_t)) == 0);
+            decoded += packed;
+        }
+        else
+        {
+            // Only the frames after the lost one, until the next keyframe
+            TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, err_code);
+            TEST_CHECK(frames > LOST_FRAME && frames < LOST_FRAME + 4);
+            skipped += packed;
+        }
+        done += packed;
+    }
+    printf("  %u samples in %u frames, %u bytes for %u raw. %u samples skipped after the lost frame\n",
+           done, frames, bytes, (uint32_t)(SAMPLES * CHANNELS * sizeof(int16_t)), skipped);
+    TEST_CHECK(skipped > 0);
+    TEST_CHECK(decoded + skipped < SAMPLES); // The lost frame
+    TEST_CHECK(bytes < SAMPLES * CHANNELS * sizeof(int16_t));
+}
+
+
+
+static void test_malformed(void)
+{
+    app_frame_encoder_t encoder;
+    app_frame_decoder_t decoder;
+    app_frame_header_t  header;
+    uint8_t             frame[APP_FRAME_MAX_LEN];
+    uint16_t            packed;
+    uint16_t            len;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_frame_encoder_init(&encoder, STREAM_SAMPLES, CHANNELS, 4));
+    app_frame_decoder_init(&decoder);
+    len = app_frame_encode(&encoder, frame, sizeof(frame), 0, PERIOD, m_samples, CHANNELS, 10, &packed);
+    TEST_CHECK_EQUAL(10, packed);
+
+    // Cut short, or a length byte that runs past the data
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_frame_decode(&decoder, frame, len - 1, &header, m_decoded, sizeof(m_decoded) / sizeof(int16_t)));
+    frame[0]--;
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_frame_decode(&decoder, frame, len, &header, m_decoded, sizeof(m_decoded) / sizeof(int16_t)));
+    frame[0]++;
+    // No room for the samples
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_frame_decode(&decoder, frame, len, &header, m_decoded, 10 * CHANNELS - 1));
+    // Raw frames are not samples
+    len = app_frame_raw_encode(STREAM_RAW, frame, sizeof(frame), (uint8_t const *)"abc", 3, &packed);
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_frame_decode(&decoder, frame, len, &header, m_decoded, sizeof(m_decoded) / sizeof(int16_t)));
+}
+
+
+
+static void test_raw(void)
+{
+    uint8_t         data[600];
+    uint8_t         frame[APP_FRAME_MAX_LEN];
+    uint8_t const * p_data;
+    uint16_t        data_len;
+    uint16_t        packed;
+    uint16_t        len;
+    uint16_t        done = 0;
+    uint16_t        frames = 0;
+
+    for(uint16_t i = 0; i < sizeof(data); i++)
+    {
+        data[i] = (uint8_t)(i * 7);
+    }
+
+    // Longer than a frame takes, so it is split
+    while(done < sizeof(data))
+    {
+        len = app_frame_raw_encode(STREAM_RAW, frame, sizeof(frame), &data[done], sizeof(data) - done, &packed);
+        TEST_CHECK(len > APP_FRAME_RAW_HEADER_SIZE && len <= APP_FRAME_MAX_LEN);
+        TEST_CHECK(APP_FRAME_IS_RAW(frame));
+        TEST_CHECK_EQUAL(STREAM_RAW, APP_FRAME_STREAM_GET(frame));
+        TEST_CHECK_EQUAL(NRF_SUCCESS, app_frame_raw_decode(frame, len, &p_data, &data_len));
+        TEST_CHECK_EQUAL(packed, data_len);
+        TEST_CHECK(memcmp(p_data, &data[done], data_len) == 0);
+        if(len == 0) break;
+        done += packed;
+        frames++;
+    }
+    TEST_CHECK_EQUAL(3, frames);
+
+    TEST_CHECK_EQUAL(0, app_frame_raw_encode(STREAM_RAW, frame, sizeof(frame), data, 0, &packed));
+    TEST_CHECK_EQUAL(0, app_frame_raw_encode(STREAM_RAW, frame, APP_FRAME_RAW_HEADER_SIZE, data, 1, &packed));
+    TEST_CHECK_EQUAL(0, app_frame_raw_encode(APP_FRAME_STREAM_COUNT, frame, sizeof(frame), data, 1, &packed));
+    len = app_frame_raw_encode(STREAM_RAW, frame, sizeof(frame), data, 10, &packed);
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_frame_raw_decode(frame, len - 1, &p_data, &data_len));
+}
+
+
+
+/**@brief Sample frames and UART bytes in one byte stream, split again by the length byte and stream id */
+static void test_mixed(void)
+{
+    static uint8_t      link[16384];
+    uint8_t             uart[SAMPLES];
+    uint8_t             uart_received[SAMPLES];
+    app_frame_encoder_t encoder;
+    app_frame_decoder_t decoder;
+    app_frame_header_t  header;
+    uint32_t            link_len = 0;
+    uint16_t            done = 0;
+    uint16_t            uart_done = 0;
+    uint16_t            decoded = 0;
+    uint16_t            uart_len = 0;
+    uint16_t            pos;
+
+    for(uint16_t i = 0; i < sizeof(uart); i++)
+    {
+        uart[i] = (uint8_t)rand();
+    }
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_frame_encoder_init(&encoder, STREAM_SAMPLES, CHANNELS, 4));
+    app_frame_decoder_init(&decoder);
+
+    while(done < SAMPLES || uart_done < sizeof(uart))
+    {
+        uint16_t packed;
+        uint16_t len;
+
+        if(done < SAMPLES)
+        {
+            len = app_frame_encode(&encoder, &link[link_len], 100, done * PERIOD, PERIOD,
+                                   &m_samples[done * CHANNELS], CHANNELS, MIN(SAMPLES - done, 8), &packed);
+            link_len += len;
+            done     += packed;
+        }
+        if(uart_done < sizeof(uart))
+        {
+            // As the UART interrupt does, up to 64 bytes at a time. Some contain length byte lookalikes
+            len = app_frame_raw_encode(STREAM_RAW, &link[link_len], APP_FRAME_MAX_LEN, &uart[uart_done],
+                                       MIN(sizeof(uart) - uart_done, 1 + (rand() % 64)), &packed);
+            link_len  += len;
+            uart_done += packed;
+        }
+        TEST_CHECK(link_len + 2 * APP_FRAME_MAX_LEN < sizeof(link));
+    }
+
+    // The peer side
+    for(pos = 0; pos < link_len; pos += link[pos] + 1)
+    {
+        uint8_t const * p_frame = &link[pos];
+
+        if(APP_FRAME_STREAM_GET(p_frame) == STREAM_RAW)
+        {
+            uint8_t const * p_data;
+            uint16_t        data_len;
+
+            TEST_CHECK(APP_FRAME_IS_RAW(p_frame));
+            TEST_CHECK_EQUAL(NRF_SUCCESS, app_frame_raw_decode(p_frame, link_len - pos, &p_data, &data_len));
+            TEST_CHECK(uart_len + data_len <= sizeof(uart_received));
+            memcpy(&uart_received[uart_len], p_data, data_len);
+            uart_len += data_len;
+        }
+        else
+        {
+            TEST_CHECK_EQUAL(STREAM_SAMPLES, APP_FRAME_STREAM_GET(p_frame));
+            TEST_CHECK_EQUAL(NRF_SUCCESS, app_frame_decode(&decoder, p_frame, link_len - pos, &header,
+                                                           m_decoded, sizeof(m_decoded) / sizeof(int16_t)));
+            TEST_CHECK(memcmp(m_decoded, &m_samples[decoded * CHANNELS], header.count * CHANNELS * sizeof(int16_t)) == 0);
+            decoded += header.count;
+        }
+    }
+    TEST_CHECK_EQUAL(link_len, pos);
+    TEST_CHECK_EQUAL(SAMPLES, decoded);
+    TEST_CHECK_EQUAL(sizeof(uart), uart_len);
+    TEST_CHECK(memcmp(uart, uart_received, sizeof(uart)) == 0);
+    printf("  %u bytes of samples and UART data on one link, split again without loss\n", link_len);
+}
+
+
+
+int main(void)
+{
+    samples_make();
+    test_round_trip();
+    test_malformed();
+    test_raw();
+    test_mixed();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
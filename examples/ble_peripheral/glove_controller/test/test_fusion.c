@@ -0,0 +1,367 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the orientation filter, app_mpu_fusion.c. The fixed point path the nRF51 runs and the
+ * float path of the nRF52, built next to it by fusion_float.c, are fed the same golden vectors:
+ * samples made from a known orientation, as an MPU at 200 Hz, 16 g and 2000 deg/s would measure
+ * it, with noise. Both must follow the known orientation, and stay close to each other, at rest,
+ * through a turn, through a tumble about all axes, from a start far from the truth and with a
+ * gyroscope bias. Then both are timed per update.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "app_mpu_fusion.h"
+#include "fusion_float.h"
+#include "nrf_error.h"
+#include "test.h"
+
+#define SAMPLE_PERIOD_US        5000                                    // 200 Hz, as the glove samples
+#define ACCEL_1G                2048.0                                  // AFS_16G
+#define GYRO_LSB_RAD            ((2000.0 / 32768.0) * (M_PI / 180.0))   // GFS_2000DPS
+#define MAGN_FIELD              300.0
+#define MAGN_DIP_DEG            65.0                                    // Inclination of the earth field
+#define ACCEL_NOISE             8                                       // LSB, either way
+#define GYRO_NOISE              2
+#define MAGN_NOISE              3
+#define MAX_SAMPLES             (120 * 200)
+#define BENCH_UPDATES           1000000
+
+/**@brief A golden trace: the motion the samples are made from, and how closely the filters must follow it */
+typedef struct
+{
+    char const *    name;
+    bool            magn;               // 9-axis fusion
+    double          start_deg[3];       // Roll, pitch and yaw of the sensor at the start. The filters start level
+    double          seconds;
+    double          rate_dps[3];        // Turn rate about x, y and z
+    double          rate_hz;            // The rates swing at this frequency. 0 for constant rates
+    int16_t         gyro_bias;          // LSB, on all axes
+    float           ki;
+    double          settle_s;           // The error from the truth is counted from here
+    double          max_error_deg;      // From the truth, for either path
+    double          max_apart_deg;      // Between the paths
+}trace_t;
+
+typedef struct
+{
+    accel_values_t  accel;
+    gyro_values_t   gyro;
+    int16_t         magn[3];
+    double          truth[4];           // w, x, y, z after the sample
+}sample_t;
+
+static const trace_t m_traces[] =
+{
+    {"rest",          false, {0, 0, 0},     10, {0, 0, 0},       0,   0,  0.0f,  0, 0.2, 0.1},
+    {"turn",          false, {0, 0, 0},      8, {0, 0, 90},      0,   0,  0.0f,  0, 0.2, 0.1},
+    {"tumble",        true,  {0, 0, 0},     20, {200, 150, 250}, 0.5, 0,  0.0f,  0, 0.3, 0.1},
+    {"tilted start",  false, {40, 0, 0},    10, {0, 0, 0},       0,   0,  0.0f,  8, 0.2, 0.1},
+    {"heading",       true,  {0, 0, 60},    80, {0, 0, 0},       0,   0,  0.0f, 60, 0.5, 0.2},
+    {"gyro bias",     true,  {0, 0, 0},    120, {0, 0, 0},       0,   16, 0.1f, 90, 0.6, 0.6},
+};
+
+static sample_t m_samples[MAX_SAMPLES];
+static uint32_t m_rand = 1;
+
+
+
+static int16_t noise(int16_t amplitude)
+{
+    m_rand = m_rand * 1103515245 + 12345;
+    return (int16_t)((int32_t)((m_rand >> 16) % (2 * amplitude + 1)) - amplitude);
+}
+
+
+
+static int16_t lsb(double value)
+{
+    return (int16_t)lround(value);
+}
+
+
+
+static void quat_mul(double const * a, double const * b, double * p_out)
+{
+    p_out[0] = (a[0] * b[0]) - (a[1] * b[1]) - (a[2] * b[2]) - (a[3] * b[3]);
+    p_out[1] = (a[0] * b[1]) + (a[1] * b[0]) + (a[2] * b[3]) - (a[3] * b[2]);
+    p_out[2] = (a[0] * b[2]) - (a[1] * b[3]) + (a[2] * b[0]) + (a[3] * b[1]);
+    p_out[3] = (a[0] * b[3]) + (a[1] * b[2]) - (a[2] * b[1]) + (a[3] * b[0]);
+}
+
+
+
+/**@brief Earth frame vector in the frame of a sensor with orientation q, q* v q */
+static void to_sensor(double const * q, double const * v, double * p_out)
+{
+    double conj[4] = {q[0], -q[1], -q[2], -q[3]};
+    double vq[4]   = {0, v[0], v[1], v[2]};
+    double tmp[4];
+    double out[4];
+
+    quat_mul(conj, vq, tmp);
+    quat_mul(tmp, q, out);
+    p_out[0] = out[1];
+    p_out[1] = out[2];
+    p_out[2] = out[3];
+}
+
+
+
+/**@brief Makes the samples of a trace, and the orientation after each */
+static uint32_t trace_make(trace_t const * p_trace)
+{
+    double   dt      = SAMPLE_PERIOD_US * 1e-6;
+    double   gravity[3] = {0, 0, 1};
+    double   field[3]   = {cos(MAGN_DIP_DEG * M_PI / 180.0), 0, sin(MAGN_DIP_DEG * M_PI / 180.0)};
+    double   q[4]    = {1, 0, 0, 0};
+    uint32_t count   = (uint32_t)(p_trace->seconds / dt);
+
+    // Yaw, then pitch, then roll
+    for(int8_t axis = 2; axis >= 0; axis--)
+    {
+        double half   = p_trace->start_deg[axis] * (M_PI / 360.0);
+        double r[4]   = {cos(half), 0, 0, 0};
+        double tmp[4] = {q[0], q[1], q[2], q[3]};
+
+        r[axis + 1] = sin(half);
+        quat_mul(tmp, r, q);
+    }
+
+    for(uint32_t k = 0; k < count; k++)
+    {
+        sample_t * p_sample = &m_samples[k];
+        double     v[3];
+        int16_t    rate[3];
+        double     angle2 = 0;
+
+        to_sensor(q, gravity, v);
+        p_sample->accel.x = lsb(v[0] * ACCEL_1G) + noise(ACCEL_NOISE);
+        p_sample->accel.y = lsb(v[1] * ACCEL_1G) + noise(ACCEL_NOISE);
+        p_sample->accel.z = lsb(v[2] * ACCEL_1G) + noise(ACCEL_NOISE);
+        to_sensor(q, field, v);
+        for(uint8_t i = 0; i < 3; i++)
+        {
+            p_sample->magn[i] = lsb(v[i] * MAGN_FIELD) + noise(MAGN_NOISE);
+        }
+
+        // The truth turns by the rates as the gyroscope quantizes them. Bias and noise are errors
+        for(uint8_t i = 0; i < 3; i++)
+        {
+            double dps = p_trace->rate_dps[i];
+
+            if(p_trace->rate_hz != 0) dps *= sin((2 * M_PI * p_trace->rate_hz * k * dt) + i);
+            rate[i] = lsb(dps * (M_PI / 180.0) / GYRO_LSB_RAD);
+            angle2 += (double)rate[i] * rate[i];
+        }
+        p_sample->gyro.x = rate[0] + p_trace->gyro_bias + noise(GYRO_NOISE);
+        p_sample->gyro.y = rate[1] + p_trace->gyro_bias + noise(GYRO_NOISE);
+        p_sample->gyro.z = rate[2] + p_trace->gyro_bias + noise(GYRO_NOISE);
+
+        if(angle2 > 0)
+        {
+            double angle  = sqrt(angle2) * GYRO_LSB_RAD * dt;
+            double s      = sin(angle / 2) / sqrt(angle2);
+            double r[4]   = {cos(angle / 2), rate[0] * s, rate[1] * s, rate[2] * s};
+            double tmp[4] = {q[0], q[1], q[2], q[3]};
+
+            quat_mul(tmp, r, q);
+        }
+        for(uint8_t i = 0; i < 4; i++)
+        {
+            p_sample->truth[i] = q[i];
+        }
+    }
+    return count;
+}
+
+
+
+/**@brief Angle between two orientations, in degrees. Q14 quaternions are only about unit length */
+static double angle_deg(double const * a, double const * b)
+{
+    double dot = fabs((a[0] * b[0]) + (a[1] * b[1]) + (a[2] * b[2]) + (a[3] * b[3]));
+
+    dot /= sqrt(((a[0] * a[0]) + (a[1] * a[1]) + (a[2] * a[2]) + (a[3] * a[3])) *
+                ((b[0] * b[0]) + (b[1] * b[1]) + (b[2] * b[2]) + (b[3] * b[3])));
+    return 2 * acos((dot > 1) ? 1 : dot) * (180.0 / M_PI);
+}
+
+
+
+static void quat_to_double(app_mpu_fusion_quat_t const * p_quat, double * p_out)
+{
+    p_out[0] = p_quat->w / 16384.0;
+    p_out[1] = p_quat->x / 16384.0;
+    p_out[2] = p_quat->y / 16384.0;
+    p_out[3] = p_quat->z / 16384.0;
+}
+
+
+
+static void test_init(void)
+{
+    app_mpu_fusion_t        fusion;
+    app_mpu_fusion_config_t config = APP_MPU_FUSION_DEFAULT_CONFIG(SAMPLE_PERIOD_US);
+    app_mpu_fusion_quat_t   quat;
+
+    config.sample_period_us = 0;
+    TEST_CHECK_EQUAL(MPU_BAD_PARAMETER, app_mpu_fusion_init(&fusion, &config));
+    TEST_CHECK_EQUAL(MPU_BAD_PARAMETER, fusion_float_init(&config));
+    config.sample_period_us = SAMPLE_PERIOD_US;
+    config.gyro_fs          = GFS_2000DPS + 1;
+    TEST_CHECK_EQUAL(MPU_BAD_PARAMETER, app_mpu_fusion_init(&fusion, &config));
+    TEST_CHECK_EQUAL(MPU_BAD_PARAMETER, fusion_float_init(&config));
+
+    config.gyro_fs = GFS_2000DPS;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fusion_init(&fusion, &config));
+    app_mpu_fusion_quat_get(&fusion, &quat);
+    TEST_CHECK_EQUAL(16384, quat.w);
+    TEST_CHECK_EQUAL(0, quat.x | quat.y | quat.z);
+}
+
+
+
+static void test_trace(trace_t const * p_trace)
+{
+    app_mpu_fusion_t        fusion;
+    app_mpu_fusion_config_t config = APP_MPU_FUSION_DEFAULT_CONFIG(SAMPLE_PERIOD_US);
+    uint32_t                count  = trace_make(p_trace);
+    uint32_t                settle = (uint32_t)(p_trace->settle_s * 1e6 / SAMPLE_PERIOD_US);
+    double                  fixed_error = 0;
+    double                  float_error = 0;
+    double                  apart = 0;
+
+    config.ki = p_trace->ki;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fusion_init(&fusion, &config));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, fusion_float_init(&config));
+
+    for(uint32_t k = 0; k < count; k++)
+    {
+        sample_t const *      p_sample = &m_samples[k];
+        int16_t const *       p_magn   = p_trace->magn ? p_sample->magn : NULL;
+        app_mpu_fusion_quat_t quat;
+        double                q_fixed[4];
+        double                q_float[4];
+
+        app_mpu_fusion_update(&fusion, &p_sample->accel, &p_sample->gyro, p_magn);
+        fusion_float_update(&p_sample->accel, &p_sample->gyro, p_magn);
+        app_mpu_fusion_quat_get(&fusion, &quat);
+        quat_to_double(&quat, q_fixed);
+        fusion_float_quat_get(&quat);
+        quat_to_double(&quat, q_float);
+
+        if(k >= settle)
+        {
+            fixed_error = fmax(fixed_error, angle_deg(q_fixed, p_sample->truth));
+            float_error = fmax(float_error, angle_deg(q_float, p_sample->truth));
+        }
+        apart = fmax(apart, angle_deg(q_fixed, q_float));
+    }
+
+    printf("  %s: fixed point %.2f deg, float %.2f deg from the truth at most, %.2f deg apart\n",
+           p_trace->name, fixed_error, float_error, apart);
+    TEST_CHECK(fixed_error <= p_trace->max_error_deg);
+    TEST_CHECK(float_error <= p_trace->max_error_deg);
+    TEST_CHECK(apart <= p_trace->max_apart_deg);
+}
+
+
+
+/**@brief The burst read path must give the same orientation as the sample path */
+static void test_burst(void)
+{
+    app_mpu_fusion_t        fusion;
+    app_mpu_fusion_t        fusion_burst;
+    app_mpu_fusion_config_t config = APP_MPU_FUSION_DEFAULT_CONFIG(SAMPLE_PERIOD_US);
+    uint32_t                count  = trace_make(&m_traces[2]);
+    uint32_t                differ = 0;
+
+    app_mpu_fusion_init(&fusion, &config);
+    app_mpu_fusion_init(&fusion_burst, &config);
+    for(uint32_t k = 0; k < count; k++)
+    {
+        sample_t const *      p_sample = &m_samples[k];
+        int16_t const         v[MPU_SAMPLE_SIZE / 2] = {p_sample->accel.x, p_sample->accel.y, p_sample->accel.z, 0,
+                                                        p_sample->gyro.x, p_sample->gyro.y, p_sample->gyro.z};
+        uint8_t               burst[MPU_SAMPLE_SIZE];
+        app_mpu_fusion_quat_t quat;
+        app_mpu_fusion_quat_t quat_burst;
+
+        for(uint8_t i = 0; i < MPU_SAMPLE_SIZE / 2; i++)
+        {
+            burst[2 * i]       = (uint8_t)((uint16_t)v[i] >> 8);
+            burst[(2 * i) + 1] = (uint8_t)v[i];
+        }
+        app_mpu_fusion_update(&fusion, &p_sample->accel, &p_sample->gyro, p_sample->magn);
+        app_mpu_fusion_update_burst(&fusion_burst, burst, p_sample->magn);
+        app_mpu_fusion_quat_get(&fusion, &quat);
+        app_mpu_fusion_quat_get(&fusion_burst, &quat_burst);
+        differ += (quat.w != quat_burst.w) || (quat.x != quat_burst.x) ||
+                  (quat.y != quat_burst.y) || (quat.z != quat_burst.z);
+    }
+    TEST_CHECK_EQUAL(0, differ);
+}
+
+
+
+static double ns_per_update(bool fixed, bool magn, uint32_t count)
+{
+    app_mpu_fusion_t        fusion;
+    app_mpu_fusion_config_t config = APP_MPU_FUSION_DEFAULT_CONFIG(SAMPLE_PERIOD_US);
+    clock_t                 start;
+
+    app_mpu_fusion_init(&fusion, &config);
+    fusion_float_init(&config);
+    start = clock();
+    for(uint32_t i = 0; i < BENCH_UPDATES; i++)
+    {
+        sample_t const * p_sample = &m_samples[i % count];
+        int16_t const *  p_magn   = magn ? p_sample->magn : NULL;
+
+        if(fixed)
+        {
+            app_mpu_fusion_update(&fusion, &p_sample->accel, &p_sample->gyro, p_magn);
+        }
+        else
+        {
+            fusion_float_update(&p_sample->accel, &p_sample->gyro, p_magn);
+        }
+    }
+    return (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / BENCH_UPDATES;
+}
+
+
+
+static void bench(void)
+{
+    uint32_t count = trace_make(&m_traces[2]);
+
+    printf("  update on this host: fixed point %.0f ns, float %.0f ns. With the magnetometer %.0f ns and %.0f ns\n",
+           ns_per_update(true, false, count), ns_per_update(false, false, count),
+           ns_per_update(true, true, count), ns_per_update(false, true, count));
+}
+
+
+
+int main(void)
+{
+    test_init();
+    for(uint8_t i = 0; i < sizeof(m_traces) / sizeof(m_traces[0]); i++)
+    {
+        test_trace(&m_traces[i]);
+    }
+    test_burst();
+    bench();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
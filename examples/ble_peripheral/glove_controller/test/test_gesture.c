@@ -0,0 +1,407 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the gesture recognizer and the model upload, app_gesture.c. The upload is fed the
+ * commands tools/gesture_model.py prints for the test model, so the firmware and the host tool
+ * must agree on the wire format and the CRC, and then the ways an upload can go wrong. FDS is
+ * stood in for by one record in RAM.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_gesture.h"
+#include "crc16.h"
+#include "fds.h"
+#include "sdk_errors.h"
+#include "app_util.h"
+#include "test.h"
+
+#define CHANNELS                4
+
+static const app_gesture_model_t m_model =
+{
+    .version        = APP_GESTURE_MODEL_VERSION,
+    .signal_count   = 2,
+    .node_count     = 5,
+    .signals        = {1, 3},
+    .window         = 8,
+    .hop            = 2,
+    .votes          = 2,
+    .holdoff        = 3,
+    .nodes          =
+    {
+        APP_GESTURE_NODE_SPLIT(1, APP_GESTURE_FEATURE_MEAN, 1000, 1, 2),
+        APP_GESTURE_NODE_SPLIT(0, APP_GESTURE_FEATURE_PEAK, 500,  3, 4),
+        APP_GESTURE_NODE_LEAF(APP_GESTURE_GRAB),
+        APP_GESTURE_NODE_LEAF(APP_GESTURE_NONE),
+        APP_GESTURE_NODE_LEAF(APP_GESTURE_TAP),
+    }
+};
+
+// m_model in the wire format, from gesture_model.py export --image
+static const uint8_t m_image[] =
+{
+    0x01, 0x02, 0x05, 0x08, 0x02, 0x02, 0x03, 0x01, 0x03, 0x05, 0x01, 0x02,
+    0xe8, 0x03, 0x00, 0x00, 0x04, 0x03, 0x04, 0xf4, 0x01, 0x00, 0x00, 0xff,
+    0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0xff, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+// The upload commands of m_model, from gesture_model.py export
+static const char * const m_commands[] =
+{
+    "a7100000010205080202030103050102e803d5d0",
+    "a7100e000000040304f4010000ff08000000a3a0",
+    "a7101c000000ff000000000000ff05000000fad0",
+    "a7042a0000009af1",
+    "a8042c0073b73699",
+};
+
+static app_gesture_upload_t m_upload;
+static uint32_t             m_record[BYTES_TO_WORDS(sizeof(app_gesture_model_t))];
+static bool                 m_record_written;
+static fds_cb_t             m_fds_handler;
+
+
+
+ret_code_t fds_register(fds_cb_t cb)
+{
+    m_fds_handler = cb;
+    return FDS_SUCCESS;
+}
+
+
+
+ret_code_t fds_record_find(uint16_t file_id, uint16_t record_key, fds_record_desc_t * p_desc, fds_find_token_t * p_token)
+{
+    return (m_record_written && file_id == APP_GESTURE_FILE_ID && record_key == APP_GESTURE_RECORD_KEY) ?
+           FDS_SUCCESS : FDS_ERR_NOT_FOUND;
+}
+
+
+
+ret_code_t fds_record_open(fds_record_desc_t * p_desc, fds_flash_record_t * p_flash_record)
+{
+    static fds_header_t header;
+
+    header.tl.length_words  = ARRAY_SIZE(m_record);
+    p_flash_record->p_header = &header;
+    p_flash_record->p_data   = m_record;
+    return FDS_SUCCESS;
+}
+
+
+
+ret_code_t fds_record_close(fds_record_desc_t * p_desc)
+{
+    return FDS_SUCCESS;
+}
+
+
+
+static ret_code_t record_store(fds_record_t const * p_record, fds_evt_id_t id)
+{
+    fds_evt_t evt;
+
+    TEST_CHECK_EQUAL(ARRAY_SIZE(m_record), p_record->data.p_chunks[0].length_words);
+    memcpy(m_record, p_record->data.p_chunks[0].p_data, sizeof(m_record));
+    m_record_written = true;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.id            = id;
+    evt.write.file_id = p_record->file_id;
+    m_fds_handler(&evt);
+    return FDS_SUCCESS;
+}
+
+
+
+ret_code_t fds_record_write(fds_record_desc_t * p_desc, fds_record_t const * p_record)
+{
+    return record_store(p_record, FDS_EVT_WRITE);
+}
+
+
+
+ret_code_t fds_record_update(fds_record_desc_t * p_desc, fds_record_t const * p_record)
+{
+    return record_store(p_record, FDS_EVT_UPDATE);
+}
+
+
+
+ret_code_t fds_gc(void)
+{
+    return FDS_SUCCESS;
+}
+
+
+
+static uint16_t hex_decode(char const * p_hex, uint8_t * p_data)
+{
+    uint16_t len = 0;
+
+    for(; p_hex[0] != '\0' && p_hex[1] != '\0'; p_hex += 2)
+    {
+        unsigned int byte;
+        sscanf(p_hex, "%2x", &byte);
+        p_data[len++] = (uint8_t)byte;
+    }
+    return len;
+}
+
+
+
+static bool model_equal(app_gesture_model_t const * p_a, app_gesture_model_t const * p_b)
+{
+    if(p_a->version != p_b->version || p_a->signal_count != p_b->signal_count || p_a->node_count != p_b->node_count ||
+       p_a->window != p_b->window || p_a->hop != p_b->hop || p_a->votes != p_b->votes || p_a->holdoff != p_b->holdoff ||
+       memcmp(p_a->signals, p_b->signals, p_a->signal_count) != 0)
+    {
+        return false;
+    }
+    for(uint8_t i = 0; i < p_a->node_count; i++)
+    {
+        if(p_a->nodes[i].feature != p_b->nodes[i].feature || p_a->nodes[i].left != p_b->nodes[i].left ||
+           p_a->nodes[i].right != p_b->nodes[i].right || p_a->nodes[i].threshold != p_b->nodes[i].threshold)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+/**@brief A command framed as gesture_model.py frames them */
+static uint16_t command_make(uint8_t command, uint8_t const * p_payload, uint8_t payload_len, uint8_t * p_out)
+{
+    p_out[0] = command;
+    p_out[1] = payload_len;
+    memcpy(&p_out[2], p_payload, payload_len);
+    (void)uint16_encode(crc16_compute(p_out, 2 + payload_len, NULL), &p_out[2 + payload_len]);
+    return payload_len + APP_GESTURE_CMD_OVERHEAD;
+}
+
+
+
+static uint16_t write_make(uint16_t offset, uint8_t size, uint8_t * p_out)
+{
+    uint8_t payload[2 + 32];
+
+    (void)uint16_encode(offset, payload);
+    memcpy(&payload[2], &m_image[offset], size);
+    return command_make(APP_GESTURE_CMD_WRITE, payload, 2 + size, p_out);
+}
+
+
+
+static uint16_t commit_make(uint16_t length, uint16_t crc, uint8_t * p_out)
+{
+    uint8_t payload[4];
+
+    (void)uint16_encode(length, &payload[0]);
+    (void)uint16_encode(crc, &payload[2]);
+    return command_make(APP_GESTURE_CMD_COMMIT, payload, sizeof(payload), p_out);
+}
+
+
+
+/**@brief Uploads m_image in pieces of 14 bytes, as gesture_model.py does */
+static void image_write(void)
+{
+    uint8_t             cmd[64];
+    uint16_t            len;
+    app_gesture_model_t model;
+    bool                committed;
+
+    for(uint16_t offset = 0; offset < sizeof(m_image); offset += 14)
+    {
+        len = write_make(offset, MIN(14, sizeof(m_image) - offset), cmd);
+        TEST_CHECK_EQUAL(NRF_SUCCESS, app_gesture_upload_command(&m_upload, cmd, len, CHANNELS, &model, &committed));
+        TEST_CHECK(!committed);
+    }
+}
+
+
+
+static uint32_t commit(uint16_t length, uint16_t crc, app_gesture_model_t * p_model, bool * p_committed)
+{
+    uint8_t  cmd[16];
+    uint16_t len = commit_make(length, crc, cmd);
+
+    return app_gesture_upload_command(&m_upload, cmd, len, CHANNELS, p_model, p_committed);
+}
+
+
+
+static void test_recognizer(void)
+{
+    app_gesture_t       gesture;
+    app_gesture_model_t bad = m_model;
+    int16_t             sample[CHANNELS] = {0};
+    int32_t             features[2 * APP_GESTURE_FEATURE_COUNT];
+    uint8_t             events[2] = {0, 0};
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_gesture_init(&gesture, &m_model, CHANNELS));
+    bad.nodes[1].left = 0; // Loops back to the root
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_gesture_model_check(&bad, CHANNELS));
+    bad = m_model;
+    bad.signals[1] = CHANNELS;
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_gesture_model_check(&bad, CHANNELS));
+
+    // A tap on signal 0, then a grab held on signal 1: one event each
+    for(int i = 0; i < 60; i++)
+    {
+        uint8_t g;
+
+        sample[1] = (i >= 10 && i < 12) ? 2000 : ((i % 2) ? 10 : -10);
+        sample[3] = (i >= 30) ? 5000 : 0;
+        g = app_gesture_push(&gesture, sample);
+        if(g == APP_GESTURE_TAP)  events[0]++;
+        if(g == APP_GESTURE_GRAB) events[1]++;
+    }
+    TEST_CHECK_EQUAL(1, events[0]);
+    TEST_CHECK_EQUAL(1, events[1]);
+
+    app_gesture_features_get(&gesture, features);
+    TEST_CHECK_EQUAL(0, features[APP_GESTURE_FEATURE_INDEX(0, APP_GESTURE_FEATURE_MEAN)]);
+    TEST_CHECK_EQUAL(7, features[APP_GESTURE_FEATURE_INDEX(0, APP_GESTURE_FEATURE_ZERO_CROSSINGS)]);
+    TEST_CHECK_EQUAL(10, features[APP_GESTURE_FEATURE_INDEX(0, APP_GESTURE_FEATURE_PEAK)]);
+    TEST_CHECK_EQUAL(5000, features[APP_GESTURE_FEATURE_INDEX(1, APP_GESTURE_FEATURE_MEAN)]);
+    TEST_CHECK_EQUAL(0, features[APP_GESTURE_FEATURE_INDEX(1, APP_GESTURE_FEATURE_VARIANCE)]);
+}
+
+
+
+static void test_wire_format(void)
+{
+    uint8_t             image[APP_GESTURE_WIRE_MAX_SIZE];
+    app_gesture_model_t model;
+    uint16_t            len;
+
+    len = app_gesture_model_encode(&m_model, image, sizeof(image));
+    TEST_CHECK_EQUAL(sizeof(m_image), len);
+    TEST_CHECK(memcmp(image, m_image, sizeof(m_image)) == 0);
+    TEST_CHECK_EQUAL(0, app_gesture_model_encode(&m_model, image, len - 1));
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_gesture_model_decode(m_image, sizeof(m_image), &model));
+    TEST_CHECK(model_equal(&m_model, &model));
+
+    // Lengths that do not match the counts, and an unknown version
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_gesture_model_decode(m_image, sizeof(m_image) - 1, &model));
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_gesture_model_decode(m_image, 3, &model));
+    memcpy(image, m_image, sizeof(m_image));
+    image[0] = APP_GESTURE_WIRE_VERSION + 1;
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_gesture_model_decode(image, sizeof(m_image), &model));
+    image[0] = APP_GESTURE_WIRE_VERSION;
+    image[2] = APP_GESTURE_MAX_NODES + 1;
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_gesture_model_decode(image, sizeof(m_image), &model));
+}
+
+
+
+static void test_upload(void)
+{
+    uint8_t             cmd[64];
+    uint16_t            len;
+    app_gesture_model_t model;
+    app_gesture_model_t loaded;
+    bool                committed;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_gesture_storage_init());
+    TEST_CHECK_EQUAL(NRF_ERROR_NOT_FOUND, app_gesture_model_load(&loaded));
+    app_gesture_upload_reset(&m_upload);
+
+    // The commands of the host tool
+    for(uint8_t i = 0; i < ARRAY_SIZE(m_commands); i++)
+    {
+        len = hex_decode(m_commands[i], cmd);
+        TEST_CHECK_EQUAL(NRF_SUCCESS, app_gesture_upload_command(&m_upload, cmd, len, CHANNELS, &model, &committed));
+        TEST_CHECK_EQUAL(i == ARRAY_SIZE(m_commands) - 1, committed);
+    }
+    TEST_CHECK(model_equal(&m_model, &model));
+    TEST_CHECK_EQUAL(0, m_upload.length);
+
+    // Stored as it is run
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_gesture_model_save(&model));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_gesture_model_load(&loaded));
+    TEST_CHECK(model_equal(&m_model, &loaded));
+
+    // Other NUS data is left alone
+    cmd[0] = 'h';
+    TEST_CHECK_EQUAL(NRF_ERROR_NOT_SUPPORTED, app_gesture_upload_command(&m_upload, cmd, 1, CHANNELS, &model, &committed));
+    TEST_CHECK_EQUAL(NRF_ERROR_NOT_SUPPORTED, app_gesture_upload_command(&m_upload, cmd, 0, CHANNELS, &model, &committed));
+
+    // A damaged write drops the upload, and the commit finds nothing to take
+    image_write();
+    len = write_make(0, 14, cmd);
+    cmd[5] ^= 0x01;
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, app_gesture_upload_command(&m_upload, cmd, len, CHANNELS, &model, &committed));
+    TEST_CHECK_EQUAL(0, m_upload.length);
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, commit(sizeof(m_image), crc16_compute(m_image, sizeof(m_image), NULL), &model, &committed));
+    TEST_CHECK(!committed);
+
+    // Length byte that does not match, cut off and too short to be framed
+    len = write_make(0, 14, cmd);
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_LENGTH, app_gesture_upload_command(&m_upload, cmd, len - 1, CHANNELS, &model, &committed));
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_LENGTH, app_gesture_upload_command(&m_upload, cmd, 3, CHANNELS, &model, &committed));
+    len = command_make(APP_GESTURE_CMD_WRITE, cmd, 1, cmd);
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_LENGTH, app_gesture_upload_command(&m_upload, cmd, len, CHANNELS, &model, &committed));
+
+    // Out of order: a piece skipped
+    len = write_make(0, 14, cmd);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_gesture_upload_command(&m_upload, cmd, len, CHANNELS, &model, &committed));
+    len = write_make(28, 14, cmd);
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_gesture_upload_command(&m_upload, cmd, len, CHANNELS, &model, &committed));
+    TEST_CHECK_EQUAL(0, m_upload.length);
+
+    // Offset 0 starts over, e.g. after the host lost track
+    len = write_make(0, 14, cmd);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_gesture_upload_command(&m_upload, cmd, len, CHANNELS, &model, &committed));
+    image_write();
+    TEST_CHECK_EQUAL(sizeof(m_image), m_upload.length);
+
+    // Commit of the wrong image
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, commit(sizeof(m_image), crc16_compute(m_image, sizeof(m_image), NULL) ^ 1, &model, &committed));
+    TEST_CHECK(!committed);
+    image_write();
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, commit(sizeof(m_image) - 1, crc16_compute(m_image, sizeof(m_image) - 1, NULL), &model, &committed));
+    TEST_CHECK(!committed);
+
+    // A dropped link, as main.c resets the upload on BLE_GAP_EVT_DISCONNECTED
+    image_write();
+    app_gesture_upload_reset(&m_upload);
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA, commit(sizeof(m_image), crc16_compute(m_image, sizeof(m_image), NULL), &model, &committed));
+    TEST_CHECK(!committed);
+
+    // Framed right, but the model uses a channel the glove does not have
+    image_write();
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_DATA,
+                     app_gesture_upload_command(&m_upload, cmd, commit_make(sizeof(m_image), crc16_compute(m_image, sizeof(m_image), NULL), cmd),
+                                                2, &model, &committed));
+    TEST_CHECK(!committed);
+
+    image_write();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, commit(sizeof(m_image), crc16_compute(m_image, sizeof(m_image), NULL), &model, &committed));
+    TEST_CHECK(committed);
+    TEST_CHECK(model_equal(&m_model, &model));
+}
+
+
+
+int main(void)
+{
+    test_recognizer();
+    test_wire_format();
+    test_upload();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,455 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the mapping of the glove motion to HID reports, app_hid_map.c. The hand is turned and
+ * tilted by known angles, so the mouse counts and stick positions can be checked against the
+ * gains, and the deadzones, the finger hysteresis and the gesture clicks are run through their
+ * edges. The reports are taken as the link would take them, including sends that fail.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_hid_map.h"
+#include "nrf_error.h"
+#include "test.h"
+
+#define Q14_ONE                 16384
+#define MAX_MOVE                127
+#define PRESS_BEND              20000
+#define RELEASE_BEND            12000
+#define GESTURE_TAP             1
+#define GESTURE_GRAB            2
+
+static app_hid_map_t m_map;
+
+
+
+static app_hid_map_config_t config_get(app_hid_map_mode_t mode)
+{
+    app_hid_map_config_t config;
+
+    memset(&config, 0, sizeof(config));
+    config.mode                            = mode;
+    config.axis_x                          = 2;
+    config.axis_y                          = 1;
+    config.gain_x                          = 1000;
+    config.gain_y                          = -500;
+    config.press_bend                      = PRESS_BEND;
+    config.release_bend                    = RELEASE_BEND;
+    config.finger_buttons[1]               = 0x01;
+    config.finger_buttons[2]               = 0x02;
+    config.finger_buttons[3]               = 0x02;
+    config.gesture_buttons[GESTURE_TAP]    = 0x01;
+    config.gesture_buttons[GESTURE_GRAB]   = 0x04;
+    return config;
+}
+
+
+
+/**@brief Orientation turned by angle radians about a glove axis, Q14 */
+static app_mpu_fusion_quat_t quat_get(uint8_t axis, double angle)
+{
+    app_mpu_fusion_quat_t quat = {.w = (int16_t)lround(cos(angle / 2) * Q14_ONE)};
+    int16_t               v    = (int16_t)lround(sin(angle / 2) * Q14_ONE);
+
+    if(axis == 0) quat.x = v;
+    if(axis == 1) quat.y = v;
+    if(axis == 2) quat.z = v;
+    return quat;
+}
+
+
+
+/**@brief Function for turning the hand in steps of step radians about a glove axis */
+static void turn(uint8_t axis, double * p_angle, double step, uint32_t count)
+{
+    for(uint32_t i = 0; i < count; i++)
+    {
+        app_mpu_fusion_quat_t quat;
+
+        *p_angle += step;
+        quat      = quat_get(axis, *p_angle);
+        app_hid_map_orientation_add(&m_map, &quat);
+    }
+}
+
+
+
+/**@brief Function for sending reports until there is nothing new. Returns the motion sent */
+static uint32_t drain(int32_t * p_x, int32_t * p_y)
+{
+    app_hid_map_report_t report;
+    uint32_t             reports = 0;
+
+    *p_x = 0;
+    *p_y = 0;
+    while(app_hid_map_report_get(&m_map, MAX_MOVE, &report))
+    {
+        TEST_CHECK(abs(report.x) <= MAX_MOVE && abs(report.y) <= MAX_MOVE);
+        app_hid_map_report_sent(&m_map, &report);
+        *p_x += report.x;
+        *p_y += report.y;
+        if(++reports > 1000) break;
+    }
+    return reports;
+}
+
+
+
+static void test_init(void)
+{
+    app_hid_map_config_t config = config_get(APP_HID_MAP_MOUSE);
+
+    config.axis_x = 3;
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_PARAM, app_hid_map_init(&m_map, &config));
+    config = config_get(APP_HID_MAP_MOUSE);
+    config.axis_y = 3;
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_PARAM, app_hid_map_init(&m_map, &config));
+}
+
+
+
+static void test_mouse_gain(void)
+{
+    app_hid_map_config_t config = config_get(APP_HID_MAP_MOUSE);
+    app_hid_map_report_t report;
+    double               angle  = 0;
+    int32_t              x;
+    int32_t              y;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_hid_map_init(&m_map, &config));
+
+    // The first orientation only sets the reference
+    turn(2, &angle, 0.5, 1);
+    TEST_CHECK(!app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+
+    // 1 rad about z in steps of 0.01 rad is 1000 counts sideways, sent in reports of at most MAX_MOVE
+    turn(2, &angle, 0.01, 100);
+    TEST_CHECK_EQUAL(8, drain(&x, &y));
+    printf("  1 rad turn: %d %d counts\n", x, y);
+    TEST_CHECK(abs(x - 1000) <= 2);
+    TEST_CHECK_EQUAL(0, y);
+
+    // Tilting about y moves up and down, flipped by the negative gain
+    app_hid_map_reset(&m_map);
+    angle = 0;
+    turn(1, &angle, 0, 1);
+    turn(1, &angle, 0.02, 50);
+    drain(&x, &y);
+    TEST_CHECK_EQUAL(0, x);
+    TEST_CHECK(abs(y + 500) <= 2);
+
+    // The same orientation with the opposite sign is no rotation
+    turn(1, &angle, 0, 1);
+    m_map.last.w = -m_map.last.w;
+    m_map.last.x = -m_map.last.x;
+    m_map.last.y = -m_map.last.y;
+    m_map.last.z = -m_map.last.z;
+    turn(1, &angle, 0.01, 1);
+    drain(&x, &y);
+    TEST_CHECK(abs(y + 5) <= 1);
+
+    // Slow turns under one count per update still add up, the fraction is kept
+    config.gain_x = 100;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_hid_map_init(&m_map, &config));
+    angle = 0;
+    turn(2, &angle, 0, 1);
+    for(uint8_t i = 0; i < 100; i++)
+    {
+        int32_t step_x;
+        int32_t step_y;
+
+        turn(2, &angle, 0.004, 1);      // 0.4 counts
+        drain(&step_x, &step_y);
+        x += step_x;
+    }
+    TEST_CHECK(abs(x - 40) <= 1);
+}
+
+
+
+static void test_mouse_deadzone(void)
+{
+    app_hid_map_config_t config = config_get(APP_HID_MAP_MOUSE);
+    double               angle  = 0;
+    int32_t              x;
+    int32_t              y;
+
+    config.deadzone = (uint16_t)(0.002 * Q14_ONE);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_hid_map_init(&m_map, &config));
+    turn(2, &angle, 0, 1);
+
+    // Tremor under the deadzone is dropped for good, not saved up
+    turn(2, &angle, 0.0015, 200);
+    TEST_CHECK_EQUAL(0, drain(&x, &y));
+
+    // Just past it every update counts in full
+    turn(2, &angle, 0.0025, 200);
+    drain(&x, &y);
+    TEST_CHECK(abs(x - 500) <= 8);
+}
+
+
+
+static void test_mouse_coalescing(void)
+{
+    app_hid_map_config_t config = config_get(APP_HID_MAP_MOUSE);
+    app_hid_map_report_t report;
+    app_hid_map_report_t retry;
+    double               angle  = 0;
+    int32_t              x;
+    int32_t              y;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_hid_map_init(&m_map, &config));
+    turn(2, &angle, 0, 1);
+
+    // Many updates in one report
+    turn(2, &angle, 0.001, 50);
+    TEST_CHECK(app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+    TEST_CHECK(abs(report.x - 50) <= 1);
+
+    // The send failed: the motion stays, and the retry carries it with the motion since
+    turn(2, &angle, 0.001, 30);
+    TEST_CHECK(app_hid_map_report_get(&m_map, MAX_MOVE, &retry));
+    TEST_CHECK(abs(retry.x - 80) <= 1);
+    app_hid_map_report_sent(&m_map, &retry);
+    TEST_CHECK(!app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+
+    // More than a report holds is split, nothing lost
+    turn(2, &angle, 0.01, 30);
+    TEST_CHECK(app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+    TEST_CHECK_EQUAL(MAX_MOVE, report.x);
+    TEST_CHECK_EQUAL(3, drain(&x, &y));
+    TEST_CHECK(abs(x - 300) <= 1);
+
+    // Reset forgets the motion and the reference orientation
+    turn(2, &angle, 0.01, 10);
+    app_hid_map_reset(&m_map);
+    TEST_CHECK(!app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+    turn(2, &angle, 0.5, 1);
+    TEST_CHECK(!app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+}
+
+
+
+static void fingers_set(int16_t bend_1, int16_t bend_2, int16_t bend_3)
+{
+    int16_t bend[APP_HID_MAP_MAX_FINGERS] = {32767, bend_1, bend_2, bend_3, 32767};
+
+    app_hid_map_fingers_set(&m_map, bend, APP_HID_MAP_MAX_FINGERS);
+}
+
+
+
+/**@brief Function for taking a report when there is one and sending it. Returns its buttons, or -1 */
+static int16_t buttons_sent(void)
+{
+    app_hid_map_report_t report;
+
+    if(!app_hid_map_report_get(&m_map, MAX_MOVE, &report)) return -1;
+    app_hid_map_report_sent(&m_map, &report);
+    return report.buttons;
+}
+
+
+
+static void test_fingers(void)
+{
+    app_hid_map_config_t config = config_get(APP_HID_MAP_MOUSE);
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_hid_map_init(&m_map, &config));
+
+    // Fingers 0 and 4 have no buttons
+    fingers_set(0, 0, 0);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+
+    // Pressed at press_bend, held down to release_bend, released under it
+    fingers_set(PRESS_BEND - 1, 0, 0);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+    fingers_set(PRESS_BEND, 0, 0);
+    TEST_CHECK_EQUAL(0x01, buttons_sent());
+    fingers_set(PRESS_BEND - 1, 0, 0);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+    fingers_set(RELEASE_BEND, 0, 0);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+    fingers_set(RELEASE_BEND - 1, 0, 0);
+    TEST_CHECK_EQUAL(0x00, buttons_sent());
+    fingers_set(PRESS_BEND - 1, 0, 0);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+
+    // A finger wavering at the press point gives one press
+    for(uint8_t i = 0; i < 10; i++)
+    {
+        fingers_set((i & 1) ? PRESS_BEND + 100 : PRESS_BEND - 100, 0, 0);
+        TEST_CHECK_EQUAL((i == 1) ? 0x01 : -1, buttons_sent());
+    }
+
+    // Two fingers on one button: held until both are straight
+    fingers_set(0, PRESS_BEND, PRESS_BEND);
+    TEST_CHECK_EQUAL(0x02, buttons_sent());
+    fingers_set(0, 0, PRESS_BEND);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+    fingers_set(0, 0, 0);
+    TEST_CHECK_EQUAL(0x00, buttons_sent());
+
+    // The state of the fingers not given is kept
+    fingers_set(PRESS_BEND, 0, 0);
+    TEST_CHECK_EQUAL(0x01, buttons_sent());
+    app_hid_map_fingers_set(&m_map, (int16_t[]){0, RELEASE_BEND}, 2);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+    app_hid_map_reset(&m_map);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+    fingers_set(RELEASE_BEND, 0, 0);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+}
+
+
+
+static void test_gestures(void)
+{
+    app_hid_map_config_t config = config_get(APP_HID_MAP_MOUSE);
+    app_hid_map_report_t report;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_hid_map_init(&m_map, &config));
+
+    // A click is pressed in one report and released in the next
+    app_hid_map_gesture_add(&m_map, GESTURE_GRAB);
+    TEST_CHECK_EQUAL(0x04, buttons_sent());
+    TEST_CHECK_EQUAL(0x00, buttons_sent());
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+
+    // Unknown and unmapped gestures click nothing
+    app_hid_map_gesture_add(&m_map, APP_HID_MAP_MAX_GESTURES);
+    app_hid_map_gesture_add(&m_map, 0);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+
+    // Two gestures before the link takes a report are one report
+    app_hid_map_gesture_add(&m_map, GESTURE_TAP);
+    app_hid_map_gesture_add(&m_map, GESTURE_GRAB);
+    TEST_CHECK_EQUAL(0x05, buttons_sent());
+    TEST_CHECK_EQUAL(0x00, buttons_sent());
+
+    // A second click before the release was sent is a second click, not one long press
+    app_hid_map_gesture_add(&m_map, GESTURE_TAP);
+    TEST_CHECK_EQUAL(0x01, buttons_sent());
+    app_hid_map_gesture_add(&m_map, GESTURE_TAP);
+    TEST_CHECK_EQUAL(0x00, buttons_sent());
+    TEST_CHECK_EQUAL(0x01, buttons_sent());
+    TEST_CHECK_EQUAL(0x00, buttons_sent());
+
+    // A click of a button a finger holds is dropped, not sent after the finger lets go
+    fingers_set(PRESS_BEND, 0, 0);
+    TEST_CHECK_EQUAL(0x01, buttons_sent());
+    app_hid_map_gesture_add(&m_map, GESTURE_TAP);
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+    fingers_set(0, 0, 0);
+    TEST_CHECK_EQUAL(0x00, buttons_sent());
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+
+    // A click that failed to send is still sent
+    app_hid_map_gesture_add(&m_map, GESTURE_GRAB);
+    TEST_CHECK(app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+    TEST_CHECK_EQUAL(0x04, report.buttons);
+    TEST_CHECK_EQUAL(0x04, buttons_sent());
+    TEST_CHECK_EQUAL(0x00, buttons_sent());
+
+    // A click while a finger holds another button leaves it held
+    fingers_set(0, PRESS_BEND, 0);
+    TEST_CHECK_EQUAL(0x02, buttons_sent());
+    app_hid_map_gesture_add(&m_map, GESTURE_TAP);
+    TEST_CHECK_EQUAL(0x03, buttons_sent());
+    TEST_CHECK_EQUAL(0x02, buttons_sent());
+    fingers_set(0, 0, 0);
+    TEST_CHECK_EQUAL(0x00, buttons_sent());
+}
+
+
+
+static void test_gamepad(void)
+{
+    app_hid_map_config_t  config = config_get(APP_HID_MAP_GAMEPAD);
+    app_hid_map_report_t  report;
+    app_mpu_fusion_quat_t quat;
+
+    config.axis_x   = 1;        // As main.c
+    config.axis_y   = 0;
+    config.gain_x   = 127;
+    config.gain_y   = 127;
+    config.deadzone = (uint16_t)(0.05 * Q14_ONE);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_hid_map_init(&m_map, &config));
+
+    // Level hand, stick centred
+    quat = quat_get(0, 0);
+    app_hid_map_orientation_add(&m_map, &quat);
+    TEST_CHECK(!app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+
+    // Rolled 30 degrees about x, gravity along y is sin(30) and the stick half way sideways
+    quat = quat_get(0, M_PI / 6);
+    app_hid_map_orientation_add(&m_map, &quat);
+    TEST_CHECK(app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+    TEST_CHECK(abs(report.x - 63) <= 1);
+    TEST_CHECK_EQUAL(0, report.y);
+    app_hid_map_report_sent(&m_map, &report);
+    app_hid_map_orientation_add(&m_map, &quat);
+    TEST_CHECK(!app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+
+    // Tilted about y, gravity along x is -sin(angle) and the stick goes up and down
+    quat = quat_get(1, M_PI / 6);
+    app_hid_map_orientation_add(&m_map, &quat);
+    TEST_CHECK(app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+    TEST_CHECK_EQUAL(0, report.x);
+    TEST_CHECK(abs(report.y + 63) <= 1);
+
+    // The send failed, and the next report has the position at that time, not the one before
+    quat = quat_get(1, M_PI / 12);
+    app_hid_map_orientation_add(&m_map, &quat);
+    TEST_CHECK(app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+    TEST_CHECK(abs(report.y + 33) <= 1);
+    app_hid_map_report_sent(&m_map, &report);
+
+    // Within the deadzone the stick is centred, past full deflection it is clamped
+    quat = quat_get(0, 0.04);
+    app_hid_map_orientation_add(&m_map, &quat);
+    TEST_CHECK(app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+    TEST_CHECK_EQUAL(0, report.x);
+    TEST_CHECK_EQUAL(0, report.y);
+    app_hid_map_report_sent(&m_map, &report);
+    config.gain_y = -300;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_hid_map_init(&m_map, &config));
+    quat = quat_get(1, -M_PI / 2);
+    app_hid_map_orientation_add(&m_map, &quat);
+    TEST_CHECK(app_hid_map_report_get(&m_map, MAX_MOVE, &report));
+    TEST_CHECK_EQUAL(-APP_HID_MAP_STICK_MAX, report.y);
+
+    // The fingers and gestures work the same as with the mouse
+    app_hid_map_report_sent(&m_map, &report);
+    app_hid_map_gesture_add(&m_map, GESTURE_TAP);
+    TEST_CHECK_EQUAL(0x01, buttons_sent());
+    TEST_CHECK_EQUAL(0x00, buttons_sent());
+    TEST_CHECK_EQUAL(-1, buttons_sent());
+}
+
+
+
+int main(void)
+{
+    test_init();
+    test_mouse_gain();
+    test_mouse_deadzone();
+    test_mouse_coalescing();
+    test_fingers();
+    test_gestures();
+    test_gamepad();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,447 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the activity state machine in app_mpu_activity.c against the simulated MPU. Runs a scripted
+ * trace of still and moving hand through a model of the glove main loop: 1 ms steps, the INT pin
+ * interrupt at the end of a step when GPIOTE senses the pin high, then app_mpu_activity_process() and
+ * the FIFO drains every 100 ms. The hand counts as still after MPU_IDLE_WINDOWS calibration windows of
+ * 640 ms, as in main.c. Checks that every wake up has full rate sampling back within one sample period
+ * of the interrupt, and reports the time in each power mode with the current it would draw.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "app_mpu.h"
+#include "app_mpu_activity.h"
+#include "app_timer.h"
+#include "nrf_delay.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_drv_mpu.h"
+#include "nrf_drv_mpu_sim.h"
+#include "sdk_errors.h"
+#include "test.h"
+
+#define INT_PIN                 3
+#define STEP_US                 1000
+#define DRAIN_INTERVAL_US       100000
+#define STILL_BEFORE_IDLE_US    (8 * 640000)        // MPU_IDLE_WINDOWS windows of 640 ms, as main.c
+#define SAMPLE_PERIOD_US        10000               // 100 Hz with smplrt_div 9
+#define RTC_MASK                0x00FFFFFF
+
+// Typical supply currents from the data sheets, in uA: gyroscope and accelerometer, low power accelerometer
+// at the wake rate of main.c, and sleep
+#if defined(MPU9255)
+#define CURRENT_ACTIVE_UA       3700
+#define CURRENT_CYCLE_UA        20                  // 31.25 Hz
+#define CURRENT_SLEEP_UA        8
+#define WAKE_PERIOD_US          32000
+#else
+#define CURRENT_ACTIVE_UA       3800
+#define CURRENT_CYCLE_UA        70                  // 20 Hz
+#define CURRENT_SLEEP_UA        5
+#define WAKE_PERIOD_US          50000
+#endif
+
+/**@brief One step of the script */
+typedef struct
+{
+    uint32_t    duration_ms;
+    bool        moving;
+    bool        wake;           // app_mpu_activity_wake() at the start, as when a peer subscribes
+}step_t;
+
+static const step_t m_script[] =
+{
+    {3000,  true,  false},
+    {8000,  false, false},      // Idle after 5.12 s, woken by the motion that follows
+    {2000,  true,  false},
+    {30000, false, false},      // Idle again
+    {8000,  false, true},       // Woken without motion, idle again 5.12 s later
+    {1000,  true,  false},
+    {2000,  false, false},      // Too short to go idle
+};
+
+static uint32_t                     m_time_us;
+static uint32_t                     m_script_end_us;
+static nrf_drv_gpiote_evt_handler_t m_int_handler;
+static bool                         m_int_enabled;
+static bool                         m_int_delivered;    // The PORT event has fired since the sensing was enabled
+static bool                         m_gpiote_init;
+static uint32_t                     m_int_time_us;
+static uint32_t                     m_active_since_us;
+static uint32_t                     m_idle_evts;
+static uint32_t                     m_active_evts;
+
+
+
+static step_t const * script_step(uint32_t time_us)
+{
+    uint32_t end_us = 0;
+
+    for(uint8_t i = 0; i < sizeof(m_script) / sizeof(m_script[0]); i++)
+    {
+        end_us += m_script[i].duration_ms * 1000;
+        if(time_us < end_us) return &m_script[i];
+    }
+    return &m_script[(sizeof(m_script) / sizeof(m_script[0])) - 1];
+}
+
+
+
+static uint32_t script_step_start(step_t const * p_step)
+{
+    uint32_t start_us = 0;
+
+    for(step_t const * p_before = m_script; p_before < p_step; p_before++)
+    {
+        start_us += p_before->duration_ms * 1000;
+    }
+    return start_us;
+}
+
+
+
+/**@brief The hand at rest, or swinging at 1.5 Hz with an amplitude of 0.5 g at 16 g full scale */
+static void motion(uint32_t time_us, nrf_drv_mpu_sim_motion_t * p_motion, void * p_context)
+{
+    (void)p_context;
+    p_motion->accel[0] = 0;
+    p_motion->accel[2] = 2048;
+    p_motion->gyro[0]  = 5;
+    if(script_step(time_us)->moving)
+    {
+        uint32_t phase = time_us % 666667;      // Triangle wave instead of a sine, the same steps per sample
+        int32_t  ramp  = (int32_t)(phase < 333333 ? phase : 666667 - phase);
+
+        p_motion->accel[0] = (int16_t)((ramp * 2048) / 333333 - 1024);
+        p_motion->gyro[0]  = (int16_t)(p_motion->accel[0] / 2);
+    }
+}
+
+
+
+static void time_advance(uint32_t time_us)
+{
+    m_time_us += time_us;
+    nrf_drv_mpu_sim_time_advance(time_us);
+}
+
+
+
+// The blocking delays of app_mpu.c move the clock of the test, and the one of the simulated MPU
+void nrf_delay_ms(uint32_t ms)
+{
+    time_advance(ms * 1000);
+}
+
+
+
+void nrf_delay_us(uint32_t us)
+{
+    time_advance(us);
+}
+
+
+
+// RTC1 at 32768 Hz, without prescaler
+uint32_t app_timer_cnt_get(void)
+{
+    return (uint32_t)(((uint64_t)m_time_us * APP_TIMER_CLOCK_FREQ) / 1000000) & RTC_MASK;
+}
+
+
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff)
+{
+    *p_ticks_diff = (ticks_to - ticks_from) & RTC_MASK;
+    return NRF_SUCCESS;
+}
+
+
+
+static uint32_t ticks_to_us(uint32_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000000) / APP_TIMER_CLOCK_FREQ);
+}
+
+
+
+// GPIOTE in PORT mode on the MPU INT pin
+bool nrf_drv_gpiote_is_init(void)
+{
+    return m_gpiote_init;
+}
+
+
+
+uint32_t nrf_drv_gpiote_init(void)
+{
+    m_gpiote_init = true;
+    return NRF_SUCCESS;
+}
+
+
+
+uint32_t nrf_drv_gpiote_in_init(nrf_drv_gpiote_pin_t pin, nrf_drv_gpiote_in_config_t const * p_config,
+                                nrf_drv_gpiote_evt_handler_t evt_handler)
+{
+    TEST_CHECK_EQUAL(INT_PIN, pin);
+    TEST_CHECK_EQUAL(NRF_GPIOTE_POLARITY_LOTOHI, p_config->sense);
+    TEST_CHECK_EQUAL(NRF_GPIO_PIN_PULLDOWN, p_config->pull);
+    TEST_CHECK(!p_config->hi_accuracy);
+    m_int_handler = evt_handler;
+    return NRF_SUCCESS;
+}
+
+
+
+void nrf_drv_gpiote_in_event_enable(nrf_drv_gpiote_pin_t pin, bool int_enable)
+{
+    TEST_CHECK(int_enable);
+    m_int_enabled   = true;
+    m_int_delivered = false;
+}
+
+
+
+void nrf_drv_gpiote_in_event_disable(nrf_drv_gpiote_pin_t pin)
+{
+    m_int_enabled = false;
+}
+
+
+
+bool nrf_drv_gpiote_in_is_set(nrf_drv_gpiote_pin_t pin)
+{
+    return nrf_drv_mpu_sim_int_get();
+}
+
+
+
+static void activity_evt_handler(app_mpu_activity_state_t state)
+{
+    app_mpu_fifo_en_t fifo_en = MPU_DEFAULT_FIFO_EN_CONFIG();
+
+    if(state == APP_MPU_ACTIVITY_IDLE)
+    {
+        m_idle_evts++;
+        return;
+    }
+
+    // Like mpu_activity_evt_handler() in main.c: the FIFO back on and the still windows counted from here
+    m_active_evts++;
+    m_active_since_us = m_time_us;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+}
+
+
+
+static void setup(void)
+{
+    app_mpu_config_t          config  = MPU_DEFAULT_CONFIG();
+    app_mpu_fifo_en_t         fifo_en = MPU_DEFAULT_FIFO_EN_CONFIG();
+    app_mpu_activity_config_t activity_config;
+
+    nrf_drv_mpu_sim_motion_set(motion, NULL);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_init());
+    config.smplrt_div = 9;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_config(&config));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+
+    activity_config.int_pin                = INT_PIN;
+    activity_config.lp_motion.threshold_mg = 64;
+#if defined(MPU9255)
+    activity_config.lp_motion.wake_rate    = LP_WAKE_31_25HZ;
+#else
+    activity_config.lp_motion.wake_rate    = LP_WAKE_20HZ;
+#endif
+    activity_config.lp_motion.duration_ms  = 1;
+    activity_config.evt_handler            = activity_evt_handler;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_activity_init(&activity_config));
+    TEST_CHECK(m_gpiote_init);
+    TEST_CHECK(m_int_handler != NULL);
+    TEST_CHECK_EQUAL(APP_MPU_ACTIVITY_ACTIVE, app_mpu_activity_state_get());
+
+    for(uint8_t i = 0; i < sizeof(m_script) / sizeof(m_script[0]); i++)
+    {
+        m_script_end_us += m_script[i].duration_ms * 1000;
+    }
+}
+
+
+
+static void drain(uint32_t * p_samples)
+{
+    uint8_t  data[MPU_SAMPLE_SIZE * 16];
+    uint16_t count;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_count_get(&count));
+    while(count >= MPU_SAMPLE_SIZE)
+    {
+        uint16_t length = (count > sizeof(data)) ? sizeof(data) : count - (count % MPU_SAMPLE_SIZE);
+
+        TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_read(data, length));
+        *p_samples += length / MPU_SAMPLE_SIZE;
+        count      -= length;
+    }
+}
+
+
+
+static void test_trace(void)
+{
+    nrf_drv_mpu_sim_stats_t  sim_before;
+    nrf_drv_mpu_sim_stats_t  sim_after;
+    nrf_drv_mpu_sim_stats_t  sim_stats;
+    app_mpu_activity_stats_t stats;
+    step_t const *           p_last_step   = NULL;
+    uint32_t                 next_drain_us = DRAIN_INTERVAL_US;
+    uint32_t                 restored_us   = 0;
+    uint32_t                 still_us;
+    uint32_t                 samples       = 0;
+    uint32_t                 wakes         = 0;
+    uint32_t                 motion_wakes  = 0;
+    uint32_t                 latency_max   = 0;
+    bool                     first_sample  = true;
+
+    while(m_time_us < m_script_end_us)
+    {
+        step_t const * p_step;
+
+        // The INT pin interrupt, then the main loop wakes up from sd_app_evt_wait()
+        time_advance(STEP_US);
+        p_step = script_step(m_time_us);
+        if(p_step != p_last_step && p_step->wake)
+        {
+            app_mpu_activity_wake();
+            m_int_time_us = m_time_us;
+        }
+        p_last_step = p_step;
+        if(m_int_enabled && !m_int_delivered && nrf_drv_mpu_sim_int_get())
+        {
+            m_int_delivered = true;
+            m_int_time_us   = m_time_us;
+            m_int_handler(INT_PIN, NRF_GPIOTE_POLARITY_LOTOHI);
+            TEST_CHECK_EQUAL(APP_MPU_ACTIVITY_WAKING, app_mpu_activity_state_get());
+            TEST_CHECK(p_step->moving);
+            printf("  %6u ms: motion woke the MPU %u us after it started\n", m_time_us / 1000,
+                   m_int_time_us - script_step_start(p_step));
+            TEST_CHECK(m_int_time_us - script_step_start(p_step) <= 2 * WAKE_PERIOD_US);
+            motion_wakes++;
+        }
+
+        if(app_mpu_activity_state_get() == APP_MPU_ACTIVITY_WAKING)
+        {
+            uint32_t latency_us;
+
+            nrf_drv_mpu_sim_stats_get(&sim_before);
+            TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_activity_process());
+            nrf_drv_mpu_sim_stats_get(&sim_after);
+            TEST_CHECK_EQUAL(APP_MPU_ACTIVITY_ACTIVE, app_mpu_activity_state_get());
+            TEST_CHECK(!nrf_drv_mpu_sim_int_get());
+            TEST_CHECK(!m_int_enabled);
+
+            // The delays are on the clock, the blocking transfers are not
+            app_mpu_activity_stats_get(&stats);
+            latency_us  = ticks_to_us(stats.wake_latency_last) + (sim_after.bus_time_us - sim_before.bus_time_us);
+            latency_max = (latency_us > latency_max) ? latency_us : latency_max;
+            TEST_CHECK(latency_us < SAMPLE_PERIOD_US);
+            TEST_CHECK(stats.wake_latency_last < APP_TIMER_TICKS(SAMPLE_PERIOD_US / 1000, 0));
+            restored_us   = m_time_us;
+            first_sample  = false;
+            next_drain_us = m_time_us + DRAIN_INTERVAL_US;
+            wakes++;
+        }
+
+        // The first sample comes within one sample period of full rate sampling, at the 1 ms steps of the loop
+        if(!first_sample && m_time_us - restored_us >= SAMPLE_PERIOD_US)
+        {
+            uint16_t count;
+
+            TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_count_get(&count));
+            TEST_CHECK(count >= MPU_SAMPLE_SIZE);
+            first_sample = true;
+        }
+
+        if(app_mpu_activity_state_get() != APP_MPU_ACTIVITY_ACTIVE) continue;
+
+        if(m_time_us >= next_drain_us)
+        {
+            drain(&samples);
+            next_drain_us += DRAIN_INTERVAL_US;
+
+            still_us = script_step_start(p_step);
+            still_us = (still_us > m_active_since_us) ? still_us : m_active_since_us;
+            if(!p_step->moving && m_time_us - still_us >= STILL_BEFORE_IDLE_US)
+            {
+                TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_activity_idle_enter());
+                TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_activity_idle_enter());
+                TEST_CHECK(m_int_enabled);
+                TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_activity_process()); // Nothing to do while idle
+                TEST_CHECK_EQUAL(APP_MPU_ACTIVITY_IDLE, app_mpu_activity_state_get());
+                printf("  %6u ms: idle\n", m_time_us / 1000);
+            }
+        }
+    }
+
+    app_mpu_activity_stats_get(&stats);
+    nrf_drv_mpu_sim_stats_get(&sim_stats);
+    printf("  %u wake ups, %u by motion, wake latency max %u us (%u ticks), %u samples\n",
+           wakes, motion_wakes, latency_max, stats.wake_latency_max, samples);
+    TEST_CHECK_EQUAL(3, stats.idle_count);
+    TEST_CHECK_EQUAL(3, m_idle_evts);
+    TEST_CHECK_EQUAL(3, m_active_evts);
+    TEST_CHECK_EQUAL(3, wakes);
+    TEST_CHECK_EQUAL(2, motion_wakes);
+    TEST_CHECK(stats.wake_latency_max < APP_TIMER_TICKS(SAMPLE_PERIOD_US / 1000, 0));
+    TEST_CHECK_EQUAL(APP_MPU_ACTIVITY_ACTIVE, app_mpu_activity_state_get());
+    TEST_CHECK_EQUAL(0, sim_stats.fifo_overflows);
+
+    // Idle about (8 - 5.2) + (30 - 5.2) + (8 - 5.2) s of the 54 s, from the first drain after 5.12 s still
+    printf("  idle %u ms of %u ms\n", ticks_to_us(stats.idle_ticks) / 1000, m_time_us / 1000);
+    TEST_CHECK(ticks_to_us(stats.idle_ticks) > 30000000);
+    TEST_CHECK(ticks_to_us(stats.idle_ticks) < 31000000);
+    TEST_CHECK(samples > (m_time_us - ticks_to_us(stats.idle_ticks)) / SAMPLE_PERIOD_US - 100);
+}
+
+
+
+/**@brief Estimated MPU current per mode, from the time the simulated MPU spent in each */
+static void test_current(void)
+{
+    nrf_drv_mpu_sim_stats_t stats;
+    uint32_t                sleep_us;
+    uint64_t                charge;
+    uint32_t                average_ua;
+
+    nrf_drv_mpu_sim_stats_get(&stats);
+    sleep_us   = m_time_us - stats.active_time_us - stats.cycle_time_us;
+    charge     = ((uint64_t)stats.active_time_us * CURRENT_ACTIVE_UA) + ((uint64_t)stats.cycle_time_us * CURRENT_CYCLE_UA) +
+                 ((uint64_t)sleep_us * CURRENT_SLEEP_UA);
+    average_ua = (uint32_t)(charge / m_time_us);
+
+    printf("  active %8u ms at %4u uA\n", stats.active_time_us / 1000, CURRENT_ACTIVE_UA);
+    printf("  cycle  %8u ms at %4u uA\n", stats.cycle_time_us / 1000, CURRENT_CYCLE_UA);
+    printf("  sleep  %8u ms at %4u uA\n", sleep_us / 1000, CURRENT_SLEEP_UA);
+    printf("  average %u uA, %u uA without idling\n", average_ua, CURRENT_ACTIVE_UA);
+    TEST_CHECK(stats.cycle_time_us > 30000000);
+    TEST_CHECK(average_ua < CURRENT_ACTIVE_UA / 2);
+}
+
+
+
+int main(void)
+{
+    setup();
+    test_trace();
+    test_current();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
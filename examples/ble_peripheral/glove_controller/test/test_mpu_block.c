@@ -0,0 +1,384 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the sample block pool, app_mpu_block.c, on nrf_balloc and the simulated MPU. Checks the
+ * reference counts as BLE and logging keep a block after the producer hands it over, that the pool
+ * runs empty and the drains then wait with the samples in the FIFO, and that a full ready queue
+ * gives the block back.
+ *
+ * Then streams through a ready queue the way main.c does and counts the bytes memcpy() copies per
+ * sample, from the FIFO drain to three consumers, against passing the samples on by copy. memcpy()
+ * is wrapped by the linker, and the sources are built with -fno-builtin-memcpy so no copy is inlined.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "app_mpu.h"
+#include "app_mpu_block.h"
+#include "nrf_drv_mpu.h"
+#include "nrf_drv_mpu_sim.h"
+#include "sdk_errors.h"
+#include "test.h"
+
+#define SAMPLE_PERIOD_US        5000                                    // 1 kHz / (1 + 4)
+#define DRAIN_PERIOD_US         (APP_MPU_BLOCK_SAMPLES * SAMPLE_PERIOD_US)
+#define READY_QUEUE_SIZE        APP_MPU_BLOCK_POOL_SIZE                 // As MPU_READY_QUEUE_SIZE in main.c
+#define STREAM_DRAINS           100
+#define CONSUMERS               3                                       // BLE, logging and fusion
+
+/**@brief A consumer that keeps the blocks it is handed until it is told to let go of them, as BLE
+ * does until the notifications are sent
+ */
+typedef struct
+{
+    app_mpu_block_t   * p_blocks[APP_MPU_BLOCK_POOL_SIZE];
+    uint8_t             count;
+}consumer_t;
+
+static uint32_t             m_time_us;
+static int16_t              m_next_index;       // Sample number expected next
+static app_mpu_block_t    * m_ready_blocks[READY_QUEUE_SIZE];
+static uint8_t              m_ready_head;
+static uint8_t              m_ready_tail;
+static uint32_t             m_drains;
+static uint32_t             m_drains_skipped;
+static consumer_t           m_ble;
+static consumer_t           m_log;
+static imu_sample_t         m_copy_samples[APP_MPU_BLOCK_SAMPLES];      // Buffers of the copying path
+static imu_sample_t         m_copy_queue[APP_MPU_BLOCK_SAMPLES];
+static imu_sample_t         m_copy_consumers[CONSUMERS][APP_MPU_BLOCK_SAMPLES];
+static uint16_t             m_copy_num_samples;
+static volatile bool        m_counting;         // volatile, as string.h tells the compiler memcpy() calls nothing in this file
+static volatile uint32_t    m_copied;
+
+void * __real_memcpy(void * p_dst, void const * p_src, size_t size);
+
+
+
+void * __wrap_memcpy(void * p_dst, void const * p_src, size_t size)
+{
+    if(m_counting) m_copied += size;
+    return __real_memcpy(p_dst, p_src, size);
+}
+
+
+
+/**@brief Numbers each sample in accel.x, so lost or repeated samples show */
+static void motion(uint32_t time_us, nrf_drv_mpu_sim_motion_t * p_motion, void * p_context)
+{
+    (void)p_context;
+    p_motion->accel[0] = (int16_t)(time_us / SAMPLE_PERIOD_US);
+    p_motion->accel[2] = 2048;
+    p_motion->gyro[2]  = 17;
+}
+
+
+
+/**@brief Function for passing a drained block on to the ready queue, as mpu_block_ready_handler() in main.c */
+static void block_ready_handler(uint32_t result, void * p_context)
+{
+    app_mpu_block_t * p_block = (app_mpu_block_t *)p_context;
+    uint8_t           next    = (m_ready_tail + 1) % READY_QUEUE_SIZE;
+
+    m_drains++;
+    p_block->timestamp = m_time_us;
+    if(result != NRF_SUCCESS || p_block->num_samples == 0 || next == m_ready_head)
+    {
+        app_mpu_block_release(p_block);
+        return;
+    }
+    m_ready_blocks[m_ready_tail] = p_block;
+    m_ready_tail = next;
+}
+
+
+
+/**@brief Function for draining the FIFO into a new block, as mpu_drain_timer_handler() in main.c, and running the bus */
+static void drain_now(void)
+{
+    app_mpu_block_t * p_block;
+
+    p_block = app_mpu_block_alloc();
+    if(p_block == NULL)
+    {
+        m_drains_skipped++;
+        return;
+    }
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_block_fifo_read_async(p_block, block_ready_handler, p_block));
+    while(nrf_drv_mpu_sim_process() > 0)
+    {
+    }
+}
+
+
+
+static void drain(void)
+{
+    m_time_us += DRAIN_PERIOD_US;
+    nrf_drv_mpu_sim_time_advance(DRAIN_PERIOD_US);
+    drain_now();
+}
+
+
+
+static void consumer_keep(consumer_t * p_consumer, app_mpu_block_t * p_block)
+{
+    app_mpu_block_retain(p_block);
+    p_consumer->p_blocks[p_consumer->count++] = p_block;
+}
+
+
+
+static void consumer_done(consumer_t * p_consumer)
+{
+    for(uint8_t i = 0; i < p_consumer->count; i++)
+    {
+        app_mpu_block_release(p_consumer->p_blocks[i]);
+    }
+    p_consumer->count = 0;
+}
+
+
+
+/**@brief Function for handing the ready blocks to the consumers, as mpu_blocks_process() in main.c.
+ * BLE and logging keep the blocks, fusion reads the samples in place
+ * @retval  Number of samples handed over
+ */
+static uint32_t blocks_process(void)
+{
+    uint32_t samples = 0;
+    int32_t  sum     = 0;
+
+    while(m_ready_head != m_ready_tail)
+    {
+        app_mpu_block_t * p_block = m_ready_blocks[m_ready_head];
+
+        m_ready_head = (m_ready_head + 1) % READY_QUEUE_SIZE;
+        consumer_keep(&m_ble, p_block);
+        consumer_keep(&m_log, p_block);
+        for(uint16_t i = 0; i < p_block->num_samples; i++)
+        {
+            TEST_CHECK_EQUAL(m_next_index, p_block->samples[i].accel.x);
+            TEST_CHECK_EQUAL(17, p_block->samples[i].gyro.z);
+            m_next_index = p_block->samples[i].accel.x + 1;
+            sum += p_block->samples[i].gyro.z;
+        }
+        samples += p_block->num_samples;
+        app_mpu_block_release(p_block);
+    }
+    TEST_CHECK_EQUAL(17 * (int32_t)samples, sum);
+    return samples;
+}
+
+
+
+/**@brief Function for counting the free blocks, by taking them all and giving them back */
+static uint8_t pool_free_count(void)
+{
+    app_mpu_block_t * p_blocks[APP_MPU_BLOCK_POOL_SIZE + 1];
+    uint8_t           count = 0;
+
+    while((count <= APP_MPU_BLOCK_POOL_SIZE) && ((p_blocks[count] = app_mpu_block_alloc()) != NULL))
+    {
+        count++;
+    }
+    for(uint8_t i = 0; i < count; i++) app_mpu_block_release(p_blocks[i]);
+    return count;
+}
+
+
+
+static void setup(void)
+{
+    app_mpu_config_t  config  = MPU_DEFAULT_CONFIG();
+    app_mpu_fifo_en_t fifo_en = MPU_DEFAULT_FIFO_EN_CONFIG();
+
+    nrf_drv_mpu_sim_motion_set(motion, NULL);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_init());
+    config.smplrt_div = 4;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_config(&config));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_block_pool_init());
+    m_next_index = (int16_t)(m_time_us / SAMPLE_PERIOD_US) + 1;
+}
+
+
+
+/**@brief A block is shared by BLE and logging, and goes back to the pool with the last reference */
+static void test_lifecycle(void)
+{
+    app_mpu_block_t * p_block;
+
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_POOL_SIZE, pool_free_count());
+    drain();
+    TEST_CHECK_EQUAL(1, m_drains);
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_POOL_SIZE - 1, pool_free_count());
+
+    p_block = m_ready_blocks[m_ready_head];
+    TEST_CHECK_EQUAL(1, p_block->ref_count);
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_SAMPLES, p_block->num_samples);
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_SAMPLES, blocks_process());
+    TEST_CHECK_EQUAL(2, p_block->ref_count);
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_POOL_SIZE - 1, pool_free_count());
+
+    // Logging is done first. The samples are still there for BLE
+    consumer_done(&m_log);
+    TEST_CHECK_EQUAL(1, p_block->ref_count);
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_POOL_SIZE - 1, pool_free_count());
+    TEST_CHECK_EQUAL(m_next_index - 1, p_block->samples[APP_MPU_BLOCK_SAMPLES - 1].accel.x);
+
+    consumer_done(&m_ble);
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_POOL_SIZE, pool_free_count());
+}
+
+
+
+/**@brief BLE holds on to the blocks while the link is stalled. The pool runs empty, the drains
+ * are skipped and the samples wait in the FIFO, and none are lost once the blocks come back
+ */
+static void test_exhaustion(void)
+{
+    app_mpu_block_t * p_block;
+    uint32_t          samples = 0;
+
+    for(uint8_t i = 0; i < APP_MPU_BLOCK_POOL_SIZE; i++)
+    {
+        drain();
+        samples += blocks_process();
+        consumer_done(&m_log);
+    }
+    TEST_CHECK_EQUAL(0, pool_free_count());
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_POOL_SIZE, app_mpu_block_max_utilization_get());
+    TEST_CHECK(app_mpu_block_alloc() == NULL);
+
+    // A drain period of samples waits in the FIFO, which holds 36 frames on the MPU9255
+    drain();
+    TEST_CHECK_EQUAL(1, m_drains_skipped);
+    consumer_done(&m_ble);
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_POOL_SIZE, pool_free_count());
+
+    // A block holds no more than APP_MPU_BLOCK_SAMPLES, so the backlog takes one more drain to catch up
+    for(uint8_t i = 0; i < 2; i++)
+    {
+        if(i == 0) drain();
+        else drain_now();
+        samples += blocks_process();
+        consumer_done(&m_ble);
+        consumer_done(&m_log);
+    }
+    TEST_CHECK_EQUAL((uint32_t)(m_next_index - 1), samples + APP_MPU_BLOCK_SAMPLES);
+    TEST_CHECK_EQUAL((int16_t)(m_time_us / SAMPLE_PERIOD_US), m_next_index - 1);
+
+    // A full ready queue gives the block back to the pool
+    for(uint8_t i = 0; i < READY_QUEUE_SIZE - 1; i++) drain();
+    TEST_CHECK_EQUAL(READY_QUEUE_SIZE - 1, (m_ready_tail + READY_QUEUE_SIZE - m_ready_head) % READY_QUEUE_SIZE);
+    TEST_CHECK_EQUAL(1, pool_free_count());
+    m_time_us += DRAIN_PERIOD_US;
+    nrf_drv_mpu_sim_time_advance(DRAIN_PERIOD_US);
+    p_block = app_mpu_block_alloc();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_block_fifo_read_async(p_block, block_ready_handler, p_block));
+    while(nrf_drv_mpu_sim_process() > 0)
+    {
+    }
+    TEST_CHECK_EQUAL(1, pool_free_count());
+
+    // The samples of the dropped block are lost. The next ones follow on from it
+    blocks_process();
+    consumer_done(&m_ble);
+    consumer_done(&m_log);
+    TEST_CHECK_EQUAL(APP_MPU_BLOCK_POOL_SIZE, pool_free_count());
+    m_next_index += APP_MPU_BLOCK_SAMPLES;
+}
+
+
+
+/**@brief Function for the drain of the copying path, into one static buffer */
+static void copy_drain_handler(uint32_t result, void * p_context)
+{
+    (void)p_context;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, result);
+}
+
+
+
+/**@brief The bytes memcpy() copies per sample with blocks, and with the samples copied into a
+ * ready queue and from there to each consumer, which is what the pool replaces
+ */
+static void test_copies(void)
+{
+    uint32_t drain_copied = 0;
+    uint32_t block_copied = 0;
+    uint32_t copy_copied  = 0;
+    uint32_t samples      = 0;
+
+    for(uint32_t i = 0; i < STREAM_DRAINS; i++)
+    {
+        uint16_t num_samples;
+
+        m_counting = true;
+        m_copied   = 0;
+        drain();
+        drain_copied += m_copied;
+        m_copied    = 0;
+        num_samples = m_ready_blocks[m_ready_head]->num_samples;
+        samples += blocks_process();
+        consumer_done(&m_ble);
+        consumer_done(&m_log);
+        block_copied += m_copied;
+        m_counting = false;
+        TEST_CHECK_EQUAL(APP_MPU_BLOCK_SAMPLES, num_samples);
+    }
+    TEST_CHECK_EQUAL(STREAM_DRAINS * APP_MPU_BLOCK_SAMPLES, samples);
+
+    // The same drains, with the samples copied on
+    for(uint32_t i = 0; i < STREAM_DRAINS; i++)
+    {
+        m_time_us += DRAIN_PERIOD_US;
+        nrf_drv_mpu_sim_time_advance(DRAIN_PERIOD_US);
+        TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_read_samples_async(m_copy_samples, APP_MPU_BLOCK_SAMPLES,
+                                                                       &m_copy_num_samples, copy_drain_handler, NULL));
+        while(nrf_drv_mpu_sim_process() > 0)
+        {
+        }
+        m_counting = true;
+        m_copied   = 0;
+        memcpy(m_copy_queue, m_copy_samples, m_copy_num_samples * sizeof(imu_sample_t));
+        for(uint8_t j = 0; j < CONSUMERS; j++)
+        {
+            memcpy(m_copy_consumers[j], m_copy_queue, m_copy_num_samples * sizeof(imu_sample_t));
+        }
+        copy_copied += m_copied;
+        m_counting = false;
+        TEST_CHECK_EQUAL(APP_MPU_BLOCK_SAMPLES, m_copy_num_samples);
+        TEST_CHECK_EQUAL(m_next_index + APP_MPU_BLOCK_SAMPLES - 1, m_copy_consumers[CONSUMERS - 1][APP_MPU_BLOCK_SAMPLES - 1].accel.x);
+        m_next_index += APP_MPU_BLOCK_SAMPLES;
+    }
+
+    printf("  memcpy per sample: %u bytes in the FIFO drain, %u bytes from the ready queue to %u consumers with blocks, %u bytes with copies\n",
+           (unsigned)(drain_copied / samples), (unsigned)(block_copied / samples), CONSUMERS, (unsigned)(copy_copied / samples));
+
+    // The drain puts the frame bytes in register order and nothing is copied after it
+    TEST_CHECK_EQUAL(MPU_SAMPLE_SIZE * samples, drain_copied);
+    TEST_CHECK_EQUAL(0, block_copied);
+    TEST_CHECK_EQUAL((1 + CONSUMERS) * sizeof(imu_sample_t) * samples, copy_copied);
+}
+
+
+
+int main(void)
+{
+    setup();
+    test_lifecycle();
+    test_exhaustion();
+    test_copies();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
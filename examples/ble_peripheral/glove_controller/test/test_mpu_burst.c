@@ -0,0 +1,142 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Benchmark of app_mpu_read_all() against separate accelerometer, temperature and gyroscope
+ * reads on the app_twi mock. Counts the bus transactions and bytes per sample and works out the
+ * highest sample rate the 400 kHz bus allows. Also checks the byte order of imu_sample_t.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "app_mpu.h"
+#include "nrf_drv_mpu.h"
+#include "sdk_errors.h"
+#include "mock_app_twi.h"
+#include "test.h"
+
+#define SAMPLES                 1000
+
+typedef struct
+{
+    uint32_t    transactions;
+    uint32_t    bytes;
+    uint32_t    bus_time_us;
+}per_sample_t;
+
+static uint8_t * m_p_regs;
+static uint32_t  m_done;
+
+
+
+static void evt_handler(uint32_t result, void * p_context)
+{
+    TEST_CHECK_EQUAL(NRF_SUCCESS, result);
+    (void)p_context;
+    m_done++;
+}
+
+
+
+static void setup(void)
+{
+    // Accelerometer X, Y, Z, temperature, gyroscope X, Y, Z
+    static const int16_t values[7] = {-2, 300, 16384, -1234, 7, -32768, 32767};
+
+    mock_app_twi_reset();
+    m_p_regs = mock_app_twi_device_add(MPU_ADDRESS);
+    for(uint8_t i = 0; i < 7; i++)
+    {
+        m_p_regs[MPU_REG_ACCEL_XOUT_H + (2 * i)]     = (uint8_t)((uint16_t)values[i] >> 8);
+        m_p_regs[MPU_REG_ACCEL_XOUT_H + (2 * i) + 1] = (uint8_t)values[i];
+    }
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_init());
+}
+
+
+
+static void sample_check(imu_sample_t const * p_sample)
+{
+    TEST_CHECK_EQUAL(-2, p_sample->accel.x);
+    TEST_CHECK_EQUAL(300, p_sample->accel.y);
+    TEST_CHECK_EQUAL(16384, p_sample->accel.z);
+    TEST_CHECK_EQUAL(-1234, p_sample->temp);
+    TEST_CHECK_EQUAL(7, p_sample->gyro.x);
+    TEST_CHECK_EQUAL(-32768, p_sample->gyro.y);
+    TEST_CHECK_EQUAL(32767, p_sample->gyro.z);
+}
+
+
+
+static per_sample_t run(bool burst)
+{
+    mock_app_twi_stats_t before;
+    mock_app_twi_stats_t after;
+    per_sample_t         result;
+    imu_sample_t         sample = {{0}};
+
+    setup();
+    mock_app_twi_stats_get(&before);
+    for(uint32_t i = 0; i < SAMPLES; i++)
+    {
+        if(burst)
+        {
+            TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_all(&sample));
+        }
+        else
+        {
+            TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_accel(&sample.accel));
+            TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_temp(&sample.temp));
+            TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_gyro(&sample.gyro));
+        }
+    }
+    mock_app_twi_stats_get(&after);
+    sample_check(&sample);
+
+    result.transactions = (after.transactions - before.transactions) / SAMPLES;
+    result.bytes        = (after.bytes - before.bytes) / SAMPLES;
+    result.bus_time_us  = (after.bus_time_us - before.bus_time_us) / SAMPLES;
+    printf("  %-28s %u transactions, %2u bytes, %3u us on the bus pr sample. At most %u Hz\n",
+           burst ? "app_mpu_read_all():" : "accel, temp and gyro reads:",
+           result.transactions, result.bytes, result.bus_time_us, 1000000 / result.bus_time_us);
+    return result;
+}
+
+
+
+static void test_async_burst(void)
+{
+    imu_sample_t sample = {{0}};
+
+    setup();
+    m_done = 0;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_all_async(&sample, evt_handler, NULL));
+    TEST_CHECK_EQUAL(NRF_ERROR_BUSY, app_mpu_read_all_async(&sample, evt_handler, NULL));
+    mock_app_twi_time_advance(1000);
+    TEST_CHECK_EQUAL(1, m_done);
+    sample_check(&sample);
+}
+
+
+
+int main(void)
+{
+    per_sample_t separate = run(false);
+    per_sample_t burst    = run(true);
+
+    // Three register address writes and reads become one
+    TEST_CHECK_EQUAL(3, separate.transactions);
+    TEST_CHECK_EQUAL(1, burst.transactions);
+    TEST_CHECK_EQUAL(2 + 1 + 14, burst.bytes);
+    TEST_CHECK_EQUAL(3 * (2 + 1) + 14, separate.bytes);
+    TEST_CHECK(burst.bus_time_us * 4 <= separate.bus_time_us * 3);
+
+    test_async_burst();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,427 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the sensor calibration, app_mpu_calib.c, on a synthetic sensor with a known gyroscope
+ * bias, accelerometer offset and scale per axis, and magnetometer hard and soft iron error. Still
+ * windows must recover the gyroscope bias, six of them resting on each side the accelerometer fit,
+ * and a turn through all orientations the magnetometer fit, and the corrected samples must come
+ * out at the nominal values. Windows with motion, or resting on no side, must leave all as it was.
+ *
+ * One build per MPU type. The MPU9255 has gyroscope offset registers, so there the bias is written
+ * to the simulated MPU, and the synthetic sensor subtracts what the registers hold as the MPU does.
+ * Then the calibration is stored in FDS on the fstorage mock and loaded back.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "app_mpu.h"
+#include "app_mpu_calib.h"
+#include "fds.h"
+#include "mock_fstorage.h"
+#include "nrf_drv_mpu.h"
+#include "nrf_drv_mpu_sim.h"
+#include "sdk_errors.h"
+#include "test.h"
+
+#define ONE_G                   2048                    // AFS_16G
+#define ACCEL_NOISE             6                       // LSB, either way
+#define GYRO_NOISE              3
+#define MAGN_RADIUS             300                     // Earth field in magnetometer LSB
+
+static const int16_t    m_gyro_bias[3]      = {23, -41, 7};
+static const int16_t    m_accel_offset[3]   = {61, -37, 118};
+static const int16_t    m_accel_one_g[3]    = {2095, 2011, 1987};   // 1 g as each axis measures it
+static const int16_t    m_magn_offset[3]    = {140, -95, 52};
+static const int16_t    m_magn_radius[3]    = {330, 285, 300};      // Soft iron stretches each axis
+
+static int16_t          m_gyro_offset[3];       // What the offset registers remove, in LSB
+static uint32_t         m_rand = 1;
+
+
+
+static int16_t noise(int16_t amplitude)
+{
+    m_rand = m_rand * 1103515245 + 12345;
+    return (int16_t)((int32_t)((m_rand >> 16) % (2 * amplitude + 1)) - amplitude);
+}
+
+
+
+/**@brief Reads back the gyroscope offset registers, which the MPU subtracts from every sample */
+static void gyro_offset_update(void)
+{
+#if APP_MPU_CALIB_GYRO_HW
+    uint8_t data[6];
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_XG_OFFSET_H, data, sizeof(data)));
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        // OffsetLSB = X_OFFS_USR * 4 / 2^FS_SEL, at GFS_2000DPS
+        m_gyro_offset[i] = -((int16_t)((data[2 * i] << 8) | data[(2 * i) + 1]) * 4) / 8;
+    }
+#endif
+}
+
+
+
+/**@brief Makes a sample of the sensor with gravity along p_gravity, in g, turning at p_rate LSB */
+static void sample_make(double const * p_gravity, int16_t const * p_rate, accel_values_t * p_accel, gyro_values_t * p_gyro)
+{
+    int16_t accel[3];
+    int16_t gyro[3];
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        accel[i] = (int16_t)lround(m_accel_offset[i] + (p_gravity[i] * m_accel_one_g[i])) + noise(ACCEL_NOISE);
+        gyro[i]  = p_rate[i] + m_gyro_bias[i] - m_gyro_offset[i] + noise(GYRO_NOISE);
+    }
+    p_accel->x = accel[0];
+    p_accel->y = accel[1];
+    p_accel->z = accel[2];
+    p_gyro->x  = gyro[0];
+    p_gyro->y  = gyro[1];
+    p_gyro->z  = gyro[2];
+}
+
+
+
+/**@brief Feeds one window of samples, turning faster and faster up to p_rate
+ * @retval  The APP_MPU_CALIB_VALID_ bits app_mpu_calib_sample_add() reported
+ */
+static uint8_t window_feed(app_mpu_calib_collector_t * p_collector, app_mpu_calib_t * p_calib,
+                           double const * p_gravity, int16_t const * p_rate)
+{
+    uint8_t updated = 0;
+
+    for(uint16_t i = 0; i < APP_MPU_CALIB_WINDOW; i++)
+    {
+        accel_values_t accel;
+        gyro_values_t  gyro;
+        int16_t        rate[3];
+
+        for(uint8_t j = 0; j < 3; j++)
+        {
+            rate[j] = (int16_t)((p_rate[j] * (i + 1)) / APP_MPU_CALIB_WINDOW);
+        }
+        sample_make(p_gravity, rate, &accel, &gyro);
+        updated |= app_mpu_calib_sample_add(p_collector, p_calib, &accel, &gyro);
+    }
+    return updated;
+}
+
+
+
+static void calib_init(app_mpu_calib_t * p_calib, app_mpu_calib_collector_t * p_collector)
+{
+    app_mpu_config_t config = MPU_DEFAULT_CONFIG();
+
+    app_mpu_calib_defaults(p_calib, &config);
+    app_mpu_calib_collector_init(p_collector);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_calib_apply(p_calib));
+    gyro_offset_update();
+}
+
+
+
+static void test_gyro_bias(void)
+{
+    app_mpu_calib_t             calib;
+    app_mpu_calib_collector_t   collector;
+    double const                flat[3]   = {0, 0, 1};
+    int16_t const               still[3]  = {0, 0, 0};
+    int16_t const               moving[3] = {0, 24, 0};
+    int16_t                     sum[3]    = {0};
+
+    calib_init(&calib, &collector);
+    TEST_CHECK_EQUAL(0, m_gyro_offset[0] | m_gyro_offset[1] | m_gyro_offset[2]);
+
+    // Starting to turn, to 24 LSB: more than APP_MPU_CALIB_STILL_RANGE peak to peak
+    TEST_CHECK_EQUAL(0, window_feed(&collector, &calib, flat, moving));
+    TEST_CHECK_EQUAL(0, collector.still_windows);
+
+    TEST_CHECK_EQUAL(APP_MPU_CALIB_VALID_GYRO, window_feed(&collector, &calib, flat, still));
+    TEST_CHECK_EQUAL(1, collector.still_windows);
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        TEST_CHECK(abs(collector.gyro_bias[i] - m_gyro_bias[i]) <= 1);
+    }
+    TEST_CHECK_EQUAL(0, calib.valid & APP_MPU_CALIB_VALID_GYRO);    // Not before it is applied
+
+#if APP_MPU_CALIB_GYRO_HW
+    // A failed register write leaves the calibration as it was, so it keeps matching the registers
+    nrf_drv_mpu_sim_fault_set(0, 1, NRF_ERROR_INTERNAL);
+    TEST_CHECK_EQUAL(NRF_ERROR_INTERNAL, app_mpu_calib_gyro_apply(&collector, &calib));
+    TEST_CHECK_EQUAL(0, calib.valid & APP_MPU_CALIB_VALID_GYRO);
+    gyro_offset_update();
+    TEST_CHECK_EQUAL(0, m_gyro_offset[0] | m_gyro_offset[1] | m_gyro_offset[2]);
+#endif
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_calib_gyro_apply(&collector, &calib));
+    TEST_CHECK(calib.valid & APP_MPU_CALIB_VALID_GYRO);
+    gyro_offset_update();
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        TEST_CHECK_EQUAL(collector.gyro_bias[i], calib.gyro_bias[i]);
+#if APP_MPU_CALIB_GYRO_HW
+        TEST_CHECK_EQUAL(calib.gyro_bias[i], m_gyro_offset[i]);
+#else
+        TEST_CHECK_EQUAL(0, m_gyro_offset[i]);
+#endif
+    }
+
+    // The next still window measures the same bias, over what the registers already remove
+    TEST_CHECK_EQUAL(APP_MPU_CALIB_VALID_GYRO, window_feed(&collector, &calib, flat, still));
+    TEST_CHECK_EQUAL(2, collector.still_windows);
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        TEST_CHECK(abs(collector.gyro_bias[i] - m_gyro_bias[i]) <= 1);
+    }
+
+    // Corrected samples have no bias left, whichever removes it
+    for(uint16_t i = 0; i < APP_MPU_CALIB_WINDOW; i++)
+    {
+        accel_values_t accel;
+        gyro_values_t  gyro;
+
+        sample_make(flat, still, &accel, &gyro);
+        app_mpu_calib_correct(&calib, NULL, &gyro, NULL);
+        sum[0] += gyro.x;
+        sum[1] += gyro.y;
+        sum[2] += gyro.z;
+    }
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        TEST_CHECK(abs(sum[i]) <= APP_MPU_CALIB_WINDOW);
+    }
+    printf("  gyroscope bias %d %d %d LSB, found %d %d %d\n", m_gyro_bias[0], m_gyro_bias[1], m_gyro_bias[2],
+           calib.gyro_bias[0], calib.gyro_bias[1], calib.gyro_bias[2]);
+}
+
+
+
+static void test_accel_fit(void)
+{
+    app_mpu_calib_t             calib;
+    app_mpu_calib_collector_t   collector;
+    int16_t const               still[3] = {0, 0, 0};
+    double const                tilted[3] = {0.7, 0, 0.7};
+
+    calib_init(&calib, &collector);
+
+    // Resting on no side
+    TEST_CHECK_EQUAL(APP_MPU_CALIB_VALID_GYRO, window_feed(&collector, &calib, tilted, still));
+    TEST_CHECK_EQUAL(0, collector.accel_pos_seen);
+
+    for(uint8_t pos = 0; pos < 6; pos++)
+    {
+        double  gravity[3] = {0, 0, 0};
+        uint8_t updated;
+
+        gravity[pos / 2] = (pos & 1) ? -1 : 1;
+        updated = window_feed(&collector, &calib, gravity, still);
+        TEST_CHECK_EQUAL((pos < 5) ? APP_MPU_CALIB_VALID_GYRO : (APP_MPU_CALIB_VALID_GYRO | APP_MPU_CALIB_VALID_ACCEL), updated);
+        TEST_CHECK_EQUAL((1 << (pos + 1)) - 1, collector.accel_pos_seen);
+    }
+    TEST_CHECK(calib.valid & APP_MPU_CALIB_VALID_ACCEL);
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        int32_t scale = (ONE_G * APP_MPU_CALIB_SCALE_ONE) / m_accel_one_g[i];
+
+        TEST_CHECK(abs(calib.accel_offset[i] - m_accel_offset[i]) <= 1);
+        TEST_CHECK(abs(calib.accel_scale[i] - scale) <= scale / 1000);
+    }
+    printf("  accelerometer offset %d %d %d LSB, found %d %d %d. 1 g %d %d %d LSB, scale %d %d %d / 16384\n",
+           m_accel_offset[0], m_accel_offset[1], m_accel_offset[2],
+           calib.accel_offset[0], calib.accel_offset[1], calib.accel_offset[2],
+           m_accel_one_g[0], m_accel_one_g[1], m_accel_one_g[2],
+           calib.accel_scale[0], calib.accel_scale[1], calib.accel_scale[2]);
+
+    // Corrected, each side reads the nominal 1 g
+    for(uint8_t pos = 0; pos < 6; pos++)
+    {
+        double          gravity[3] = {0, 0, 0};
+        int32_t         sum[3]     = {0};
+        accel_values_t  accel;
+        gyro_values_t   gyro;
+
+        gravity[pos / 2] = (pos & 1) ? -1 : 1;
+        for(uint16_t i = 0; i < APP_MPU_CALIB_WINDOW; i++)
+        {
+            sample_make(gravity, still, &accel, &gyro);
+            app_mpu_calib_correct(&calib, &accel, NULL, NULL);
+            sum[0] += accel.x;
+            sum[1] += accel.y;
+            sum[2] += accel.z;
+        }
+        for(uint8_t i = 0; i < 3; i++)
+        {
+            TEST_CHECK(abs((sum[i] / APP_MPU_CALIB_WINDOW) - (int32_t)lround(gravity[i] * ONE_G)) <= 3);
+        }
+    }
+
+    // A moving window in a new position changes nothing
+    {
+        double const  gravity[3] = {0, 0, 1};
+        int16_t const rate[3]    = {200, 0, 0};
+        int16_t       offset[3];
+
+        memcpy(offset, calib.accel_offset, sizeof(offset));
+        collector.accel_pos[4] = 0;
+        TEST_CHECK_EQUAL(0, window_feed(&collector, &calib, gravity, rate) & (APP_MPU_CALIB_VALID_GYRO | APP_MPU_CALIB_VALID_ACCEL));
+        TEST_CHECK_EQUAL(0, collector.accel_pos[4]);
+        TEST_CHECK(memcmp(offset, calib.accel_offset, sizeof(offset)) == 0);
+    }
+}
+
+
+
+static void test_magn_fit(void)
+{
+    app_mpu_calib_t             calib;
+    app_mpu_calib_collector_t   collector;
+    uint16_t const              points = 400;
+    int32_t                     min[3] = {INT16_MAX, INT16_MAX, INT16_MAX};
+    int32_t                     max[3] = {INT16_MIN, INT16_MIN, INT16_MIN};
+
+    calib_init(&calib, &collector);
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_calib_magn_fit(&collector, &calib));
+
+    // Turned through all orientations, the field traces an ellipsoid around the hard iron offset
+    for(uint16_t k = 0; k < points; k++)
+    {
+        double  z   = 1.0 - ((2.0 * k) / (points - 1));
+        double  r   = sqrt(1.0 - (z * z));
+        double  phi = k * 2.39996323;       // Golden angle
+        double  v[3] = {r * cos(phi), r * sin(phi), z};
+        int16_t magn[3];
+
+        for(uint8_t i = 0; i < 3; i++)
+        {
+            magn[i] = (int16_t)lround(m_magn_offset[i] + (v[i] * m_magn_radius[i]));
+        }
+        app_mpu_calib_magn_add(&collector, magn);
+
+        // Half way round the range is too small on x and y
+        if(k == points / 8) TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_calib_magn_fit(&collector, &calib));
+    }
+    // The extremes of x and y, which the spiral passes near but not on
+    for(uint8_t i = 0; i < 2; i++)
+    {
+        for(int8_t sign = -1; sign <= 1; sign += 2)
+        {
+            int16_t magn[3] = {m_magn_offset[0], m_magn_offset[1], m_magn_offset[2]};
+
+            magn[i] += sign * m_magn_radius[i];
+            app_mpu_calib_magn_add(&collector, magn);
+        }
+    }
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_calib_magn_fit(&collector, &calib));
+    TEST_CHECK(calib.valid & APP_MPU_CALIB_VALID_MAGN);
+
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        int32_t scale = (((m_magn_radius[0] + m_magn_radius[1] + m_magn_radius[2]) / 3) * APP_MPU_CALIB_SCALE_ONE) / m_magn_radius[i];
+
+        TEST_CHECK(abs(calib.magn_offset[i] - m_magn_offset[i]) <= 1);
+        TEST_CHECK(abs(calib.magn_scale[i] - scale) <= scale / 200);
+    }
+
+    // Corrected, the ellipsoid is a sphere around zero
+    for(uint16_t k = 0; k < points; k++)
+    {
+        double  z   = 1.0 - ((2.0 * k) / (points - 1));
+        double  r   = sqrt(1.0 - (z * z));
+        double  phi = k * 2.39996323;
+        double  v[3] = {r * cos(phi), r * sin(phi), z};
+        int16_t magn[3];
+
+        for(uint8_t i = 0; i < 3; i++)
+        {
+            magn[i] = (int16_t)lround(m_magn_offset[i] + (v[i] * m_magn_radius[i]));
+        }
+        app_mpu_calib_correct(&calib, NULL, NULL, magn);
+        for(uint8_t i = 0; i < 3; i++)
+        {
+            if(magn[i] < min[i]) min[i] = magn[i];
+            if(magn[i] > max[i]) max[i] = magn[i];
+        }
+    }
+    for(uint8_t i = 0; i < 3; i++)
+    {
+        TEST_CHECK(abs(max[i] + min[i]) <= 4);
+        TEST_CHECK(abs((max[i] - min[i]) - (2 * MAGN_RADIUS)) <= 2 * MAGN_RADIUS / 50);
+    }
+    printf("  magnetometer offset %d %d %d, found %d %d %d. Radius %d %d %d, scale %d %d %d / 16384\n",
+           m_magn_offset[0], m_magn_offset[1], m_magn_offset[2],
+           calib.magn_offset[0], calib.magn_offset[1], calib.magn_offset[2],
+           m_magn_radius[0], m_magn_radius[1], m_magn_radius[2],
+           calib.magn_scale[0], calib.magn_scale[1], calib.magn_scale[2]);
+}
+
+
+
+static void fds_evt_handler(fds_evt_t const * const p_evt)
+{
+    (void)p_evt;
+}
+
+
+
+static void test_storage(void)
+{
+    app_mpu_config_t            config = MPU_DEFAULT_CONFIG();
+    app_mpu_calib_t             calib;
+    app_mpu_calib_t             loaded;
+    app_mpu_calib_collector_t   collector;
+
+    mock_fstorage_reset();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_calib_storage_init());
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_register(fds_evt_handler));
+    TEST_CHECK_EQUAL(FDS_SUCCESS, fds_init());
+    mock_fstorage_run();
+    TEST_CHECK_EQUAL(NRF_ERROR_NOT_FOUND, app_mpu_calib_load(&loaded, &config));
+
+    calib_init(&calib, &collector);
+    calib.gyro_bias[1]    = -41;
+    calib.accel_offset[2] = 118;
+    calib.valid           = APP_MPU_CALIB_VALID_GYRO | APP_MPU_CALIB_VALID_ACCEL;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_calib_save(&calib));
+    TEST_CHECK_EQUAL(NRF_ERROR_BUSY, app_mpu_calib_save(&calib));
+    mock_fstorage_run();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_calib_load(&loaded, &config));
+    TEST_CHECK(memcmp(&calib, &loaded, sizeof(calib)) == 0);
+
+    // Saved again, it replaces the record
+    calib.gyro_bias[1] = -40;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_calib_save(&calib));
+    mock_fstorage_run();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_calib_load(&loaded, &config));
+    TEST_CHECK_EQUAL(-40, loaded.gyro_bias[1]);
+
+    // Collected with another range, it is no use
+    config.gyro_config.fs_sel = GFS_500DPS;
+    TEST_CHECK_EQUAL(NRF_ERROR_NOT_FOUND, app_mpu_calib_load(&loaded, &config));
+}
+
+
+
+int main(void)
+{
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_init());
+
+    test_gyro_bias();
+    test_accel_fit();
+    test_magn_fit();
+    test_storage();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
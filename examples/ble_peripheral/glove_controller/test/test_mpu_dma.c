@@ -0,0 +1,210 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the PPI driven acquisition engine, app_mpu_dma.c, on a model of the nRF52 TWIM, TIMERs
+ * and PPI. Samples at 1 kHz for ten seconds and checks that every trigger ends up in a block, in
+ * order, with two CPU wakeups per buffer. Then makes the re-arm interrupt late and checks that the
+ * TWIM never writes outside the buffer and that every trigger is either in a block or counted by
+ * an overrun event. Also checks stop and start, and that a failed init releases what it took.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_mpu_dma.h"
+#include "nrf_ppi.h"
+#include "sdk_errors.h"
+#include "mock_nrf52_dma.h"
+#include "test.h"
+
+#define DEPTH                   32
+#define RUN_TIME_US             10000000
+
+static uint8_t  m_buffer[APP_MPU_DMA_BUFFER_SIZE(APP_MPU_DMA_ALL_SIZE, DEPTH)];
+static uint32_t m_next_trigger;     // Trigger expected in the next sample. 0 to take any after a restart
+static uint32_t m_received;
+static uint32_t m_overrun;
+static uint32_t m_blocks;
+
+
+
+static void evt_handler(app_mpu_dma_evt_t const * p_evt, void * p_context)
+{
+    (void)p_context;
+    if(p_evt->type == APP_MPU_DMA_EVT_OVERRUN)
+    {
+        m_overrun      += p_evt->num_samples;
+        m_next_trigger += p_evt->num_samples;
+        return;
+    }
+    TEST_CHECK_EQUAL(APP_MPU_DMA_EVT_BLOCK_DONE, p_evt->type);
+    TEST_CHECK_EQUAL(DEPTH, p_evt->num_samples);
+
+    // The blocks take turns
+    TEST_CHECK(p_evt->p_block == &m_buffer[(m_blocks % 2) * DEPTH * APP_MPU_DMA_ALL_SIZE]);
+    m_blocks++;
+
+    for(uint16_t i = 0; i < p_evt->num_samples; i++)
+    {
+        uint8_t const * p_sample = p_evt->p_block + (i * APP_MPU_DMA_ALL_SIZE);
+        uint16_t        trigger  = (uint16_t)((p_sample[0] << 8) | p_sample[1]);
+
+        if(m_next_trigger == 0)
+        {
+            m_next_trigger = trigger;
+        }
+        TEST_CHECK_EQUAL((uint16_t)m_next_trigger, trigger);
+        TEST_CHECK_EQUAL(APP_MPU_DMA_ALL_REG + 2, p_sample[2]);
+        TEST_CHECK_EQUAL(APP_MPU_DMA_ALL_REG + APP_MPU_DMA_ALL_SIZE - 1, p_sample[APP_MPU_DMA_ALL_SIZE - 1]);
+        m_next_trigger = trigger + 1;
+        m_received++;
+    }
+}
+
+
+
+static void setup(uint32_t irq_latency_us)
+{
+    app_mpu_dma_config_t config = APP_MPU_DMA_DEFAULT_CONFIG(m_buffer, evt_handler);
+
+    mock_nrf52_dma_reset();
+    mock_nrf52_dma_irq_latency_set(irq_latency_us);
+    mock_nrf52_dma_buffer_set(m_buffer, sizeof(m_buffer));
+    m_next_trigger = 1;
+    m_received     = 0;
+    m_overrun      = 0;
+    m_blocks       = 0;
+
+    config.depth = DEPTH;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_dma_init(&config));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_dma_start());
+}
+
+
+
+/**@brief Function for sampling for RUN_TIME_US with the re-arm interrupt irq_latency_us late */
+static void run(uint32_t irq_latency_us, mock_nrf52_dma_stats_t * p_stats)
+{
+    setup(irq_latency_us);
+    mock_nrf52_dma_time_advance(RUN_TIME_US);
+    mock_nrf52_dma_stats_get(p_stats);
+    app_mpu_dma_uninit();
+    TEST_CHECK_EQUAL(0, mock_nrf52_dma_resources_in_use());
+
+    printf("  interrupt latency %4u us: %u triggers, %u samples in blocks, %u counted as overrun, %u wakeups\n",
+           irq_latency_us, p_stats->triggers, m_received, m_overrun, p_stats->irqs);
+    TEST_CHECK_EQUAL(RUN_TIME_US / 1000, p_stats->triggers);
+    TEST_CHECK_EQUAL(0, p_stats->out_of_bounds);
+    TEST_CHECK_EQUAL(0, p_stats->busy_starts);
+}
+
+
+
+static void test_no_loss(void)
+{
+    mock_nrf52_dma_stats_t stats;
+
+    // Up to the end of the last block, every trigger is read and handed over exactly once
+    run(20, &stats);
+    TEST_CHECK_EQUAL(0, m_overrun);
+    TEST_CHECK_EQUAL(stats.triggers - (stats.triggers % DEPTH), m_received);
+    TEST_CHECK_EQUAL(stats.triggers, stats.reads + 1);      // The last trigger is still being read
+    TEST_CHECK_EQUAL(m_blocks, stats.irqs);
+
+    // The counter interrupt may be late by the gap between the end of a read and the next trigger
+    run(500, &stats);
+    TEST_CHECK_EQUAL(0, m_overrun);
+    TEST_CHECK_EQUAL(stats.triggers - (stats.triggers % DEPTH), m_received);
+}
+
+
+
+static void test_late_rearm(void)
+{
+    mock_nrf52_dma_stats_t stats;
+
+    // The trigger is parked in hardware until the interrupt has moved the RX pointer back, so
+    // nothing is written past the buffer. The triggers missed meanwhile are reported
+    run(2500, &stats);
+    TEST_CHECK(m_overrun > 0);
+    TEST_CHECK_EQUAL(stats.reads + m_overrun, stats.triggers - 1);
+    TEST_CHECK_EQUAL(m_next_trigger - 1, m_received + m_overrun);
+    TEST_CHECK(stats.triggers - (m_received + m_overrun) < 2 * DEPTH);
+}
+
+
+
+static void test_stop_start(void)
+{
+    mock_nrf52_dma_stats_t before;
+    mock_nrf52_dma_stats_t after;
+
+    setup(20);
+    mock_nrf52_dma_time_advance(DEPTH * 1000 + 10 * 1000);
+    TEST_CHECK_EQUAL(DEPTH, m_received);
+
+    // Nothing is read while stopped
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_dma_stop());
+    mock_nrf52_dma_time_advance(500);
+    mock_nrf52_dma_stats_get(&before);
+    mock_nrf52_dma_time_advance(100 * 1000);
+    mock_nrf52_dma_stats_get(&after);
+    TEST_CHECK_EQUAL(before.reads, after.reads);
+    TEST_CHECK_EQUAL(before.triggers, after.triggers);
+
+    // Sampling starts over from the first block, with the partial block dropped
+    m_next_trigger = 0;
+    m_blocks       = 0;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_dma_start());
+    mock_nrf52_dma_time_advance(2 * DEPTH * 1000 + 500);
+    TEST_CHECK_EQUAL(3 * DEPTH, m_received);
+    TEST_CHECK_EQUAL(0, m_overrun);
+    app_mpu_dma_uninit();
+}
+
+
+
+static void test_init_release(void)
+{
+    app_mpu_dma_config_t config = APP_MPU_DMA_DEFAULT_CONFIG(m_buffer, evt_handler);
+
+    mock_nrf52_dma_reset();
+
+    // Out of PPI channels, then out of PPI groups: what was taken is given back
+    mock_nrf52_dma_ppi_limit_set(3, PPI_GROUP_NUM);
+    TEST_CHECK_EQUAL(NRF_ERROR_NO_MEM, app_mpu_dma_init(&config));
+    TEST_CHECK_EQUAL(0, mock_nrf52_dma_resources_in_use());
+    mock_nrf52_dma_ppi_limit_set(PPI_CH_NUM, 1);
+    TEST_CHECK_EQUAL(NRF_ERROR_NO_MEM, app_mpu_dma_init(&config));
+    TEST_CHECK_EQUAL(0, mock_nrf52_dma_resources_in_use());
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_dma_start());
+
+    // TWI, two TIMERs, four PPI channels and two groups
+    mock_nrf52_dma_ppi_limit_set(PPI_CH_NUM, PPI_GROUP_NUM);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_dma_init(&config));
+    TEST_CHECK_EQUAL(9, mock_nrf52_dma_resources_in_use());
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_dma_init(&config));
+    app_mpu_dma_uninit();
+    TEST_CHECK_EQUAL(0, mock_nrf52_dma_resources_in_use());
+
+    config.depth = 0;
+    TEST_CHECK_EQUAL(MPU_BAD_PARAMETER, app_mpu_dma_init(&config));
+}
+
+
+
+int main(void)
+{
+    test_no_loss();
+    test_late_rearm();
+    test_stop_start();
+    test_init_release();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,225 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the FIFO streaming in app_mpu.c against the simulated MPU. Streams for a few seconds
+ * and checks that every sample arrives once and in order, that drains split into whole frames
+ * per bus transaction, that an overflow is reported and streaming resyncs on a frame boundary,
+ * and that a drain stops at the first bus error.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "app_mpu.h"
+#include "nrf_drv_mpu.h"
+#include "nrf_drv_mpu_sim.h"
+#include "sdk_errors.h"
+#include "test.h"
+
+#define SAMPLE_PERIOD_US        5000    // 1 kHz / (1 + 4)
+#define DRAIN_PERIOD_US         100000  // 20 samples pr wakeup
+#define MAX_SAMPLES             64
+
+static uint32_t     m_time_us;
+static int16_t      m_next_index;       // Sample number expected next
+static imu_sample_t m_samples[MAX_SAMPLES];
+static uint16_t     m_num_samples;
+static uint32_t     m_drain_result;
+static uint32_t     m_drains;
+
+
+
+/**@brief Numbers each sample in accel.x, so lost or repeated samples show */
+static void motion(uint32_t time_us, nrf_drv_mpu_sim_motion_t * p_motion, void * p_context)
+{
+    (void)p_context;
+    p_motion->accel[0] = (int16_t)(time_us / SAMPLE_PERIOD_US);
+    p_motion->accel[2] = 2048;
+    p_motion->temp     = 340;
+    p_motion->gyro[0]  = (int16_t)-(time_us / SAMPLE_PERIOD_US);
+    p_motion->gyro[2]  = 17;
+}
+
+
+
+static void time_advance(uint32_t time_us)
+{
+    m_time_us += time_us;
+    nrf_drv_mpu_sim_time_advance(time_us);
+}
+
+
+
+static void drain_handler(uint32_t result, void * p_context)
+{
+    (void)p_context;
+    m_drain_result = result;
+    m_drains++;
+}
+
+
+
+/**@brief Function for draining the FIFO the way a drain timer would, and running the bus
+ * @retval  Result passed to the handler
+ */
+static uint32_t drain(uint16_t max_samples)
+{
+    uint32_t drains = m_drains;
+
+    m_num_samples = 0xFFFF;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_read_samples_async(m_samples, max_samples, &m_num_samples, drain_handler, NULL));
+    TEST_CHECK_EQUAL(NRF_ERROR_BUSY, app_mpu_fifo_read_samples_async(m_samples, max_samples, &m_num_samples, drain_handler, NULL));
+    while(nrf_drv_mpu_sim_process() > 0)
+    {
+    }
+    TEST_CHECK_EQUAL(drains + 1, m_drains);
+    return m_drain_result;
+}
+
+
+
+/**@brief Function for checking that the drained samples follow on from the last ones */
+static void samples_check(bool gyro)
+{
+    for(uint16_t i = 0; i < m_num_samples; i++)
+    {
+        TEST_CHECK_EQUAL(m_next_index, m_samples[i].accel.x);
+        TEST_CHECK_EQUAL(2048, m_samples[i].accel.z);
+        TEST_CHECK_EQUAL(340, m_samples[i].temp);
+        TEST_CHECK_EQUAL(gyro ? -m_next_index : 0, m_samples[i].gyro.x);
+        TEST_CHECK_EQUAL(gyro ? 17 : 0, m_samples[i].gyro.z);
+        m_next_index = m_samples[i].accel.x + 1;
+    }
+}
+
+
+
+static void setup(void)
+{
+    app_mpu_config_t  config  = MPU_DEFAULT_CONFIG();
+    app_mpu_fifo_en_t fifo_en = MPU_DEFAULT_FIFO_EN_CONFIG();
+
+    nrf_drv_mpu_sim_motion_set(motion, NULL);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_init());
+    config.smplrt_div = 4;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_config(&config));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+    m_next_index = (int16_t)(m_time_us / SAMPLE_PERIOD_US) + 1;
+}
+
+
+
+static void test_streaming(void)
+{
+    nrf_drv_mpu_sim_stats_t before;
+    nrf_drv_mpu_sim_stats_t after;
+    uint32_t                samples = 0;
+
+    nrf_drv_mpu_sim_stats_get(&before);
+    for(uint32_t i = 0; i < 30; i++)
+    {
+        time_advance(DRAIN_PERIOD_US);
+        TEST_CHECK_EQUAL(NRF_SUCCESS, drain(MAX_SAMPLES));
+        TEST_CHECK_EQUAL(DRAIN_PERIOD_US / SAMPLE_PERIOD_US, m_num_samples);
+        samples_check(true);
+        samples += m_num_samples;
+    }
+    nrf_drv_mpu_sim_stats_get(&after);
+
+    // FIFO_COUNT, then 18 frames (252 bytes) and 2 frames: 3 transactions pr wakeup instead of 1 pr sample
+    printf("  %u samples in %u wakeups, %u transactions\n", samples, 30, after.transactions - before.transactions);
+    TEST_CHECK_EQUAL(30 * 3, after.transactions - before.transactions);
+    TEST_CHECK_EQUAL(0, after.fifo_overflows - before.fifo_overflows);
+}
+
+
+
+static void test_partial_drain(void)
+{
+    // What does not fit in the buffer is left for the next drain
+    time_advance(DRAIN_PERIOD_US);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, drain(5));
+    TEST_CHECK_EQUAL(5, m_num_samples);
+    samples_check(true);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, drain(MAX_SAMPLES));
+    TEST_CHECK_EQUAL(DRAIN_PERIOD_US / SAMPLE_PERIOD_US - 5, m_num_samples);
+    samples_check(true);
+}
+
+
+
+static void test_overflow_resync(void)
+{
+    nrf_drv_mpu_sim_stats_t stats;
+
+    // The FIFO holds MPU_FIFO_SIZE / 14 samples. Miss enough drains for it to wrap
+    time_advance((MPU_FIFO_SIZE / MPU_SAMPLE_SIZE + 10) * SAMPLE_PERIOD_US);
+    nrf_drv_mpu_sim_stats_get(&stats);
+    TEST_CHECK(stats.fifo_overflows > 0);
+    TEST_CHECK_EQUAL(MPU_FIFO_OVERFLOW, drain(MAX_SAMPLES));
+    TEST_CHECK_EQUAL(0, m_num_samples);
+
+    // The FIFO was reset, so the next drain starts on a frame boundary with the newest samples
+    m_next_index = (int16_t)(m_time_us / SAMPLE_PERIOD_US) + 1;
+    time_advance(DRAIN_PERIOD_US);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, drain(MAX_SAMPLES));
+    TEST_CHECK_EQUAL(DRAIN_PERIOD_US / SAMPLE_PERIOD_US, m_num_samples);
+    samples_check(true);
+}
+
+
+
+static void test_bus_error(void)
+{
+    // FIFO_COUNT is read, the first data transaction fails. The rest stays in the FIFO
+    time_advance(DRAIN_PERIOD_US);
+    nrf_drv_mpu_sim_fault_set(1, 1, NRF_ERROR_DRV_TWI_ERR_DNACK);
+    TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_DNACK, drain(MAX_SAMPLES));
+    TEST_CHECK_EQUAL(0, m_num_samples);
+
+    // Samples are not lost when the FIFO read itself never happened, they are drained next time
+    TEST_CHECK_EQUAL(NRF_SUCCESS, drain(MAX_SAMPLES));
+    TEST_CHECK_EQUAL(DRAIN_PERIOD_US / SAMPLE_PERIOD_US, m_num_samples);
+    samples_check(true);
+}
+
+
+
+static void test_accel_temp_only(void)
+{
+    app_mpu_fifo_en_t fifo_en = {.accel = 1, .temp = 1};
+
+    // 8 byte frames: 31 frames fit in one transaction
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+    m_next_index = (int16_t)(m_time_us / SAMPLE_PERIOD_US) + 1;
+    time_advance(DRAIN_PERIOD_US);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, drain(MAX_SAMPLES));
+    TEST_CHECK_EQUAL(DRAIN_PERIOD_US / SAMPLE_PERIOD_US, m_num_samples);
+    samples_check(false);
+
+    // Slave data does not fit an imu_sample_t, and a disabled FIFO has nothing to drain
+    fifo_en.slv0 = 1;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_fifo_read_samples_async(m_samples, MAX_SAMPLES, &m_num_samples, NULL, NULL));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_disable());
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_fifo_read_samples_async(m_samples, MAX_SAMPLES, &m_num_samples, NULL, NULL));
+}
+
+
+
+int main(void)
+{
+    setup();
+    test_streaming();
+    test_partial_drain();
+    test_overflow_resync();
+    test_bus_error();
+    test_accel_temp_only();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
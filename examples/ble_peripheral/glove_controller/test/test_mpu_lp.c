@@ -0,0 +1,213 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the low power motion detection in app_mpu.c against the simulated MPU. Puts the MPU to
+ * sleep, checks that motion wakes it through the latched INT pin and that full rate sampling comes
+ * back as before. Then fails each transfer of the sequence in turn and checks that the MPU is
+ * written back to where it was, except for the FIFO, and that the sequence can be tried again.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "app_mpu.h"
+#include "nrf_drv_mpu.h"
+#include "nrf_drv_mpu_sim.h"
+#include "sdk_errors.h"
+#include "test.h"
+
+#define MOVE_AT_US              3000000
+#define MAX_TRANSFERS           32
+
+static uint32_t m_time_us;
+static bool     m_moving;
+
+// Registers the sequence changes and must put back
+static const uint8_t m_regs[] = {MPU_REG_PWR_MGMT_1, MPU_REG_PWR_MGMT_2, MPU_REG_INT_ENABLE, MPU_REG_INT_PIN_CFG,
+#if defined(MPU9255)
+                                 MPU_REG_ACCEL_CONFIG_2, MPU_REG_MOT_DETECT_CTRL, MPU_REG_USER_CTRL,
+#else
+                                 MPU_REG_ACCEL_CONFIG,
+#endif
+                                };
+
+
+
+static void motion(uint32_t time_us, nrf_drv_mpu_sim_motion_t * p_motion, void * p_context)
+{
+    (void)p_context;
+    p_motion->accel[2] = 2048;
+    p_motion->gyro[0]  = 5;
+    if(m_moving && time_us >= MOVE_AT_US)
+    {
+        p_motion->accel[0] = (int16_t)((time_us - MOVE_AT_US) / 100);
+    }
+}
+
+
+
+static void time_advance(uint32_t time_us)
+{
+    m_time_us += time_us;
+    nrf_drv_mpu_sim_time_advance(time_us);
+}
+
+
+
+static app_mpu_lp_motion_config_t lp_config(void)
+{
+    app_mpu_lp_motion_config_t config = {.threshold_mg = 64, .duration_ms = 1};
+
+#if defined(MPU9255)
+    config.wake_rate = LP_WAKE_31_25HZ;
+#else
+    config.wake_rate = LP_WAKE_20HZ;
+#endif
+    return config;
+}
+
+
+
+static void setup(void)
+{
+    app_mpu_config_t  config  = MPU_DEFAULT_CONFIG();
+    app_mpu_fifo_en_t fifo_en = MPU_DEFAULT_FIFO_EN_CONFIG();
+
+    nrf_drv_mpu_sim_motion_set(motion, NULL);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_init());
+    config.smplrt_div = 9;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_config(&config));
+#if defined(MPU9255)
+    app_mpu_magn_config_t magn_config = {.mode = CONTINUOUS_MEASUREMENT_100Hz_MODE, .resolution = 1};
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_magnetometer_master_init(&magn_config));
+#endif
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+    time_advance(100000);
+}
+
+
+
+static void regs_save(uint8_t * p_regs)
+{
+    for(uint8_t i = 0; i < sizeof(m_regs); i++)
+    {
+        p_regs[i] = nrf_drv_mpu_sim_register_get(m_regs[i]);
+    }
+}
+
+
+
+static void regs_check(uint8_t const * p_regs)
+{
+    for(uint8_t i = 0; i < sizeof(m_regs); i++)
+    {
+        TEST_CHECK_EQUAL(p_regs[i], nrf_drv_mpu_sim_register_get(m_regs[i]));
+    }
+}
+
+
+
+static void test_wake(void)
+{
+    app_mpu_lp_motion_config_t config  = lp_config();
+    app_mpu_fifo_en_t          fifo_en = MPU_DEFAULT_FIFO_EN_CONFIG();
+    nrf_drv_mpu_sim_stats_t    stats;
+    uint8_t                    regs[sizeof(m_regs)];
+    uint16_t                   count;
+    bool                       woke = false;
+
+    regs_save(regs);
+    m_moving = true;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_lp_motion_enable(&config));
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_lp_motion_enable(&config));
+    TEST_CHECK(!nrf_drv_mpu_sim_int_get());
+
+    // Still until MOVE_AT_US, then the INT pin goes up within a few wake periods
+    while(m_time_us < MOVE_AT_US + 1000000 && !woke)
+    {
+        time_advance(1000);
+        woke = nrf_drv_mpu_sim_int_get();
+    }
+    TEST_CHECK(woke);
+    TEST_CHECK(m_time_us >= MOVE_AT_US);
+    printf("  woke %u us after the motion started\n", m_time_us - MOVE_AT_US);
+    TEST_CHECK(m_time_us - MOVE_AT_US < 200000);
+
+    // Back to full rate, the INT pin released and the configuration as before
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_lp_motion_disable());
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_lp_motion_disable());
+    TEST_CHECK(!nrf_drv_mpu_sim_int_get());
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+    regs_check(regs);
+    time_advance(100000);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_count_get(&count));
+    TEST_CHECK(count / MPU_SAMPLE_SIZE >= 9);
+
+    nrf_drv_mpu_sim_stats_get(&stats);
+    printf("  %u us active, %u us in cycle mode\n", stats.active_time_us, stats.cycle_time_us);
+    TEST_CHECK(stats.cycle_time_us > 0);
+    m_moving = false;
+}
+
+
+
+static void test_rollback(void)
+{
+    app_mpu_lp_motion_config_t config  = lp_config();
+    app_mpu_fifo_en_t          fifo_en = MPU_DEFAULT_FIFO_EN_CONFIG();
+    nrf_drv_mpu_sim_stats_t    before;
+    nrf_drv_mpu_sim_stats_t    after;
+    uint8_t                    regs[sizeof(m_regs)];
+    uint32_t                   transactions;
+
+    // Count the transfers of the sequence
+    regs_save(regs);
+    nrf_drv_mpu_sim_stats_get(&before);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_lp_motion_enable(&config));
+    nrf_drv_mpu_sim_stats_get(&after);
+    transactions = after.transactions - before.transactions;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_lp_motion_disable());
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+    TEST_CHECK(transactions > 10 && transactions < MAX_TRANSFERS);
+
+    // Wherever it fails, the MPU is put back and the next try goes through
+    for(uint32_t skip = 0; skip < transactions; skip++)
+    {
+        nrf_drv_mpu_sim_fault_set(skip, 1, NRF_ERROR_DRV_TWI_ERR_DNACK);
+        TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_DNACK, app_mpu_lp_motion_enable(&config));
+        TEST_CHECK(!nrf_drv_mpu_sim_int_get());
+        TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en)); // The FIFO is left disabled, like main.c does
+        regs_check(regs);
+
+        TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_lp_motion_enable(&config));
+        TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_lp_motion_disable());
+        TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+        regs_check(regs);
+    }
+
+    // A failure on the way out still leaves the MPU out of cycle mode, and the rest written back
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_lp_motion_enable(&config));
+    nrf_drv_mpu_sim_fault_set(1, 1, NRF_ERROR_DRV_TWI_ERR_DNACK);
+    TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_DNACK, app_mpu_lp_motion_disable());
+    TEST_CHECK_EQUAL(0, nrf_drv_mpu_sim_register_get(MPU_REG_INT_ENABLE) & (1 << 6));    // MOT_EN, WOM_EN on the MPU9255
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_lp_motion_enable(&config));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_lp_motion_disable());
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_fifo_enable(&fifo_en));
+    regs_check(regs);
+}
+
+
+
+int main(void)
+{
+    setup();
+    test_wake();
+    test_rollback();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
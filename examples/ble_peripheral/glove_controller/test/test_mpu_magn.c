@@ -0,0 +1,308 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the magnetometer behind the MPU9255 I2C master, app_mpu_magnetometer_master_init() and
+ * app_mpu_read_all_magn(), on the simulated MPU. The register accesses of app_mpu.c are wrapped
+ * and logged, so the test checks the sequence: bypass off, the I2C master on, the magnetometer
+ * configured with a slave 4 write that is polled until DONE, and slave 0 set up to read HXL to ST2
+ * at every sample. The wrapper also holds back DONE, or reports a NACK, to check that the init
+ * gives up on both. Then one 21 byte burst must give the accelerometer, temperature, gyroscope and
+ * magnetometer values of the same sample. One build over TWI and one over SPI.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_mpu.h"
+#include "nrf_drv_mpu.h"
+#include "nrf_drv_mpu_sim.h"
+#include "sdk_errors.h"
+#include "test.h"
+
+#define MAX_LOG                 160
+#define SLV4_TIMEOUT_POLLS      100     // MPU_SLV4_TIMEOUT_MS polls, 1 ms apart
+#define BYPASS_EN               0x02    // I2C_BYPASS_EN in INT_PIN_CFG
+#define I2C_MST_EN              0x20    // In USER_CTRL
+#define I2C_IF_DIS              0x10
+#define SLV4_DONE               0x40    // In I2C_MST_STATUS
+#define SLV4_NACK               0x10
+
+/**@brief A register access of app_mpu.c */
+typedef struct
+{
+    bool        read;
+    uint8_t     reg;
+    uint8_t     length;
+    uint8_t     data[3];    // Written
+}access_t;
+
+static access_t m_log[MAX_LOG];
+static uint16_t m_log_count;
+static uint16_t m_status_busy;      // Polls of I2C_MST_STATUS that see the slave 4 transfer still running
+static bool     m_status_nack;      // The magnetometer does not acknowledge slave 4
+
+static const app_mpu_magn_config_t m_magn_config = {.mode = CONTINUOUS_MEASUREMENT_100Hz_MODE, .resolution = 1};
+
+uint32_t __real_nrf_drv_mpu_read_registers(uint8_t reg, uint8_t * p_data, uint32_t length);
+uint32_t __real_nrf_drv_mpu_write_registers(uint8_t reg, uint8_t * p_data, uint32_t length);
+uint32_t __real_nrf_drv_mpu_write_single_register(uint8_t reg, uint8_t data);
+
+
+
+static void log_add(bool read, uint8_t reg, uint8_t const * p_data, uint32_t length)
+{
+    access_t * p_access = &m_log[m_log_count];
+
+    if(m_log_count == MAX_LOG) return;
+    m_log_count++;
+    p_access->read   = read;
+    p_access->reg    = reg;
+    p_access->length = (uint8_t)length;
+    memset(p_access->data, 0, sizeof(p_access->data));
+    if(!read) memcpy(p_access->data, p_data, (length < sizeof(p_access->data)) ? length : sizeof(p_access->data));
+}
+
+
+
+uint32_t __wrap_nrf_drv_mpu_read_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    uint32_t err_code;
+
+    log_add(true, reg, NULL, length);
+    if(reg == MPU_REG_I2C_MST_STATUS && m_status_busy > 0)
+    {
+        m_status_busy--;
+        p_data[0] = 0;
+        return NRF_SUCCESS;
+    }
+    err_code = __real_nrf_drv_mpu_read_registers(reg, p_data, length);
+    if(reg == MPU_REG_I2C_MST_STATUS && m_status_nack && (p_data[0] & SLV4_DONE))
+    {
+        p_data[0] |= SLV4_NACK;
+    }
+    return err_code;
+}
+
+
+
+uint32_t __wrap_nrf_drv_mpu_write_registers(uint8_t reg, uint8_t * p_data, uint32_t length)
+{
+    log_add(false, reg, p_data, length);
+    return __real_nrf_drv_mpu_write_registers(reg, p_data, length);
+}
+
+
+
+uint32_t __wrap_nrf_drv_mpu_write_single_register(uint8_t reg, uint8_t data)
+{
+    log_add(false, reg, &data, 1);
+    return __real_nrf_drv_mpu_write_single_register(reg, data);
+}
+
+
+
+static void motion(uint32_t time_us, nrf_drv_mpu_sim_motion_t * p_motion, void * p_context)
+{
+    int16_t n = (int16_t)(time_us / 1000);
+
+    (void)p_context;
+    p_motion->accel[0] = n;
+    p_motion->accel[1] = -2 * n;
+    p_motion->accel[2] = 2048;
+    p_motion->temp     = 340;
+    p_motion->gyro[0]  = 3 * n;
+    p_motion->gyro[1]  = -4;
+    p_motion->gyro[2]  = 5;
+    p_motion->magn[0]  = 300 + n;
+    p_motion->magn[1]  = -0x1234;
+    p_motion->magn[2]  = n;
+}
+
+
+
+static void log_check_write(uint16_t i, uint8_t reg, uint8_t length, uint8_t d0, uint8_t d1, uint8_t d2)
+{
+    TEST_CHECK(!m_log[i].read);
+    TEST_CHECK_EQUAL(reg, m_log[i].reg);
+    TEST_CHECK_EQUAL(length, m_log[i].length);
+    TEST_CHECK_EQUAL(d0, m_log[i].data[0]);
+    TEST_CHECK_EQUAL(d1, m_log[i].data[1]);
+    TEST_CHECK_EQUAL(d2, m_log[i].data[2]);
+}
+
+
+
+/**@brief The accesses up to the slave 4 poll. Returns the index of the first poll */
+static uint16_t sequence_check(void)
+{
+    uint8_t user_ctrl = nrf_drv_mpu_sim_register_get(MPU_REG_USER_CTRL);
+
+    TEST_CHECK(m_log[0].read && m_log[0].reg == MPU_REG_INT_PIN_CFG && m_log[0].length == 1);
+    log_check_write(1, MPU_REG_INT_PIN_CFG, 1, nrf_drv_mpu_sim_register_get(MPU_REG_INT_PIN_CFG), 0, 0);
+    TEST_CHECK_EQUAL(0, m_log[1].data[0] & BYPASS_EN);
+    log_check_write(2, MPU_REG_I2C_MST_CTRL, 1, 0x4D, 0, 0);                   // WAIT_FOR_ES, 400 kHz
+    log_check_write(3, MPU_REG_USER_CTRL, 1, user_ctrl, 0, 0);
+    TEST_CHECK(user_ctrl & I2C_MST_EN);
+#if defined(MPU_USES_SPI)
+    TEST_CHECK(user_ctrl & I2C_IF_DIS);
+#else
+    TEST_CHECK(!(user_ctrl & I2C_IF_DIS));
+#endif
+    log_check_write(4, MPU_REG_I2C_SLV4_ADDR, 3, MPU_AK89XX_MAGN_ADDRESS, MPU_AK89XX_REG_CNTL, *(uint8_t const *)&m_magn_config);
+    log_check_write(5, MPU_REG_I2C_SLV4_CTRL, 1, 0x80, 0, 0);
+    return 6;
+}
+
+
+
+static uint16_t polls_count(uint16_t from)
+{
+    uint16_t polls = 0;
+
+    for(uint16_t i = from; i < m_log_count; i++)
+    {
+        polls += (m_log[i].read && m_log[i].reg == MPU_REG_I2C_MST_STATUS);
+    }
+    return polls;
+}
+
+
+
+static uint32_t master_init(void)
+{
+    app_mpu_magn_config_t config = m_magn_config;
+
+    m_log_count = 0;
+    return app_mpu_magnetometer_master_init(&config);
+}
+
+
+
+static void setup(void)
+{
+    app_mpu_config_t config = MPU_DEFAULT_CONFIG();
+
+    nrf_drv_mpu_sim_motion_set(motion, NULL);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_init());
+    config.smplrt_div = 4;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_config(&config));
+    nrf_drv_mpu_sim_time_advance(20000);
+}
+
+
+
+/**@brief Slave 4 reports a NACK, or never reports DONE. Slave 0 must not be set up */
+static void test_slv4_failures(void)
+{
+    imu_sample_t               sample;
+    magn_values_t              magn;
+    app_mpu_magn_read_status_t status;
+    uint16_t                   poll;
+
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_read_all_magn(&sample, &magn, &status));
+
+    m_status_nack = true;
+    m_status_busy = 2;
+    TEST_CHECK_EQUAL(NRF_ERROR_INTERNAL, master_init());
+    poll = sequence_check();
+    TEST_CHECK_EQUAL(3, polls_count(poll));
+    TEST_CHECK_EQUAL(poll + 3, m_log_count);
+    m_status_nack = false;
+
+    m_status_busy = UINT16_MAX;
+    TEST_CHECK_EQUAL(NRF_ERROR_TIMEOUT, master_init());
+    poll = sequence_check();
+    TEST_CHECK_EQUAL(SLV4_TIMEOUT_POLLS, polls_count(poll));
+    TEST_CHECK_EQUAL(poll + SLV4_TIMEOUT_POLLS, m_log_count);
+    m_status_busy = 0;
+
+    TEST_CHECK_EQUAL(0, nrf_drv_mpu_sim_register_get(MPU_REG_I2C_SLV0_CTRL));
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_read_all_magn(&sample, &magn, &status));
+}
+
+
+
+/**@brief A bus error at any access is returned, and the init can be tried again */
+static void test_bus_errors(void)
+{
+    uint16_t accesses;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, master_init());
+    accesses = m_log_count;
+    for(uint16_t i = 0; i < accesses; i++)
+    {
+        nrf_drv_mpu_sim_fault_set(i, 1, NRF_ERROR_INTERNAL);
+        TEST_CHECK_EQUAL(NRF_ERROR_INTERNAL, master_init());
+        TEST_CHECK_EQUAL(i + 1, m_log_count);
+    }
+    nrf_drv_mpu_sim_fault_set(0, 0, 0);
+}
+
+
+
+static void test_init_and_read(void)
+{
+    imu_sample_t               sample;
+    magn_values_t              magn;
+    magn_values_t              magn_only;
+    app_mpu_magn_read_status_t status;
+    uint16_t                   poll;
+
+    m_status_busy = 4;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, master_init());
+    poll = sequence_check();
+    TEST_CHECK_EQUAL(5, polls_count(poll));
+    log_check_write(m_log_count - 1, MPU_REG_I2C_SLV0_ADDR, 3,
+                    0x80 | MPU_AK89XX_MAGN_ADDRESS, MPU_AK89XX_REG_HXL, 0x80 | 7);    // Read 7 bytes from HXL
+    TEST_CHECK_EQUAL(poll + 5 + 1, m_log_count);
+    TEST_CHECK_EQUAL(0, nrf_drv_mpu_sim_register_get(MPU_REG_INT_PIN_CFG) & BYPASS_EN);
+
+    // The magnetometer runs at 100 Hz, and slave 0 copies it at every 200 Hz sample
+    nrf_drv_mpu_sim_time_advance(100000);
+    m_log_count = 0;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_all_magn(&sample, &magn, &status));
+    TEST_CHECK_EQUAL(1, m_log_count);
+    TEST_CHECK(m_log[0].read);
+    TEST_CHECK_EQUAL(MPU_REG_ACCEL_XOUT_H, m_log[0].reg);
+    TEST_CHECK_EQUAL(21, m_log[0].length);
+    TEST_CHECK_EQUAL(21, MPU_SAMPLE_MAGN_SIZE);
+
+    // All of one sample, and the magnetometer measurement of the last 10 ms before it
+    TEST_CHECK_EQUAL(-2 * sample.accel.x, sample.accel.y);
+    TEST_CHECK_EQUAL(2048, sample.accel.z);
+    TEST_CHECK_EQUAL(340, sample.temp);
+    TEST_CHECK_EQUAL(3 * sample.accel.x, sample.gyro.x);
+    TEST_CHECK_EQUAL(-4, sample.gyro.y);
+    TEST_CHECK_EQUAL(5, sample.gyro.z);
+    TEST_CHECK(magn.z <= sample.accel.x && magn.z > sample.accel.x - 10);
+    TEST_CHECK_EQUAL(300 + magn.z, magn.x);
+    TEST_CHECK_EQUAL(-0x1234, magn.y);
+    TEST_CHECK_EQUAL(1, status.res_mirror);
+    TEST_CHECK_EQUAL(0, status.overflow);
+
+    // Without the IMU, the same values come from EXT_SENS_DATA
+    m_log_count = 0;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_magnetometer(&magn_only, NULL));
+    TEST_CHECK_EQUAL(1, m_log_count);
+    TEST_CHECK_EQUAL(MPU_REG_EXT_SENS_DATA_00, m_log[0].reg);
+    TEST_CHECK_EQUAL(7, m_log[0].length);
+    TEST_CHECK(memcmp(&magn, &magn_only, sizeof(magn)) == 0);
+}
+
+
+
+int main(void)
+{
+    setup();
+    test_slv4_failures();
+    test_bus_errors();
+    test_init_and_read();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
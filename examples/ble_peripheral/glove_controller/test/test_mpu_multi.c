@@ -0,0 +1,193 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of app_mpu_multi.c against six simulated MPUs sampling at 200 Hz, one on the back of the
+ * hand and one on each finger. Reads all of them each sample period for ten seconds and checks
+ * that every handle gets the fresh sample of its own MPU, that the reads fit the period on the
+ * bus, and that a failed read shows in its own handle only and the next round recovers.
+ *
+ * Built for SPI, each MPU on its own CS pin, as a TWI bus only takes two MPUs. Built with the
+ * default queue of the simulated bus driver, and with a queue of two so most reads are queued
+ * as the ones before them are done.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "app_mpu.h"
+#include "app_mpu_multi.h"
+#include "nrf_drv_mpu.h"
+#include "nrf_drv_mpu_sim.h"
+#include "sdk_errors.h"
+#include "test.h"
+
+#define NUM_MPUS                6
+#define SAMPLE_PERIOD_US        5000    // 1 kHz / (1 + 4)
+#define ROUNDS                  2000    // 10 s
+
+#if !defined(MPU_USES_SPI)
+#error "Six MPUs need one CS pin each. Build with MPU_USES_SPI"
+#endif
+
+// CS pins
+static app_mpu_t    m_mpus[NUM_MPUS] =
+{
+    APP_MPU_INSTANCE(10),
+    APP_MPU_INSTANCE(11),
+    APP_MPU_INSTANCE(12),
+    APP_MPU_INSTANCE(13),
+    APP_MPU_INSTANCE(14),
+    APP_MPU_INSTANCE(15),
+};
+static uint32_t     m_time_us;
+static uint32_t     m_reads;
+static uint32_t     m_read_result;
+
+
+
+/**@brief Numbers each sample in accel.x and puts the number of the MPU in accel.y and gyro.z,
+ * so a sample from the wrong MPU or an old one shows
+ */
+static void motion(uint32_t time_us, nrf_drv_mpu_sim_motion_t * p_motion, void * p_context)
+{
+    int16_t id = (int16_t)(intptr_t)p_context;
+
+    p_motion->accel[0] = (int16_t)(time_us / SAMPLE_PERIOD_US);
+    p_motion->accel[1] = id;
+    p_motion->accel[2] = 2048;
+    p_motion->gyro[2]  = (int16_t)-id;
+}
+
+
+
+static void read_handler(uint32_t result, void * p_context)
+{
+    TEST_CHECK(p_context == &m_reads);
+    m_read_result = result;
+    m_reads++;
+}
+
+
+
+/**@brief Function for reading all the MPUs the way a sample timer would, and running the bus
+ * @retval  Result passed to the handler
+ */
+static uint32_t read_all(void)
+{
+    uint32_t reads = m_reads;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_multi_read_async(read_handler, &m_reads));
+    TEST_CHECK(app_mpu_multi_busy());
+    TEST_CHECK_EQUAL(NRF_ERROR_BUSY, app_mpu_multi_read_async(read_handler, &m_reads));
+    while(nrf_drv_mpu_sim_process() > 0)
+    {
+    }
+    TEST_CHECK(!app_mpu_multi_busy());
+    TEST_CHECK_EQUAL(reads + 1, m_reads);
+    return m_read_result;
+}
+
+
+
+static void samples_check(void)
+{
+    imu_sample_t sample;
+
+    for(uint8_t i = 0; i < NUM_MPUS; i++)
+    {
+        app_mpu_multi_sample_get(&m_mpus[i], &sample);
+        TEST_CHECK_EQUAL(NRF_SUCCESS, m_mpus[i].result);
+        TEST_CHECK_EQUAL((int16_t)(m_time_us / SAMPLE_PERIOD_US), sample.accel.x);
+        TEST_CHECK_EQUAL(i + 1, sample.accel.y);
+        TEST_CHECK_EQUAL(2048, sample.accel.z);
+        TEST_CHECK_EQUAL(-(i + 1), sample.gyro.z);
+    }
+}
+
+
+
+static void setup(void)
+{
+    app_mpu_t too_many[APP_MPU_MULTI_MAX + 1];
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_init());
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, app_mpu_multi_read_async(read_handler, &m_reads));
+
+    TEST_CHECK_EQUAL(NRF_ERROR_NULL, app_mpu_multi_init(NULL, NUM_MPUS));
+    TEST_CHECK_EQUAL(MPU_BAD_PARAMETER, app_mpu_multi_init(m_mpus, 0));
+    TEST_CHECK_EQUAL(MPU_BAD_PARAMETER, app_mpu_multi_init(too_many, APP_MPU_MULTI_MAX + 1));
+
+    for(uint8_t i = 0; i < NUM_MPUS; i++)
+    {
+        m_mpus[i].config.smplrt_div = 4;
+        nrf_drv_mpu_sim_select(m_mpus[i].dev);
+        nrf_drv_mpu_sim_motion_set(motion, (void *)(intptr_t)(i + 1));
+    }
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_multi_init(m_mpus, NUM_MPUS));
+}
+
+
+
+static void test_rounds(void)
+{
+    nrf_drv_mpu_sim_stats_t start;
+    nrf_drv_mpu_sim_stats_t end;
+
+    nrf_drv_mpu_sim_stats_get(&start);
+    for(uint32_t round = 0; round < ROUNDS; round++)
+    {
+        m_time_us += SAMPLE_PERIOD_US;
+        nrf_drv_mpu_sim_time_advance(SAMPLE_PERIOD_US);
+        TEST_CHECK_EQUAL(NRF_SUCCESS, read_all());
+        samples_check();
+    }
+    nrf_drv_mpu_sim_stats_get(&end);
+
+    // One burst read per MPU and round, and the bus has time to spare in each period
+    printf("  %u MPUs at %u Hz: %u transactions and %u us on the bus per round\n",
+           NUM_MPUS, 1000000 / SAMPLE_PERIOD_US,
+           (unsigned)((end.transactions - start.transactions) / ROUNDS),
+           (unsigned)((end.bus_time_us - start.bus_time_us) / ROUNDS));
+    TEST_CHECK_EQUAL(NUM_MPUS * ROUNDS, end.transactions - start.transactions);
+    TEST_CHECK_EQUAL(NUM_MPUS * ROUNDS * (1 + MPU_SAMPLE_SIZE), end.bytes - start.bytes);
+    TEST_CHECK((end.bus_time_us - start.bus_time_us) / ROUNDS < SAMPLE_PERIOD_US / 2);
+    TEST_CHECK_EQUAL(0, end.errors - start.errors);
+}
+
+
+
+static void test_bus_error(void)
+{
+    // The read of the fourth MPU fails, the others are still read
+    m_time_us += SAMPLE_PERIOD_US;
+    nrf_drv_mpu_sim_time_advance(SAMPLE_PERIOD_US);
+    nrf_drv_mpu_sim_fault_set(3, 1, NRF_ERROR_TIMEOUT);
+    TEST_CHECK_EQUAL(NRF_ERROR_TIMEOUT, read_all());
+    for(uint8_t i = 0; i < NUM_MPUS; i++)
+    {
+        TEST_CHECK_EQUAL((i == 3) ? NRF_ERROR_TIMEOUT : NRF_SUCCESS, m_mpus[i].result);
+    }
+
+    // And the next round reads it again
+    m_time_us += SAMPLE_PERIOD_US;
+    nrf_drv_mpu_sim_time_advance(SAMPLE_PERIOD_US);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, read_all());
+    samples_check();
+}
+
+
+
+int main(void)
+{
+    setup();
+    test_rounds();
+    test_bus_error();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,433 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Regression test of the simulated MPU in nrf_drv_mpu_sim.c: sample rate timing, data ready and
+ * FIFO, FIFO overflow, the AK89xx behind bypass and the I2C master, injected faults and NACKs,
+ * the asynchronous queue and playback of a motion trace. Built once per MPU type.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "nrf_drv_mpu.h"
+#include "nrf_drv_mpu_sim.h"
+#include "sdk_errors.h"
+#include "test.h"
+
+#if defined(MPU60x0)
+    #include "mpu60x0_register_map.h"
+    #define WHO_AM_I            0x68
+    #define FIFO_SIZE           1024
+#elif defined(MPU9150)
+    #include "mpu9150_register_map.h"
+    #define WHO_AM_I            0x68
+    #define FIFO_SIZE           1024
+    #define MAGN                1
+    #define MAGN_CNTL           0x01    // Single measurement, the only mode the AK8975 has
+    #define MAGN_FIRST_US       7200    // Single measurement time
+#elif defined(MPU9255)
+    #include "mpu9255_register_map.h"
+    #define WHO_AM_I            0x73
+    #define FIFO_SIZE           512
+    #define MAGN                1
+    #define MAGN_CNTL           0x16    // Continuous 100 Hz, 16 bit
+    #define MAGN_FIRST_US       10000
+#endif
+
+#define SAMPLE_BYTES            14      // Accelerometer, temperature and gyroscope
+#define TRACE_PERIOD_US         10000   // 100 Hz
+
+
+/**@brief A recorded motion trace, one row per 10 ms */
+static const int16_t m_trace[][3] =
+{
+    {    0,    0, 16384 },
+    {  120,  -40, 16300 },
+    {  800, -300, 15800 },
+    { 2400, -900, 14100 },
+    { 4100, -1500, 12000 },
+    { 2600, -700, 14900 },
+    {  300,  -20, 16350 },
+};
+
+#define TRACE_ROWS              (sizeof(m_trace) / sizeof(m_trace[0]))
+
+static uint32_t m_time_us;          // Simulated time
+static uint32_t m_trace_start_us;   // Simulated time of the first trace row
+static uint32_t m_handler_calls;
+static uint32_t m_handler_result;
+
+
+
+/**@brief Row of the trace played at a time after trace_start(). Past the end the last row is held */
+static uint32_t trace_row(uint32_t time_us)
+{
+    uint32_t row = time_us / TRACE_PERIOD_US;
+
+    return (row < TRACE_ROWS) ? row : (TRACE_ROWS - 1);
+}
+
+
+
+static void trace_motion(uint32_t time_us, nrf_drv_mpu_sim_motion_t * p_motion, void * p_context)
+{
+    uint32_t row = trace_row(time_us - m_trace_start_us);
+
+    (void)p_context;
+    memcpy(p_motion->accel, m_trace[row], sizeof(p_motion->accel));
+    p_motion->gyro[0] = (int16_t)row;
+    p_motion->magn[0] = (int16_t)(100 + row);
+    p_motion->magn[2] = -5;
+}
+
+
+
+static void time_advance(uint32_t time_us)
+{
+    m_time_us += time_us;
+    nrf_drv_mpu_sim_time_advance(time_us);
+}
+
+
+
+static void trace_start(void)
+{
+    m_trace_start_us = m_time_us;
+    nrf_drv_mpu_sim_motion_set(trace_motion, NULL);
+}
+
+
+
+static void evt_handler(uint32_t result, void * p_context)
+{
+    (void)p_context;
+    m_handler_calls++;
+    m_handler_result = result;
+}
+
+
+
+static uint16_t fifo_count_get(void)
+{
+    uint8_t count[2];
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_FIFO_COUNTH, count, 2));
+    return (uint16_t)((count[0] << 8) | count[1]);
+}
+
+
+
+static uint8_t int_status_get(void)
+{
+    uint8_t status;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_INT_STATUS, &status, 1));
+    return status;
+}
+
+
+
+static int16_t be16(uint8_t const * p_data)
+{
+    return (int16_t)((p_data[0] << 8) | p_data[1]);
+}
+
+
+
+static void test_identity_and_reset(void)
+{
+    uint8_t data;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_init());
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_WHO_AM_I, &data, 1));
+    TEST_CHECK_EQUAL(WHO_AM_I, data);
+    TEST_CHECK_EQUAL(0x40, nrf_drv_mpu_sim_register_get(MPU_REG_PWR_MGMT_1)); // Asleep after reset
+
+    // Read only registers ignore writes
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_WHO_AM_I, 0x00));
+    TEST_CHECK_EQUAL(WHO_AM_I, nrf_drv_mpu_sim_register_get(MPU_REG_WHO_AM_I));
+}
+
+
+
+static void test_sample_rate(void)
+{
+    // Asleep: no samples
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, 0x40 | 0x04));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_FIFO_EN, 0xF8));
+    time_advance(50000);
+    TEST_CHECK_EQUAL(0, fifo_count_get());
+    TEST_CHECK_EQUAL(0, int_status_get() & 0x01);
+
+    // 1 kHz / (1 + 9) with the low pass filter on
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_PWR_MGMT_1, 0x00));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_CONFIG, 0x01));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_SMPLRT_DIV, 9));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, 0x40 | 0x04));
+    time_advance(9999);
+    TEST_CHECK_EQUAL(0, fifo_count_get());
+    time_advance(1);
+    TEST_CHECK_EQUAL(SAMPLE_BYTES, fifo_count_get());
+    time_advance(90000);
+    TEST_CHECK_EQUAL(10 * SAMPLE_BYTES, fifo_count_get());
+
+    // 8 kHz / (1 + 7) with the low pass filter off
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_CONFIG, 0x00));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_SMPLRT_DIV, 7));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, 0x40 | 0x04));
+    time_advance(20000);
+    TEST_CHECK_EQUAL(20 * SAMPLE_BYTES, fifo_count_get());
+}
+
+
+
+static void test_data_ready(void)
+{
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_SMPLRT_DIV, 0)); // 8 kHz
+    (void)int_status_get();
+    TEST_CHECK_EQUAL(0, int_status_get());
+    time_advance(125);
+    TEST_CHECK_EQUAL(0x01, int_status_get());
+    TEST_CHECK_EQUAL(0, int_status_get());                                  // Cleared when read
+
+    // Latched INT pin follows INT_STATUS, a pulse only reports once
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_INT_ENABLE, 0x01));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_INT_PIN_CFG, 0x20));
+    time_advance(125);
+    TEST_CHECK(nrf_drv_mpu_sim_int_get());
+    TEST_CHECK(nrf_drv_mpu_sim_int_get());
+    (void)int_status_get();
+    TEST_CHECK(!nrf_drv_mpu_sim_int_get());
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_INT_PIN_CFG, 0x00));
+    time_advance(125);
+    TEST_CHECK(nrf_drv_mpu_sim_int_get());
+    TEST_CHECK(!nrf_drv_mpu_sim_int_get());
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_INT_ENABLE, 0x00));
+}
+
+
+
+static void test_fifo_overflow(void)
+{
+    uint8_t  sample[SAMPLE_BYTES];
+    uint32_t samples = FIFO_SIZE / SAMPLE_BYTES + 3;
+    nrf_drv_mpu_sim_stats_t stats;
+
+    trace_start();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_CONFIG, 0x01));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_SMPLRT_DIV, 0)); // 1 kHz
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, 0x40 | 0x04));
+    (void)int_status_get();
+
+    // The oldest bytes are overwritten, so the FIFO no longer starts on a sample boundary
+    time_advance(samples * 1000);
+    TEST_CHECK_EQUAL(FIFO_SIZE, fifo_count_get());
+    TEST_CHECK(int_status_get() & 0x10);
+    nrf_drv_mpu_sim_stats_get(&stats);
+    TEST_CHECK(stats.fifo_overflows > 0);
+
+    // Resync: reset the FIFO and the next sample starts on a boundary again
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, 0x40 | 0x04));
+    TEST_CHECK_EQUAL(0, fifo_count_get());
+    TEST_CHECK_EQUAL(0x40, nrf_drv_mpu_sim_register_get(MPU_REG_USER_CTRL));  // Reset bit clears itself
+    time_advance(1000);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_FIFO_R_W, sample, SAMPLE_BYTES));
+    TEST_CHECK_EQUAL(m_trace[trace_row((samples + 1) * 1000)][2], be16(&sample[4]));
+    TEST_CHECK_EQUAL(trace_row((samples + 1) * 1000), be16(&sample[8]));     // Gyroscope X after temperature
+
+    // FIFO_MODE keeps the oldest data and drops the new
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_CONFIG, 0x41));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, 0x40 | 0x04));
+    time_advance(samples * 1000);
+    TEST_CHECK_EQUAL(FIFO_SIZE, fifo_count_get());
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_FIFO_R_W, sample, SAMPLE_BYTES));
+    TEST_CHECK_EQUAL(m_trace[trace_row((samples + 2) * 1000)][0], be16(&sample[0]));
+    TEST_CHECK_EQUAL(FIFO_SIZE - SAMPLE_BYTES, fifo_count_get());
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_CONFIG, 0x01));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, 0x04));
+    nrf_drv_mpu_sim_motion_set(NULL, NULL);
+}
+
+
+
+static void test_motion_trace(void)
+{
+    static const uint8_t reset = 0x80;
+    uint8_t data[6];
+
+    // One row per sample at 100 Hz
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_registers(MPU_REG_PWR_MGMT_1, (uint8_t *)&reset, 1));
+    trace_start();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_PWR_MGMT_1, 0x00));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_CONFIG, 0x01));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_SMPLRT_DIV, 9));
+    for(uint32_t i = 1; i < TRACE_ROWS + 3; i++)
+    {
+        time_advance(TRACE_PERIOD_US);
+        TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_ACCEL_XOUT_H, data, 6));
+        TEST_CHECK_EQUAL(m_trace[trace_row(i * TRACE_PERIOD_US)][0], be16(&data[0]));
+        TEST_CHECK_EQUAL(m_trace[trace_row(i * TRACE_PERIOD_US)][1], be16(&data[2]));
+        TEST_CHECK_EQUAL(m_trace[trace_row(i * TRACE_PERIOD_US)][2], be16(&data[4]));
+    }
+    nrf_drv_mpu_sim_motion_set(NULL, NULL);
+}
+
+
+
+#if (MAGN)
+
+static void test_magnetometer_bypass(void)
+{
+    uint8_t data[8];
+
+    // The magnetometer only answers in bypass mode
+    TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_ANACK, nrf_drv_mpu_read_magnetometer_registers(MPU_AK89XX_REG_WIA, data, 1));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_INT_PIN_CFG, 0x02));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_magnetometer_registers(MPU_AK89XX_REG_WIA, data, 1));
+    TEST_CHECK_EQUAL(0x48, data[0]);
+
+    trace_start();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_magnetometer_register(MPU_AK89XX_REG_CNTL, 0x01));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_magnetometer_registers(MPU_AK89XX_REG_ST1, data, 1));
+    TEST_CHECK_EQUAL(0, data[0] & 0x01);
+    time_advance(7200);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_magnetometer_registers(MPU_AK89XX_REG_ST1, data, 8));
+    TEST_CHECK_EQUAL(0x01, data[0] & 0x01);
+    TEST_CHECK_EQUAL(100, (int16_t)(data[1] | (data[2] << 8)));             // Little endian
+    TEST_CHECK_EQUAL(-5, (int16_t)(data[5] | (data[6] << 8)));
+    TEST_CHECK_EQUAL(0, nrf_drv_mpu_sim_register_get(MPU_REG_USER_CTRL) & 0x20);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_magnetometer_registers(MPU_AK89XX_REG_ST1, data, 1));
+    TEST_CHECK_EQUAL(0, data[0] & 0x01);                                    // Reading ST2 ended the data read
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_magnetometer_registers(MPU_AK89XX_REG_CNTL, data, 1));
+    TEST_CHECK_EQUAL(0, data[0] & 0x0F);                                    // Back in power down
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_INT_PIN_CFG, 0x00));
+    nrf_drv_mpu_sim_motion_set(NULL, NULL);
+}
+
+
+
+static void test_magnetometer_i2c_master(void)
+{
+    uint8_t slv4[3] = {MPU_AK89XX_MAGN_ADDRESS, MPU_AK89XX_REG_CNTL, MAGN_CNTL};
+    uint8_t slv0[3] = {0x80 | MPU_AK89XX_MAGN_ADDRESS, MPU_AK89XX_REG_ST1, 0x80 | 8};
+    uint8_t data[8];
+    uint16_t count;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, 0x40 | 0x20 | 0x04));
+
+    // Slave 4 to a wrong address is NACKed
+    slv4[0] = 0x0D;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_registers(MPU_REG_I2C_SLV4_ADDR, slv4, 3));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_I2C_SLV4_CTRL, 0x80));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_I2C_MST_STATUS, data, 1));
+    TEST_CHECK_EQUAL(0x40 | 0x10, data[0]);
+
+    // Slave 4 starts the measurement, slave 0 reads ST1 to ST2 on every sample into EXT_SENS_DATA and the FIFO
+    slv4[0] = MPU_AK89XX_MAGN_ADDRESS;
+    trace_start();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_SMPLRT_DIV, 9)); // Samples at 10 and 20 ms
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_registers(MPU_REG_I2C_SLV4_ADDR, slv4, 3));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_I2C_SLV4_CTRL, 0x80));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_I2C_MST_STATUS, data, 1));
+    TEST_CHECK_EQUAL(0x40, data[0]);
+    TEST_CHECK_EQUAL(0, nrf_drv_mpu_sim_register_get(MPU_REG_I2C_SLV4_CTRL) & 0x80);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_registers(MPU_REG_I2C_SLV0_ADDR, slv0, 3));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_FIFO_EN, 0x01));
+    time_advance(20000);
+
+    count = fifo_count_get();
+    TEST_CHECK_EQUAL(2 * 8, count);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_FIFO_R_W, data, 8));
+    TEST_CHECK_EQUAL(0x01, data[0] & 0x01);
+    TEST_CHECK_EQUAL(100 + MAGN_FIRST_US / TRACE_PERIOD_US, (int16_t)(data[1] | (data[2] << 8)));
+    TEST_CHECK_EQUAL(-5, (int16_t)(data[5] | (data[6] << 8)));
+
+    // In the bypass path the magnetometer is hidden while the master is on
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_INT_PIN_CFG, 0x02));
+    TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_ANACK, nrf_drv_mpu_read_magnetometer_registers(MPU_AK89XX_REG_WIA, data, 1));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_INT_PIN_CFG, 0x00));
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_FIFO_EN, 0x00));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_I2C_SLV0_CTRL, 0x00));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(MPU_REG_USER_CTRL, 0x04));
+    nrf_drv_mpu_sim_motion_set(NULL, NULL);
+}
+
+#endif // (MAGN)
+
+
+
+static void test_faults_and_async(void)
+{
+    uint8_t data[4];
+    uint8_t write[15] = {0};
+    nrf_drv_mpu_sim_stats_t before;
+    nrf_drv_mpu_sim_stats_t after;
+
+    nrf_drv_mpu_sim_stats_get(&before);
+
+    // One good transaction, then two failures
+    nrf_drv_mpu_sim_fault_set(1, 2, NRF_ERROR_DRV_TWI_ERR_DNACK);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_WHO_AM_I, data, 1));
+    TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_DNACK, nrf_drv_mpu_read_registers(MPU_REG_WHO_AM_I, data, 1));
+    TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_DNACK, nrf_drv_mpu_write_single_register(MPU_REG_SMPLRT_DIV, 1));
+    TEST_CHECK_EQUAL(9, nrf_drv_mpu_sim_register_get(MPU_REG_SMPLRT_DIV));    // The failed write did nothing
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_WHO_AM_I, data, 1));
+
+    // Nobody at the address
+    TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_ANACK, nrf_drv_mpu_dev_read_registers(0x50, MPU_REG_WHO_AM_I, data, 1));
+
+    // Length limits of the TWI driver
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_LENGTH, nrf_drv_mpu_read_registers(MPU_REG_WHO_AM_I, data, 0));
+    TEST_CHECK_EQUAL(NRF_ERROR_DATA_SIZE, nrf_drv_mpu_write_registers(MPU_REG_SMPLRT_DIV, write, sizeof(write)));
+
+    nrf_drv_mpu_sim_stats_get(&after);
+    TEST_CHECK_EQUAL(5, after.transactions - before.transactions);         // Length errors never reach the bus
+    TEST_CHECK_EQUAL(3, after.errors - before.errors);
+
+    // Asynchronous transactions run on nrf_drv_mpu_sim_process(), a failure reaches the handler
+    for(uint32_t i = 0; i < NRF_DRV_MPU_SIM_QUEUE_SIZE; i++)
+    {
+        TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers_async(MPU_REG_WHO_AM_I, data, 1, evt_handler, NULL));
+    }
+    TEST_CHECK_EQUAL(NRF_ERROR_BUSY, nrf_drv_mpu_read_registers_async(MPU_REG_WHO_AM_I, data, 1, evt_handler, NULL));
+    TEST_CHECK_EQUAL(0, m_handler_calls);
+    nrf_drv_mpu_sim_fault_set(NRF_DRV_MPU_SIM_QUEUE_SIZE - 1, 1, NRF_ERROR_DRV_TWI_ERR_OVERRUN);
+    TEST_CHECK_EQUAL(NRF_DRV_MPU_SIM_QUEUE_SIZE, nrf_drv_mpu_sim_process());
+    TEST_CHECK_EQUAL(NRF_DRV_MPU_SIM_QUEUE_SIZE, m_handler_calls);
+    TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_OVERRUN, m_handler_result);
+    TEST_CHECK_EQUAL(0, nrf_drv_mpu_sim_process());
+
+    // Data to write is copied when scheduled
+    data[0] = 3;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_registers_async(MPU_REG_SMPLRT_DIV, data, 1, NULL, NULL));
+    data[0] = 4;
+    (void)nrf_drv_mpu_sim_process();
+    TEST_CHECK_EQUAL(3, nrf_drv_mpu_sim_register_get(MPU_REG_SMPLRT_DIV));
+}
+
+
+
+int main(void)
+{
+    test_identity_and_reset();
+    test_sample_rate();
+    test_data_ready();
+    test_fifo_overflow();
+#if (MAGN)
+    test_magnetometer_bypass();
+    test_magnetometer_i2c_master();
+#endif
+    test_motion_trace();
+    test_faults_and_async();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,305 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the SPI backend, nrf_drv_mpu_spi.c, on the SPI mock. Checks how the transfers are framed
+ * by CS and how long they are, the clock each register range is read at, and that a transfer that
+ * never finishes is stopped so the MPU is released and the next transfer works. Built a second time
+ * with SPIM, where reads are also started through PPI, to check that the trigger leaves no PPI
+ * channel or GPIOTE behind when setting it up fails at any step.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "nrf_drv_mpu.h"
+#include "nrf_drv_spi.h"
+#include "sdk_errors.h"
+#include "mock_spi.h"
+#include "test.h"
+
+#if defined(SPIM_PRESENT) && SPI0_USE_EASY_DMA
+#define TEST_SPIM               1
+#else
+#define TEST_SPIM               0
+#endif
+
+#define REG_SMPLRT_DIV          0x19
+#define REG_ACCEL_XOUT_H        0x3B
+#define REG_EXT_SENS_DATA_23    0x60
+#define REG_FIFO_R_W            0x74
+#define REG_WHO_AM_I            0x75
+#define SPI_BUFFER_SIZE         22      // MPU_SPI_BUFFER_SIZE, reads above it go directly into the buffer of the caller
+
+static uint32_t m_done;
+static uint32_t m_result;
+
+
+
+static void evt_handler(uint32_t result, void * p_context)
+{
+    m_done++;
+    m_result = result;
+}
+
+
+
+static void frame_check(uint32_t frames, uint32_t bytes)
+{
+    mock_spi_stats_t stats;
+
+    mock_spi_stats_get(&stats);
+    TEST_CHECK_EQUAL(frames, stats.frames);
+    TEST_CHECK_EQUAL(bytes, stats.frame_bytes);
+    TEST_CHECK_EQUAL(0, stats.errors);
+    TEST_CHECK(mock_spi_cs_get());
+}
+
+
+
+static void setup(void)
+{
+    uint8_t * p_regs;
+
+    mock_spi_reset();
+    p_regs = mock_spi_registers();
+    for(uint32_t i = 0; i < 256; i++)
+    {
+        p_regs[i] = (uint8_t)(i ^ 0x5A);
+    }
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_init());
+    TEST_CHECK(mock_spi_cs_get());
+    TEST_CHECK(mock_spi_cs_output_get());
+    m_done = 0;
+}
+
+
+
+static void test_framing(void)
+{
+    uint8_t * p_regs;
+    uint8_t   data[3] = {1, 2, 3};
+    uint8_t   buf[256];
+
+    setup();
+    p_regs = mock_spi_registers();
+    mock_spi_hold_set(true);
+
+    // Write: register byte and the data in one frame, at the configuration clock
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_registers_async(REG_SMPLRT_DIV, data, sizeof(data), evt_handler, NULL));
+    TEST_CHECK(!mock_spi_cs_get());
+    TEST_CHECK_EQUAL(NRF_ERROR_BUSY, nrf_drv_mpu_read_registers_async(REG_WHO_AM_I, buf, 1, evt_handler, NULL));
+    mock_spi_run();
+    TEST_CHECK_EQUAL(1, m_done);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, m_result);
+    TEST_CHECK(memcmp(&p_regs[REG_SMPLRT_DIV], data, sizeof(data)) == 0);
+    frame_check(1, 1 + sizeof(data));
+
+    // Configuration register, at 1 MHz
+    memset(buf, 0, sizeof(buf));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers_async(REG_WHO_AM_I, buf, 1, evt_handler, NULL));
+    TEST_CHECK_EQUAL(NRF_DRV_SPI_FREQ_1M, mock_spi_frequency_get());
+    mock_spi_run();
+    TEST_CHECK_EQUAL(REG_WHO_AM_I ^ 0x5A, buf[0]);
+    frame_check(2, 2);
+
+    // Sensor data at the fast clock
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers_async(REG_ACCEL_XOUT_H, buf, 14, evt_handler, NULL));
+    TEST_CHECK_EQUAL(NRF_DRV_SPI_FREQ_8M, mock_spi_frequency_get());
+    mock_spi_run();
+    for(uint8_t i = 0; i < 14; i++)
+    {
+        TEST_CHECK_EQUAL((REG_ACCEL_XOUT_H + i) ^ 0x5A, buf[i]);
+    }
+    frame_check(3, 15);
+
+    // Runs past the sensor data into configuration registers, so at 1 MHz
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers_async(REG_EXT_SENS_DATA_23, buf, 2, evt_handler, NULL));
+    TEST_CHECK_EQUAL(NRF_DRV_SPI_FREQ_1M, mock_spi_frequency_get());
+    mock_spi_run();
+    frame_check(4, 3);
+
+    // Longest read that fits the buffers, and the shortest that goes directly into the caller's buffer
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers_async(REG_FIFO_R_W, buf, SPI_BUFFER_SIZE - 1, evt_handler, NULL));
+    mock_spi_run();
+    frame_check(5, SPI_BUFFER_SIZE);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers_async(REG_FIFO_R_W, buf, SPI_BUFFER_SIZE, evt_handler, NULL));
+    mock_spi_run();
+    frame_check(6, SPI_BUFFER_SIZE + 1);
+    for(uint8_t i = 0; i < SPI_BUFFER_SIZE; i++)
+    {
+        TEST_CHECK_EQUAL(SPI_BUFFER_SIZE - 1 + i, buf[i]);
+    }
+
+    // A FIFO drain: the register byte and then the data, in one frame with CS held low between
+    memset(buf, 0xEE, sizeof(buf));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers_async(REG_FIFO_R_W, buf, 240, evt_handler, NULL));
+    TEST_CHECK_EQUAL(NRF_DRV_SPI_FREQ_8M, mock_spi_frequency_get());
+    TEST_CHECK_EQUAL(NRF_ERROR_BUSY, nrf_drv_mpu_read_registers_async(REG_FIFO_R_W, buf, 2, evt_handler, NULL));
+    mock_spi_run();
+    TEST_CHECK_EQUAL(7, m_done);
+    frame_check(7, 241);
+    for(uint8_t i = 0; i < 240; i++)
+    {
+        TEST_CHECK_EQUAL((uint8_t)(2 * SPI_BUFFER_SIZE - 1 + i), buf[i]);
+    }
+    TEST_CHECK_EQUAL(0xEE, buf[240]);
+
+    // Lengths that do not fit
+    TEST_CHECK_EQUAL(NRF_ERROR_DATA_SIZE, nrf_drv_mpu_read_registers_async(REG_FIFO_R_W, buf, MPU_MAX_READ_LENGTH + 1, evt_handler, NULL));
+    TEST_CHECK_EQUAL(NRF_ERROR_DATA_SIZE, nrf_drv_mpu_read_registers_async(REG_FIFO_R_W, buf, 0, evt_handler, NULL));
+    TEST_CHECK_EQUAL(NRF_ERROR_DATA_SIZE, nrf_drv_mpu_write_registers_async(REG_SMPLRT_DIV, buf, SPI_BUFFER_SIZE, evt_handler, NULL));
+    frame_check(7, 241);
+
+    // Blocking calls
+    mock_spi_hold_set(false);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(REG_SMPLRT_DIV, 9));
+    TEST_CHECK_EQUAL(9, p_regs[REG_SMPLRT_DIV]);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(REG_WHO_AM_I, buf, 1));
+    TEST_CHECK_EQUAL(REG_WHO_AM_I ^ 0x5A, buf[0]);
+    frame_check(9, 2);
+
+    // A transfer the driver does not take releases the MPU at once
+    mock_spi_fail_set(1);
+    TEST_CHECK_EQUAL(NRF_ERROR_INTERNAL, nrf_drv_mpu_read_registers(REG_WHO_AM_I, buf, 1));
+    mock_spi_fail_set(0);
+    frame_check(10, 0);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(REG_WHO_AM_I, buf, 1));
+}
+
+
+
+static void test_timeout(void)
+{
+    mock_spi_stats_t stats;
+    uint8_t          buf[64];
+
+    setup();
+
+    // The transfer never finishes. The MPU must be released and the driver left ready
+    mock_spi_hang_set(true);
+    TEST_CHECK_EQUAL(NRF_ERROR_TIMEOUT, nrf_drv_mpu_write_single_register(REG_SMPLRT_DIV, 1));
+    mock_spi_stats_get(&stats);
+    TEST_CHECK(mock_spi_cs_get());
+    TEST_CHECK_EQUAL(1, stats.dropped);
+    TEST_CHECK_EQUAL(2, stats.inits);
+
+    // Also for the second transfer of a direct read
+    TEST_CHECK_EQUAL(NRF_ERROR_TIMEOUT, nrf_drv_mpu_read_registers(REG_FIFO_R_W, buf, sizeof(buf)));
+    TEST_CHECK(mock_spi_cs_get());
+
+    mock_spi_hang_set(false);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_single_register(REG_SMPLRT_DIV, 7));
+    TEST_CHECK_EQUAL(7, mock_spi_registers()[REG_SMPLRT_DIV]);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(REG_FIFO_R_W, buf, sizeof(buf)));
+    mock_spi_stats_get(&stats);
+    TEST_CHECK_EQUAL(2, stats.dropped);
+    TEST_CHECK_EQUAL(0, stats.errors);
+    TEST_CHECK_EQUAL(65, stats.frame_bytes);
+    TEST_CHECK_EQUAL(0, m_done); // The blocking calls have no handler
+}
+
+
+
+#if TEST_SPIM
+static void test_trigger(void)
+{
+    uint8_t buf[3 * 15];
+    uint8_t data[1];
+
+    setup();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_trigger_enable(MOCK_SPI_EVENT_TRIGGER, REG_ACCEL_XOUT_H, buf, 14));
+    TEST_CHECK_EQUAL(2, mock_spi_ppi_in_use());
+    TEST_CHECK(mock_spi_gpiote_in_use());
+    TEST_CHECK_EQUAL(NRF_ERROR_BUSY, nrf_drv_mpu_read_registers(REG_WHO_AM_I, data, 1));
+
+    // Each trigger is one frame of the register byte and 14 bytes, one after the other in buf
+    for(uint8_t n = 0; n < 3; n++)
+    {
+        mock_spi_event(MOCK_SPI_EVENT_TRIGGER);
+        frame_check(n + 1, 15);
+    }
+    for(uint8_t n = 0; n < 3; n++)
+    {
+        for(uint8_t i = 0; i < 14; i++)
+        {
+            TEST_CHECK_EQUAL((REG_ACCEL_XOUT_H + i) ^ 0x5A, buf[n * 15 + 1 + i]);
+        }
+    }
+
+    // Back to the start of buf
+    memset(buf, 0, sizeof(buf));
+    nrf_drv_mpu_trigger_rewind();
+    mock_spi_event(MOCK_SPI_EVENT_TRIGGER);
+    TEST_CHECK_EQUAL(REG_ACCEL_XOUT_H ^ 0x5A, buf[1]);
+    TEST_CHECK_EQUAL(0, buf[16]);
+
+    nrf_drv_mpu_trigger_disable();
+    TEST_CHECK_EQUAL(0, mock_spi_ppi_in_use());
+    TEST_CHECK(!mock_spi_gpiote_in_use());
+    TEST_CHECK(mock_spi_cs_get());
+    TEST_CHECK(mock_spi_cs_output_get());
+    mock_spi_event(MOCK_SPI_EVENT_TRIGGER);
+    frame_check(4, 15);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(REG_WHO_AM_I, data, 1));
+    TEST_CHECK_EQUAL(REG_WHO_AM_I ^ 0x5A, data[0]);
+}
+
+
+
+static void test_trigger_errors(void)
+{
+    uint8_t  buf[15];
+    uint8_t  data[1];
+    uint32_t err_code;
+    uint32_t call = 0;
+
+    setup();
+
+    // Fails each call the setup makes in turn, until it gets through
+    do
+    {
+        call++;
+        mock_spi_fail_set(call);
+        err_code = nrf_drv_mpu_trigger_enable(MOCK_SPI_EVENT_TRIGGER, REG_ACCEL_XOUT_H, buf, 14);
+        if(err_code != NRF_SUCCESS)
+        {
+            TEST_CHECK_EQUAL(0, mock_spi_ppi_in_use());
+            TEST_CHECK(!mock_spi_gpiote_in_use());
+            TEST_CHECK(mock_spi_cs_get());
+            TEST_CHECK(mock_spi_cs_output_get());
+            mock_spi_fail_set(0);
+            TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(REG_WHO_AM_I, data, 1));
+        }
+    }while(err_code != NRF_SUCCESS && call < 20);
+    mock_spi_fail_set(0);
+
+    printf("  trigger setup failed at each of %u calls\n", call - 1);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, err_code);
+    TEST_CHECK(call >= 9);
+    TEST_CHECK_EQUAL(2, mock_spi_ppi_in_use());
+    mock_spi_event(MOCK_SPI_EVENT_TRIGGER);
+    TEST_CHECK_EQUAL(REG_ACCEL_XOUT_H ^ 0x5A, buf[1]);
+    nrf_drv_mpu_trigger_disable();
+    TEST_CHECK_EQUAL(0, mock_spi_ppi_in_use());
+}
+#endif
+
+
+
+int main(void)
+{
+    test_framing();
+    test_timeout();
+#if TEST_SPIM
+    test_trigger();
+    test_trigger_errors();
+#endif
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
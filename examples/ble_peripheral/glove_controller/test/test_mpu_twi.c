@@ -0,0 +1,228 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the queued TWI backend, nrf_drv_mpu_twi.c, on the app_twi mock. Checks the register
+ * transfers and the asynchronous API, then measures the transaction throughput of a full queue
+ * and the fraction of time the CPU is idle when sampling at 1 kHz with blocking and with
+ * asynchronous reads.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "app_mpu.h"
+#include "nrf_drv_mpu.h"
+#include "sdk_errors.h"
+#include "mock_app_twi.h"
+#include "test.h"
+
+#define SAMPLE_RATE_HZ          1000
+#define RUN_TIME_US             1000000
+
+static uint8_t * m_p_regs;
+static uint32_t  m_done;
+static uint32_t  m_result;
+static uint8_t   m_data[MPU_SAMPLE_SIZE];
+
+
+
+static void evt_handler(uint32_t result, void * p_context)
+{
+    (void)p_context;
+    m_done++;
+    m_result = result;
+}
+
+
+
+/**@brief Keeps the queue full: every finished read schedules the next */
+static void reschedule_handler(uint32_t result, void * p_context)
+{
+    m_done++;
+    if(result == NRF_SUCCESS && p_context != NULL)
+    {
+        (void)nrf_drv_mpu_read_registers_async(MPU_REG_ACCEL_XOUT_H, m_data, MPU_SAMPLE_SIZE, reschedule_handler, p_context);
+    }
+}
+
+
+
+static void setup(void)
+{
+    mock_app_twi_reset();
+    m_p_regs = mock_app_twi_device_add(MPU_ADDRESS);
+    for(uint8_t i = 0; i < MPU_SAMPLE_SIZE; i++)
+    {
+        m_p_regs[MPU_REG_ACCEL_XOUT_H + i] = (uint8_t)(0x10 + i);
+    }
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_init());
+}
+
+
+
+static void test_registers(void)
+{
+    accel_values_t accel;
+    gyro_values_t  gyro;
+    uint8_t        data[14] = {1, 2, 3};
+
+    setup();
+    TEST_CHECK_EQUAL(7, m_p_regs[MPU_REG_SIGNAL_PATH_RESET]);
+    TEST_CHECK_EQUAL(1, m_p_regs[MPU_REG_PWR_MGMT_1]);
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_accel(&accel));
+    TEST_CHECK_EQUAL(0x1011, accel.x);
+    TEST_CHECK_EQUAL(0x1415, accel.z);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_gyro(&gyro));
+    TEST_CHECK_EQUAL(0x1819, gyro.x);
+    TEST_CHECK_EQUAL(0x1C1D, gyro.z);
+
+    // Writes go out as one transfer: register address and the data behind it
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_registers(MPU_REG_SMPLRT_DIV, data, 3));
+    TEST_CHECK_EQUAL(1, m_p_regs[MPU_REG_SMPLRT_DIV]);
+    TEST_CHECK_EQUAL(3, m_p_regs[MPU_REG_SMPLRT_DIV + 2]);
+    TEST_CHECK_EQUAL(NRF_ERROR_DATA_SIZE, nrf_drv_mpu_write_registers(MPU_REG_SMPLRT_DIV, data, 15));
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_LENGTH, nrf_drv_mpu_read_registers(MPU_REG_SMPLRT_DIV, data, 0));
+
+    // Nobody at the address
+    TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_ANACK, nrf_drv_mpu_dev_read_registers(MPU_ADDRESS_AD0_HIGH, 0, data, 1));
+}
+
+
+
+static void test_async(void)
+{
+    accel_values_t accel = {0};
+    uint8_t        data[MPU_SAMPLE_SIZE];
+    uint32_t       i;
+
+    setup();
+
+    // Submit and return: nothing has happened until the bus has had the time
+    m_done = 0;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_accel_async(&accel, evt_handler, NULL));
+    TEST_CHECK_EQUAL(NRF_ERROR_BUSY, app_mpu_read_accel_async(&accel, evt_handler, NULL));
+    TEST_CHECK_EQUAL(0, accel.x);
+    mock_app_twi_time_advance(100);
+    TEST_CHECK_EQUAL(0, m_done);
+    mock_app_twi_time_advance(200);
+    TEST_CHECK_EQUAL(1, m_done);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, m_result);
+    TEST_CHECK_EQUAL(0x1011, accel.x);
+
+    // The queue holds 8 transactions
+    for(i = 0; i < 8; i++)
+    {
+        TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers_async(MPU_REG_ACCEL_XOUT_H, data, 2, evt_handler, NULL));
+    }
+    TEST_CHECK_EQUAL(NRF_ERROR_BUSY, nrf_drv_mpu_read_registers_async(MPU_REG_ACCEL_XOUT_H, data, 2, evt_handler, NULL));
+    mock_app_twi_time_advance(10000);
+    TEST_CHECK_EQUAL(9, m_done);
+    TEST_CHECK_EQUAL(0, mock_app_twi_pending());
+
+    // A blocking read waits behind what is queued, and the queued callbacks run first
+    data[0] = 0x55;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_write_registers_async(MPU_REG_SMPLRT_DIV, data, 1, evt_handler, NULL));
+    data[0] = 0;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers(MPU_REG_SMPLRT_DIV, data, 1));
+    TEST_CHECK_EQUAL(10, m_done);
+    TEST_CHECK_EQUAL(0x55, data[0]);
+
+    // A NACK reaches the handler
+    TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_dev_read_registers_async(MPU_ADDRESS_AD0_HIGH, 0, data, 1, evt_handler, NULL));
+    mock_app_twi_time_advance(1000);
+    TEST_CHECK_EQUAL(11, m_done);
+    TEST_CHECK_EQUAL(NRF_ERROR_DRV_TWI_ERR_ANACK, m_result);
+}
+
+
+
+static void test_throughput(void)
+{
+    mock_app_twi_stats_t stats;
+    uint32_t             bus_limit;
+
+    setup();
+    m_done = 0;
+    for(uint32_t i = 0; i < 4; i++)
+    {
+        TEST_CHECK_EQUAL(NRF_SUCCESS, nrf_drv_mpu_read_registers_async(MPU_REG_ACCEL_XOUT_H, m_data, MPU_SAMPLE_SIZE,
+                                                                       reschedule_handler, m_data));
+    }
+    mock_app_twi_time_advance(RUN_TIME_US);
+    mock_app_twi_stats_get(&stats);
+
+    // Register write, repeated start and a 14 byte read: (2 + 15) bytes of 9 clocks, and start and stop twice
+    bus_limit = RUN_TIME_US / ((((2 + 15) * 9 + 4) * 1000000 + 399999) / 400000);
+    printf("  throughput: %u transactions/s, %u bytes/s, bus busy %u%%, bus limit %u transactions/s\n",
+           m_done, stats.bytes, stats.bus_time_us / (RUN_TIME_US / 100), bus_limit);
+    TEST_CHECK(m_done * 100 >= bus_limit * 95);
+    TEST_CHECK(stats.bus_time_us >= RUN_TIME_US * 95 / 100);
+}
+
+
+
+/**@brief Function for sampling at SAMPLE_RATE_HZ for RUN_TIME_US
+ * @retval  Percent of the time the CPU is idle
+ */
+static uint32_t sample_run(bool async)
+{
+    mock_app_twi_stats_t stats;
+    imu_sample_t         sample;
+    uint32_t             start_us;
+
+    setup();
+    m_done   = 0;
+    start_us = mock_app_twi_time_get();
+    for(uint32_t i = 0; i < RUN_TIME_US / (1000000 / SAMPLE_RATE_HZ); i++)
+    {
+        uint32_t due_us = start_us + i * (1000000 / SAMPLE_RATE_HZ);
+
+        mock_app_twi_time_advance(due_us - mock_app_twi_time_get());
+        if(async)
+        {
+            TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_all_async(&sample, evt_handler, NULL));
+        }
+        else
+        {
+            TEST_CHECK_EQUAL(NRF_SUCCESS, app_mpu_read_all(&sample));
+            m_done++;
+        }
+    }
+    mock_app_twi_time_advance(start_us + RUN_TIME_US - mock_app_twi_time_get());
+    mock_app_twi_stats_get(&stats);
+    TEST_CHECK_EQUAL(SAMPLE_RATE_HZ * (RUN_TIME_US / 1000000), m_done);
+    TEST_CHECK_EQUAL(0x1011, sample.accel.x);
+    return 100 - (stats.cpu_time_us / (RUN_TIME_US / 100));
+}
+
+
+
+static void test_cpu_idle(void)
+{
+    uint32_t blocking = sample_run(false);
+    uint32_t async    = sample_run(true);
+
+    printf("  CPU idle at %u Hz: %u%% with blocking reads, %u%% with asynchronous reads\n",
+           SAMPLE_RATE_HZ, blocking, async);
+    TEST_CHECK(async >= 95);
+    TEST_CHECK(blocking < 70);
+}
+
+
+
+int main(void)
+{
+    test_registers();
+    test_async();
+    test_throughput();
+    test_cpu_idle();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
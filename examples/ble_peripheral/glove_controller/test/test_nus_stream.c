@@ -0,0 +1,348 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Loopback test of the NUS byte stream, ble_nus_stream.c, on the SoftDevice mock. A writer fills the
+ * stream with a counting byte sequence and the notifications are checked byte for byte in the sink,
+ * while connection events give the TX buffers back. Measures the throughput against what the link can
+ * carry, and checks that nothing is lost or sent twice when writes, BLE_EVT_TX_COMPLETE and a
+ * disconnect come in while a notification is handed to the SoftDevice, which is outside the
+ * critical regions.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "ble.h"
+#include "ble_nus.h"
+#include "ble_nus_stream.h"
+#include "sdk_errors.h"
+#include "mock_softdevice.h"
+#include "test.h"
+
+#define CONN_HANDLE             3
+#define CONN_INTERVAL_US        7500
+#define PACKETS_PR_EVENT        6       // Taken by the peer in each connection event
+#define STEP_US                 250
+#define MAX_FRAME_LEN           48
+
+static ble_nus_t        m_nus;
+static ble_nus_stream_t m_stream;
+static uint32_t         m_rand = 1;
+static uint32_t         m_write_seq;        // Next byte of the sequence to write
+static uint32_t         m_recv_seq;         // Next byte of the sequence expected in a notification
+static uint32_t         m_short;            // Notifications shorter than the payload size
+static uint32_t         m_critical_depth;
+static bool             m_in_sink;
+
+
+
+void test_critical_region_enter(void)
+{
+    m_critical_depth++;
+}
+
+
+
+void test_critical_region_exit(void)
+{
+    TEST_CHECK(m_critical_depth > 0);
+    m_critical_depth--;
+}
+
+
+
+static uint32_t rand_get(uint32_t max)
+{
+    m_rand = m_rand * 1103515245 + 12345;
+    return ((m_rand >> 16) % max) + 1;
+}
+
+
+
+static void evt_send(uint16_t evt_id, uint8_t count)
+{
+    ble_evt_t evt;
+
+    memset(&evt, 0, sizeof(evt));
+    evt.header.evt_id = evt_id;
+    evt.evt.gap_evt.conn_handle = CONN_HANDLE;
+    if(evt_id == BLE_EVT_TX_COMPLETE)
+    {
+        evt.evt.common_evt.params.tx_complete.count = count;
+    }
+    ble_nus_stream_on_ble_evt(&m_stream, &evt);
+}
+
+
+
+static void hvx_sink(uint16_t handle, uint8_t const * p_data, uint16_t len)
+{
+    TEST_CHECK(!m_in_sink);
+    TEST_CHECK_EQUAL(0, m_critical_depth);
+    TEST_CHECK_EQUAL(m_nus.rx_handles.value_handle, handle);
+    TEST_CHECK(len > 0 && len <= m_stream.max_payload_len);
+
+    m_in_sink = true;
+    if(len < m_stream.max_payload_len)
+    {
+        m_short++;
+    }
+    for(uint16_t i = 0; i < len; i++)
+    {
+        if(p_data[i] != (uint8_t)m_recv_seq)
+        {
+            printf("  byte %u is %u, expected %u\n", m_recv_seq, p_data[i], (uint8_t)m_recv_seq);
+            TEST_CHECK(false);
+            m_recv_seq = p_data[i];
+        }
+        m_recv_seq++;
+    }
+    m_in_sink = false;
+}
+
+
+
+static void connect(void)
+{
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_t    attr;
+
+    mock_softdevice_reset();
+    mock_softdevice_hvx_sink_set(hvx_sink);
+    mock_softdevice_sys_attr_set(true);
+
+    memset(&m_nus, 0, sizeof(m_nus));
+    memset(&char_md, 0, sizeof(char_md));
+    memset(&attr, 0, sizeof(attr));
+    char_md.char_props.notify = 1;
+    TEST_CHECK_EQUAL(NRF_SUCCESS, sd_ble_gatts_characteristic_add(1, &char_md, &attr, &m_nus.rx_handles));
+    mock_softdevice_cccd_set(m_nus.rx_handles.cccd_handle, BLE_GATT_HVX_NOTIFICATION);
+
+    ble_nus_stream_init(&m_stream, &m_nus, NULL);
+    m_nus.conn_handle = CONN_HANDLE;
+    evt_send(BLE_GAP_EVT_CONNECTED, 0);
+    m_nus.is_notification_enabled = true;
+    evt_send(BLE_GATTS_EVT_WRITE, 0);
+    TEST_CHECK(m_stream.enabled);
+
+    m_write_seq = 0;
+    m_recv_seq  = 0;
+    m_short     = 0;
+}
+
+
+
+static uint32_t frame_write(uint16_t len)
+{
+    uint8_t  frame[MAX_FRAME_LEN];
+    uint32_t err_code;
+
+    for(uint16_t i = 0; i < len; i++)
+    {
+        frame[i] = (uint8_t)(m_write_seq + i);
+    }
+    // Taken before the write, as the irqs write from inside it. A failed write runs no irqs
+    m_write_seq += len;
+    err_code = ble_nus_stream_write(&m_stream, frame, len);
+    if(err_code != NRF_SUCCESS)
+    {
+        m_write_seq -= len;
+    }
+    return err_code;
+}
+
+
+
+/**@brief The peer takes up to PACKETS_PR_EVENT notifications */
+static void conn_event(void)
+{
+    uint8_t count = MIN(mock_softdevice_tx_in_use(), PACKETS_PR_EVENT);
+
+    if(count > 0)
+    {
+        mock_softdevice_tx_complete(count);
+        evt_send(BLE_EVT_TX_COMPLETE, count);
+    }
+}
+
+
+
+/**@brief Runs connection events until everything written has been received */
+static void drain(void)
+{
+    for(uint32_t i = 0; i < 1000 && (ble_nus_stream_pending_get(&m_stream) > 0 || mock_softdevice_tx_in_use() > 0); i++)
+    {
+        conn_event();
+    }
+    TEST_CHECK_EQUAL(0, ble_nus_stream_pending_get(&m_stream));
+    TEST_CHECK_EQUAL(m_write_seq, m_recv_seq);
+    TEST_CHECK_EQUAL(m_write_seq, m_stream.bytes_sent);
+}
+
+
+
+static void test_throughput(void)
+{
+    uint32_t duration_us = 10000000;
+    uint32_t received;
+    uint32_t max_bytes;
+
+    connect();
+    for(uint32_t time_us = 0; time_us < duration_us; time_us += STEP_US)
+    {
+        // Writes as much as fits. Frames that do not fit are written again later
+        for(uint8_t i = 0; i < 4; i++)
+        {
+            if(frame_write(rand_get(MAX_FRAME_LEN)) != NRF_SUCCESS) break;
+        }
+        if(time_us % CONN_INTERVAL_US == 0)
+        {
+            conn_event();
+        }
+    }
+    received  = m_recv_seq;
+    max_bytes = (duration_us / CONN_INTERVAL_US) * PACKETS_PR_EVENT * m_stream.max_payload_len;
+    printf("  saturated: %u bytes/s, %u%% of the link, %u short notifications\n",
+           received / (duration_us / 1000000), (uint32_t)((uint64_t)received * 100 / max_bytes), m_short);
+    TEST_CHECK((uint64_t)received * 100 >= (uint64_t)max_bytes * 98);
+    drain();
+
+    // A light load goes out at once in short notifications, as the link is idle
+    connect();
+    for(uint32_t time_us = 0; time_us < 1000000; time_us += STEP_US)
+    {
+        if(time_us % 20000 == 0)
+        {
+            TEST_CHECK_EQUAL(NRF_SUCCESS, frame_write(10));
+            TEST_CHECK_EQUAL(m_write_seq, m_recv_seq);
+        }
+        if(time_us % CONN_INTERVAL_US == 0)
+        {
+            conn_event();
+        }
+    }
+    drain();
+}
+
+
+
+/**@brief A higher priority writer and the TX_COMPLETE event come in while the SoftDevice is called.
+ * The writer adds less than a notification carries, or the stream would never catch up.
+ */
+static void preempt_irq(void)
+{
+    static uint32_t count;
+
+    count++;
+    if(count % 2 == 0)
+    {
+        (void)frame_write(rand_get(MAX_FRAME_LEN / 2));
+    }
+    if(count % 3 == 0)
+    {
+        conn_event();
+    }
+}
+
+
+
+static void test_preempt(void)
+{
+    connect();
+    mock_softdevice_hvx_irq_set(preempt_irq);
+    for(uint32_t time_us = 0; time_us < 2000000; time_us += STEP_US)
+    {
+        (void)frame_write(rand_get(MAX_FRAME_LEN));
+        if(time_us % CONN_INTERVAL_US == 0)
+        {
+            conn_event();
+        }
+    }
+    mock_softdevice_hvx_irq_set(NULL);
+    printf("  preempted: %u bytes through\n", m_recv_seq);
+    drain();
+}
+
+
+
+/**@brief All TX buffers come back while the notification that found none is still in the SoftDevice */
+static void tx_complete_irq(void)
+{
+    mock_softdevice_hvx_irq_set(NULL);
+    mock_softdevice_tx_complete(MOCK_SOFTDEVICE_TX_BUFFERS);
+    evt_send(BLE_EVT_TX_COMPLETE, MOCK_SOFTDEVICE_TX_BUFFERS);
+}
+
+
+
+static void test_tx_complete_race(void)
+{
+    mock_softdevice_stats_t stats;
+
+    connect();
+    while(mock_softdevice_tx_in_use() < MOCK_SOFTDEVICE_TX_BUFFERS)
+    {
+        TEST_CHECK_EQUAL(NRF_SUCCESS, frame_write(MAX_FRAME_LEN));
+    }
+    for(uint8_t i = 0; i < 4; i++)
+    {
+        TEST_CHECK_EQUAL(NRF_SUCCESS, frame_write(MAX_FRAME_LEN)); // More than the TX buffers take
+    }
+
+    // The write finds no TX buffers, and the event that gives them back is turned away
+    mock_softdevice_hvx_irq_set(tx_complete_irq);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, frame_write(MAX_FRAME_LEN));
+    mock_softdevice_stats_get(&stats);
+    TEST_CHECK(stats.no_tx_packets > 0);
+
+    // It must not wait for a TX_COMPLETE that is not coming
+    TEST_CHECK_EQUAL(MOCK_SOFTDEVICE_TX_BUFFERS, mock_softdevice_tx_in_use());
+    drain();
+}
+
+
+
+/**@brief The link goes down while a notification is in the SoftDevice */
+static void disconnect_irq(void)
+{
+    mock_softdevice_hvx_irq_set(NULL);
+    m_nus.conn_handle             = BLE_CONN_HANDLE_INVALID;
+    m_nus.is_notification_enabled = false;
+    evt_send(BLE_GAP_EVT_DISCONNECTED, 0);
+}
+
+
+
+static void test_disconnect(void)
+{
+    connect();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, frame_write(MAX_FRAME_LEN));
+    mock_softdevice_hvx_irq_set(disconnect_irq);
+    TEST_CHECK_EQUAL(NRF_SUCCESS, frame_write(MAX_FRAME_LEN));
+    TEST_CHECK(!m_stream.enabled);
+    TEST_CHECK_EQUAL(0, ble_nus_stream_pending_get(&m_stream));
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_STATE, frame_write(MAX_FRAME_LEN));
+
+    // Nothing left over for the next connection
+    connect();
+    TEST_CHECK_EQUAL(NRF_SUCCESS, frame_write(MAX_FRAME_LEN));
+    drain();
+}
+
+
+
+int main(void)
+{
+    test_throughput();
+    test_preempt();
+    test_tx_complete_race();
+    test_disconnect();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
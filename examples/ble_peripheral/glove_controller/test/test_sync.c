@@ -0,0 +1,181 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the sensor alignment, app_sync.c, with synthetic clocks. The IMU and the flex sensors
+ * sample a known signal on clocks that run fast and slow against the RTC, and each sample is stamped
+ * in RTC ticks with a tick of capture jitter, as app_timer_cnt_get() does. The flex stream is then
+ * resampled at the IMU timestamps, the way main.c builds its tuples, for long enough that the 24 bit
+ * RTC counter wraps three times and the clocks drift apart by almost a second. The error against the
+ * signal must stay within what interpolation and the tick resolution allow, and must not grow.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "app_sync.h"
+#include "sdk_errors.h"
+#include "test.h"
+
+#define RTC_HZ                  32768.0
+#define START_TICKS             0x00FFF000      // The counter wraps shortly after the start
+#define DURATION_S              1100.0          // The 24 bit counter wraps every 512 s at 32768 Hz
+#define IMU_PERIOD_S            0.001
+#define IMU_PPM                 300.0           // Against the RTC
+#define FLEX_PERIOD_S           0.010
+#define FLEX_PPM                (-500.0)
+#define IMU_BLOCK               10              // Samples aligned at a time, once the block is drained
+#define ALIGN_DELAY_S           0.025           // From the last IMU sample of a block to its alignment
+#define SIGNAL_HZ               1.0
+#define SIGNAL_AMPLITUDE        10000.0
+#define MAX_ERROR               16              // Interpolation over a flex period and two ticks of timestamp error
+
+static uint32_t m_rand = 1;
+
+
+
+static double signal(double time_s, int channel)
+{
+    double value = SIGNAL_AMPLITUDE * sin(2 * M_PI * SIGNAL_HZ * time_s);
+    return (channel == 0) ? value : -value;
+}
+
+
+
+static uint32_t stamp(double time_s)
+{
+    m_rand = m_rand * 1103515245 + 12345;
+    return ((uint32_t)(START_TICKS + time_s * RTC_HZ) + ((m_rand >> 16) & 1)) & APP_SYNC_TIMESTAMP_MASK;
+}
+
+
+
+static void test_basics(void)
+{
+    app_sync_stream_t stream;
+    int16_t           values[2] = {123, 456};
+    uint32_t          t0 = 0x00FFFF00;
+
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_PARAM, app_sync_stream_init(&stream, 0, APP_SYNC_MODE_LINEAR));
+    TEST_CHECK_EQUAL(NRF_ERROR_INVALID_PARAM, app_sync_stream_init(&stream, APP_SYNC_MAX_CHANNELS + 1, APP_SYNC_MODE_LINEAR));
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_sync_stream_init(&stream, 2, APP_SYNC_MODE_LINEAR));
+    TEST_CHECK(!app_sync_resample(&stream, 0, values));
+    TEST_CHECK_EQUAL(123, values[0]);
+
+    // 33 ticks apart across the wrap. The history keeps the last APP_SYNC_HISTORY_SIZE
+    for(int16_t i = 0; i < 20; i++)
+    {
+        int16_t x[2] = {i * 100, -i * 100};
+        app_sync_push(&stream, t0 + i * 33, x);
+    }
+    for(int16_t k = 0; k < 30; k++)
+    {
+        int32_t expected = ((4 * 33 + k * 17) * 100) / 33;
+
+        if(expected > 1900) expected = 1900;
+        TEST_CHECK(app_sync_resample(&stream, (t0 + 4 * 33 + k * 17) & APP_SYNC_TIMESTAMP_MASK, values));
+        TEST_CHECK(abs(values[0] - expected) <= 1);
+        TEST_CHECK_EQUAL(-values[0], values[1]);
+    }
+
+    // Before the history the oldest sample is held
+    TEST_CHECK(app_sync_resample(&stream, t0, values));
+    TEST_CHECK_EQUAL(400, values[0]);
+
+    // Older than the newest, so ignored
+    values[0] = 0;
+    values[1] = 0;
+    app_sync_push(&stream, t0, values);
+    TEST_CHECK(app_sync_resample(&stream, (t0 + 19 * 33 + 5) & APP_SYNC_TIMESTAMP_MASK, values));
+    TEST_CHECK_EQUAL(1900, values[0]);
+
+    // Newest at or before, not interpolated
+    stream.mode = APP_SYNC_MODE_HOLD;
+    TEST_CHECK(app_sync_resample(&stream, (t0 + 5 * 33 + 32) & APP_SYNC_TIMESTAMP_MASK, values));
+    TEST_CHECK_EQUAL(500, values[0]);
+    TEST_CHECK(app_sync_resample(&stream, (t0 + 6 * 33) & APP_SYNC_TIMESTAMP_MASK, values));
+    TEST_CHECK_EQUAL(600, values[0]);
+
+    app_sync_stream_reset(&stream);
+    TEST_CHECK(!app_sync_resample(&stream, t0, values));
+}
+
+
+
+static void test_drift(void)
+{
+    app_sync_stream_t flex;
+    double            imu_period  = IMU_PERIOD_S * (1 - IMU_PPM / 1e6);     // Fast clock, shorter period
+    double            flex_period = FLEX_PERIOD_S * (1 - FLEX_PPM / 1e6);
+    double            imu_time[IMU_BLOCK];
+    uint32_t          imu_stamp[IMU_BLOCK];
+    uint32_t          imu_count   = 0;
+    uint32_t          flex_count  = 0;
+    uint32_t          wraps       = 0;
+    uint32_t          last_stamp  = START_TICKS;
+    int32_t           max_error[2] = {0, 0};    // First and last minute
+    int32_t           max_error_all = 0;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_sync_stream_init(&flex, 2, APP_SYNC_MODE_LINEAR));
+
+    while(imu_count * imu_period < DURATION_S)
+    {
+        // A block of IMU samples, stamped as they are captured
+        for(uint8_t i = 0; i < IMU_BLOCK; i++, imu_count++)
+        {
+            imu_time[i]  = imu_count * imu_period;
+            imu_stamp[i] = stamp(imu_time[i]);
+            if(imu_stamp[i] < last_stamp) wraps++;
+            last_stamp = imu_stamp[i];
+        }
+
+        // The flex samples captured until the block is aligned
+        while(flex_count * flex_period <= imu_time[IMU_BLOCK - 1] + ALIGN_DELAY_S)
+        {
+            double  time_s = flex_count * flex_period;
+            int16_t values[2] = {(int16_t)lround(signal(time_s, 0)), (int16_t)lround(signal(time_s, 1))};
+
+            app_sync_push(&flex, stamp(time_s), values);
+            flex_count++;
+        }
+
+        // Resampled at the IMU timestamps and compared to the signal at the true time of each IMU sample
+        for(uint8_t i = 0; i < IMU_BLOCK; i++)
+        {
+            int16_t values[2];
+
+            TEST_CHECK(app_sync_resample(&flex, imu_stamp[i], values));
+            for(int c = 0; c < 2; c++)
+            {
+                int32_t error = abs(values[c] - (int32_t)lround(signal(imu_time[i], c)));
+
+                if(error > max_error_all) max_error_all = error;
+                if(imu_time[i] < 60.0 && error > max_error[0]) max_error[0] = error;
+                if(imu_time[i] > DURATION_S - 60.0 && error > max_error[1]) max_error[1] = error;
+            }
+        }
+    }
+
+    printf("  %u IMU and %u flex samples over %.0f s, %u wraps, clocks %.3f s apart. Max error %d, first minute %d, last minute %d\n",
+           imu_count, flex_count, DURATION_S, wraps, (IMU_PPM - FLEX_PPM) / 1e6 * DURATION_S,
+           max_error_all, max_error[0], max_error[1]);
+    TEST_CHECK_EQUAL(3, wraps);
+    TEST_CHECK(max_error_all <= MAX_ERROR);
+    TEST_CHECK(max_error[1] <= max_error[0] + 2);   // Does not grow with the drift
+}
+
+
+
+int main(void)
+{
+    test_basics();
+    test_drift();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
@@ -0,0 +1,342 @@
+ /*
+  * The library is not extensively tested and only
+  * meant as a simple explanation and for inspiration.
+  * NO WARRANTY of ANY KIND is provided.
+  */
+
+/* Test of the latency trace, app_trace.c, built for the nRF51 with its 16 bit TIMER at 125 kHz.
+ * The time of each event is set in the capture registers before it is stamped. It covers the
+ * matching of stages by id, the wrap of the clock, the ring running over and the statistics
+ * and percentiles. Then a scripted pipeline is dumped to TRACE_DUMP_FILE the way main.c logs
+ * it with TRACE_DUMP, with its reports, for tools/trace_report.py --check to replay.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "app_trace.h"
+#include "nrf.h"
+#include "nrf_error.h"
+#include "test.h"
+
+#define US_PER_TICK             8
+#define BLOCK_PERIOD_US         50000                                       // FIFO drain period of the glove
+#define BLOCKS                  120                                         // Of the scripted pipeline
+#define BLOCKS_PER_REPORT       40
+
+NRF_TIMER_Type test_timer2;
+
+static const char * const m_stage_names[APP_TRACE_EVT_COUNT] =
+    {"drain", "bus start", "bus end", "process", "fusion", "pack", "hvx", "tx complete"};
+static FILE *   m_dump;
+static uint32_t m_random = 1;
+
+
+
+// Stamps an event at 'us', as the TIMER would capture it
+static void stamp(app_trace_evt_t evt, uint16_t id, uint32_t us)
+{
+    test_timer2.CC[0] = (us / US_PER_TICK) & 0xFFFF;
+    test_timer2.CC[1] = test_timer2.CC[0];
+    app_trace_record(evt, id);
+}
+
+
+
+static app_trace_stats_t stats_get(app_trace_evt_t evt)
+{
+    app_trace_stats_t stats;
+
+    app_trace_stats_get(evt, &stats);
+    return stats;
+}
+
+
+
+static uint32_t random_get(uint32_t range)
+{
+    m_random = (m_random * 1103515245) + 12345;
+    return (m_random >> 16) % range;
+}
+
+
+
+static void test_matching(void)
+{
+    app_trace_stats_t stats;
+
+    TEST_CHECK_EQUAL(NRF_SUCCESS, app_trace_init());
+    TEST_CHECK_EQUAL(TIMER_BITMODE_BITMODE_16Bit, test_timer2.BITMODE);
+
+    // Two blocks in flight. Block 0x100 skips fusion, so pack is matched with its process
+    stamp(APP_TRACE_EVT_DRAIN,       APP_TRACE_ID_NONE, 1000);
+    stamp(APP_TRACE_EVT_BUS_START,   0x100,             1040);
+    stamp(APP_TRACE_EVT_BUS_END,     0x100,             2640);
+    stamp(APP_TRACE_EVT_DRAIN,       APP_TRACE_ID_NONE, 3000);
+    stamp(APP_TRACE_EVT_BUS_START,   0x200,             3016);
+    stamp(APP_TRACE_EVT_PROCESS,     0x100,             3200);
+    stamp(APP_TRACE_EVT_PACK,        0x100,             3400);
+    stamp(APP_TRACE_EVT_BUS_END,     0x200,             4216);
+    stamp(APP_TRACE_EVT_PROCESS,     0x200,             4800);
+    stamp(APP_TRACE_EVT_FUSION,      0x200,             5000);
+    stamp(APP_TRACE_EVT_PACK,        0x200,             5080);
+
+    // A notification mixes bytes of both, so it is matched with the latest pack of any id
+    stamp(APP_TRACE_EVT_HVX,         APP_TRACE_ID_NONE, 5200);
+    stamp(APP_TRACE_EVT_TX_COMPLETE, APP_TRACE_ID_NONE, 12704);
+    TEST_CHECK_EQUAL(0, app_trace_process());
+    TEST_CHECK_EQUAL(0, app_trace_process());
+
+    // The first drain has nothing before it, the rest are matched with the drain
+    TEST_CHECK_EQUAL(0, stats_get(APP_TRACE_EVT_DRAIN).count);
+    stats = stats_get(APP_TRACE_EVT_BUS_START);
+    TEST_CHECK_EQUAL(2, stats.count);
+    TEST_CHECK_EQUAL(16, stats.min);
+    TEST_CHECK_EQUAL(40, stats.max);
+
+    // 0x200 started after the end of 0x100, but is matched with its own start
+    stats = stats_get(APP_TRACE_EVT_BUS_END);
+    TEST_CHECK_EQUAL(2, stats.count);
+    TEST_CHECK_EQUAL(1200, stats.min);
+    TEST_CHECK_EQUAL(1600, stats.max);
+    TEST_CHECK_EQUAL(2800, stats.sum);
+
+    stats = stats_get(APP_TRACE_EVT_PROCESS);
+    TEST_CHECK_EQUAL(2, stats.count);
+    TEST_CHECK_EQUAL(560, stats.min);
+    TEST_CHECK_EQUAL(584, stats.max);
+
+    stats = stats_get(APP_TRACE_EVT_FUSION);
+    TEST_CHECK_EQUAL(1, stats.count);
+    TEST_CHECK_EQUAL(200, stats.sum);
+
+    stats = stats_get(APP_TRACE_EVT_PACK);
+    TEST_CHECK_EQUAL(2, stats.count);
+    TEST_CHECK_EQUAL(80, stats.min);
+    TEST_CHECK_EQUAL(200, stats.max);
+
+    TEST_CHECK_EQUAL(120, stats_get(APP_TRACE_EVT_HVX).sum);
+    TEST_CHECK_EQUAL(7504, stats_get(APP_TRACE_EVT_TX_COMPLETE).sum);
+
+    // Across the wrap of the 16 bit counter, 524288 us
+    stamp(APP_TRACE_EVT_PACK,        0x300,             APP_TRACE_TIME_WRAP_US - 200);
+    stamp(APP_TRACE_EVT_HVX,         APP_TRACE_ID_NONE, APP_TRACE_TIME_WRAP_US + 288);
+    TEST_CHECK_EQUAL(0, app_trace_process());
+    stats = stats_get(APP_TRACE_EVT_HVX);
+    TEST_CHECK_EQUAL(2, stats.count);
+    TEST_CHECK_EQUAL(488, stats.max);
+
+    // Resolution is one tick
+    app_trace_stats_reset();
+    stamp(APP_TRACE_EVT_BUS_START,   0x400,             100);
+    stamp(APP_TRACE_EVT_BUS_END,     0x400,             103);
+    stamp(APP_TRACE_EVT_BUS_START,   0x500,             100);
+    stamp(APP_TRACE_EVT_BUS_END,     0x500,             109);
+    TEST_CHECK_EQUAL(0, app_trace_process());
+    stats = stats_get(APP_TRACE_EVT_BUS_END);
+    TEST_CHECK_EQUAL(0, stats.min);
+    TEST_CHECK_EQUAL(8, stats.max);
+    TEST_CHECK_EQUAL(0, stats_get(APP_TRACE_EVT_DRAIN).count);
+}
+
+
+
+// The main loop falls behind: the oldest events are written over and counted as lost
+static void test_ring(void)
+{
+    uint32_t lost;
+
+    app_trace_stats_reset();
+    for(uint32_t i = 0; i < APP_TRACE_BUFFER_SIZE + 6; i++)
+    {
+        stamp((i & 1) ? APP_TRACE_EVT_BUS_END : APP_TRACE_EVT_BUS_START, 0x600, 10000 + (i * 80));
+    }
+    lost = app_trace_process();
+    TEST_CHECK_EQUAL(6, lost);
+
+    // One lap is kept, from a start on: 64 start/end pairs
+    TEST_CHECK_EQUAL(APP_TRACE_BUFFER_SIZE / 2, stats_get(APP_TRACE_EVT_BUS_START).count);
+    TEST_CHECK_EQUAL(APP_TRACE_BUFFER_SIZE / 2, stats_get(APP_TRACE_EVT_BUS_END).count);
+    TEST_CHECK_EQUAL(80, stats_get(APP_TRACE_EVT_BUS_END).min);
+    TEST_CHECK_EQUAL(80, stats_get(APP_TRACE_EVT_BUS_END).max);
+
+    // Nothing new and the ring is in step again, with exactly one lap
+    TEST_CHECK_EQUAL(0, app_trace_process());
+    app_trace_stats_reset();
+    for(uint32_t i = 0; i < APP_TRACE_BUFFER_SIZE; i++)
+    {
+        stamp((i & 1) ? APP_TRACE_EVT_BUS_END : APP_TRACE_EVT_BUS_START, 0x700, 40000 + (i * 16));
+    }
+    TEST_CHECK_EQUAL(0, app_trace_process());
+    TEST_CHECK_EQUAL(APP_TRACE_BUFFER_SIZE / 2, stats_get(APP_TRACE_EVT_BUS_END).count);
+    TEST_CHECK_EQUAL(16, stats_get(APP_TRACE_EVT_BUS_END).min);
+    TEST_CHECK_EQUAL(16, stats_get(APP_TRACE_EVT_BUS_END).max);
+
+    // Many laps behind, the whole ring is lost but one lap
+    for(uint32_t i = 0; i < 3 * APP_TRACE_BUFFER_SIZE; i++)
+    {
+        stamp(APP_TRACE_EVT_DRAIN, APP_TRACE_ID_NONE, i * 8);
+    }
+    TEST_CHECK_EQUAL(2 * APP_TRACE_BUFFER_SIZE, app_trace_process());
+    TEST_CHECK_EQUAL(0, app_trace_process());
+}
+
+
+
+static void test_percentile(void)
+{
+    app_trace_stats_t stats;
+
+    memset(&stats, 0, sizeof(stats));
+    TEST_CHECK_EQUAL(0, app_trace_percentile_get(&stats, 99));
+
+    // 90 events of 8 us in bucket 3 (8 to 15) and 10 of 96 us in bucket 6 (64 to 127)
+    app_trace_stats_reset();
+    for(uint8_t i = 0; i < 100; i++)
+    {
+        uint32_t latency = (i % 10 == 9) ? 96 : 8;
+
+        stamp(APP_TRACE_EVT_BUS_START, 0x800, 20000 + (i * 1000));
+        stamp(APP_TRACE_EVT_BUS_END,   0x800, 20000 + (i * 1000) + latency);
+        TEST_CHECK_EQUAL(0, app_trace_process());
+    }
+    stats = stats_get(APP_TRACE_EVT_BUS_END);
+    TEST_CHECK_EQUAL(100, stats.count);
+    TEST_CHECK_EQUAL(1680, stats.sum);
+    TEST_CHECK_EQUAL(90, stats.histogram[3]);
+    TEST_CHECK_EQUAL(10, stats.histogram[6]);
+    TEST_CHECK_EQUAL(15,  app_trace_percentile_get(&stats, 50));
+    TEST_CHECK_EQUAL(15,  app_trace_percentile_get(&stats, 90));
+    TEST_CHECK_EQUAL(96,  app_trace_percentile_get(&stats, 91));        // Bucket top is 127, but never above max
+    TEST_CHECK_EQUAL(96,  app_trace_percentile_get(&stats, 99));
+    TEST_CHECK_EQUAL(96,  app_trace_percentile_get(&stats, 100));
+
+    // Rounded up, so one event of three in the top bucket is p67 and above
+    memset(&stats, 0, sizeof(stats));
+    stats.count         = 3;
+    stats.max           = 3000;
+    stats.histogram[1]  = 2;
+    stats.histogram[11] = 1;
+    TEST_CHECK_EQUAL(3,    app_trace_percentile_get(&stats, 66));
+    TEST_CHECK_EQUAL(3000, app_trace_percentile_get(&stats, 67));
+
+    // Within one tick is 0 us, in bucket 0
+    app_trace_stats_reset();
+    stamp(APP_TRACE_EVT_BUS_START, 0x900, 0);
+    stamp(APP_TRACE_EVT_BUS_END,   0x900, 3);
+    TEST_CHECK_EQUAL(0, app_trace_process());
+    TEST_CHECK_EQUAL(1, stats_get(APP_TRACE_EVT_BUS_END).histogram[0]);
+    TEST_CHECK_EQUAL(1, app_trace_percentile_get(&(app_trace_stats_t){.count = 1, .max = 1, .histogram = {1}}, 99));
+
+    // Saturated buckets no longer add up to the count, so the max is reported
+    memset(&stats, 0, sizeof(stats));
+    stats.count        = 100000;
+    stats.max          = 100;
+    stats.histogram[2] = UINT16_MAX;
+    TEST_CHECK_EQUAL(100, app_trace_percentile_get(&stats, 99));
+    TEST_CHECK_EQUAL(7,   app_trace_percentile_get(&stats, 50));
+}
+
+
+
+// Logs one event the way trace_dump_handler() in main.c does
+static void dump_handler(app_trace_evt_t evt, uint16_t id, uint32_t time_us)
+{
+    fprintf(m_dump, "trace %u %u %u\r\n", evt, id, (unsigned)time_us);
+}
+
+
+
+// Logs the report the way trace_process() in main.c does, with the <info> prefix of NRF_LOG
+static void dump_report(uint32_t lost)
+{
+    for(uint8_t evt = 0; evt < APP_TRACE_EVT_COUNT; evt++)
+    {
+        app_trace_stats_t stats = stats_get((app_trace_evt_t)evt);
+        if(stats.count > 0)
+        {
+            fprintf(m_dump, "<info> app: %s: n %u min %u avg %u p99 %u max %u us\r\n", m_stage_names[evt],
+                    (unsigned)stats.count, (unsigned)stats.min, (unsigned)(stats.sum / stats.count),
+                    (unsigned)app_trace_percentile_get(&stats, 99), (unsigned)stats.max);
+        }
+    }
+    if(lost > 0)
+    {
+        fprintf(m_dump, "<info> app: trace: %u events lost\r\n", (unsigned)lost);
+    }
+    fprintf(m_dump, "<info> app: NUS 1200 B/s, 0 B dropped, 0 B queued\r\n");
+    app_trace_stats_reset();
+}
+
+
+
+// A pipeline with jitter, in the order the glove stamps it. Every third block skips fusion, and in
+// the second interval the main loop stalls for 30 blocks, so the ring runs over
+static void test_dump(void)
+{
+    uint32_t lost    = 0;
+    uint32_t tx_busy = 0;
+
+    m_dump = fopen(TRACE_DUMP_FILE, "w");
+    TEST_CHECK(m_dump != NULL);
+    if(m_dump == NULL) return;
+
+    app_trace_init();
+    app_trace_dump_set(dump_handler);
+    fprintf(m_dump, "<info> app: Template started\r\n");
+    fprintf(m_dump, "trace wrap %u\r\n", (unsigned)APP_TRACE_TIME_WRAP_US);
+
+    for(uint32_t block = 0; block < BLOCKS; block++)
+    {
+        uint16_t id = 0x2000 + ((block % 4) * 0x90);
+        uint32_t t  = 7000 + (block * BLOCK_PERIOD_US);
+
+        stamp(APP_TRACE_EVT_DRAIN,     APP_TRACE_ID_NONE, t);
+        t += 20 + random_get(40);
+        stamp(APP_TRACE_EVT_BUS_START, id, t);
+        t += 1300 + random_get(400);
+        stamp(APP_TRACE_EVT_BUS_END,   id, t);
+        t += 100 + random_get(random_get(8) == 0 ? 9000 : 900);
+        stamp(APP_TRACE_EVT_PROCESS,   id, t);
+        if(block % 3 != 0)
+        {
+            t += 600 + random_get(200);
+            stamp(APP_TRACE_EVT_FUSION, id, t);
+        }
+        t += 150 + random_get(100);
+        stamp(APP_TRACE_EVT_PACK,      id, t);
+        t += 30 + random_get(30);
+        stamp(APP_TRACE_EVT_HVX,       APP_TRACE_ID_NONE, t);
+        tx_busy = (tx_busy + 7500 + random_get(15000)) % 22500;
+        stamp(APP_TRACE_EVT_TX_COMPLETE, APP_TRACE_ID_NONE, t + 500 + tx_busy);
+
+        if(block < 50 || block >= 80 || block % 30 == 29)
+        {
+            lost += app_trace_process();
+        }
+        if(block % BLOCKS_PER_REPORT == BLOCKS_PER_REPORT - 1)
+        {
+            dump_report(lost);
+            lost = 0;
+        }
+    }
+    fclose(m_dump);
+    app_trace_dump_set(NULL);
+    printf("  %u blocks dumped to %s for trace_report.py\n", BLOCKS, TRACE_DUMP_FILE);
+}
+
+
+
+int main(void)
+{
+    test_matching();
+    test_ring();
+    test_percentile();
+    test_dump();
+    return TEST_RESULT();
+}
+
+/**
+  @}
+*/
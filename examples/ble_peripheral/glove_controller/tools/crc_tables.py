@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+#
+# The library is not extensively tested and only
+# meant as a simple explanation and for inspiration.
+# NO WARRANTY of ANY KIND is provided.
+#
+"""Prints the lookup tables of crc16.c and crc32.c in components/libraries.
+
+    crc_tables.py 16 > table16.inc
+    crc_tables.py 32 > table32.inc
+
+The output is the initializer of m_crc16_table or m_crc32_table, with the three tables only
+slicing-by-4 uses under #if. Table k holds the CRC of byte n followed by k zero bytes. CRC16 is
+CRC-16/CCITT-FALSE, MSB first, and CRC32 the reflected CRC-32 of zlib. test/test_crc.c checks the
+tables against the bitwise loops.
+"""
+
+import sys
+
+
+def crc32_tables():
+    tables = [[0] * 256 for _ in range(4)]
+    for n in range(256):
+        crc = n
+        for _ in range(8):
+            crc = (crc >> 1) ^ (0xEDB88320 if crc & 1 else 0)
+        tables[0][n] = crc
+    for k in range(1, 4):
+        for n in range(256):
+            tables[k][n] = (tables[k - 1][n] >> 8) ^ tables[0][tables[k - 1][n] & 0xFF]
+    return tables
+
+
+def crc16_tables():
+    tables = [[0] * 256 for _ in range(4)]
+    for n in range(256):
+        crc = n << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xFFFF
+        tables[0][n] = crc
+    for k in range(1, 4):
+        for n in range(256):
+            tables[k][n] = ((tables[k - 1][n] << 8) & 0xFFFF) ^ tables[0][tables[k - 1][n] >> 8]
+    return tables
+
+
+def table(values, digits, per_line):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('        ' + ', '.join('0x%0*X' % (digits, v) for v in values[i:i + per_line]))
+    return '    {\n' + ',\n'.join(lines) + '\n    }'
+
+
+def main():
+    if len(sys.argv) != 2 or sys.argv[1] not in ('16', '32'):
+        sys.exit('usage: crc_tables.py 16|32')
+    width = sys.argv[1]
+    tables, digits, per_line = (crc16_tables(), 4, 8) if width == '16' else (crc32_tables(), 8, 6)
+
+    print('{')
+    print(table(tables[0], digits, per_line) + ',')
+    print('#if (CRC%s_CONFIG_IMPLEMENTATION == CRC%s_IMPLEMENTATION_SLICING_BY_4)' % (width, width))
+    print(',\n'.join(table(t, digits, per_line) for t in tables[1:]))
+    print('#endif')
+    print('};')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,241 @@
+#!/usr/bin/env python3
+#
+# The library is not extensively tested and only
+# meant as a simple explanation and for inspiration.
+# NO WARRANTY of ANY KIND is provided.
+#
+"""Trains gesture models for app_gesture.c and packs them for the upload over NUS.
+
+A recording is a CSV file with one aligned sample per row, as the glove sends them in its
+NUS frames: the gesture id the sample belongs to (0 for none), then the SYNC_CHANNELS values.
+The features are worked out the way app_gesture_features_get() does, in integers, and a
+decision tree is grown on them with its nodes numbered so children come after their parent.
+
+    gesture_model.py train --signals 3,4,9,10 -o model.json rec1.csv rec2.csv
+    gesture_model.py export model.json
+
+export prints the upload commands in hex, one NUS write each, and the glove takes them on a
+bonded and encrypted link only. See app_gesture.h for the wire format.
+"""
+
+import argparse
+import csv
+import json
+import struct
+import sys
+
+WIRE_VERSION = 1
+MAX_SIGNALS = 8
+MAX_WINDOW = 48
+MAX_NODES = 48
+LEAF = 0xFF
+CMD_WRITE = 0xA7
+CMD_COMMIT = 0xA8
+CMD_OVERHEAD = 4
+INT32_MAX = 0x7FFFFFFF
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC16 of crc16_compute()"""
+    for byte in data:
+        crc = ((crc >> 8) | (crc << 8)) & 0xFFFF
+        crc ^= byte
+        crc ^= (crc & 0xFF) >> 4
+        crc ^= (crc << 12) & 0xFFFF
+        crc ^= ((crc & 0xFF) << 5) & 0xFFFF
+    return crc
+
+
+def c_div(a, b):
+    """Integer division of C, which rounds toward zero"""
+    q = abs(a) // abs(b)
+    return q if (a < 0) == (b < 0) else -q
+
+
+def features(window):
+    """Features of one signal over a window, as app_gesture_features_get() works them out"""
+    n = len(window)
+    mean = c_div(sum(window), n)
+    deviations = [x - mean for x in window]
+    crossings = 0
+    last_sign = 0
+    for d in deviations:
+        sign = (d > 0) - (d < 0)
+        if sign != 0:
+            if last_sign != 0 and sign != last_sign:
+                crossings += 1
+            last_sign = sign
+    return [mean,
+            min(sum(d * d for d in deviations) // n, INT32_MAX),
+            min(sum(x * x for x in window) // n, INT32_MAX),
+            crossings,
+            max(abs(d) for d in deviations)]
+
+
+def examples(rows, signals, window, hop):
+    """Feature vectors and labels of the windows the recognizer would classify. A window is
+    labelled with the gesture of more than half its samples, else none"""
+    out = []
+    for end in range(window, len(rows) + 1, hop):
+        samples = rows[end - window:end]
+        vector = []
+        for channel in signals:
+            vector += features([row[1 + channel] for row in samples])
+        labels = [row[0] for row in samples]
+        label = max(set(labels), key=labels.count)
+        out.append((vector, label if labels.count(label) * 2 > window else 0))
+    return out
+
+
+def gini(labels):
+    counts = {}
+    for label in labels:
+        counts[label] = counts.get(label, 0) + 1
+    return 1.0 - sum((c / len(labels)) ** 2 for c in counts.values())
+
+
+def grow(data, depth, min_split):
+    """Decision tree as nested tuples: ('leaf', gesture) or ('split', feature, threshold, left, right)"""
+    labels = [label for _, label in data]
+    majority = max(set(labels), key=labels.count)
+    if depth == 0 or len(data) < min_split or len(set(labels)) == 1:
+        return ('leaf', majority)
+
+    best = None
+    for feature in range(len(data[0][0])):
+        ordered = sorted(data, key=lambda e: e[0][feature])
+        for i in range(1, len(ordered)):
+            a = ordered[i - 1][0][feature]
+            b = ordered[i][0][feature]
+            if a == b:
+                continue
+            left = [label for _, label in ordered[:i]]
+            right = [label for _, label in ordered[i:]]
+            cost = (len(left) * gini(left) + len(right) * gini(right)) / len(ordered)
+            if best is None or cost < best[0]:
+                best = (cost, feature, (a + b) // 2)    # a <= threshold < b, as the glove compares
+    if best is None or best[0] >= gini(labels):
+        return ('leaf', majority)
+
+    _, feature, threshold = best
+    left = [e for e in data if e[0][feature] <= threshold]
+    right = [e for e in data if e[0][feature] > threshold]
+    return ('split', feature, threshold, grow(left, depth - 1, min_split), grow(right, depth - 1, min_split))
+
+
+def number(tree):
+    """Nodes breadth first, so children come after their parent as app_gesture_model_check() wants"""
+    nodes = []
+    queue = [tree]
+    while queue:
+        node = queue.pop(0)
+        if node[0] == 'leaf':
+            nodes.append({'feature': LEAF, 'left': node[1], 'right': 0, 'threshold': 0})
+        else:
+            first = len(nodes) + len(queue) + 1
+            nodes.append({'feature': node[1], 'left': first, 'right': first + 1, 'threshold': node[2]})
+            queue += [node[3], node[4]]
+    return nodes
+
+
+def train(args):
+    signals = [int(s) for s in args.signals.split(',')]
+    if not 0 < len(signals) <= MAX_SIGNALS or not 2 <= args.window <= MAX_WINDOW:
+        sys.exit('1 to %d signals and a window of 2 to %d samples' % (MAX_SIGNALS, MAX_WINDOW))
+
+    data = []
+    for path in args.recordings:
+        with open(path, newline='') as f:
+            rows = [[int(v) for v in row] for row in csv.reader(f) if row and not row[0].startswith('#')]
+        data += examples(rows, signals, args.window, args.hop)
+    if not data:
+        sys.exit('No windows in the recordings')
+
+    # Shallower until the tree fits the glove
+    for depth in range(args.max_depth, 0, -1):
+        nodes = number(grow(data, depth, args.min_split))
+        if len(nodes) <= MAX_NODES:
+            break
+    correct = sum(classify(nodes, v) == label for v, label in data)
+    print('%d windows, %d nodes, %.1f %% classified right' % (len(data), len(nodes), 100.0 * correct / len(data)))
+
+    model = {'signals': signals, 'window': args.window, 'hop': args.hop, 'votes': args.votes,
+             'holdoff': args.holdoff, 'nodes': nodes}
+    with open(args.output, 'w') as f:
+        json.dump(model, f, indent=1)
+
+
+def classify(nodes, vector):
+    i = 0
+    while nodes[i]['feature'] != LEAF:
+        node = nodes[i]
+        i = node['left'] if vector[node['feature']] <= node['threshold'] else node['right']
+    return nodes[i]['left']
+
+
+def encode(model):
+    """Model image in the wire format of app_gesture_model_decode()"""
+    nodes = model['nodes']
+    if len(model['signals']) > MAX_SIGNALS or len(nodes) > MAX_NODES:
+        raise ValueError('model too large')
+    image = struct.pack('<7B', WIRE_VERSION, len(model['signals']), len(nodes),
+                        model['window'], model['hop'], model['votes'], model['holdoff'])
+    image += bytes(model['signals'])
+    for node in nodes:
+        image += struct.pack('<3Bi', node['feature'], node['left'], node['right'], node['threshold'])
+    return image
+
+
+def command(cmd, payload):
+    frame = struct.pack('<2B', cmd, len(payload)) + payload
+    return frame + struct.pack('<H', crc16(frame))
+
+
+def commands(image, mtu_payload):
+    """Upload commands, each fitting one NUS write"""
+    chunk = mtu_payload - CMD_OVERHEAD - 2
+    out = []
+    for offset in range(0, len(image), chunk):
+        out.append(command(CMD_WRITE, struct.pack('<H', offset) + image[offset:offset + chunk]))
+    out.append(command(CMD_COMMIT, struct.pack('<HH', len(image), crc16(image))))
+    return out
+
+
+def export(args):
+    with open(args.model) as f:
+        image = encode(json.load(f))
+    if args.image:
+        with open(args.image, 'wb') as f:
+            f.write(image)
+    for cmd in commands(image, args.mtu_payload):
+        print(cmd.hex())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest='action', required=True)
+
+    p = sub.add_parser('train', help='grow a model from recordings')
+    p.add_argument('recordings', nargs='+')
+    p.add_argument('--signals', required=True, help='channels of the aligned samples, comma separated')
+    p.add_argument('--window', type=int, default=24)
+    p.add_argument('--hop', type=int, default=4)
+    p.add_argument('--votes', type=int, default=2)
+    p.add_argument('--holdoff', type=int, default=8)
+    p.add_argument('--max-depth', type=int, default=5)
+    p.add_argument('--min-split', type=int, default=8)
+    p.add_argument('-o', '--output', required=True)
+    p.set_defaults(func=train)
+
+    p = sub.add_parser('export', help='print the upload commands of a model')
+    p.add_argument('model')
+    p.add_argument('--mtu-payload', type=int, default=20, help='bytes in one NUS write')
+    p.add_argument('--image', help='also write the model image to this file')
+    p.set_defaults(func=export)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()
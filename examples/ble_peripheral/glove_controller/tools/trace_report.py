@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+#
+# The library is not extensively tested and only
+# meant as a simple explanation and for inspiration.
+# NO WARRANTY of ANY KIND is provided.
+#
+"""Turns the app_trace event dump into the per stage latency report.
+
+Build the glove with APP_TRACE_ENABLED 1 and TRACE_DUMP 1 in main.c. It then logs every traced
+event over RTT or the UART as it is matched, one line each:
+
+    trace wrap <us>                 once at start, where the time stamps wrap
+    trace <evt> <id> <time_us>      one per event
+
+Each event is matched with the latest earlier stage of the same id, as app_trace_process()
+does, so the latencies are the ones the glove adds to its statistics. The report has exact
+percentiles where the glove only has one log2 bucket, and the bucketed p99 next to them.
+
+    JLinkRTTLogger -Device NRF51422_XXAC -If SWD -Speed 4000 -RTTChannel 0 rtt.log
+    trace_report.py rtt.log
+
+The lines of the glove's own report, logged every TRACE_REPORT_INTERVAL, split the dump into
+intervals. With --check each of them must match the report computed from the dump, which
+tests the matching and the statistics of app_trace.c against this script. On the nRF52 the
+time stamps are rounded to us before they are dumped, so a latency can differ by 1 us there.
+"""
+
+import argparse
+import math
+import re
+import sys
+
+STAGES = ['drain', 'bus start', 'bus end', 'process', 'fusion', 'pack', 'hvx', 'tx complete']
+ID_NONE = 0xFFFF
+HISTOGRAM_SIZE = 20
+UINT16_MAX = 0xFFFF
+WRAP_US_NRF51 = 0x80000
+
+EVENT_LINE = re.compile(r'trace (\d+) (\d+) (\d+)')
+WRAP_LINE = re.compile(r'trace wrap (\d+)')
+REPORT_LINE = re.compile(r'(' + '|'.join(STAGES) + r'): n (\d+) min (\d+) avg (\d+) p99 (\d+) max (\d+) us')
+
+
+def bucket(us):
+    """Histogram bucket of bucket_get()"""
+    n = 0
+    while us > 1 and n < HISTOGRAM_SIZE - 1:
+        us >>= 1
+        n += 1
+    return n
+
+
+def bucketed_percentile(latencies, percent):
+    """Percentile of app_trace_percentile_get(), the upper end of its log2 bucket"""
+    if not latencies:
+        return 0
+    histogram = [0] * HISTOGRAM_SIZE
+    for us in latencies:
+        n = bucket(us)
+        histogram[n] = min(histogram[n] + 1, UINT16_MAX)
+    target = (len(latencies) * percent + 99) // 100
+    total = 0
+    for n, count in enumerate(histogram):
+        total += count
+        if total >= target:
+            return min((2 << n) - 1, max(latencies))
+    return max(latencies)
+
+
+def percentile(latencies, percent):
+    """Nearest rank percentile"""
+    ordered = sorted(latencies)
+    rank = max(1, math.ceil(len(ordered) * percent / 100))
+    return ordered[rank - 1]
+
+
+class Matcher:
+    """The matching of record_handle(), fed with the dumped events"""
+
+    def __init__(self, wrap_us):
+        self.wrap_us = wrap_us
+        self.last = [None] * len(STAGES)
+        self.latencies = [[] for _ in STAGES]
+
+    def event(self, evt, id, time_us):
+        if evt >= len(STAGES):
+            return
+        for k in range(evt - 1, -1, -1):
+            last = self.last[k]
+            if last is not None and (id == ID_NONE or last[0] == ID_NONE or last[0] == id):
+                self.latencies[evt].append((time_us - last[1]) % self.wrap_us)
+                break
+        self.last[evt] = (id, time_us)
+
+    def take(self):
+        """Latencies since the last call, per stage. The latest events are kept for matching"""
+        latencies = self.latencies
+        self.latencies = [[] for _ in STAGES]
+        return latencies
+
+
+def summary(latencies):
+    """n, min, avg and max as the glove logs them, and the bucketed p99"""
+    return (len(latencies), min(latencies), sum(latencies) // len(latencies),
+            bucketed_percentile(latencies, 99), max(latencies))
+
+
+def report(latencies, title):
+    print(title)
+    print('  %-12s %7s %7s %7s %7s %7s %7s %7s %7s' % ('stage', 'n', 'min', 'avg', 'p50', 'p90', 'p99', 'p99.9', 'max'))
+    for evt, values in enumerate(latencies):
+        if not values:
+            continue
+        n, low, avg, p99_bucket, high = summary(values)
+        print('  %-12s %7d %7d %7d %7d %7d %7d %7d %7d   glove p99 %d' % (
+            STAGES[evt], n, low, avg, percentile(values, 50), percentile(values, 90),
+            percentile(values, 99), percentile(values, 99.9), high, p99_bucket))
+
+
+def check(latencies, reported):
+    """Mismatches between the report computed from the dump and the lines the glove logged"""
+    errors = []
+    for evt, values in enumerate(latencies):
+        expected = summary(values) if values else None
+        if reported.get(evt) != expected:
+            errors.append('%s: glove reported %s, dump gives %s' % (STAGES[evt], reported.get(evt), expected))
+    return errors
+
+
+def replay(lines, args):
+    matcher = Matcher(args.wrap)
+    reported = {}
+    intervals = 0
+    errors = []
+
+    def close():
+        nonlocal reported, intervals
+        latencies = matcher.take()
+        intervals += 1
+        if args.check:
+            errors.extend('interval %d: %s' % (intervals, e) for e in check(latencies, reported))
+        else:
+            report(latencies, 'interval %d' % intervals)
+        reported = {}
+
+    for line in lines:
+        match = WRAP_LINE.search(line)
+        if match:
+            matcher = Matcher(int(match.group(1)))
+            continue
+        match = EVENT_LINE.search(line)
+        if match:
+            if reported:
+                close()
+            matcher.event(*(int(x) for x in match.groups()))
+            continue
+        match = REPORT_LINE.search(line)
+        if match:
+            reported[STAGES.index(match.group(1))] = tuple(int(x) for x in match.groups()[1:])
+    if reported:
+        close()
+
+    rest = matcher.take()
+    if any(rest) and not args.check:
+        report(rest, 'after the last glove report' if intervals else 'whole dump')
+    return intervals, errors
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('log', nargs='?', help='RTT or UART log, standard input if left out')
+    parser.add_argument('--wrap', type=int, default=WRAP_US_NRF51,
+                        help='us at which the time stamps wrap, if the log has no "trace wrap" line')
+    parser.add_argument('--check', action='store_true',
+                        help='compare each glove report with the one computed from the dump')
+    args = parser.parse_args()
+
+    if args.log:
+        with open(args.log, errors='replace') as f:
+            intervals, errors = replay(f, args)
+    else:
+        intervals, errors = replay(sys.stdin, args)
+
+    if args.check:
+        for error in errors:
+            print(error)
+        if intervals == 0:
+            print('no glove reports to check')
+            sys.exit(1)
+        print('%d intervals checked: %s' % (intervals, 'FAILED' if errors else 'ok'))
+        sys.exit(1 if errors else 0)
+
+
+if __name__ == '__main__':
+    main()